@@ -0,0 +1,177 @@
+#include <AdcAds1220.hpp>
+
+#define ADS1220_CMD_RESET 0x06
+#define ADS1220_CMD_START 0x08
+#define ADS1220_CMD_RREG 0x20
+#define ADS1220_CMD_WREG 0x40
+
+#define ADS1220_REG1_TS 0x02
+#define ADS1220_REG1_CM 0x04
+#define ADS1220_REG1_MODE_TURBO 0x10
+#define ADS1220_REG2_PSW 0x08
+#define ADS1220_MUX_SHORTED 0x0E // (AVDD + AVSS) / 2 on both inputs
+
+#define ADS1220_SPI_CLOCK 4000000
+#define ADS1220_OFFSET_SAMPLES 16
+
+TaskHandle_t AdcAds1220::_task = NULL;
+
+void IRAM_ATTR AdcAds1220::onDataReady()
+{
+    BaseType_t woken = pdFALSE;
+    if (_task != NULL)
+        vTaskNotifyGiveFromISR(_task, &woken);
+    if (woken)
+        portYIELD_FROM_ISR();
+}
+
+void AdcAds1220::command(uint8_t command)
+{
+    _spi->beginTransaction(SPISettings(ADS1220_SPI_CLOCK, MSBFIRST, SPI_MODE1));
+    digitalWrite(_csPin, LOW);
+    _spi->transfer(command);
+    digitalWrite(_csPin, HIGH);
+    _spi->endTransaction();
+}
+
+void AdcAds1220::writeRegister(uint8_t reg, uint8_t value)
+{
+    _spi->beginTransaction(SPISettings(ADS1220_SPI_CLOCK, MSBFIRST, SPI_MODE1));
+    digitalWrite(_csPin, LOW);
+    _spi->transfer(ADS1220_CMD_WREG | (reg << 2));
+    _spi->transfer(value);
+    digitalWrite(_csPin, HIGH);
+    _spi->endTransaction();
+}
+
+uint8_t AdcAds1220::readRegister(uint8_t reg)
+{
+    _spi->beginTransaction(SPISettings(ADS1220_SPI_CLOCK, MSBFIRST, SPI_MODE1));
+    digitalWrite(_csPin, LOW);
+    _spi->transfer(ADS1220_CMD_RREG | (reg << 2));
+    uint8_t value = _spi->transfer(0xFF);
+    digitalWrite(_csPin, HIGH);
+    _spi->endTransaction();
+    return value;
+}
+
+int32_t AdcAds1220::readRaw()
+{
+    // continuous mode: the result is clocked out without a command, DIN held high (no command)
+    uint8_t data[3] = {0xFF, 0xFF, 0xFF};
+    _spi->beginTransaction(SPISettings(ADS1220_SPI_CLOCK, MSBFIRST, SPI_MODE1));
+    digitalWrite(_csPin, LOW);
+    _spi->transfer(data, 3);
+    digitalWrite(_csPin, HIGH);
+    _spi->endTransaction();
+
+    // sign extend 24 bit
+    return (int32_t)(((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8)) >> 8;
+}
+
+bool AdcAds1220::begin()
+{
+    // pins come with the config, the chip is set up in configure(). configure() may run in
+    // other tasks on config changes, the interrupt always wakes the acquisition task
+    _task = xTaskGetCurrentTaskHandle();
+    return true;
+}
+
+int32_t AdcAds1220::measureOffset()
+{
+    int64_t sum = 0;
+    for (uint8_t i = 0; i < ADS1220_OFFSET_SAMPLES + 2; i++)
+    {
+        uint32_t start = millis();
+        while (!available())
+        {
+            if (millis() - start > 100)
+                return 0;
+            delay(1);
+        }
+        int32_t raw = readRaw();
+        if (i >= 2) // first conversions after the mux change still settle
+            sum += raw;
+    }
+    return sum / ADS1220_OFFSET_SAMPLES;
+}
+
+void AdcAds1220::configure(const Config &config)
+{
+    if (_drdyPin >= 0)
+        detachInterrupt(digitalPinToInterrupt(_drdyPin));
+
+    _csPin = config.cs_pin;
+    _drdyPin = config.drdy_pin;
+    _rate = config.samplerate;
+    _turbo = config.turbo;
+
+    pinMode(_csPin, OUTPUT);
+    digitalWrite(_csPin, HIGH);
+    pinMode(_drdyPin, INPUT_PULLUP);
+    _spi->begin();
+
+    command(ADS1220_CMD_RESET);
+    delay(1);
+
+    uint8_t reg0 = (config.gain & 0x07) << 1;
+    _reg1 = ((config.samplerate & 0x07) << 5) | (_turbo ? ADS1220_REG1_MODE_TURBO : 0) | ADS1220_REG1_CM;
+    uint8_t reg2 = ((config.reference & 0x03) << 6) | (config.low_side_switch ? ADS1220_REG2_PSW : 0);
+
+    log_i("adc gain %i, rate %i, turbo %i, reference %i", config.gain, config.samplerate, config.turbo, config.reference);
+    writeRegister(1, _reg1);
+    writeRegister(2, reg2);
+    writeRegister(3, 0);
+
+    // offset of PGA and modulator with shorted inputs, like the NAU7802 internal calibration
+    writeRegister(0, (ADS1220_MUX_SHORTED << 4) | reg0);
+    command(ADS1220_CMD_START);
+    _offset = measureOffset();
+    log_i("adc offset %i", _offset);
+
+    writeRegister(0, ((config.mux & 0x0F) << 4) | reg0);
+    if (readRegister(0) != (((config.mux & 0x0F) << 4) | reg0))
+        log_e("ADS1220 not detected, register readback failed");
+    command(ADS1220_CMD_START);
+
+    // Take 4 readings to flush out readings
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint32_t start = millis();
+        while (!available() && millis() - start < 100)
+            delay(1);
+        readRaw();
+    }
+
+    attachInterrupt(digitalPinToInterrupt(_drdyPin), onDataReady, FALLING);
+}
+
+void AdcAds1220::waitReady(uint32_t timeout_ticks)
+{
+    if (!available())
+        ulTaskNotifyTake(pdTRUE, timeout_ticks);
+}
+
+float AdcAds1220::getSampleRate() const
+{
+    static const float turbo_rates[] = {40, 90, 180, 350, 660, 1200, 2000};
+    if (_rate > ADS1220_RATE_2000SPS)
+        return 0;
+    // normal mode: 20, 45, 90, 175, 330, 600, 1000
+    return _turbo ? turbo_rates[_rate] : turbo_rates[_rate] / 2;
+}
+
+bool AdcAds1220::setTemperatureInput(bool enable)
+{
+    // the temperature sensor replaces the input mux, gain settings are ignored while active
+    _reg1 = enable ? (_reg1 | ADS1220_REG1_TS) : (_reg1 & ~ADS1220_REG1_TS);
+    writeRegister(1, _reg1);
+    return true;
+}
+
+float AdcAds1220::convertTemperature(int32_t raw) const
+{
+    // 14 bit left justified, 0.03125 degC per LSB. the offset correction only applies to the
+    // load input, read() result is corrected back here
+    return (float)((raw + _offset) >> 10) * 0.03125f;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <ConfigStructs.hpp>
+
+/// ADS1220 over SPI, continuous conversion up to 2000 SPS in turbo mode.
+/// Data ready interrupt wakes the acquisition task, so it runs once per conversion instead of
+/// once per tick. See AdcBackend.hpp for the interface.
+class AdcAds1220
+{
+private:
+    SPIClass *_spi = &SPI;
+    int8_t _csPin = -1;
+    int8_t _drdyPin = -1;
+    uint8_t _reg1 = 0; // kept to toggle the temperature sensor bit
+    Ads1220SampleRate _rate = ADS1220_RATE_2000SPS;
+    bool _turbo = true;
+    int32_t _offset = 0; // shorted input reading, subtracted from every conversion
+
+    static TaskHandle_t _task; // acquisition task, notified by the data ready interrupt
+    static void IRAM_ATTR onDataReady();
+
+    void command(uint8_t command);
+    void writeRegister(uint8_t reg, uint8_t value);
+    uint8_t readRegister(uint8_t reg);
+    int32_t readRaw();
+    int32_t measureOffset();
+
+public:
+    typedef Ads1220Config Config;
+    static constexpr const char *NAME = "ADS1220";
+    static constexpr int32_t FULL_SCALE_COUNTS = 1 << 23; // +-reference / gain
+    static constexpr bool HAS_TEMPERATURE = true;
+
+    bool begin();
+    void configure(const Config &config);
+
+    bool available() { return digitalRead(_drdyPin) == LOW; }
+    int32_t read() { return readRaw() - _offset; }
+    bool readFailed() const { return false; } // SPI has no acknowledge, glitches show as outliers
+    void waitReady(uint32_t timeout_ticks);
+    float getSampleRate() const;
+
+    bool setTemperatureInput(bool enable);
+    float convertTemperature(int32_t raw) const;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+// ADC backend, selected at compile time with -DADC_BACKEND=ADC_BACKEND_<chip> (default NAU7802).
+// LoadcellClass holds the concrete type, so the sample loop calls are resolved statically and
+// can be inlined, there is no virtual dispatch per sample.
+//
+// Every backend class provides:
+//   typedef ... Config;                         adc.json schema, derived from AdcBaseConfig
+//   static const char *NAME;
+//   static const int32_t FULL_SCALE_COUNTS;     counts for an input of reference / gain,
+//                                               the mV/V scale of PipelineParams::calcScaleFactor
+//   static const bool HAS_TEMPERATURE;          internal temperature sensor for interleaving
+//   bool begin();
+//   void configure(const Config &config);       rate, gain, reference, calibration, flush
+//   bool available();                           conversion ready
+//   int32_t read();                             sign extended raw counts
+//   bool readFailed() const;                    last read() had a bus error, its value is invalid
+//   void waitReady(uint32_t timeout_ticks);     block the acquisition task until available
+//   float getSampleRate() const;                configured rate in SPS
+//   bool setTemperatureInput(bool enable);      only used if HAS_TEMPERATURE
+//   float convertTemperature(int32_t raw) const;
+//
+// AdcMock (lib/AdcMock) implements the same interface without Arduino for host tools.
+
+#define ADC_BACKEND_NAU7802 1
+#define ADC_BACKEND_ADS1220 2
+#define ADC_BACKEND_HX711 3
+
+#ifndef ADC_BACKEND
+#define ADC_BACKEND ADC_BACKEND_NAU7802
+#endif
+
+#if ADC_BACKEND == ADC_BACKEND_NAU7802
+#include <AdcNau7802.hpp>
+typedef AdcNau7802 AdcBackend;
+#elif ADC_BACKEND == ADC_BACKEND_ADS1220
+#include <AdcAds1220.hpp>
+typedef AdcAds1220 AdcBackend;
+#elif ADC_BACKEND == ADC_BACKEND_HX711
+#include <AdcHx711.hpp>
+typedef AdcHx711 AdcBackend;
+#else
+#error "unknown ADC_BACKEND"
+#endif
+
+typedef AdcBackend::Config AdcConfig;
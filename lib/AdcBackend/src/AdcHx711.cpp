@@ -0,0 +1,83 @@
+#include <AdcHx711.hpp>
+
+// SCK high longer than 60 us powers the chip down, the read must not be preempted
+static portMUX_TYPE hx711_mux = portMUX_INITIALIZER_UNLOCKED;
+
+bool AdcHx711::begin()
+{
+    // pins come with the config, set up in configure()
+    return true;
+}
+
+void AdcHx711::configure(const Config &config)
+{
+    _doutPin = config.dout_pin;
+    _sckPin = config.sck_pin;
+    _rate = config.samplerate;
+
+    switch (config.gain)
+    {
+    case HX711_GAIN_32:
+        _gainPulses = 2;
+        break;
+    case HX711_GAIN_64:
+        _gainPulses = 3;
+        break;
+    default:
+        _gainPulses = 1;
+        break;
+    }
+
+    pinMode(_doutPin, INPUT);
+    pinMode(_sckPin, OUTPUT);
+    digitalWrite(_sckPin, LOW);
+    if (config.rate_pin >= 0)
+    {
+        pinMode(config.rate_pin, OUTPUT);
+        digitalWrite(config.rate_pin, _rate == HX711_RATE_80SPS ? HIGH : LOW);
+    }
+    log_i("adc gain %i, rate %i", config.gain, config.samplerate);
+
+    // gain applies from the next conversion on, take 4 readings to flush out readings
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint32_t start = millis();
+        while (!available())
+        {
+            if (millis() - start > 500)
+            {
+                log_e("HX711 not detected, no data ready");
+                return;
+            }
+            delay(1);
+        }
+        read();
+    }
+}
+
+int32_t AdcHx711::read()
+{
+    uint32_t value = 0;
+
+    portENTER_CRITICAL(&hx711_mux);
+    for (uint8_t i = 0; i < 24 + _gainPulses; i++)
+    {
+        digitalWrite(_sckPin, HIGH);
+        delayMicroseconds(1);
+        if (i < 24)
+            value = (value << 1) | digitalRead(_doutPin);
+        digitalWrite(_sckPin, LOW);
+        delayMicroseconds(1);
+    }
+    portEXIT_CRITICAL(&hx711_mux);
+
+    // sign extend 24 bit
+    return (int32_t)(value << 8) >> 8;
+}
+
+void AdcHx711::waitReady(uint32_t timeout_ticks)
+{
+    // DOUT doubles as data line, an edge interrupt would fire on every bit. 80 SPS is slow
+    // enough to poll once per tick
+    vTaskDelay(timeout_ticks);
+}
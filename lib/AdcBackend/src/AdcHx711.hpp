@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ConfigStructs.hpp>
+
+/// HX711 bit banged on two GPIOs, 10 or 80 SPS. See AdcBackend.hpp for the interface.
+class AdcHx711
+{
+private:
+    int8_t _doutPin = -1;
+    int8_t _sckPin = -1;
+    uint8_t _gainPulses = 1; // clock pulses after the 24 data bits select channel and gain of the next conversion
+    Hx711SampleRate _rate = HX711_RATE_80SPS;
+
+public:
+    typedef Hx711Config Config;
+    static constexpr const char *NAME = "HX711";
+    static constexpr int32_t FULL_SCALE_COUNTS = 1 << 24; // +-0.5 * AVDD / gain
+    static constexpr bool HAS_TEMPERATURE = false;
+
+    bool begin();
+    void configure(const Config &config);
+
+    bool available() { return _doutPin >= 0 && digitalRead(_doutPin) == LOW; }
+    int32_t read();
+    bool readFailed() const { return false; } // bit banged, no acknowledge
+    void waitReady(uint32_t timeout_ticks);
+    float getSampleRate() const { return _rate == HX711_RATE_80SPS ? 80 : 10; }
+
+    bool setTemperatureInput(bool enable) { return false; }
+    float convertTemperature(int32_t raw) const { return NAN; }
+};
@@ -0,0 +1,114 @@
+#include <AdcNau7802.hpp>
+
+#include <Wire.h>
+
+// NAU7802 registers not covered by the Adafruit library
+#define NAU7802_ADDRESS 0x2A
+#define NAU7802_REG_I2C_CTRL 0x11
+#define NAU7802_REG_ADCO_B2 0x12
+#define NAU7802_I2C_CTRL_TS 0x02 // PGA input from the internal temperature sensor
+
+bool AdcNau7802::begin()
+{
+    return _adc.begin();
+}
+
+void AdcNau7802::configure(const Config &config)
+{
+    _gain = config.gain;
+    _ldo = config.ldovoltage;
+    _rate = config.samplerate;
+
+    log_i("adc setRate %i", _rate);
+    _adc.setRate(_rate);
+    log_i("adc setGain %i", _gain);
+    _adc.setGain(_gain);
+    log_i("adc setLDO %i", _ldo);
+    _adc.setLDO(_ldo);
+
+    // Take 4 readings to flush out readings
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        while (!_adc.available())
+            delay(1);
+        _adc.read();
+    }
+
+    // Re-cal analog front end when we change gain, sample rate, or channel
+    // removes internal offset and gain error.
+    if (!_adc.calibrate(NAU7802_CALMOD_INTERNAL))
+        log_e("NAU7802_CALMOD_INTERNAL calibration failed!");
+    else
+        log_i("NAU7802_CALMOD_INTERNAL calibration successful.");
+}
+
+int32_t AdcNau7802::read()
+{
+    // own transfer instead of Adafruit_NAU7802::read(), which returns -1 on a failed transfer
+    Wire.beginTransmission(NAU7802_ADDRESS);
+    Wire.write(NAU7802_REG_ADCO_B2);
+    _readFailed = Wire.endTransmission(false) != 0 || Wire.requestFrom((uint8_t)NAU7802_ADDRESS, (uint8_t)3) != 3;
+    if (_readFailed)
+        return 0;
+
+    uint32_t value = (uint32_t)Wire.read() << 16;
+    value |= (uint32_t)Wire.read() << 8;
+    value |= (uint32_t)Wire.read();
+    // sign extend 24 bit
+    return (int32_t)(value << 8) >> 8;
+}
+
+void AdcNau7802::waitReady(uint32_t timeout_ticks)
+{
+    // data ready is only available as register bit, poll once per tick
+    vTaskDelay(timeout_ticks);
+}
+
+float AdcNau7802::getSampleRate() const
+{
+    switch (_rate)
+    {
+    case NAU7802_RATE_10SPS:
+        return 10;
+    case NAU7802_RATE_20SPS:
+        return 20;
+    case NAU7802_RATE_40SPS:
+        return 40;
+    case NAU7802_RATE_80SPS:
+        return 80;
+    case NAU7802_RATE_320SPS:
+        return 320;
+    default:
+        return 0;
+    }
+}
+
+bool AdcNau7802::setTemperatureInput(bool enable)
+{
+    Wire.beginTransmission(NAU7802_ADDRESS);
+    Wire.write(NAU7802_REG_I2C_CTRL);
+    if (Wire.endTransmission(false) != 0 || Wire.requestFrom((uint8_t)NAU7802_ADDRESS, (uint8_t)1) != 1)
+        return false;
+
+    uint8_t ctrl = Wire.read();
+    ctrl = enable ? (ctrl | NAU7802_I2C_CTRL_TS) : (ctrl & ~NAU7802_I2C_CTRL_TS);
+
+    Wire.beginTransmission(NAU7802_ADDRESS);
+    Wire.write(NAU7802_REG_I2C_CTRL);
+    Wire.write(ctrl);
+    if (Wire.endTransmission() != 0)
+        return false;
+
+    // the sensor voltage needs gain 1, the load cell its configured gain
+    return _adc.setGain(enable ? NAU7802_GAIN_1 : _gain);
+}
+
+float AdcNau7802::convertTemperature(int32_t raw) const
+{
+    // datasheet typical values: 109 mV at 25 degC, 390 uV/degC, input range +-Vref/2 at gain 1.
+    // not calibrated, the absolute value may be off by a few degC but the compensation only
+    // depends on temperature differences measured on the same scale
+    float vref = 4.5f - 0.3f * _ldo;
+    float mv = (float)raw / (float)(FULL_SCALE_COUNTS / 2) * 0.5f * vref * 1000.0f;
+    return 25.0f + (mv - 109.0f) / 0.390f;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_NAU7802.h>
+#include <ConfigStructs.hpp>
+
+/// NAU7802 over I2C, 10..320 SPS, see AdcBackend.hpp for the interface
+class AdcNau7802
+{
+private:
+    Adafruit_NAU7802 _adc;
+    NAU7802_Gain _gain = NAU7802_GAIN_128;
+    NAU7802_LDOVoltage _ldo = NAU7802_3V0;
+    NAU7802_SampleRate _rate = NAU7802_RATE_10SPS;
+    bool _readFailed = false;
+
+public:
+    typedef Nau7802Config Config;
+    static constexpr const char *NAME = "NAU7802";
+    static constexpr int32_t FULL_SCALE_COUNTS = 1 << 24; // +-0.5 * reference / gain
+    static constexpr bool HAS_TEMPERATURE = true;
+
+    bool begin();
+    void configure(const Config &config);
+
+    bool available() { return _adc.available(); }
+    int32_t read();
+    bool readFailed() const { return _readFailed; }
+    void waitReady(uint32_t timeout_ticks);
+    float getSampleRate() const;
+
+    bool setTemperatureInput(bool enable);
+    float convertTemperature(int32_t raw) const;
+};
@@ -0,0 +1,112 @@
+#include <AdcMock.hpp>
+
+#include <math.h>
+#include <time.h>
+
+static uint64_t monotonic_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+AdcMock::AdcMock()
+{
+    _clock = monotonic_us;
+}
+
+void AdcMock::setClock(Clock clock)
+{
+    _clock = clock ? clock : monotonic_us;
+    _realtime = clock == nullptr;
+}
+
+bool AdcMock::begin()
+{
+    return true;
+}
+
+void AdcMock::configure(const Config &config)
+{
+    _config = config;
+    _period_us = config.samplerate > 0 ? (uint64_t)(1000000.0 / config.samplerate) : 1000000;
+    if (_period_us == 0)
+        _period_us = 1;
+
+    _start_us = _clock();
+    _lastRead = 0;
+    _conversions = 0;
+    _overruns = 0;
+    _temperatureInput = false;
+    _readFailed = false;
+}
+
+float AdcMock::noise()
+{
+    // xorshift32, deterministic so simulations are repeatable
+    _noise ^= _noise << 13;
+    _noise ^= _noise >> 17;
+    _noise ^= _noise << 5;
+    return ((float)_noise / 4294967296.0f * 2.0f - 1.0f) * _config.noise_counts;
+}
+
+int32_t AdcMock::read()
+{
+    uint64_t latest = completed();
+    if (latest > _lastRead + 1)
+        _overruns += latest - _lastRead - 1;
+    _lastRead = latest;
+    _conversions++;
+
+    double t_s = (double)(latest * _period_us) / 1e6;
+
+    double counts;
+    if (_temperatureInput)
+    {
+        counts = (_config.temperature + _config.temp_drift_per_s * t_s) * 1000.0;
+    }
+    else
+    {
+        double mv_per_v = _config.signal_mv_per_v;
+        if (_config.sine_hz > 0)
+            mv_per_v += _config.sine_mv_per_v * sin(2.0 * M_PI * _config.sine_hz * t_s);
+        counts = mv_per_v / 1000.0 * FULL_SCALE_COUNTS * (double)(1 << _config.gain) + noise();
+
+        if (_config.fault_spike_every > 0 && latest % _config.fault_spike_every == 0)
+            counts += _config.fault_spike_counts;
+        if (_config.fault_saturate_every > 0 && latest % _config.fault_saturate_every == 0)
+            counts = (1 << 23) - 1;
+    }
+
+    _readFailed = _config.fault_read_error_every > 0 && latest % _config.fault_read_error_every == 0;
+    if (_readFailed)
+        return 0;
+
+    // saturate like the 24 bit output register
+    if (counts > (1 << 23) - 1)
+        counts = (1 << 23) - 1;
+    if (counts < -(1 << 23))
+        counts = -(1 << 23);
+    return (int32_t)lround(counts);
+}
+
+void AdcMock::waitReady(uint32_t timeout_ms)
+{
+    if (!_realtime || available())
+        return;
+
+    uint64_t now = _clock();
+    uint64_t next = _start_us + (_lastRead + 1) * _period_us;
+    uint64_t wait = next > now ? next - now : 0;
+    if (wait > (uint64_t)timeout_ms * 1000)
+        wait = (uint64_t)timeout_ms * 1000;
+
+    timespec ts = {(time_t)(wait / 1000000), (long)(wait % 1000000) * 1000};
+    nanosleep(&ts, nullptr);
+}
+
+bool AdcMock::setTemperatureInput(bool enable)
+{
+    _temperatureInput = enable;
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// Simulated ADC with the backend interface of lib/AdcBackend, for host tools and tests.
+// Conversions complete on a fixed period of the clock. A conversion that is not read before
+// the next one completes is lost and counted as overrun, like a real ADC overwriting its
+// output register. Must not depend on Arduino or ESP-IDF headers.
+
+#include <stdint.h>
+
+struct AdcMockConfig
+{
+    float samplerate = 2000.0; // SPS
+    uint8_t gain = 7;          // log2, like the backend gain enums
+    float signal_mv_per_v = 0.0;
+    float sine_mv_per_v = 0.0; // amplitude of an added sine
+    float sine_hz = 0.0;
+    float noise_counts = 0.0; // uniform noise amplitude
+    float temperature = 25.0; // degC
+    float temp_drift_per_s = 0.0;
+
+    // injected faults on every n-th conversion, 0: off
+    uint32_t fault_spike_every = 0; // single sample spike of fault_spike_counts
+    float fault_spike_counts = 0.0;
+    uint32_t fault_saturate_every = 0;  // positive rail code
+    uint32_t fault_read_error_every = 0; // failed bus transfer, readFailed() is true
+
+    // AdcBaseConfig fields used by the acquisition
+    float cali_offset = 0.0;
+    float cali_gain_factor = 1.0;
+    uint16_t temp_interval_samples = 0;
+    uint8_t temp_settle_samples = 2;
+};
+
+class AdcMock
+{
+public:
+    typedef uint64_t (*Clock)(); // microseconds
+
+private:
+    AdcMockConfig _config;
+    Clock _clock;
+    bool _realtime = true; // monotonic clock, waitReady sleeps
+    uint64_t _start_us = 0;
+    uint64_t _period_us = 500;
+    uint64_t _lastRead = 0; // index of the last conversion read, conversions count from 1
+    bool _temperatureInput = false;
+    bool _readFailed = false;
+    uint32_t _noise = 1;
+
+    uint32_t _conversions = 0;
+    uint32_t _overruns = 0;
+
+    uint64_t completed() const { return (_clock() - _start_us) / _period_us; }
+    float noise();
+
+public:
+    typedef AdcMockConfig Config;
+    static constexpr const char *NAME = "mock";
+    static constexpr int32_t FULL_SCALE_COUNTS = 1 << 24; // +-0.5 * reference / gain, like NAU7802
+    static constexpr bool HAS_TEMPERATURE = true;
+
+    AdcMock();
+
+    // simulations pass their own clock and advance it, waitReady() then returns immediately
+    void setClock(Clock clock);
+
+    bool begin();
+    void configure(const Config &config);
+
+    bool available() { return completed() > _lastRead; }
+    int32_t read();
+    bool readFailed() const { return _readFailed; }
+    void waitReady(uint32_t timeout_ms);
+    float getSampleRate() const { return _config.samplerate; }
+
+    bool setTemperatureInput(bool enable);
+    float convertTemperature(int32_t raw) const { return raw / 1000.0f; } // 1 count per mdegC
+
+    // change the simulated input, e.g. for step responses
+    void setSignal(float mv_per_v) { _config.signal_mv_per_v = mv_per_v; }
+
+    uint32_t getConversions() const { return _conversions; }
+    uint32_t getOverruns() const { return _overruns; }
+};
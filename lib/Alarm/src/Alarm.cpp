@@ -0,0 +1,185 @@
+#include <Alarm.hpp>
+
+#include <Trace.hpp> // -->g_Trace
+
+AlarmClass g_Alarm;
+
+AlarmClass::AlarmClass()
+{
+    // on init construct with default variables
+}
+
+void AlarmClass::initialize()
+{
+    log_i("Alarm init");
+
+    _events = xQueueCreateStatic(ALARM_EVENT_QUEUE_SIZE, sizeof(AlarmEvent), _eventsStorage, &_eventsStruct);
+    _configLock = xSemaphoreCreateMutexStatic(&_configLockBuffer);
+
+    this->cbLoadConfiguration(); // applied before the first sample
+
+    // commands
+    EventManager::instance().subscribe([&](Event *ev)
+                                       {
+            if (ev->is("Alarm/acknowledge"))
+            {
+                log_d("Alarm/acknowledge");
+
+                this->cmdAcknowledge();
+            } });
+}
+
+void AlarmClass::applyConfig()
+{
+    // release outputs of the previous configuration
+    writeOutputs(0);
+
+    for (uint8_t i = 0; i < ALARM_MAX_OUTPUTS; i++)
+    {
+        _pins[i] = _applied->output_pins[i];
+        if (_pins[i] >= 0)
+            pinMode(_pins[i], OUTPUT);
+    }
+    _activeHigh = _applied->active_high;
+
+    _engine.compile(_applied->rules, ALARM_MAX_RULES);
+    _outputs = 0xFF; // force write
+    writeOutputs(_engine.getOutputs());
+}
+
+void AlarmClass::writeOutputs(uint8_t outputs)
+{
+    uint8_t changed = outputs ^ _outputs;
+    for (uint8_t i = 0; i < ALARM_MAX_OUTPUTS; i++)
+    {
+        if ((changed & (1 << i)) && _pins[i] >= 0)
+            digitalWrite(_pins[i], ((outputs >> i) & 1) == _activeHigh ? HIGH : LOW);
+    }
+    _outputs = outputs;
+}
+
+void AlarmClass::process(float value, uint32_t timestamp_us, uint32_t period_us)
+{
+    // a command holding the config lock is not waited for, the next sample tries again
+    if (_configChanged && xSemaphoreTake(_configLock, 0) == pdTRUE)
+    {
+        std::swap(_applied, _staged);
+        _configChanged = false;
+        xSemaphoreGive(_configLock);
+        applyConfig();
+    }
+    if (_ackRequested)
+    {
+        _ackRequested = false;
+        _engine.acknowledge();
+    }
+    if (_resetRequested)
+    {
+        _resetRequested = false;
+        _status = AlarmStatus();
+        _evalLatencySum = 0;
+    }
+
+    uint8_t outputs = _engine.process(value);
+
+    if (outputs != _outputs)
+    {
+        writeOutputs(outputs);
+
+        uint32_t latency = micros() - timestamp_us;
+        _status.edges++;
+        _status.edge_latency_us_last = latency;
+        if (latency > _status.edge_latency_us_max)
+            _status.edge_latency_us_max = latency;
+        g_Trace.record(TRACE_ALARM, timestamp_us);
+    }
+
+    uint32_t changed = _engine.takeChangedRules();
+    if (changed)
+    {
+        AlarmEvent event = {millis(), changed, _engine.getActiveRules(), value};
+        xQueueSend(_events, &event, 0); // never block acquisition, drop if nobody drains
+    }
+
+    uint32_t latency = micros() - timestamp_us;
+    _status.eval_samples++;
+    _evalLatencySum += latency;
+    if (latency > _status.eval_latency_us_max)
+        _status.eval_latency_us_max = latency;
+    if (period_us && latency > period_us)
+        _status.deadline_misses++;
+
+    _status.outputs = _outputs;
+    _status.active_rules = _engine.getActiveRules();
+}
+
+void AlarmClass::update_loop()
+{
+    AlarmEvent event;
+    while (xQueueReceive(_events, &event, 0) == pdTRUE)
+    {
+        for (uint8_t i = 0; i < ALARM_MAX_RULES; i++)
+        {
+            if (!(event.changed & (1UL << i)))
+                continue;
+
+            bool active = event.active & (1UL << i);
+            String message = "alarm " + String(i) + (active ? " set" : " cleared") + " at " + String(event.value);
+
+            DataEvent changed("Alarm/changed", String(i) + "," + String(active ? 1 : 0) + "," + String(event.t_ms) + "," + String(event.value));
+            EventManager::instance().publish(changed);
+
+            DataEvent ev("Webservice/sendMessage", message);
+            EventManager::instance().publish(ev);
+
+            log_i("%s", message.c_str());
+        }
+    }
+}
+
+AlarmStatus AlarmClass::getStatus()
+{
+    // written by acquisition only, torn reads of single counters are harmless here
+    AlarmStatus status = _status;
+    status.eval_latency_us_mean = status.eval_samples ? _evalLatencySum / status.eval_samples : 0;
+    return status;
+}
+
+void AlarmClass::cmdAcknowledge()
+{
+    _ackRequested = true;
+}
+
+void AlarmClass::cmdResetStats()
+{
+    _resetRequested = true;
+}
+
+void AlarmClass::cbSaveConfiguration(void)
+{
+    xSemaphoreTake(_configLock, portMAX_DELAY);
+    alarm_config.saveConfiguration();
+    xSemaphoreGive(_configLock);
+}
+void AlarmClass::cbLoadConfiguration(void)
+{
+    xSemaphoreTake(_configLock, portMAX_DELAY);
+    alarm_config.loadConfiguration();
+    postConfigChange();
+    xSemaphoreGive(_configLock);
+}
+void AlarmClass::configFromWeb(JsonVariant alarm)
+{
+    xSemaphoreTake(_configLock, portMAX_DELAY);
+    alarm_config.fromWeb(alarm);
+    postConfigChange();
+    xSemaphoreGive(_configLock);
+}
+void AlarmClass::postConfigChange(void)
+{
+    log_i("postConfigChange triggered");
+
+    // recompiled by the acquisition task before the next sample, from a copy nobody writes
+    *_staged = alarm_config;
+    _configChanged = true;
+}
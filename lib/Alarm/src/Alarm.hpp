@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <DataEvent.hpp>
+#include <ConfigStructs.hpp>
+#include <AlarmEngine.hpp>
+
+#define ALARM_EVENT_QUEUE_SIZE 16
+
+using namespace esp32m;
+
+struct AlarmStatus
+{
+    uint8_t outputs = 0;
+    uint32_t active_rules = 0;
+    uint32_t edges = 0;
+
+    // data ready of the sample to GPIO written, only samples that changed an output
+    uint32_t edge_latency_us_max = 0;
+    uint32_t edge_latency_us_last = 0;
+    // data ready to evaluation done, every sample. upper bound for the edge latency
+    uint32_t eval_latency_us_max = 0;
+    float eval_latency_us_mean = 0;
+    uint32_t eval_samples = 0;
+    uint32_t deadline_misses = 0; // evaluation took longer than the sample period
+};
+
+/// Overload/threshold alarms driving GPIO outputs, see AlarmEngine.
+/// process() runs in the acquisition task right after conversion, so an output changes within
+/// the same sample. The input is the converted value ahead of glitch rejection and hum filter
+/// (LoadcellPipeline::getAlarmInput), a substitution or the filter cascade would delay it. Events are queued and published by Task_Alarm, never from acquisition.
+class AlarmClass
+{
+private:
+    struct AlarmEvent
+    {
+        uint32_t t_ms;
+        uint32_t changed;
+        uint32_t active;
+        float value;
+    };
+
+    AlarmEngine _engine;
+    QueueHandle_t _events = NULL;
+    uint8_t _eventsStorage[ALARM_EVENT_QUEUE_SIZE * sizeof(AlarmEvent)]; // static, see MemoryPlan
+    StaticQueue_t _eventsStruct;
+    int8_t _pins[ALARM_MAX_OUTPUTS] = {-1, -1, -1, -1};
+    bool _activeHigh = true;
+    uint8_t _outputs = 0;
+
+    // config as compiled, read only by the acquisition task. Commands change alarm_config under
+    // _configLock and stage a copy, process() swaps the pointers, as in LoadcellClass
+    AlarmConfig _configs[2] = {AlarmConfig("alarm.json"), AlarmConfig("alarm.json")};
+    AlarmConfig *_applied = &_configs[0];
+    AlarmConfig *_staged = &_configs[1];
+    SemaphoreHandle_t _configLock = NULL;
+    StaticSemaphore_t _configLockBuffer;
+
+    volatile bool _configChanged = false; // a staged copy waits
+    volatile bool _ackRequested = false;
+    volatile bool _resetRequested = false;
+
+    AlarmStatus _status;
+    double _evalLatencySum = 0;
+
+    void applyConfig();
+    void writeOutputs(uint8_t outputs);
+    // stages alarm_config for the acquisition task, with _configLock held
+    void postConfigChange(void);
+
+public:
+    // as loaded, saved and shown, the acquisition task works on its applied copy
+    AlarmConfig alarm_config = AlarmConfig("alarm.json");
+
+    AlarmClass();
+
+    void initialize();
+    void update_loop();
+
+    // called from acquisition for every converted sample
+    void process(float value, uint32_t timestamp_us, uint32_t period_us);
+
+    AlarmStatus getStatus();
+
+    // commands triggered externally, executed in the acquisition task
+    void cmdAcknowledge();
+    void cmdResetStats();
+
+    void cbSaveConfiguration(void);
+    void cbLoadConfiguration(void);
+    // update from a web request, recompiled before the next sample
+    void configFromWeb(JsonVariant alarm);
+};
+
+extern AlarmClass g_Alarm;
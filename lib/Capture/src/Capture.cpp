@@ -0,0 +1,416 @@
+#include <Capture.hpp>
+
+#include <Loadcell.hpp> // -->g_Loadcell
+#include <MemoryPlan.hpp> // -->g_MemoryPlan
+
+CaptureClass g_Capture;
+
+CaptureClass::CaptureClass()
+{
+    // on init construct with default variables
+}
+
+void CaptureClass::initialize()
+{
+    log_i("Capture init");
+
+    _buffer = xStreamBufferCreateStatic(CAPTURE_BUFFER_SIZE, sizeof(CaptureSample), _bufferStorage, &_bufferStruct);
+    g_MemoryPlan.registerStatic("capture buffer", sizeof(_bufferStorage));
+    g_MemoryPlan.registerStatic("capture encoder", sizeof(_block) + sizeof(_encoded));
+
+    // continue numbering after the highest existing capture file. CAPTURE_DIR is created by
+    // the storage task with the first capture
+    uint32_t captures = 0;
+    File dir = FFat.open(CAPTURE_DIR);
+    while (dir)
+    {
+        File entry = dir.openNextFile();
+        if (!entry)
+            break;
+
+        String name = entry.name();
+        name = name.substring(name.lastIndexOf('/') + 1);
+
+        unsigned int index = 0;
+        if (sscanf(name.c_str(), "cap_%u", &index) == 1)
+        {
+            captures++;
+            if (index >= _fileIndex)
+                _fileIndex = index + 1;
+        }
+
+        entry.close();
+    }
+    dir.close();
+
+    // captures not closed before a reset or files removed by hand: rebuild the catalogue
+    if (!checkCatalog(captures))
+        _rebuildRequested = true;
+
+    // commands
+    EventManager::instance().subscribe([&](Event *ev)
+                                       {
+            if (ev->is("Capture/start"))
+            {
+                log_d("Capture/start");
+
+                this->cmdStart();
+            } });
+
+    EventManager::instance().subscribe([&](Event *ev)
+                                       {
+            if (ev->is("Capture/stop"))
+            {
+                log_d("Capture/stop");
+
+                this->cmdStop();
+            } });
+
+    EventManager::instance().subscribe([&](Event *ev)
+                                       {
+            if (ev->is("Capture/rebuildCatalog"))
+            {
+                log_d("Capture/rebuildCatalog");
+
+                this->cmdRebuildCatalog();
+            } });
+}
+
+void CaptureClass::cmdStart()
+{
+    _startRequested = true;
+}
+void CaptureClass::cmdStop()
+{
+    _stopRequested = true;
+}
+void CaptureClass::cmdRebuildCatalog()
+{
+    _rebuildRequested = true;
+}
+
+bool CaptureClass::isActive()
+{
+    return _active;
+}
+String CaptureClass::getFilename()
+{
+    return _filename;
+}
+uint32_t CaptureClass::getSampleCount()
+{
+    return _sampleCount;
+}
+uint32_t CaptureClass::getOverruns()
+{
+    return _overruns;
+}
+uint32_t CaptureClass::getDataBytes()
+{
+    return _dataBytes;
+}
+uint32_t CaptureClass::getWriteErrors()
+{
+    return _writeErrors;
+}
+uint32_t CaptureClass::getCatalogRecords()
+{
+    return _catalogRecords;
+}
+uint32_t CaptureClass::getCatalogRebuildMs()
+{
+    return _catalogRebuildMs;
+}
+
+void CaptureClass::push(uint32_t timestamp_us, int32_t raw)
+{
+    if (!_active)
+        return;
+
+    CaptureSample sample = {timestamp_us, raw};
+    if (xStreamBufferSend(_buffer, &sample, sizeof(sample), 0) != sizeof(sample))
+        _overruns++;
+}
+
+// queued for the storage task. Task_Capture may wait for a free slot, the stream buffer keeps
+// the samples meanwhile
+bool CaptureClass::write(const char *path, StorageMode mode, const uint8_t *data, size_t length, uint32_t offset)
+{
+    if (g_Storage.submit(path, mode, data, length, offset, onWritten, this, CAPTURE_STORAGE_WAIT_MS))
+        return true;
+
+    _writeErrors++;
+    log_e("capture write failed, storage queue full");
+    return false;
+}
+
+// in the storage task
+void CaptureClass::onWritten(const StorageResult &result, void *context)
+{
+    if (result.ok)
+        return;
+
+    CaptureClass *capture = (CaptureClass *)context;
+    capture->_writeErrors++;
+    log_e("capture write of %s failed", result.path);
+    // records may be missing
+    if (strcmp(result.path, CATALOG_FILE) == 0)
+        capture->_rebuildRequested = true;
+}
+
+void CaptureClass::openFile()
+{
+    char name[32];
+    _currentIndex = _fileIndex++;
+    catalogFilename(name, sizeof(name), _currentIndex);
+    _filename = String(CAPTURE_DIR) + name;
+
+    CaptureHeader &header = _header;
+    header = CaptureHeader();
+    PipelineParams params = g_Loadcell.getPipelineParams();
+    header.start_millis = millis();
+    header.sample_rate = g_Loadcell.getSampleRate();
+    header.sensor_scale_factor = params.sensor_scale_factor;
+    header.sensor_zero_balance_raw = params.sensor_zero_balance_raw;
+    strlcpy(header.sensor_name, g_Loadcell.sensor_config.name.c_str(), sizeof(header.sensor_name));
+    strlcpy(header.sensor_serial, g_Loadcell.sensor_config.serial.c_str(), sizeof(header.sensor_serial));
+    strlcpy(header.displayunit, g_Loadcell.sensor_config.displayunit.c_str(), sizeof(header.displayunit));
+    header.encoding = CAPTURE_ENCODING;
+    // a new file, the index continues after the highest existing one
+    if (!write(_filename.c_str(), STORAGE_APPEND, (const uint8_t *)&header, sizeof(header)))
+    {
+        log_e("Failed to create capture file %s", _filename.c_str());
+        return;
+    }
+
+    _sampleCount = 0;
+    _overruns = 0;
+    _writeErrors = 0;
+    _blockCount = 0;
+    _blockIndex = 0;
+    _dataBytes = 0;
+    _summary.reset();
+    xStreamBufferReset(_buffer);
+    _active = true;
+
+    log_i("capture started: %s", _filename.c_str());
+}
+
+void CaptureClass::closeFile()
+{
+    _active = false;
+    drainBuffer();
+    if (_blockCount > 0)
+        writeBlock();
+
+    // patch sample count into header, then the storage task writes the staged tail and closes
+    write(_filename.c_str(), STORAGE_PATCH, (const uint8_t *)&_sampleCount, sizeof(_sampleCount), offsetof(CaptureHeader, sample_count));
+    write(_filename.c_str(), STORAGE_CLOSE, nullptr, 0);
+    uint32_t size = sizeof(CaptureHeader) + _dataBytes;
+
+    _header.sample_count = _sampleCount;
+    CatalogRecord record;
+    _summary.fill(record, _header, _currentIndex, size);
+    appendCatalog(record);
+
+    log_i("capture stopped: %s, %u samples, %u bytes, %u overruns", _filename.c_str(), _sampleCount, _dataBytes, _overruns);
+
+    DataEvent ev("Webservice/sendMessage", "capture finished: " + _filename);
+    EventManager::instance().publish(ev);
+}
+
+void CaptureClass::drainBuffer()
+{
+    uint8_t chunk[CAPTURE_WRITE_CHUNK];
+    size_t received;
+
+    while ((received = xStreamBufferReceive(_buffer, chunk, sizeof(chunk), 0)) > 0)
+    {
+        // the stream buffer only holds whole samples, trigger level is one sample
+        writeSamples((const CaptureSample *)chunk, received / sizeof(CaptureSample));
+        _summary.add((const CaptureSample *)chunk, received / sizeof(CaptureSample));
+        _sampleCount += received / sizeof(CaptureSample);
+    }
+}
+
+void CaptureClass::writeSamples(const CaptureSample *samples, size_t count)
+{
+    if (_header.encoding == CAPTURE_ENCODING_RAW)
+    {
+        size_t size = count * sizeof(CaptureSample);
+        write(_filename.c_str(), STORAGE_APPEND, (const uint8_t *)samples, size);
+        _dataBytes += size;
+        return;
+    }
+
+    while (count > 0)
+    {
+        size_t copy = min(count, (size_t)CAPTURE_BLOCK_SAMPLES - _blockCount);
+        memcpy(_block + _blockCount, samples, copy * sizeof(CaptureSample));
+        _blockCount += copy;
+        samples += copy;
+        count -= copy;
+
+        if (_blockCount == CAPTURE_BLOCK_SAMPLES)
+            writeBlock();
+    }
+}
+
+void CaptureClass::writeBlock()
+{
+    // the buffer holds the worst case, the whole block is consumed
+    CodecResult result = SampleCodec::encodeBlock(_block, _blockCount, _blockIndex, _encoded, sizeof(_encoded));
+    write(_filename.c_str(), STORAGE_APPEND, _encoded, result.bytes);
+
+    _dataBytes += result.bytes;
+    _blockIndex += _blockCount;
+    _blockCount = 0;
+}
+
+void CaptureClass::update_loop()
+{
+    if (_startRequested)
+    {
+        _startRequested = false;
+        if (!_active)
+            openFile();
+    }
+
+    if (_stopRequested)
+    {
+        _stopRequested = false;
+        if (_active)
+            closeFile();
+    }
+
+    if (_active)
+        drainBuffer();
+
+    if (_rebuildRequested && !_active)
+    {
+        _rebuildRequested = false;
+        rebuildCatalog();
+    }
+}
+
+// true if the index is intact and has one record per capture file
+bool CaptureClass::checkCatalog(uint32_t captures)
+{
+    File index = FFat.open(CATALOG_FILE, FILE_READ);
+    _catalogExists = (bool)index;
+    if (!index)
+        return captures == 0;
+
+    CatalogHeader header;
+    bool valid = index.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && catalogHeaderValid(header) &&
+                 (index.size() - sizeof(header)) % sizeof(CatalogRecord) == 0;
+    _catalogRecords = valid ? (index.size() - sizeof(header)) / sizeof(CatalogRecord) : 0;
+    index.close();
+
+    if (!valid)
+        log_w("capture catalogue invalid");
+    else if (_catalogRecords != captures)
+        log_w("capture catalogue has %u records for %u captures", _catalogRecords, captures);
+    return valid && _catalogRecords == captures;
+}
+
+void CaptureClass::appendCatalog(const CatalogRecord &record)
+{
+    if (!_catalogExists)
+    {
+        CatalogHeader header;
+        header.record_size = sizeof(CatalogRecord);
+        if (!write(CATALOG_FILE, STORAGE_APPEND, (const uint8_t *)&header, sizeof(header)))
+            return;
+        _catalogExists = true;
+    }
+    // counted when queued, a failed write requests a rebuild
+    if (write(CATALOG_FILE, STORAGE_APPEND, (const uint8_t *)&record, sizeof(record)))
+        _catalogRecords++;
+    write(CATALOG_FILE, STORAGE_CLOSE, nullptr, 0);
+}
+
+// all samples of a capture file after the header. For encoded captures up to the first damaged or
+// truncated block, e.g. the end of a capture that was not closed
+void CaptureClass::summarizeFile(File &file, const CaptureHeader &header, CatalogSummary &summary)
+{
+    file.seek(header.header_size);
+
+    if (captureEncoding(header) == CAPTURE_ENCODING_RAW)
+    {
+        CaptureSample samples[CAPTURE_WRITE_CHUNK / sizeof(CaptureSample)];
+        size_t received;
+        while ((received = file.read((uint8_t *)samples, sizeof(samples)) / sizeof(CaptureSample)) > 0)
+            summary.add(samples, received);
+        return;
+    }
+
+    // no capture is active, the encoder buffers are free
+    auto read = [&file](uint8_t *buffer, size_t length)
+    { return file.read(buffer, length); };
+    size_t decoded;
+    while ((decoded = SampleCodec::readBlock(read, _encoded, sizeof(_encoded), _block, CAPTURE_BLOCK_SAMPLES)) > 0)
+        summary.add(_block, decoded);
+}
+
+// reads the header and all samples of every capture file into a new index, then replaces the old
+// one: a replace with the header, the records appended. A reset in between leaves fewer records
+// than captures, which checkCatalog finds on the next start
+void CaptureClass::rebuildCatalog()
+{
+    uint32_t start_ms = millis();
+
+    // the rebuild reads the captures, after the queued capture and catalogue writes
+    if (!g_Storage.waitIdle(CAPTURE_STORAGE_WAIT_MS * 10))
+    {
+        log_w("capture catalogue rebuild deferred, storage busy");
+        _rebuildRequested = true;
+        return;
+    }
+
+    CatalogHeader catalogHeader;
+    catalogHeader.record_size = sizeof(CatalogRecord);
+    if (!write(CATALOG_FILE, STORAGE_REPLACE, (const uint8_t *)&catalogHeader, sizeof(catalogHeader)))
+    {
+        log_e("Failed to create capture catalogue");
+        _rebuildRequested = true;
+        return;
+    }
+
+    uint32_t records = 0;
+    File dir = FFat.open(CAPTURE_DIR);
+    while (dir)
+    {
+        File entry = dir.openNextFile();
+        if (!entry)
+            break;
+
+        String name = entry.name();
+        name = name.substring(name.lastIndexOf('/') + 1);
+
+        unsigned int file_index = 0;
+        CaptureHeader header;
+        if (sscanf(name.c_str(), "cap_%u", &file_index) == 1 &&
+            entry.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == CAPTURE_MAGIC)
+        {
+            // a capture that was not closed has sample count 0, all whole samples in the file count
+            CatalogSummary summary;
+            summarizeFile(entry, header, summary);
+
+            // consecutive records merge in the queue while they wait
+            CatalogRecord record;
+            summary.fill(record, header, file_index, entry.size());
+            if (write(CATALOG_FILE, STORAGE_APPEND, (const uint8_t *)&record, sizeof(record)))
+                records++;
+        }
+        entry.close();
+    }
+    dir.close();
+    write(CATALOG_FILE, STORAGE_CLOSE, nullptr, 0);
+
+    // counted when queued, a failed write requests another rebuild
+    _catalogRecords = records;
+    _catalogExists = true;
+    _catalogRebuildMs = millis() - start_ms;
+    log_i("capture catalogue rebuilt: %u records in %u ms", records, _catalogRebuildMs);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FFat.h>
+#include <freertos/stream_buffer.h>
+#include <DataEvent.hpp>
+#include <CaptureFormat.hpp>
+#include <CaptureCatalog.hpp>
+#include <SampleCodec.hpp>
+#include <Storage.hpp>
+
+#define CAPTURE_BUFFER_SIZE 4096
+#define CAPTURE_WRITE_CHUNK 512
+#define CAPTURE_BLOCK_SAMPLES 128 // samples per SampleCodec block
+#define CAPTURE_STORAGE_WAIT_MS 200 // longest wait for a storage queue slot, the buffer holds more
+
+// encoding of new captures, CAPTURE_ENCODING_RAW for the plain sample layout
+#ifndef CAPTURE_ENCODING
+#define CAPTURE_ENCODING CAPTURE_ENCODING_DELTA_RICE
+#endif
+
+using namespace esp32m;
+
+/// Records raw samples to FFat. Loadcell pushes samples into a stream buffer without blocking,
+/// Task_Capture drains the buffer and queues the file data for the storage task (Storage),
+/// including the catalogue index of the captures, see CaptureCatalog. Samples are compressed
+/// in blocks of CAPTURE_BLOCK_SAMPLES on the way to the file (SampleCodec), a block not yet
+/// written, queued or staged by the storage task is lost on a reset.
+class CaptureClass
+{
+private:
+    StreamBufferHandle_t _buffer = NULL;
+    uint8_t _bufferStorage[CAPTURE_BUFFER_SIZE + 1]; // static, see MemoryPlan
+    StaticStreamBuffer_t _bufferStruct;
+    String _filename;
+    uint32_t _fileIndex = 0;
+    uint32_t _currentIndex = 0;
+    CaptureHeader _header;
+
+    // encoding
+    CaptureSample _block[CAPTURE_BLOCK_SAMPLES];
+    size_t _blockCount = 0;
+    uint32_t _blockIndex = 0; // sample index of _block[0] in the capture
+    uint8_t _encoded[CODEC_MAX_BLOCK_SIZE(CAPTURE_BLOCK_SAMPLES)];
+    uint32_t _dataBytes = 0;
+    volatile uint32_t _writeErrors = 0;
+
+    volatile bool _active = false;
+    volatile bool _startRequested = false;
+    volatile bool _stopRequested = false;
+
+    uint32_t _sampleCount = 0;
+    uint32_t _overruns = 0;
+
+    // catalogue
+    CatalogSummary _summary;
+    volatile bool _rebuildRequested = false;
+    uint32_t _catalogRecords = 0;
+    bool _catalogExists = false;
+    uint32_t _catalogRebuildMs = 0;
+
+    bool write(const char *path, StorageMode mode, const uint8_t *data, size_t length, uint32_t offset = 0);
+    static void onWritten(const StorageResult &result, void *context);
+    void openFile();
+    void closeFile();
+    void drainBuffer();
+    void writeSamples(const CaptureSample *samples, size_t count);
+    void writeBlock();
+    void summarizeFile(File &file, const CaptureHeader &header, CatalogSummary &summary);
+    bool checkCatalog(uint32_t captures);
+    void appendCatalog(const CatalogRecord &record);
+    void rebuildCatalog();
+
+public:
+    CaptureClass();
+
+    void initialize();
+    void update_loop();
+
+    // called from acquisition, never blocks
+    void push(uint32_t timestamp_us, int32_t raw);
+
+    bool isActive();
+    String getFilename();
+    uint32_t getSampleCount();
+    uint32_t getOverruns();
+    // sample data written to the current or last capture, without header
+    uint32_t getDataBytes();
+    // requests not queued or failed in the storage task
+    uint32_t getWriteErrors();
+    uint32_t getCatalogRecords();
+    uint32_t getCatalogRebuildMs();
+
+    // commands triggered externally, executed async in update_loop
+    void cmdStart();
+    void cmdStop();
+    // reads every capture file, deferred until no capture is active
+    void cmdRebuildCatalog();
+};
+
+extern CaptureClass g_Capture;
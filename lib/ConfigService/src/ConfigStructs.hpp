@@ -1,12 +1,27 @@
 #pragma once
 
-#define CONFIG_DIR "/config/"
-#define MAX_DOCUMENT_SIZE 1024
+#define CONFIG_DIR_PATH "/config"
+#define CONFIG_DIR CONFIG_DIR_PATH "/"
+#define MAX_DOCUMENT_SIZE 2048
 
 #include <Arduino.h>
 #include <FFat.h>
 #include <ArduinoJson.h>
 #include "Adafruit_NAU7802.h"
+#include <AlarmEngine.hpp>
+#include <JsonPool.hpp>
+#include <Storage.hpp>
+
+// groups of settings by what a change has to reinitialize, combined as bit mask.
+// see LoadcellClass::postConfigChange
+enum ConfigChange : uint8_t
+{
+    CONFIG_CHANGE_NONE = 0,
+    CONFIG_CHANGE_PRESENTATION = 1, // name, unit, digits: nothing to reapply
+    CONFIG_CHANGE_SCALE = 2,        // conversion, compensation: new pipeline params, filter restarts
+    CONFIG_CHANGE_ADC = 4,          // adc registers: reprogram between samples, flush and calibrate
+    CONFIG_CHANGE_ALL = 7,
+};
 
 struct BaseConfig
 {
@@ -20,64 +35,78 @@ public:
     }
 
 public:
-    virtual void toDoc(DynamicJsonDocument &doc) const {};
-    virtual void fromDoc(DynamicJsonDocument const &doc){};
+    virtual void toDoc(JsonDocument &doc) const {};
+    virtual void fromDoc(JsonDocument const &doc){};
     virtual void fromWeb(JsonVariant variant){};
 
-    // Loads the configuration from a file
+    // Loads the configuration from a file, or from a save that is still queued for writing
     void loadConfiguration()
     {
+        String path = String(CONFIG_DIR) + this->_filename;
         log_d("reading config file");
-        log_d("%s", (String(CONFIG_DIR) + this->_filename).c_str());
-
-        // Open file for reading
-        File file = FFat.open(String(CONFIG_DIR) + this->_filename, FILE_READ);
+        log_d("%s", path.c_str());
 
         // Allocate a temporary JsonDocument
         // Don't forget to change the capacity to match your requirements.
         // Use arduinojson.org/v6/assistant to compute the capacity.
-        DynamicJsonDocument doc(MAX_DOCUMENT_SIZE);
+        PooledJsonDocument doc(MAX_DOCUMENT_SIZE);
+        DeserializationError error;
+
+        auto read = [&doc, &error](const uint8_t *data, size_t length)
+        { error = deserializeJson(doc, (const char *)data, length); };
+        if (!g_Storage.readLatest(path.c_str(), read))
+        {
+            // a reset between remove and rename of a save leaves the new content in the .tmp file
+            if (!FFat.exists(path) && FFat.exists(path + ".tmp"))
+                path += ".tmp";
 
-        // Deserialize the JSON document
-        DeserializationError error = deserializeJson(doc, file);
+            // Open file for reading
+            File file = FFat.open(path, FILE_READ);
+
+            // Deserialize the JSON document
+            error = deserializeJson(doc, file);
+
+            // Close the file (Curiously, File's destructor doesn't close the file)
+            file.close();
+        }
         if (error)
             log_e("Deserialization failed, using default configuration");
 
         this->fromDoc(doc);
 
-        // Close the file (Curiously, File's destructor doesn't close the file)
-        file.close();
-
         // save defaults for next time loading.
         // if (error)
         //     this->saveConfiguration();
     }
 
-    // Saves the configuration to a file
+    // Saves the configuration to a file. Serialized into the storage queue and written by the
+    // storage task, returns without waiting for the flash
     void saveConfiguration()
     {
+        String path = String(CONFIG_DIR) + this->_filename;
         log_d("writing config file");
-        log_d("%s", (String(CONFIG_DIR) + this->_filename).c_str());
-
-        // Delete existing file, otherwise the configuration is appended to the file
-        FFat.remove(String(CONFIG_DIR) + this->_filename);
+        log_d("%s", path.c_str());
 
-        // Open file for writing
-        File file = FFat.open(String(CONFIG_DIR) + this->_filename, FILE_WRITE, true);
-        if (!file)
-        {
-            log_e("Failed to create file");
-            return;
-        }
-        DynamicJsonDocument doc(MAX_DOCUMENT_SIZE);
+        PooledJsonDocument doc(MAX_DOCUMENT_SIZE);
         this->toDoc(doc);
 
-        // Serialize JSON to file
-        if (serializeJson(doc, file) == 0)
-            log_e("Failed to write to file");
+        auto fill = [&doc](uint8_t *buffer, size_t capacity) -> size_t
+        {
+            // serializeJson truncates, a config that does not fit is not written at all
+            size_t length = measureJson(doc);
+            return length < capacity ? serializeJson(doc, (char *)buffer, capacity) : 0;
+        };
+        if (!g_Storage.replace(path.c_str(), fill, onSaved))
+            log_e("Failed to queue config file %s", path.c_str());
+    }
 
-        // Close the file
-        file.close();
+    // in the storage task
+    static void onSaved(const StorageResult &result, void *context)
+    {
+        if (!result.ok)
+            log_e("Failed to write config file %s", result.path);
+        else
+            log_d("config file %s written, %u us after save", result.path, result.latency_us);
     }
 };
 
@@ -93,28 +122,34 @@ public:
     bool wifi_ap_mode = true; // if true: AP mode, otherwise STA mode
     String wifi_ap_ssid = "sg-box-spot";
     String wifi_ap_password = "12345678";
+    String wifi_sta_ssid = "";
+    String wifi_sta_password = "";
 
     String serial = "";
 
     // create doc from data
-    void toDoc(DynamicJsonDocument &doc) const
+    void toDoc(JsonDocument &doc) const
     {
         // Set the values in the document
         doc["hostname"] = hostname;
         doc["wifi_ap_mode"] = wifi_ap_mode;
         doc["wifi_ap_ssid"] = wifi_ap_ssid;
         doc["wifi_ap_password"] = wifi_ap_password;
+        doc["wifi_sta_ssid"] = wifi_sta_ssid;
+        doc["wifi_sta_password"] = wifi_sta_password;
         doc["serial"] = serial;
     };
 
     // set data according to doc
-    void fromDoc(DynamicJsonDocument const &doc)
+    void fromDoc(JsonDocument const &doc)
     {
         // Copy values from the JsonDocument to the Config
         hostname = doc["hostname"] | hostname;
         wifi_ap_mode = doc["wifi_ap_mode"] | wifi_ap_mode;
         wifi_ap_ssid = doc["wifi_ap_ssid"] | wifi_ap_ssid;
         wifi_ap_password = doc["wifi_ap_password"] | wifi_ap_password;
+        wifi_sta_ssid = doc["wifi_sta_ssid"] | wifi_sta_ssid;
+        wifi_sta_password = doc["wifi_sta_password"] | wifi_sta_password;
         serial = doc["serial"] | serial;
     };
     // set data according to doc
@@ -129,6 +164,10 @@ public:
             wifi_ap_ssid = variant["wifi_ap_ssid"].as<String>();
         if (!variant["wifi_ap_password"].isNull())
             wifi_ap_password = variant["wifi_ap_password"].as<String>();
+        if (!variant["wifi_sta_ssid"].isNull())
+            wifi_sta_ssid = variant["wifi_sta_ssid"].as<String>();
+        if (!variant["wifi_sta_password"].isNull())
+            wifi_sta_password = variant["wifi_sta_password"].as<String>();
         if (!variant["serial"].isNull())
             serial = variant["serial"].as<String>();
     };
@@ -146,9 +185,23 @@ public:
     float zerobalance = 0.0;
     String displayunit = "mV/V";
     uint8_t digits = 4;
+    float temp_zero_coeff = 0.0; // displayunit per degC, learned by tempLearn
+    float temp_span_coeff = 0.0; // relative per degC
+    float temp_reference = 25.0; // degC
+    uint8_t hum_filter = 0;      // 0: off, 1: notch at mains frequency, 2: comb, notch at harmonics too
+    float hum_mains_hz = 50.0;
+    float hum_q = 2.0;           // notch quality, lower is wider
+    uint8_t hum_harmonics = 5;   // comb: harmonics 1..n, aliased ones included
+    uint8_t glitch_filter = 1;   // 0: off, 1: reject read errors, rail codes, steps and outliers
+    float glitch_k = 5.0;        // Hampel threshold in robust standard deviations
+    float glitch_floor = 0.01;   // Hampel threshold floor, share of fullrange
+    float glitch_max_step = 0.5; // largest change between two samples, share of fullrange, 0: off
+    uint8_t rate_window = 9;     // samples of the dF/dt slope, see DerivedParams
+    uint8_t display_channel = 0; // DerivedChannel: 0 force, 1 rate, 2 impulse, 3 work
+    uint8_t stream_channel = 0;  // DerivedChannel published by mqtt and the sample events
 
     // create doc from data
-    void toDoc(DynamicJsonDocument &doc) const
+    void toDoc(JsonDocument &doc) const
     {
         // Set the values in the document
         doc["name"] = name;
@@ -158,10 +211,24 @@ public:
         doc["zerobalance"] = zerobalance;
         doc["displayunit"] = displayunit;
         doc["digits"] = digits;
+        doc["temp_zero_coeff"] = temp_zero_coeff;
+        doc["temp_span_coeff"] = temp_span_coeff;
+        doc["temp_reference"] = temp_reference;
+        doc["hum_filter"] = hum_filter;
+        doc["hum_mains_hz"] = hum_mains_hz;
+        doc["hum_q"] = hum_q;
+        doc["hum_harmonics"] = hum_harmonics;
+        doc["glitch_filter"] = glitch_filter;
+        doc["glitch_k"] = glitch_k;
+        doc["glitch_floor"] = glitch_floor;
+        doc["glitch_max_step"] = glitch_max_step;
+        doc["rate_window"] = rate_window;
+        doc["display_channel"] = display_channel;
+        doc["stream_channel"] = stream_channel;
     };
 
     // set data according to doc
-    void fromDoc(DynamicJsonDocument const &doc)
+    void fromDoc(JsonDocument const &doc)
     {
         // Copy values from the JsonDocument to the Config
         name = doc["name"] | name;
@@ -171,6 +238,20 @@ public:
         zerobalance = doc["zerobalance"] | zerobalance;
         displayunit = doc["displayunit"] | displayunit;
         digits = doc["digits"] | digits;
+        temp_zero_coeff = doc["temp_zero_coeff"] | temp_zero_coeff;
+        temp_span_coeff = doc["temp_span_coeff"] | temp_span_coeff;
+        temp_reference = doc["temp_reference"] | temp_reference;
+        hum_filter = doc["hum_filter"] | hum_filter;
+        hum_mains_hz = doc["hum_mains_hz"] | hum_mains_hz;
+        hum_q = doc["hum_q"] | hum_q;
+        hum_harmonics = doc["hum_harmonics"] | hum_harmonics;
+        glitch_filter = doc["glitch_filter"] | glitch_filter;
+        glitch_k = doc["glitch_k"] | glitch_k;
+        glitch_floor = doc["glitch_floor"] | glitch_floor;
+        glitch_max_step = doc["glitch_max_step"] | glitch_max_step;
+        rate_window = doc["rate_window"] | rate_window;
+        display_channel = doc["display_channel"] | display_channel;
+        stream_channel = doc["stream_channel"] | stream_channel;
     };
 
     // set data according to doc
@@ -191,40 +272,131 @@ public:
             displayunit = variant["displayunit"].as<String>();
         if (!variant["digits"].isNull())
             digits = variant["digits"].as<uint8_t>();
+        if (!variant["temp_zero_coeff"].isNull())
+            temp_zero_coeff = variant["temp_zero_coeff"].as<float>();
+        if (!variant["temp_span_coeff"].isNull())
+            temp_span_coeff = variant["temp_span_coeff"].as<float>();
+        if (!variant["temp_reference"].isNull())
+            temp_reference = variant["temp_reference"].as<float>();
+        if (!variant["hum_filter"].isNull())
+            hum_filter = variant["hum_filter"].as<uint8_t>();
+        if (!variant["hum_mains_hz"].isNull())
+            hum_mains_hz = variant["hum_mains_hz"].as<float>();
+        if (!variant["hum_q"].isNull())
+            hum_q = variant["hum_q"].as<float>();
+        if (!variant["hum_harmonics"].isNull())
+            hum_harmonics = variant["hum_harmonics"].as<uint8_t>();
+        if (!variant["glitch_filter"].isNull())
+            glitch_filter = variant["glitch_filter"].as<uint8_t>();
+        if (!variant["glitch_k"].isNull())
+            glitch_k = variant["glitch_k"].as<float>();
+        if (!variant["glitch_floor"].isNull())
+            glitch_floor = variant["glitch_floor"].as<float>();
+        if (!variant["glitch_max_step"].isNull())
+            glitch_max_step = variant["glitch_max_step"].as<float>();
+        if (!variant["rate_window"].isNull())
+            rate_window = variant["rate_window"].as<uint8_t>();
+        if (!variant["display_channel"].isNull())
+            display_channel = variant["display_channel"].as<uint8_t>();
+        if (!variant["stream_channel"].isNull())
+            stream_channel = variant["stream_channel"].as<uint8_t>();
+    };
+
+    // ConfigChange groups that differ from previous
+    uint8_t changesFrom(const SensorConfig &previous) const
+    {
+        uint8_t changes = CONFIG_CHANGE_NONE;
+        if (name != previous.name || serial != previous.serial || displayunit != previous.displayunit || digits != previous.digits ||
+            display_channel != previous.display_channel || stream_channel != previous.stream_channel)
+            changes |= CONFIG_CHANGE_PRESENTATION;
+        if (fullrange != previous.fullrange || sensitivity != previous.sensitivity || zerobalance != previous.zerobalance ||
+            temp_zero_coeff != previous.temp_zero_coeff || temp_span_coeff != previous.temp_span_coeff || temp_reference != previous.temp_reference ||
+            hum_filter != previous.hum_filter || hum_mains_hz != previous.hum_mains_hz || hum_q != previous.hum_q || hum_harmonics != previous.hum_harmonics ||
+            rate_window != previous.rate_window || glitch_filter != previous.glitch_filter || glitch_k != previous.glitch_k ||
+            glitch_floor != previous.glitch_floor || glitch_max_step != previous.glitch_max_step)
+            changes |= CONFIG_CHANGE_SCALE;
+        return changes;
     };
 };
 
-struct AdcConfig : BaseConfig
+// settings shared by all adc backends, the backend configs add their own chip settings.
+// gain is the log2 of the amplification for every backend, see PipelineParams::calcScaleFactor
+struct AdcBaseConfig : BaseConfig
 {
     using BaseConfig::BaseConfig; // Inherit BaseConfig's constructors.
+public:
+    // data
+    float cali_offset = 0.0;
+    float cali_gain_factor = 1.0;
+    uint16_t temp_interval_samples = 0; // temperature conversion every n load samples, 0: off
+    uint8_t temp_settle_samples = 2;    // discarded after each input switch
+
+protected:
+    void commonToDoc(JsonDocument &doc) const
+    {
+        doc["cali_offset"] = cali_offset;
+        doc["cali_gain_factor"] = cali_gain_factor;
+        doc["temp_interval_samples"] = temp_interval_samples;
+        doc["temp_settle_samples"] = temp_settle_samples;
+    };
+
+    void commonFromDoc(JsonDocument const &doc)
+    {
+        cali_offset = doc["cali_offset"] | cali_offset;
+        cali_gain_factor = doc["cali_gain_factor"] | cali_gain_factor;
+        temp_interval_samples = doc["temp_interval_samples"] | temp_interval_samples;
+        temp_settle_samples = doc["temp_settle_samples"] | temp_settle_samples;
+    };
+
+    void commonFromWeb(JsonVariant variant)
+    {
+        if (!variant["cali_offset"].isNull())
+            cali_offset = variant["cali_offset"].as<float>();
+        if (!variant["cali_gain_factor"].isNull())
+            cali_gain_factor = variant["cali_gain_factor"].as<float>();
+        if (!variant["temp_interval_samples"].isNull())
+            temp_interval_samples = variant["temp_interval_samples"].as<uint16_t>();
+        if (!variant["temp_settle_samples"].isNull())
+            temp_settle_samples = variant["temp_settle_samples"].as<uint8_t>();
+    };
+
+    // calibration and temperature schedule are applied in the pipeline, the adc keeps running
+    uint8_t commonChangesFrom(const AdcBaseConfig &previous) const
+    {
+        if (cali_offset != previous.cali_offset || cali_gain_factor != previous.cali_gain_factor ||
+            temp_interval_samples != previous.temp_interval_samples || temp_settle_samples != previous.temp_settle_samples)
+            return CONFIG_CHANGE_SCALE;
+        return CONFIG_CHANGE_NONE;
+    };
+};
+
+struct Nau7802Config : AdcBaseConfig
+{
+    using AdcBaseConfig::AdcBaseConfig; // Inherit AdcBaseConfig's constructors.
 public:
     // data
     NAU7802_LDOVoltage ldovoltage = NAU7802_3V0;
     NAU7802_Gain gain = NAU7802_GAIN_128;
     NAU7802_SampleRate samplerate = NAU7802_RATE_10SPS;
-    float cali_offset = 0.0;
-    float cali_gain_factor = 1.0;
 
     // create doc from data
-    void toDoc(DynamicJsonDocument &doc) const
+    void toDoc(JsonDocument &doc) const
     {
         // Set the values in the document
         doc["ldovoltage"] = ldovoltage;
         doc["gain"] = gain;
         doc["samplerate"] = samplerate;
-        doc["cali_offset"] = cali_offset;
-        doc["cali_gain_factor"] = cali_gain_factor;
+        commonToDoc(doc);
     };
 
     // set data according to doc
-    void fromDoc(DynamicJsonDocument const &doc)
+    void fromDoc(JsonDocument const &doc)
     {
         // Copy values from the JsonDocument to the Config
         ldovoltage = doc["ldovoltage"] | ldovoltage;
         gain = doc["gain"] | gain;
         samplerate = doc["samplerate"] | samplerate;
-        cali_offset = doc["cali_offset"] | cali_offset;
-        cali_gain_factor = doc["cali_gain_factor"] | cali_gain_factor;
+        commonFromDoc(doc);
     };
 
     // set data according to doc
@@ -237,9 +409,372 @@ public:
             gain = variant["gain"].as<NAU7802_Gain>();
         if (!variant["samplerate"].isNull())
             samplerate = variant["samplerate"].as<NAU7802_SampleRate>();
-        if (!variant["cali_offset"].isNull())
-            cali_offset = variant["cali_offset"].as<float>();
-        if (!variant["cali_gain_factor"].isNull())
-            cali_gain_factor = variant["cali_gain_factor"].as<float>();
+        commonFromWeb(variant);
+    };
+
+    // ConfigChange groups that differ from previous, gain also changes the scale factor
+    uint8_t changesFrom(const Nau7802Config &previous) const
+    {
+        uint8_t changes = commonChangesFrom(previous);
+        if (ldovoltage != previous.ldovoltage || gain != previous.gain || samplerate != previous.samplerate)
+            changes |= CONFIG_CHANGE_ADC | CONFIG_CHANGE_SCALE;
+        return changes;
+    };
+};
+
+// ADS1220 register values, gain enum is log2 of the PGA gain like NAU7802_Gain
+enum Ads1220Gain
+{
+    ADS1220_GAIN_1,
+    ADS1220_GAIN_2,
+    ADS1220_GAIN_4,
+    ADS1220_GAIN_8,
+    ADS1220_GAIN_16,
+    ADS1220_GAIN_32,
+    ADS1220_GAIN_64,
+    ADS1220_GAIN_128,
+};
+
+// data rate in turbo mode, normal mode runs at about half the rate with lower noise
+enum Ads1220SampleRate
+{
+    ADS1220_RATE_40SPS,
+    ADS1220_RATE_90SPS,
+    ADS1220_RATE_180SPS,
+    ADS1220_RATE_350SPS,
+    ADS1220_RATE_660SPS,
+    ADS1220_RATE_1200SPS,
+    ADS1220_RATE_2000SPS,
+};
+
+enum Ads1220Reference
+{
+    ADS1220_VREF_INTERNAL, // 2.048 V, not ratiometric: calibrate with cali_gain_factor
+    ADS1220_VREF_REF0,     // REFP0/REFN0, bridge excitation sensed at the sensor
+    ADS1220_VREF_REF1,     // REFP1/REFN1
+    ADS1220_VREF_AVDD,     // analog supply, bridge excited from AVDD
+};
+
+struct Ads1220Config : AdcBaseConfig
+{
+    using AdcBaseConfig::AdcBaseConfig; // Inherit AdcBaseConfig's constructors.
+public:
+    // data
+    Ads1220Gain gain = ADS1220_GAIN_128;
+    Ads1220SampleRate samplerate = ADS1220_RATE_2000SPS;
+    Ads1220Reference reference = ADS1220_VREF_AVDD;
+    bool turbo = true;         // false: normal mode, half the listed rates
+    uint8_t mux = 0;           // input multiplexer, 0: AIN0/AIN1
+    bool low_side_switch = false; // close PSW during conversions to switch the bridge excitation
+    int8_t cs_pin = 10;
+    int8_t drdy_pin = 9;
+
+    // create doc from data
+    void toDoc(JsonDocument &doc) const
+    {
+        // Set the values in the document
+        doc["gain"] = gain;
+        doc["samplerate"] = samplerate;
+        doc["reference"] = reference;
+        doc["turbo"] = turbo;
+        doc["mux"] = mux;
+        doc["low_side_switch"] = low_side_switch;
+        doc["cs_pin"] = cs_pin;
+        doc["drdy_pin"] = drdy_pin;
+        commonToDoc(doc);
+    };
+
+    // set data according to doc
+    void fromDoc(JsonDocument const &doc)
+    {
+        // Copy values from the JsonDocument to the Config
+        gain = doc["gain"] | gain;
+        samplerate = doc["samplerate"] | samplerate;
+        reference = doc["reference"] | reference;
+        turbo = doc["turbo"] | turbo;
+        mux = doc["mux"] | mux;
+        low_side_switch = doc["low_side_switch"] | low_side_switch;
+        cs_pin = doc["cs_pin"] | cs_pin;
+        drdy_pin = doc["drdy_pin"] | drdy_pin;
+        commonFromDoc(doc);
+    };
+
+    // set data according to doc
+    void fromWeb(JsonVariant variant)
+    {
+        // Copy values from the variant to the Config
+        if (!variant["gain"].isNull())
+            gain = variant["gain"].as<Ads1220Gain>();
+        if (!variant["samplerate"].isNull())
+            samplerate = variant["samplerate"].as<Ads1220SampleRate>();
+        if (!variant["reference"].isNull())
+            reference = variant["reference"].as<Ads1220Reference>();
+        if (!variant["turbo"].isNull())
+            turbo = variant["turbo"].as<bool>();
+        if (!variant["mux"].isNull())
+            mux = variant["mux"].as<uint8_t>();
+        if (!variant["low_side_switch"].isNull())
+            low_side_switch = variant["low_side_switch"].as<bool>();
+        if (!variant["cs_pin"].isNull())
+            cs_pin = variant["cs_pin"].as<int8_t>();
+        if (!variant["drdy_pin"].isNull())
+            drdy_pin = variant["drdy_pin"].as<int8_t>();
+        commonFromWeb(variant);
+    };
+
+    // ConfigChange groups that differ from previous, gain also changes the scale factor
+    uint8_t changesFrom(const Ads1220Config &previous) const
+    {
+        uint8_t changes = commonChangesFrom(previous);
+        if (gain != previous.gain || samplerate != previous.samplerate || reference != previous.reference || turbo != previous.turbo ||
+            mux != previous.mux || low_side_switch != previous.low_side_switch || cs_pin != previous.cs_pin || drdy_pin != previous.drdy_pin)
+            changes |= CONFIG_CHANGE_ADC | CONFIG_CHANGE_SCALE;
+        return changes;
+    };
+};
+
+// HX711 channel and gain are selected together, values are log2 of the gain
+enum Hx711Gain
+{
+    HX711_GAIN_32 = 5,  // channel B
+    HX711_GAIN_64 = 6,  // channel A
+    HX711_GAIN_128 = 7, // channel A
+};
+
+// set by the RATE pin, either wired on the board or driven through rate_pin
+enum Hx711SampleRate
+{
+    HX711_RATE_10SPS,
+    HX711_RATE_80SPS,
+};
+
+struct Hx711Config : AdcBaseConfig
+{
+    using AdcBaseConfig::AdcBaseConfig; // Inherit AdcBaseConfig's constructors.
+public:
+    // data
+    Hx711Gain gain = HX711_GAIN_128;
+    Hx711SampleRate samplerate = HX711_RATE_80SPS;
+    int8_t dout_pin = 5;
+    int8_t sck_pin = 6;
+    int8_t rate_pin = -1; // -1: RATE hardwired, samplerate must match the board
+
+    // create doc from data
+    void toDoc(JsonDocument &doc) const
+    {
+        // Set the values in the document
+        doc["gain"] = gain;
+        doc["samplerate"] = samplerate;
+        doc["dout_pin"] = dout_pin;
+        doc["sck_pin"] = sck_pin;
+        doc["rate_pin"] = rate_pin;
+        commonToDoc(doc);
+    };
+
+    // set data according to doc
+    void fromDoc(JsonDocument const &doc)
+    {
+        // Copy values from the JsonDocument to the Config
+        gain = doc["gain"] | gain;
+        samplerate = doc["samplerate"] | samplerate;
+        dout_pin = doc["dout_pin"] | dout_pin;
+        sck_pin = doc["sck_pin"] | sck_pin;
+        rate_pin = doc["rate_pin"] | rate_pin;
+        commonFromDoc(doc);
+    };
+
+    // set data according to doc
+    void fromWeb(JsonVariant variant)
+    {
+        // Copy values from the variant to the Config
+        if (!variant["gain"].isNull())
+            gain = variant["gain"].as<Hx711Gain>();
+        if (!variant["samplerate"].isNull())
+            samplerate = variant["samplerate"].as<Hx711SampleRate>();
+        if (!variant["dout_pin"].isNull())
+            dout_pin = variant["dout_pin"].as<int8_t>();
+        if (!variant["sck_pin"].isNull())
+            sck_pin = variant["sck_pin"].as<int8_t>();
+        if (!variant["rate_pin"].isNull())
+            rate_pin = variant["rate_pin"].as<int8_t>();
+        commonFromWeb(variant);
+    };
+
+    // ConfigChange groups that differ from previous, gain also changes the scale factor
+    uint8_t changesFrom(const Hx711Config &previous) const
+    {
+        uint8_t changes = commonChangesFrom(previous);
+        if (gain != previous.gain || samplerate != previous.samplerate || dout_pin != previous.dout_pin ||
+            sck_pin != previous.sck_pin || rate_pin != previous.rate_pin)
+            changes |= CONFIG_CHANGE_ADC | CONFIG_CHANGE_SCALE;
+        return changes;
+    };
+};
+
+struct MqttConfig : BaseConfig
+{
+    using BaseConfig::BaseConfig; // Inherit BaseConfig's constructors.
+public:
+    // data
+    bool enabled = false;
+    String broker = "";
+    uint16_t port = 1883;
+    String username = "";
+    String password = "";
+    String topic_prefix = "sgbox";   // topics: <prefix>/<hostname>/samples|stats|status
+    uint8_t mode = 0;                // 0: every sample, 1: min/max/mean per stats_interval_ms
+    uint16_t batch_records = 64;     // records per message
+    uint16_t stats_interval_ms = 1000;
+    uint8_t max_inflight = 4;        // unacknowledged QoS 1 messages
+    uint16_t drain_rate = 10;        // messages/s sent from the offline spool after reconnect
+
+    // create doc from data
+    void toDoc(JsonDocument &doc) const
+    {
+        // Set the values in the document
+        doc["enabled"] = enabled;
+        doc["broker"] = broker;
+        doc["port"] = port;
+        doc["username"] = username;
+        doc["password"] = password;
+        doc["topic_prefix"] = topic_prefix;
+        doc["mode"] = mode;
+        doc["batch_records"] = batch_records;
+        doc["stats_interval_ms"] = stats_interval_ms;
+        doc["max_inflight"] = max_inflight;
+        doc["drain_rate"] = drain_rate;
+    };
+
+    // set data according to doc
+    void fromDoc(JsonDocument const &doc)
+    {
+        // Copy values from the JsonDocument to the Config
+        enabled = doc["enabled"] | enabled;
+        broker = doc["broker"] | broker;
+        port = doc["port"] | port;
+        username = doc["username"] | username;
+        password = doc["password"] | password;
+        topic_prefix = doc["topic_prefix"] | topic_prefix;
+        mode = doc["mode"] | mode;
+        batch_records = doc["batch_records"] | batch_records;
+        stats_interval_ms = doc["stats_interval_ms"] | stats_interval_ms;
+        max_inflight = doc["max_inflight"] | max_inflight;
+        drain_rate = doc["drain_rate"] | drain_rate;
+    };
+
+    // set data according to doc
+    void fromWeb(JsonVariant variant)
+    {
+        // Copy values from the variant to the Config
+        if (!variant["enabled"].isNull())
+            enabled = variant["enabled"].as<bool>();
+        if (!variant["broker"].isNull())
+            broker = variant["broker"].as<String>();
+        if (!variant["port"].isNull())
+            port = variant["port"].as<uint16_t>();
+        if (!variant["username"].isNull())
+            username = variant["username"].as<String>();
+        if (!variant["password"].isNull())
+            password = variant["password"].as<String>();
+        if (!variant["topic_prefix"].isNull())
+            topic_prefix = variant["topic_prefix"].as<String>();
+        if (!variant["mode"].isNull())
+            mode = variant["mode"].as<uint8_t>();
+        if (!variant["batch_records"].isNull())
+            batch_records = variant["batch_records"].as<uint16_t>();
+        if (!variant["stats_interval_ms"].isNull())
+            stats_interval_ms = variant["stats_interval_ms"].as<uint16_t>();
+        if (!variant["max_inflight"].isNull())
+            max_inflight = variant["max_inflight"].as<uint8_t>();
+        if (!variant["drain_rate"].isNull())
+            drain_rate = variant["drain_rate"].as<uint16_t>();
+    };
+};
+
+struct AlarmConfig : BaseConfig
+{
+    using BaseConfig::BaseConfig; // Inherit BaseConfig's constructors.
+public:
+    // data
+    int8_t output_pins[ALARM_MAX_OUTPUTS] = {-1, -1, -1, -1}; // -1: not connected
+    bool active_high = true;
+    AlarmRuleParams rules[ALARM_MAX_RULES];
+
+    // create doc from data
+    void toDoc(JsonDocument &doc) const
+    {
+        // Set the values in the document
+        JsonArray pins = doc.createNestedArray("output_pins");
+        for (int8_t pin : output_pins)
+            pins.add(pin);
+        doc["active_high"] = active_high;
+
+        JsonArray array = doc.createNestedArray("rules");
+        for (const AlarmRuleParams &rule : rules)
+        {
+            JsonObject item = array.createNestedObject();
+            item["enabled"] = rule.enabled;
+            item["mode"] = rule.mode;
+            item["level"] = rule.level;
+            item["hysteresis"] = rule.hysteresis;
+            item["latch"] = rule.latch;
+            item["confirm_samples"] = rule.confirm_samples;
+            item["output"] = rule.output;
+        }
+    };
+
+    // set data according to doc
+    void fromDoc(JsonDocument const &doc)
+    {
+        // Copy values from the JsonDocument to the Config
+        for (uint8_t i = 0; i < ALARM_MAX_OUTPUTS; i++)
+            output_pins[i] = doc["output_pins"][i] | output_pins[i];
+        active_high = doc["active_high"] | active_high;
+
+        for (uint8_t i = 0; i < ALARM_MAX_RULES; i++)
+        {
+            JsonVariantConst item = doc["rules"][i];
+            rules[i].enabled = item["enabled"] | rules[i].enabled;
+            rules[i].mode = (AlarmMode)(item["mode"] | (uint8_t)rules[i].mode);
+            rules[i].level = item["level"] | rules[i].level;
+            rules[i].hysteresis = item["hysteresis"] | rules[i].hysteresis;
+            rules[i].latch = item["latch"] | rules[i].latch;
+            rules[i].confirm_samples = item["confirm_samples"] | rules[i].confirm_samples;
+            rules[i].output = item["output"] | rules[i].output;
+        }
+    };
+
+    // set data according to doc
+    void fromWeb(JsonVariant variant)
+    {
+        // Copy values from the variant to the Config
+        for (uint8_t i = 0; i < ALARM_MAX_OUTPUTS; i++)
+        {
+            if (!variant["output_pins"][i].isNull())
+                output_pins[i] = variant["output_pins"][i].as<int8_t>();
+        }
+        if (!variant["active_high"].isNull())
+            active_high = variant["active_high"].as<bool>();
+
+        for (uint8_t i = 0; i < ALARM_MAX_RULES; i++)
+        {
+            JsonVariant item = variant["rules"][i];
+            if (item.isNull())
+                continue;
+            if (!item["enabled"].isNull())
+                rules[i].enabled = item["enabled"].as<bool>();
+            if (!item["mode"].isNull())
+                rules[i].mode = (AlarmMode)item["mode"].as<uint8_t>();
+            if (!item["level"].isNull())
+                rules[i].level = item["level"].as<float>();
+            if (!item["hysteresis"].isNull())
+                rules[i].hysteresis = item["hysteresis"].as<float>();
+            if (!item["latch"].isNull())
+                rules[i].latch = item["latch"].as<bool>();
+            if (!item["confirm_samples"].isNull())
+                rules[i].confirm_samples = item["confirm_samples"].as<uint8_t>();
+            if (!item["output"].isNull())
+                rules[i].output = item["output"].as<uint8_t>();
+        }
     };
 };
\ No newline at end of file
@@ -1,7 +1,11 @@
 #include <Display.hpp>
 
+#include <DisplayPages.hpp>
+#include <WiFi.h>
+
 #include <Fuelgauge.hpp> // -->g_Fuelgauge
 #include <Loadcell.hpp>  // -->g_Loadcell
+#include <Trace.hpp>     // -->g_Trace
 
 namespace Display
 {
@@ -11,15 +15,58 @@ namespace Display
     U8G2_SH1106_128X64_NONAME_F_HW_I2C display(U8G2_R0, /* reset=*/U8X8_PIN_NONE); // AZ-Delivery 1.3 display.
     // U8G2_SSD1327_WS_128X128_F_HW_I2C display(U8G2_R0, /* reset=*/U8X8_PIN_NONE); // Adafruit 1.5 display // Too slow with I2C
 
-    u8g2_uint_t display_height = display.getDisplayHeight();
-    u8g2_uint_t display_width = display.getDisplayWidth();
+    // the layout draws through this, the same layout runs on the host (tools/host display, soak)
+    class U8g2Canvas : public DisplayCanvas
+    {
+    private:
+        U8G2 &_u8g2;
+
+    public:
+        U8g2Canvas(U8G2 &u8g2) : _u8g2(u8g2) {}
+
+        uint16_t width() const override { return _u8g2.getDisplayWidth(); }
+        uint16_t height() const override { return _u8g2.getDisplayHeight(); }
+
+        void clear() override { _u8g2.clearBuffer(); }
+
+        void setFont(DisplayFont font) override
+        {
+            switch (font)
+            {
+            case DISPLAY_FONT_VALUE:
+                _u8g2.setFont(u8g2_font_spleen16x32_mn);
+                break;
+            case DISPLAY_FONT_ICONS:
+                _u8g2.setFont(u8g2_font_siji_t_6x10);
+                break;
+            case DISPLAY_FONT_MEDIUM:
+                _u8g2.setFont(u8g2_font_spleen8x16_mr);
+                break;
+            default:
+                _u8g2.setFont(u8g2_font_spleen5x8_mr);
+                break;
+            }
+        }
+
+        void drawStr(int16_t x, int16_t y, const char *text) override { _u8g2.drawStr(x, y, text); }
+        void drawGlyph(int16_t x, int16_t y, uint16_t glyph) override { _u8g2.drawGlyph(x, y, glyph); }
+        uint16_t getStrWidth(const char *text) override { return _u8g2.getStrWidth(text); }
+
+        uint8_t *getBuffer() override { return _u8g2.getBufferPtr(); }
+        void send() override { _u8g2.sendBuffer(); }
+        void sendArea(uint8_t tile_x, uint8_t tile_y, uint8_t tile_width, uint8_t tile_height) override
+        {
+            _u8g2.updateDisplayArea(tile_x, tile_y, tile_width, tile_height);
+        }
+    };
+
+    U8g2Canvas canvas(display);
+    DisplayPages pages;
 
     ulong lastMillisStatusMessage = 0;
 
-    const u8g2_uint_t line1 = 8;
-    const u8g2_uint_t line2 = (line1 + 4) + 25;
-    const u8g2_uint_t line3 = (line2 + 4) + 10;
-    const u8g2_uint_t line4 = display_height;
+    // set by the button task, applied by the display task
+    volatile bool nextPageRequest = false;
 
     ///
     void initialize()
@@ -35,6 +82,7 @@ namespace Display
                 ; // Don't proceed, loop forever
         }
         log_v("Display initialized");
+        pages.begin(canvas);
 
         // Init
         status_message("pls wait, starting...");
@@ -42,10 +90,8 @@ namespace Display
 
     void status_message(String message)
     {
-        display.clearBuffer();                                     // clear the internal memory
-        display.setFont(u8g2_font_spleen5x8_mr);                   // choose a suitable font
-        display.drawStr(0, (display_height - 8), message.c_str()); // write something to the internal memory
-        display.sendBuffer();                                      // transfer internal memory to the display
+        DisplayLayout::drawStatusMessage(canvas, message.c_str());
+        pages.invalidate();
 
         // for debug: also print to serial
         log_i("%s", message.c_str());
@@ -53,61 +99,50 @@ namespace Display
         lastMillisStatusMessage = millis();
     }
 
-    void draw_battery_icon(float battery_percent)
-    {
-        uint8_t symbol_offset = int(battery_percent / 9);
-        symbol_offset = symbol_offset < 0 ? 0 : symbol_offset; // limit to 0
-        symbol_offset = symbol_offset > 9 ? 9 : symbol_offset; // limit to +9
-
-        uint16_t _symbol = 0xe242 + symbol_offset;
-
-        // Battery Icon Font
-        display.setFont(u8g2_font_siji_t_6x10);
-        display.drawGlyph((display_width - 12), line1 - 1, _symbol); /* Battery Bar */
-    }
-
-    void static_content()
+    void next_page()
     {
-        display.clearBuffer();
-
-        /*
-        display: 128x64
-
-        line1: 8: statusbar (displayunit, battery)
-        line2: 24: value in displayunit
-        line3: 8: line up to range
-
-        line4: -8: statusmessage (up to 2 secs)
-        */
-
-        display.setFont(u8g2_font_spleen5x8_mr); // choose a suitable font
-
-        // displayunit unit
-        display.drawStr(0, line1, (String("[") + String(g_Loadcell.sensor_config.displayunit) + String("]")).c_str());
-        // fullrange
-        display.drawStr(60, line1, String(g_Loadcell.sensor_config.fullrange, 0).c_str());
-
-        // sensitivity, always 4 digits
-        display.drawStr(0, line4, String(g_Loadcell.sensor_config.sensitivity, 4).c_str());
-        // zerobalance, always 4 digits
-        display.drawStr(64, line4, String(g_Loadcell.sensor_config.zerobalance, 4).c_str());
+        nextPageRequest = true;
     }
 
     void update_loop()
     {
-        char buf[16];
-        const int numberdigits = 4;
-
-        static_content();
-
-        // value in displayunit
-        display.setFont(u8g2_font_spleen16x32_mn); // choose a suitable font
-        sprintf(buf, "%2.*f", g_Loadcell.sensor_config.digits, g_Loadcell.getReadingDisplayunitFiltered());
-        display.drawStr(display_width - display.getStrWidth(buf), line2, buf);
+        if (nextPageRequest)
+        {
+            nextPageRequest = false;
+            pages.nextPage();
+        }
 
-        if (g_Fuelgauge.getGaugeAvailable())
-            draw_battery_icon(g_Fuelgauge.getBatteryPercent());
+        // value and the sample it belongs to from one snapshot
+        LoadcellTelemetry reading = g_Loadcell.getTelemetry();
+        FuelgaugeStatus battery = g_Fuelgauge.getStatus();
+
+        DisplayState state;
+        state.unit = g_Loadcell.sensor_config.displayunit.c_str();
+        state.channel = g_Loadcell.sensor_config.display_channel;
+        // value in displayunit, or the selected derived channel
+        state.value = LoadcellClass::getChannel(reading, g_Loadcell.sensor_config.display_channel);
+        state.digits = g_Loadcell.sensor_config.digits;
+        state.fullrange = g_Loadcell.sensor_config.fullrange;
+        state.sensitivity = g_Loadcell.sensor_config.sensitivity;
+        state.zerobalance = g_Loadcell.sensor_config.zerobalance;
+        state.peak = reading.stats.max;
+        state.valley = reading.stats.min;
+        state.samples = reading.stats.count;
+        state.battery_available = battery.available;
+        state.battery_percent = battery.percent;
+        state.battery_voltage = battery.voltage;
+        state.battery_charge_rate = battery.charge_rate;
+        state.wifi_connected = WiFi.isConnected();
+        if (state.wifi_connected)
+        {
+            IPAddress ip = WiFi.localIP();
+            state.wifi_rssi = WiFi.RSSI();
+            for (uint8_t i = 0; i < 4; i++)
+                state.ip[i] = ip[i];
+        }
+        state.uptime_s = millis() / 1000;
 
-        display.sendBuffer();
+        pages.update(canvas, state);
+        g_Trace.record(TRACE_DISPLAY, reading.micros);
     }
-}
\ No newline at end of file
+}
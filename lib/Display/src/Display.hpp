@@ -21,6 +21,9 @@
 #define OLED_RESET -1       // Reset pin # (or -1 if sharing Arduino reset pin)
 #define SCREEN_ADDRESS 0x3C ///< See datasheet for Address; 0x3D for 128x64, 0x3C for 128x32
 
+// frame period, the trend page scrolls one column per frame. Frames send only the changed tiles
+#define DISPLAY_UPDATE_MS 100
+
 ///
 namespace Display
 {
@@ -28,6 +31,7 @@ namespace Display
     ///
     void initialize();
     void update_loop();
-    void static_content();
     void status_message(String message);
+    // measurement, trend, peak/valley, status. Safe from other tasks, applied with the next frame
+    void next_page();
 }
\ No newline at end of file
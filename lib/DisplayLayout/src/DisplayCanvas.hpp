@@ -0,0 +1,44 @@
+#pragma once
+
+// Drawing surface of the display layout. The firmware adapts the U8g2 full buffer of the
+// OLED (Display.cpp), the host tools an in-memory buffer. Coordinates and the baseline of
+// text as in U8g2.
+// Portable, no Arduino dependencies.
+//
+// buffer: U8g2 layout of page mode controllers (SSD1306, SH1106), tile rows of 8 pixels.
+// byte [tile_row * width() + x] holds the pixels x, tile_row * 8 .. + 7, lsb on top
+
+#include <stdint.h>
+
+#define DISPLAY_TILE 8 // pixels per tile side
+
+enum DisplayFont : uint8_t
+{
+    DISPLAY_FONT_SMALL = 0, // 5x8, status bar and status line
+    DISPLAY_FONT_VALUE,     // 16x32 digits, the reading
+    DISPLAY_FONT_ICONS,     // 6x10 symbols, battery
+    DISPLAY_FONT_MEDIUM,    // 8x16, secondary values
+};
+
+class DisplayCanvas
+{
+public:
+    virtual ~DisplayCanvas() {}
+
+    virtual uint16_t width() const = 0;
+    virtual uint16_t height() const = 0;
+
+    virtual void clear() = 0;
+    virtual void setFont(DisplayFont font) = 0;
+    virtual void drawStr(int16_t x, int16_t y, const char *text) = 0;
+    virtual void drawGlyph(int16_t x, int16_t y, uint16_t glyph) = 0;
+    // width of text in the current font
+    virtual uint16_t getStrWidth(const char *text) = 0;
+
+    // the frame buffer, width() * height() / 8 bytes
+    virtual uint8_t *getBuffer() = 0;
+    // transfer the whole buffer to the display
+    virtual void send() = 0;
+    // transfer a rectangle of tiles, like U8g2 updateDisplayArea
+    virtual void sendArea(uint8_t tile_x, uint8_t tile_y, uint8_t tile_width, uint8_t tile_height) = 0;
+};
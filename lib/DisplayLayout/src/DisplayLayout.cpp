@@ -0,0 +1,158 @@
+#include <DisplayLayout.hpp>
+
+#include <stdio.h>
+
+namespace
+{
+    const int16_t line1 = 8;
+    const int16_t line2 = (line1 + 4) + 25;
+
+    // header of the trend page, small font: ascent 7, descent 1, stays in tile rows 0..1
+    const int16_t header1 = 7;
+    const int16_t header2 = 15;
+
+    // unit of the derived channels
+    const char *channel_suffix[CHANNEL_COUNT] = {"", "/s", "*s", "*d"};
+
+    void drawBattery(DisplayCanvas &canvas, const DisplayState &state)
+    {
+        if (!state.battery_available)
+            return;
+        canvas.setFont(DISPLAY_FONT_ICONS);
+        canvas.drawGlyph(canvas.width() - 12, line1 - 1, DisplayLayout::batteryGlyph(state.battery_percent));
+    }
+
+    void formatUnit(char *text, size_t size, const DisplayState &state)
+    {
+        uint8_t channel = state.channel < CHANNEL_COUNT ? state.channel : (uint8_t)CHANNEL_FORCE;
+        snprintf(text, size, "[%s%s]", state.unit, channel_suffix[channel]);
+    }
+
+    // label left, value in the medium font right aligned
+    void drawLabeled(DisplayCanvas &canvas, int16_t y, const char *label, float value, uint8_t digits)
+    {
+        char text[DISPLAY_TEXT_SIZE];
+        canvas.setFont(DISPLAY_FONT_SMALL);
+        canvas.drawStr(0, y, label);
+        canvas.setFont(DISPLAY_FONT_MEDIUM);
+        snprintf(text, sizeof(text), "%.*f", digits, value);
+        canvas.drawStr(canvas.width() - canvas.getStrWidth(text), y, text);
+    }
+}
+
+namespace DisplayLayout
+{
+    uint16_t batteryGlyph(float percent)
+    {
+        int step = (int)(percent / 9);
+        step = step < 0 ? 0 : step;
+        step = step > 9 ? 9 : step;
+        return DISPLAY_BATTERY_GLYPH + step;
+    }
+
+    void drawMeasurement(DisplayCanvas &canvas, const DisplayState &state)
+    {
+        char text[DISPLAY_TEXT_SIZE];
+        const int16_t line4 = canvas.height();
+
+        canvas.setFont(DISPLAY_FONT_SMALL);
+
+        // displayunit, of the derived channel if one is selected
+        formatUnit(text, sizeof(text), state);
+        canvas.drawStr(0, line1, text);
+        snprintf(text, sizeof(text), "%.0f", state.fullrange);
+        canvas.drawStr(60, line1, text);
+
+        // sensitivity and zerobalance, always 4 digits
+        snprintf(text, sizeof(text), "%.4f", state.sensitivity);
+        canvas.drawStr(0, line4, text);
+        snprintf(text, sizeof(text), "%.4f", state.zerobalance);
+        canvas.drawStr(64, line4, text);
+
+        canvas.setFont(DISPLAY_FONT_VALUE);
+        snprintf(text, sizeof(text), "%2.*f", state.digits, state.value);
+        canvas.drawStr(canvas.width() - canvas.getStrWidth(text), line2, text);
+
+        drawBattery(canvas, state);
+    }
+
+    void drawTrendHeader(DisplayCanvas &canvas, const DisplayState &state, float low, float high)
+    {
+        char text[DISPLAY_TEXT_SIZE];
+
+        canvas.setFont(DISPLAY_FONT_SMALL);
+        formatUnit(text, sizeof(text), state);
+        canvas.drawStr(0, header1, text);
+        // value left of the battery icon
+        snprintf(text, sizeof(text), "%.*f", state.digits, state.value);
+        canvas.drawStr(canvas.width() - 14 - canvas.getStrWidth(text), header1, text);
+
+        // range of the plot
+        snprintf(text, sizeof(text), "%.*f .. %.*f", state.digits, low, state.digits, high);
+        canvas.drawStr(0, header2, text);
+
+        drawBattery(canvas, state);
+    }
+
+    void drawPeak(DisplayCanvas &canvas, const DisplayState &state)
+    {
+        char text[DISPLAY_TEXT_SIZE];
+
+        canvas.setFont(DISPLAY_FONT_SMALL);
+        formatUnit(text, sizeof(text), state);
+        canvas.drawStr(0, line1, text);
+        canvas.drawStr(40, line1, "peak/valley");
+
+        drawLabeled(canvas, 32, "max", state.peak, state.digits);
+        drawLabeled(canvas, 52, "min", state.valley, state.digits);
+
+        canvas.setFont(DISPLAY_FONT_SMALL);
+        snprintf(text, sizeof(text), "%u samples", (unsigned)state.samples);
+        canvas.drawStr(0, canvas.height(), text);
+
+        drawBattery(canvas, state);
+    }
+
+    void drawStatus(DisplayCanvas &canvas, const DisplayState &state)
+    {
+        char text[DISPLAY_TEXT_SIZE];
+
+        canvas.setFont(DISPLAY_FONT_SMALL);
+        canvas.drawStr(0, line1, "status");
+
+        if (state.battery_available)
+        {
+            snprintf(text, sizeof(text), "battery %.0f%% %.2fV", state.battery_percent, state.battery_voltage);
+            canvas.drawStr(0, 20, text);
+            snprintf(text, sizeof(text), "charge %+.1f%%/h", state.battery_charge_rate);
+            canvas.drawStr(0, 30, text);
+        }
+        else
+            canvas.drawStr(0, 20, "battery: no gauge");
+
+        if (state.wifi_connected)
+        {
+            snprintf(text, sizeof(text), "wifi %d dBm", state.wifi_rssi);
+            canvas.drawStr(0, 42, text);
+            snprintf(text, sizeof(text), "ip %u.%u.%u.%u", state.ip[0], state.ip[1], state.ip[2], state.ip[3]);
+            canvas.drawStr(0, 52, text);
+        }
+        else
+            canvas.drawStr(0, 42, "wifi not connected");
+
+        uint32_t s = state.uptime_s;
+        snprintf(text, sizeof(text), "up %ud %02u:%02u:%02u", (unsigned)(s / 86400), (unsigned)(s / 3600 % 24), (unsigned)(s / 60 % 60),
+                 (unsigned)(s % 60));
+        canvas.drawStr(0, canvas.height(), text);
+
+        drawBattery(canvas, state);
+    }
+
+    void drawStatusMessage(DisplayCanvas &canvas, const char *message)
+    {
+        canvas.clear();
+        canvas.setFont(DISPLAY_FONT_SMALL);
+        canvas.drawStr(0, canvas.height() - 8, message);
+        canvas.send();
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Screen layout of the OLED, drawn from a snapshot of the values shown. Text is formatted
+// into fixed buffers, a frame does not allocate: the display task redraws several times a
+// second for the lifetime of the box.
+// Portable, used by DisplayPages and the host tools.
+//
+// display: 128x64
+//   measurement: status bar (displayunit, fullrange, battery), value in displayunit,
+//                sensitivity and zero balance on the bottom line
+//   trend:       value and plot scale in tile rows 0..1, the trend plot below
+//   peak:        peak and valley since the statistics were reset
+//   status:      battery, WiFi and uptime
+
+#include <stdint.h>
+
+#include <DisplayCanvas.hpp>
+#include <DerivedChannels.hpp>
+
+#define DISPLAY_TEXT_SIZE 32
+#define DISPLAY_BATTERY_GLYPH 0xe242 // siji battery bar, 10 steps
+#define DISPLAY_TREND_TILE_ROW 2     // first tile row of the plot, the header lines are above
+
+enum DisplayPage : uint8_t
+{
+    DISPLAY_PAGE_MEASUREMENT = 0,
+    DISPLAY_PAGE_TREND,
+    DISPLAY_PAGE_PEAK,
+    DISPLAY_PAGE_STATUS,
+    DISPLAY_PAGE_COUNT,
+};
+
+// what one frame shows, filled by the display task
+struct DisplayState
+{
+    const char *unit = "";
+    uint8_t channel = CHANNEL_FORCE; // DerivedChannel shown, its unit suffix is added
+    float value = 0.0;
+    uint8_t digits = 4;
+    float fullrange = 0.0;
+    float sensitivity = 0.0;
+    float zerobalance = 0.0;
+
+    // filtered values since the statistics were reset
+    float peak = 0.0;
+    float valley = 0.0;
+    uint32_t samples = 0;
+
+    bool battery_available = false;
+    float battery_percent = 0.0;
+    float battery_voltage = 0.0;
+    float battery_charge_rate = 0.0; // %/h
+
+    bool wifi_connected = false;
+    int8_t wifi_rssi = 0; // dBm
+    uint8_t ip[4] = {0};
+    uint32_t uptime_s = 0;
+};
+
+namespace DisplayLayout
+{
+    // pages, drawn into a cleared buffer
+    void drawMeasurement(DisplayCanvas &canvas, const DisplayState &state);
+    void drawPeak(DisplayCanvas &canvas, const DisplayState &state);
+    void drawStatus(DisplayCanvas &canvas, const DisplayState &state);
+
+    // value and plot scale, drawn into cleared tile rows above DISPLAY_TREND_TILE_ROW only
+    void drawTrendHeader(DisplayCanvas &canvas, const DisplayState &state, float low, float high);
+
+    // message on the bottom line of an otherwise empty screen, cleared and sent
+    void drawStatusMessage(DisplayCanvas &canvas, const char *message);
+
+    // battery bar glyph for 0..100 %
+    uint16_t batteryGlyph(float percent);
+}
@@ -0,0 +1,110 @@
+#include <DisplayPages.hpp>
+
+#include <math.h>
+#include <string.h>
+
+void DisplayPages::begin(DisplayCanvas &canvas)
+{
+    uint8_t rows = canvas.height() / DISPLAY_TILE;
+    _trend.begin(0, canvas.width(), DISPLAY_TREND_TILE_ROW, rows - DISPLAY_TREND_TILE_ROW);
+    invalidate();
+}
+
+void DisplayPages::nextPage()
+{
+    setPage((DisplayPage)((_page + 1) % DISPLAY_PAGE_COUNT));
+}
+
+void DisplayPages::setPage(DisplayPage page)
+{
+    if (page >= DISPLAY_PAGE_COUNT || page == _page)
+        return;
+    _page = page;
+    _pageShown = false;
+}
+
+void DisplayPages::invalidate()
+{
+    _pageShown = false;
+    _shadowValid = false;
+}
+
+void DisplayPages::update(DisplayCanvas &canvas, const DisplayState &state)
+{
+    _trend.setMinRange(DISPLAY_TREND_MIN_STEPS * powf(10, -(float)state.digits));
+    _trend.add(state.value);
+
+    uint8_t *buffer = canvas.getBuffer();
+    if (_page == DISPLAY_PAGE_TREND)
+    {
+        if (!_pageShown)
+        {
+            canvas.clear();
+            _trend.invalidate();
+        }
+        else
+            memset(buffer, 0, DISPLAY_TREND_TILE_ROW * canvas.width());
+
+        // plot first, the header shows its scale
+        _trend.render(buffer, canvas.width());
+        DisplayLayout::drawTrendHeader(canvas, state, _trend.getLow(), _trend.getHigh());
+    }
+    else
+    {
+        canvas.clear();
+        if (_page == DISPLAY_PAGE_PEAK)
+            DisplayLayout::drawPeak(canvas, state);
+        else if (_page == DISPLAY_PAGE_STATUS)
+            DisplayLayout::drawStatus(canvas, state);
+        else
+            DisplayLayout::drawMeasurement(canvas, state);
+    }
+    _pageShown = true;
+
+    flush(canvas);
+    _stats.frames++;
+}
+
+// per tile row one transfer from the first to the last changed tile
+void DisplayPages::flush(DisplayCanvas &canvas)
+{
+    const uint8_t *buffer = canvas.getBuffer();
+    uint16_t width = canvas.width();
+    size_t size = (size_t)width * canvas.height() / 8;
+
+    if (!_shadowValid || size > sizeof(_shadow))
+    {
+        canvas.send();
+        _stats.full_sends++;
+        _stats.tiles_sent += size / DISPLAY_TILE;
+        if (size <= sizeof(_shadow))
+        {
+            memcpy(_shadow, buffer, size);
+            _shadowValid = true;
+        }
+        return;
+    }
+
+    uint8_t tiles = width / DISPLAY_TILE;
+    for (uint8_t row = 0; row < canvas.height() / DISPLAY_TILE; row++)
+    {
+        size_t offset = (size_t)row * width;
+        int16_t first = -1;
+        int16_t last = -1;
+        for (uint8_t tile = 0; tile < tiles; tile++)
+        {
+            if (memcmp(buffer + offset + tile * DISPLAY_TILE, _shadow + offset + tile * DISPLAY_TILE, DISPLAY_TILE) != 0)
+            {
+                first = first < 0 ? tile : first;
+                last = tile;
+            }
+        }
+        if (first < 0)
+            continue;
+
+        canvas.sendArea(first, row, last - first + 1, 1);
+        memcpy(_shadow + offset + first * DISPLAY_TILE, buffer + offset + first * DISPLAY_TILE, (last - first + 1) * DISPLAY_TILE);
+        _stats.areas_sent++;
+        _stats.tiles_sent += last - first + 1;
+    }
+}
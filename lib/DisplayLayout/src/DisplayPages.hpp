@@ -0,0 +1,61 @@
+#pragma once
+
+// Page switching and frame transfer of the display. Every frame adds the value to the trend
+// (also while another page is shown), draws the current page and sends only the tiles that
+// differ from what the display shows: the value and a slowly moving trend line touch a few
+// of the 128 tiles, so the I2C traffic per frame stays small at higher refresh rates.
+// Portable, used by Display.cpp and the host tools.
+//
+// The trend page keeps its plot in the buffer between frames, only the header tile rows
+// are cleared and redrawn. The other pages redraw into a cleared buffer.
+
+#include <stdint.h>
+
+#include <DisplayLayout.hpp>
+#include <TrendPlot.hpp>
+
+#define DISPLAY_BUFFER_MAX 1024 // 128x64
+#define DISPLAY_TREND_MIN_STEPS 50 // smallest plot range in steps of the displayed digits
+
+struct DisplayPagesStats
+{
+    uint32_t frames = 0;
+    uint32_t full_sends = 0;
+    uint32_t areas_sent = 0;
+    uint32_t tiles_sent = 0; // 8 bytes each, a full 128x64 frame is 128 tiles
+};
+
+class DisplayPages
+{
+private:
+    DisplayPage _page = DISPLAY_PAGE_MEASUREMENT;
+    bool _pageShown = false; // buffer holds the current page, the trend page keeps its plot
+
+    TrendPlot _trend;
+
+    // what the display shows, compared per tile
+    uint8_t _shadow[DISPLAY_BUFFER_MAX];
+    bool _shadowValid = false;
+
+    DisplayPagesStats _stats;
+
+    void flush(DisplayCanvas &canvas);
+
+public:
+    // trend region from the canvas size
+    void begin(DisplayCanvas &canvas);
+
+    void nextPage();
+    void setPage(DisplayPage page);
+    DisplayPage getPage() const { return _page; }
+
+    // one frame: adds the value to the trend, draws the current page and sends the changes
+    void update(DisplayCanvas &canvas, const DisplayState &state);
+
+    // the display was drawn outside of update, e.g. a status message: next frame redraws
+    // and sends everything
+    void invalidate();
+
+    const TrendPlot &getTrend() const { return _trend; }
+    const DisplayPagesStats &getStats() const { return _stats; }
+};
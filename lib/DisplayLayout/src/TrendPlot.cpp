@@ -0,0 +1,194 @@
+#include <TrendPlot.hpp>
+
+#include <math.h>
+#include <string.h>
+
+TrendPlot::TrendPlot()
+{
+    clear();
+}
+
+void TrendPlot::begin(uint8_t x, uint8_t width, uint8_t tile_row, uint8_t tile_rows)
+{
+    _x = x;
+    _width = width < TREND_MAX_COLUMNS ? width : TREND_MAX_COLUMNS;
+    _tileRow = tile_row;
+    _tileRows = tile_rows;
+    clear();
+}
+
+void TrendPlot::clear()
+{
+    for (float &value : _values)
+        value = NAN;
+    _head = 0;
+    _count = 0;
+    _pending = 0;
+    _sinceCheck = 0;
+    _low = 0;
+    _high = 0;
+    _valid = false;
+}
+
+float TrendPlot::at(uint16_t age) const
+{
+    uint16_t size = _width + 1;
+    return _values[(_head + size - 1 - age) % size];
+}
+
+void TrendPlot::add(float value)
+{
+    uint16_t size = _width + 1;
+    if (size < 2)
+        return;
+
+    _values[_head] = value;
+    _head = (_head + 1) % size;
+    if (_count < size)
+        _count++;
+    if (_pending < size)
+        _pending++;
+    _sinceCheck++;
+    _stats.values++;
+
+    if (isfinite(value) && (value < _low || value > _high))
+        _valid = false;
+}
+
+int16_t TrendPlot::toY(float value) const
+{
+    int16_t top = _tileRow * 8;
+    int16_t height = _tileRows * 8;
+    int16_t offset = (int16_t)lroundf((value - _low) / (_high - _low) * (height - 1));
+    offset = offset < 0 ? 0 : (offset > height - 1 ? height - 1 : offset);
+    return top + height - 1 - offset;
+}
+
+// visible values including the one the first column connects to, false if none is finite
+bool TrendPlot::dataRange(float &low, float &high) const
+{
+    low = INFINITY;
+    high = -INFINITY;
+    for (uint16_t age = 0; age <= visible() && age < _count; age++)
+    {
+        float value = at(age);
+        if (isfinite(value))
+        {
+            low = value < low ? value : low;
+            high = value > high ? value : high;
+        }
+    }
+    return low <= high;
+}
+
+float TrendPlot::minRange(float low, float high) const
+{
+    float magnitude = fabsf(low) > fabsf(high) ? fabsf(low) : fabsf(high);
+    float range = TREND_MIN_RANGE * (magnitude > 1 ? magnitude : 1);
+    return range > _minRange ? range : _minRange;
+}
+
+// range of the data plus the margin, the range of the data is at least minRange(), a flat
+// line sits in the middle
+void TrendPlot::rescale()
+{
+    float low, high;
+    if (!dataRange(low, high))
+        return; // no value to scale for, keep the scale
+
+    float min_range = minRange(low, high);
+    float range = high - low;
+    if (range < min_range)
+    {
+        float center = (low + high) / 2;
+        low = center - min_range / 2;
+        high = center + min_range / 2;
+        range = min_range;
+    }
+    low -= TREND_MARGIN * range;
+    high += TREND_MARGIN * range;
+    if (low != _low || high != _high)
+        _stats.rescales++;
+    _low = low;
+    _high = high;
+}
+
+bool TrendPlot::shrunk() const
+{
+    float low, high;
+    if (!dataRange(low, high))
+        return false;
+    float range = high - low;
+    float min_range = minRange(low, high);
+    return (range > min_range ? range : min_range) < TREND_SHRINK * (_high - _low);
+}
+
+void TrendPlot::drawColumn(uint8_t *buffer, uint16_t stride, uint8_t x, float previous, float value) const
+{
+    for (uint8_t row = 0; row < _tileRows; row++)
+        buffer[(_tileRow + row) * stride + x] = 0;
+    if (!isfinite(value))
+        return;
+
+    int16_t y1 = toY(value);
+    int16_t y0 = isfinite(previous) ? toY(previous) : y1;
+    if (y0 > y1)
+    {
+        int16_t swap = y0;
+        y0 = y1;
+        y1 = swap;
+    }
+    for (int16_t y = y0; y <= y1; y++)
+        buffer[(y >> 3) * stride + x] |= 1 << (y & 7);
+}
+
+void TrendPlot::redraw(uint8_t *buffer, uint16_t stride) const
+{
+    uint16_t columns = visible();
+    for (uint8_t row = 0; row < _tileRows; row++)
+        memset(buffer + (_tileRow + row) * stride + _x, 0, _width - columns);
+
+    // oldest visible value first, right aligned
+    for (uint16_t i = 0; i < columns; i++)
+    {
+        uint16_t age = columns - 1 - i;
+        float previous = age + 1 < _count ? at(age + 1) : NAN;
+        drawColumn(buffer, stride, _x + _width - columns + i, previous, at(age));
+    }
+}
+
+bool TrendPlot::render(uint8_t *buffer, uint16_t stride)
+{
+    if (_width == 0)
+        return false;
+
+    if (_sinceCheck >= _width)
+    {
+        _sinceCheck = 0;
+        if (shrunk())
+            _valid = false;
+    }
+
+    // shifting in more than half of the columns costs more than drawing them all
+    if (!_valid || _pending > _width / 2)
+    {
+        rescale();
+        redraw(buffer, stride);
+        _valid = true;
+        _pending = 0;
+        _stats.full_redraws++;
+        return true;
+    }
+
+    for (; _pending > 0; _pending--)
+    {
+        for (uint8_t row = 0; row < _tileRows; row++)
+        {
+            uint8_t *line = buffer + (_tileRow + row) * stride + _x;
+            memmove(line, line + 1, _width - 1);
+        }
+        drawColumn(buffer, stride, _x + _width - 1, at(_pending), at(_pending - 1));
+        _stats.columns++;
+    }
+    return false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Scrolling trend plot in a region of the display buffer, one column per value. A new value
+// shifts the region one pixel to the left and draws only the new column, so the cost of a
+// frame does not depend on the plot width. The whole region is redrawn only when the scale
+// changes (a value outside the range, or the data shrank to a small part of it) or after
+// invalidate(), e.g. when the page comes back into view.
+// Portable, used by DisplayPages.
+//
+// region: columns x .. x + width - 1, whole tile rows, buffer in the layout of DisplayCanvas.
+// column: a vertical line from the previous value to the value, NAN leaves the column empty
+
+#include <stdint.h>
+
+#define TREND_MAX_COLUMNS 128
+#define TREND_MARGIN 0.1f // headroom on both sides of the data after a rescale, share of its range
+#define TREND_SHRINK 0.4f // rescale if the visible data spans less than this share of the scale
+#define TREND_MIN_RANGE 1e-3f // relative to the magnitude of the data
+
+struct TrendStats
+{
+    uint32_t values = 0;
+    uint32_t columns = 0;      // drawn by shifting
+    uint32_t full_redraws = 0; // including the rescales
+    uint32_t rescales = 0;
+};
+
+class TrendPlot
+{
+private:
+    uint8_t _x = 0;
+    uint8_t _width = 0;
+    uint8_t _tileRow = 0;
+    uint8_t _tileRows = 0;
+
+    // latest values, one more than columns: the oldest connects the first visible column
+    float _values[TREND_MAX_COLUMNS + 1];
+    uint16_t _head = 0; // next write
+    uint16_t _count = 0;
+    uint16_t _pending = 0; // added since the last render
+    uint16_t _sinceCheck = 0;
+
+    float _low = 0;
+    float _high = 0;
+    float _minRange = 0;
+    bool _valid = false; // buffer region shows all values at the current scale
+
+    TrendStats _stats;
+
+    float at(uint16_t age) const; // 0: newest
+    uint16_t visible() const { return _count < _width ? _count : _width; }
+    int16_t toY(float value) const;
+    bool dataRange(float &low, float &high) const;
+    float minRange(float low, float high) const;
+    void rescale();
+    bool shrunk() const;
+    void drawColumn(uint8_t *buffer, uint16_t stride, uint8_t x, float previous, float value) const;
+
+public:
+    TrendPlot();
+
+    // width up to TREND_MAX_COLUMNS, clears the values
+    void begin(uint8_t x, uint8_t width, uint8_t tile_row, uint8_t tile_rows);
+    void clear();
+
+    void add(float value);
+
+    // smallest range of the scale, e.g. some steps of the displayed resolution: noise below
+    // it is not magnified to the full height
+    void setMinRange(float range) { _minRange = range; }
+
+    // next render redraws the region
+    void invalidate() { _valid = false; }
+
+    // brings the region up to date: shifts in the columns added since the last call, or
+    // redraws it. returns true if redrawn
+    bool render(uint8_t *buffer, uint16_t stride);
+
+    // draws all visible values at the current scale, what render leaves in the region
+    void redraw(uint8_t *buffer, uint16_t stride) const;
+
+    float getLow() const { return _low; }
+    float getHigh() const { return _high; }
+    const TrendStats &getStats() const { return _stats; }
+};
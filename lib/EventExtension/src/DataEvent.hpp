@@ -4,12 +4,18 @@
 #include <events.hpp>
 using namespace esp32m;
 
+#define DATA_EVENT_SIZE 192 // longer payloads are truncated
+
+// payload is stored inline, publishing does not touch the heap (events live on the stack
+// of the publisher and are delivered synchronously)
 class DataEvent : public Event
 {
 public:
-    DataEvent(const char *type, String data) : Event(type), _data(data) {}
-    String data() { return _data; }
+    DataEvent(const char *type, const char *data) : Event(type) { strlcpy(_data, data, sizeof(_data)); }
+    DataEvent(const char *type, const String &data) : DataEvent(type, data.c_str()) {}
+    String data() { return String(_data); }
+    const char *c_str() const { return _data; }
 
 private:
-    String _data;
+    char _data[DATA_EVENT_SIZE];
 };
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include <EventFanout.hpp>
+
+#include <stdio.h>
+#include <string.h>
+
+EventFanout::EventFanout(FanoutTransport &transport) : _transport(transport)
+{
+}
+
+int8_t EventFanout::registerChannel(const char *name, bool coalesce)
+{
+    int8_t channel = findChannel(name);
+    if (channel >= 0)
+        return channel;
+
+    if (_channelCount >= FANOUT_MAX_CHANNELS)
+        return -1;
+
+    strncpy(_channels[_channelCount].name, name, FANOUT_NAME_SIZE - 1);
+    _channels[_channelCount].name[FANOUT_NAME_SIZE - 1] = 0;
+    _channels[_channelCount].coalesce = coalesce;
+
+    return _channelCount++;
+}
+
+int8_t EventFanout::findChannel(const char *name) const
+{
+    for (uint8_t i = 0; i < _channelCount; i++)
+    {
+        if (strncmp(_channels[i].name, name, FANOUT_NAME_SIZE) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char *EventFanout::getChannelName(uint8_t channel) const
+{
+    return channel < _channelCount ? _channels[channel].name : "";
+}
+
+uint32_t EventFanout::channelMask(const char *names) const
+{
+    if (names == nullptr || *names == 0)
+        return FANOUT_ALL_CHANNELS;
+
+    uint32_t mask = 0;
+    char name[FANOUT_NAME_SIZE];
+
+    while (*names)
+    {
+        size_t len = strcspn(names, ",");
+        size_t copy = len < FANOUT_NAME_SIZE - 1 ? len : FANOUT_NAME_SIZE - 1;
+        memcpy(name, names, copy);
+        name[copy] = 0;
+
+        int8_t channel = findChannel(name);
+        if (channel >= 0)
+            mask |= 1UL << channel;
+
+        names += len;
+        if (*names == ',')
+            names++;
+    }
+    return mask;
+}
+
+EventFanout::Client *EventFanout::findClient(void *handle)
+{
+    for (Client &client : _clients)
+    {
+        if (client.handle == handle)
+            return &client;
+    }
+    return nullptr;
+}
+
+const FanoutEvent *EventFanout::findEvent(uint32_t id) const
+{
+    const FanoutEvent &event = _history[id % FANOUT_HISTORY_SIZE];
+    return event.id == id ? &event : nullptr;
+}
+
+void EventFanout::dequeue(Client &client, uint8_t index)
+{
+    memmove(&client.queue[index], &client.queue[index + 1], (client.queue_count - index - 1) * sizeof(client.queue[0]));
+    client.queue_count--;
+}
+
+void EventFanout::enqueue(Client &client, const FanoutEvent &event)
+{
+    if (!(client.channel_mask & (1UL << event.channel)))
+        return;
+
+    // a slow client gets the latest state instead of a backlog
+    if (_channels[event.channel].coalesce)
+    {
+        for (uint8_t i = 0; i < client.queue_count; i++)
+        {
+            const FanoutEvent *queued = findEvent(client.queue[i]);
+            if (queued && queued->channel == event.channel)
+            {
+                dequeue(client, i);
+                _metrics.coalesced++;
+                break;
+            }
+        }
+    }
+
+    if (client.queue_count == FANOUT_QUEUE_SIZE)
+    {
+        dequeue(client, 0);
+        client.dropped++;
+        _metrics.dropped++;
+    }
+
+    client.queue[client.queue_count++] = event.id;
+}
+
+uint32_t EventFanout::publish(uint8_t channel, const char *data, uint32_t now_ms, uint32_t source_us)
+{
+    if (channel >= _channelCount)
+        return 0;
+
+    FanoutEvent &event = _history[_nextId % FANOUT_HISTORY_SIZE];
+    event.id = _nextId++;
+    event.timestamp_ms = now_ms;
+    event.channel = channel;
+    event.source_us = source_us;
+    strncpy(event.data, data, FANOUT_DATA_SIZE - 1);
+    event.data[FANOUT_DATA_SIZE - 1] = 0;
+
+    _metrics.published++;
+
+    for (Client &client : _clients)
+    {
+        if (client.handle)
+            enqueue(client, event);
+    }
+
+    return event.id;
+}
+
+bool EventFanout::addClient(void *handle, uint32_t last_id, uint32_t channel_mask, uint32_t min_interval_ms)
+{
+    Client *client = findClient(nullptr);
+    if (client == nullptr)
+        return false;
+
+    *client = Client();
+    client->handle = handle;
+    client->channel_mask = channel_mask;
+    client->min_interval_ms = min_interval_ms;
+    _metrics.clients++;
+
+    // replay what the client missed, new clients get the current state of all channels
+    uint32_t first_id = _nextId > FANOUT_HISTORY_SIZE ? _nextId - FANOUT_HISTORY_SIZE : 1;
+    for (uint32_t id = first_id; id < _nextId; id++)
+    {
+        const FanoutEvent *event = findEvent(id);
+        if (event == nullptr)
+            continue;
+        if (last_id == 0 && !_channels[event->channel].coalesce)
+            continue;
+        if (last_id != 0 && id <= last_id)
+            continue;
+        if (!(client->channel_mask & (1UL << event->channel)))
+            continue;
+
+        enqueue(*client, *event);
+        _metrics.replayed++;
+    }
+
+    return true;
+}
+
+void EventFanout::removeClient(void *handle)
+{
+    Client *client = findClient(handle);
+    if (client == nullptr)
+        return;
+
+    *client = Client();
+    _metrics.clients--;
+}
+
+bool EventFanout::setSubscription(void *handle, uint32_t channel_mask, uint32_t min_interval_ms)
+{
+    Client *client = findClient(handle);
+    if (client == nullptr)
+        return false;
+
+    client->channel_mask = channel_mask;
+    client->min_interval_ms = min_interval_ms;
+    return true;
+}
+
+size_t EventFanout::format(const FanoutEvent &event, char *buffer, size_t size) const
+{
+    int len = snprintf(buffer, size, "id: %u\nevent: %s\ndata: %s\n\n", (unsigned int)event.id, _channels[event.channel].name, event.data);
+    return (len > 0 && (size_t)len < size) ? len : 0;
+}
+
+void EventFanout::serviceClient(Client &client, uint32_t now_ms)
+{
+    char buffer[FANOUT_DATA_SIZE + FANOUT_NAME_SIZE + 32];
+
+    uint8_t i = 0;
+    while (i < client.queue_count)
+    {
+        const FanoutEvent *event = findEvent(client.queue[i]);
+        if (event == nullptr)
+        {
+            // overwritten in history before it could be sent
+            dequeue(client, i);
+            client.dropped++;
+            _metrics.dropped++;
+            continue;
+        }
+
+        // rate limit applies to state channels only, they stay queued and get coalesced meanwhile
+        if (_channels[event->channel].coalesce && client.min_interval_ms &&
+            client.last_sent_ms[event->channel] && now_ms - client.last_sent_ms[event->channel] < client.min_interval_ms)
+        {
+            i++;
+            continue;
+        }
+
+        size_t len = format(*event, buffer, sizeof(buffer));
+        if (!_transport.canSend(client.handle, len))
+            break; // slow client, keep queue and try again on next ack
+
+        if (_transport.send(client.handle, buffer, len))
+        {
+            client.last_sent_ms[event->channel] = now_ms ? now_ms : 1;
+            client.delivered++;
+            _metrics.delivered++;
+            _transport.delivered(client.handle, *event);
+        }
+        else
+        {
+            // rejected although canSend agreed, e.g. the connection closed meanwhile
+            client.dropped++;
+            _metrics.dropped++;
+        }
+        dequeue(client, i);
+    }
+}
+
+void EventFanout::service(uint32_t now_ms)
+{
+    for (Client &client : _clients)
+    {
+        if (client.handle)
+            serviceClient(client, now_ms);
+    }
+}
+
+void EventFanout::service(void *handle, uint32_t now_ms)
+{
+    Client *client = findClient(handle);
+    if (client)
+        serviceClient(*client, now_ms);
+}
+
+bool EventFanout::hasSubscribers(uint8_t channel) const
+{
+    for (const Client &client : _clients)
+    {
+        if (client.handle && (client.channel_mask & (1UL << channel)))
+            return true;
+    }
+    return false;
+}
+
+uint32_t EventFanout::getQueued(void *handle)
+{
+    Client *client = findClient(handle);
+    return client ? client->queue_count : 0;
+}
+
+uint32_t EventFanout::getDropped(void *handle)
+{
+    Client *client = findClient(handle);
+    return client ? client->dropped : 0;
+}
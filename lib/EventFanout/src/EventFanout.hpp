@@ -0,0 +1,121 @@
+#pragma once
+
+// Portable fan-out of server sent events to multiple clients. Each client has a bounded
+// queue and a subscription (channel mask + min interval). Must not depend on Arduino headers,
+// the transport (AsyncTCP on target, simulated clients on host) is plugged in via FanoutTransport.
+//
+// Not thread safe, the owner serializes calls.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FANOUT_MAX_CLIENTS 8
+#define FANOUT_MAX_CHANNELS 16
+#define FANOUT_QUEUE_SIZE 16
+#define FANOUT_HISTORY_SIZE 32
+#define FANOUT_NAME_SIZE 16
+#define FANOUT_DATA_SIZE 96
+
+#define FANOUT_ALL_CHANNELS 0xFFFFFFFF
+
+struct FanoutEvent
+{
+    uint32_t id = 0;
+    uint32_t timestamp_ms = 0;
+    uint8_t channel = 0;
+    uint32_t source_us = 0; // acquisition timestamp of the carried value, 0 if none
+    char data[FANOUT_DATA_SIZE] = {0};
+};
+
+struct FanoutMetrics
+{
+    uint32_t clients = 0;
+    uint32_t published = 0;
+    uint32_t delivered = 0;
+    uint32_t dropped = 0;   // queue full (oldest event discarded), overwritten in history or send failed
+    uint32_t coalesced = 0; // replaced by a newer event of the same channel
+    uint32_t replayed = 0;  // sent from history on reconnect
+};
+
+class FanoutTransport
+{
+public:
+    // true if the client can take len bytes right now without buffering
+    virtual bool canSend(void *client, size_t len) = 0;
+    virtual bool send(void *client, const char *buffer, size_t len) = 0;
+    // event was written to the client, e.g. for latency tracing
+    virtual void delivered(void *client, const FanoutEvent &event) {}
+};
+
+class EventFanout
+{
+private:
+    struct Channel
+    {
+        char name[FANOUT_NAME_SIZE];
+        bool coalesce; // only the latest value matters, e.g. readings. messages are never coalesced
+    };
+
+    struct Client
+    {
+        void *handle = nullptr;
+        uint32_t channel_mask = FANOUT_ALL_CHANNELS;
+        uint32_t min_interval_ms = 0;
+        uint32_t last_sent_ms[FANOUT_MAX_CHANNELS] = {0};
+
+        // event ids, oldest first
+        uint32_t queue[FANOUT_QUEUE_SIZE];
+        uint8_t queue_count = 0;
+
+        uint32_t delivered = 0;
+        uint32_t dropped = 0;
+    };
+
+    FanoutTransport &_transport;
+
+    Channel _channels[FANOUT_MAX_CHANNELS];
+    uint8_t _channelCount = 0;
+
+    // ring of recent events, events are referenced by id from the client queues
+    FanoutEvent _history[FANOUT_HISTORY_SIZE];
+    uint32_t _nextId = 1;
+
+    Client _clients[FANOUT_MAX_CLIENTS];
+
+    FanoutMetrics _metrics;
+
+    Client *findClient(void *handle);
+    const FanoutEvent *findEvent(uint32_t id) const;
+    void enqueue(Client &client, const FanoutEvent &event);
+    void dequeue(Client &client, uint8_t index);
+    void serviceClient(Client &client, uint32_t now_ms);
+    size_t format(const FanoutEvent &event, char *buffer, size_t size) const;
+
+public:
+    EventFanout(FanoutTransport &transport);
+
+    // returns channel index or -1 if no slot left
+    int8_t registerChannel(const char *name, bool coalesce);
+    int8_t findChannel(const char *name) const;
+    const char *getChannelName(uint8_t channel) const;
+    // parse comma separated list of channel names into mask, empty list means all channels
+    uint32_t channelMask(const char *names) const;
+
+    // store event in history and queue it for all subscribed clients. returns event id
+    uint32_t publish(uint8_t channel, const char *data, uint32_t now_ms, uint32_t source_us = 0);
+
+    // last_id: id of the last event the client received before reconnecting, 0 for new clients
+    bool addClient(void *handle, uint32_t last_id, uint32_t channel_mask, uint32_t min_interval_ms);
+    void removeClient(void *handle);
+    bool setSubscription(void *handle, uint32_t channel_mask, uint32_t min_interval_ms);
+
+    // send queued events as far as the transport accepts them
+    void service(uint32_t now_ms);
+    void service(void *handle, uint32_t now_ms);
+
+    const FanoutMetrics &getMetrics() const { return _metrics; }
+    // a connected client takes the channel, producers of expensive channels skip the work otherwise
+    bool hasSubscribers(uint8_t channel) const;
+    uint32_t getQueued(void *handle);
+    uint32_t getDropped(void *handle);
+};
@@ -0,0 +1,85 @@
+#include <SampleBlock.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t decimalLength(uint32_t value)
+{
+    size_t length = 1;
+    while (value >= 10)
+    {
+        value /= 10;
+        length++;
+    }
+    return length;
+}
+
+bool SampleBlock::parse(const char *text, SampleBlock &block)
+{
+    char *end;
+    block.index = strtoul(text, &end, 10);
+    if (*end != ',')
+        return false;
+    block.first_us = strtoul(end + 1, &end, 10);
+    if (*end != ',')
+        return false;
+    block.span_us = strtoul(end + 1, &end, 10);
+    if (*end != ',')
+        return false;
+
+    block.count = 0;
+    while (*end == ',' && block.count < SAMPLEBLOCK_MAX_VALUES)
+    {
+        const char *start = end + 1;
+        block.values[block.count] = strtof(start, &end);
+        if (end == start)
+            return false;
+        block.count++;
+    }
+    return *end == 0 && block.count > 0;
+}
+
+bool SampleBlockWriter::add(uint32_t index, uint32_t timestamp_us, float value)
+{
+    if (_count == SAMPLEBLOCK_MAX_VALUES || (_count && index != _index + _count))
+        return false;
+
+    char text[24];
+    int length = snprintf(text, sizeof(text), "%s%.*f", _count ? "," : "", _digits, value);
+    if (length < 0 || length >= (int)sizeof(text))
+        return false;
+
+    // header with this sample as the last one, the terminating 0 included
+    uint32_t first_us = _count ? _first_us : timestamp_us;
+    size_t header = decimalLength(_count ? _index : index) + decimalLength(first_us) + decimalLength(timestamp_us - first_us) + 3;
+    if (header + _valuesLength + length + 1 > SAMPLEBLOCK_SIZE)
+        return false;
+
+    if (_count == 0)
+    {
+        _index = index;
+        _first_us = timestamp_us;
+    }
+    memcpy(_values + _valuesLength, text, length + 1);
+    _valuesLength += length;
+    _last_us = timestamp_us;
+    _count++;
+    return true;
+}
+
+void SampleBlockWriter::clear()
+{
+    _valuesLength = 0;
+    _values[0] = 0;
+    _count = 0;
+}
+
+const char *SampleBlockWriter::text()
+{
+    // add() made sure header and values fit
+    int header = snprintf(_text, sizeof(_text), "%u,%u,%u,", (unsigned)_index, (unsigned)_first_us, (unsigned)(_last_us - _first_us));
+    if (header > 0 && header + _valuesLength < sizeof(_text))
+        memcpy(_text + header, _values, _valuesLength + 1);
+    return _text;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// Payload of the "samples" event: consecutive samples of one box with their acquisition
+// timestamps, for aggregating several boxes (tools/host aggregator). Shared by firmware
+// (SampleEvents), simbox and aggregator. Must not depend on Arduino headers.
+//
+//   <index>,<first_us>,<span_us>,<value>,<value>,...
+//
+// index counts the samples of the stream, a jump means lost samples. first_us is the data
+// ready timestamp (micros(), wraps after 71.6 minutes) of the first value, span_us the time
+// to the last one. The adc clocks the conversions, values in between are evenly spaced.
+// A block fits one fan-out event.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <EventFanout.hpp>
+
+#define SAMPLEBLOCK_CHANNEL "samples"
+#define SAMPLEBLOCK_SIZE FANOUT_DATA_SIZE
+#define SAMPLEBLOCK_MAX_VALUES 32
+
+struct SampleBlock
+{
+    uint32_t index = 0;
+    uint32_t first_us = 0;
+    uint32_t span_us = 0;
+    uint16_t count = 0;
+    float values[SAMPLEBLOCK_MAX_VALUES];
+
+    // timestamp of value i, wraps like micros()
+    uint32_t timestamp(uint16_t i) const { return count > 1 ? first_us + (uint32_t)((uint64_t)span_us * i / (count - 1)) : first_us; }
+
+    // false if malformed
+    static bool parse(const char *text, SampleBlock &block);
+};
+
+class SampleBlockWriter
+{
+private:
+    char _values[SAMPLEBLOCK_SIZE];
+    size_t _valuesLength = 0;
+    char _text[SAMPLEBLOCK_SIZE];
+    uint32_t _index = 0;
+    uint32_t _first_us = 0;
+    uint32_t _last_us = 0;
+    uint16_t _count = 0;
+    uint8_t _digits = 3;
+
+public:
+    // decimals of the values that follow
+    void setDigits(uint8_t digits) { _digits = digits; }
+
+    // false if the sample does not fit or does not follow the last one (index), the block is
+    // unchanged then: send it, clear and add again
+    bool add(uint32_t index, uint32_t timestamp_us, float value);
+    void clear();
+
+    bool isEmpty() const { return _count == 0; }
+    uint16_t getCount() const { return _count; }
+    uint32_t getLastUs() const { return _last_us; }
+
+    // the payload, valid until the next add or clear
+    const char *text();
+};
@@ -2,6 +2,12 @@
 
 FuelgaugeClass g_Fuelgauge;
 
+// a higher priority reader may have preempted the gauge task in the middle of a publish
+static void snapshotBackoff()
+{
+    vTaskDelay(1);
+}
+
 FuelgaugeClass::FuelgaugeClass()
 {
     // on init construct with default variables
@@ -28,31 +34,41 @@ bool FuelgaugeClass::getGaugeAvailable()
     return _batteryGaugeAvail;
 }
 
+FuelgaugeStatus FuelgaugeClass::getStatus()
+{
+    return _status.read(nullptr, snapshotBackoff);
+}
+
 float FuelgaugeClass::getBatteryPercent()
 {
-    return (_batteryGaugeAvail) ? _batteryCellPercent : 0.0;
+    return getStatus().percent;
 }
 
 float FuelgaugeClass::getBatteryVoltage()
 {
-    return (_batteryGaugeAvail) ? _batteryVoltage : 0.0;
+    return getStatus().voltage;
 }
 
 float FuelgaugeClass::getChargeRate()
 {
-    return (_batteryGaugeAvail) ? _chargeRate : 0.0;
+    return getStatus().charge_rate;
 }
 
 void FuelgaugeClass::update_loop()
 {
     if (_batteryGaugeAvail)
     {
-        _batteryCellPercent = battery_gauge.cellPercent();
-        _batteryCellPercent = _batteryCellPercent < 0 ? 0 : _batteryCellPercent;     // limit to 0%
-        _batteryCellPercent = _batteryCellPercent > 100 ? 100 : _batteryCellPercent; // limit to 100%
+        FuelgaugeStatus status;
+        status.available = true;
+
+        status.percent = battery_gauge.cellPercent();
+        status.percent = status.percent < 0 ? 0 : status.percent;     // limit to 0%
+        status.percent = status.percent > 100 ? 100 : status.percent; // limit to 100%
+
+        status.voltage = battery_gauge.cellVoltage();
 
-        _batteryVoltage = battery_gauge.cellVoltage();
+        status.charge_rate = battery_gauge.chargeRate();
 
-        _chargeRate = battery_gauge.chargeRate();
+        _status.write(status);
     }
 }
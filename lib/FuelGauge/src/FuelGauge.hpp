@@ -2,6 +2,16 @@
 
 #include <Arduino.h>
 #include "Adafruit_MAX1704X.h"
+#include <Seqlock.hpp>
+
+// values of one gauge readout, all 0 if no gauge
+struct FuelgaugeStatus
+{
+    bool available = false;
+    float percent = 0;
+    float voltage = 0;
+    float charge_rate = 0; // %/h
+};
 
 class FuelgaugeClass
 {
@@ -9,9 +19,8 @@ private:
     Adafruit_MAX17048 battery_gauge;
 
     bool _batteryGaugeAvail = false;
-    float _batteryCellPercent = 0;
-    float _batteryVoltage = 0;
-    float _chargeRate = 0;
+    // written by the fuel gauge task, read by display, web and info output
+    Seqlock<FuelgaugeStatus> _status;
 
 public:
     FuelgaugeClass();
@@ -20,6 +29,8 @@ public:
     void update_loop();
     bool getGaugeAvailable();
 
+    FuelgaugeStatus getStatus();
+
     float getBatteryPercent();
     float getBatteryVoltage();
     float getChargeRate();
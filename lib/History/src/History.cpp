@@ -0,0 +1,112 @@
+#include <History.hpp>
+
+#include <esp_heap_caps.h>
+#include <MemoryPlan.hpp> // -->g_MemoryPlan
+
+HistoryClass g_History;
+
+HistoryClass::HistoryClass()
+{
+    // on init construct with default variables
+}
+
+void HistoryClass::initialize()
+{
+    log_i("History init");
+
+    _mutex = xSemaphoreCreateMutex();
+
+    size_t capacity = HISTORY_CAPACITY;
+    void *memory = heap_caps_malloc(HistoryStore::requiredMemory(capacity, HISTORY_LEVELS), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    bool psram = memory != NULL;
+    if (memory == NULL)
+    {
+        log_w("no PSRAM for history, using small buffer in internal RAM");
+        capacity = HISTORY_FALLBACK_CAPACITY;
+        memory = malloc(HistoryStore::requiredMemory(capacity, HISTORY_LEVELS));
+    }
+    // allocated once at boot, part of the memory plan
+    g_MemoryPlan.registerStatic("history", HistoryStore::requiredMemory(capacity, HISTORY_LEVELS), psram);
+
+    _available = _store.begin(memory, capacity, HISTORY_LEVELS, HISTORY_BASE_SAMPLES);
+    if (!_available)
+        log_e("history store setup failed");
+    else
+        log_i("history: %u levels x %u entries", HISTORY_LEVELS, capacity);
+}
+
+void HistoryClass::add(uint32_t t_ms, float value)
+{
+    if (!_available)
+        return;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _store.add(t_ms, value);
+    xSemaphoreGive(_mutex);
+}
+
+void HistoryClass::clear()
+{
+    if (!_available)
+        return;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _store.clear();
+    xSemaphoreGive(_mutex);
+}
+
+bool HistoryClass::getRange(uint32_t &oldest_ms, uint32_t &newest_ms)
+{
+    if (!_available)
+        return false;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    bool ok = _store.getRange(oldest_ms, newest_ms);
+    xSemaphoreGive(_mutex);
+    return ok;
+}
+
+void HistoryClass::printJson(Print &out, uint32_t from_ms, uint32_t to_ms, size_t points)
+{
+    if (points > HISTORY_MAX_POINTS)
+        points = HISTORY_MAX_POINTS;
+
+    out.print("{\"points\":[");
+
+    int8_t level = -1;
+    if (_available)
+    {
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        level = _store.selectLevel(from_ms, to_ms, points);
+        xSemaphoreGive(_mutex);
+    }
+
+    // copy in small chunks so acquisition never waits for the json formatting
+    HistoryEntry chunk[HISTORY_QUERY_CHUNK];
+    size_t count = 0;
+    bool first = true;
+
+    while (level >= 0 && count < points)
+    {
+        size_t n = 0;
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        _store.visitLevel(level, from_ms, to_ms, min(points - count, (size_t)HISTORY_QUERY_CHUNK), first, [&](const HistoryEntry &entry)
+                          { chunk[n++] = entry; });
+        xSemaphoreGive(_mutex);
+
+        if (n == 0)
+            break;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            out.printf("%s[%u,%g,%g,%g]", first ? "" : ",", chunk[i].t_ms, chunk[i].min, chunk[i].max, chunk[i].mean);
+            first = false;
+        }
+
+        count += n;
+        from_ms = chunk[n - 1].t_ms + 1;
+    }
+
+    out.printf("],\"level\":%d,\"samples_per_point\":%u}", level, level < 0 ? 0 : HISTORY_BASE_SAMPLES << level);
+}
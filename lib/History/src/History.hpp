@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+#include <HistoryStore.hpp>
+
+#define HISTORY_CAPACITY 4096        // entries per level
+#define HISTORY_LEVELS 12            // level 11 spans 2048x level 0
+#define HISTORY_BASE_SAMPLES 8       // samples per level 0 entry
+#define HISTORY_FALLBACK_CAPACITY 256 // without PSRAM
+#define HISTORY_MAX_POINTS 2000
+#define HISTORY_QUERY_CHUNK 64
+
+/// Session history of the converted readings for zoomable charts, see HistoryStore.
+/// Lives in PSRAM if available, fed by LoadcellClass per sample.
+class HistoryClass
+{
+private:
+    HistoryStore _store;
+    SemaphoreHandle_t _mutex = NULL;
+    bool _available = false;
+
+public:
+    HistoryClass();
+
+    void initialize();
+
+    // called from acquisition
+    void add(uint32_t t_ms, float value);
+
+    // stream entries as json to the print, e.g. an AsyncResponseStream
+    void printJson(Print &out, uint32_t from_ms, uint32_t to_ms, size_t points);
+    bool getRange(uint32_t &oldest_ms, uint32_t &newest_ms);
+
+    void clear();
+};
+
+extern HistoryClass g_History;
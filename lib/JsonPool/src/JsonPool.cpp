@@ -0,0 +1,121 @@
+#include <JsonPool.hpp>
+
+#include <Arduino.h>
+
+namespace JsonPool
+{
+    static uint8_t small_blocks[JSON_POOL_SMALL_BLOCKS][JSON_POOL_SMALL_SIZE] __attribute__((aligned(8)));
+    static uint8_t large_blocks[JSON_POOL_LARGE_BLOCKS][JSON_POOL_LARGE_SIZE] __attribute__((aligned(8)));
+
+    static uint32_t small_used = 0; // bit per block
+    static uint32_t large_used = 0;
+    static JsonPoolStats stats;
+    static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+    static int8_t take(uint32_t &used, uint8_t blocks)
+    {
+        for (uint8_t i = 0; i < blocks; i++)
+        {
+            if (!(used & (1UL << i)))
+            {
+                used |= 1UL << i;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    static bool contains(void *ptr, void *base, size_t size)
+    {
+        return (uint8_t *)ptr >= (uint8_t *)base && (uint8_t *)ptr < (uint8_t *)base + size;
+    }
+
+    void *allocate(size_t size)
+    {
+        void *block = nullptr;
+
+        portENTER_CRITICAL(&mux);
+        if (size <= JSON_POOL_SMALL_SIZE)
+        {
+            int8_t i = take(small_used, JSON_POOL_SMALL_BLOCKS);
+            if (i >= 0)
+            {
+                block = small_blocks[i];
+                stats.small_used++;
+                if (stats.small_used > stats.small_peak)
+                    stats.small_peak = stats.small_used;
+            }
+        }
+        // small requests may use a large block when the small ones are gone
+        if (block == nullptr && size <= JSON_POOL_LARGE_SIZE)
+        {
+            int8_t i = take(large_used, JSON_POOL_LARGE_BLOCKS);
+            if (i >= 0)
+            {
+                block = large_blocks[i];
+                stats.large_used++;
+                if (stats.large_used > stats.large_peak)
+                    stats.large_peak = stats.large_used;
+            }
+        }
+        if (block == nullptr)
+            stats.fallbacks++;
+        portEXIT_CRITICAL(&mux);
+
+        return block ? block : malloc(size);
+    }
+
+    void deallocate(void *ptr)
+    {
+        if (ptr == nullptr)
+            return;
+
+        if (contains(ptr, small_blocks, sizeof(small_blocks)))
+        {
+            uint8_t i = ((uint8_t *)ptr - &small_blocks[0][0]) / JSON_POOL_SMALL_SIZE;
+            portENTER_CRITICAL(&mux);
+            small_used &= ~(1UL << i);
+            stats.small_used--;
+            portEXIT_CRITICAL(&mux);
+        }
+        else if (contains(ptr, large_blocks, sizeof(large_blocks)))
+        {
+            uint8_t i = ((uint8_t *)ptr - &large_blocks[0][0]) / JSON_POOL_LARGE_SIZE;
+            portENTER_CRITICAL(&mux);
+            large_used &= ~(1UL << i);
+            stats.large_used--;
+            portEXIT_CRITICAL(&mux);
+        }
+        else
+            free(ptr);
+    }
+
+    void *reallocate(void *ptr, size_t new_size)
+    {
+        // documents only shrink (shrinkToFit), a pool block can stay as it is
+        if ((contains(ptr, small_blocks, sizeof(small_blocks)) && new_size <= JSON_POOL_SMALL_SIZE) ||
+            (contains(ptr, large_blocks, sizeof(large_blocks)) && new_size <= JSON_POOL_LARGE_SIZE))
+            return ptr;
+
+        if (ptr != nullptr && !contains(ptr, small_blocks, sizeof(small_blocks)) && !contains(ptr, large_blocks, sizeof(large_blocks)))
+            return realloc(ptr, new_size);
+
+        // grow out of a pool block
+        size_t old_size = contains(ptr, small_blocks, sizeof(small_blocks)) ? JSON_POOL_SMALL_SIZE : JSON_POOL_LARGE_SIZE;
+        void *block = allocate(new_size);
+        if (block != nullptr && ptr != nullptr)
+        {
+            memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+            deallocate(ptr);
+        }
+        return block;
+    }
+
+    JsonPoolStats getStats()
+    {
+        portENTER_CRITICAL(&mux);
+        JsonPoolStats copy = stats;
+        portEXIT_CRITICAL(&mux);
+        return copy;
+    }
+}
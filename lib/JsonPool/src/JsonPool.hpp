@@ -0,0 +1,41 @@
+#pragma once
+
+// Fixed pool for ArduinoJson documents. Config load/save and the web handlers take their
+// document memory from static blocks instead of the heap, so short lived documents of a few
+// kB do not fragment it. A request larger than a block or with the pool exhausted falls back
+// to the heap and is counted.
+// Portable apart from the critical section (portMUX), host tools get it from the Arduino.h
+// stand-in in tools/host/shim.
+
+#include <ArduinoJson.h>
+
+#define JSON_POOL_SMALL_SIZE 1024
+#define JSON_POOL_SMALL_BLOCKS 8
+#define JSON_POOL_LARGE_SIZE 6144
+#define JSON_POOL_LARGE_BLOCKS 3
+
+struct JsonPoolStats
+{
+    uint8_t small_used = 0;
+    uint8_t small_peak = 0;
+    uint8_t large_used = 0;
+    uint8_t large_peak = 0;
+    uint32_t fallbacks = 0; // heap allocations
+};
+
+namespace JsonPool
+{
+    void *allocate(size_t size);
+    void deallocate(void *ptr);
+    void *reallocate(void *ptr, size_t new_size);
+    JsonPoolStats getStats();
+}
+
+struct JsonPoolAllocator
+{
+    void *allocate(size_t size) { return JsonPool::allocate(size); }
+    void deallocate(void *ptr) { JsonPool::deallocate(ptr); }
+    void *reallocate(void *ptr, size_t new_size) { return JsonPool::reallocate(ptr, new_size); }
+};
+
+typedef BasicJsonDocument<JsonPoolAllocator> PooledJsonDocument;
@@ -1,7 +1,26 @@
 #include <Loadcell.hpp>
 
+#include <Capture.hpp>      // -->g_Capture
+#include <SerialStream.hpp> // -->g_SerialStream
+#include <History.hpp>      // -->g_History
+#include <Trace.hpp>        // -->g_Trace
+#include <Mqtt.hpp>         // -->g_Mqtt
+#include <SampleEvents.hpp> // -->g_SampleEvents
+#include <Alarm.hpp>        // -->g_Alarm
+#include <Spectrum.hpp>     // -->g_Spectrum
+#include <MemoryPlan.hpp>   // -->g_MemoryPlan
+
+#define TEMP_LEARN_START 1
+#define TEMP_LEARN_STOP 2
+
 LoadcellClass g_Loadcell;
 
+// readers may preempt the acquisition task in the middle of a publish, let it finish
+static void snapshotBackoff()
+{
+    vTaskDelay(1);
+}
+
 LoadcellClass::LoadcellClass()
 {
     // on init construct with default variables
@@ -10,17 +29,23 @@ LoadcellClass::LoadcellClass()
 // Record the current system settings to EEPROM
 void LoadcellClass::initialize(void)
 {
+    _configLock = xSemaphoreCreateMutexStatic(&_configLockBuffer);
+    _messages = xQueueCreateStatic(LOADCELL_MESSAGE_QUEUE_SIZE, sizeof(Message), _messagesStorage, &_messagesStruct);
+    g_MemoryPlan.registerStatic("loadcell messages", sizeof(_messagesStorage));
 
-    if (!nau7802_adc.begin())
+    if (!adc.begin())
     {
         log_w("Scale not detected. Please check wiring. Retry...");
         delay(1000);
-        if (!nau7802_adc.begin())
+        if (!adc.begin())
             log_e("Scale not detected in second run. Ignoring...");
     }
 
     this->cbLoadConfiguration(); // Load zeroOffset and calibrationFactor from EEPROM
 
+    g_History.initialize(); // before the first sample is added
+    g_Alarm.initialize();
+
     // register events
 
     // commands
@@ -33,6 +58,31 @@ void LoadcellClass::initialize(void)
                 this->cmdZeroOffsetTare();
             } });
 
+    EventManager::instance().subscribe([&](Event *ev)
+                                       {
+            if (ev->is("Loadcell/setSampleRate"))
+            {
+                log_d("Loadcell/setSampleRate, value %s", ((DataEvent *)ev)->data().c_str());
+
+                this->cmdSetSampleRate(((DataEvent *)ev)->data().toInt());
+            } });
+
+    EventManager::instance().subscribe([&](Event *ev)
+                                       {
+            if (ev->is("Loadcell/resetstats"))
+            {
+                log_d("Loadcell/resetstats");
+
+                this->cmdResetStats();
+            } });
+
+    EventManager::instance().subscribe([&](Event *ev)
+                                       {
+            if (ev->is("Loadcell/displacement"))
+            {
+                this->cmdSetDisplacement(((DataEvent *)ev)->data().toFloat());
+            } });
+
     EventManager::instance().subscribe([&](Event *ev)
                                        {
             if (ev->is("Loadcell/calibrateToKnownValue"))
@@ -42,6 +92,19 @@ void LoadcellClass::initialize(void)
                 this->cmdCalcCalibrationFactor(((DataEvent *)ev)->data().toFloat());
         } });
 
+    EventManager::instance().subscribe([&](Event *ev)
+                                       {
+            if (ev->is("Loadcell/tempLearn"))
+            {
+                // "start,<known load>" or "stop"
+                String data = ((DataEvent *)ev)->data();
+                log_d("Loadcell/tempLearn, value %s", data.c_str());
+
+                int comma = data.indexOf(',');
+                bool start = data.startsWith("start");
+                this->cmdTempLearn(start, comma > 0 ? data.substring(comma + 1).toFloat() : 0.0);
+        } });
+
     EventManager::instance().subscribe([&](Event *ev)
                                        {
             if (ev->is("*/saveconfiguration"))
@@ -63,88 +126,511 @@ void LoadcellClass::initialize(void)
 
 void LoadcellClass::cbSaveConfiguration(void)
 {
+    xSemaphoreTake(_configLock, portMAX_DELAY);
     sensor_config.saveConfiguration();
     adc_config.saveConfiguration();
+    xSemaphoreGive(_configLock);
 }
 void LoadcellClass::cbLoadConfiguration(void)
 {
+    xSemaphoreTake(_configLock, portMAX_DELAY);
     sensor_config.loadConfiguration();
     adc_config.loadConfiguration();
     postConfigChange();
+    xSemaphoreGive(_configLock);
 }
-void LoadcellClass::postConfigChange(void)
+void LoadcellClass::postConfigChange(uint8_t changes)
 {
-    log_i("postConfigChange triggered");
+    log_i("postConfigChange triggered, changes 0x%02x", changes);
 
-    // reset average
-    _readingDisplayunitFiltered.clear();
-
-    sensor_scale_factor = ((float)adc_resolution * (float)(1 << adc_config.gain) * ((sensor_config.sensitivity * adc_config.cali_gain_factor))) / (1000.0 * sensor_config.fullrange);
-    sensor_zero_balance_raw = (int)((sensor_config.zerobalance - adc_config.cali_offset) * (float)adc_resolution * (float)(1 << adc_config.gain) / 1000.0);
+    // the pipeline and the adc belong to the acquisition task, it must not read a config that
+    // is written meanwhile. The copy is made here, the acquisition task only swaps pointers
+    _staged->sensor = sensor_config;
+    _staged->adc = adc_config;
+    _configChangeRequest.fetch_or(changes);
+}
+uint8_t LoadcellClass::configFromWeb(JsonVariant sensor, JsonVariant adc)
+{
+    xSemaphoreTake(_configLock, portMAX_DELAY);
+    SensorConfig previous_sensor = sensor_config;
+    AdcConfig previous_adc = adc_config;
 
-    log_i("sensor_scale_factor: %0.2f", sensor_scale_factor);
-    log_i("sensor_zero_balance_raw: %i", sensor_zero_balance_raw);
+    sensor_config.fromWeb(sensor);
+    adc_config.fromWeb(adc);
 
-    log_i("adc setRate %i", adc_config.samplerate);
-    nau7802_adc.setRate(adc_config.samplerate);
-    log_i("adc setGain %i", adc_config.gain);
-    nau7802_adc.setGain(adc_config.gain);
-    log_i("adc setLDO %i", adc_config.ldovoltage);
-    nau7802_adc.setLDO(adc_config.ldovoltage);
+    uint8_t changes = sensor_config.changesFrom(previous_sensor) | adc_config.changesFrom(previous_adc);
+    if (changes != CONFIG_CHANGE_NONE)
+        postConfigChange(changes);
+    xSemaphoreGive(_configLock);
+    return changes;
+}
+void LoadcellClass::applyConfigChange(uint8_t changes)
+{
+    uint32_t start_us = micros();
+    ConfigApplyKind kind = CONFIG_APPLY_PRESENTATION;
+    if (changes & CONFIG_CHANGE_ADC)
+        kind = CONFIG_APPLY_ADC;
+    else if (changes & CONFIG_CHANGE_SCALE)
+        kind = CONFIG_APPLY_SCALE;
 
-    // Take 4 readings to flush out readings
-    for (uint8_t i = 0; i < 4; i++)
+    if (changes & CONFIG_CHANGE_ADC)
     {
-        while (!nau7802_adc.available())
-            delay(1);
-        nau7802_adc.read();
+        // leave a running temperature slot, the adc is reconfigured below
+        if (_tempSlot)
+        {
+            adc.setTemperatureInput(false);
+            _tempSlot = false;
+        }
+        _samplesSinceTemp = 0;
+
+        log_i("adc %s configure", AdcBackend::NAME);
+        adc.configure(_applied->adc);
+        _samplePeriodUs = 1000000.0f / getSampleRate();
     }
 
-    // Re-cal analog front end when we change gain, sample rate, or channel
-    // removes internal offset and gain error.
-    if (!nau7802_adc.calibrate(NAU7802_CALMOD_INTERNAL))
-        log_e("NAU7802_CALMOD_INTERNAL calibration failed!");
-    else
-        log_i("NAU7802_CALMOD_INTERNAL calibration successful.");
+    // after the adc, the hum filter is designed for its sample rate.
+    // presentation: display and web read sensor_config
+    if (changes & (CONFIG_CHANGE_SCALE | CONFIG_CHANGE_ADC))
+        applyPipelineConfig();
+
+    _params.write(_pipeline.getParams());
+    publishTelemetry();
+
+    // the next sample closes the gap, see update_loop
+    _applyStatus.count[kind]++;
+    _applyStatus.apply_us_last[kind] = micros() - start_us;
+    _applyStatus.sample_period_us = _samplePeriodUs;
+    _gapPending = current_reading_micros != 0 ? kind : -1;
+    _gapStart_us = current_reading_micros;
+    _applyStatusSnapshot.write(_applyStatus);
+}
+void LoadcellClass::applyPipelineConfig(void)
+{
+    const SensorConfig &sensor = _applied->sensor;
+    const AdcConfig &adc_settings = _applied->adc;
+
+    PipelineParams params;
+    params.sensor_scale_factor = PipelineParams::calcScaleFactor(AdcBackend::FULL_SCALE_COUNTS, adc_settings.gain, sensor.sensitivity, adc_settings.cali_gain_factor, sensor.fullrange);
+    params.sensor_zero_balance_raw = PipelineParams::calcZeroBalanceRaw(AdcBackend::FULL_SCALE_COUNTS, adc_settings.gain, sensor.zerobalance, adc_settings.cali_offset);
+    params.filter_size = AVG_SIZE;
+    params.temp_zero_coeff = sensor.temp_zero_coeff;
+    params.temp_span_coeff = sensor.temp_span_coeff;
+    params.temp_reference = sensor.temp_reference;
+    params.hum.mode = (HumFilterMode)sensor.hum_filter;
+    params.hum.mains_hz = sensor.hum_mains_hz;
+    params.hum.q = sensor.hum_q;
+    params.hum.harmonics = sensor.hum_harmonics;
+    params.derived.rate_window = sensor.rate_window;
+    // glitch thresholds relative to the span of the sensor in counts
+    float span_counts = fabsf(sensor.fullrange * params.sensor_scale_factor);
+    params.glitch.enabled = sensor.glitch_filter != 0;
+    params.glitch.k = sensor.glitch_k;
+    params.glitch.min_deviation = (int32_t)(sensor.glitch_floor * span_counts);
+    params.glitch.max_step = (int32_t)(sensor.glitch_max_step * span_counts);
+    params.sample_rate = getSampleRate();
+
+    // reset average
+    _pipeline.configure(params);
+
+    log_i("sensor_scale_factor: %0.2f", params.sensor_scale_factor);
+    log_i("sensor_zero_balance_raw: %i", params.sensor_zero_balance_raw);
+
+    if (adc_settings.temp_interval_samples == 0)
+    {
+        _temperature = NAN;
+        _pipeline.setTemperature(NAN);
+    }
 }
 
 // getter for external readout
+LoadcellTelemetry LoadcellClass::getTelemetry()
+{
+    uint32_t sequence;
+    LoadcellTelemetry telemetry = _telemetry.read(&sequence, snapshotBackoff);
+    telemetry.sequence = sequence;
+    return telemetry;
+}
 int32_t LoadcellClass::getReadingRaw()
 {
-    return current_reading_raw;
+    return getTelemetry().raw;
+}
+uint32_t LoadcellClass::getReadingMillis()
+{
+    return getTelemetry().millis;
+}
+uint32_t LoadcellClass::getReadingMicros()
+{
+    return getTelemetry().micros;
 }
 float LoadcellClass::getReadingDisplayunitFiltered()
 {
-    return _readingDisplayunitFiltered.getAverage();
+    return getTelemetry().filtered;
 }
+PipelineStats LoadcellClass::getStats()
+{
+    return getTelemetry().stats;
+}
+PipelineParams LoadcellClass::getPipelineParams()
+{
+    return _params.read(nullptr, snapshotBackoff);
+}
+void LoadcellClass::waitReady()
+{
+    adc.waitReady(1);
+}
+TemperatureStatus LoadcellClass::getTemperatureStatus()
+{
+    return getTelemetry().temperature;
+}
+float LoadcellClass::getChannel(const LoadcellTelemetry &telemetry, uint8_t channel)
+{
+    switch (channel)
+    {
+    case CHANNEL_RATE:
+        return telemetry.rate;
+    case CHANNEL_IMPULSE:
+        return telemetry.impulse;
+    case CHANNEL_WORK:
+        return telemetry.work;
+    default:
+        return telemetry.filtered;
+    }
+}
+ConfigApplyStatus LoadcellClass::getConfigApplyStatus()
+{
+    return _applyStatusSnapshot.read(nullptr, snapshotBackoff);
+}
+void LoadcellClass::publishTelemetry()
+{
+    LoadcellTelemetry telemetry;
+    telemetry.raw = current_reading_raw;
+    telemetry.millis = current_reading_millis;
+    telemetry.micros = current_reading_micros;
+    telemetry.converted = _pipeline.getConverted();
+    telemetry.filtered = _pipeline.getFiltered();
+    telemetry.rate = _pipeline.getDerived().getRate();
+    telemetry.impulse = _pipeline.getDerived().getImpulse();
+    telemetry.work = _pipeline.getDerived().getWork();
+    telemetry.stats = _pipeline.getStats();
+    telemetry.hum_sample_rate = _pipeline.getHumFilter().getSampleRate();
+    telemetry.glitch = _pipeline.getGlitch();
 
-// commands triggered externally
-void LoadcellClass::cmdZeroOffsetTare()
+    TemperatureStatus &status = telemetry.temperature;
+    status.temperature = _temperature;
+    status.compensating = !isnan(_temperature) && (_applied->sensor.temp_zero_coeff != 0.0f || _applied->sensor.temp_span_coeff != 0.0f);
+    status.conversions = _tempConversions;
+    status.held_samples = _heldSamples;
+    if (_applied->adc.temp_interval_samples > 0)
+        status.load_sample_ratio = (float)_applied->adc.temp_interval_samples / (_applied->adc.temp_interval_samples + 2 * _applied->adc.temp_settle_samples + 1);
+    status.learning = _tempLearning;
+    status.learn_load = _tempLearnLoad;
+    status.learn_points = _tempLearner.getPoints();
+    status.learn_temp_span = _tempLearner.getTemperatureSpan();
+
+    _telemetry.write(telemetry);
+}
+float LoadcellClass::getSampleRate()
 {
-    sensor_zero_balance_raw = current_reading_raw;
+    return adc.getSampleRate();
+}
 
-    DataEvent ev("Webservice/sendMessage", "new zero offset: " + String(sensor_zero_balance_raw));
-    EventManager::instance().publish(ev);
+// commands triggered externally, applied in the acquisition task
+void LoadcellClass::cmdZeroOffsetTare()
+{
+    _tareRequest = true;
+}
+void LoadcellClass::cmdSetSampleRate(uint8_t samplerate)
+{
+    xSemaphoreTake(_configLock, portMAX_DELAY);
+    if (adc_config.samplerate != (decltype(adc_config.samplerate))samplerate)
+    {
+        adc_config.samplerate = (decltype(adc_config.samplerate))samplerate;
+        postConfigChange(CONFIG_CHANGE_ADC | CONFIG_CHANGE_SCALE);
+    }
+    xSemaphoreGive(_configLock);
+}
+void LoadcellClass::cmdTempLearn(bool start, float load)
+{
+    _tempLearnRequestLoad = load;
+    _tempLearnRequest = start ? TEMP_LEARN_START : TEMP_LEARN_STOP;
+}
+void LoadcellClass::cmdSetDisplacement(float displacement)
+{
+    _displacement = displacement;
+}
+void LoadcellClass::cmdResetStats()
+{
+    _resetStatsRequest = true;
+    g_Alarm.cmdResetStats();
 }
 void LoadcellClass::cmdCalcCalibrationFactor(float knownReference)
 {
     // step 1: tare
     // step 2: put known weight on scale
     // step 3: calc cal factor
-    // TODO: nau7802_adc.calculateCalibrationFactor(knownReference);
+    // TODO: calculateCalibrationFactor(knownReference);
     // step 4: store cal factor
 
-    DataEvent ev("Webservice/sendMessage", "new calibraction factor: " + String(sensor_scale_factor));
-    EventManager::instance().publish(ev);
+    Message message = {MESSAGE_CALIBRATION};
+    message.value = getPipelineParams().sensor_scale_factor;
+    queueMessage(message);
+}
+
+void LoadcellClass::queueMessage(const Message &message)
+{
+    xQueueSend(_messages, &message, 0); // never block acquisition, drop if nobody drains
+}
+
+void LoadcellClass::publishMessages()
+{
+    Message message;
+    while (xQueueReceive(_messages, &message, 0) == pdTRUE)
+    {
+        String text;
+        switch (message.kind)
+        {
+        case MESSAGE_ZERO_OFFSET:
+            text = "new zero offset: " + String(message.raw);
+            break;
+        case MESSAGE_CALIBRATION:
+            text = "new calibraction factor: " + String(message.value);
+            break;
+        case MESSAGE_TEMP_LEARN_UNSUPPORTED:
+            text = String("temperature learning not supported by ") + AdcBackend::NAME;
+            break;
+        case MESSAGE_TEMP_LEARN_NO_INTERVAL:
+            text = "temperature learning needs temp_interval_samples > 0";
+            break;
+        case MESSAGE_TEMP_LEARN_STARTED:
+            text = message.load == 0.0f ? "temperature learning started, zero coefficient" : "temperature learning started, span coefficient at load " + String(message.load);
+            break;
+        case MESSAGE_TEMP_LEARN_FAILED:
+            text = "temperature learning failed, " + String(message.points) + " points over " + String(message.temp_span, 1) + " degC";
+            break;
+        case MESSAGE_TEMP_LEARN_DONE:
+            text = String(message.load == 0.0f ? "new temp_zero_coeff: " : "new temp_span_coeff: ") + String(message.value, 6) +
+                   ", r2: " + String(message.r2, 3) + ", " + String(message.points) + " points over " +
+                   String(message.temp_span, 1) + " degC";
+            break;
+        }
+
+        DataEvent ev("Webservice/sendMessage", text);
+        EventManager::instance().publish(ev);
+    }
+}
+
+// returns true if the conversion is not a load sample (settling or temperature)
+bool LoadcellClass::updateTemperatureSlot(int32_t raw)
+{
+    uint8_t settle = _applied->adc.temp_settle_samples;
+
+    if (!_tempSlot)
+    {
+        if (!AdcBackend::HAS_TEMPERATURE || _applied->adc.temp_interval_samples == 0 || ++_samplesSinceTemp < _applied->adc.temp_interval_samples)
+            return false;
+
+        // this one is still a load sample, the following conversions see the temperature sensor
+        _samplesSinceTemp = 0;
+        _tempSlot = adc.setTemperatureInput(true);
+        _tempSlotIndex = 0;
+        return false;
+    }
+
+    _heldSamples++;
+    uint8_t index = _tempSlotIndex++;
+
+    // a failed read keeps the previous temperature
+    if (index == settle && !adc.readFailed())
+    {
+        float temp = adc.convertTemperature(raw);
+        _temperature = isnan(_temperature) ? temp : _temperature + TEMP_SMOOTHING * (temp - _temperature);
+        _tempConversions++;
+        _pipeline.setTemperature(_temperature);
+
+        if (_tempLearning && _tempLearnCount > 0)
+        {
+            _tempLearner.add(_temperature, _tempLearnSum / _tempLearnCount);
+            _tempLearnSum = 0.0;
+            _tempLearnCount = 0;
+        }
+    }
+    if (index == settle)
+        adc.setTemperatureInput(false);
+    if (index >= 2 * settle)
+        _tempSlot = false;
+
+    return true;
+}
+
+void LoadcellClass::applyTempLearnRequest()
+{
+    uint8_t request = _tempLearnRequest;
+    if (request == 0)
+        return;
+    _tempLearnRequest = 0;
+
+    Message message = {};
+    if (request == TEMP_LEARN_START)
+    {
+        if (!AdcBackend::HAS_TEMPERATURE)
+        {
+            message.kind = MESSAGE_TEMP_LEARN_UNSUPPORTED;
+        }
+        else if (_applied->adc.temp_interval_samples == 0)
+        {
+            message.kind = MESSAGE_TEMP_LEARN_NO_INTERVAL;
+        }
+        else
+        {
+            _tempLearner.reset();
+            _tempLearnLoad = _tempLearnRequestLoad;
+            _tempLearnSum = 0.0;
+            _tempLearnCount = 0;
+            _tempLearning = true;
+            message.kind = MESSAGE_TEMP_LEARN_STARTED;
+            message.load = _tempLearnLoad;
+        }
+    }
+    else if (_tempLearning)
+    {
+        _tempLearning = false;
+
+        TempCoeffResult result;
+        if (!_tempLearner.solve(result))
+        {
+            message.kind = MESSAGE_TEMP_LEARN_FAILED;
+            message.points = result.points;
+            message.temp_span = _tempLearner.getTemperatureSpan();
+        }
+        else
+        {
+            if (_tempLearnLoad == 0.0f)
+                _applied->sensor.temp_zero_coeff = result.slope;
+            else
+                _applied->sensor.temp_span_coeff = result.slope / _tempLearnLoad;
+            applyConfigChange(CONFIG_CHANGE_SCALE);
+            _coeffsLearned = true;
+
+            message.kind = MESSAGE_TEMP_LEARN_DONE;
+            message.load = _tempLearnLoad;
+            message.value = _tempLearnLoad == 0.0f ? _applied->sensor.temp_zero_coeff : _applied->sensor.temp_span_coeff;
+            message.r2 = result.r2;
+            message.points = result.points;
+            message.temp_span = result.temp_max - result.temp_min;
+        }
+    }
+    else
+        return;
+
+    queueMessage(message);
+}
+
+void LoadcellClass::applyRequests()
+{
+    // a command holding the config lock is not waited for, the next sample tries again
+    if ((_configChangeRequest != CONFIG_CHANGE_NONE || _coeffsLearned) && xSemaphoreTake(_configLock, 0) == pdTRUE)
+    {
+        // learned coefficients go into the config for the next save, and into a staged copy
+        // that is not applied yet
+        if (_coeffsLearned)
+        {
+            sensor_config.temp_zero_coeff = _staged->sensor.temp_zero_coeff = _applied->sensor.temp_zero_coeff;
+            sensor_config.temp_span_coeff = _staged->sensor.temp_span_coeff = _applied->sensor.temp_span_coeff;
+            _coeffsLearned = false;
+        }
+        uint8_t changes = _configChangeRequest.exchange(CONFIG_CHANGE_NONE);
+        if (changes != CONFIG_CHANGE_NONE)
+            std::swap(_applied, _staged);
+        xSemaphoreGive(_configLock);
+
+        if (changes != CONFIG_CHANGE_NONE)
+            applyConfigChange(changes);
+    }
+
+    if (_tareRequest)
+    {
+        _tareRequest = false;
+        _pipeline.setZeroBalanceRaw(current_reading_raw);
+        _pipeline.resetIntegrals();
+        // zero now belongs to the current temperature
+        if (!isnan(_temperature))
+            _pipeline.setTemperatureReference(_temperature);
+        _params.write(_pipeline.getParams());
+
+        Message message = {MESSAGE_ZERO_OFFSET};
+        message.raw = current_reading_raw;
+        queueMessage(message);
+    }
+
+    if (_resetStatsRequest)
+    {
+        _resetStatsRequest = false;
+        _pipeline.resetStats();
+    }
+
+    applyTempLearnRequest();
+
+    // sample and hold, the work integral uses the latest displacement per load sample
+    _pipeline.setDisplacement(_displacement);
 }
 
 void LoadcellClass::update_loop()
 {
-    if (nau7802_adc.available() == true)
+    applyRequests();
+
+    if (adc.available() == true)
     {
-        current_reading_raw = nau7802_adc.read();
+        uint32_t timestamp_us = micros();
+        int32_t raw = adc.read();
+        bool read_error = adc.readFailed();
+        // during a temperature slot the last load sample is repeated, consumers keep their rate
+        bool held = updateTemperatureSlot(raw);
+        if (!held)
+        {
+            current_reading_raw = raw;
+
+            // first load sample after a config apply
+            if (_gapPending >= 0)
+            {
+                uint32_t gap_us = timestamp_us - _gapStart_us;
+                _applyStatus.gap_us_last[_gapPending] = gap_us;
+                if (gap_us > _applyStatus.gap_us_max[_gapPending])
+                    _applyStatus.gap_us_max[_gapPending] = gap_us;
+                _gapPending = -1;
+                _applyStatusSnapshot.write(_applyStatus);
+            }
+        }
+        current_reading_millis = millis();
+        g_Trace.record(TRACE_ADC_READ, timestamp_us);
+
+        // reject glitches, convert to displayunit: y=(x-b)/m and filter. A held sample was checked already
+        _pipeline.process(current_reading_raw, timestamp_us, read_error && !held);
+        current_reading_raw = _pipeline.getRaw();
+        current_reading_micros = timestamp_us;
+        g_Trace.record(TRACE_FILTER, timestamp_us);
+
+        if (_tempLearning && !held)
+        {
+            // span: the zero coefficient is known already and must not end up in the slope
+            float value = _pipeline.getUncompensated();
+            if (_tempLearnLoad != 0.0f && !isnan(_temperature))
+                value -= _applied->sensor.temp_zero_coeff * (_temperature - _pipeline.getParams().temp_reference);
+            _tempLearnSum += value;
+            _tempLearnCount++;
+        }
+
+        // alarms first, everything below may take longer. Before the hum filter, its group delay
+        // would hold back the edge
+        g_Alarm.process(_pipeline.getAlarmInput(), timestamp_us, _samplePeriodUs);
+
+        publishTelemetry();
 
-        // convert to displayunit: y=(x-b)/m
-        _readingDisplayunitFiltered.add(((current_reading_raw - sensor_zero_balance_raw) / sensor_scale_factor));
+        g_History.add(current_reading_millis, _pipeline.getConverted());
+        float stream_value = _pipeline.getDerived().get((DerivedChannel)_applied->sensor.stream_channel, _pipeline.getConverted());
+        g_Mqtt.push(current_reading_millis, stream_value);
+        g_SampleEvents.push(timestamp_us, stream_value);
+        g_Capture.push(timestamp_us, current_reading_raw);
+        g_SerialStream.push(timestamp_us, current_reading_raw);
+        g_Spectrum.push(_pipeline.getConverted());
     }
 }
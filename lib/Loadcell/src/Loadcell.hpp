@@ -1,34 +1,172 @@
 #pragma once
 
 #define AVG_SIZE 8
-#define ADC_RESOLUTION 24
+#define TEMP_SMOOTHING 0.2 // exponential smoothing of the temperature conversions
+#define LOADCELL_MESSAGE_QUEUE_SIZE 4
 
 #include <Arduino.h>
-#include <RunningMedian.h>
+#include <freertos/queue.h>
+#include <atomic>
 #include <DataEvent.hpp>
-#include <Adafruit_NAU7802.h>
 #include <ConfigStructs.hpp>
+#include <AdcBackend.hpp>
+#include <LoadcellPipeline.hpp>
+#include <TempCoeffLearner.hpp>
+#include <Seqlock.hpp>
 
 using namespace esp32m;
 
-class LoadcellClass
+struct TemperatureStatus
 {
-private:
-    // Create instance of the NAU7802 class
-    Adafruit_NAU7802 nau7802_adc;
+    float temperature = NAN; // degC, NAN until the first conversion or if disabled
+    bool compensating = false;
+    uint32_t conversions = 0;
+    uint32_t held_samples = 0;    // samples repeated while the adc measured temperature
+    float load_sample_ratio = 1.0; // share of adc conversions spent on the load cell
+    bool learning = false;
+    float learn_load = 0.0;
+    uint32_t learn_points = 0;
+    float learn_temp_span = 0.0;
+};
+
+// kinds of config apply, by the most expensive group in the change
+enum ConfigApplyKind : uint8_t
+{
+    CONFIG_APPLY_PRESENTATION = 0,
+    CONFIG_APPLY_SCALE = 1,
+    CONFIG_APPLY_ADC = 2,
+    CONFIG_APPLY_KINDS = 3,
+};
 
-    // settings, constants, ...
-    const int32_t adc_resolution = 1 << ADC_RESOLUTION;
+// cost of config changes per kind. gap: time between the last sample before and the first
+// sample after the apply, one sample period means no sample was lost
+struct ConfigApplyStatus
+{
+    uint32_t count[CONFIG_APPLY_KINDS] = {};
+    uint32_t apply_us_last[CONFIG_APPLY_KINDS] = {};
+    uint32_t gap_us_last[CONFIG_APPLY_KINDS] = {};
+    uint32_t gap_us_max[CONFIG_APPLY_KINDS] = {};
+    uint32_t sample_period_us = 0;
+};
+
+// published by the acquisition task after every sample, readers in other tasks get a
+// consistent copy without locking, see Seqlock.hpp
+struct LoadcellTelemetry
+{
+    uint32_t sequence = 0; // publish counter, set by getTelemetry
+    int32_t raw = 0;
+    uint32_t millis = 0;
+    uint32_t micros = 0; // data ready timestamp, identifies the sample for latency tracing
+    float converted = NAN;
+    float filtered = NAN;
+    float rate = NAN;    // displayunit per s
+    float impulse = 0.0; // displayunit * s since tare
+    float work = NAN;    // displayunit * displacement unit since tare, NAN without displacement
+    PipelineStats stats;
+    TemperatureStatus temperature;
+    float hum_sample_rate = 0; // rate the hum filter is designed for, measured once known
+    uint8_t glitch = 0;        // GlitchReason mask of this sample, counters in stats
+};
 
-    // temporary results to convert readings to displayunit
-    float sensor_scale_factor = 0;
-    int32_t sensor_zero_balance_raw = 0;
+class LoadcellClass
+{
+private:
+    // adc chip selected at compile time, see AdcBackend.hpp
+    AdcBackend adc;
 
     // readings and converted readings
     int32_t current_reading_raw = 0;
-    RunningMedian _readingDisplayunitFiltered = RunningMedian(AVG_SIZE);
+    uint32_t current_reading_millis = 0;
+    uint32_t current_reading_micros = 0; // data ready timestamp, identifies the sample for latency tracing
+    LoadcellPipeline _pipeline;
+    uint32_t _samplePeriodUs = 0; // nominal, from the configured sample rate
+
+    // snapshots for readers in other tasks, the pipeline itself is only touched by the acquisition task
+    Seqlock<LoadcellTelemetry> _telemetry;
+    Seqlock<PipelineParams> _params;
+
+    // acquisition gap measurement of the last config apply
+    ConfigApplyStatus _applyStatus;
+    Seqlock<ConfigApplyStatus> _applyStatusSnapshot;
+    int8_t _gapPending = -1; // ConfigApplyKind waiting for the next sample
+    uint32_t _gapStart_us = 0;
+
+    // config as applied, read only by the acquisition task. Commands change sensor_config and
+    // adc_config under _configLock and stage a copy, applyRequests swaps the pointers
+    struct Settings
+    {
+        SensorConfig sensor = SensorConfig("sensor.json");
+        AdcConfig adc = AdcConfig("adc.json");
+    };
+    Settings _settings[2];
+    Settings *_applied = &_settings[0];
+    Settings *_staged = &_settings[1];
+    SemaphoreHandle_t _configLock = NULL;
+    StaticSemaphore_t _configLockBuffer;
+    bool _coeffsLearned = false; // learned temperature coefficients not yet in sensor_config
+
+    // results of tare, calibration and temperature learning for the web page. The text is
+    // formatted and published by Task_Alarm, never from acquisition
+    enum MessageKind : uint8_t
+    {
+        MESSAGE_ZERO_OFFSET,
+        MESSAGE_CALIBRATION,
+        MESSAGE_TEMP_LEARN_UNSUPPORTED,
+        MESSAGE_TEMP_LEARN_NO_INTERVAL,
+        MESSAGE_TEMP_LEARN_STARTED,
+        MESSAGE_TEMP_LEARN_FAILED,
+        MESSAGE_TEMP_LEARN_DONE,
+    };
+    struct Message
+    {
+        MessageKind kind;
+        int32_t raw;       // zero offset
+        float value;       // scale factor or learned coefficient
+        float load;        // known load of the temperature learning, 0: zero coefficient
+        float r2;
+        uint32_t points;
+        float temp_span;
+    };
+    QueueHandle_t _messages = NULL;
+    uint8_t _messagesStorage[LOADCELL_MESSAGE_QUEUE_SIZE * sizeof(Message)]; // static, see MemoryPlan
+    StaticQueue_t _messagesStruct;
+
+    // set by commands from other tasks, applied in update_loop
+    std::atomic<uint8_t> _configChangeRequest{CONFIG_CHANGE_NONE}; // ConfigChange mask of the staged copy
+    volatile bool _tareRequest = false;
+    volatile bool _resetStatsRequest = false;
+    volatile float _displacement = NAN; // from cmdSetDisplacement, sampled with every load sample
+
+    // temperature conversions interleaved with load samples, all in the acquisition task
+    bool _tempSlot = false;       // adc input switched to the temperature sensor
+    uint8_t _tempSlotIndex = 0;   // conversions since the slot started
+    uint16_t _samplesSinceTemp = 0;
+    float _temperature = NAN;
+    uint32_t _tempConversions = 0;
+    uint32_t _heldSamples = 0;
+
+    // temperature coefficient learning, mean load between two temperature conversions
+    TempCoeffLearner _tempLearner;
+    bool _tempLearning = false;
+    float _tempLearnLoad = 0.0; // 0: zero coefficient, else known load for the span coefficient
+    double _tempLearnSum = 0.0;
+    uint32_t _tempLearnCount = 0;
+    volatile uint8_t _tempLearnRequest = 0; // set by cmdTempLearn, applied in update_loop
+    float _tempLearnRequestLoad = 0.0;
+
+    bool updateTemperatureSlot(int32_t raw);
+    void applyTempLearnRequest();
+    void applyRequests();
+    void applyConfigChange(uint8_t changes);
+    void applyPipelineConfig();
+    void publishTelemetry();
+    void queueMessage(const Message &message);
+    // stages sensor_config and adc_config for the acquisition task, with _configLock held.
+    // only the groups in changes (ConfigChange mask) are reinitialized
+    void postConfigChange(uint8_t changes = CONFIG_CHANGE_ALL);
 
 public:
+    // as loaded, saved and shown, the acquisition task works on its applied copy
     SensorConfig sensor_config = SensorConfig("sensor.json");
     AdcConfig adc_config = AdcConfig("adc.json");
 
@@ -36,18 +174,40 @@ public:
 
     void initialize();
     void update_loop();
+    // publishes the queued messages, in a task that may allocate (Task_Alarm)
+    void publishMessages();
+    // block until the adc has the next conversion or one tick passed
+    void waitReady();
 
-    // getter for external readout
+    // getter for external readout, from the latest snapshot. Take one getTelemetry() for
+    // several values that must belong to the same sample
+    LoadcellTelemetry getTelemetry();
     int32_t getReadingRaw();
+    uint32_t getReadingMillis();
+    uint32_t getReadingMicros();
     float getReadingDisplayunitFiltered();
+    PipelineStats getStats();
+    PipelineParams getPipelineParams();
+    float getSampleRate();
+    TemperatureStatus getTemperatureStatus();
+    // value of a DerivedChannel in the snapshot, CHANNEL_FORCE is the filtered value
+    static float getChannel(const LoadcellTelemetry &telemetry, uint8_t channel);
+    ConfigApplyStatus getConfigApplyStatus();
 
     // commands triggered externally
     void cmdZeroOffsetTare();
     void cmdCalcCalibrationFactor(float knownReference);
+    void cmdResetStats();
+    // second channel for work (integral F dx), e.g. from a travel sensor. NAN: none
+    void cmdSetDisplacement(float displacement);
+    void cmdSetSampleRate(uint8_t samplerate); // backend rate enum, see adc.json
+    // start (load 0: zero, >0: span with known load) or stop learning the temperature coefficient
+    void cmdTempLearn(bool start, float load);
 
     void cbSaveConfiguration(void);
     void cbLoadConfiguration(void);
-    void postConfigChange(void);
+    // update from a web request, applies only what differs. returns the ConfigChange mask
+    uint8_t configFromWeb(JsonVariant sensor, JsonVariant adc);
 };
 
 extern LoadcellClass g_Loadcell;
@@ -0,0 +1,182 @@
+#include <MemoryPlan.hpp>
+
+#include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+#include <rom/ets_sys.h>
+#include <JsonPool.hpp>
+
+MemoryPlanClass g_MemoryPlan;
+
+MemoryPlanClass::MemoryPlanClass()
+{
+    // on init construct with default variables
+}
+
+void MemoryPlanClass::registerTask(TaskHandle_t handle, const char *name, uint32_t stack_bytes, bool critical)
+{
+    if (_taskCount >= MEMORY_PLAN_MAX_TASKS)
+    {
+        log_e("memory plan: too many tasks, %s not registered", name);
+        return;
+    }
+
+    MemoryTaskInfo &task = _tasks[_taskCount];
+    task.name = name;
+    task.stack_bytes = stack_bytes;
+    task.critical = critical;
+    task.handle = handle;
+    _taskCount++; // publish after the entry is complete, onAllocation reads concurrently
+}
+
+void MemoryPlanClass::registerStatic(const char *name, size_t bytes, bool psram)
+{
+    if (_staticCount >= MEMORY_PLAN_MAX_STATICS)
+        return;
+
+    _statics[_staticCount].name = name;
+    _statics[_staticCount].bytes = bytes;
+    _statics[_staticCount].psram = psram;
+    _staticCount++;
+}
+
+void MemoryPlanClass::update_loop()
+{
+    if (_armed || millis() < _armAtMs)
+        return;
+
+    _heapFreeAtArm = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    _armed = true;
+    log_i("memory guard armed, heap free %u", _heapFreeAtArm);
+}
+
+void MemoryPlanClass::onAllocation(size_t size, void *caller)
+{
+    if (!_armed)
+        return;
+
+    _allocationsSinceArm++;
+
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    for (uint8_t i = 0; i < _taskCount; i++)
+    {
+        MemoryTaskInfo &task = _tasks[i];
+        if (task.handle != current || !task.critical)
+            continue;
+
+        task.allocations++;
+        task.last_caller = caller;
+        task.last_size = size;
+#ifdef MEMORY_GUARD_FAULT
+        // no logging here, the logger may allocate. resolve the caller with addr2line
+        ets_printf("heap allocation of %u bytes in critical task %s, caller %p\n", size, task.name, caller);
+        abort();
+#endif
+        return;
+    }
+}
+
+void MemoryPlanClass::printJson(Print &out)
+{
+    PooledJsonDocument json(JSON_POOL_LARGE_SIZE);
+
+    json["armed"] = _armed;
+#ifdef MEMORY_GUARD
+    json["guard"] = true;
+#else
+    json["guard"] = false;
+#endif
+
+    JsonObject heap = json.createNestedObject("heap");
+    uint32_t heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    heap["free"] = heap_free;
+    heap["min_free"] = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    heap["largest_block"] = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    heap["internal_free"] = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    heap["psram_free"] = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    heap["free_at_arm"] = _heapFreeAtArm;
+    // bytes taken since arming, 0 in a steady state
+    heap["growth"] = _armed ? (int32_t)(_heapFreeAtArm - heap_free) : 0;
+    heap["allocations_since_arm"] = _allocationsSinceArm;
+
+    uint32_t stacks_total = 0;
+    JsonArray tasks = json.createNestedArray("tasks");
+    for (uint8_t i = 0; i < _taskCount; i++)
+    {
+        const MemoryTaskInfo &info = _tasks[i];
+        JsonObject task = tasks.createNestedObject();
+        task["name"] = info.name;
+        task["stack"] = info.stack_bytes;
+        // ESP-IDF stack depth is in bytes
+        task["stack_free_min"] = uxTaskGetStackHighWaterMark(info.handle);
+        task["critical"] = info.critical;
+        if (info.critical)
+        {
+            task["allocations"] = info.allocations;
+            if (info.allocations)
+            {
+                char caller[12];
+                snprintf(caller, sizeof(caller), "%p", info.last_caller);
+                task["last_caller"] = caller;
+                task["last_size"] = info.last_size;
+            }
+        }
+        stacks_total += info.stack_bytes;
+    }
+
+    uint32_t statics_internal = 0;
+    uint32_t statics_psram = 0;
+    JsonArray statics = json.createNestedArray("statics");
+    for (uint8_t i = 0; i < _staticCount; i++)
+    {
+        JsonObject item = statics.createNestedObject();
+        item["name"] = _statics[i].name;
+        item["bytes"] = _statics[i].bytes;
+        item["psram"] = _statics[i].psram;
+        (_statics[i].psram ? statics_psram : statics_internal) += _statics[i].bytes;
+    }
+
+    JsonPoolStats pool = JsonPool::getStats();
+    JsonObject json_pool = json.createNestedObject("json_pool");
+    json_pool["small_used"] = pool.small_used;
+    json_pool["small_peak"] = pool.small_peak;
+    json_pool["large_used"] = pool.large_used;
+    json_pool["large_peak"] = pool.large_peak;
+    json_pool["fallbacks"] = pool.fallbacks;
+
+    JsonObject budget = json.createNestedObject("budget");
+    budget["task_stacks"] = stacks_total;
+    budget["json_pool"] = JSON_POOL_SMALL_SIZE * JSON_POOL_SMALL_BLOCKS + JSON_POOL_LARGE_SIZE * JSON_POOL_LARGE_BLOCKS;
+    budget["statics_internal"] = statics_internal;
+    budget["statics_psram"] = statics_psram;
+
+    serializeJson(json, out);
+}
+
+#ifdef MEMORY_GUARD
+// linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc: every call to these ends up here,
+// including operator new and String from precompiled libraries
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t n, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+
+    void *__wrap_malloc(size_t size)
+    {
+        g_MemoryPlan.onAllocation(size, __builtin_return_address(0));
+        return __real_malloc(size);
+    }
+
+    void *__wrap_calloc(size_t n, size_t size)
+    {
+        g_MemoryPlan.onAllocation(n * size, __builtin_return_address(0));
+        return __real_calloc(n, size);
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size)
+    {
+        g_MemoryPlan.onAllocation(size, __builtin_return_address(0));
+        return __real_realloc(ptr, size);
+    }
+}
+#endif
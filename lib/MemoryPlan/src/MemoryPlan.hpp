@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define MEMORY_PLAN_MAX_TASKS 12
+#define MEMORY_PLAN_MAX_STATICS 12
+#define MEMORY_ARM_DELAY_MS 15000 // module initialize() still allocates while tasks start up
+
+struct MemoryTaskInfo
+{
+    const char *name = nullptr;
+    TaskHandle_t handle = NULL;
+    uint32_t stack_bytes = 0;
+    bool critical = false;     // heap use is counted (or faults) after arming
+    uint32_t allocations = 0; // heap allocations since arming, counted for critical tasks only
+    void *last_caller = nullptr;
+    uint32_t last_size = 0;
+};
+
+struct MemoryStaticInfo
+{
+    const char *name = nullptr;
+    size_t bytes = 0;
+    bool psram = false;
+};
+
+/// Static memory plan: task stacks and large buffers are allocated at boot and registered
+/// here, the run-time report (/status/memory) lists them with stack high water marks and
+/// heap state. After MEMORY_ARM_DELAY_MS the allocation guard counts malloc/new/realloc
+/// in critical tasks (build flag MEMORY_GUARD, faults with MEMORY_GUARD_FAULT) and the heap
+/// baseline for growth is taken, so soak runs can prove the steady state does not allocate.
+class MemoryPlanClass
+{
+private:
+    MemoryTaskInfo _tasks[MEMORY_PLAN_MAX_TASKS];
+    uint8_t _taskCount = 0;
+    MemoryStaticInfo _statics[MEMORY_PLAN_MAX_STATICS];
+    uint8_t _staticCount = 0;
+
+    volatile bool _armed = false;
+    uint32_t _armAtMs = MEMORY_ARM_DELAY_MS;
+    uint32_t _heapFreeAtArm = 0;
+    uint32_t _allocationsSinceArm = 0; // all tasks
+
+public:
+    MemoryPlanClass();
+
+    void registerTask(TaskHandle_t handle, const char *name, uint32_t stack_bytes, bool critical);
+    void registerStatic(const char *name, size_t bytes, bool psram = false);
+
+    // arms the guard once the delay passed, call periodically
+    void update_loop();
+    bool isArmed() { return _armed; }
+
+    // from the malloc wrappers, any task, must not allocate itself
+    void onAllocation(size_t size, void *caller);
+
+    void printJson(Print &out);
+};
+
+extern MemoryPlanClass g_MemoryPlan;
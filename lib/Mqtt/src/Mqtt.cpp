@@ -0,0 +1,218 @@
+#include <Mqtt.hpp>
+
+#include <System.hpp> // -->g_System
+#include <MemoryPlan.hpp> // -->g_MemoryPlan
+#include <Storage.hpp> // -->g_Storage
+#include <atomic>
+
+class WifiTransport : public MqttTransport
+{
+private:
+    WiFiClient _client;
+
+public:
+    virtual bool connect(const char *host, uint16_t port) override
+    {
+        if (!_client.connect(host, port, MQTT_CONNECT_TIMEOUT_MS))
+            return false;
+        _client.setNoDelay(true);
+        return true;
+    }
+    virtual bool connected() override
+    {
+        return _client.connected();
+    }
+    virtual bool write(const uint8_t *data, size_t len) override
+    {
+        return _client.write(data, len) == len;
+    }
+    virtual int read(uint8_t *data, size_t len) override
+    {
+        int available = _client.available();
+        if (available <= 0)
+            return 0;
+        return _client.read(data, min((size_t)available, len));
+    }
+    virtual void close() override
+    {
+        _client.stop();
+    }
+};
+
+static WifiTransport transport;
+
+// the spool file on FFat: writes queued for the storage task, reads direct. A write is in the
+// file when its request completed (StorageWriter syncs patches)
+class StorageSpoolFile : public SpoolFile
+{
+private:
+    char _path[SPOOL_PATH_SIZE] = "";
+    std::atomic<uint32_t> _pending{0};
+
+    static void onWritten(const StorageResult &result, void *context)
+    {
+        if (!result.ok)
+            log_e("mqtt spool write of %s failed", result.path);
+        ((StorageSpoolFile *)context)->_pending--;
+    }
+
+    bool submit(StorageMode mode, uint32_t offset, const uint8_t *data, size_t len)
+    {
+        _pending++;
+        if (g_Storage.submit(_path, mode, data, len, offset, onWritten, this, MQTT_STORAGE_WAIT_MS))
+            return true;
+        _pending--;
+        return false;
+    }
+
+public:
+    virtual void begin(const char *path) override
+    {
+        strlcpy(_path, path, sizeof(_path));
+    }
+    virtual bool read(uint32_t offset, uint8_t *data, size_t len) override
+    {
+        // a handle per read, nothing cached across the writes of the storage task
+        File file = FFat.open(_path, FILE_READ);
+        bool ok = file && file.seek(offset) && file.read(data, len) == len;
+        file.close();
+        return ok;
+    }
+    virtual bool create(const uint8_t *data, size_t len) override
+    {
+        return submit(STORAGE_REPLACE, 0, data, len);
+    }
+    virtual bool append(const uint8_t *data, size_t len) override
+    {
+        return submit(STORAGE_APPEND, 0, data, len);
+    }
+    virtual bool write(uint32_t offset, const uint8_t *data, size_t len) override
+    {
+        return submit(STORAGE_PATCH, offset, data, len);
+    }
+    virtual bool settled() override
+    {
+        return _pending == 0;
+    }
+};
+
+static StorageSpoolFile spoolFile;
+
+MqttClass g_Mqtt;
+
+MqttClass::MqttClass() : _session(transport), _spool(spoolFile), _publisher(_session, _spool)
+{
+    // on init construct with default variables
+}
+
+void MqttClass::initialize()
+{
+    log_i("Mqtt init");
+
+    _samples = xStreamBufferCreateStatic(MQTT_SAMPLE_BUFFER_SIZE, sizeof(Sample), _samplesStorage, &_samplesStruct);
+    g_MemoryPlan.registerStatic("mqtt buffer", sizeof(_samplesStorage));
+    _mutex = xSemaphoreCreateMutex();
+
+    this->cbLoadConfiguration(); // applied on the first update_loop
+}
+
+void MqttClass::applyConfig()
+{
+    _clientId = g_System.system_config.hostname;
+    _topicPrefix = mqtt_config.topic_prefix + "/" + g_System.system_config.hostname;
+
+    MqttPublisherConfig config;
+    config.host = mqtt_config.broker.c_str();
+    config.port = mqtt_config.port;
+    config.connect.client_id = _clientId.c_str();
+    config.connect.username = mqtt_config.username.length() ? mqtt_config.username.c_str() : nullptr;
+    config.connect.password = mqtt_config.password.length() ? mqtt_config.password.c_str() : nullptr;
+    config.topic_prefix = _topicPrefix.c_str();
+    config.stats_mode = mqtt_config.mode == 1;
+    config.batch_records = mqtt_config.batch_records;
+    config.stats_interval_ms = mqtt_config.stats_interval_ms;
+    config.max_inflight = mqtt_config.max_inflight;
+    config.drain_rate = mqtt_config.drain_rate;
+    _publisher.configure(config, millis());
+
+    if (mqtt_config.enabled && !_spool.isOpen() && !_spool.open(MQTT_SPOOL_PATH, MQTT_SPOOL_SLOT_SIZE, MQTT_SPOOL_SLOTS))
+        log_e("mqtt spool %s not available, no offline buffering", MQTT_SPOOL_PATH);
+
+    xStreamBufferReset(_samples);
+    _active = mqtt_config.enabled && mqtt_config.broker.length() > 0;
+
+    log_i("mqtt %s, broker %s:%u", _active ? "enabled" : "disabled", mqtt_config.broker.c_str(), mqtt_config.port);
+}
+
+void MqttClass::push(uint32_t t_ms, float value)
+{
+    if (!_active)
+        return;
+
+    Sample sample = {t_ms, value};
+    if (xStreamBufferSend(_samples, &sample, sizeof(sample), 0) != sizeof(sample))
+        _overruns++;
+}
+
+void MqttClass::update_loop()
+{
+    if (_configChanged)
+    {
+        _configChanged = false;
+        applyConfig();
+    }
+
+    if (_active)
+    {
+        Sample samples[64];
+        size_t received;
+        while ((received = xStreamBufferReceive(_samples, samples, sizeof(samples), 0)) > 0)
+        {
+            for (size_t i = 0; i < received / sizeof(Sample); i++)
+                _publisher.addSample(samples[i].t_ms, samples[i].value, millis());
+        }
+
+        _publisher.loop(millis(), WiFi.isConnected());
+    }
+
+    // snapshot for getStatus, the task itself never waits for the webserver
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _status.enabled = _active;
+    _status.connected = _session.isConnected();
+    _status.inflight = _session.getInflight();
+    _status.spooled = _spool.getCount();
+    _status.spool_dropped = _spool.getDropped();
+    _status.overruns = _overruns;
+    _status.publisher = _publisher.getStats();
+    _status.session = _session.getMetrics();
+    xSemaphoreGive(_mutex);
+}
+
+MqttStatus MqttClass::getStatus()
+{
+    if (_mutex == NULL)
+        return MqttStatus();
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    MqttStatus status = _status;
+    xSemaphoreGive(_mutex);
+
+    return status;
+}
+
+void MqttClass::cbSaveConfiguration(void)
+{
+    mqtt_config.saveConfiguration();
+}
+void MqttClass::cbLoadConfiguration(void)
+{
+    mqtt_config.loadConfiguration();
+    postConfigChange();
+}
+void MqttClass::postConfigChange(void)
+{
+    log_i("postConfigChange triggered");
+
+    // applied by the task, the session must not be touched from the webserver
+    _configChanged = true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/stream_buffer.h>
+#include <ConfigStructs.hpp>
+#include <MqttPublisher.hpp>
+
+#define MQTT_SAMPLE_BUFFER_SIZE 8192 // ~3 s at 320 SPS, covers a blocking connect attempt
+#define MQTT_CONNECT_TIMEOUT_MS 2000
+#define MQTT_SPOOL_PATH "/mqtt_spool.bin" // on FFat, written by the storage task
+#define MQTT_SPOOL_SLOTS 256
+#define MQTT_STORAGE_WAIT_MS 200 // longest wait for a storage queue slot per spool write
+
+struct MqttStatus
+{
+    bool enabled = false;
+    bool connected = false;
+    uint8_t inflight = 0;
+    uint32_t spooled = 0;
+    uint32_t spool_dropped = 0;
+    uint32_t overruns = 0;
+    MqttPublisherStats publisher;
+    MqttMetrics session;
+};
+
+/// Publishes samples or statistics to an MQTT broker, see MqttPublisher.
+/// Loadcell pushes samples without blocking, Task_Mqtt does all network access and reads the
+/// spool, its writes go through the storage task.
+class MqttClass
+{
+private:
+    struct Sample
+    {
+        uint32_t t_ms;
+        float value;
+    };
+
+    StreamBufferHandle_t _samples = NULL;
+    uint8_t _samplesStorage[MQTT_SAMPLE_BUFFER_SIZE + 1]; // static, see MemoryPlan
+    StaticStreamBuffer_t _samplesStruct;
+    MqttSession _session;
+    SpoolRing _spool;
+    MqttPublisher _publisher;
+
+    // strings referenced by the publisher config
+    String _clientId;
+    String _topicPrefix;
+
+    volatile bool _active = false;
+    volatile bool _configChanged = false;
+    uint32_t _overruns = 0;
+
+    SemaphoreHandle_t _mutex = NULL; // guards _status
+    MqttStatus _status;
+
+    void applyConfig();
+
+public:
+    MqttConfig mqtt_config = MqttConfig("mqtt.json");
+
+    MqttClass();
+
+    void initialize();
+    void update_loop();
+
+    // called from acquisition, never blocks
+    void push(uint32_t t_ms, float value);
+
+    MqttStatus getStatus();
+
+    void cbSaveConfiguration(void);
+    void cbLoadConfiguration(void);
+    void postConfigChange(void);
+};
+
+extern MqttClass g_Mqtt;
@@ -0,0 +1,84 @@
+#include <MqttBatch.hpp>
+
+void MqttBatch::begin(Kind kind, uint16_t max_records)
+{
+    _kind = kind;
+    _maxRecords = max_records;
+    clear();
+}
+
+void MqttBatch::clear()
+{
+    _length = MQTT_BATCH_HEADER_SIZE;
+    _count = 0;
+    _buffer[0] = MQTT_BATCH_VERSION;
+    _buffer[1] = _kind;
+}
+
+bool MqttBatch::isFull() const
+{
+    return (_maxRecords && _count >= _maxRecords) || _length + recordSize(_kind) > sizeof(_buffer);
+}
+
+uint32_t MqttBatch::getFirstMs() const
+{
+    return _buffer[4] | (_buffer[5] << 8) | (_buffer[6] << 16) | ((uint32_t)_buffer[7] << 24);
+}
+
+bool MqttBatch::prepare(uint32_t t_ms)
+{
+    if (isFull())
+        return false;
+
+    uint32_t dt;
+    if (_count == 0)
+    {
+        _buffer[4] = t_ms;
+        _buffer[5] = t_ms >> 8;
+        _buffer[6] = t_ms >> 16;
+        _buffer[7] = t_ms >> 24;
+        dt = 0;
+    }
+    else
+    {
+        dt = t_ms - _lastMs;
+        if (dt > 0xFFFF)
+            return false;
+    }
+
+    _buffer[_length] = dt;
+    _buffer[_length + 1] = dt >> 8;
+    _lastMs = t_ms;
+    return true;
+}
+
+bool MqttBatch::addSample(uint32_t t_ms, float value)
+{
+    if (_kind != SAMPLES || !prepare(t_ms))
+        return false;
+
+    memcpy(_buffer + _length + 2, &value, 4);
+    _length += 6;
+    _count++;
+    _buffer[2] = _count;
+    _buffer[3] = _count >> 8;
+    return true;
+}
+
+bool MqttBatch::addStats(uint32_t t_ms, uint16_t count, float min, float max, float mean)
+{
+    if (_kind != STATS || !prepare(t_ms))
+        return false;
+
+    uint8_t *p = _buffer + _length;
+    p[2] = count;
+    p[3] = count >> 8;
+    memcpy(p + 4, &min, 4);
+    memcpy(p + 8, &max, 4);
+    memcpy(p + 12, &mean, 4);
+    _length += 16;
+    _count++;
+    _buffer[2] = _count;
+    _buffer[3] = _count >> 8;
+    return true;
+}
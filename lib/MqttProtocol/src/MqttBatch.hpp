@@ -0,0 +1,107 @@
+#pragma once
+
+// Compact binary batch payload for published samples and statistics, little endian:
+//
+//   version u8 | kind u8 | count u16 | t0_ms u32 | records
+//   kind 1 samples: dt_ms u16 | value f32                                   (6 bytes)
+//   kind 2 stats:   dt_ms u16 | count u16 | min f32 | max f32 | mean f32    (16 bytes)
+//
+// dt_ms is relative to the previous record (the first one to t0_ms), a record that does not
+// fit (payload full or gap > 65 s) is rejected and the caller flushes the batch first.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <MqttProtocol.hpp>
+
+#define MQTT_BATCH_VERSION 1
+#define MQTT_BATCH_HEADER_SIZE 8
+
+class MqttBatch
+{
+public:
+    enum Kind : uint8_t
+    {
+        SAMPLES = 1,
+        STATS = 2,
+    };
+
+    struct Record
+    {
+        uint32_t t_ms;
+        uint16_t count; // samples in a stats record, 1 for samples
+        float min;
+        float max;
+        float mean; // the value for samples
+    };
+
+private:
+    uint8_t _buffer[MQTT_MAX_PAYLOAD];
+    size_t _length = 0;
+    uint16_t _count = 0;
+    uint16_t _maxRecords = 0;
+    uint32_t _lastMs = 0;
+    Kind _kind = SAMPLES;
+
+    static size_t recordSize(Kind kind) { return kind == STATS ? 16 : 6; }
+    bool prepare(uint32_t t_ms);
+
+public:
+    // max_records 0: as many as fit into MQTT_MAX_PAYLOAD
+    void begin(Kind kind, uint16_t max_records);
+    void clear();
+
+    bool addSample(uint32_t t_ms, float value);
+    bool addStats(uint32_t t_ms, uint16_t count, float min, float max, float mean);
+
+    bool isEmpty() const { return _count == 0; }
+    bool isFull() const;
+    uint16_t getCount() const { return _count; }
+    uint32_t getFirstMs() const;
+
+    const uint8_t *data() const { return _buffer; }
+    size_t size() const { return _length; }
+
+    // decode a received payload, returns number of records or -1 if malformed
+    template <typename Visitor>
+    static int decode(const uint8_t *payload, size_t len, Visitor visit)
+    {
+        if (len < MQTT_BATCH_HEADER_SIZE || payload[0] != MQTT_BATCH_VERSION)
+            return -1;
+
+        Kind kind = (Kind)payload[1];
+        if (kind != SAMPLES && kind != STATS)
+            return -1;
+
+        uint16_t count = payload[2] | (payload[3] << 8);
+        if (len < MQTT_BATCH_HEADER_SIZE + count * recordSize(kind))
+            return -1;
+
+        uint32_t t_ms = payload[4] | (payload[5] << 8) | (payload[6] << 16) | ((uint32_t)payload[7] << 24);
+        const uint8_t *p = payload + MQTT_BATCH_HEADER_SIZE;
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+            Record record;
+            t_ms += p[0] | (p[1] << 8);
+            record.t_ms = t_ms;
+            if (kind == SAMPLES)
+            {
+                record.count = 1;
+                memcpy(&record.mean, p + 2, 4);
+                record.min = record.max = record.mean;
+            }
+            else
+            {
+                record.count = p[2] | (p[3] << 8);
+                memcpy(&record.min, p + 4, 4);
+                memcpy(&record.max, p + 8, 4);
+                memcpy(&record.mean, p + 12, 4);
+            }
+            visit(kind, record);
+            p += recordSize(kind);
+        }
+        return count;
+    }
+};
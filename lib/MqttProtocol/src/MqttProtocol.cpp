@@ -0,0 +1,183 @@
+#include <MqttProtocol.hpp>
+
+#include <string.h>
+
+namespace MqttProtocol
+{
+    // remaining length as variable byte integer, returns bytes written
+    static size_t writeLength(uint32_t length, uint8_t *out)
+    {
+        size_t n = 0;
+        do
+        {
+            uint8_t byte = length % 128;
+            length /= 128;
+            if (length > 0)
+                byte |= 0x80;
+            out[n++] = byte;
+        } while (length > 0);
+        return n;
+    }
+
+    static size_t lengthSize(uint32_t length)
+    {
+        return length < 128 ? 1 : length < 16384 ? 2
+                              : length < 2097152 ? 3
+                                                 : 4;
+    }
+
+    static uint8_t *writeString(uint8_t *p, const char *str)
+    {
+        size_t len = strlen(str);
+        p[0] = len >> 8;
+        p[1] = len & 0xFF;
+        memcpy(p + 2, str, len);
+        return p + 2 + len;
+    }
+
+    static size_t stringSize(const char *str)
+    {
+        return 2 + strlen(str);
+    }
+
+    size_t encodeConnect(const ConnectOptions &options, uint8_t *out, size_t size)
+    {
+        bool will = options.will_topic && options.will_message;
+
+        uint32_t remaining = 10 + stringSize(options.client_id);
+        if (will)
+            remaining += stringSize(options.will_topic) + stringSize(options.will_message);
+        if (options.username)
+            remaining += stringSize(options.username);
+        if (options.password)
+            remaining += stringSize(options.password);
+
+        if (1 + lengthSize(remaining) + remaining > size)
+            return 0;
+
+        uint8_t flags = 0;
+        if (options.clean_session)
+            flags |= 0x02;
+        if (will)
+            flags |= 0x04 | 0x20; // will QoS 0, retained
+        if (options.password)
+            flags |= 0x40;
+        if (options.username)
+            flags |= 0x80;
+
+        uint8_t *p = out;
+        *p++ = CONNECT << 4;
+        p += writeLength(remaining, p);
+        p = writeString(p, "MQTT");
+        *p++ = 4; // protocol level 3.1.1
+        *p++ = flags;
+        *p++ = options.keepalive_s >> 8;
+        *p++ = options.keepalive_s & 0xFF;
+
+        p = writeString(p, options.client_id);
+        if (will)
+        {
+            p = writeString(p, options.will_topic);
+            p = writeString(p, options.will_message);
+        }
+        if (options.username)
+            p = writeString(p, options.username);
+        if (options.password)
+            p = writeString(p, options.password);
+
+        return p - out;
+    }
+
+    size_t encodePublish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos, bool retain, uint16_t packet_id, uint8_t *out, size_t size)
+    {
+        uint32_t remaining = stringSize(topic) + (qos ? 2 : 0) + len;
+        if (1 + lengthSize(remaining) + remaining > size)
+            return 0;
+
+        uint8_t *p = out;
+        *p++ = (PUBLISH << 4) | (qos << 1) | (retain ? 1 : 0);
+        p += writeLength(remaining, p);
+        p = writeString(p, topic);
+        if (qos)
+        {
+            *p++ = packet_id >> 8;
+            *p++ = packet_id & 0xFF;
+        }
+        memcpy(p, payload, len);
+
+        return p + len - out;
+    }
+
+    size_t encodePingreq(uint8_t *out, size_t size)
+    {
+        if (size < 2)
+            return 0;
+        out[0] = PINGREQ << 4;
+        out[1] = 0;
+        return 2;
+    }
+
+    size_t encodeDisconnect(uint8_t *out, size_t size)
+    {
+        if (size < 2)
+            return 0;
+        out[0] = DISCONNECT << 4;
+        out[1] = 0;
+        return 2;
+    }
+
+    void setDup(uint8_t *packet)
+    {
+        packet[0] |= 0x08;
+    }
+
+    void PacketReader::reset()
+    {
+        _state = HEADER;
+        _received = 0;
+    }
+
+    bool PacketReader::feed(uint8_t byte)
+    {
+        switch (_state)
+        {
+        case HEADER:
+            _header = byte;
+            _remaining = 0;
+            _lengthShift = 0;
+            _received = 0;
+            _state = LENGTH;
+            return false;
+
+        case LENGTH:
+            _remaining |= (uint32_t)(byte & 0x7F) << _lengthShift;
+            _lengthShift += 7;
+            if (byte & 0x80)
+            {
+                if (_lengthShift > 21)
+                {
+                    malformed++;
+                    _state = HEADER;
+                }
+                return false;
+            }
+            if (_remaining == 0)
+            {
+                _state = HEADER;
+                return true;
+            }
+            _state = BODY;
+            return false;
+
+        case BODY:
+            if (_received < MQTT_READER_BUFFER)
+                _body[_received] = byte;
+            _received++;
+            if (_received < _remaining)
+                return false;
+            _state = HEADER;
+            return true;
+        }
+        return false;
+    }
+}
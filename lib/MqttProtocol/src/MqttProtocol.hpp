@@ -0,0 +1,83 @@
+#pragma once
+
+// Minimal MQTT 3.1.1 packet encoding for a publishing client: CONNECT (with will),
+// PUBLISH QoS 0/1, PINGREQ, DISCONNECT out; CONNACK, PUBACK, PINGRESP in.
+// Must not depend on Arduino headers, shared by firmware (Mqtt) and host tool (mqttpub).
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MQTT_MAX_TOPIC 64
+#define MQTT_MAX_PAYLOAD 512
+#define MQTT_MAX_PACKET (5 + 2 + MQTT_MAX_TOPIC + 2 + MQTT_MAX_PAYLOAD)
+#define MQTT_READER_BUFFER 32 // incoming packets we care about are tiny, larger ones are skipped
+
+namespace MqttProtocol
+{
+    enum PacketType : uint8_t
+    {
+        CONNECT = 1,
+        CONNACK = 2,
+        PUBLISH = 3,
+        PUBACK = 4,
+        SUBACK = 9,
+        PINGREQ = 12,
+        PINGRESP = 13,
+        DISCONNECT = 14,
+    };
+
+    struct ConnectOptions
+    {
+        const char *client_id = "";
+        const char *username = nullptr;
+        const char *password = nullptr;
+        uint16_t keepalive_s = 30;
+        bool clean_session = true;
+
+        // last will, published retained by the broker if the connection breaks
+        const char *will_topic = nullptr;
+        const char *will_message = nullptr;
+    };
+
+    // all encoders return the packet length, 0 if it does not fit into size
+    size_t encodeConnect(const ConnectOptions &options, uint8_t *out, size_t size);
+    size_t encodePublish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos, bool retain, uint16_t packet_id, uint8_t *out, size_t size);
+    size_t encodePingreq(uint8_t *out, size_t size);
+    size_t encodeDisconnect(uint8_t *out, size_t size);
+
+    // set the DUP flag of an encoded PUBLISH for retransmission
+    void setDup(uint8_t *packet);
+
+    /// Reassembles incoming packets from a byte stream.
+    class PacketReader
+    {
+    private:
+        enum State : uint8_t
+        {
+            HEADER,
+            LENGTH,
+            BODY
+        };
+
+        State _state = HEADER;
+        uint8_t _header = 0;
+        uint32_t _remaining = 0;
+        uint8_t _lengthShift = 0;
+        uint32_t _received = 0;
+        uint8_t _body[MQTT_READER_BUFFER];
+
+    public:
+        uint32_t malformed = 0;
+
+        void reset();
+
+        // returns true if a packet is complete, valid until the next call
+        bool feed(uint8_t byte);
+
+        uint8_t type() const { return _header >> 4; }
+        uint8_t flags() const { return _header & 0x0F; }
+        // body truncated to MQTT_READER_BUFFER
+        const uint8_t *body() const { return _body; }
+        size_t bodyLength() const { return _received < MQTT_READER_BUFFER ? _received : MQTT_READER_BUFFER; }
+    };
+}
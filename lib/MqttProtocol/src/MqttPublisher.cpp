@@ -0,0 +1,190 @@
+#include <MqttPublisher.hpp>
+
+#include <stdio.h>
+#include <string.h>
+
+MqttPublisher::MqttPublisher(MqttSession &session, SpoolRing &spool) : _session(session), _spool(spool)
+{
+}
+
+void MqttPublisher::configure(const MqttPublisherConfig &config, uint32_t now_ms)
+{
+    if (_session.getState() != MqttSession::DISCONNECTED)
+        _session.disconnect(now_ms);
+
+    _config = config;
+    snprintf(_topicSamples, sizeof(_topicSamples), "%s/samples", config.topic_prefix);
+    snprintf(_topicStats, sizeof(_topicStats), "%s/stats", config.topic_prefix);
+    snprintf(_topicStatus, sizeof(_topicStatus), "%s/status", config.topic_prefix);
+    _config.connect.will_topic = _topicStatus;
+    _config.connect.will_message = "offline";
+
+    _session.setWindow(config.max_inflight, 5000);
+    _batch.begin(config.stats_mode ? MqttBatch::STATS : MqttBatch::SAMPLES, config.batch_records);
+    _statsCount = 0;
+
+    _nextConnectMs = now_ms;
+    _reconnectDelayMs = MQTT_RECONNECT_MIN_MS;
+    _announced = false;
+    _drainLastMs = now_ms;
+    _windowStartMs = now_ms;
+}
+
+void MqttPublisher::handleConnection(uint32_t now_ms, bool network_up)
+{
+    if (_session.getState() != MqttSession::DISCONNECTED)
+    {
+        if (_session.isConnected() && !_announced)
+        {
+            _session.publish(_topicStatus, (const uint8_t *)"online", 6, 1, true, now_ms);
+            _announced = true;
+            _reconnectDelayMs = MQTT_RECONNECT_MIN_MS;
+        }
+        return;
+    }
+
+    _announced = false;
+
+    if ((int32_t)(now_ms - _nextConnectMs) < 0 || !network_up)
+        return;
+
+    // exponential backoff, reset once connected. an unreachable broker must not cost a
+    // (possibly blocking) connect every loop
+    _session.connect(_config.host, _config.port, _config.connect, now_ms);
+    _nextConnectMs = now_ms + _reconnectDelayMs;
+    _reconnectDelayMs = _reconnectDelayMs * 2 < MQTT_RECONNECT_MAX_MS ? _reconnectDelayMs * 2 : MQTT_RECONNECT_MAX_MS;
+}
+
+bool MqttPublisher::publishRecord(const uint8_t *record, size_t len, uint32_t now_ms)
+{
+    // record: kind byte + batch payload
+    const char *topic = record[0] == MqttBatch::STATS ? _topicStats : _topicSamples;
+    if (!_session.publish(topic, record + 1, len - 1, 1, false, now_ms))
+        return false;
+
+    uint16_t records = record[3] | (record[4] << 8);
+    _stats.records_published += records;
+    _windowMessages++;
+    _windowRecords += records;
+    _windowBytes += len - 1;
+    return true;
+}
+
+void MqttPublisher::flushBatch(uint32_t now_ms)
+{
+    if (_batch.isEmpty())
+        return;
+
+    uint8_t record[MQTT_SPOOL_SLOT_SIZE];
+    record[0] = _config.stats_mode ? MqttBatch::STATS : MqttBatch::SAMPLES;
+    memcpy(record + 1, _batch.data(), _batch.size());
+    size_t len = 1 + _batch.size();
+    _batch.clear();
+
+    // keep order: live data goes through the spool as long as it is not empty
+    if (_spool.getCount() == 0 && _session.canPublish() && publishRecord(record, len, now_ms))
+        return;
+
+    if (!_spool.push(record, len))
+        _stats.spool_failures++;
+}
+
+void MqttPublisher::addSample(uint32_t t_ms, float value, uint32_t now_ms)
+{
+    if (!_config.stats_mode)
+    {
+        if (!_batch.addSample(t_ms, value))
+        {
+            flushBatch(now_ms);
+            _batch.addSample(t_ms, value);
+        }
+        if (_batch.isFull())
+            flushBatch(now_ms);
+        return;
+    }
+
+    // stats mode: one record per interval
+    if (_statsCount > 0 && t_ms - _statsStartMs >= _config.stats_interval_ms)
+    {
+        float mean = _statsSum / _statsCount;
+        if (!_batch.addStats(_statsStartMs, _statsCount, _statsMin, _statsMax, mean))
+        {
+            flushBatch(now_ms);
+            _batch.addStats(_statsStartMs, _statsCount, _statsMin, _statsMax, mean);
+        }
+        if (_batch.isFull())
+            flushBatch(now_ms);
+        _statsCount = 0;
+    }
+
+    if (_statsCount == 0)
+    {
+        _statsStartMs = t_ms;
+        _statsMin = value;
+        _statsMax = value;
+        _statsSum = 0;
+    }
+    if (value < _statsMin)
+        _statsMin = value;
+    if (value > _statsMax)
+        _statsMax = value;
+    _statsSum += value;
+    if (_statsCount < 0xFFFF)
+        _statsCount++;
+}
+
+void MqttPublisher::drainSpool(uint32_t now_ms)
+{
+    // token bucket, at most one second of burst
+    float rate = _config.drain_rate ? _config.drain_rate : 1;
+    _drainTokens += (now_ms - _drainLastMs) * rate / 1000.0f;
+    if (_drainTokens > rate)
+        _drainTokens = rate;
+    _drainLastMs = now_ms;
+
+    uint8_t record[MQTT_SPOOL_SLOT_SIZE];
+    while (_drainTokens >= 1 && _spool.getCount() > 0 && _session.canPublish())
+    {
+        uint16_t len = _spool.peek(record, sizeof(record));
+        if (len < 2)
+            break;
+        if (!publishRecord(record, len, now_ms))
+            break;
+        // the session owns the message now (inflight until PUBACK)
+        _spool.pop();
+        _drainTokens -= 1;
+    }
+}
+
+void MqttPublisher::updateThroughput(uint32_t now_ms)
+{
+    uint32_t elapsed = now_ms - _windowStartMs;
+    if (elapsed < MQTT_THROUGHPUT_WINDOW_MS)
+        return;
+
+    _stats.messages_per_sec = _windowMessages * 1000.0f / elapsed;
+    _stats.records_per_sec = _windowRecords * 1000.0f / elapsed;
+    _stats.bytes_per_sec = _windowBytes * 1000.0f / elapsed;
+    _windowMessages = 0;
+    _windowRecords = 0;
+    _windowBytes = 0;
+    _windowStartMs = now_ms;
+}
+
+void MqttPublisher::loop(uint32_t now_ms, bool network_up)
+{
+    _session.loop(now_ms);
+
+    // sample batches are also complete by age, stats batches by record count only
+    if (!_config.stats_mode && !_batch.isEmpty() && now_ms - _batch.getFirstMs() > MQTT_BATCH_MAX_AGE_MS)
+        flushBatch(now_ms);
+
+    handleConnection(now_ms, network_up);
+
+    if (_session.isConnected())
+        drainSpool(now_ms);
+    else
+        _drainLastMs = now_ms;
+
+    updateThroughput(now_ms);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// Batching QoS 1 publisher with offline spool, the portable part of the firmware Mqtt module
+// and the host tool mqttpub:
+// - samples (or min/max/mean per interval) are collected into MqttBatch payloads
+// - complete batches are published directly while connected and the spool is empty,
+//   otherwise appended to the spool, so the broker always receives them in order
+// - after reconnect the spool is drained at drain_rate messages/s within the inflight window
+// - reconnects with exponential backoff, will message "offline" / retained "online" on status
+//
+// Not thread safe, the owner serializes calls.
+
+#include <MqttSession.hpp>
+#include <MqttBatch.hpp>
+#include <SpoolRing.hpp>
+
+#define MQTT_RECONNECT_MIN_MS 1000
+#define MQTT_RECONNECT_MAX_MS 60000
+#define MQTT_BATCH_MAX_AGE_MS 2000 // flush incomplete sample batches at low sample rates
+#define MQTT_SPOOL_SLOT_SIZE (1 + MQTT_MAX_PAYLOAD) // kind byte + batch
+#define MQTT_THROUGHPUT_WINDOW_MS 5000
+
+struct MqttPublisherConfig
+{
+    const char *host = "";
+    uint16_t port = 1883;
+    MqttProtocol::ConnectOptions connect;
+    const char *topic_prefix = "sgbox"; // <prefix>/samples|stats|status
+    bool stats_mode = false;
+    uint16_t batch_records = 64;
+    uint16_t stats_interval_ms = 1000;
+    uint8_t max_inflight = 4;
+    uint16_t drain_rate = 10;
+};
+
+struct MqttPublisherStats
+{
+    uint32_t records_published = 0;
+    uint32_t spool_failures = 0; // batch lost, spool not available or write error
+    float messages_per_sec = 0;
+    float records_per_sec = 0;
+    float bytes_per_sec = 0;
+};
+
+class MqttPublisher
+{
+private:
+    MqttSession &_session;
+    SpoolRing &_spool;
+
+    MqttPublisherConfig _config;
+    char _topicSamples[MQTT_MAX_TOPIC];
+    char _topicStats[MQTT_MAX_TOPIC];
+    char _topicStatus[MQTT_MAX_TOPIC];
+
+    MqttBatch _batch;
+
+    uint32_t _nextConnectMs = 0;
+    uint32_t _reconnectDelayMs = MQTT_RECONNECT_MIN_MS;
+    bool _announced = false;
+
+    // stats mode aggregation
+    uint32_t _statsStartMs = 0;
+    uint16_t _statsCount = 0;
+    float _statsMin = 0;
+    float _statsMax = 0;
+    double _statsSum = 0;
+
+    // spool drain token bucket
+    float _drainTokens = 0;
+    uint32_t _drainLastMs = 0;
+
+    // throughput over the last window
+    uint32_t _windowStartMs = 0;
+    uint32_t _windowMessages = 0;
+    uint32_t _windowRecords = 0;
+    uint32_t _windowBytes = 0;
+
+    MqttPublisherStats _stats;
+
+    void handleConnection(uint32_t now_ms, bool network_up);
+    void flushBatch(uint32_t now_ms);
+    bool publishRecord(const uint8_t *record, size_t len, uint32_t now_ms);
+    void drainSpool(uint32_t now_ms);
+    void updateThroughput(uint32_t now_ms);
+
+public:
+    MqttPublisher(MqttSession &session, SpoolRing &spool);
+
+    // strings in config must stay valid. disconnects, a partial batch is discarded
+    void configure(const MqttPublisherConfig &config, uint32_t now_ms);
+
+    void addSample(uint32_t t_ms, float value, uint32_t now_ms);
+
+    // network_up: false while the link below (WiFi) is down, no connect attempts then
+    void loop(uint32_t now_ms, bool network_up);
+
+    const MqttPublisherStats &getStats() const { return _stats; }
+};
@@ -0,0 +1,255 @@
+#include <MqttSession.hpp>
+
+using namespace MqttProtocol;
+
+MqttSession::MqttSession(MqttTransport &transport) : _transport(transport)
+{
+}
+
+void MqttSession::setWindow(uint8_t max_inflight, uint32_t retry_ms)
+{
+    _maxInflight = max_inflight == 0 ? 1 : max_inflight > MQTT_MAX_INFLIGHT ? MQTT_MAX_INFLIGHT
+                                                                             : max_inflight;
+    _retryMs = retry_ms;
+}
+
+bool MqttSession::send(const uint8_t *data, size_t len, uint32_t now_ms)
+{
+    if (!_transport.write(data, len))
+    {
+        drop();
+        return false;
+    }
+    _metrics.bytes_sent += len;
+    _lastSentMs = now_ms;
+    return true;
+}
+
+void MqttSession::drop()
+{
+    if (_state != DISCONNECTED)
+        _metrics.disconnects++;
+
+    _transport.close();
+    _reader.reset();
+    _state = DISCONNECTED;
+    _pingPending = false;
+}
+
+bool MqttSession::connect(const char *host, uint16_t port, const ConnectOptions &options, uint32_t now_ms)
+{
+    if (_state != DISCONNECTED)
+        drop();
+
+    if (!_transport.connect(host, port))
+    {
+        _metrics.connect_failures++;
+        return false;
+    }
+
+    uint8_t packet[MQTT_MAX_PACKET];
+    size_t len = encodeConnect(options, packet, sizeof(packet));
+    if (len == 0)
+    {
+        _transport.close();
+        _metrics.connect_failures++;
+        return false;
+    }
+
+    _keepaliveS = options.keepalive_s;
+    _reader.reset();
+    _state = CONNECTING;
+    _stateSinceMs = now_ms;
+    _lastReceivedMs = now_ms;
+
+    return send(packet, len, now_ms);
+}
+
+void MqttSession::disconnect(uint32_t now_ms)
+{
+    if (_state == CONNECTED)
+    {
+        uint8_t packet[2];
+        send(packet, encodeDisconnect(packet, sizeof(packet)), now_ms);
+    }
+    drop();
+}
+
+void MqttSession::resendInflight(uint32_t now_ms, bool all)
+{
+    for (Inflight &slot : _inflight)
+    {
+        if (slot.packet_id == 0 || (!all && (_retryMs == 0 || now_ms - slot.sent_ms < _retryMs)))
+            continue;
+
+        setDup(slot.packet);
+        if (!send(slot.packet, slot.length, now_ms))
+            return;
+        slot.sent_ms = now_ms;
+        _metrics.retransmits++;
+    }
+}
+
+void MqttSession::handlePacket(uint32_t now_ms)
+{
+    const uint8_t *body = _reader.body();
+    size_t len = _reader.bodyLength();
+
+    switch (_reader.type())
+    {
+    case CONNACK:
+        if (_state != CONNECTING)
+            break;
+        if (len < 2 || body[1] != 0)
+        {
+            // refused (bad credentials, client id ...)
+            _metrics.connect_failures++;
+            drop();
+            return;
+        }
+        _state = CONNECTED;
+        _stateSinceMs = now_ms;
+        _metrics.connects++;
+        // unacknowledged messages of the previous connection
+        resendInflight(now_ms, true);
+        break;
+
+    case PUBACK:
+    {
+        if (len < 2)
+            break;
+        uint16_t id = (body[0] << 8) | body[1];
+        for (Inflight &slot : _inflight)
+        {
+            if (slot.packet_id != id)
+                continue;
+
+            uint32_t latency = now_ms - slot.first_sent_ms;
+            if (latency > _metrics.ack_latency_ms_max)
+                _metrics.ack_latency_ms_max = latency;
+
+            slot.packet_id = 0;
+            _inflightCount--;
+            _metrics.acked++;
+            break;
+        }
+        break;
+    }
+
+    case PINGRESP:
+        _pingPending = false;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void MqttSession::loop(uint32_t now_ms)
+{
+    if (_state == DISCONNECTED)
+        return;
+
+    if (!_transport.connected())
+    {
+        drop();
+        return;
+    }
+
+    uint8_t buffer[64];
+    int n;
+    while ((n = _transport.read(buffer, sizeof(buffer))) > 0)
+    {
+        _lastReceivedMs = now_ms;
+        for (int i = 0; i < n && _state != DISCONNECTED; i++)
+        {
+            if (_reader.feed(buffer[i]))
+                handlePacket(now_ms);
+        }
+    }
+    if (n < 0)
+    {
+        drop();
+        return;
+    }
+
+    if (_state == CONNECTING)
+    {
+        if (now_ms - _stateSinceMs > MQTT_CONNACK_TIMEOUT_MS)
+        {
+            _metrics.connect_failures++;
+            drop();
+        }
+        return;
+    }
+
+    // keepalive: ping after half the interval without traffic, give up after a full one without answer
+    uint32_t keepalive_ms = _keepaliveS * 1000UL;
+    if (keepalive_ms)
+    {
+        if (_pingPending && now_ms - _lastReceivedMs > keepalive_ms)
+        {
+            drop();
+            return;
+        }
+        if (!_pingPending && (now_ms - _lastSentMs > keepalive_ms / 2 || now_ms - _lastReceivedMs > keepalive_ms / 2))
+        {
+            uint8_t packet[2];
+            if (!send(packet, encodePingreq(packet, sizeof(packet)), now_ms))
+                return;
+            _pingPending = true;
+        }
+    }
+
+    resendInflight(now_ms, false);
+}
+
+bool MqttSession::publish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos, bool retain, uint32_t now_ms)
+{
+    if (_state != CONNECTED)
+        return false;
+
+    if (qos == 0)
+    {
+        uint8_t packet[MQTT_MAX_PACKET];
+        size_t length = encodePublish(topic, payload, len, 0, retain, 0, packet, sizeof(packet));
+        if (length == 0 || !send(packet, length, now_ms))
+            return false;
+        _metrics.published++;
+        return true;
+    }
+
+    if (_inflightCount >= _maxInflight)
+        return false;
+
+    Inflight *slot = nullptr;
+    for (Inflight &candidate : _inflight)
+    {
+        if (candidate.packet_id == 0)
+        {
+            slot = &candidate;
+            break;
+        }
+    }
+    if (slot == nullptr)
+        return false;
+
+    uint16_t id = _nextPacketId++;
+    if (_nextPacketId == 0)
+        _nextPacketId = 1;
+
+    size_t length = encodePublish(topic, payload, len, 1, retain, id, slot->packet, sizeof(slot->packet));
+    if (length == 0)
+        return false;
+
+    // owned by the session from here, even if the write fails it is resent after reconnect
+    slot->packet_id = id;
+    slot->length = length;
+    slot->sent_ms = now_ms;
+    slot->first_sent_ms = now_ms;
+    _inflightCount++;
+    _metrics.published++;
+
+    send(slot->packet, length, now_ms);
+    return true;
+}
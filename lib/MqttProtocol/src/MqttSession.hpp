@@ -0,0 +1,104 @@
+#pragma once
+
+// Publishing MQTT session on top of a pluggable transport (WiFiClient on target, POSIX
+// socket on host). QoS 1 messages are kept until their PUBACK arrives, at most max_inflight
+// at a time, and are retransmitted with DUP after retry_ms and after every reconnect.
+//
+// Not thread safe, the owner serializes calls.
+
+#include <MqttProtocol.hpp>
+
+#define MQTT_MAX_INFLIGHT 8
+#define MQTT_CONNACK_TIMEOUT_MS 5000
+
+class MqttTransport
+{
+public:
+    // may block up to a transport specific timeout
+    virtual bool connect(const char *host, uint16_t port) = 0;
+    virtual bool connected() = 0;
+    // returns false if not all bytes could be written
+    virtual bool write(const uint8_t *data, size_t len) = 0;
+    // never blocks, returns bytes read, 0 if nothing available, -1 on error
+    virtual int read(uint8_t *data, size_t len) = 0;
+    virtual void close() = 0;
+};
+
+struct MqttMetrics
+{
+    uint32_t connects = 0;
+    uint32_t connect_failures = 0;
+    uint32_t disconnects = 0;
+    uint32_t published = 0;
+    uint32_t acked = 0;
+    uint32_t retransmits = 0;
+    uint32_t bytes_sent = 0;
+    uint32_t ack_latency_ms_max = 0;
+};
+
+class MqttSession
+{
+public:
+    enum State : uint8_t
+    {
+        DISCONNECTED,
+        CONNECTING, // waiting for CONNACK
+        CONNECTED,
+    };
+
+private:
+    struct Inflight
+    {
+        uint16_t packet_id = 0; // 0: free slot
+        uint32_t sent_ms = 0;
+        uint32_t first_sent_ms = 0;
+        uint16_t length = 0;
+        uint8_t packet[MQTT_MAX_PACKET];
+    };
+
+    MqttTransport &_transport;
+    MqttProtocol::PacketReader _reader;
+    State _state = DISCONNECTED;
+
+    uint8_t _maxInflight = MQTT_MAX_INFLIGHT;
+    uint32_t _retryMs = 5000;
+    uint16_t _keepaliveS = 30;
+
+    Inflight _inflight[MQTT_MAX_INFLIGHT];
+    uint8_t _inflightCount = 0;
+    uint16_t _nextPacketId = 1;
+
+    uint32_t _stateSinceMs = 0;
+    uint32_t _lastSentMs = 0;
+    uint32_t _lastReceivedMs = 0;
+    bool _pingPending = false;
+
+    MqttMetrics _metrics;
+
+    bool send(const uint8_t *data, size_t len, uint32_t now_ms);
+    void handlePacket(uint32_t now_ms);
+    void resendInflight(uint32_t now_ms, bool all);
+    void drop(); // transport lost, inflight messages are kept
+
+public:
+    MqttSession(MqttTransport &transport);
+
+    // max_inflight is clamped to MQTT_MAX_INFLIGHT, retry_ms 0 resends on reconnect only
+    void setWindow(uint8_t max_inflight, uint32_t retry_ms);
+
+    // opens the transport and sends CONNECT, the session is usable after CONNACK (see loop)
+    bool connect(const char *host, uint16_t port, const MqttProtocol::ConnectOptions &options, uint32_t now_ms);
+    void disconnect(uint32_t now_ms);
+
+    // receive acks, keepalive, retransmissions. call often
+    void loop(uint32_t now_ms);
+
+    // qos 1 needs a free inflight slot, see canPublish
+    bool publish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos, bool retain, uint32_t now_ms);
+
+    bool canPublish() const { return _state == CONNECTED && _inflightCount < _maxInflight; }
+    State getState() const { return _state; }
+    bool isConnected() const { return _state == CONNECTED; }
+    uint8_t getInflight() const { return _inflightCount; }
+    const MqttMetrics &getMetrics() const { return _metrics; }
+};
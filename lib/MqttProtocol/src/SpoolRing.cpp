@@ -0,0 +1,224 @@
+#include <SpoolRing.hpp>
+
+#include <string.h>
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ---- SpoolStdioFile ----
+
+SpoolStdioFile::~SpoolStdioFile()
+{
+    end();
+}
+
+void SpoolStdioFile::begin(const char *path)
+{
+    end();
+    snprintf(_path, sizeof(_path), "%s", path);
+    _file = fopen(_path, "r+b");
+}
+
+void SpoolStdioFile::end()
+{
+    if (_file)
+        fclose(_file);
+    _file = nullptr;
+}
+
+bool SpoolStdioFile::read(uint32_t offset, uint8_t *data, size_t len)
+{
+    return _file && fseek(_file, offset, SEEK_SET) == 0 && fread(data, 1, len, _file) == len;
+}
+
+bool SpoolStdioFile::writeAt(long offset, int whence, const uint8_t *data, size_t len)
+{
+    return _file && fseek(_file, offset, whence) == 0 && fwrite(data, 1, len, _file) == len && fflush(_file) == 0;
+}
+
+bool SpoolStdioFile::create(const uint8_t *data, size_t len)
+{
+    end();
+    _file = fopen(_path, "w+b");
+    return writeAt(0, SEEK_SET, data, len);
+}
+
+bool SpoolStdioFile::append(const uint8_t *data, size_t len)
+{
+    return writeAt(0, SEEK_END, data, len);
+}
+
+bool SpoolStdioFile::write(uint32_t offset, const uint8_t *data, size_t len)
+{
+    return writeAt(offset, SEEK_SET, data, len);
+}
+
+// ---- SpoolRing ----
+
+SpoolRing::~SpoolRing()
+{
+    close();
+}
+
+uint32_t SpoolRing::slotOffset(uint32_t counter) const
+{
+    return SPOOL_HEADER_SIZE + (counter % _slotCount) * (2 + _slotSize);
+}
+
+bool SpoolRing::writeHeader()
+{
+    uint8_t header[SPOOL_HEADER_SIZE];
+    put32(header, SPOOL_MAGIC);
+    header[4] = _slotSize;
+    header[5] = _slotSize >> 8;
+    header[6] = _slotCount;
+    header[7] = _slotCount >> 8;
+    put32(header + 8, _head);
+    put32(header + 12, _tail);
+    put32(header + 16, _dropped);
+
+    return _file.write(0, header, sizeof(header));
+}
+
+bool SpoolRing::open(const char *path, uint16_t slot_size, uint16_t slot_count)
+{
+    close();
+    if (slot_size == 0 || slot_count == 0)
+        return false;
+
+    _slotSize = slot_size;
+    _slotCount = slot_count;
+    _file.begin(path);
+
+    uint8_t header[SPOOL_HEADER_SIZE];
+    if (_file.read(0, header, sizeof(header)) && get32(header) == SPOOL_MAGIC &&
+        (header[4] | (header[5] << 8)) == slot_size && (header[6] | (header[7] << 8)) == slot_count)
+    {
+        _head = get32(header + 8);
+        _tail = get32(header + 12);
+        _dropped = get32(header + 16);
+        if (_head - _tail <= _slotCount)
+        {
+            _settled = _head;
+            _open = true;
+            return true;
+        }
+    }
+
+    // missing, different geometry or corrupted: start over
+    _head = 0;
+    _tail = 0;
+    _dropped = 0;
+    _settled = 0;
+
+    put32(header, SPOOL_MAGIC);
+    header[4] = _slotSize;
+    header[5] = _slotSize >> 8;
+    header[6] = _slotCount;
+    header[7] = _slotCount >> 8;
+    memset(header + 8, 0, sizeof(header) - 8);
+    if (!_file.create(header, sizeof(header)))
+    {
+        _file.end();
+        return false;
+    }
+
+    // preallocate, so a full filesystem shows up now and not while offline
+    uint8_t zero[512] = {0};
+    uint32_t total = slotOffset(0) + (uint32_t)_slotCount * (2 + _slotSize);
+    for (uint32_t written = SPOOL_HEADER_SIZE; written < total; written += sizeof(zero))
+    {
+        size_t n = total - written < sizeof(zero) ? total - written : sizeof(zero);
+        if (!_file.append(zero, n))
+        {
+            _file.end();
+            return false;
+        }
+    }
+
+    _open = true;
+    return true;
+}
+
+void SpoolRing::close()
+{
+    if (_open)
+        _file.end();
+    _open = false;
+}
+
+bool SpoolRing::push(const uint8_t *data, uint16_t len)
+{
+    if (!_open || len == 0 || len > _slotSize)
+        return false;
+
+    if (_head - _tail >= _slotCount)
+    {
+        // full: overwrite the oldest
+        _tail++;
+        _dropped++;
+    }
+
+    uint8_t length[2] = {(uint8_t)len, (uint8_t)(len >> 8)};
+    if (!_file.write(slotOffset(_head), length, 2) || !_file.write(slotOffset(_head) + 2, data, len))
+        return false;
+
+    _head++;
+    return writeHeader();
+}
+
+uint16_t SpoolRing::peek(uint8_t *data, uint16_t size)
+{
+    if (!_open || _head == _tail)
+        return 0;
+
+    // a slot pushed in this session is read once its writes are in the file
+    if ((int32_t)(_tail - _settled) >= 0)
+    {
+        if (!_file.settled())
+            return 0;
+        _settled = _head;
+    }
+
+    uint8_t length[2];
+    if (!_file.read(slotOffset(_tail), length, 2))
+        return 0;
+
+    uint16_t len = length[0] | (length[1] << 8);
+    if (len == 0 || len > _slotSize || len > size || !_file.read(slotOffset(_tail) + 2, data, len))
+    {
+        // unreadable slot, skip it
+        pop();
+        _dropped++;
+        return 0;
+    }
+    return len;
+}
+
+void SpoolRing::pop()
+{
+    if (!_open || _head == _tail)
+        return;
+
+    _tail++;
+    writeHeader();
+}
+
+void SpoolRing::clear()
+{
+    if (!_open)
+        return;
+
+    _tail = _head;
+    writeHeader();
+}
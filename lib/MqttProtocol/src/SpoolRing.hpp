@@ -0,0 +1,94 @@
+#pragma once
+
+// Persistent FIFO of messages in a single preallocated file of fixed size slots, used to keep
+// data while the broker is unreachable. When full, the oldest message is overwritten.
+// The file is accessed through a pluggable SpoolFile: stdio on host (SpoolStdioFile), the
+// storage task on target, which queues the writes and reports when they are in the file.
+//
+// file: magic u32 | slot_size u16 | slot_count u16 | head u32 | tail u32 | dropped u32 | slots
+// slot: length u16 | data[slot_size]
+// head/tail are running counters, the slot index is counter % slot_count.
+//
+// Not thread safe, the owner serializes calls.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define SPOOL_MAGIC 0x4C4F5053 // "SPOL"
+#define SPOOL_HEADER_SIZE 20
+#define SPOOL_PATH_SIZE 48
+
+class SpoolFile
+{
+public:
+    // the file all other calls work on
+    virtual void begin(const char *path) = 0;
+    virtual void end() {}
+    // false if the file is missing or shorter
+    virtual bool read(uint32_t offset, uint8_t *data, size_t len) = 0;
+    // the writes may complete later, in the order issued
+    // new file with this content, replaces an existing one
+    virtual bool create(const uint8_t *data, size_t len) = 0;
+    virtual bool append(const uint8_t *data, size_t len) = 0;
+    // within the file
+    virtual bool write(uint32_t offset, const uint8_t *data, size_t len) = 0;
+    // all writes issued so far are in the file, a read sees them
+    virtual bool settled() { return true; }
+};
+
+// direct stdio, every write is in the file when it returns
+class SpoolStdioFile : public SpoolFile
+{
+private:
+    FILE *_file = nullptr;
+    char _path[SPOOL_PATH_SIZE] = "";
+
+    bool writeAt(long offset, int whence, const uint8_t *data, size_t len);
+
+public:
+    ~SpoolStdioFile();
+
+    virtual void begin(const char *path) override;
+    virtual void end() override;
+    virtual bool read(uint32_t offset, uint8_t *data, size_t len) override;
+    virtual bool create(const uint8_t *data, size_t len) override;
+    virtual bool append(const uint8_t *data, size_t len) override;
+    virtual bool write(uint32_t offset, const uint8_t *data, size_t len) override;
+};
+
+class SpoolRing
+{
+private:
+    SpoolFile &_file;
+    bool _open = false;
+    uint16_t _slotSize = 0;
+    uint16_t _slotCount = 0;
+    uint32_t _head = 0; // next write
+    uint32_t _tail = 0; // oldest
+    uint32_t _dropped = 0;
+    uint32_t _settled = 0; // slots before this counter are in the file
+
+    bool writeHeader();
+    uint32_t slotOffset(uint32_t counter) const;
+
+public:
+    SpoolRing(SpoolFile &file) : _file(file) {}
+    ~SpoolRing();
+
+    // reopens an existing spool with the same geometry, otherwise creates a new one
+    bool open(const char *path, uint16_t slot_size, uint16_t slot_count);
+    void close();
+    bool isOpen() const { return _open; }
+
+    bool push(const uint8_t *data, uint16_t len);
+    // copies the oldest message, returns its length, 0 if empty, on error or while the oldest
+    // message is not yet written to the file
+    uint16_t peek(uint8_t *data, uint16_t size);
+    void pop();
+    void clear();
+
+    uint32_t getCount() const { return _head - _tail; }
+    uint16_t getCapacity() const { return _slotCount; }
+    uint32_t getDropped() const { return _dropped; }
+};
@@ -0,0 +1,85 @@
+#include <SampleEvents.hpp>
+
+#include <EventStream.hpp> // -->EventStream
+#include <Loadcell.hpp>    // -->g_Loadcell
+#include <MemoryPlan.hpp>  // -->g_MemoryPlan
+
+SampleEventsClass g_SampleEvents;
+
+SampleEventsClass::SampleEventsClass()
+{
+    // on init construct with default variables
+}
+
+void SampleEventsClass::initialize()
+{
+    log_i("SampleEvents init");
+
+    _samples = xStreamBufferCreateStatic(SAMPLEEVENTS_BUFFER_SIZE, sizeof(Sample), _samplesStorage, &_samplesStruct);
+    g_MemoryPlan.registerStatic("sample events buffer", sizeof(_samplesStorage));
+}
+
+uint32_t SampleEventsClass::getOverruns()
+{
+    return _overruns;
+}
+
+void SampleEventsClass::push(uint32_t timestamp_us, float value)
+{
+    if (!_active || ++_skipped < _decimation)
+        return;
+    _skipped = 0;
+
+    // a lost sample still takes its index, the aggregator sees the gap
+    Sample sample = {_index++, timestamp_us, value};
+    if (xStreamBufferSend(_samples, &sample, sizeof(sample), 0) != sizeof(sample))
+        _overruns++;
+}
+
+void SampleEventsClass::send()
+{
+    EventStream::publish(SAMPLEBLOCK_CHANNEL, _block.text(), _block.getLastUs());
+    _block.clear();
+}
+
+void SampleEventsClass::update_loop()
+{
+    bool active = EventStream::hasSubscribers(SAMPLEBLOCK_CHANNEL);
+    if (active != _active)
+    {
+        // samples left from the last subscription are stale, acquisition does not push meanwhile
+        if (active)
+        {
+            xStreamBufferReset(_samples);
+            _block.clear();
+        }
+        _active = active;
+        log_i("sample events %s", active ? "started" : "stopped");
+    }
+    if (!_active)
+        return;
+
+    float rate = g_Loadcell.getSampleRate();
+    _decimation = rate > SAMPLEEVENTS_MAX_RATE ? (uint8_t)ceilf(rate / SAMPLEEVENTS_MAX_RATE) : 1;
+    _block.setDigits(g_Loadcell.sensor_config.digits);
+
+    Sample samples[32];
+    size_t received;
+    while ((received = xStreamBufferReceive(_samples, samples, sizeof(samples), 0)) > 0)
+    {
+        for (size_t i = 0; i < received / sizeof(Sample); i++)
+        {
+            if (_block.isEmpty())
+                _blockSince_ms = millis();
+            if (_block.add(samples[i].index, samples[i].timestamp_us, samples[i].value))
+                continue;
+
+            send();
+            _blockSince_ms = millis();
+            _block.add(samples[i].index, samples[i].timestamp_us, samples[i].value);
+        }
+    }
+
+    if (!_block.isEmpty() && millis() - _blockSince_ms >= SAMPLEEVENTS_MAX_AGE_MS)
+        send();
+}
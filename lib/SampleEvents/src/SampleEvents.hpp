@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/stream_buffer.h>
+#include <SampleBlock.hpp>
+
+#define SAMPLEEVENTS_BUFFER_SIZE 3072 // 256 samples, 0.8 s at 320 SPS
+#define SAMPLEEVENTS_MAX_RATE 400     // samples/s in the stream, faster adc rates are decimated
+#define SAMPLEEVENTS_MAX_AGE_MS 100   // a block is sent after this even if not full
+
+/// Every sample with its data ready timestamp on the "samples" event channel, packed into
+/// SampleBlock payloads, for aggregators that align several boxes (tools/host aggregator).
+/// Same values as the MQTT sample stream (sensor stream_channel). Loadcell pushes without
+/// blocking, Task_SampleEvents packs and publishes. Only runs while a client subscribed the
+/// channel by name (/events?fields=samples), it is not part of a subscription to all channels.
+class SampleEventsClass
+{
+private:
+    struct Sample
+    {
+        uint32_t index;
+        uint32_t timestamp_us;
+        float value;
+    };
+
+    StreamBufferHandle_t _samples = NULL;
+    uint8_t _samplesStorage[SAMPLEEVENTS_BUFFER_SIZE + 1]; // static, see MemoryPlan
+    StaticStreamBuffer_t _samplesStruct;
+
+    SampleBlockWriter _block;
+    uint32_t _blockSince_ms = 0;
+
+    volatile bool _active = false;
+    volatile uint8_t _decimation = 1;
+    // acquisition only
+    uint32_t _index = 0;
+    uint8_t _skipped = 0;
+    uint32_t _overruns = 0;
+
+    void send();
+
+public:
+    SampleEventsClass();
+
+    void initialize();
+    void update_loop();
+
+    // called from acquisition, never blocks
+    void push(uint32_t timestamp_us, float value);
+
+    uint32_t getOverruns();
+};
+
+extern SampleEventsClass g_SampleEvents;
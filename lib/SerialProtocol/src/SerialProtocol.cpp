@@ -0,0 +1,171 @@
+#include <SerialProtocol.hpp>
+
+#include <string.h>
+
+namespace SerialProtocol
+{
+    uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc)
+    {
+        // CRC-16/CCITT-FALSE, nibble table keeps it small and fast enough for the serial rate
+        static const uint16_t table[16] = {
+            0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+            0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef};
+
+        for (size_t i = 0; i < len; i++)
+        {
+            crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+            crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+        }
+        return crc;
+    }
+
+    size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out)
+    {
+        size_t code_pos = 0;
+        size_t out_pos = 1;
+        uint8_t code = 1;
+
+        for (size_t i = 0; i < len; i++)
+        {
+            if (in[i] == 0)
+            {
+                out[code_pos] = code;
+                code_pos = out_pos++;
+                code = 1;
+                continue;
+            }
+
+            out[out_pos++] = in[i];
+            if (++code == 0xFF)
+            {
+                out[code_pos] = code;
+                code_pos = out_pos++;
+                code = 1;
+            }
+        }
+        out[code_pos] = code;
+
+        return out_pos;
+    }
+
+    size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out)
+    {
+        size_t in_pos = 0;
+        size_t out_pos = 0;
+
+        while (in_pos < len)
+        {
+            uint8_t code = in[in_pos++];
+            if (code == 0 || in_pos + code - 1 > len)
+                return 0;
+
+            for (uint8_t i = 1; i < code; i++)
+                out[out_pos++] = in[in_pos++];
+
+            if (code != 0xFF && in_pos < len)
+                out[out_pos++] = 0;
+        }
+        return out_pos;
+    }
+
+    size_t encodeFrame(uint8_t type, uint16_t seq, const uint8_t *payload, size_t len, uint8_t *out)
+    {
+        if (len > SP_MAX_PAYLOAD)
+            return 0;
+
+        uint8_t frame[SP_MAX_FRAME];
+        frame[0] = type;
+        frame[1] = seq & 0xFF;
+        frame[2] = seq >> 8;
+        memcpy(frame + 3, payload, len);
+
+        uint16_t crc = crc16(frame, 3 + len);
+        frame[3 + len] = crc & 0xFF;
+        frame[4 + len] = crc >> 8;
+
+        out[0] = 0;
+        size_t encoded = 1 + cobsEncode(frame, 5 + len, out + 1);
+        out[encoded++] = 0;
+        return encoded;
+    }
+
+    size_t encodeSamples(const Sample *samples, size_t count, uint8_t *payload)
+    {
+        if (count > SP_MAX_SAMPLES_PER_FRAME)
+            count = SP_MAX_SAMPLES_PER_FRAME;
+
+        uint8_t *p = payload;
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t t = samples[i].timestamp_us;
+            uint32_t raw = (uint32_t)samples[i].raw;
+            p[0] = t;
+            p[1] = t >> 8;
+            p[2] = t >> 16;
+            p[3] = t >> 24;
+            p[4] = raw;
+            p[5] = raw >> 8;
+            p[6] = raw >> 16;
+            p += SP_SAMPLE_SIZE;
+        }
+        return p - payload;
+    }
+
+    size_t decodeSamples(const uint8_t *payload, size_t len, Sample *samples)
+    {
+        size_t count = len / SP_SAMPLE_SIZE;
+        if (count > SP_MAX_SAMPLES_PER_FRAME)
+            count = SP_MAX_SAMPLES_PER_FRAME;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint8_t *p = payload + i * SP_SAMPLE_SIZE;
+            samples[i].timestamp_us = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+            // sign extend 24 bit
+            samples[i].raw = (int32_t)((uint32_t)(p[4] | (p[5] << 8) | (p[6] << 16)) << 8) >> 8;
+        }
+        return count;
+    }
+
+    bool FrameDecoder::feed(uint8_t byte)
+    {
+        if (byte != 0)
+        {
+            if (_length < sizeof(_buffer))
+                _buffer[_length++] = byte;
+            else
+                _overflow = true;
+            return false;
+        }
+
+        // delimiter: decode what was collected
+        size_t length = _length;
+        bool overflow = _overflow;
+        _length = 0;
+        _overflow = false;
+
+        if (length == 0)
+            return false;
+
+        size_t decoded = overflow ? 0 : cobsDecode(_buffer, length, _buffer);
+        if (decoded < 5)
+        {
+            framing_errors++;
+            return false;
+        }
+
+        uint16_t crc = _buffer[decoded - 2] | (_buffer[decoded - 1] << 8);
+        if (crc16(_buffer, decoded - 2) != crc)
+        {
+            crc_errors++;
+            return false;
+        }
+
+        _type = _buffer[0];
+        _seq = _buffer[1] | (_buffer[2] << 8);
+        _payloadLength = decoded - 5;
+        frames++;
+
+        return true;
+    }
+}
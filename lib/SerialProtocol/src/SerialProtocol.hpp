@@ -0,0 +1,87 @@
+#pragma once
+
+// Framed binary protocol for the USB serial link, shared by firmware (SerialStream) and host
+// decoder (tools/host sgstream). Must not depend on Arduino headers.
+//
+// frame before COBS: type u8 | seq u16 | payload | crc16 (CCITT-FALSE over type..payload)
+// on the wire:       0x00 COBS(frame) 0x00 (leading delimiter resyncs after plain text output)
+// all integers little endian
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SP_MAX_PAYLOAD 240
+#define SP_MAX_FRAME (3 + SP_MAX_PAYLOAD + 2)
+#define SP_MAX_ENCODED (SP_MAX_FRAME + SP_MAX_FRAME / 254 + 3)
+
+#define SP_SAMPLE_SIZE 7 // u32 timestamp_us, int24 raw
+#define SP_MAX_SAMPLES_PER_FRAME (SP_MAX_PAYLOAD / SP_SAMPLE_SIZE)
+
+namespace SerialProtocol
+{
+    enum FrameType : uint8_t
+    {
+        FRAME_SAMPLES = 0x01,        // device -> host: batch of raw samples
+        FRAME_LOG = 0x02,            // device -> host: log text
+        FRAME_ACK = 0x03,            // device -> host: command, result
+        FRAME_SAMPLES_PACKED = 0x04, // device -> host: one SampleCodec block, first_index counts from start
+        FRAME_COMMAND = 0x10,        // host -> device: command, args
+    };
+
+    enum Command : uint8_t
+    {
+        CMD_PING = 0x01,
+        CMD_START = 0x02,    // optional arg u8: 1 FRAME_SAMPLES_PACKED instead of FRAME_SAMPLES
+        CMD_STOP = 0x03,
+        CMD_TARE = 0x04,
+        CMD_SET_RATE = 0x05, // arg u8: samplerate enum of the adc backend (adc.json)
+    };
+
+    struct Sample
+    {
+        uint32_t timestamp_us;
+        int32_t raw;
+    };
+
+    uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
+
+    // out needs len + len / 254 + 1 bytes. returns encoded length (without delimiter)
+    size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out);
+    // returns decoded length, 0 on malformed input. in place decoding is allowed
+    size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out);
+
+    // build complete wire frame including both 0x00 delimiters into out (SP_MAX_ENCODED).
+    // returns wire length, 0 if the payload is too large
+    size_t encodeFrame(uint8_t type, uint16_t seq, const uint8_t *payload, size_t len, uint8_t *out);
+
+    size_t encodeSamples(const Sample *samples, size_t count, uint8_t *payload);
+    // returns number of samples decoded into samples (SP_MAX_SAMPLES_PER_FRAME)
+    size_t decodeSamples(const uint8_t *payload, size_t len, Sample *samples);
+
+    /// Reassembles frames from a byte stream. Garbage and corrupted frames are skipped
+    /// and counted, decoding resyncs on the next 0x00 delimiter.
+    class FrameDecoder
+    {
+    private:
+        uint8_t _buffer[SP_MAX_ENCODED];
+        size_t _length = 0;
+        bool _overflow = false;
+
+        uint8_t _type = 0;
+        uint16_t _seq = 0;
+        size_t _payloadLength = 0;
+
+    public:
+        uint32_t frames = 0;
+        uint32_t crc_errors = 0;
+        uint32_t framing_errors = 0;
+
+        // returns true if a valid frame is complete, valid until the next call
+        bool feed(uint8_t byte);
+
+        uint8_t type() const { return _type; }
+        uint16_t seq() const { return _seq; }
+        const uint8_t *payload() const { return _buffer + 3; }
+        size_t payloadLength() const { return _payloadLength; }
+    };
+}
@@ -0,0 +1,238 @@
+#include <SerialStream.hpp>
+
+#include <rom/ets_sys.h>
+#include <Trace.hpp> // -->g_Trace
+#include <MemoryPlan.hpp> // -->g_MemoryPlan
+
+using namespace SerialProtocol;
+
+SerialStreamClass g_SerialStream;
+
+SerialStreamClass::SerialStreamClass()
+{
+    // on init construct with default variables
+}
+
+void SerialStreamClass::initialize()
+{
+    log_i("SerialStream init");
+
+    _samples = xStreamBufferCreateStatic(SERIALSTREAM_SAMPLE_BUFFER_SIZE, sizeof(Sample), _samplesStorage, &_samplesStruct);
+    g_MemoryPlan.registerStatic("serialstream buffer", sizeof(_samplesStorage));
+    g_MemoryPlan.registerStatic("serialstream packed", sizeof(_pending));
+
+    // take over debug output (replaces the hook installed by Serial.setDebugOutput)
+    ets_install_putc1(putcHook);
+}
+
+// runs in the context of whoever prints, also from ets_printf with the uart driver's lock
+// held or with interrupts disabled: buffer only, Serial.write here can deadlock
+void SerialStreamClass::putcHook(char c)
+{
+    SerialStreamClass &self = g_SerialStream;
+
+    portENTER_CRITICAL_SAFE(&self._logMux);
+    size_t next = (self._logHead + 1) % SERIALSTREAM_LOG_BUFFER_SIZE;
+    if (next != self._logTail)
+    {
+        self._log[self._logHead] = c;
+        self._logHead = next;
+    }
+    else
+    {
+        self._logOverruns++;
+    }
+    portEXIT_CRITICAL_SAFE(&self._logMux);
+}
+
+bool SerialStreamClass::isActive()
+{
+    return _active;
+}
+uint32_t SerialStreamClass::getOverruns()
+{
+    return _overruns;
+}
+
+void SerialStreamClass::push(uint32_t timestamp_us, int32_t raw)
+{
+    if (!_active)
+        return;
+
+    Sample sample = {timestamp_us, raw};
+    if (xStreamBufferSend(_samples, &sample, sizeof(sample), 0) != sizeof(sample))
+        _overruns++;
+}
+
+void SerialStreamClass::sendFrame(uint8_t type, const uint8_t *payload, size_t len)
+{
+    uint8_t wire[SP_MAX_ENCODED];
+    size_t wire_len = encodeFrame(type, _seq++, payload, len, wire);
+    Serial.write(wire, wire_len);
+}
+
+void SerialStreamClass::sendSamples()
+{
+    Sample samples[SP_MAX_SAMPLES_PER_FRAME];
+    uint8_t payload[SP_MAX_PAYLOAD];
+    size_t received;
+
+    while ((received = xStreamBufferReceive(_samples, samples, sizeof(samples), 0)) > 0)
+    {
+        size_t len = encodeSamples(samples, received / sizeof(Sample), payload);
+        sendFrame(FRAME_SAMPLES, payload, len);
+        // oldest sample of the frame, worst case
+        g_Trace.record(TRACE_SERIAL, samples[0].timestamp_us);
+    }
+}
+
+// frames of as many pending samples as fit, the rest waits for the next frame
+void SerialStreamClass::sendPacked(bool flush)
+{
+    Sample samples[SP_MAX_SAMPLES_PER_FRAME];
+    uint8_t payload[SP_MAX_PAYLOAD];
+
+    while (true)
+    {
+        size_t received;
+        do
+        {
+            size_t space = min(SERIALSTREAM_PACKED_SAMPLES - _pendingCount, (size_t)SP_MAX_SAMPLES_PER_FRAME);
+            received = space ? xStreamBufferReceive(_samples, samples, space * sizeof(Sample), 0) / sizeof(Sample) : 0;
+            if (received > 0 && _pendingCount == 0)
+                _pendingSince_ms = millis();
+            for (size_t i = 0; i < received; i++)
+                _pending[_pendingCount++] = {samples[i].timestamp_us, samples[i].raw};
+        } while (received > 0);
+
+        if (_pendingCount == 0)
+            return;
+        if (!flush && _pendingCount < SERIALSTREAM_PACKED_SAMPLES && millis() - _pendingSince_ms < SERIALSTREAM_PACKED_MAX_AGE_MS)
+            return;
+
+        CodecResult result = SampleCodec::encodeBlock(_pending, _pendingCount, _packedIndex, payload, sizeof(payload));
+        sendFrame(FRAME_SAMPLES_PACKED, payload, result.bytes);
+        // oldest sample of the frame, worst case
+        g_Trace.record(TRACE_SERIAL, _pending[0].timestamp_us);
+
+        _packedIndex += result.samples;
+        _pendingCount -= result.samples;
+        memmove(_pending, _pending + result.samples, _pendingCount * sizeof(CaptureSample));
+        _pendingSince_ms = millis();
+    }
+}
+
+void SerialStreamClass::sendLog()
+{
+    uint8_t payload[SP_MAX_PAYLOAD];
+    size_t len = 0;
+
+    while (_logTail != _logHead)
+    {
+        portENTER_CRITICAL(&_logMux);
+        while (_logTail != _logHead && len < sizeof(payload))
+        {
+            payload[len++] = _log[_logTail];
+            _logTail = (_logTail + 1) % SERIALSTREAM_LOG_BUFFER_SIZE;
+        }
+        portEXIT_CRITICAL(&_logMux);
+
+        sendFrame(FRAME_LOG, payload, len);
+        len = 0;
+    }
+}
+
+// plain text while not streaming
+void SerialStreamClass::writeLog()
+{
+    char text[128];
+    size_t len = 0;
+
+    while (_logTail != _logHead)
+    {
+        portENTER_CRITICAL(&_logMux);
+        while (_logTail != _logHead && len < sizeof(text))
+        {
+            text[len++] = _log[_logTail];
+            _logTail = (_logTail + 1) % SERIALSTREAM_LOG_BUFFER_SIZE;
+        }
+        portEXIT_CRITICAL(&_logMux);
+
+        Serial.write((const uint8_t *)text, len);
+        len = 0;
+    }
+}
+
+void SerialStreamClass::handleCommand(const uint8_t *payload, size_t len)
+{
+    if (len < 1)
+        return;
+
+    uint8_t ack[2] = {payload[0], 0};
+
+    switch (payload[0])
+    {
+    case CMD_PING:
+        break;
+    case CMD_START:
+        xStreamBufferReset(_samples);
+        _overruns = 0;
+        _packed = len >= 2 && payload[1] == 1;
+        _pendingCount = 0;
+        _packedIndex = 0;
+        _active = true;
+        break;
+    case CMD_STOP:
+        if (_packed)
+            sendPacked(true);
+        else
+            sendSamples();
+        sendLog();
+        _active = false;
+        break;
+    case CMD_TARE:
+    {
+        Event ev("Loadcell/tare");
+        EventManager::instance().publish(ev);
+        break;
+    }
+    case CMD_SET_RATE:
+    {
+        if (len < 2)
+        {
+            ack[1] = 1;
+            break;
+        }
+        DataEvent ev("Loadcell/setSampleRate", String(payload[1]));
+        EventManager::instance().publish(ev);
+        break;
+    }
+    default:
+        ack[1] = 1; // unknown command
+    }
+
+    sendFrame(FRAME_ACK, ack, sizeof(ack));
+}
+
+void SerialStreamClass::update_loop()
+{
+    // commands from host, plain text typed into a terminal is ignored by the decoder
+    while (Serial.available())
+    {
+        if (_decoder.feed(Serial.read()) && _decoder.type() == FRAME_COMMAND)
+            handleCommand(_decoder.payload(), _decoder.payloadLength());
+    }
+
+    if (_active)
+    {
+        if (_packed)
+            sendPacked(false);
+        else
+            sendSamples();
+        sendLog();
+    }
+    else
+    {
+        writeLog();
+    }
+}
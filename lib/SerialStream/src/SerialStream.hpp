@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/stream_buffer.h>
+#include <DataEvent.hpp>
+#include <SerialProtocol.hpp>
+#include <SampleCodec.hpp>
+
+#define SERIALSTREAM_SAMPLE_BUFFER_SIZE 4096
+#define SERIALSTREAM_LOG_BUFFER_SIZE 1024
+#define SERIALSTREAM_PACKED_SAMPLES 128    // collected for one packed frame, about 100 fit at low noise
+#define SERIALSTREAM_PACKED_MAX_AGE_MS 100 // send a packed frame after this even if not full
+
+using namespace esp32m;
+
+/// Lossless full rate sample streaming over USB serial using SerialProtocol frames.
+/// All log output is captured by the putc hook and written by the serial stream task, as
+/// FRAME_LOG while streaming, so text never corrupts the binary stream, and as plain text
+/// otherwise. The hook never calls the uart driver, it may run with the driver locked. Streaming is started/stopped by host commands, on request with
+/// compressed sample frames (SampleCodec blocks), which carry about three times the samples
+/// of a plain frame but are held back until a frame is full or SERIALSTREAM_PACKED_MAX_AGE_MS.
+class SerialStreamClass
+{
+private:
+    StreamBufferHandle_t _samples = NULL;
+    uint8_t _samplesStorage[SERIALSTREAM_SAMPLE_BUFFER_SIZE + 1]; // static, see MemoryPlan
+    StaticStreamBuffer_t _samplesStruct;
+
+    // log characters captured from the putc hook, any task may write, dropped if full
+    char _log[SERIALSTREAM_LOG_BUFFER_SIZE];
+    volatile size_t _logHead = 0;
+    volatile size_t _logTail = 0;
+    portMUX_TYPE _logMux = portMUX_INITIALIZER_UNLOCKED;
+
+    SerialProtocol::FrameDecoder _decoder;
+    uint16_t _seq = 0;
+
+    volatile bool _active = false;
+
+    // packed frames
+    bool _packed = false;
+    CaptureSample _pending[SERIALSTREAM_PACKED_SAMPLES];
+    size_t _pendingCount = 0;
+    uint32_t _pendingSince_ms = 0;
+    uint32_t _packedIndex = 0;
+
+    uint32_t _overruns = 0;
+    uint32_t _logOverruns = 0;
+
+    static void putcHook(char c);
+
+    void sendFrame(uint8_t type, const uint8_t *payload, size_t len);
+    void sendSamples();
+    void sendPacked(bool flush);
+    void sendLog();
+    void writeLog();
+    void handleCommand(const uint8_t *payload, size_t len);
+
+public:
+    SerialStreamClass();
+
+    void initialize();
+    void update_loop();
+
+    // called from acquisition, never blocks
+    void push(uint32_t timestamp_us, int32_t raw);
+
+    bool isActive();
+    uint32_t getOverruns();
+};
+
+extern SerialStreamClass g_SerialStream;
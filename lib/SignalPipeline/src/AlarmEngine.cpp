@@ -0,0 +1,109 @@
+#include <AlarmEngine.hpp>
+
+#include <math.h>
+
+void AlarmEngine::compile(const AlarmRuleParams *rules, uint8_t count)
+{
+    _ruleCount = 0;
+    _active = 0;
+    _changed = 0;
+
+    for (uint8_t i = 0; i < count && i < ALARM_MAX_RULES; i++)
+    {
+        const AlarmRuleParams &params = rules[i];
+        if (!params.enabled || params.output >= ALARM_MAX_OUTPUTS)
+            continue;
+
+        float hysteresis = params.hysteresis < 0 ? -params.hysteresis : params.hysteresis;
+
+        CompiledRule &rule = _rules[_ruleCount];
+        rule.sign = params.mode == ALARM_BELOW ? -1.0f : 1.0f;
+        rule.set = rule.sign * params.level;
+        rule.clear = rule.set - hysteresis;
+        rule.confirm = params.confirm_samples ? params.confirm_samples : 1;
+        rule.pending = 0;
+        rule.output_bit = 1 << params.output;
+        rule.latch = params.latch;
+
+        _ruleIndex[_ruleCount] = i;
+        _ruleCount++;
+    }
+
+    updateOutputs();
+}
+
+void AlarmEngine::updateOutputs()
+{
+    uint8_t outputs = 0;
+    for (uint8_t i = 0; i < _ruleCount; i++)
+    {
+        if (_active & (1UL << _ruleIndex[i]))
+            outputs |= _rules[i].output_bit;
+    }
+    _outputs = outputs;
+}
+
+uint8_t AlarmEngine::process(float value)
+{
+    if (isnan(value))
+        return _outputs;
+
+    uint32_t before = _active;
+
+    for (uint8_t i = 0; i < _ruleCount; i++)
+    {
+        CompiledRule &rule = _rules[i];
+        uint32_t bit = 1UL << _ruleIndex[i];
+        float v = rule.sign * value;
+
+        if (!(_active & bit))
+        {
+            if (v >= rule.set)
+            {
+                if (++rule.pending >= rule.confirm)
+                {
+                    _active |= bit;
+                    rule.pending = 0;
+                }
+            }
+            else
+            {
+                rule.pending = 0;
+            }
+        }
+        else if (!rule.latch && v < rule.clear)
+        {
+            _active &= ~bit;
+        }
+    }
+
+    if (_active != before)
+    {
+        _changed |= _active ^ before;
+        updateOutputs();
+    }
+    return _outputs;
+}
+
+void AlarmEngine::acknowledge()
+{
+    uint32_t before = _active;
+    for (uint8_t i = 0; i < _ruleCount; i++)
+    {
+        if (_rules[i].latch)
+            _active &= ~(1UL << _ruleIndex[i]);
+    }
+
+    if (_active != before)
+    {
+        _changed |= _active ^ before;
+        updateOutputs();
+    }
+}
+
+uint32_t AlarmEngine::takeChangedRules()
+{
+    uint32_t changed = _changed;
+    _changed = 0;
+    return changed;
+}
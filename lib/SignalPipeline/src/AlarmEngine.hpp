@@ -0,0 +1,69 @@
+#pragma once
+
+// Threshold alarm rules evaluated per sample. Rules are compiled into a flat table once
+// (sign folded in, so above and below use the same comparison), the per sample cost is
+// one compare per rule and does not depend on rule parameters.
+// Must not depend on Arduino or ESP-IDF headers.
+
+#include <stdint.h>
+
+#define ALARM_MAX_RULES 8
+#define ALARM_MAX_OUTPUTS 4
+
+enum AlarmMode : uint8_t
+{
+    ALARM_ABOVE = 0, // active when value >= level, cleared below level - hysteresis
+    ALARM_BELOW = 1, // active when value <= level, cleared above level + hysteresis
+};
+
+struct AlarmRuleParams
+{
+    bool enabled = false;
+    AlarmMode mode = ALARM_ABOVE;
+    float level = 0.0;
+    float hysteresis = 0.0;
+    bool latch = false;          // stays active until acknowledged
+    uint8_t confirm_samples = 1; // consecutive samples beyond level before the rule fires
+    uint8_t output = 0;          // output index driven by the rule
+};
+
+class AlarmEngine
+{
+private:
+    struct CompiledRule
+    {
+        float sign;  // +1 above, -1 below
+        float set;   // sign * level
+        float clear; // sign * (level -+ hysteresis)
+        uint8_t confirm;
+        uint8_t pending; // consecutive samples beyond level so far
+        uint8_t output_bit;
+        uint8_t latch;
+    };
+
+    CompiledRule _rules[ALARM_MAX_RULES];
+    uint8_t _ruleCount = 0;
+    uint8_t _ruleIndex[ALARM_MAX_RULES]; // compiled -> configured rule index
+
+    uint32_t _active = 0; // bit per configured rule
+    uint32_t _changed = 0;
+    uint8_t _outputs = 0;
+
+    void updateOutputs();
+
+public:
+    // disabled rules are dropped from the table. resets all rule states
+    void compile(const AlarmRuleParams *rules, uint8_t count);
+
+    // returns the output mask, bit n set: output n active. NAN (read error) is skipped, rule
+    // states and pending confirmations stay
+    uint8_t process(float value);
+
+    // clear latched rules, they fire again on the next sample if still beyond level
+    void acknowledge();
+
+    uint8_t getOutputs() const { return _outputs; }
+    uint32_t getActiveRules() const { return _active; }
+    // rules that changed state since the last call
+    uint32_t takeChangedRules();
+};
@@ -0,0 +1,81 @@
+#include <CaptureCatalog.hpp>
+
+#include <stdio.h>
+
+void CatalogSummary::add(const CaptureSample *samples, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const CaptureSample &sample = samples[i];
+        if (_count == 0)
+        {
+            _rawMin = sample.raw;
+            _rawMax = sample.raw;
+        }
+        else
+        {
+            if (sample.raw < _rawMin)
+                _rawMin = sample.raw;
+            if (sample.raw > _rawMax)
+                _rawMax = sample.raw;
+            _duration_us += (uint32_t)(sample.timestamp_us - _lastTime_us);
+        }
+        _lastTime_us = sample.timestamp_us;
+        _count++;
+    }
+}
+
+void CatalogSummary::fill(CatalogRecord &record, const CaptureHeader &header, uint32_t file_index, uint32_t file_size) const
+{
+    record = CatalogRecord();
+    record.file_index = file_index;
+    record.start_millis = header.start_millis;
+    record.duration_ms = (uint32_t)(_duration_us / 1000);
+    record.sample_count = _count;
+    record.sample_rate = header.sample_rate;
+    record.data_offset = header.header_size;
+    record.file_size = file_size;
+    record.flags = header.sample_count == _count ? CATALOG_CLOSED : CATALOG_RECOVERED;
+
+    // same conversion as the csv download, a negative scale factor swaps the extremes
+    if (_count > 0 && header.sensor_scale_factor != 0)
+    {
+        float a = (float)(_rawMin - header.sensor_zero_balance_raw) / header.sensor_scale_factor;
+        float b = (float)(_rawMax - header.sensor_zero_balance_raw) / header.sensor_scale_factor;
+        record.min = fminf(a, b);
+        record.max = fmaxf(a, b);
+    }
+
+    memcpy(record.sensor_name, header.sensor_name, sizeof(record.sensor_name));
+    memcpy(record.sensor_serial, header.sensor_serial, sizeof(record.sensor_serial));
+    memcpy(record.displayunit, header.displayunit, sizeof(record.displayunit));
+    record.sensor_name[sizeof(record.sensor_name) - 1] = 0;
+    record.sensor_serial[sizeof(record.sensor_serial) - 1] = 0;
+    record.displayunit[sizeof(record.displayunit) - 1] = 0;
+}
+
+bool CatalogFilter::matches(const CatalogRecord &record) const
+{
+    if (record.file_index < from_index || record.file_index > to_index)
+        return false;
+    if (record.sample_count < min_samples)
+        return false;
+    // captures without samples have no peak and never match a peak condition
+    if (!isnan(min_peak) && !(record.max >= min_peak))
+        return false;
+    if (!isnan(max_peak) && !(record.max <= max_peak))
+        return false;
+    if (sensor && sensor[0] && !strstr(record.sensor_name, sensor) && !strstr(record.sensor_serial, sensor))
+        return false;
+    return true;
+}
+
+bool catalogHeaderValid(const CatalogHeader &header)
+{
+    return header.magic == CATALOG_MAGIC && header.version == CATALOG_VERSION && header.record_size == sizeof(CatalogRecord);
+}
+
+void catalogFilename(char *name, size_t size, uint32_t file_index)
+{
+    snprintf(name, size, "cap_%05u%s", (unsigned int)file_index, CAPTURE_FILE_EXTENSION);
+}
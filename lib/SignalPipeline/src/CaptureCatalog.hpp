@@ -0,0 +1,88 @@
+#pragma once
+
+// Catalogue of the capture files, one fixed size record per capture in an append-only index
+// file next to the captures. Listings and queries read the index only, never the capture
+// files or the directory. CaptureClass appends a record on close and rebuilds the index on
+// demand or if it does not match the capture files.
+// Portable, used by CaptureClass, the web listing and the host tools.
+//
+// file: CatalogHeader | CatalogRecord[n], in the order the captures were closed or found
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <CaptureFormat.hpp>
+
+#define CATALOG_MAGIC 0x49474253 // "SBGI"
+#define CATALOG_VERSION 1
+#define CATALOG_FILE CAPTURE_DIR "index.sgi"
+
+enum CatalogFlags : uint8_t
+{
+    CATALOG_CLOSED = 1,    // sample count from the header, the capture was closed properly
+    CATALOG_RECOVERED = 2, // not closed, sample count from the file size on rebuild
+};
+
+struct __attribute__((packed)) CatalogHeader
+{
+    uint32_t magic = CATALOG_MAGIC;
+    uint16_t version = CATALOG_VERSION;
+    uint16_t record_size = 0; // sizeof(CatalogRecord), set by the writer
+};
+
+struct __attribute__((packed)) CatalogRecord
+{
+    uint32_t file_index = 0; // cap_<file_index>.sgc
+    uint32_t start_millis = 0;
+    uint32_t duration_ms = 0; // first to last sample timestamp
+    uint32_t sample_count = 0;
+    float sample_rate = 0;
+    float min = NAN; // displayunit, conversion of the capture header
+    float max = NAN;
+    uint32_t data_offset = 0; // first sample in the capture file
+    uint32_t file_size = 0;
+    uint8_t flags = 0;
+    char sensor_name[32] = {0};
+    char sensor_serial[16] = {0};
+    char displayunit[8] = {0};
+};
+
+// statistics of one capture, collected while writing or on rebuild
+class CatalogSummary
+{
+private:
+    uint32_t _count = 0;
+    int32_t _rawMin = 0;
+    int32_t _rawMax = 0;
+    uint32_t _lastTime_us = 0;
+    uint64_t _duration_us = 0; // summed intervals, survives the micros() wrap
+
+public:
+    void reset() { *this = CatalogSummary(); }
+    void add(const CaptureSample *samples, uint32_t count);
+
+    uint32_t getCount() const { return _count; }
+
+    // record for capture file_index from its header and this summary
+    void fill(CatalogRecord &record, const CaptureHeader &header, uint32_t file_index, uint32_t file_size) const;
+};
+
+// query of the web listing, all conditions must match
+struct CatalogFilter
+{
+    const char *sensor = nullptr; // substring of name or serial
+    uint32_t min_samples = 0;
+    float min_peak = NAN; // max >= min_peak
+    float max_peak = NAN; // max <= max_peak
+    uint32_t from_index = 0;
+    uint32_t to_index = UINT32_MAX;
+
+    bool matches(const CatalogRecord &record) const;
+};
+
+// false if the header is not a catalogue of this version
+bool catalogHeaderValid(const CatalogHeader &header);
+
+// capture file name of a record, e.g. cap_00012.sgc
+void catalogFilename(char *name, size_t size, uint32_t file_index);
@@ -0,0 +1,55 @@
+#pragma once
+
+// Binary layout of raw capture files written by CaptureClass to FFat
+// and read back by the host tools. Little endian, no padding.
+//
+// file: CaptureHeader | CaptureSample[sample_count]           encoding CAPTURE_ENCODING_RAW
+//       CaptureHeader | SampleCodec blocks                    encoding CAPTURE_ENCODING_DELTA_RICE
+// version 1 headers end before encoding and are always raw, see captureEncoding()
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC 0x43474253 // "SBGC"
+#define CAPTURE_VERSION 2
+#define CAPTURE_DIR "/captures/"
+#define CAPTURE_FILE_EXTENSION ".sgc"
+
+enum CaptureEncoding : uint8_t
+{
+    CAPTURE_ENCODING_RAW = 0,
+    CAPTURE_ENCODING_DELTA_RICE = 1, // lossless, see SampleCodec
+};
+
+struct __attribute__((packed)) CaptureHeader
+{
+    uint32_t magic = CAPTURE_MAGIC;
+    uint16_t version = CAPTURE_VERSION;
+    uint16_t header_size = sizeof(CaptureHeader);
+
+    uint32_t start_millis = 0;
+    float sample_rate = 0;   // nominal rate in SPS as configured on the adc
+    uint32_t sample_count = 0; // updated on close, 0 if the capture was not closed properly
+
+    // conversion parameters in use when the capture was started
+    float sensor_scale_factor = 1.0;
+    int32_t sensor_zero_balance_raw = 0;
+    char sensor_name[32] = {0};
+    char sensor_serial[16] = {0};
+    char displayunit[8] = {0};
+
+    // version 2
+    uint8_t encoding = CAPTURE_ENCODING_RAW;
+    uint8_t reserved[3] = {0};
+};
+
+struct __attribute__((packed)) CaptureSample
+{
+    uint32_t timestamp_us;
+    int32_t raw;
+};
+
+// version 1 files have no encoding field, reading a whole CaptureHeader from them picks up sample data
+inline uint8_t captureEncoding(const CaptureHeader &header)
+{
+    return header.version >= 2 && header.header_size >= sizeof(CaptureHeader) ? header.encoding : (uint8_t)CAPTURE_ENCODING_RAW;
+}
@@ -0,0 +1,98 @@
+#include <DerivedChannels.hpp>
+
+DerivedChannels::DerivedChannels()
+{
+    reset();
+}
+
+void DerivedChannels::configure(const DerivedParams &params)
+{
+    _params = params;
+
+    if (_params.rate_window < DERIVED_RATE_WINDOW_MIN)
+        _params.rate_window = DERIVED_RATE_WINDOW_MIN;
+    if (_params.rate_window > DERIVED_RATE_WINDOW_MAX)
+        _params.rate_window = DERIVED_RATE_WINDOW_MAX;
+
+    reset();
+}
+
+void DerivedChannels::reset()
+{
+    _index = 0;
+    _count = 0;
+    _rate = NAN;
+    _lastValue = NAN;
+    _lastTime_us = 0;
+
+    resetIntegrals();
+}
+
+void DerivedChannels::resetIntegrals()
+{
+    _impulse = 0.0;
+    _work = 0.0;
+    _lastDisplacement = _displacement;
+}
+
+void DerivedChannels::process(float value, uint32_t timestamp_us)
+{
+    // trapezoids between this and the previous sample, unsigned difference survives the micros() wrap
+    if (!isnan(_lastValue))
+    {
+        float mean = 0.5f * (value + _lastValue);
+        _impulse += (double)mean * (uint32_t)(timestamp_us - _lastTime_us) * 1e-6;
+        if (!isnan(_displacement) && !isnan(_lastDisplacement))
+            _work += (double)mean * (_displacement - _lastDisplacement);
+    }
+    _lastValue = value;
+    _lastTime_us = timestamp_us;
+    _lastDisplacement = _displacement;
+
+    _time_us[_index] = timestamp_us;
+    _value[_index] = value;
+    _index = (_index + 1) % _params.rate_window;
+    if (_count < _params.rate_window)
+        _count++;
+
+    if (_count < 2)
+    {
+        _rate = NAN;
+        return;
+    }
+
+    // least squares slope: sum((t-tm)(y-ym)) / sum((t-tm)^2). times relative to the newest
+    // sample keep float exact, the window spans far less than 2^24 us
+    float t_sum = 0, y_sum = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        t_sum += (float)(int32_t)(_time_us[i] - timestamp_us);
+        y_sum += _value[i];
+    }
+    float t_mean = t_sum / _count;
+    float y_mean = y_sum / _count;
+
+    float ty = 0, tt = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        float t = (float)(int32_t)(_time_us[i] - timestamp_us) - t_mean;
+        ty += t * (_value[i] - y_mean);
+        tt += t * t;
+    }
+    _rate = tt > 0 ? ty / tt * 1e6f : NAN;
+}
+
+float DerivedChannels::get(DerivedChannel channel, float value) const
+{
+    switch (channel)
+    {
+    case CHANNEL_RATE:
+        return getRate();
+    case CHANNEL_IMPULSE:
+        return getImpulse();
+    case CHANNEL_WORK:
+        return getWork();
+    default:
+        return value;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// Channels derived from the converted load, per sample with the real sample timestamps:
+//   rate:    dF/dt, least squares slope over a sliding window
+//   impulse: integral F dt, trapezoidal
+//   work:    integral F dx, trapezoidal over an external displacement channel
+// Portable, used by LoadcellPipeline and the host tools.
+
+#include <stdint.h>
+#include <math.h>
+
+#define DERIVED_RATE_WINDOW_MIN 3
+#define DERIVED_RATE_WINDOW_MAX 32 // bounds the cost per sample
+
+enum DerivedChannel : uint8_t
+{
+    CHANNEL_FORCE = 0,   // converted value, displayunit
+    CHANNEL_RATE = 1,    // displayunit per s
+    CHANNEL_IMPULSE = 2, // displayunit * s
+    CHANNEL_WORK = 3,    // displayunit * unit of the displacement
+    CHANNEL_COUNT = 4,
+};
+
+struct DerivedParams
+{
+    // samples in the slope window. With uniform sampling the slope equals the Savitzky-Golay
+    // first derivative (order 1 and 2 are identical at the center) and is delayed by
+    // (rate_window - 1) / 2 samples. Longer windows suppress more noise
+    uint8_t rate_window = 9;
+};
+
+class DerivedChannels
+{
+private:
+    DerivedParams _params;
+
+    // slope window ring buffer, timestamps keep the real spacing including jitter and gaps
+    uint32_t _time_us[DERIVED_RATE_WINDOW_MAX];
+    float _value[DERIVED_RATE_WINDOW_MAX];
+    uint8_t _index = 0;
+    uint8_t _count = 0;
+
+    // trapezoidal integrals, double: long runs add many small increments
+    double _impulse = 0.0;
+    double _work = 0.0;
+    float _displacement = NAN;
+    float _lastDisplacement = NAN;
+    float _lastValue = NAN;
+    uint32_t _lastTime_us = 0;
+
+    float _rate = NAN;
+
+public:
+    DerivedChannels();
+
+    void configure(const DerivedParams &params);
+    const DerivedParams &getParams() const { return _params; }
+
+    // clear window and integrals
+    void reset();
+    // impulse and work start over, e.g. on tare
+    void resetIntegrals();
+
+    // latest displacement, held until the next update. NAN: no displacement channel, no work
+    void setDisplacement(float displacement) { _displacement = displacement; }
+
+    // one converted sample. cost grows linearly with rate_window only
+    void process(float value, uint32_t timestamp_us);
+
+    // NAN until two samples are in the window
+    float getRate() const { return _rate; }
+    float getImpulse() const { return (float)_impulse; }
+    // NAN without a displacement channel
+    float getWork() const { return isnan(_displacement) ? NAN : (float)_work; }
+    // value of channel, value is the converted sample for CHANNEL_FORCE
+    float get(DerivedChannel channel, float value) const;
+};
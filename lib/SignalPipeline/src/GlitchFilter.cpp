@@ -0,0 +1,132 @@
+#include <GlitchFilter.hpp>
+
+#include <stdlib.h>
+
+static bool isRail(int32_t raw)
+{
+    return raw >= GLITCH_RAIL_HIGH - GLITCH_RAIL_MARGIN || raw <= GLITCH_RAIL_LOW + GLITCH_RAIL_MARGIN;
+}
+
+// insertion sort, at most GLITCH_WINDOW_MAX values
+static void sortSmall(int32_t *values, uint8_t count)
+{
+    for (uint8_t i = 1; i < count; i++)
+    {
+        int32_t v = values[i];
+        int8_t j = i - 1;
+        for (; j >= 0 && values[j] > v; j--)
+            values[j + 1] = values[j];
+        values[j + 1] = v;
+    }
+}
+
+GlitchFilter::GlitchFilter()
+{
+    reset();
+}
+
+void GlitchFilter::configure(const GlitchParams &params)
+{
+    _params = params;
+
+    if (_params.window < GLITCH_WINDOW_MIN)
+        _params.window = GLITCH_WINDOW_MIN;
+    if (_params.window > GLITCH_WINDOW_MAX)
+        _params.window = GLITCH_WINDOW_MAX;
+    if (_params.max_consecutive < 1)
+        _params.max_consecutive = 1;
+
+    reset();
+}
+
+void GlitchFilter::reset()
+{
+    _index = 0;
+    _count = 0;
+    _hasGood = false;
+    _run = 0;
+    _saturated = false;
+    _reason = GLITCH_NONE;
+    _substituted = false;
+}
+
+void GlitchFilter::median(int32_t &median, int32_t &mad) const
+{
+    int32_t sorted[GLITCH_WINDOW_MAX];
+    for (uint8_t i = 0; i < _count; i++)
+        sorted[i] = _window[i];
+    sortSmall(sorted, _count);
+    median = sorted[_count / 2];
+
+    for (uint8_t i = 0; i < _count; i++)
+        sorted[i] = abs(_window[i] - median);
+    sortSmall(sorted, _count);
+    mad = sorted[_count / 2];
+}
+
+int32_t GlitchFilter::process(int32_t raw, bool read_error)
+{
+    _reason = GLITCH_NONE;
+    _substituted = false;
+
+    if (!_params.enabled)
+        return raw;
+
+    int32_t change = raw - _lastGood;
+    if (read_error)
+    {
+        _reason = GLITCH_READ_ERROR;
+    }
+    else
+    {
+        // sustained overload and the sample leaving it pass as they are, no change for the window
+        bool saturated = isRail(raw);
+        bool overload = saturated ? _saturated : _hasGood && isRail(_lastGood);
+        _saturated = saturated;
+        if (overload)
+        {
+            _run = 0;
+            _lastGood = raw;
+            _hasGood = true;
+            return raw;
+        }
+
+        if (saturated)
+            _reason |= GLITCH_SATURATION;
+
+        if (_hasGood && _params.max_step > 0 && abs(change) > _params.max_step)
+            _reason |= GLITCH_STEP;
+
+        if (_hasGood && _count == _params.window)
+        {
+            int32_t med, mad;
+            median(med, mad);
+            // after substitutions the change spans _run + 1 sample periods, so does its spread
+            int32_t periods = _run + 1;
+            if ((float)abs(change - med * periods) > _params.k * 1.4826f * mad * periods + _params.min_deviation)
+                _reason |= GLITCH_OUTLIER;
+        }
+    }
+
+    // nothing to substitute before the first good sample, a read error never has a value
+    bool accept = _reason == GLITCH_NONE || (_reason != GLITCH_READ_ERROR && (_run >= _params.max_consecutive || !_hasGood));
+    if (!accept)
+    {
+        if (_run < UINT8_MAX)
+            _run++;
+        _substituted = true;
+        return _hasGood ? _lastGood : 0;
+    }
+
+    if (_hasGood)
+    {
+        _window[_index] = change;
+        _index = (_index + 1) % _params.window;
+        if (_count < _params.window)
+            _count++;
+    }
+    _run = 0;
+    _lastGood = raw;
+    _hasGood = true;
+    return raw;
+}
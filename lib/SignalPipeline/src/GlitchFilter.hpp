@@ -0,0 +1,83 @@
+#pragma once
+
+// Rejection of single sample glitches in the raw adc counts: corrupted bus transfers,
+// ESD spikes and codes at the rails. Runs first in LoadcellPipeline, so averaging, peak
+// hold, derived channels and captures only see the substituted value. Alarms are evaluated
+// ahead of it (LoadcellPipeline::getAlarmInput), a substitution must not delay an overload.
+// Portable, used by LoadcellPipeline and the host tools.
+//
+// A sample is rejected if
+//   - the backend reported a bus error for the read
+//   - it is within GLITCH_RAIL_MARGIN of the 24 bit rails
+//   - it differs from the last accepted sample by more than max_step counts
+//   - Hampel test on the change d = x - last accepted sample against the previous changes:
+//     |d - n * median| > n * k * 1.4826 * MAD + min_deviation, n periods since the last
+//     accepted sample. On the change and not on the level, a median of levels lags every
+//     ramp of a dynamic load and would reject it
+// and replaced by the last accepted sample. A run of more than max_consecutive rejections is
+// a real change of the level (step) and is accepted, read errors never are.
+// Only a single rail code is a glitch: a rail code following one is an overload and passes
+// without tests and without being counted, as does the first sample after the overload (its
+// change from a rail code says nothing).
+
+#include <stdint.h>
+
+#define GLITCH_WINDOW_MIN 3
+#define GLITCH_WINDOW_MAX 9 // median and MAD sort twice per sample, bounds the cost
+#define GLITCH_RAIL_HIGH 0x7FFFFF
+#define GLITCH_RAIL_LOW (-0x800000)
+#define GLITCH_RAIL_MARGIN 256 // backends subtracting an offset do not hit the rails exactly
+
+enum GlitchReason : uint8_t
+{
+    GLITCH_NONE = 0,
+    GLITCH_READ_ERROR = 1,
+    GLITCH_SATURATION = 2,
+    GLITCH_STEP = 4,
+    GLITCH_OUTLIER = 8,
+};
+
+struct GlitchParams
+{
+    bool enabled = false;
+    uint8_t window = 7;          // previous samples for the Hampel test
+    float k = 5.0;               // Hampel threshold in robust standard deviations
+    int32_t min_deviation = 0;   // counts, floor of the Hampel threshold for quiet signals
+    int32_t max_step = 0;        // counts between two samples, 0: no limit
+    uint8_t max_consecutive = 2; // longer runs are accepted as a change of the level, delays real steps
+};
+
+class GlitchFilter
+{
+private:
+    GlitchParams _params;
+
+    int32_t _window[GLITCH_WINDOW_MAX]; // changes of the accepted samples
+    uint8_t _index = 0;
+    uint8_t _count = 0;
+
+    int32_t _lastGood = 0;
+    bool _hasGood = false;
+    uint8_t _run = 0; // consecutive rejections
+    bool _saturated = false; // previous input was a rail code
+
+    uint8_t _reason = GLITCH_NONE;
+    bool _substituted = false;
+
+    void median(int32_t &median, int32_t &mad) const;
+
+public:
+    GlitchFilter();
+
+    void configure(const GlitchParams &params);
+    const GlitchParams &getParams() const { return _params; }
+    void reset();
+
+    // returns the sample to use: raw or the substitute. read_error: the backend could not
+    // read the conversion, raw is invalid
+    int32_t process(int32_t raw, bool read_error);
+
+    // GlitchReason mask of the last sample, also set if the run limit accepted it
+    uint8_t getReason() const { return _reason; }
+    bool getSubstituted() const { return _substituted; }
+};
@@ -0,0 +1,199 @@
+#include <HistoryStore.hpp>
+
+size_t HistoryStore::requiredMemory(size_t capacity, uint8_t levels)
+{
+    return capacity * levels * sizeof(HistoryEntry);
+}
+
+bool HistoryStore::begin(void *memory, size_t capacity, uint8_t levels, uint16_t base_samples)
+{
+    if (memory == nullptr || capacity == 0 || levels == 0 || levels > HISTORY_MAX_LEVELS)
+        return false;
+
+    _capacity = capacity;
+    _levelCount = levels;
+    _baseSamples = base_samples ? base_samples : 1;
+
+    HistoryEntry *entries = (HistoryEntry *)memory;
+    for (uint8_t i = 0; i < levels; i++)
+        _levels[i].entries = entries + i * capacity;
+
+    clear();
+    return true;
+}
+
+void HistoryStore::clear()
+{
+    for (uint8_t i = 0; i < _levelCount; i++)
+    {
+        _levels[i].head = 0;
+        _levels[i].size = 0;
+        _levels[i].pending_children = 0;
+    }
+    _pending.count = 0;
+}
+
+void HistoryStore::merge(HistoryEntry &into, const HistoryEntry &from)
+{
+    if (into.count == 0)
+    {
+        into = from;
+        return;
+    }
+
+    if (from.min < into.min)
+        into.min = from.min;
+    if (from.max > into.max)
+        into.max = from.max;
+    into.mean = (into.mean * into.count + from.mean * from.count) / (into.count + from.count);
+    into.count += from.count;
+}
+
+void HistoryStore::push(uint8_t level, const HistoryEntry &entry)
+{
+    // iterative instead of recursive: carry completed pairs to the next level
+    HistoryEntry carry = entry;
+
+    for (; level < _levelCount; level++)
+    {
+        Level &l = _levels[level];
+        l.entries[l.head] = carry;
+        l.head = (l.head + 1) % _capacity;
+        if (l.size < _capacity)
+            l.size++;
+
+        if (level + 1 >= _levelCount)
+            break;
+
+        Level &parent = _levels[level + 1];
+        if (parent.pending_children == 0)
+            parent.pending.count = 0;
+        merge(parent.pending, carry);
+        if (++parent.pending_children < 2)
+            break;
+
+        parent.pending_children = 0;
+        carry = parent.pending;
+    }
+}
+
+void HistoryStore::add(uint32_t t_ms, float value)
+{
+    if (_levelCount == 0)
+        return;
+
+    if (_pending.count == 0)
+    {
+        _pending.t_ms = t_ms;
+        _pending.min = value;
+        _pending.max = value;
+        _pending.mean = value;
+        _pending.count = 1;
+    }
+    else
+    {
+        if (value < _pending.min)
+            _pending.min = value;
+        if (value > _pending.max)
+            _pending.max = value;
+        _pending.count++;
+        _pending.mean += (value - _pending.mean) / _pending.count;
+    }
+
+    if (_pending.count >= _baseSamples)
+    {
+        push(0, _pending);
+        _pending.count = 0;
+    }
+}
+
+const HistoryEntry &HistoryStore::at(const Level &level, size_t index) const
+{
+    size_t oldest = (level.head + _capacity - level.size) % _capacity;
+    return level.entries[(oldest + index) % _capacity];
+}
+
+int64_t HistoryStore::position(uint32_t t_ms, uint32_t oldest_ms, uint32_t newest_ms)
+{
+    int64_t t = offset(t_ms, oldest_ms);
+    int64_t span = offset(newest_ms, oldest_ms);
+    if (t <= span)
+        return t;
+    // outside: after the newest entry or before the oldest, the shorter way round the wrap
+    return t - span <= ((int64_t)1 << 32) - t ? span + 1 : -1;
+}
+
+size_t HistoryStore::lowerBound(const Level &level, int64_t position, uint32_t oldest_ms) const
+{
+    // offsets are monotonic within a level
+    size_t low = 0;
+    size_t high = level.size;
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (offset(at(level, mid).t_ms, oldest_ms) < position)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+size_t HistoryStore::upperBound(const Level &level, int64_t position, uint32_t oldest_ms) const
+{
+    return lowerBound(level, position + 1, oldest_ms);
+}
+
+size_t HistoryStore::firstIndex(const Level &level, int64_t position, uint32_t oldest_ms, bool include_containing) const
+{
+    size_t first = lowerBound(level, position, oldest_ms);
+    if (include_containing && first > 0 && (first == level.size || offset(at(level, first).t_ms, oldest_ms) > position))
+        first--;
+    return first;
+}
+
+int8_t HistoryStore::selectLevel(uint32_t from_ms, uint32_t to_ms, size_t points) const
+{
+    uint32_t oldest_ms, newest_ms;
+    if (!getRange(oldest_ms, newest_ms))
+        return -1;
+
+    int64_t from = position(from_ms, oldest_ms, newest_ms);
+    int64_t to = position(to_ms, oldest_ms, newest_ms);
+    if (from > to)
+        return -1;
+
+    int8_t coarsest = -1;
+    for (uint8_t i = 0; i < _levelCount; i++)
+    {
+        const Level &l = _levels[i];
+        if (l.size == 0)
+            break;
+        coarsest = i;
+
+        // level must reach back to from_ms, unless it is not full yet (nothing older exists)
+        if (l.size == _capacity && offset(at(l, 0).t_ms, oldest_ms) > from)
+            continue;
+
+        size_t first = firstIndex(l, from, oldest_ms, true);
+        size_t last = upperBound(l, to, oldest_ms);
+        if (last - first <= points)
+            return i;
+    }
+    return coarsest;
+}
+
+bool HistoryStore::getRange(uint32_t &oldest_ms, uint32_t &newest_ms) const
+{
+    if (_levelCount == 0 || _levels[0].size == 0)
+        return false;
+
+    // coarsest filled level reaches back the furthest
+    uint8_t coarsest = 0;
+    while (coarsest + 1 < _levelCount && _levels[coarsest + 1].size > 0)
+        coarsest++;
+
+    oldest_ms = at(_levels[coarsest], 0).t_ms;
+    newest_ms = at(_levels[0], _levels[0].size - 1).t_ms;
+    return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+// Multi-resolution time series store (min/max/mean pyramid). Level 0 aggregates
+// base_samples input samples per entry, every further level aggregates two entries of
+// the level below. Each level is a ring of the same capacity, so level k spans 2^k times
+// the duration of level 0. Inserting is amortized O(1) per sample, a query picks the
+// finest level that covers the requested range with at most the requested number of
+// points and is O(points).
+//
+// Timestamps are millis() and wrap every 49.7 days. They are compared as offsets from the
+// oldest stored entry, which is correct across the wrap while the store spans less than
+// 2^32 ms. A query bound outside the stored range is taken as before or after it, whichever
+// is closer, so to_ms beyond the newest entry is clamped to it.
+//
+// Memory is provided by the caller (PSRAM on target). Not thread safe.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HISTORY_MAX_LEVELS 16
+
+struct HistoryEntry
+{
+    uint32_t t_ms; // timestamp of the first sample in the entry
+    float min;
+    float max;
+    float mean;
+    uint32_t count; // number of input samples
+};
+
+class HistoryStore
+{
+private:
+    struct Level
+    {
+        HistoryEntry *entries = nullptr;
+        size_t head = 0; // next write position
+        size_t size = 0;
+
+        // partial aggregate of entries from the level below, complete after two
+        HistoryEntry pending;
+        uint8_t pending_children = 0;
+    };
+
+    Level _levels[HISTORY_MAX_LEVELS];
+    uint8_t _levelCount = 0;
+    size_t _capacity = 0;
+    uint16_t _baseSamples = 1;
+
+    // partial level 0 entry
+    HistoryEntry _pending;
+
+    static void merge(HistoryEntry &into, const HistoryEntry &from);
+    void push(uint8_t level, const HistoryEntry &entry);
+    const HistoryEntry &at(const Level &level, size_t index) const; // 0 = oldest
+
+    // offsets from the oldest stored entry, wrap safe. position() of a query bound is -1
+    // before and span + 1 after the stored range
+    static int64_t offset(uint32_t t_ms, uint32_t oldest_ms) { return (uint32_t)(t_ms - oldest_ms); }
+    static int64_t position(uint32_t t_ms, uint32_t oldest_ms, uint32_t newest_ms);
+    // first entry at or after position, first entry after position
+    size_t lowerBound(const Level &level, int64_t position, uint32_t oldest_ms) const;
+    size_t upperBound(const Level &level, int64_t position, uint32_t oldest_ms) const;
+    // first entry of a query, the one containing position if include_containing
+    size_t firstIndex(const Level &level, int64_t position, uint32_t oldest_ms, bool include_containing) const;
+
+public:
+    static size_t requiredMemory(size_t capacity, uint8_t levels);
+
+    // memory must hold requiredMemory(capacity, levels) bytes, aligned for HistoryEntry
+    bool begin(void *memory, size_t capacity, uint8_t levels, uint16_t base_samples);
+    void clear();
+
+    void add(uint32_t t_ms, float value);
+
+    // visit entries of the chosen level between from_ms and to_ms, at most points.
+    // returns the level used, -1 if the store is empty
+    template <typename Visitor>
+    int8_t query(uint32_t from_ms, uint32_t to_ms, size_t points, Visitor visit) const
+    {
+        int8_t level = selectLevel(from_ms, to_ms, points);
+        if (level >= 0)
+            visitLevel(level, from_ms, to_ms, points, true, visit);
+        return level;
+    }
+
+    // visit entries of a level, the first one may start before from_ms if include_containing.
+    // returns number of entries visited
+    template <typename Visitor>
+    size_t visitLevel(uint8_t level, uint32_t from_ms, uint32_t to_ms, size_t max_entries, bool include_containing, Visitor visit) const
+    {
+        uint32_t oldest_ms, newest_ms;
+        if (level >= _levelCount || !getRange(oldest_ms, newest_ms))
+            return 0;
+
+        const Level &l = _levels[level];
+        size_t first = firstIndex(l, position(from_ms, oldest_ms, newest_ms), oldest_ms, include_containing);
+        size_t last = upperBound(l, position(to_ms, oldest_ms, newest_ms), oldest_ms);
+
+        size_t n = 0;
+        for (size_t i = first; i < last && n < max_entries; i++, n++)
+            visit(at(l, i));
+        return n;
+    }
+
+    // finest level that covers the range with at most points entries (as query visits them,
+    // with the containing one), -1 if empty or from_ms is after to_ms
+    int8_t selectLevel(uint32_t from_ms, uint32_t to_ms, size_t points) const;
+
+    uint8_t getLevelCount() const { return _levelCount; }
+    size_t getLevelSize(uint8_t level) const { return level < _levelCount ? _levels[level].size : 0; }
+    // newest_ms is below oldest_ms after the millis() wrap
+    bool getRange(uint32_t &oldest_ms, uint32_t &newest_ms) const;
+};
@@ -0,0 +1,93 @@
+#include <HumFilter.hpp>
+
+#include <math.h>
+
+void HumFilter::designNotch(HumFilterStage &stage, float frequency, float sample_rate, float q)
+{
+    // notch from the audio EQ cookbook: b = (1, -2cos w0, 1), a = (1 + alpha, -2cos w0, 1 - alpha)
+    double w0 = 2.0 * M_PI * frequency / sample_rate;
+    double alpha = sin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+    double one = (double)(1 << HUM_FILTER_COEFF_BITS);
+
+    stage.frequency = frequency;
+    stage.b0 = (int32_t)lround(one / a0);
+    stage.b2 = stage.b0;
+    stage.a1 = (int32_t)lround(one * -2.0 * cos(w0) / a0);
+    stage.a2 = (int32_t)lround(one * (1.0 - alpha) / a0);
+
+    // unity DC gain after rounding: b0 + b1 + b2 = 1 + a1 + a2
+    stage.b1 = (int32_t)(((int64_t)1 << HUM_FILTER_COEFF_BITS) + stage.a1 + stage.a2 - stage.b0 - stage.b2);
+}
+
+void HumFilter::design(const HumFilterParams &params, float sample_rate)
+{
+    _params = params;
+    _sampleRate = sample_rate;
+
+    uint8_t count = 0;
+    if (params.mode != HUM_FILTER_OFF && sample_rate > 0 && params.mains_hz > 0)
+    {
+        uint8_t harmonics = params.mode == HUM_FILTER_COMB ? params.harmonics : 1;
+        for (uint8_t k = 1; k <= harmonics && count < HUM_FILTER_MAX_STAGES; k++)
+        {
+            // fold the harmonic into 0..fs/2
+            float frequency = fmodf(k * params.mains_hz, sample_rate);
+            if (frequency > sample_rate / 2)
+                frequency = sample_rate - frequency;
+
+            // a notch at DC or at Nyquist degenerates, and close to DC it would remove the load signal
+            if (frequency < HUM_FILTER_MIN_HZ || frequency > 0.49f * sample_rate)
+                continue;
+
+            bool duplicate = false;
+            for (uint8_t i = 0; i < count; i++)
+                duplicate |= fabsf(_stages[i].frequency - frequency) < 0.5f;
+            if (duplicate)
+                continue;
+
+            // keep the state of an existing stage, only the coefficients move
+            designNotch(_stages[count], frequency, sample_rate, params.q > 0 ? params.q : 1.0f);
+            count++;
+        }
+    }
+
+    if (count != _stageCount)
+        _primed = false;
+    _stageCount = count;
+}
+
+void HumFilter::reset()
+{
+    _primed = false;
+}
+
+void HumFilter::prime(int32_t x)
+{
+    for (uint8_t i = 0; i < HUM_FILTER_MAX_STAGES; i++)
+    {
+        HumFilterStage &s = _stages[i];
+        s.x1 = s.x2 = s.y1 = s.y2 = x * (1 << HUM_FILTER_STATE_BITS);
+        s.error = 0;
+    }
+    _primed = true;
+}
+
+double HumFilter::response(float frequency) const
+{
+    double w = 2.0 * M_PI * frequency / _sampleRate;
+    double one = (double)(1 << HUM_FILTER_COEFF_BITS);
+    double magnitude = 1.0;
+
+    for (uint8_t i = 0; i < _stageCount; i++)
+    {
+        const HumFilterStage &s = _stages[i];
+        // H(e^jw) = (b0 + b1 e^-jw + b2 e^-2jw) / (1 + a1 e^-jw + a2 e^-2jw)
+        double br = s.b0 + s.b1 * cos(w) + s.b2 * cos(2 * w);
+        double bi = -s.b1 * sin(w) - s.b2 * sin(2 * w);
+        double ar = one + s.a1 * cos(w) + s.a2 * cos(2 * w);
+        double ai = -s.a1 * sin(w) - s.a2 * sin(2 * w);
+        magnitude *= sqrt((br * br + bi * bi) / (ar * ar + ai * ai));
+    }
+    return magnitude;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+// Mains hum rejection on raw adc counts: cascade of biquad notch filters in fixed point.
+// NOTCH removes the mains frequency, COMB additionally its harmonics. Harmonics above
+// Nyquist are notched where they alias to, at 320 SPS the 250 Hz harmonic of 50 Hz shows
+// up at 70 Hz. Coefficients are Q29 (|a1| approaches 2 for notches close to Nyquist) with
+// the numerator adjusted after rounding so the DC gain is exactly 1. The state carries 6
+// fractional bits below the 24 bit adc counts, a limit cycle of one state LSB then rounds
+// away and a static load passes bit exact. Per sample cost is constant: 5 multiply-
+// accumulates per stage.
+//
+// Must not depend on Arduino or ESP-IDF headers.
+
+#include <stdint.h>
+
+#define HUM_FILTER_MAX_STAGES 8
+#define HUM_FILTER_COEFF_BITS 29
+#define HUM_FILTER_STATE_BITS 6 // fractional bits of the state, input range +-2^24 counts
+#define HUM_FILTER_MIN_HZ 2.0f // aliases closer to DC are not notched, they would remove the load signal
+
+enum HumFilterMode : uint8_t
+{
+    HUM_FILTER_OFF = 0,
+    HUM_FILTER_NOTCH = 1, // mains frequency only
+    HUM_FILTER_COMB = 2,  // mains frequency and harmonics
+};
+
+struct HumFilterParams
+{
+    HumFilterMode mode = HUM_FILTER_OFF;
+    float mains_hz = 50.0;
+    float q = 2.0;         // notch quality f0/bandwidth, low values tolerate mains frequency drift
+    uint8_t harmonics = 5; // comb: harmonics 1..n
+};
+
+struct HumFilterStage
+{
+    float frequency = 0; // Hz, after aliasing
+
+    // Q29 coefficients, a0 = 1
+    int32_t b0 = 0;
+    int32_t b1 = 0;
+    int32_t b2 = 0;
+    int32_t a1 = 0;
+    int32_t a2 = 0;
+
+    // direct form I state and error feedback of the truncated fraction
+    int32_t x1 = 0;
+    int32_t x2 = 0;
+    int32_t y1 = 0;
+    int32_t y2 = 0;
+    int64_t error = 0;
+};
+
+class HumFilter
+{
+private:
+    HumFilterParams _params;
+    float _sampleRate = 0;
+    HumFilterStage _stages[HUM_FILTER_MAX_STAGES];
+    uint8_t _stageCount = 0;
+    bool _primed = false;
+
+    static void designNotch(HumFilterStage &stage, float frequency, float sample_rate, float q);
+
+public:
+    // computes coefficients for the sample rate, the filter state is kept so a redesign for
+    // a slightly different measured rate does not disturb the output
+    void design(const HumFilterParams &params, float sample_rate);
+    // clear the state, the next sample is taken as settled input
+    void reset();
+    // set the state to a settled input x, avoids the step response from zero
+    void prime(int32_t x);
+
+    int32_t process(int32_t input)
+    {
+        if (!_primed)
+            prime(input);
+
+        int32_t x = input * (1 << HUM_FILTER_STATE_BITS);
+
+        for (uint8_t i = 0; i < _stageCount; i++)
+        {
+            HumFilterStage &s = _stages[i];
+            int64_t acc = (int64_t)s.b0 * x + (int64_t)s.b1 * s.x1 + (int64_t)s.b2 * s.x2 -
+                          (int64_t)s.a1 * s.y1 - (int64_t)s.a2 * s.y2 + s.error;
+            int32_t y = (int32_t)(acc >> HUM_FILTER_COEFF_BITS);
+            s.error = acc - ((int64_t)y << HUM_FILTER_COEFF_BITS);
+
+            s.x2 = s.x1;
+            s.x1 = x;
+            s.y2 = s.y1;
+            s.y1 = y;
+            x = y;
+        }
+        return (x + (1 << (HUM_FILTER_STATE_BITS - 1))) >> HUM_FILTER_STATE_BITS;
+    }
+
+    bool isActive() const { return _stageCount > 0; }
+    float getSampleRate() const { return _sampleRate; }
+    uint8_t getStageCount() const { return _stageCount; }
+    const HumFilterStage &getStage(uint8_t index) const { return _stages[index]; }
+
+    // magnitude response of the quantized coefficients at frequency, for verification
+    double response(float frequency) const;
+};
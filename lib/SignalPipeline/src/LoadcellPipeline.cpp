@@ -0,0 +1,166 @@
+#include <LoadcellPipeline.hpp>
+
+LoadcellPipeline::LoadcellPipeline()
+{
+    reset();
+}
+
+void LoadcellPipeline::configure(const PipelineParams &params)
+{
+    _params = params;
+
+    if (_params.filter_size < 1)
+        _params.filter_size = 1;
+    if (_params.filter_size > PIPELINE_FILTER_SIZE_MAX)
+        _params.filter_size = PIPELINE_FILTER_SIZE_MAX;
+
+    setTemperature(_temperature);
+    _glitch.configure(_params.glitch);
+    _params.glitch = _glitch.getParams();
+    _hum.design(_params.hum, _params.sample_rate);
+    _derived.configure(_params.derived);
+    _params.derived = _derived.getParams();
+    reset();
+}
+
+void LoadcellPipeline::setTemperature(float temp_c)
+{
+    _temperature = temp_c;
+
+    if (isnan(temp_c))
+    {
+        _tcOffset = 0.0;
+        _tcGain = 1.0;
+        return;
+    }
+
+    float dt = temp_c - _params.temp_reference;
+    float span = 1.0f + _params.temp_span_coeff * dt;
+    _tcOffset = _params.temp_zero_coeff * dt;
+    _tcGain = span > 0.0f ? 1.0f / span : 1.0f;
+}
+
+void LoadcellPipeline::setTemperatureReference(float temp_c)
+{
+    _params.temp_reference = temp_c;
+    setTemperature(_temperature);
+}
+
+void LoadcellPipeline::reset()
+{
+    _filterSum = 0;
+    _filterIndex = 0;
+    _filterCount = 0;
+
+    _alarmInput = NAN;
+    _uncompensated = NAN;
+    _converted = NAN;
+    _filtered = NAN;
+
+    _triggerSide = 0;
+    _triggered = false;
+
+    _glitch.reset();
+    _hum.reset();
+    _derived.reset();
+
+    resetStats();
+}
+
+void LoadcellPipeline::resetStats()
+{
+    _stats = PipelineStats();
+}
+
+bool LoadcellPipeline::process(int32_t raw, uint32_t timestamp_us, bool read_error)
+{
+    _alarmInput = read_error ? NAN : convert(raw);
+    raw = _glitch.process(raw, read_error);
+    _raw = raw;
+    uint8_t glitch = _glitch.getReason();
+    if (glitch != GLITCH_NONE)
+    {
+        _stats.glitch_read_errors += (glitch & GLITCH_READ_ERROR) != 0;
+        _stats.glitch_saturations += (glitch & GLITCH_SATURATION) != 0;
+        _stats.glitch_steps += (glitch & GLITCH_STEP) != 0;
+        _stats.glitch_outliers += (glitch & GLITCH_OUTLIER) != 0;
+        _stats.glitch_substituted += _glitch.getSubstituted();
+        _stats.last_glitch_timestamp_us = timestamp_us;
+        _stats.last_glitch_reason = glitch;
+    }
+
+    if (_hum.isActive())
+        raw = _hum.process(raw);
+
+    _uncompensated = convertUncompensated(raw);
+    _converted = (_uncompensated - _tcOffset) * _tcGain;
+
+    // moving average, sum is updated incrementally so cost does not depend on filter size
+    if (_filterCount == _params.filter_size)
+        _filterSum -= _filterBuffer[_filterIndex];
+    else
+        _filterCount++;
+
+    _filterBuffer[_filterIndex] = _converted;
+    _filterSum += _converted;
+    _filterIndex = (_filterIndex + 1) % _params.filter_size;
+
+    _filtered = _filterSum / _filterCount;
+
+    // derived channels on the unfiltered value, the moving average would smear the rate
+    _derived.process(_converted, timestamp_us);
+
+    // statistics on filtered value
+    _stats.count++;
+    if (_filtered < _stats.min)
+        _stats.min = _filtered;
+    if (_filtered > _stats.max)
+        _stats.max = _filtered;
+    _stats.mean += (_filtered - _stats.mean) / _stats.count;
+    float rate = _derived.getRate();
+    if (rate < _stats.rate_min)
+        _stats.rate_min = rate;
+    if (rate > _stats.rate_max)
+        _stats.rate_max = rate;
+
+    if (_stats.count > 1)
+    {
+        uint32_t interval_us = timestamp_us - _lastTimestamp_us;
+        if (interval_us < _stats.interval_us_min)
+            _stats.interval_us_min = interval_us;
+        if (interval_us > _stats.interval_us_max)
+            _stats.interval_us_max = interval_us;
+        _stats.interval_us_mean += ((float)interval_us - _stats.interval_us_mean) / (_stats.count - 1);
+    }
+    _lastTimestamp_us = timestamp_us;
+
+    // notch frequencies depend on the real sample rate, the adc clock may be off by a few percent
+    if (_hum.isActive() && _stats.count % PIPELINE_HUM_REDESIGN_SAMPLES == 0 && _stats.interval_us_mean > 0)
+    {
+        float measured = 1e6f / _stats.interval_us_mean;
+        if (fabsf(measured - _hum.getSampleRate()) > PIPELINE_HUM_REDESIGN_TOLERANCE * _hum.getSampleRate())
+            _hum.design(_params.hum, measured);
+    }
+
+    // level trigger with hysteresis: fires when the filtered value crosses from one side of the band to the other
+    _triggered = false;
+    if (_params.trigger_mode != TRIGGER_OFF)
+    {
+        int8_t side = _triggerSide;
+        if (_filtered >= _params.trigger_level + _params.trigger_hysteresis)
+            side = 1;
+        else if (_filtered <= _params.trigger_level - _params.trigger_hysteresis)
+            side = -1;
+
+        if (((_params.trigger_mode & TRIGGER_RISING) && _triggerSide < 0 && side > 0) ||
+            ((_params.trigger_mode & TRIGGER_FALLING) && _triggerSide > 0 && side < 0))
+        {
+            _triggered = true;
+            _stats.triggers++;
+            _stats.last_trigger_timestamp_us = timestamp_us;
+        }
+        _triggerSide = side;
+    }
+
+    return _triggered;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+// Portable sample processing shared by the firmware (LoadcellClass) and the
+// host tools (tools/host). Must not depend on Arduino or ESP-IDF headers.
+
+#include <stdint.h>
+#include <math.h>
+
+#include <GlitchFilter.hpp>
+#include <HumFilter.hpp>
+#include <DerivedChannels.hpp>
+
+#define PIPELINE_FILTER_SIZE_MAX 64
+#define PIPELINE_HUM_REDESIGN_SAMPLES 512 // check the measured sample rate every n samples
+#define PIPELINE_HUM_REDESIGN_TOLERANCE 0.002f
+
+enum TriggerMode : uint8_t
+{
+    TRIGGER_OFF = 0,
+    TRIGGER_RISING = 1,
+    TRIGGER_FALLING = 2,
+    TRIGGER_BOTH = 3,
+};
+
+struct PipelineParams
+{
+    // conversion to displayunit: y=(x-b)/m
+    float sensor_scale_factor = 1.0;
+    int32_t sensor_zero_balance_raw = 0;
+
+    // temperature compensation: y=(y0-zero_coeff*dT)/(1+span_coeff*dT), dT=T-temp_reference
+    float temp_zero_coeff = 0.0; // displayunit per degC
+    float temp_span_coeff = 0.0; // relative per degC
+    float temp_reference = 25.0; // degC
+
+    // glitch rejection on the raw values, first stage
+    GlitchParams glitch;
+
+    // mains hum rejection on the raw values, designed for sample_rate (nominal, SPS) and
+    // redesigned for the measured rate once known
+    HumFilterParams hum;
+    float sample_rate = 0.0;
+
+    // moving average over the converted values
+    uint8_t filter_size = 8;
+
+    // rate, impulse and work of the converted values
+    DerivedParams derived;
+
+    // level trigger on the filtered value
+    TriggerMode trigger_mode = TRIGGER_OFF;
+    float trigger_level = 0.0;
+    float trigger_hysteresis = 0.0;
+
+    // derive scale factor and zero balance from sensor datasheet values and adc calibration
+    static float calcScaleFactor(int32_t adc_resolution, uint8_t gain, float sensitivity, float cali_gain_factor, float fullrange)
+    {
+        return ((float)adc_resolution * (float)(1 << gain) * ((sensitivity * cali_gain_factor))) / (1000.0 * fullrange);
+    }
+    static int32_t calcZeroBalanceRaw(int32_t adc_resolution, uint8_t gain, float zerobalance, float cali_offset)
+    {
+        return (int32_t)((zerobalance - cali_offset) * (float)adc_resolution * (float)(1 << gain) / 1000.0);
+    }
+};
+
+struct PipelineStats
+{
+    uint32_t count = 0;
+    float min = INFINITY;
+    float max = -INFINITY;
+    float mean = 0.0;
+    uint32_t triggers = 0;
+    uint32_t last_trigger_timestamp_us = 0;
+
+    // rejected raw samples per GlitchReason, substituted: replaced by the last good sample
+    uint32_t glitch_read_errors = 0;
+    uint32_t glitch_saturations = 0;
+    uint32_t glitch_steps = 0;
+    uint32_t glitch_outliers = 0;
+    uint32_t glitch_substituted = 0;
+    uint32_t last_glitch_timestamp_us = 0;
+    uint8_t last_glitch_reason = GLITCH_NONE;
+
+    // peak rate of change, displayunit per s
+    float rate_min = INFINITY;
+    float rate_max = -INFINITY;
+
+    // sample timing, to judge jitter of the acquisition
+    uint32_t interval_us_min = UINT32_MAX;
+    uint32_t interval_us_max = 0;
+    float interval_us_mean = 0.0;
+};
+
+class LoadcellPipeline
+{
+private:
+    PipelineParams _params;
+
+    GlitchFilter _glitch;
+    HumFilter _hum;
+    DerivedChannels _derived;
+
+    // moving average ring buffer
+    float _filterBuffer[PIPELINE_FILTER_SIZE_MAX];
+    float _filterSum = 0;
+    uint8_t _filterIndex = 0;
+    uint8_t _filterCount = 0;
+
+    // temperature compensation, precalculated per temperature update
+    float _temperature = NAN;
+    float _tcOffset = 0.0;
+    float _tcGain = 1.0;
+
+    // latest results
+    int32_t _raw = 0; // after glitch rejection
+    float _alarmInput = NAN;
+    float _uncompensated = NAN;
+    float _converted = NAN;
+    float _filtered = NAN;
+
+    PipelineStats _stats;
+    uint32_t _lastTimestamp_us = 0;
+
+    int8_t _triggerSide = 0; // -1 below, +1 above trigger band, 0 unknown
+    bool _triggered = false;
+
+public:
+    LoadcellPipeline();
+
+    void configure(const PipelineParams &params);
+    const PipelineParams &getParams() const { return _params; }
+
+    // clear filter and statistics, keeps the params
+    void reset();
+    void resetStats();
+
+    // tare: use raw value as new zero balance
+    void setZeroBalanceRaw(int32_t zero_balance_raw) { _params.sensor_zero_balance_raw = zero_balance_raw; }
+    // impulse and work start over, with tare
+    void resetIntegrals() { _derived.resetIntegrals(); }
+    // second channel for work, NAN: none
+    void setDisplacement(float displacement) { _derived.setDisplacement(displacement); }
+
+    // sensor temperature for compensation, NAN disables it
+    void setTemperature(float temp_c);
+    void setTemperatureReference(float temp_c);
+    float getTemperature() const { return _temperature; }
+
+    // process one adc sample, read_error: the backend could not read it and raw is invalid.
+    // returns true if the trigger fired on this sample
+    bool process(int32_t raw, uint32_t timestamp_us, bool read_error = false);
+
+    float convertUncompensated(int32_t raw) const
+    {
+        return (float)(raw - _params.sensor_zero_balance_raw) / _params.sensor_scale_factor;
+    }
+    float convert(int32_t raw) const
+    {
+        return (convertUncompensated(raw) - _tcOffset) * _tcGain;
+    }
+
+    // raw value after glitch rejection, what captures and tare should use
+    int32_t getRaw() const { return _raw; }
+    // GlitchReason mask of the latest sample
+    uint8_t getGlitch() const { return _glitch.getReason(); }
+    float getConverted() const { return _converted; }
+    // converted before glitch rejection and hum filter, the input of the alarms: a substitution
+    // holds back a step or an overload, the notch/comb cascade delays it by several samples
+    // (group delay), an alarm must switch within the sample. NAN for a read error
+    float getAlarmInput() const { return _alarmInput; }
+    // converted without temperature compensation, input for learning the coefficients
+    float getUncompensated() const { return _uncompensated; }
+    // average of the filter window, NAN if no sample since reset
+    float getFiltered() const { return _filtered; }
+    const PipelineStats &getStats() const { return _stats; }
+    bool getTriggered() const { return _triggered; }
+    const HumFilter &getHumFilter() const { return _hum; }
+    const DerivedChannels &getDerived() const { return _derived; }
+};
@@ -0,0 +1,372 @@
+#include <SampleCodec.hpp>
+
+#include <string.h>
+
+#define CODEC_RICE_N_INIT 2
+#define CODEC_RICE_RESET 32 // halve the running sums, the parameter follows changes of the noise
+#define CODEC_RICE_CLAMP (1u << 24)
+#define CODEC_MAX_K 24
+
+namespace
+{
+    inline uint32_t zigzag(uint32_t r)
+    {
+        return (r << 1) ^ (uint32_t)((int32_t)r >> 31);
+    }
+
+    inline uint32_t unzigzag(uint32_t u)
+    {
+        return (u >> 1) ^ (0u - (u & 1));
+    }
+
+    // smallest k with n << k >= a, starting from the previous k
+    struct RiceState
+    {
+        uint32_t a = 0;
+        uint32_t n = 0;
+        uint8_t k = 0;
+
+        void begin(uint8_t k_init)
+        {
+            k = k_init;
+            n = CODEC_RICE_N_INIT;
+            a = n << k;
+        }
+
+        void update(uint32_t u)
+        {
+            a += u < CODEC_RICE_CLAMP ? u : CODEC_RICE_CLAMP;
+            if (++n >= CODEC_RICE_RESET)
+            {
+                a >>= 1;
+                n >>= 1;
+            }
+            while ((n << k) < a)
+                k++;
+            while (k > 0 && (n << (k - 1)) >= a)
+                k--;
+        }
+    };
+
+    // delta predictor in modular arithmetic, lossless for any input
+    struct Predictor
+    {
+        uint8_t order = 1;
+        uint32_t prev = 0;
+        uint32_t delta = 0;
+
+        uint32_t residual(uint32_t x)
+        {
+            uint32_t d = x - prev;
+            uint32_t r = order == CODEC_ORDER_2 ? d - delta : d;
+            prev = x;
+            delta = d;
+            return r;
+        }
+
+        uint32_t restore(uint32_t r)
+        {
+            uint32_t d = order == CODEC_ORDER_2 ? r + delta : r;
+            prev += d;
+            delta = d;
+            return prev;
+        }
+    };
+
+    class BitWriter
+    {
+    private:
+        uint8_t *_start;
+        uint8_t *_p;
+        uint64_t _acc = 0;
+        unsigned _bits = 0; // pending, < 8 between calls
+
+    public:
+        uint8_t check = 0;
+
+        BitWriter(uint8_t *out) : _start(out), _p(out) {}
+
+        // n <= 56
+        void put(uint64_t value, unsigned n)
+        {
+            _acc = (_acc << n) | value;
+            _bits += n;
+            while (_bits >= 8)
+            {
+                _bits -= 8;
+                uint8_t byte = (uint8_t)(_acc >> _bits);
+                *_p++ = byte;
+                check ^= byte;
+            }
+        }
+
+        void flush()
+        {
+            if (_bits)
+                put(0, 8 - _bits);
+        }
+
+        size_t size() const { return _p - _start; }
+    };
+
+    class BitReader
+    {
+    private:
+        const uint8_t *_p;
+        const uint8_t *_end;
+        uint64_t _acc = 0;
+        unsigned _bits = 0;  // valid low bits of _acc
+        size_t _padding = 0; // zero bytes read past the end
+
+    public:
+        BitReader(const uint8_t *data, size_t size) : _p(data), _end(data + size) {}
+
+        // at least 57 valid bits afterwards
+        void refill()
+        {
+            while (_bits <= 56)
+            {
+                uint8_t byte = 0;
+                if (_p < _end)
+                    byte = *_p++;
+                else
+                    _padding++;
+                _acc = (_acc << 8) | byte;
+                _bits += 8;
+            }
+        }
+
+        // n <= 32, needs n valid bits
+        uint32_t get(unsigned n)
+        {
+            _bits -= n;
+            return n ? (uint32_t)((_acc >> _bits) & ((1ull << n) - 1)) : 0;
+        }
+
+        bool rice(uint8_t k, uint32_t &u)
+        {
+            refill();
+            uint64_t window = _acc << (64 - _bits);
+            unsigned q = window ? __builtin_clzll(window) : 64;
+            if (q > CODEC_ESCAPE)
+                return false;
+
+            _bits -= q + 1;
+            if (q == CODEC_ESCAPE)
+            {
+                refill();
+                u = get(32);
+            }
+            else
+                u = (q << k) | get(k);
+            return true;
+        }
+
+        // no bit read past the end of the payload
+        bool complete() const { return _padding * 8 <= _bits; }
+    };
+
+    void putRice(BitWriter &w, uint8_t k, uint32_t u)
+    {
+        uint32_t q = u >> k;
+        if (q < CODEC_ESCAPE)
+            w.put((1ull << k) | (u & ((1ull << k) - 1)), q + 1 + k);
+        else
+        {
+            w.put(1, CODEC_ESCAPE + 1);
+            w.put(u, 32);
+        }
+    }
+
+    // the second sample of a block has no running mean yet: bit length in 6 bits, then the bits
+    void putFirst(BitWriter &w, uint32_t u)
+    {
+        unsigned n = u ? 32 - __builtin_clz(u) : 0;
+        w.put(n, 6);
+        if (n)
+            w.put(u, n);
+    }
+
+    bool getFirst(BitReader &r, uint32_t &u)
+    {
+        r.refill();
+        unsigned n = r.get(6);
+        if (n > 32)
+            return false;
+        r.refill();
+        u = r.get(n);
+        return true;
+    }
+
+    // sums of the absolute first and second order residuals of a channel, from the third sample on
+    struct OrderEstimate
+    {
+        uint64_t sum1 = 0;
+        uint64_t sum2 = 0;
+        uint32_t count = 0;
+
+        uint8_t order() const { return sum2 < sum1 ? CODEC_ORDER_2 : CODEC_ORDER_1; }
+
+        // rice parameter for the mean of the zigzag mapped residuals
+        uint8_t k(uint8_t order) const
+        {
+            if (count == 0)
+                return 0;
+            uint64_t mean = 2 * (order == CODEC_ORDER_2 ? sum2 : sum1) / count;
+            uint8_t k = 0;
+            while (k < CODEC_MAX_K && (1ull << k) < mean)
+                k++;
+            return k;
+        }
+    };
+
+    inline uint64_t absolute(uint32_t r)
+    {
+        int64_t s = (int32_t)r;
+        return s < 0 ? -s : s;
+    }
+}
+
+namespace SampleCodec
+{
+    CodecResult encodeBlock(const CaptureSample *samples, size_t count, uint32_t first_index, uint8_t *out, size_t out_size,
+                            CodecOrder order)
+    {
+        CodecResult result;
+        if (count == 0 || out_size < sizeof(CodecBlockHeader))
+            return result;
+        if (count > CODEC_MAX_BLOCK_SAMPLES)
+            count = CODEC_MAX_BLOCK_SAMPLES;
+
+        // bit stream size is limited by payload_size
+        size_t capacity = out_size - sizeof(CodecBlockHeader);
+        if (capacity > UINT16_MAX)
+            capacity = UINT16_MAX;
+
+        // one pass for the order and the initial rice parameters, over the samples that might
+        // fit: at least one bit per channel and sample
+        size_t scan = count < 2 + capacity * 4 ? count : 2 + capacity * 4;
+        OrderEstimate time, raw;
+        for (size_t i = 2; i < scan; i++)
+        {
+            uint32_t t1 = samples[i].timestamp_us - samples[i - 1].timestamp_us;
+            uint32_t t0 = samples[i - 1].timestamp_us - samples[i - 2].timestamp_us;
+            uint32_t r1 = (uint32_t)samples[i].raw - (uint32_t)samples[i - 1].raw;
+            uint32_t r0 = (uint32_t)samples[i - 1].raw - (uint32_t)samples[i - 2].raw;
+            time.sum1 += absolute(t1);
+            time.sum2 += absolute(t1 - t0);
+            raw.sum1 += absolute(r1);
+            raw.sum2 += absolute(r1 - r0);
+        }
+        time.count = raw.count = scan > 2 ? scan - 2 : 0;
+
+        CodecBlockHeader header;
+        uint8_t order_time = order != CODEC_ORDER_AUTO ? (uint8_t)order : time.order();
+        uint8_t order_raw = order != CODEC_ORDER_AUTO ? (uint8_t)order : raw.order();
+        header.order = order_raw | (order_time << 4);
+        header.k_time = time.k(order_time);
+        header.k_raw = raw.k(order_raw);
+        header.first_index = first_index;
+        header.timestamp_us = samples[0].timestamp_us;
+        header.raw = samples[0].raw;
+
+        Predictor predict_time, predict_raw;
+        predict_time.order = order_time;
+        predict_time.prev = samples[0].timestamp_us;
+        predict_raw.order = order_raw;
+        predict_raw.prev = (uint32_t)samples[0].raw;
+        RiceState rice_time, rice_raw;
+        rice_time.begin(header.k_time);
+        rice_raw.begin(header.k_raw);
+
+        BitWriter w(out + sizeof(CodecBlockHeader));
+        size_t n = 1;
+        for (; n < count && w.size() + CODEC_MAX_SAMPLE_BYTES <= capacity; n++)
+        {
+            uint32_t u_time = zigzag(predict_time.residual(samples[n].timestamp_us));
+            uint32_t u_raw = zigzag(predict_raw.residual((uint32_t)samples[n].raw));
+            if (n == 1)
+            {
+                putFirst(w, u_time);
+                putFirst(w, u_raw);
+                continue;
+            }
+            putRice(w, rice_time.k, u_time);
+            rice_time.update(u_time);
+            putRice(w, rice_raw.k, u_raw);
+            rice_raw.update(u_raw);
+        }
+        w.flush();
+
+        header.sample_count = n;
+        header.payload_size = w.size();
+        header.check = w.check;
+        memcpy(out, &header, sizeof(header));
+
+        result.bytes = sizeof(CodecBlockHeader) + w.size();
+        result.samples = n;
+        return result;
+    }
+
+    bool headerValid(const CodecBlockHeader &header)
+    {
+        uint8_t order_raw = header.order & 0x0F;
+        uint8_t order_time = header.order >> 4;
+        return header.magic == CODEC_BLOCK_MAGIC && header.sample_count >= 1 && header.sample_count <= CODEC_MAX_BLOCK_SAMPLES &&
+               (order_raw == CODEC_ORDER_1 || order_raw == CODEC_ORDER_2) && (order_time == CODEC_ORDER_1 || order_time == CODEC_ORDER_2) &&
+               header.k_time <= CODEC_MAX_K && header.k_raw <= CODEC_MAX_K;
+    }
+
+    size_t decodeBlock(const uint8_t *block, size_t size, CaptureSample *samples, size_t max_samples)
+    {
+        CodecBlockHeader header;
+        if (size < sizeof(header))
+            return 0;
+        memcpy(&header, block, sizeof(header));
+        if (!headerValid(header) || size < sizeof(header) + header.payload_size || header.sample_count > max_samples)
+            return 0;
+
+        const uint8_t *payload = block + sizeof(header);
+        uint8_t check = 0;
+        for (size_t i = 0; i < header.payload_size; i++)
+            check ^= payload[i];
+        if (check != header.check)
+            return 0;
+
+        Predictor predict_time, predict_raw;
+        predict_time.order = header.order >> 4;
+        predict_time.prev = header.timestamp_us;
+        predict_raw.order = header.order & 0x0F;
+        predict_raw.prev = (uint32_t)header.raw;
+        RiceState rice_time, rice_raw;
+        rice_time.begin(header.k_time);
+        rice_raw.begin(header.k_raw);
+
+        samples[0].timestamp_us = header.timestamp_us;
+        samples[0].raw = header.raw;
+
+        BitReader r(payload, header.payload_size);
+        for (size_t n = 1; n < header.sample_count; n++)
+        {
+            uint32_t u_time, u_raw;
+            if (n == 1)
+            {
+                if (!getFirst(r, u_time) || !getFirst(r, u_raw))
+                    return 0;
+            }
+            else
+            {
+                if (!r.rice(rice_time.k, u_time))
+                    return 0;
+                rice_time.update(u_time);
+                if (!r.rice(rice_raw.k, u_raw))
+                    return 0;
+                rice_raw.update(u_raw);
+            }
+            samples[n].timestamp_us = predict_time.restore(unzigzag(u_time));
+            samples[n].raw = (int32_t)predict_raw.restore(unzigzag(u_raw));
+        }
+
+        return r.complete() ? header.sample_count : 0;
+    }
+}
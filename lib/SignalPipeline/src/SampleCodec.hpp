@@ -0,0 +1,96 @@
+#pragma once
+
+// Lossless compression of raw sample streams (timestamp_us, raw) for captures and the serial
+// stream. Consecutive load readings differ by a few LSB and the timestamps follow the sample
+// period with some jitter, so both channels are predicted from the previous samples (first or
+// second order delta), the residuals zigzag mapped to unsigned and written as adaptive Rice
+// codes (parameter follows the running mean of the residuals, as in JPEG-LS). Residuals too
+// large for the code are escaped to 32 bits, any int32/uint32 input round trips exactly.
+//
+// The stream is cut into self-contained blocks: the header holds the first sample, the
+// prediction order and the stream position, so a reader can skip blocks by their headers
+// (random access by sample index) and resync on a damaged block. No allocation, no state
+// between blocks.
+// Portable, used by CaptureClass, SerialStream, the capture download and the host tools.
+//
+// block: CodecBlockHeader | bit stream, payload_size bytes, msb first
+// bit stream per sample after the first: rice(timestamp residual) rice(raw residual), the
+//          second sample has no running mean yet: bit length in 6 bits, then the bits
+// rice(u): q = u >> k zero bits, a one bit, k low bits of u. q >= CODEC_ESCAPE: CODEC_ESCAPE
+//          zero bits, a one bit, u in 32 bits
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <CaptureFormat.hpp>
+
+#define CODEC_BLOCK_MAGIC 0x4B42 // "BK"
+#define CODEC_MAX_BLOCK_SAMPLES 4096
+#define CODEC_ESCAPE 24
+#define CODEC_MAX_SAMPLE_BYTES ((2 * (CODEC_ESCAPE + 1 + 32) + 7 + 7) / 8) // two escaped codes and pending bits
+// worst case size of an encoded block of n samples
+#define CODEC_MAX_BLOCK_SIZE(n) (sizeof(CodecBlockHeader) + (n) * CODEC_MAX_SAMPLE_BYTES)
+
+enum CodecOrder : uint8_t
+{
+    CODEC_ORDER_AUTO = 0, // per block and channel, the order with the smaller residuals
+    CODEC_ORDER_1 = 1,    // x[n] - x[n-1]
+    CODEC_ORDER_2 = 2,    // x[n] - 2 x[n-1] + x[n-2]
+};
+
+struct __attribute__((packed)) CodecBlockHeader
+{
+    uint16_t magic = CODEC_BLOCK_MAGIC;
+    uint16_t sample_count = 0; // including the first sample in the header
+    uint16_t payload_size = 0; // bytes of bit stream after the header
+    uint8_t order = 0;         // prediction order, raw in the low nibble, timestamp in the high nibble
+    uint8_t check = 0;         // xor of the payload bytes
+    uint8_t k_time = 0;        // initial rice parameters
+    uint8_t k_raw = 0;
+    uint32_t first_index = 0; // stream position of the first sample, e.g. sample index in the capture
+
+    // first sample
+    uint32_t timestamp_us = 0;
+    int32_t raw = 0;
+};
+
+struct CodecResult
+{
+    size_t bytes = 0;   // block size including the header, 0 if nothing was encoded
+    size_t samples = 0; // samples consumed
+};
+
+namespace SampleCodec
+{
+    // encodes up to count samples (CODEC_MAX_BLOCK_SAMPLES) into one block at out. Stops early
+    // before a sample that might not fit into out_size, a block holds at least the first sample
+    // if out_size >= sizeof(CodecBlockHeader)
+    CodecResult encodeBlock(const CaptureSample *samples, size_t count, uint32_t first_index, uint8_t *out, size_t out_size,
+                            CodecOrder order = CODEC_ORDER_AUTO);
+
+    // plausible header, says nothing about the payload
+    bool headerValid(const CodecBlockHeader &header);
+
+    // decodes a complete block of size bytes, samples must hold max_samples. returns the
+    // number of samples, 0 if the block is damaged or has more than max_samples
+    size_t decodeBlock(const uint8_t *block, size_t size, CaptureSample *samples, size_t max_samples);
+
+    // reads and decodes the next block of a stream, read(buffer, length) returns bytes read.
+    // buffer holds CODEC_MAX_BLOCK_SIZE(max_samples) bytes. returns the number of samples,
+    // 0 at the end of the stream, on a truncated or a damaged block
+    template <typename Read>
+    size_t readBlock(Read read, uint8_t *buffer, size_t buffer_size, CaptureSample *samples, size_t max_samples,
+                     CodecBlockHeader *header_out = nullptr)
+    {
+        CodecBlockHeader &header = *(CodecBlockHeader *)buffer;
+        if (buffer_size < sizeof(CodecBlockHeader) || read(buffer, sizeof(CodecBlockHeader)) != sizeof(CodecBlockHeader) ||
+            !headerValid(header) || sizeof(CodecBlockHeader) + header.payload_size > buffer_size)
+            return 0;
+
+        if (read(buffer + sizeof(CodecBlockHeader), header.payload_size) != header.payload_size)
+            return 0;
+        if (header_out)
+            *header_out = header;
+        return decodeBlock(buffer, sizeof(CodecBlockHeader) + header.payload_size, samples, max_samples);
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+// Single writer, multiple reader snapshot of a trivially copyable struct (seqlock).
+// The writer never waits: it bumps the sequence to odd, copies the value and bumps it to
+// even again. Readers copy without locking and retry if the sequence was odd or changed
+// meanwhile, so they always get a consistent copy of one publish.
+//
+// The value is stored as 32 bit atomic words, relaxed word copies plus fences keep the
+// copy free of data races (plain 32 bit loads and stores on ESP32).
+//
+// A reader with a higher priority than the writer on the same core would spin while the
+// preempted writer is in the middle of a publish. read() therefore calls a backoff (on
+// target: sleep one tick) after SEQLOCK_SPIN_RETRIES failed attempts.
+//
+// Must not depend on Arduino or ESP-IDF headers.
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+#define SEQLOCK_SPIN_RETRIES 64
+
+template <typename T>
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable type");
+
+private:
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> _sequence{0};
+    std::atomic<uint32_t> _words[WORDS];
+
+public:
+    Seqlock()
+    {
+        write(T());
+    }
+
+    // writer side, one task only
+    void write(const T &value)
+    {
+        uint32_t words[WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+
+        uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; i++)
+            _words[i].store(words[i], std::memory_order_relaxed);
+
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // one attempt, false if a write was in progress
+    bool tryRead(T &value, uint32_t *sequence = nullptr) const
+    {
+        uint32_t before = _sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            return false;
+
+        uint32_t words[WORDS];
+        for (size_t i = 0; i < WORDS; i++)
+            words[i] = _words[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_sequence.load(std::memory_order_relaxed) != before)
+            return false;
+
+        memcpy(&value, words, sizeof(T));
+        if (sequence)
+            *sequence = before / 2;
+        return true;
+    }
+
+    // retries until consistent, a write takes a few hundred cycles
+    T read(uint32_t *sequence = nullptr, void (*backoff)() = nullptr) const
+    {
+        T value;
+        uint32_t retries = 0;
+        while (!tryRead(value, sequence))
+        {
+            if (backoff && ++retries % SEQLOCK_SPIN_RETRIES == 0)
+                backoff();
+        }
+        return value;
+    }
+
+    // number of publishes so far
+    uint32_t getSequence() const { return _sequence.load(std::memory_order_acquire) / 2; }
+};
@@ -0,0 +1,223 @@
+#include <SpectrumAnalyzer.hpp>
+
+#include <math.h>
+#include <string.h>
+
+#ifdef SPECTRUM_USE_ESP_DSP
+#include <esp_dsp.h>
+#endif
+
+size_t SpectrumAnalyzer::requiredMemory(size_t points)
+{
+    return (4 * points + 2 * (points / 2 + 1)) * sizeof(float);
+}
+
+bool SpectrumAnalyzer::validPoints(size_t points)
+{
+    return points >= SPECTRUM_MIN_POINTS && points <= SPECTRUM_MAX_POINTS && (points & (points - 1)) == 0;
+}
+
+bool SpectrumAnalyzer::begin(void *memory, size_t points, uint16_t averages)
+{
+    if (memory == nullptr || !validPoints(points))
+        return false;
+
+    _points = points;
+    _averages = averages < 1 ? 1 : (averages > SPECTRUM_MAX_AVERAGES ? SPECTRUM_MAX_AVERAGES : averages);
+
+    float *p = (float *)memory;
+    _window = p;
+    p += points;
+    _ring = p;
+    p += points;
+    _work = p;
+    p += points;
+    _twiddle = p;
+    p += points;
+    _power = p;
+    p += points / 2 + 1;
+    _result = p;
+
+    _windowGain = 0;
+    for (size_t i = 0; i < points; i++)
+    {
+        _window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / points);
+        _windowGain += _window[i];
+    }
+    for (size_t k = 0; k < points / 2; k++)
+    {
+        _twiddle[2 * k] = cosf(2.0f * (float)M_PI * k / points);
+        _twiddle[2 * k + 1] = sinf(2.0f * (float)M_PI * k / points);
+    }
+
+    memset(_result, 0, getBins() * sizeof(float));
+    _results = 0;
+    clear();
+    return true;
+}
+
+void SpectrumAnalyzer::clear()
+{
+    _ringHead = 0;
+    _filled = 0;
+    _sinceFrame = 0;
+    _accumulated = 0;
+    if (_power)
+        memset(_power, 0, getBins() * sizeof(float));
+}
+
+bool SpectrumAnalyzer::add(float value)
+{
+    if (_points == 0)
+        return false;
+
+    _ring[_ringHead] = value;
+    _ringHead = (_ringHead + 1) % _points;
+    // first frame as soon as the buffer is full, then every N/2 samples
+    if (_filled < _points)
+    {
+        if (++_filled < _points)
+            return false;
+    }
+    else if (++_sinceFrame < _points / 2)
+        return false;
+
+    _sinceFrame = 0;
+    return true;
+}
+
+void SpectrumAnalyzer::fft(float *data, size_t n) const
+{
+#ifdef SPECTRUM_USE_ESP_DSP
+    dsps_fft2r_fc32(data, n);
+    dsps_bit_rev_fc32(data, n);
+#else
+    // bit reversal permutation
+    for (size_t i = 1, j = 0; i < n; i++)
+    {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+        {
+            float re = data[2 * i], im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+
+    // iterative radix-2 butterflies, the twiddle table is for 2n points
+    for (size_t len = 2; len <= n; len <<= 1)
+    {
+        size_t half = len / 2;
+        size_t step = 2 * n / len;
+        for (size_t i = 0; i < n; i += len)
+        {
+            for (size_t k = 0; k < half; k++)
+            {
+                float wr = _twiddle[2 * k * step];
+                float wi = -_twiddle[2 * k * step + 1];
+                float *a = data + 2 * (i + k);
+                float *b = data + 2 * (i + k + half);
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+#endif
+}
+
+bool SpectrumAnalyzer::compute()
+{
+    if (_filled < _points)
+        return false;
+
+    size_t n = _points;
+    size_t m = n / 2;
+
+    // oldest sample first, mean removed, windowed, packed as z[i] = x[2i] + j x[2i+1]
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += _ring[i];
+    float mean = sum / n;
+    for (size_t i = 0; i < n; i++)
+        _work[i] = (_ring[(_ringHead + i) % n] - mean) * _window[i];
+
+    fft(_work, m);
+
+    // split: X[k] = (Z[k] + Z*[m-k]) / 2 - j W^k (Z[k] - Z*[m-k]) / 2, W = e^(-j 2 pi / n)
+    for (size_t k = 0; k <= m; k++)
+    {
+        size_t a = k % m;
+        size_t b = (m - k) % m;
+        float zr = _work[2 * a], zi = _work[2 * a + 1];
+        float cr = _work[2 * b], ci = -_work[2 * b + 1];
+
+        float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci); // even samples
+        float dr = 0.5f * (zr - cr), di = 0.5f * (zi - ci);
+        // odd samples: -j * d, rotated by W^k
+        float odr = di, odi = -dr;
+        float wr = k < m ? _twiddle[2 * k] : -1.0f;
+        float wi = k < m ? -_twiddle[2 * k + 1] : 0.0f;
+        float xr = er + odr * wr - odi * wi;
+        float xi = ei + odr * wi + odi * wr;
+
+        _power[k] += xr * xr + xi * xi;
+    }
+
+    if (++_accumulated < _averages)
+        return false;
+
+    // single sided peak amplitude: 2 |X| / sum(window), DC and Nyquist once
+    for (size_t k = 0; k <= m; k++)
+    {
+        float amplitude = sqrtf(_power[k] / _accumulated) / _windowGain;
+        _result[k] = (k == 0 || k == m) ? amplitude : 2.0f * amplitude;
+        _power[k] = 0;
+    }
+    _accumulated = 0;
+    _results++;
+    return true;
+}
+
+size_t SpectrumAnalyzer::findPeaks(float sample_rate, SpectrumPeak *peaks, size_t max_peaks) const
+{
+    size_t count = 0;
+    size_t bins = getBins();
+    float resolution = sample_rate / _points;
+
+    // bin 1 is still inside the window main lobe of DC
+    for (size_t k = 2; k + 1 < bins; k++)
+    {
+        float y0 = _result[k - 1], y1 = _result[k], y2 = _result[k + 1];
+        if (y1 <= y0 || y1 < y2 || y1 <= 0)
+            continue;
+
+        // parabolic interpolation of the peak position
+        float denominator = y0 - 2 * y1 + y2;
+        float offset = denominator != 0 ? 0.5f * (y0 - y2) / denominator : 0;
+
+        SpectrumPeak peak;
+        peak.frequency = (k + offset) * resolution;
+        peak.amplitude = y1;
+
+        // insert sorted by amplitude, drop the weakest
+        size_t pos = count < max_peaks ? count++ : max_peaks;
+        while (pos > 0 && peaks[pos - 1].amplitude < peak.amplitude)
+        {
+            if (pos < max_peaks)
+                peaks[pos] = peaks[pos - 1];
+            pos--;
+        }
+        if (pos < max_peaks)
+            peaks[pos] = peak;
+    }
+    return count;
+}
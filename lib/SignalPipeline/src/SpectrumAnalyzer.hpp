@@ -0,0 +1,95 @@
+#pragma once
+
+// Averaged magnitude spectrum of a sample stream: Hann window, 50% overlap, real FFT of
+// N points as complex FFT of N/2 points plus split. Power is averaged over a number of
+// frames, the result is the single sided peak amplitude per bin in the input unit.
+// The frame mean is removed, the static load would otherwise leak into the low bins.
+//
+// The complex FFT is radix-2. SPECTRUM_USE_ESP_DSP selects the esp-dsp implementation
+// (dsps_fft2r_fc32, needs dsps_fft2r_init_fc32 for SPECTRUM_MAX_POINTS / 2 first), the
+// portable one is used otherwise.
+//
+// Memory is provided by the caller (PSRAM on target). Not thread safe.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SPECTRUM_MIN_POINTS 256
+#define SPECTRUM_MAX_POINTS 4096
+#define SPECTRUM_MAX_AVERAGES 64
+#define SPECTRUM_DEFAULT_POINTS 1024
+#define SPECTRUM_DEFAULT_AVERAGES 8
+#define SPECTRUM_SIZES 5 // 256 .. 4096 points for the benchmark
+
+// state of the analysis task as /status/spectrum reports it, see SpectrumClass
+struct SpectrumStatus
+{
+    bool enabled = false;
+    bool sse = false;
+    uint16_t points = 0;
+    uint16_t averages = 0;
+    uint16_t max_points = 0;
+    float sample_rate = 0; // measured, frequency axis of the result
+    uint32_t frames = 0;
+    uint32_t results = 0;
+    uint32_t overruns = 0; // samples dropped because the task fell behind, never blocks acquisition
+    uint32_t compute_us_last = 0;
+    uint32_t compute_us_max = 0;
+    float compute_us_mean = 0;
+    uint32_t bench_us[SPECTRUM_SIZES] = {}; // per frame for 256 .. 4096 points, 0: not measured
+};
+
+struct SpectrumPeak
+{
+    float frequency = 0; // Hz, interpolated between bins
+    float amplitude = 0;
+};
+
+class SpectrumAnalyzer
+{
+private:
+    size_t _points = 0;
+    uint16_t _averages = 1;
+
+    // caller provided memory
+    float *_window = nullptr;  // N
+    float *_ring = nullptr;    // N, input samples
+    float *_work = nullptr;    // N, N/2 complex interleaved
+    float *_twiddle = nullptr; // N, cos/sin of 2 pi k / N for k < N/2
+    float *_power = nullptr;   // N/2 + 1, accumulated
+    float *_result = nullptr;  // N/2 + 1, amplitude of the last completed average
+
+    float _windowGain = 0; // sum of the window
+    size_t _ringHead = 0;
+    size_t _filled = 0;
+    size_t _sinceFrame = 0;
+    uint16_t _accumulated = 0;
+    uint32_t _results = 0;
+
+    void fft(float *data, size_t n) const;
+
+public:
+    // bytes for a number of points
+    static size_t requiredMemory(size_t points);
+    // power of two between SPECTRUM_MIN_POINTS and SPECTRUM_MAX_POINTS
+    static bool validPoints(size_t points);
+
+    // memory must hold requiredMemory(points) bytes, aligned for float
+    bool begin(void *memory, size_t points, uint16_t averages);
+    void clear();
+
+    // add one sample, returns true if a frame is due (every N/2 samples once N are buffered)
+    bool add(float value);
+    // window and transform the latest N samples, returns true if an average completed
+    bool compute();
+
+    size_t getPoints() const { return _points; }
+    uint16_t getAverages() const { return _averages; }
+    size_t getBins() const { return _points / 2 + 1; }
+    // amplitude per bin, bin k is at k * sample_rate / N
+    const float *getResult() const { return _result; }
+    uint32_t getResults() const { return _results; }
+
+    // strongest local maxima of the result above DC, sorted by amplitude. returns count
+    size_t findPeaks(float sample_rate, SpectrumPeak *peaks, size_t max_peaks) const;
+};
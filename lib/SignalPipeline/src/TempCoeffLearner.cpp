@@ -0,0 +1,40 @@
+#include <TempCoeffLearner.hpp>
+
+void TempCoeffLearner::reset()
+{
+    *this = TempCoeffLearner();
+}
+
+void TempCoeffLearner::add(float temp_c, float value)
+{
+    _n++;
+    double dT = temp_c - _meanT;
+    double dV = value - _meanV;
+    _meanT += dT / _n;
+    _meanV += dV / _n;
+    _m2T += dT * (temp_c - _meanT);
+    _m2V += dV * (value - _meanV);
+    _cTV += dT * (value - _meanV);
+
+    if (_n == 1 || temp_c < _tMin)
+        _tMin = temp_c;
+    if (_n == 1 || temp_c > _tMax)
+        _tMax = temp_c;
+}
+
+bool TempCoeffLearner::solve(TempCoeffResult &result) const
+{
+    result = TempCoeffResult();
+    result.points = _n;
+    if (_n < 3 || _m2T <= 0)
+        return false;
+
+    double slope = _cTV / _m2T;
+    result.slope = slope;
+    result.intercept = _meanV - slope * _meanT;
+    result.r2 = _m2V > 0 ? (_cTV * _cTV) / (_m2T * _m2V) : 1.0;
+    result.temp_min = _tMin;
+    result.temp_max = _tMax;
+    result.temp_mean = _meanT;
+    return true;
+}
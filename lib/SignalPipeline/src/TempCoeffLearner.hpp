@@ -0,0 +1,42 @@
+#pragma once
+
+// Learns a temperature coefficient by least squares line fit value = a + slope * temp over
+// a logged warm-up (e.g. sensor unloaded for the zero coefficient). Incremental, constant
+// memory, centered co-moments for numerical stability over long runs.
+// Must not depend on Arduino or ESP-IDF headers.
+
+#include <stdint.h>
+
+struct TempCoeffResult
+{
+    uint32_t points = 0;
+    float slope = 0.0;     // value units per degC
+    float intercept = 0.0; // value at 0 degC
+    float r2 = 0.0;        // coefficient of determination, quality of the fit
+    float temp_min = 0.0;
+    float temp_max = 0.0;
+    float temp_mean = 0.0;
+};
+
+class TempCoeffLearner
+{
+private:
+    uint32_t _n = 0;
+    double _meanT = 0;
+    double _meanV = 0;
+    double _m2T = 0; // sum of squared deviations
+    double _m2V = 0;
+    double _cTV = 0; // co-moment
+    float _tMin = 0;
+    float _tMax = 0;
+
+public:
+    void reset();
+    void add(float temp_c, float value);
+
+    uint32_t getPoints() const { return _n; }
+    float getTemperatureSpan() const { return _n ? _tMax - _tMin : 0; }
+
+    // false if there are too few points or no temperature change to fit
+    bool solve(TempCoeffResult &result) const;
+};
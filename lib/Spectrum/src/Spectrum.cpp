@@ -0,0 +1,243 @@
+#include <Spectrum.hpp>
+
+#include <esp_heap_caps.h>
+#include <Loadcell.hpp>   // -->g_Loadcell
+#include <MemoryPlan.hpp> // -->g_MemoryPlan
+
+#ifdef SPECTRUM_USE_ESP_DSP
+#include <esp_dsp.h>
+#endif
+
+#define SPECTRUM_CHUNK 64
+#define SPECTRUM_BENCH_RUNS 4
+
+SpectrumClass g_Spectrum;
+
+SpectrumClass::SpectrumClass()
+{
+    // on init construct with default variables
+}
+
+void SpectrumClass::initialize()
+{
+    log_i("Spectrum init");
+
+    _mutex = xSemaphoreCreateMutex();
+    _samples = xStreamBufferCreateStatic(SPECTRUM_SAMPLE_BUFFER_SIZE, sizeof(float), _samplesStorage, &_samplesStruct);
+    g_MemoryPlan.registerStatic("spectrum buffer", sizeof(_samplesStorage));
+
+    _maxPoints = SPECTRUM_MAX_POINTS;
+    _memory = heap_caps_malloc(SpectrumAnalyzer::requiredMemory(_maxPoints), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    bool psram = _memory != NULL;
+    if (_memory == NULL)
+    {
+        log_w("no PSRAM for spectrum, limited to %u points", SPECTRUM_FALLBACK_POINTS);
+        _maxPoints = SPECTRUM_FALLBACK_POINTS;
+        _memory = malloc(SpectrumAnalyzer::requiredMemory(_maxPoints));
+    }
+    // allocated once at boot, part of the memory plan
+    g_MemoryPlan.registerStatic("spectrum", SpectrumAnalyzer::requiredMemory(_maxPoints), psram);
+
+#ifdef SPECTRUM_USE_ESP_DSP
+    // twiddle table of the esp-dsp radix-2 fft, for the N/2 point complex transform
+    if (dsps_fft2r_init_fc32(NULL, SPECTRUM_MAX_POINTS / 2) != ESP_OK)
+        log_e("esp-dsp fft init failed");
+    g_MemoryPlan.registerStatic("spectrum fft table", SPECTRUM_MAX_POINTS / 2 * sizeof(float), false);
+#endif
+
+    _status.max_points = _maxPoints;
+}
+
+void SpectrumClass::push(float value)
+{
+    if (!_enabled || _samples == NULL)
+        return;
+
+    // single writer: whole samples only, a partial write would shift all following ones
+    if (xStreamBufferSpacesAvailable(_samples) < sizeof(value) || xStreamBufferSend(_samples, &value, sizeof(value), 0) != sizeof(value))
+        _overruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SpectrumClass::cmdConfigure(bool enable, uint16_t points, uint16_t averages, bool sse)
+{
+    _requestPoints = points;
+    _requestAverages = averages;
+    _requestSse = sse;
+    _enabled = enable;
+    _configRequest = true;
+}
+
+void SpectrumClass::cmdBenchmark()
+{
+    _benchRequest = true;
+}
+
+void SpectrumClass::applyConfigRequest()
+{
+    _configRequest = false;
+
+    uint16_t points = _requestPoints;
+    if (!SpectrumAnalyzer::validPoints(points) || points > _maxPoints)
+    {
+        log_w("spectrum points %u invalid, using %u", points, SPECTRUM_DEFAULT_POINTS);
+        points = SPECTRUM_DEFAULT_POINTS;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _analyzer.begin(_memory, points, _requestAverages);
+    _status.enabled = _enabled;
+    _status.sse = _requestSse;
+    _status.points = _analyzer.getPoints();
+    _status.averages = _analyzer.getAverages();
+    _status.frames = 0;
+    _status.results = 0;
+    _overrunsBaseline = _overruns.load(std::memory_order_relaxed);
+    _status.compute_us_last = 0;
+    _status.compute_us_max = 0;
+    _status.compute_us_mean = 0;
+    xSemaphoreGive(_mutex);
+
+    // samples from before the change belong to the old settings
+    xStreamBufferReset(_samples);
+
+    log_i("spectrum %s, %u points, %u averages", _enabled ? "enabled" : "disabled", _status.points, _status.averages);
+}
+
+void SpectrumClass::runBenchmark()
+{
+    _benchRequest = false;
+
+    // wall time per frame in this task, includes preemption by higher priority tasks on this core
+    uint32_t bench_us[SPECTRUM_SIZES] = {};
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < SPECTRUM_SIZES; i++)
+    {
+        size_t points = SPECTRUM_MIN_POINTS << i;
+        if (points > _maxPoints)
+            break;
+
+        SpectrumAnalyzer bench;
+        bench.begin(_memory, points, 1);
+        for (size_t n = 0; n < points; n++)
+            bench.add(sinf(2.0f * (float)M_PI * 50.0f * n / 1000.0f));
+
+        uint32_t start = micros();
+        for (uint8_t run = 0; run < SPECTRUM_BENCH_RUNS; run++)
+            bench.compute();
+        bench_us[i] = (micros() - start) / SPECTRUM_BENCH_RUNS;
+        log_i("spectrum benchmark: %u points %u us per frame", points, bench_us[i]);
+    }
+    memcpy(_status.bench_us, bench_us, sizeof(bench_us));
+    xSemaphoreGive(_mutex);
+
+    // the benchmark used the analyzer memory, start over with the current settings
+    _configRequest = true;
+}
+
+void SpectrumClass::publishPeaks()
+{
+    SpectrumPeak peaks[SPECTRUM_PEAKS];
+    size_t count = _analyzer.findPeaks(_status.sample_rate, peaks, SPECTRUM_PEAKS);
+
+    // <results>,<f1>,<a1>,... fits the sse event size
+    String data = String(_status.results);
+    for (size_t i = 0; i < count; i++)
+        data += "," + String(peaks[i].frequency, 1) + "," + String(peaks[i].amplitude, 4);
+
+    DataEvent ev("Webservice/sendSpectrum", data);
+    EventManager::instance().publish(ev);
+}
+
+void SpectrumClass::update_loop()
+{
+    if (_configRequest)
+        applyConfigRequest();
+    if (_benchRequest)
+        runBenchmark();
+    if (!_status.enabled)
+        return;
+
+    float chunk[SPECTRUM_CHUNK];
+    size_t received;
+    while ((received = xStreamBufferReceive(_samples, chunk, sizeof(chunk), 0)) > 0)
+    {
+        for (size_t i = 0; i < received / sizeof(float); i++)
+        {
+            if (!_analyzer.add(chunk[i]))
+                continue;
+
+            uint32_t start = micros();
+            xSemaphoreTake(_mutex, portMAX_DELAY);
+            bool completed = _analyzer.compute();
+            uint32_t compute_us = micros() - start;
+
+            _status.frames++;
+            _status.compute_us_last = compute_us;
+            if (compute_us > _status.compute_us_max)
+                _status.compute_us_max = compute_us;
+            _status.compute_us_mean += ((float)compute_us - _status.compute_us_mean) / _status.frames;
+            if (completed)
+            {
+                PipelineStats stats = g_Loadcell.getStats();
+                _status.sample_rate = stats.interval_us_mean > 0 ? 1e6f / stats.interval_us_mean : g_Loadcell.getSampleRate();
+                _status.results = _analyzer.getResults();
+            }
+            xSemaphoreGive(_mutex);
+
+            if (completed && _status.sse)
+                publishPeaks();
+        }
+    }
+}
+
+SpectrumStatus SpectrumClass::getStatus()
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    SpectrumStatus status = _status;
+    status.overruns = _overruns.load(std::memory_order_relaxed) - _overrunsBaseline;
+    xSemaphoreGive(_mutex);
+    return status;
+}
+
+void SpectrumClass::printJson(Print &out, size_t max_bins)
+{
+    SpectrumStatus status = getStatus();
+    size_t bins = status.points / 2 + 1;
+    size_t group = max_bins > 0 && bins > max_bins ? (bins + max_bins - 1) / max_bins : 1;
+    float resolution = status.points ? status.sample_rate / status.points : 0;
+
+    out.printf("{\"enabled\":%s,\"points\":%u,\"averages\":%u,\"sample_rate\":%g,\"results\":%u,\"compute_us_last\":%u,\"bin_hz\":%g,\"amplitude\":[",
+               status.enabled ? "true" : "false", status.points, status.averages, status.sample_rate, status.results, status.compute_us_last, resolution * group);
+
+    // copy in small chunks so the fft task never waits for the json formatting
+    float chunk[SPECTRUM_CHUNK];
+    bool first = true;
+    for (size_t k = 0; status.results > 0 && k < bins;)
+    {
+        size_t n = 0;
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        if (_analyzer.getPoints() != status.points)
+        {
+            // reconfigured while printing
+            xSemaphoreGive(_mutex);
+            break;
+        }
+        const float *result = _analyzer.getResult();
+        for (; n < SPECTRUM_CHUNK && k < bins; n++)
+        {
+            // max of the group, a narrow peak must not disappear in the decimation
+            float value = 0;
+            for (size_t end = min(k + group, bins); k < end; k++)
+                value = max(value, result[k]);
+            chunk[n] = value;
+        }
+        xSemaphoreGive(_mutex);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            out.printf("%s%g", first ? "" : ",", chunk[i]);
+            first = false;
+        }
+    }
+    out.print("]}");
+}
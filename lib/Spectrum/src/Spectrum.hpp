@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/stream_buffer.h>
+#include <atomic>
+#include <DataEvent.hpp>
+#include <SpectrumAnalyzer.hpp>
+
+#define SPECTRUM_SAMPLE_BUFFER_SIZE 4096   // bytes, 1024 samples between two task runs
+#define SPECTRUM_FALLBACK_POINTS 1024      // without PSRAM
+#define SPECTRUM_PEAKS 3                   // in the sse event
+
+using namespace esp32m;
+
+/// Averaged magnitude spectrum of the converted readings for vibration analysis, see
+/// SpectrumAnalyzer. Acquisition pushes samples into a stream buffer, the FFT runs in a
+/// low priority task on the other core. Off by default, /api/cmd/spectrum starts it.
+class SpectrumClass
+{
+private:
+    StreamBufferHandle_t _samples = NULL;
+    uint8_t _samplesStorage[SPECTRUM_SAMPLE_BUFFER_SIZE + 1]; // static, see MemoryPlan
+    StaticStreamBuffer_t _samplesStruct;
+
+    SpectrumAnalyzer _analyzer;
+    void *_memory = NULL;
+    size_t _maxPoints = 0;
+    SemaphoreHandle_t _mutex = NULL; // analyzer result, read by the web handler
+
+    SpectrumStatus _status;
+    // only written by push on the acquisition core, the status reports the count since the
+    // last config change. _status.overruns is filled in by getStatus
+    std::atomic<uint32_t> _overruns{0};
+    uint32_t _overrunsBaseline = 0;
+
+    // set by commands, applied in update_loop
+    volatile bool _enabled = false;
+    volatile bool _configRequest = false;
+    volatile bool _benchRequest = false;
+    uint16_t _requestPoints = SPECTRUM_DEFAULT_POINTS;
+    uint16_t _requestAverages = SPECTRUM_DEFAULT_AVERAGES;
+    bool _requestSse = false;
+
+    void applyConfigRequest();
+    void runBenchmark();
+    void publishPeaks();
+
+public:
+    SpectrumClass();
+
+    void initialize();
+    void update_loop();
+
+    // called from acquisition, never blocks
+    void push(float value);
+
+    void cmdConfigure(bool enable, uint16_t points, uint16_t averages, bool sse);
+    void cmdBenchmark();
+
+    SpectrumStatus getStatus();
+    // latest averaged spectrum as json, at most max_bins (max of neighbouring bins)
+    void printJson(Print &out, size_t max_bins);
+};
+
+extern SpectrumClass g_Spectrum;
@@ -0,0 +1,159 @@
+#include <Storage.hpp>
+
+#include <MemoryPlan.hpp> // -->g_MemoryPlan
+
+StorageClass g_Storage;
+
+StorageClass::StorageClass()
+{
+    // on init construct with default variables
+}
+
+void StorageClass::initialize()
+{
+    log_i("Storage init");
+
+    _lock = xSemaphoreCreateMutexStatic(&_lockBuffer);
+    _writer.begin(STORAGE_ROOT);
+    g_MemoryPlan.registerStatic("storage queue", sizeof(_queue) + sizeof(_writer));
+}
+
+void StorageClass::notify()
+{
+    if (_task)
+        xTaskNotifyGive(_task);
+}
+
+void StorageClass::waitWork()
+{
+    ulTaskNotifyTake(pdTRUE, STORAGE_FLUSH_MS / portTICK_PERIOD_MS);
+}
+
+void StorageClass::update_loop()
+{
+    if (!_task)
+        _task = xTaskGetCurrentTaskHandle();
+
+    StorageJob job;
+    while (true)
+    {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool found = _queue.next(job);
+        xSemaphoreGive(_lock);
+        if (!found)
+            break;
+
+        // the slot is busy, producers do not touch it while it is written
+        uint32_t start = micros();
+        bool ok = _writer.execute(job);
+        uint32_t write_us = micros() - start;
+
+        StorageResult result;
+        StorageCallback callback;
+        void *context;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        _queue.complete(job, ok, write_us, micros(), result, callback, context);
+        _writerStats = _writer.getStats();
+        xSemaphoreGive(_lock);
+
+        if (!ok)
+            log_e("storage write of %s failed", result.path);
+        if (callback)
+            callback(result, context);
+        _lastWriteMs = millis();
+    }
+
+    // deferred work, after the writes queued before it
+    while (true)
+    {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        Deferred deferred = {nullptr, nullptr};
+        if (_deferredCount > 0)
+        {
+            deferred = _deferred[0];
+            _deferredCount--;
+            memmove(_deferred, _deferred + 1, _deferredCount * sizeof(Deferred));
+        }
+        xSemaphoreGive(_lock);
+        if (!deferred.work)
+            break;
+        deferred.work(deferred.context);
+    }
+
+    // a capture that pauses: its staged tail reaches the flash
+    if (_writer.hasUnflushed() && millis() - _lastWriteMs >= STORAGE_FLUSH_MS)
+    {
+        _writer.flush();
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        _writerStats = _writer.getStats();
+        xSemaphoreGive(_lock);
+    }
+}
+
+bool StorageClass::submit(const char *path, StorageMode mode, const uint8_t *data, size_t length, uint32_t offset,
+                          StorageCallback callback, void *context, uint32_t wait_ms)
+{
+    uint32_t start = millis();
+    while (true)
+    {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool queued = _queue.submit(path, mode, data, length, micros(), offset, callback, context);
+        xSemaphoreGive(_lock);
+
+        if (queued)
+        {
+            notify();
+            return true;
+        }
+        if (millis() - start >= wait_ms)
+            return false;
+        vTaskDelay(STORAGE_WAIT_POLL_MS / portTICK_PERIOD_MS);
+    }
+}
+
+bool StorageClass::defer(StorageWork work, void *context)
+{
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    bool queued = true;
+    bool known = false;
+    for (uint8_t i = 0; i < _deferredCount; i++)
+        known |= _deferred[i].work == work && _deferred[i].context == context;
+    if (!known)
+    {
+        queued = _deferredCount < STORAGE_DEFERRED;
+        if (queued)
+            _deferred[_deferredCount++] = {work, context};
+    }
+    xSemaphoreGive(_lock);
+
+    if (queued)
+        notify();
+    return queued;
+}
+
+bool StorageClass::waitIdle(uint32_t timeout_ms)
+{
+    uint32_t start = millis();
+    while (true)
+    {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool idle = _queue.idle();
+        xSemaphoreGive(_lock);
+
+        if (idle)
+            return true;
+        if (millis() - start >= timeout_ms)
+            return false;
+        vTaskDelay(STORAGE_WAIT_POLL_MS / portTICK_PERIOD_MS);
+    }
+}
+
+StorageStats StorageClass::getStats()
+{
+    StorageStats stats;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    stats.queue = _queue.getStats();
+    stats.writer = _writerStats;
+    xSemaphoreGive(_lock);
+    return stats;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/semphr.h>
+#include <StorageQueue.hpp>
+#include <StorageWriter.hpp>
+
+#define STORAGE_ROOT "/ffat"   // FFat mount point in the VFS
+#define STORAGE_FLUSH_MS 1000  // a staged stream tail is written after this idle time
+#define STORAGE_WAIT_POLL_MS 5 // submit with a wait: retry period while no slot is free
+#define STORAGE_DEFERRED 4     // pending deferred work items
+
+// work that runs in Task_Storage, see StorageClass::defer
+typedef void (*StorageWork)(void *context);
+
+struct StorageStats
+{
+    StorageQueueStats queue;
+    StorageWriterStats writer;
+};
+
+/// Write-behind service, the only writer to FFat. Config saves, capture data, the capture
+/// catalogue and the MQTT spool are queued (StorageQueue) and written by Task_Storage
+/// (StorageWriter), which also creates missing directories, so no web handler, event
+/// callback or acquisition path waits for a FAT sector write or an erase. Completion is
+/// reported to the callback of a request, in Task_Storage.
+/// Reads stay with the modules, readLatest gives them a save that is still queued. A read
+/// for a caller that must not wait behind a flash write (the web server) is deferred to
+/// Task_Storage.
+class StorageClass
+{
+private:
+    StorageQueue _queue;
+    StorageWriter _writer;
+    StorageWriterStats _writerStats; // copy taken under the lock
+
+    SemaphoreHandle_t _lock = NULL;
+    StaticSemaphore_t _lockBuffer;
+    TaskHandle_t _task = NULL;
+    uint32_t _lastWriteMs = 0;
+
+    struct Deferred
+    {
+        StorageWork work;
+        void *context;
+    };
+    Deferred _deferred[STORAGE_DEFERRED];
+    uint8_t _deferredCount = 0;
+
+    void notify();
+
+public:
+    StorageClass();
+
+    // from setup before the first config is loaded, Task_Storage writes once FFat is mounted
+    void initialize();
+    // Task_Storage: writes the queued requests
+    void update_loop();
+    // until a request is submitted or a staged tail is due
+    void waitWork();
+
+    // copies the data into the queue. wait_ms: time to wait for a free slot, 0 for callers
+    // that must not block. false if the request was not queued
+    bool submit(const char *path, StorageMode mode, const uint8_t *data, size_t length, uint32_t offset = 0,
+                StorageCallback callback = nullptr, void *context = nullptr, uint32_t wait_ms = 0);
+
+    // whole file content serialized directly into the queue: fill(buffer, capacity) returns
+    // the length, 0 to drop the request. Never blocks on flash
+    template <typename Fill>
+    bool replace(const char *path, Fill fill, StorageCallback callback = nullptr, void *context = nullptr)
+    {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        size_t capacity;
+        uint8_t *buffer = _queue.begin(path, STORAGE_REPLACE, 0, capacity, micros());
+        size_t length = buffer ? fill(buffer, capacity) : 0;
+        if (length > 0)
+            _queue.commit(length, 0, callback, context);
+        else if (buffer)
+            _queue.abort();
+        xSemaphoreGive(_lock);
+
+        if (length > 0)
+            notify();
+        return length > 0;
+    }
+
+    // read(data, length) with the content of a queued replace of path, if there is one
+    template <typename Read>
+    bool readLatest(const char *path, Read read)
+    {
+        const uint8_t *data;
+        size_t length;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool found = _queue.latest(path, data, length);
+        if (found)
+            read(data, length);
+        xSemaphoreGive(_lock);
+        return found;
+    }
+
+    // work(context) in Task_Storage after the requests queued before, e.g. loading the configs
+    // for a web command. A request already deferred is not added twice. false if full
+    bool defer(StorageWork work, void *context = nullptr);
+
+    // until all queued requests are written, e.g. before reading files back
+    bool waitIdle(uint32_t timeout_ms);
+
+    StorageStats getStats();
+};
+
+extern StorageClass g_Storage;
@@ -0,0 +1,220 @@
+#include <StorageQueue.hpp>
+
+#include <string.h>
+
+// newest request of path, pending or busy
+int8_t StorageQueue::newest(const char *path) const
+{
+    int8_t found = -1;
+    for (uint8_t i = 0; i < STORAGE_QUEUE_SLOTS; i++)
+    {
+        const Slot &slot = _slots[i];
+        if (slot.state == SLOT_FREE)
+            continue;
+        if (strcmp(slot.path, path) != 0)
+            continue;
+        if (found < 0 || (int32_t)(slot.sequence - _slots[found].sequence) > 0)
+            found = i;
+    }
+    return found;
+}
+
+uint8_t StorageQueue::streamSlots() const
+{
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < STORAGE_QUEUE_SLOTS; i++)
+        if (_slots[i].state != SLOT_FREE && _slots[i].mode != STORAGE_REPLACE)
+            used++;
+    return used;
+}
+
+void StorageQueue::updateDepth()
+{
+    uint8_t depth = 0;
+    for (uint8_t i = 0; i < STORAGE_QUEUE_SLOTS; i++)
+        if (_slots[i].state == SLOT_PENDING || _slots[i].state == SLOT_BUSY)
+            depth++;
+    _stats.depth = depth;
+    if (depth > _stats.depth_peak)
+        _stats.depth_peak = depth;
+}
+
+uint8_t *StorageQueue::begin(const char *path, StorageMode mode, size_t min_length, size_t &capacity, uint32_t now_us)
+{
+    capacity = 0;
+    if (_reserved >= 0 || strlen(path) >= STORAGE_PATH_SIZE || min_length > STORAGE_SLOT_SIZE)
+        return nullptr;
+
+    // the newest request of the path, if it still waits and is of the same kind
+    int8_t index = newest(path);
+    if (index >= 0)
+    {
+        Slot &slot = _slots[index];
+        bool merge = slot.state == SLOT_PENDING && slot.mode == mode &&
+                     (mode == STORAGE_REPLACE || (mode == STORAGE_APPEND && slot.length + min_length <= STORAGE_SLOT_SIZE));
+        if (merge)
+        {
+            _reserved = index;
+            _reservedMerge = true;
+            _reservedStart = mode == STORAGE_APPEND ? slot.length : 0;
+            slot.state = SLOT_RESERVED;
+            capacity = STORAGE_SLOT_SIZE - _reservedStart;
+            return slot.data + _reservedStart;
+        }
+    }
+
+    for (uint8_t i = 0; i < STORAGE_QUEUE_SLOTS && (mode == STORAGE_REPLACE || streamSlots() < STORAGE_STREAM_SLOTS); i++)
+    {
+        Slot &slot = _slots[i];
+        if (slot.state != SLOT_FREE)
+            continue;
+
+        strcpy(slot.path, path);
+        slot.mode = mode;
+        slot.length = 0;
+        slot.submit_us = now_us;
+        slot.state = SLOT_RESERVED;
+        _reserved = i;
+        _reservedMerge = false;
+        _reservedStart = 0;
+        capacity = STORAGE_SLOT_SIZE;
+        return slot.data;
+    }
+
+    _stats.rejected++;
+    return nullptr;
+}
+
+void StorageQueue::commit(size_t length, uint32_t offset, StorageCallback callback, void *context)
+{
+    if (_reserved < 0)
+        return;
+
+    Slot &slot = _slots[_reserved];
+    slot.length = _reservedStart + length;
+    slot.state = SLOT_PENDING;
+    // a merged request keeps the position and submit time of the pending one
+    if (!_reservedMerge)
+    {
+        slot.offset = offset;
+        slot.sequence = _sequence++;
+    }
+    if (callback)
+    {
+        slot.callback = callback;
+        slot.context = context;
+    }
+    else if (!_reservedMerge)
+    {
+        slot.callback = nullptr;
+        slot.context = nullptr;
+    }
+
+    _stats.submitted++;
+    if (_reservedMerge)
+        _stats.coalesced++;
+    _reserved = -1;
+    updateDepth();
+}
+
+void StorageQueue::abort()
+{
+    if (_reserved < 0)
+        return;
+
+    Slot &slot = _slots[_reserved];
+    if (_reservedMerge && slot.mode == STORAGE_APPEND)
+    {
+        // nothing written into the pending data
+        slot.state = SLOT_PENDING;
+    }
+    else
+    {
+        // a merged replace may have overwritten the pending content, it is dropped as well
+        if (_reservedMerge)
+            _stats.failed++;
+        slot.state = SLOT_FREE;
+        slot.callback = nullptr;
+    }
+    _reserved = -1;
+    updateDepth();
+}
+
+bool StorageQueue::submit(const char *path, StorageMode mode, const uint8_t *data, size_t length, uint32_t now_us,
+                          uint32_t offset, StorageCallback callback, void *context)
+{
+    size_t capacity;
+    uint8_t *buffer = begin(path, mode, length, capacity, now_us);
+    if (!buffer)
+        return false;
+
+    if (length > 0)
+        memcpy(buffer, data, length);
+    commit(length, offset, callback, context);
+    return true;
+}
+
+bool StorageQueue::next(StorageJob &job)
+{
+    int8_t found = -1;
+    for (uint8_t i = 0; i < STORAGE_QUEUE_SLOTS; i++)
+    {
+        if (_slots[i].state != SLOT_PENDING)
+            continue;
+        if (found < 0 || (int32_t)(_slots[i].sequence - _slots[found].sequence) < 0)
+            found = i;
+    }
+    if (found < 0)
+        return false;
+
+    Slot &slot = _slots[found];
+    slot.state = SLOT_BUSY;
+    job.slot = found;
+    job.path = slot.path;
+    job.mode = slot.mode;
+    job.offset = slot.offset;
+    job.data = slot.data;
+    job.length = slot.length;
+    return true;
+}
+
+void StorageQueue::complete(const StorageJob &job, bool ok, uint32_t write_us, uint32_t now_us, StorageResult &result,
+                            StorageCallback &callback, void *&context)
+{
+    Slot &slot = _slots[job.slot];
+
+    strcpy(result.path, slot.path);
+    result.mode = slot.mode;
+    result.ok = ok;
+    result.bytes = slot.length;
+    result.write_us = write_us;
+    result.latency_us = now_us - slot.submit_us;
+    callback = slot.callback;
+    context = slot.context;
+
+    _stats.completed++;
+    if (!ok)
+        _stats.failed++;
+    _stats.write_us_last = write_us;
+    if (write_us > _stats.write_us_max)
+        _stats.write_us_max = write_us;
+    _stats.write_us_total += write_us;
+    _stats.latency_us_last = result.latency_us;
+    if (result.latency_us > _stats.latency_us_max)
+        _stats.latency_us_max = result.latency_us;
+
+    slot.state = SLOT_FREE;
+    slot.callback = nullptr;
+    updateDepth();
+}
+
+bool StorageQueue::latest(const char *path, const uint8_t *&data, size_t &length) const
+{
+    int8_t index = newest(path);
+    if (index < 0 || _slots[index].mode != STORAGE_REPLACE || _slots[index].state == SLOT_RESERVED)
+        return false;
+
+    data = _slots[index].data;
+    length = _slots[index].length;
+    return true;
+}
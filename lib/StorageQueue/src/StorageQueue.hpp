@@ -0,0 +1,132 @@
+#pragma once
+
+// Write requests for the storage task, in a fixed pool of slots. Producers copy (or serialize)
+// their data into a slot and return, the storage task writes the slots in submit order with
+// StorageWriter. Repeated requests are coalesced while they wait:
+//   STORAGE_REPLACE  whole file content, a pending replace of the same path takes the new
+//                    content (latest wins), e.g. several config saves in a row
+//   STORAGE_APPEND   appended to a pending append of the same path while the slot has room,
+//                    e.g. the encoded blocks of a capture
+// Only the newest pending request of a path is merged into, so the order per path is kept.
+// A merged request completes with the request it was merged into, the callback of the newest
+// one is kept. Appends, patches and closes use at most STORAGE_STREAM_SLOTS slots, a capture
+// waiting for the flash does not take the slots of the config saves.
+// Portable, no Arduino dependencies. Not thread safe, the owner serializes calls.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef STORAGE_QUEUE_SLOTS
+#define STORAGE_QUEUE_SLOTS 7 // the five config files and the stream slots
+#endif
+#define STORAGE_STREAM_SLOTS 2 // one written, one filled
+#define STORAGE_SLOT_SIZE 2048 // MAX_DOCUMENT_SIZE, a serialized config fits one slot
+#define STORAGE_PATH_SIZE 48
+
+enum StorageMode : uint8_t
+{
+    STORAGE_REPLACE = 0, // whole content, written to <path>.tmp and renamed
+    STORAGE_APPEND,      // to the end of the file, created if missing
+    STORAGE_PATCH,       // at offset in the existing file, e.g. a header field
+    STORAGE_CLOSE,       // no data: write what is staged and close the file
+};
+
+struct StorageResult
+{
+    char path[STORAGE_PATH_SIZE] = {};
+    StorageMode mode = STORAGE_REPLACE;
+    bool ok = false;
+    uint32_t bytes = 0;
+    uint32_t write_us = 0;   // time in StorageWriter
+    uint32_t latency_us = 0; // submit of the oldest merged request to completion
+};
+
+// called by the storage task after the request is written
+typedef void (*StorageCallback)(const StorageResult &result, void *context);
+
+struct StorageJob
+{
+    uint8_t slot = 0;
+    const char *path = nullptr;
+    StorageMode mode = STORAGE_REPLACE;
+    uint32_t offset = 0;
+    const uint8_t *data = nullptr;
+    size_t length = 0;
+};
+
+struct StorageQueueStats
+{
+    uint32_t submitted = 0;
+    uint32_t coalesced = 0; // merged into a pending request, no write of their own
+    uint32_t rejected = 0;  // no free slot, or all stream slots used
+    uint32_t completed = 0;
+    uint32_t failed = 0;
+    uint8_t depth = 0; // pending and in progress
+    uint8_t depth_peak = 0;
+    uint32_t write_us_last = 0;
+    uint32_t write_us_max = 0;
+    uint64_t write_us_total = 0;
+    uint32_t latency_us_last = 0;
+    uint32_t latency_us_max = 0;
+};
+
+class StorageQueue
+{
+private:
+    enum SlotState : uint8_t
+    {
+        SLOT_FREE = 0,
+        SLOT_RESERVED, // between begin and commit
+        SLOT_PENDING,
+        SLOT_BUSY, // being written, data must stay
+    };
+
+    struct Slot
+    {
+        SlotState state = SLOT_FREE;
+        StorageMode mode = STORAGE_REPLACE;
+        char path[STORAGE_PATH_SIZE];
+        uint32_t offset = 0;
+        uint32_t sequence = 0; // submit order
+        uint32_t submit_us = 0;
+        size_t length = 0;
+        StorageCallback callback = nullptr;
+        void *context = nullptr;
+        alignas(4) uint8_t data[STORAGE_SLOT_SIZE];
+    };
+
+    Slot _slots[STORAGE_QUEUE_SLOTS];
+    uint32_t _sequence = 0;
+    int8_t _reserved = -1;
+    size_t _reservedStart = 0; // data before it belongs to merged requests
+    bool _reservedMerge = false;
+    StorageQueueStats _stats;
+
+    int8_t newest(const char *path) const;
+    uint8_t streamSlots() const;
+    void updateDepth();
+
+public:
+    // space for a request of at least min_length bytes, nullptr if no slot is free or the
+    // path is too long. The content is written to the returned pointer, up to capacity bytes,
+    // then commit or abort. One request at a time.
+    uint8_t *begin(const char *path, StorageMode mode, size_t min_length, size_t &capacity, uint32_t now_us);
+    void commit(size_t length, uint32_t offset = 0, StorageCallback callback = nullptr, void *context = nullptr);
+    void abort();
+
+    // begin, copy and commit. false if no slot is free or length > STORAGE_SLOT_SIZE
+    bool submit(const char *path, StorageMode mode, const uint8_t *data, size_t length, uint32_t now_us,
+                uint32_t offset = 0, StorageCallback callback = nullptr, void *context = nullptr);
+
+    // oldest pending request, its slot is busy until complete
+    bool next(StorageJob &job);
+    // frees the slot and fills the result for the callback, which runs after the slot is free
+    void complete(const StorageJob &job, bool ok, uint32_t write_us, uint32_t now_us, StorageResult &result,
+                  StorageCallback &callback, void *&context);
+
+    // latest content of a pending or busy replace of path, what a read after the write will see
+    bool latest(const char *path, const uint8_t *&data, size_t &length) const;
+
+    bool idle() const { return _stats.depth == 0; }
+    const StorageQueueStats &getStats() const { return _stats; }
+};
@@ -0,0 +1,236 @@
+#include <StorageWriter.hpp>
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+StorageWriter::~StorageWriter()
+{
+    close();
+}
+
+void StorageWriter::begin(const char *root)
+{
+    close();
+    snprintf(_root, sizeof(_root), "%s", root);
+}
+
+void StorageWriter::fullPath(char *out, const char *path, const char *suffix) const
+{
+    snprintf(out, STORAGE_FULL_PATH_SIZE, "%s%s%s", _root, path, suffix);
+}
+
+bool StorageWriter::execute(const StorageJob &job)
+{
+    bool ok;
+    switch (job.mode)
+    {
+    case STORAGE_REPLACE:
+        ok = replace(job.path, job.data, job.length);
+        break;
+    case STORAGE_APPEND:
+        ok = openStream(job.path, true) && append(job.data, job.length);
+        break;
+    case STORAGE_PATCH:
+        ok = openStream(job.path, false) && patch(job.offset, job.data, job.length) && sync();
+        break;
+    case STORAGE_CLOSE:
+        ok = strcmp(_streamPath, job.path) != 0 || close();
+        break;
+    default:
+        ok = false;
+        break;
+    }
+
+    if (!ok)
+        _stats.errors++;
+    return ok;
+}
+
+// fopen of a new file, creates the directory it is in if that is missing (one level)
+FILE *StorageWriter::create(const char *full, const char *mode)
+{
+    FILE *file = fopen(full, mode);
+    if (file)
+        return file;
+
+    char dir[STORAGE_FULL_PATH_SIZE];
+    snprintf(dir, sizeof(dir), "%s", full);
+    char *slash = strrchr(dir, '/');
+    if (!slash || (size_t)(slash - dir) <= strlen(_root))
+        return nullptr;
+    *slash = 0;
+    if (mkdir(dir, 0755) != 0)
+        return nullptr;
+    return fopen(full, mode);
+}
+
+// the stream for path, positioned on its last sector
+bool StorageWriter::openStream(const char *path, bool create)
+{
+    if (_stream && strcmp(_streamPath, path) == 0)
+        return true;
+    close();
+
+    char full[STORAGE_FULL_PATH_SIZE];
+    fullPath(full, path);
+    _stream = fopen(full, "r+b");
+    if (!_stream && create)
+        _stream = this->create(full, "w+b");
+    if (!_stream)
+        return false;
+    setvbuf(_stream, NULL, _IONBF, 0);
+    _stats.opens++;
+
+    if (fseek(_stream, 0, SEEK_END) != 0)
+    {
+        close();
+        return false;
+    }
+    uint32_t size = ftell(_stream);
+
+    // a partial last sector is staged again, the next write of the sector starts aligned
+    _sectorOffset = size - size % STORAGE_SECTOR_SIZE;
+    _staged = size % STORAGE_SECTOR_SIZE;
+    _flushed = _staged;
+    if (_staged > 0 && (fseek(_stream, _sectorOffset, SEEK_SET) != 0 || fread(_sector, 1, _staged, _stream) != _staged))
+    {
+        close();
+        return false;
+    }
+
+    strcpy(_streamPath, path);
+    return true;
+}
+
+bool StorageWriter::writeAt(uint32_t offset, const uint8_t *data, size_t length)
+{
+    if (fseek(_stream, offset, SEEK_SET) != 0 || fwrite(data, 1, length, _stream) != length)
+        return false;
+    _stats.bytes_written += length;
+    return true;
+}
+
+bool StorageWriter::append(const uint8_t *data, size_t length)
+{
+    while (length > 0)
+    {
+        size_t copy = STORAGE_SECTOR_SIZE - _staged;
+        copy = copy < length ? copy : length;
+        memcpy(_sector + _staged, data, copy);
+        _staged += copy;
+        data += copy;
+        length -= copy;
+
+        if (_staged == STORAGE_SECTOR_SIZE)
+        {
+            if (!writeAt(_sectorOffset, _sector, STORAGE_SECTOR_SIZE))
+                return false;
+            _stats.sector_writes++;
+            _sectorOffset += STORAGE_SECTOR_SIZE;
+            _staged = 0;
+            _flushed = 0;
+        }
+    }
+    return true;
+}
+
+// within the written file: sectors before the staged one directly, the staged one in the buffer
+bool StorageWriter::patch(uint32_t offset, const uint8_t *data, size_t length)
+{
+    if (offset + length > _sectorOffset + _staged)
+        return false;
+
+    if (offset < _sectorOffset)
+    {
+        size_t direct = _sectorOffset - offset;
+        direct = direct < length ? direct : length;
+        if (!writeAt(offset, data, direct))
+            return false;
+        _stats.patch_writes++;
+        offset += direct;
+        data += direct;
+        length -= direct;
+    }
+
+    if (length > 0)
+    {
+        size_t start = offset - _sectorOffset;
+        memcpy(_sector + start, data, length);
+        if (start < _flushed)
+            _flushed = start; // the patched bytes are written with the next flush
+    }
+    return true;
+}
+
+bool StorageWriter::replace(const char *path, const uint8_t *data, size_t length)
+{
+    if (_stream && strcmp(_streamPath, path) == 0)
+        close();
+
+    char full[STORAGE_FULL_PATH_SIZE];
+    char temp[STORAGE_FULL_PATH_SIZE];
+    fullPath(full, path);
+    fullPath(temp, path, ".tmp");
+
+    FILE *file = create(temp, "wb");
+    if (!file)
+        return false;
+    setvbuf(file, NULL, _IONBF, 0);
+    bool ok = fwrite(data, 1, length, file) == length;
+    ok &= fclose(file) == 0;
+    if (!ok)
+    {
+        remove(temp);
+        return false;
+    }
+    _stats.file_writes++;
+    _stats.bytes_written += length;
+
+    // FAT has no atomic replace, the old file goes first
+    remove(full);
+    return rename(temp, full) == 0;
+}
+
+bool StorageWriter::flush()
+{
+    if (!_stream || _staged == _flushed)
+        return true;
+
+    // from the start of the sector, the write stays aligned
+    if (!writeAt(_sectorOffset, _sector, _staged) || fsync(fileno(_stream)) != 0)
+    {
+        _stats.errors++;
+        return false;
+    }
+    _stats.tail_writes++;
+    _flushed = _staged;
+    return true;
+}
+
+// staged tail and file system buffers on the flash, a reader with its own handle sees the patch
+bool StorageWriter::sync()
+{
+    if (!flush())
+        return false;
+    if (fsync(fileno(_stream)) != 0)
+    {
+        _stats.errors++;
+        return false;
+    }
+    return true;
+}
+
+bool StorageWriter::close()
+{
+    if (!_stream)
+        return true;
+
+    bool ok = flush();
+    ok &= fclose(_stream) == 0;
+    _stream = nullptr;
+    _streamPath[0] = 0;
+    _staged = 0;
+    _flushed = 0;
+    return ok;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// Executes the requests of StorageQueue on the filesystem, in the storage task only.
+// Plain stdio without stdio buffering, so it works on host and on target (FFat is mounted in
+// the VFS at /ffat) and every fwrite reaches FatFs as issued.
+//
+// Appends to a file are staged in a buffer of one filesystem sector that maps to a sector
+// aligned file offset: a complete sector is written in one aligned write, which FatFs passes
+// to the wear levelling layer without a read-modify-write of its sector window. One file is
+// open for streaming at a time, a request for another path or STORAGE_CLOSE writes the
+// staged tail and closes it. flush() writes the tail earlier, the sector is written again
+// once complete. A patch is in the file when it completes, its owner may read it back (the
+// MQTT spool).
+//
+// A new file gets its missing parent directory, e.g. /config on a fresh filesystem.
+//
+// Replace writes <path>.tmp and renames it, a reader sees the old or the new content. A reset
+// between remove and rename leaves only the .tmp file, see BaseConfig::loadConfiguration.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <StorageQueue.hpp>
+
+#ifndef STORAGE_SECTOR_SIZE
+#define STORAGE_SECTOR_SIZE 4096 // FFat on wear levelling, CONFIG_WL_SECTOR_SIZE
+#endif
+#define STORAGE_ROOT_SIZE 32
+#define STORAGE_FULL_PATH_SIZE (STORAGE_ROOT_SIZE + STORAGE_PATH_SIZE + 4) // root, path, ".tmp"
+
+struct StorageWriterStats
+{
+    uint32_t sector_writes = 0; // whole sectors at aligned offsets
+    uint32_t tail_writes = 0;   // staged part of a sector, on close or flush
+    uint32_t file_writes = 0;   // replaced files
+    uint32_t patch_writes = 0;  // patches of already written sectors
+    uint32_t bytes_written = 0;
+    uint32_t opens = 0; // streams opened
+    uint32_t errors = 0;
+};
+
+class StorageWriter
+{
+private:
+    char _root[STORAGE_ROOT_SIZE] = "";
+
+    // stream of appends and patches
+    FILE *_stream = nullptr;
+    char _streamPath[STORAGE_PATH_SIZE] = "";
+    uint32_t _sectorOffset = 0; // file offset of _sector[0], sector aligned
+    size_t _staged = 0;         // bytes of the sector that belong to the file
+    size_t _flushed = 0;        // of these already written
+    alignas(4) uint8_t _sector[STORAGE_SECTOR_SIZE];
+
+    StorageWriterStats _stats;
+
+    void fullPath(char *out, const char *path, const char *suffix = "") const;
+    bool openStream(const char *path, bool create);
+    FILE *create(const char *full, const char *mode);
+    bool sync();
+    bool writeAt(uint32_t offset, const uint8_t *data, size_t length);
+    bool append(const uint8_t *data, size_t length);
+    bool patch(uint32_t offset, const uint8_t *data, size_t length);
+    bool replace(const char *path, const uint8_t *data, size_t length);
+
+public:
+    ~StorageWriter();
+
+    // directory the request paths are relative to, "/ffat" on target
+    void begin(const char *root);
+
+    bool execute(const StorageJob &job);
+
+    // writes the staged tail of the open stream, keeps it staged
+    bool flush();
+    // flush and close the open stream
+    bool close();
+
+    bool hasUnflushed() const { return _stream && _staged > _flushed; }
+    const StorageWriterStats &getStats() const { return _stats; }
+};
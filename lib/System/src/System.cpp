@@ -1,6 +1,7 @@
 #include <System.hpp>
 
 #define I2C_BUS_FREQUENCY 400000U
+#define WIFI_STA_CONNECT_TIMEOUT 15000U
 
 SystemClass g_System;
 
@@ -45,6 +46,8 @@ void SystemClass::initialize_filesystem()
     {
         Display::status_message("filesystem mounted successfully");
     }
+
+    // a missing CONFIG_DIR_PATH is created by the storage task with the first save
 }
 void SystemClass::initialize_wifi()
 {
@@ -53,11 +56,42 @@ void SystemClass::initialize_wifi()
 
     WiFi.hostname(system_config.hostname);
 
-    log_i("Setup accesspoint WiFi SSID '%s'", system_config.wifi_ap_ssid.c_str());
-
     if (WiFi.isConnected())
         WiFi.disconnect();
 
+    // STA connects in the background, update_loop falls back to AP if that fails
+    if (system_config.wifi_ap_mode || !initialize_wifi_sta())
+        initialize_wifi_ap();
+
+    log_i("Hostname: %s", WiFi.getHostname());
+
+    initialize_mdns();
+
+    Display::status_message("WiFi setup finished.");
+}
+
+bool SystemClass::initialize_wifi_sta()
+{
+    log_i("Connect to WiFi SSID '%s'", system_config.wifi_sta_ssid.c_str());
+
+    if (system_config.wifi_sta_ssid.length() == 0)
+        return false;
+
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(true);
+    WiFi.begin(system_config.wifi_sta_ssid.c_str(), system_config.wifi_sta_password.c_str());
+
+    _staConnectStart = millis();
+    _staConnecting = true;
+    return true;
+}
+
+void SystemClass::initialize_wifi_ap()
+{
+    log_i("Setup accesspoint WiFi SSID '%s'", system_config.wifi_ap_ssid.c_str());
+
+    WiFi.mode(WIFI_AP);
+
     IPAddress ip(192, 168, 22, 1);
     IPAddress gateway(192, 168, 22, 1);
     IPAddress subnet(255, 255, 255, 0);
@@ -75,9 +109,23 @@ void SystemClass::initialize_wifi()
     }
 
     log_i("IP-Address: %s", ip.toString().c_str());
-    log_i("Hostname: %s", WiFi.getHostname());
+}
 
-    Display::status_message("WiFi setup finished.");
+void SystemClass::initialize_mdns()
+{
+    // advertise <hostname>.local and the streaming service for discovery by aggregators
+    if (!MDNS.begin(system_config.hostname.c_str()))
+    {
+        log_e("mDNS responder setup failed");
+        return;
+    }
+
+    MDNS.addService("http", "tcp", 80);
+    MDNS.addService(MDNS_SERVICE, "tcp", 80);
+    MDNS.addServiceTxt(MDNS_SERVICE, "tcp", "events", "/events");
+    MDNS.addServiceTxt(MDNS_SERVICE, "tcp", "serial", system_config.serial);
+
+    log_i("mDNS responder started: %s.local", system_config.hostname.c_str());
 }
 
 void SystemClass::cbSaveConfiguration(void)
@@ -96,8 +144,24 @@ void SystemClass::postConfigChange(void)
     // do not reinit wifi, since if would disconnect the client - shall only be called on reset or save config initialize_wifi();
 }
 
+// follows the STA connect started by initialize_wifi_sta, the display shows the ip once connected
 void SystemClass::update_loop()
 {
+    if (!_staConnecting)
+        return;
+
+    if (WiFi.status() == WL_CONNECTED)
+    {
+        _staConnecting = false;
+        log_i("IP-Address: %s", WiFi.localIP().toString().c_str());
+    }
+    else if (millis() - _staConnectStart >= WIFI_STA_CONNECT_TIMEOUT)
+    {
+        _staConnecting = false;
+        log_w("STA connection failed; falling back to AP mode.");
+        WiFi.disconnect(true);
+        initialize_wifi_ap();
+    }
 }
 
 void SystemClass::printFilesystemFiles()
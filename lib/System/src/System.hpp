@@ -3,14 +3,19 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include <WiFi.h>
+#include <ESPmDNS.h>
 #include <FFat.h>
 #include <ConfigStructs.hpp>
 #include <Display.hpp>
 
+#define MDNS_SERVICE "sgbox" // _sgbox._tcp
+
 class SystemClass
 {
 private:
     // WiFi config;
+    bool _staConnecting = false; // initialize_wifi_sta started, update_loop waits for the connection
+    uint32_t _staConnectStart = 0;
 
 public:
     SystemConfig system_config = SystemConfig("system.json");
@@ -21,6 +26,9 @@ public:
     void initialize_i2c();
     void initialize_filesystem();
     void initialize_wifi();
+    bool initialize_wifi_sta();
+    void initialize_wifi_ap();
+    void initialize_mdns();
 
     void cbSaveConfiguration(void);
     void cbLoadConfiguration(void);
@@ -0,0 +1,133 @@
+#include <Trace.hpp>
+
+TraceClass g_Trace;
+
+static const char *point_names[TRACE_POINT_COUNT] = {"adc_read", "filter", "display", "sse", "serial", "alarm"};
+
+uint32_t LatencyHistogram::percentile(float fraction) const
+{
+    if (count == 0)
+        return 0;
+
+    uint32_t target = (uint32_t)(fraction * count + 0.5f);
+    uint32_t cumulative = 0;
+    for (uint8_t i = 0; i < TRACE_HISTOGRAM_BUCKETS; i++)
+    {
+        cumulative += buckets[i];
+        if (cumulative >= target)
+        {
+            uint32_t edge = (2UL << i) - 1;
+            return edge < max_us ? edge : max_us;
+        }
+    }
+    return max_us;
+}
+
+TraceClass::TraceClass()
+{
+    // on init construct with default variables
+}
+
+const char *TraceClass::getPointName(uint8_t point)
+{
+    return point < TRACE_POINT_COUNT ? point_names[point] : "unknown";
+}
+
+void TraceClass::setEnabled(bool enabled)
+{
+    portENTER_CRITICAL(&_mux);
+    if (enabled && !_enabled)
+    {
+        for (LatencyHistogram &histogram : _histograms)
+            histogram = LatencyHistogram();
+        _written = 0;
+    }
+    _enabled = enabled;
+    portEXIT_CRITICAL(&_mux);
+
+    log_i("latency trace %s", enabled ? "enabled" : "disabled");
+}
+
+void TraceClass::record(TracePoint point, uint32_t sample_us)
+{
+    if (!_enabled || point >= TRACE_POINT_COUNT || sample_us == 0)
+        return;
+
+    uint32_t latency_us = micros() - sample_us;
+
+    uint8_t bucket = latency_us ? 31 - __builtin_clz(latency_us) : 0;
+    if (bucket >= TRACE_HISTOGRAM_BUCKETS)
+        bucket = TRACE_HISTOGRAM_BUCKETS - 1;
+
+    portENTER_CRITICAL(&_mux);
+
+    LatencyHistogram &histogram = _histograms[point];
+    if (histogram.count == 0 || latency_us < histogram.min_us)
+        histogram.min_us = latency_us;
+    if (latency_us > histogram.max_us)
+        histogram.max_us = latency_us;
+    histogram.sum_us += latency_us;
+    histogram.count++;
+    histogram.buckets[bucket]++;
+
+    TraceRecord &entry = _ring[_written % TRACE_RING_SIZE];
+    entry.sample_us = sample_us;
+    entry.latency_us = latency_us;
+    entry.point = point;
+    _written++;
+
+    portEXIT_CRITICAL(&_mux);
+}
+
+LatencyHistogram TraceClass::getHistogram(TracePoint point)
+{
+    LatencyHistogram histogram;
+    if (point >= TRACE_POINT_COUNT)
+        return histogram;
+
+    portENTER_CRITICAL(&_mux);
+    histogram = _histograms[point];
+    portEXIT_CRITICAL(&_mux);
+
+    return histogram;
+}
+
+void TraceClass::printChromeTrace(Print &out)
+{
+    out.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    // one track per trace point
+    for (uint8_t i = 0; i < TRACE_POINT_COUNT; i++)
+        out.printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", i ? "," : "", i, point_names[i]);
+
+    // copy in small chunks, the critical section must stay short. records overwritten
+    // meanwhile are skipped
+    TraceRecord chunk[TRACE_PRINT_CHUNK];
+
+    portENTER_CRITICAL(&_mux);
+    uint32_t end = _written;
+    uint32_t index = end > TRACE_RING_SIZE ? end - TRACE_RING_SIZE : 0;
+    portEXIT_CRITICAL(&_mux);
+
+    while (true)
+    {
+        size_t n = 0;
+
+        portENTER_CRITICAL(&_mux);
+        if (_written > TRACE_RING_SIZE && index < _written - TRACE_RING_SIZE)
+            index = _written - TRACE_RING_SIZE;
+        while (index < end && n < TRACE_PRINT_CHUNK)
+            chunk[n++] = _ring[index++ % TRACE_RING_SIZE];
+        portEXIT_CRITICAL(&_mux);
+
+        if (n == 0)
+            break;
+
+        // complete events spanning from sample data ready to output
+        for (size_t i = 0; i < n; i++)
+            out.printf(",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%u,\"dur\":%u}",
+                       point_names[chunk[i].point], chunk[i].point, chunk[i].sample_us, chunk[i].latency_us);
+    }
+
+    out.print("]}");
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define TRACE_HISTOGRAM_BUCKETS 24 // log2 buckets in us, last one is >= 8.4 s
+#define TRACE_RING_SIZE 256
+#define TRACE_PRINT_CHUNK 32
+
+// where a sample (identified by its data ready timestamp in us) left the system
+enum TracePoint : uint8_t
+{
+    TRACE_ADC_READ = 0, // value read from the ADC
+    TRACE_FILTER,       // converted and filtered
+    TRACE_DISPLAY,      // shown on the OLED (after sendBuffer)
+    TRACE_SSE,          // written to an event stream client
+    TRACE_SERIAL,       // written to the serial stream
+    TRACE_ALARM,        // alarm output GPIO changed
+    TRACE_POINT_COUNT
+};
+
+struct LatencyHistogram
+{
+    uint32_t buckets[TRACE_HISTOGRAM_BUCKETS] = {0}; // bucket i: [2^i, 2^(i+1)) us, bucket 0 also holds 0
+    uint32_t count = 0;
+    uint32_t min_us = 0;
+    uint32_t max_us = 0;
+    uint64_t sum_us = 0;
+
+    // upper bucket edge the given fraction of the samples is below, clamped to max_us
+    uint32_t percentile(float fraction) const;
+};
+
+struct TraceRecord
+{
+    uint32_t sample_us; // data ready timestamp of the sample
+    uint32_t latency_us;
+    uint8_t point;
+};
+
+/// Sample-to-output latency tracing. Outputs report the data ready timestamp of the sample
+/// they just emitted, latency is measured against micros() at that moment.
+/// Disabled by default, record() is a single flag check then. Any task may record.
+class TraceClass
+{
+private:
+    volatile bool _enabled = false;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+    LatencyHistogram _histograms[TRACE_POINT_COUNT];
+
+    TraceRecord _ring[TRACE_RING_SIZE];
+    uint32_t _written = 0; // total records, ring index is _written % TRACE_RING_SIZE
+
+public:
+    TraceClass();
+
+    static const char *getPointName(uint8_t point);
+
+    // enabling also clears histograms and ring
+    void setEnabled(bool enabled);
+    bool isEnabled() { return _enabled; }
+
+    void record(TracePoint point, uint32_t sample_us);
+
+    LatencyHistogram getHistogram(TracePoint point);
+
+    // raw records in Chrome trace event format (chrome://tracing, ui.perfetto.dev)
+    void printChromeTrace(Print &out);
+};
+
+extern TraceClass g_Trace;
@@ -0,0 +1,59 @@
+#pragma once
+
+// What the api handlers need from the box: commands, config documents, readings and the
+// streamed data sets. The firmware implements it on the modules and the event manager
+// (FirmwareApiBackend), the host tools on a simulated acquisition.
+// Portable, no Arduino dependencies.
+
+#include <ApiTypes.hpp>
+#include <LoadcellPipeline.hpp>
+#include <SpectrumAnalyzer.hpp>
+
+enum ApiCommand : uint8_t
+{
+    API_CMD_RESTART = 0,
+    API_CMD_TARE,
+    API_CMD_LOAD_CONFIG,
+    API_CMD_SAVE_CONFIG,
+    API_CMD_CAPTURE_START,
+    API_CMD_CAPTURE_STOP,
+    API_CMD_CAPTURE_CATALOG,
+    API_CMD_ALARM_ACK,
+    API_CMD_RESET_STATS,
+    API_CMD_TEMP_LEARN, // arg "start,<load>" or "stop"
+    API_CMD_TRACE,      // arg "0" or "1"
+    API_CMD_CALIBRATE,  // arg known reference value
+    API_CMD_COUNT,
+};
+
+class ApiBackend
+{
+public:
+    virtual ~ApiBackend() {}
+
+    // false if the command was not accepted. Commands run async in the owning task, true
+    // means queued, not done
+    virtual bool command(ApiCommand command, const char *arg) = 0;
+
+    // document of all config groups as GET /api/config returns it
+    virtual void writeConfig(ApiSink &out) = 0;
+    // POST /api/config body, only the groups and fields present are changed. false: not json
+    virtual bool applyConfig(const char *json, size_t length) = 0;
+
+    virtual PipelineStats getStats() = 0;
+    virtual PipelineParams getPipelineParams() = 0;
+
+    // {"points":[[t_ms,min,max,mean],..],"level":n,"samples_per_point":n}
+    virtual void writeHistory(ApiSink &out, uint32_t from_ms, uint32_t to_ms, size_t points) = 0;
+    // oldest and newest stored timestamp, the open ends of a history query. false if empty
+    virtual bool getHistoryRange(uint32_t &oldest_ms, uint32_t &newest_ms) = 0;
+
+    // averaged amplitude spectrum and its analysis task, only if hasSpectrum()
+    virtual bool hasSpectrum() { return false; }
+    virtual void writeSpectrum(ApiSink &out, size_t bins) {}
+    virtual SpectrumStatus getSpectrumStatus() { return SpectrumStatus(); }
+    // points and averages are checked against getSpectrumStatus() by the handler. Async like
+    // the commands, true means queued
+    virtual bool configureSpectrum(bool enable, uint16_t points, uint16_t averages, bool sse) { return false; }
+    virtual bool benchmarkSpectrum() { return false; }
+};
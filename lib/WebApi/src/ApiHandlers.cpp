@@ -0,0 +1,294 @@
+#include <ApiHandlers.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <JsonWriter.hpp>
+
+#define API_STATUS_BUFFER 768
+
+namespace ApiHandlers
+{
+    static ApiRouter *router = nullptr;
+
+    static void sendResult(ApiResponse &response, bool ok)
+    {
+        if (ok)
+            response.send(200, "text/plain", "OK");
+        else
+            response.send(400, "text/plain", "request error");
+    }
+
+    // small json documents are built on the stack and sent in one piece
+    static void sendJson(ApiResponse &response, const BufferSink &json)
+    {
+        if (json.overflow())
+            response.send(500, "text/plain", "response too large");
+        else
+            response.send(200, "application/json", json.c_str(), json.length());
+    }
+
+    template <ApiCommand COMMAND>
+    static void handleCommand(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        sendResult(response, backend.command(COMMAND, ""));
+    }
+
+    static void handleRestart(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        // respond before the restart takes the connection down
+        response.send(200, "text/plain", "OK");
+        backend.command(API_CMD_RESTART, "");
+    }
+
+    static void handleTempLearn(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        const char *action = request.param("action");
+        if (action && strcmp(action, "start") == 0)
+        {
+            char arg[40];
+            const char *load = request.param("load");
+            snprintf(arg, sizeof(arg), "start,%s", load ? load : "0");
+            sendResult(response, backend.command(API_CMD_TEMP_LEARN, arg));
+        }
+        else if (action && strcmp(action, "stop") == 0)
+            sendResult(response, backend.command(API_CMD_TEMP_LEARN, "stop"));
+        else
+            sendResult(response, false);
+    }
+
+    static void handleTrace(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        const char *enable = request.param("enable");
+        if (!enable)
+        {
+            response.send(400, "text/plain", "parameter enable missing");
+            return;
+        }
+        sendResult(response, backend.command(API_CMD_TRACE, atoi(enable) != 0 ? "1" : "0"));
+    }
+
+    static void handleCalibrate(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        const char *known = request.param("knownValue", true);
+        if (!known)
+        {
+            response.send(400, "text/plain", "parameter knownValue missing");
+            return;
+        }
+        sendResult(response, backend.command(API_CMD_CALIBRATE, known));
+    }
+
+    static void handleConfigGet(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        ApiSink *out = response.beginStream(200, "application/json");
+        backend.writeConfig(*out);
+    }
+
+    static void handleConfigSet(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        if (backend.applyConfig(request.body(), request.bodyLength()))
+            response.send(200, "application/json", "{\"status\":\"OK\"}");
+        else
+            response.send(400, "application/json", "{\"error\":\"invalid json\"}");
+    }
+
+    static void handleHistory(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        const char *from = request.param("from");
+        const char *to = request.param("to");
+        const char *points = request.param("points");
+        size_t count = points ? atoi(points) : 500;
+        // millis() timestamps wrap, open ends are the stored range and not 0 and UINT32_MAX.
+        // A range that ends before it starts returns no points
+        uint32_t oldest_ms = 0, newest_ms = 0;
+        backend.getHistoryRange(oldest_ms, newest_ms);
+        uint32_t from_ms = from ? strtoul(from, NULL, 10) : oldest_ms;
+        uint32_t to_ms = to ? strtoul(to, NULL, 10) : newest_ms;
+
+        if (count == 0)
+        {
+            sendResult(response, false);
+            return;
+        }
+
+        ApiSink *out = response.beginStream(200, "application/json");
+        backend.writeHistory(*out, from_ms, to_ms, count);
+    }
+
+    static void handleSpectrum(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        const char *bins = request.param("bins");
+        size_t count = bins ? atoi(bins) : 512;
+        if (count == 0)
+        {
+            sendResult(response, false);
+            return;
+        }
+        if (!backend.hasSpectrum())
+        {
+            response.send(404, "text/plain", "spectrum not available");
+            return;
+        }
+
+        ApiSink *out = response.beginStream(200, "application/json");
+        backend.writeSpectrum(*out, count);
+    }
+
+    // parameters not given keep the running analysis settings
+    static void handleSpectrumCommand(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        if (!backend.hasSpectrum())
+        {
+            response.send(404, "text/plain", "spectrum not available");
+            return;
+        }
+        if (request.param("bench"))
+        {
+            sendResult(response, backend.benchmarkSpectrum());
+            return;
+        }
+        const char *enable = request.param("enable");
+        if (!enable)
+        {
+            response.send(400, "text/plain", "parameter enable missing");
+            return;
+        }
+
+        SpectrumStatus status = backend.getSpectrumStatus();
+        const char *points_param = request.param("points");
+        const char *averages_param = request.param("averages");
+        const char *sse_param = request.param("sse");
+        long points = points_param ? atol(points_param) : (status.points ? status.points : SPECTRUM_DEFAULT_POINTS);
+        long averages = averages_param ? atol(averages_param) : (status.averages ? status.averages : SPECTRUM_DEFAULT_AVERAGES);
+        bool sse = sse_param ? atoi(sse_param) != 0 : status.sse;
+        if (points < 0 || !SpectrumAnalyzer::validPoints(points) || points > status.max_points || averages <= 0 || averages > SPECTRUM_MAX_AVERAGES)
+        {
+            sendResult(response, false);
+            return;
+        }
+        sendResult(response, backend.configureSpectrum(atoi(enable) != 0, points, averages, sse));
+    }
+
+    static void handleSpectrumStatus(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        if (!backend.hasSpectrum())
+        {
+            response.send(404, "text/plain", "spectrum not available");
+            return;
+        }
+        SpectrumStatus status = backend.getSpectrumStatus();
+
+        char buffer[API_STATUS_BUFFER];
+        BufferSink sink(buffer, sizeof(buffer));
+        JsonWriter json(sink);
+        json.beginObject();
+        json.add("enabled", status.enabled);
+        json.add("sse", status.sse);
+        json.add("points", status.points);
+        json.add("averages", status.averages);
+        json.add("max_points", status.max_points);
+        json.add("sample_rate", status.sample_rate);
+        json.add("frames", status.frames);
+        json.add("results", status.results);
+        json.add("overruns", status.overruns);
+        json.add("compute_us_last", status.compute_us_last);
+        json.add("compute_us_max", status.compute_us_max);
+        json.add("compute_us_mean", status.compute_us_mean);
+        json.beginObject("bench_us");
+        for (uint8_t i = 0; i < SPECTRUM_SIZES; i++)
+        {
+            char points[8];
+            snprintf(points, sizeof(points), "%u", SPECTRUM_MIN_POINTS << i);
+            if (status.bench_us[i] > 0)
+                json.add(points, status.bench_us[i]);
+        }
+        json.endObject();
+        json.endObject();
+        sendJson(response, sink);
+    }
+
+    static void handleGlitchStatus(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        PipelineStats stats = backend.getStats();
+        GlitchParams params = backend.getPipelineParams().glitch;
+
+        char buffer[API_STATUS_BUFFER];
+        BufferSink sink(buffer, sizeof(buffer));
+        JsonWriter json(sink);
+        json.beginObject();
+        json.add("enabled", params.enabled);
+        json.add("samples", stats.count);
+        json.add("read_errors", stats.glitch_read_errors);
+        json.add("saturations", stats.glitch_saturations);
+        json.add("steps", stats.glitch_steps);
+        json.add("outliers", stats.glitch_outliers);
+        json.add("substituted", stats.glitch_substituted);
+        json.add("last_reason", stats.last_glitch_reason);
+        json.add("last_timestamp_us", stats.last_glitch_timestamp_us);
+        json.add("k", params.k);
+        json.add("window", params.window);
+        json.add("min_deviation", params.min_deviation);
+        json.add("max_step", params.max_step);
+        json.add("max_consecutive", params.max_consecutive);
+        json.endObject();
+        sendJson(response, sink);
+    }
+
+    static void handleApiStatus(const ApiRequest &request, ApiResponse &response, ApiBackend &backend)
+    {
+        const ApiRouterStats &stats = router->getStats();
+
+        // one object per route, streamed: the table grows with the api
+        ApiSink *out = response.beginStream(200, "application/json");
+        JsonWriter json(*out);
+        json.beginObject();
+        json.add("requests", stats.requests);
+        json.add("not_found", stats.not_found);
+        json.add("rejected_sends", stats.rejected_sends);
+        json.add("missing_responses", stats.missing_responses);
+        json.beginArray("routes");
+        for (uint8_t i = 0; i < router->getRouteCount(); i++)
+        {
+            const ApiRoute &route = router->getRoute(i);
+            json.beginObject();
+            json.add("path", route.path);
+            json.add("methods", route.methods);
+            json.add("requests", route.stats.requests);
+            json.add("errors", route.stats.errors);
+            json.add("time_us_total", route.stats.time_us_total);
+            json.add("time_us_max", route.stats.time_us_max);
+            json.add("time_us_mean", route.stats.requests ? route.stats.time_us_total / route.stats.requests : 0u);
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    }
+
+    bool registerRoutes(ApiRouter &apiRouter)
+    {
+        router = &apiRouter;
+
+        bool ok = true;
+        ok &= router->on(API_GET, "/api/cmd/restart", handleRestart);
+        ok &= router->on(API_GET, "/api/cmd/tare", handleCommand<API_CMD_TARE>);
+        ok &= router->on(API_GET, "/api/cmd/loadconfiguration", handleCommand<API_CMD_LOAD_CONFIG>);
+        ok &= router->on(API_GET, "/api/cmd/saveconfiguration", handleCommand<API_CMD_SAVE_CONFIG>);
+        ok &= router->on(API_GET, "/api/cmd/capturestart", handleCommand<API_CMD_CAPTURE_START>);
+        ok &= router->on(API_GET, "/api/cmd/capturestop", handleCommand<API_CMD_CAPTURE_STOP>);
+        ok &= router->on(API_GET, "/api/cmd/capturecatalog", handleCommand<API_CMD_CAPTURE_CATALOG>);
+        ok &= router->on(API_GET, "/api/cmd/alarmack", handleCommand<API_CMD_ALARM_ACK>);
+        ok &= router->on(API_GET, "/api/cmd/resetstats", handleCommand<API_CMD_RESET_STATS>);
+        ok &= router->on(API_GET, "/api/cmd/templearn", handleTempLearn);
+        ok &= router->on(API_GET, "/api/cmd/trace", handleTrace);
+        ok &= router->on(API_POST, "/api/cmd/calibrateknownreference", handleCalibrate);
+        ok &= router->on(API_GET, "/api/cmd/spectrum", handleSpectrumCommand);
+        ok &= router->on(API_GET, "/api/config", handleConfigGet);
+        ok &= router->on(API_POST | API_PUT | API_PATCH, "/api/config", handleConfigSet);
+        ok &= router->on(API_GET, "/api/history", handleHistory);
+        ok &= router->on(API_GET, "/api/spectrum", handleSpectrum);
+        ok &= router->on(API_GET, "/status/glitch", handleGlitchStatus);
+        ok &= router->on(API_GET, "/status/spectrum", handleSpectrumStatus);
+        ok &= router->on(API_GET, "/status/api", handleApiStatus);
+        return ok;
+    }
+}
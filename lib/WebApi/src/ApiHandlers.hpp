@@ -0,0 +1,27 @@
+#pragma once
+
+// Handlers of the web api routes that do not depend on the http server or on Arduino:
+//
+// GET  /api/cmd/restart, tare, loadconfiguration, saveconfiguration, capturestart,
+//      capturestop, capturecatalog, alarmack, resetstats
+// GET  /api/cmd/templearn?action=start[&load=<known load>] or action=stop
+// GET  /api/cmd/trace?enable=0|1
+// POST /api/cmd/calibrateknownreference     form field knownValue
+// GET  /api/config                          all config groups
+// POST /api/config (PUT, PATCH)             json body with the groups to change
+// GET  /api/history?from=<ms>&to=<ms>&points=<n>
+// GET  /api/spectrum?bins=<n>
+// GET  /api/cmd/spectrum?enable=0|1[&points=<256..4096>][&averages=<n>][&sse=0|1] or bench=1
+// GET  /status/spectrum                     analysis task: compute time, overruns, benchmark
+// GET  /status/glitch                       glitch rejection counters and thresholds
+// GET  /status/api                          requests, errors and handler time per route
+//
+// Portable, no Arduino dependencies.
+
+#include <ApiRouter.hpp>
+
+namespace ApiHandlers
+{
+    // adds all routes above, false if the route table is full
+    bool registerRoutes(ApiRouter &router);
+}
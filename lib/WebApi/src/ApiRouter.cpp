@@ -0,0 +1,81 @@
+#include <ApiRouter.hpp>
+
+#include <strings.h>
+
+ApiRouter::ApiRouter()
+{
+    // on init construct with default variables
+}
+
+void ApiRouter::begin(ApiBackend &backend, ApiClock clock)
+{
+    _backend = &backend;
+    _clock = clock;
+}
+
+bool ApiRouter::on(uint8_t methods, const char *path, ApiHandler handler)
+{
+    if (_count >= API_MAX_ROUTES)
+        return false;
+
+    ApiRoute &route = _routes[_count++];
+    route.methods = methods;
+    route.path = path;
+    route.handler = handler;
+    return true;
+}
+
+int8_t ApiRouter::indexOf(ApiMethod method, const char *path) const
+{
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        if ((_routes[i].methods & method) && strcmp(_routes[i].path, path) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const ApiRoute *ApiRouter::find(ApiMethod method, const char *path) const
+{
+    int8_t index = indexOf(method, path);
+    return index < 0 ? nullptr : &_routes[index];
+}
+
+void ApiRouter::dispatch(const ApiRequest &request, ApiResponse &response)
+{
+    _stats.requests++;
+
+    int8_t index = indexOf(request.method(), request.path());
+    if (index < 0 || !_backend)
+    {
+        _stats.not_found++;
+
+        const char *type = request.header("content-type");
+        if (type && strcasecmp(type, "application/json") == 0)
+            response.send(404, "application/json", "{\"error\":\"not found\"}");
+        else
+            response.send(404, "text/plain", "Not found");
+        response.finish();
+        return;
+    }
+
+    ApiRoute *route = &_routes[index];
+    uint32_t start_us = _clock ? _clock() : 0;
+    route->handler(request, response, *_backend);
+
+    if (!response.sent())
+    {
+        _stats.missing_responses++;
+        response.send(500, "text/plain", "no response");
+    }
+    response.finish();
+    _stats.rejected_sends += response.rejected();
+
+    uint32_t elapsed_us = _clock ? _clock() - start_us : 0;
+    route->stats.requests++;
+    if (response.status() >= 400)
+        route->stats.errors++;
+    route->stats.time_us_total += elapsed_us;
+    if (elapsed_us > route->stats.time_us_max)
+        route->stats.time_us_max = elapsed_us;
+}
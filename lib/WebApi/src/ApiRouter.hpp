@@ -0,0 +1,70 @@
+#pragma once
+
+// Route table and dispatch of the web api. Handlers are plain functions on ApiRequest,
+// ApiResponse and ApiBackend, the same on the device and on the host. Counts requests,
+// errors and handler time per route, and requests with no or more than one response.
+// dispatch() is not reentrant: the firmware calls it from the AsyncTCP task only, host
+// adapters serialize it.
+// Portable, no Arduino dependencies.
+
+#include <ApiTypes.hpp>
+#include <ApiBackend.hpp>
+
+#define API_MAX_ROUTES 32
+
+typedef void (*ApiHandler)(const ApiRequest &request, ApiResponse &response, ApiBackend &backend);
+typedef uint32_t (*ApiClock)(); // us, may wrap
+
+struct ApiRouteStats
+{
+    uint32_t requests = 0;
+    uint32_t errors = 0; // status 400 and above
+    uint32_t time_us_total = 0;
+    uint32_t time_us_max = 0;
+};
+
+struct ApiRoute
+{
+    uint8_t methods = 0; // ApiMethod mask
+    const char *path = nullptr;
+    ApiHandler handler = nullptr;
+    ApiRouteStats stats;
+};
+
+struct ApiRouterStats
+{
+    uint32_t requests = 0;
+    uint32_t not_found = 0;
+    uint32_t rejected_sends = 0; // handler responded more than once, later responses dropped
+    uint32_t missing_responses = 0; // handler returned without response, answered with 500
+};
+
+class ApiRouter
+{
+private:
+    ApiRoute _routes[API_MAX_ROUTES];
+    uint8_t _count = 0;
+    ApiBackend *_backend = nullptr;
+    ApiClock _clock = nullptr;
+    ApiRouterStats _stats;
+
+    int8_t indexOf(ApiMethod method, const char *path) const;
+
+public:
+    ApiRouter();
+
+    void begin(ApiBackend &backend, ApiClock clock);
+
+    // path without query string, exact match. false if the table is full
+    bool on(uint8_t methods, const char *path, ApiHandler handler);
+
+    // nullptr if no route matches path and method
+    const ApiRoute *find(ApiMethod method, const char *path) const;
+
+    // handler of the route or the not found response, exactly one response
+    void dispatch(const ApiRequest &request, ApiResponse &response);
+
+    uint8_t getRouteCount() const { return _count; }
+    const ApiRoute &getRoute(uint8_t index) const { return _routes[index]; }
+    const ApiRouterStats &getStats() const { return _stats; }
+};
@@ -0,0 +1,53 @@
+#include <ApiTypes.hpp>
+
+size_t BufferSink::write(const char *data, size_t length)
+{
+    size_t space = _size - 1 - _length;
+    if (length > space)
+    {
+        length = space;
+        _overflow = true;
+    }
+    memcpy(_buffer + _length, data, length);
+    _length += length;
+    _buffer[_length] = 0;
+    return length;
+}
+
+bool ApiResponse::send(int status, const char *type, const char *body)
+{
+    return send(status, type, body, strlen(body));
+}
+
+bool ApiResponse::send(int status, const char *type, const char *body, size_t length)
+{
+    if (sent())
+    {
+        _rejected++;
+        return false;
+    }
+    _status = status;
+    doSend(status, type, body, length);
+    return true;
+}
+
+ApiSink *ApiResponse::beginStream(int status, const char *type)
+{
+    if (sent())
+    {
+        _rejected++;
+        return nullptr;
+    }
+    _status = status;
+    _streaming = true;
+    return &doBeginStream(status, type);
+}
+
+void ApiResponse::finish()
+{
+    if (_streaming)
+    {
+        _streaming = false;
+        doFinish();
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+// Request and response of the web api, independent of the http server. The firmware adapts
+// AsyncWebServer to these (WebApiHandler), the host tools a small POSIX server.
+// Portable, no Arduino dependencies.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+enum ApiMethod : uint8_t
+{
+    API_NONE = 0, // HEAD, OPTIONS and unknown methods: no route accepts it, answered not found
+    API_GET = 1,
+    API_POST = 2,
+    API_PUT = 4,
+    API_PATCH = 8,
+    API_DELETE = 16,
+};
+
+// output of a streamed response or of a json document
+class ApiSink
+{
+public:
+    virtual ~ApiSink() {}
+    virtual size_t write(const char *data, size_t length) = 0;
+    size_t print(const char *text) { return write(text, strlen(text)); }
+};
+
+// fixed buffer, for small responses built before sending. Cut off text sets overflow
+class BufferSink : public ApiSink
+{
+private:
+    char *_buffer;
+    size_t _size;
+    size_t _length = 0;
+    bool _overflow = false;
+
+public:
+    BufferSink(char *buffer, size_t size) : _buffer(buffer), _size(size) { _buffer[0] = 0; }
+
+    size_t write(const char *data, size_t length) override;
+
+    const char *c_str() const { return _buffer; }
+    size_t length() const { return _length; }
+    bool overflow() const { return _overflow; }
+};
+
+class ApiRequest
+{
+public:
+    virtual ~ApiRequest() {}
+
+    virtual ApiMethod method() const = 0;
+    // without query string
+    virtual const char *path() const = 0;
+    // query parameter, or form field of the body if post. nullptr if missing
+    virtual const char *param(const char *name, bool post = false) const = 0;
+    // nullptr if missing, names are case insensitive
+    virtual const char *header(const char *name) const = 0;
+    // raw body of POST, PUT and PATCH requests that are not forms, "" without
+    virtual const char *body() const = 0;
+    virtual size_t bodyLength() const = 0;
+
+    bool hasParam(const char *name, bool post = false) const { return param(name, post) != nullptr; }
+};
+
+// exactly one response per request: send() or beginStream() once, later calls are dropped
+// and counted as rejected, the router answers requests a handler left without response
+class ApiResponse
+{
+private:
+    int _status = 0;
+    bool _streaming = false;
+    uint8_t _rejected = 0;
+
+protected:
+    virtual void doSend(int status, const char *type, const char *body, size_t length) = 0;
+    virtual ApiSink &doBeginStream(int status, const char *type) = 0;
+    // complete a streamed response
+    virtual void doFinish() {}
+
+public:
+    virtual ~ApiResponse() {}
+
+    bool send(int status, const char *type, const char *body);
+    bool send(int status, const char *type, const char *body, size_t length);
+    // sink for the body, nullptr if a response was sent already
+    ApiSink *beginStream(int status, const char *type);
+    // called by the router after the handler returned
+    void finish();
+
+    bool sent() const { return _status != 0; }
+    int status() const { return _status; }
+    uint8_t rejected() const { return _rejected; }
+};
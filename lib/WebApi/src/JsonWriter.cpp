@@ -0,0 +1,127 @@
+#include <JsonWriter.hpp>
+
+#include <math.h>
+#include <stdio.h>
+
+JsonWriter::JsonWriter(ApiSink &out) : _out(out)
+{
+    _first[0] = true;
+}
+
+void JsonWriter::key(const char *key)
+{
+    if (!_first[_depth])
+        _out.write(",", 1);
+    _first[_depth] = false;
+
+    if (key)
+    {
+        string(key);
+        _out.write(":", 1);
+    }
+}
+
+void JsonWriter::string(const char *text)
+{
+    _out.write("\"", 1);
+    const char *start = text;
+    for (const char *c = text; *c; c++)
+    {
+        if (*c != '"' && *c != '\\' && (uint8_t)*c >= 0x20)
+            continue;
+
+        _out.write(start, c - start);
+        char escaped[8];
+        switch (*c)
+        {
+        case '"':
+            _out.write("\\\"", 2);
+            break;
+        case '\\':
+            _out.write("\\\\", 2);
+            break;
+        case '\n':
+            _out.write("\\n", 2);
+            break;
+        default:
+            _out.write(escaped, snprintf(escaped, sizeof(escaped), "\\u%04x", (uint8_t)*c));
+        }
+        start = c + 1;
+    }
+    _out.print(start);
+    _out.write("\"", 1);
+}
+
+void JsonWriter::open(const char *name, char bracket)
+{
+    if (_depth > 0 || !_first[0])
+        key(name);
+    _out.write(&bracket, 1);
+
+    // handlers nest far less than JSON_WRITER_DEPTH, deeper levels are not tracked
+    if (_depth < JSON_WRITER_DEPTH - 1)
+        _depth++;
+    _first[_depth] = true;
+}
+
+void JsonWriter::close(char bracket)
+{
+    _out.write(&bracket, 1);
+    if (_depth > 0)
+        _depth--;
+}
+
+void JsonWriter::add(const char *name, const char *value)
+{
+    key(name);
+    if (value)
+        string(value);
+    else
+        _out.write("null", 4);
+}
+
+void JsonWriter::add(const char *name, bool value)
+{
+    key(name);
+    _out.print(value ? "true" : "false");
+}
+
+void JsonWriter::add(const char *name, long value)
+{
+    char text[24];
+    key(name);
+    _out.write(text, snprintf(text, sizeof(text), "%ld", value));
+}
+
+void JsonWriter::add(const char *name, unsigned long value)
+{
+    char text[24];
+    key(name);
+    _out.write(text, snprintf(text, sizeof(text), "%lu", value));
+}
+
+void JsonWriter::add(const char *name, float value)
+{
+    char text[24];
+    key(name);
+    if (isfinite(value))
+        _out.write(text, snprintf(text, sizeof(text), "%.7g", value));
+    else
+        _out.write("null", 4);
+}
+
+void JsonWriter::add(const char *name, double value)
+{
+    char text[32];
+    key(name);
+    if (isfinite(value))
+        _out.write(text, snprintf(text, sizeof(text), "%.10g", value));
+    else
+        _out.write("null", 4);
+}
+
+void JsonWriter::addRaw(const char *name, const char *json)
+{
+    key(name);
+    _out.print(json);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Streaming json encoder for the api handlers. Writes straight to an ApiSink, no document in
+// memory and no heap, nesting and commas are tracked per level.
+// Portable, no Arduino dependencies.
+
+#include <ApiTypes.hpp>
+
+#define JSON_WRITER_DEPTH 8
+
+class JsonWriter
+{
+private:
+    ApiSink &_out;
+    uint8_t _depth = 0;
+    bool _first[JSON_WRITER_DEPTH];
+
+    void key(const char *key);
+    void string(const char *text);
+    void open(const char *key, char bracket);
+    void close(char bracket);
+
+public:
+    JsonWriter(ApiSink &out);
+
+    // key is nullptr inside arrays and for the outermost object
+    void beginObject(const char *key = nullptr) { open(key, '{'); }
+    void endObject() { close('}'); }
+    void beginArray(const char *key = nullptr) { open(key, '['); }
+    void endArray() { close(']'); }
+
+    void add(const char *key, const char *value);
+    void add(const char *key, bool value);
+    // int32_t is long on some toolchains, all integer types resolve to one of these
+    void add(const char *key, long value);
+    void add(const char *key, unsigned long value);
+    void add(const char *key, int value) { add(key, (long)value); }
+    void add(const char *key, unsigned int value) { add(key, (unsigned long)value); }
+    // NAN and infinity are written as null
+    void add(const char *key, float value);
+    void add(const char *key, double value);
+    // already encoded json
+    void addRaw(const char *key, const char *json);
+};
@@ -0,0 +1,412 @@
+#include <CaptureDownload.hpp>
+
+#include <memory>
+#include <ArduinoJson.h>
+#include <JsonPool.hpp>
+#include <LoadcellPipeline.hpp>
+#include <CaptureCatalog.hpp>
+#include <SampleCodec.hpp>
+#include <Capture.hpp>
+
+namespace CaptureDownload
+{
+    DownloadStats stats;
+
+    struct DownloadState
+    {
+        File file;
+        size_t bytes = 0;
+        uint32_t start_ms = millis();
+
+        // csv conversion
+        LoadcellPipeline pipeline;
+        bool derived = false;
+        uint8_t encoding = CAPTURE_ENCODING_RAW;
+        std::unique_ptr<uint8_t[]> block; // encoded captures, one SampleCodec block
+        CaptureSample samples[CAPTURE_BLOCK_SAMPLES];
+        size_t samples_count = 0;
+        size_t samples_pos = 0;
+        char line[80];
+        size_t line_len = 0;
+        size_t line_pos = 0;
+
+        ~DownloadState()
+        {
+            file.close();
+
+            uint32_t duration_ms = millis() - start_ms;
+            stats.active--;
+            stats.bytes_total += bytes;
+            stats.last_kbytes_per_sec = duration_ms ? (float)bytes / duration_ms : 0;
+
+            log_i("download finished: %u bytes in %u ms, %.1f KB/s", bytes, duration_ms, stats.last_kbytes_per_sec);
+        }
+    };
+
+    DownloadStats getStats()
+    {
+        return stats;
+    }
+
+    // only plain file names in the capture dir are accepted
+    bool validFilename(const String &name)
+    {
+        return name.length() > 0 && name.indexOf('/') < 0 && name.indexOf("..") < 0 && name.endsWith(CAPTURE_FILE_EXTENSION);
+    }
+
+    struct ListState
+    {
+        File index;
+        String sensor;
+        CatalogFilter filter;
+        uint32_t offset = 0;
+        uint32_t limit = 0;
+        uint32_t matched = 0;
+        uint32_t sent = 0;
+        bool done = false;
+        CatalogRecord records[LIST_READ_RECORDS];
+        size_t records_count = 0;
+        size_t records_pos = 0;
+        char line[384];
+        size_t line_len = 0;
+        size_t line_pos = 0;
+
+        ~ListState()
+        {
+            index.close();
+        }
+    };
+
+    float paramFloat(AsyncWebServerRequest *request, const char *name)
+    {
+        return request->hasParam(name) ? request->getParam(name)->value().toFloat() : NAN;
+    }
+
+    uint32_t paramUInt(AsyncWebServerRequest *request, const char *name, uint32_t fallback)
+    {
+        return request->hasParam(name) ? (uint32_t)request->getParam(name)->value().toInt() : fallback;
+    }
+
+    // one json element per record, separated by commas
+    size_t formatRecord(ListState &state, const CatalogRecord &record)
+    {
+        char name[24];
+        catalogFilename(name, sizeof(name), record.file_index);
+        // min and max are NAN for captures without samples, json has no NAN
+        char min[16] = "null", max[16] = "null";
+        if (!isnan(record.min))
+            snprintf(min, sizeof(min), "%.6g", record.min);
+        if (!isnan(record.max))
+            snprintf(max, sizeof(max), "%.6g", record.max);
+
+        return snprintf(state.line, sizeof(state.line),
+                        "%s{\"name\":\"%s\",\"size\":%u,\"index\":%u,\"start_millis\":%u,\"duration_ms\":%u,\"samples\":%u,\"sample_rate\":%.6g,"
+                        "\"min\":%s,\"max\":%s,\"unit\":\"%s\",\"sensor\":\"%s\",\"serial\":\"%s\",\"data_offset\":%u,\"closed\":%s}",
+                        state.sent ? "," : "", name, record.file_size, record.file_index, record.start_millis, record.duration_ms, record.sample_count, record.sample_rate,
+                        min, max, record.displayunit, record.sensor_name, record.sensor_serial, record.data_offset, (record.flags & CATALOG_CLOSED) ? "true" : "false");
+    }
+
+    void handleList(AsyncWebServerRequest *request)
+    {
+        std::shared_ptr<ListState> state = std::make_shared<ListState>();
+
+        state->index = FFat.open(CATALOG_FILE, FILE_READ);
+        CatalogHeader header;
+        if (!state->index || state->index.read((uint8_t *)&header, sizeof(header)) != sizeof(header) || !catalogHeaderValid(header))
+        {
+            // no captures yet, or the catalogue is being rebuilt
+            request->send(200, "application/json", "{\"captures\":[],\"matched\":0}");
+            return;
+        }
+
+        if (request->hasParam("sensor"))
+        {
+            state->sensor = request->getParam("sensor")->value();
+            state->filter.sensor = state->sensor.c_str();
+        }
+        state->filter.min_samples = paramUInt(request, "min_samples", 0);
+        state->filter.min_peak = paramFloat(request, "min_peak");
+        state->filter.max_peak = paramFloat(request, "max_peak");
+        state->filter.from_index = paramUInt(request, "from", 0);
+        state->filter.to_index = paramUInt(request, "to", UINT32_MAX);
+        state->offset = paramUInt(request, "offset", 0);
+        state->limit = paramUInt(request, "limit", 0);
+
+        state->line_len = snprintf(state->line, sizeof(state->line), "{\"captures\":[");
+
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json", [state](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+                                                                         {
+            size_t len = 0;
+            maxLen = min(maxLen, (size_t)DOWNLOAD_MAX_CHUNK);
+
+            while (len < maxLen)
+            {
+                // flush pending line
+                if (state->line_pos < state->line_len)
+                {
+                    size_t copy = min(maxLen - len, state->line_len - state->line_pos);
+                    memcpy(buffer + len, state->line + state->line_pos, copy);
+                    len += copy;
+                    state->line_pos += copy;
+                    continue;
+                }
+                if (state->done)
+                    break;
+                state->line_len = 0;
+                state->line_pos = 0;
+
+                // next record, refill from the index in small blocks, a partial record at the end is being appended
+                if (state->records_pos == state->records_count)
+                {
+                    state->records_count = state->index.read((uint8_t *)state->records, sizeof(state->records)) / sizeof(CatalogRecord);
+                    state->records_pos = 0;
+                    if (state->records_count == 0)
+                    {
+                        state->line_len = snprintf(state->line, sizeof(state->line), "],\"matched\":%u}", state->matched);
+                        state->done = true;
+                        continue;
+                    }
+                }
+
+                const CatalogRecord &record = state->records[state->records_pos++];
+                if (!state->filter.matches(record))
+                    continue;
+                if (state->matched++ < state->offset || (state->limit && state->sent >= state->limit))
+                    continue;
+                state->line_len = formatRecord(*state, record);
+                state->sent++;
+            }
+
+            return len; });
+
+        request->send(response);
+    }
+
+    // digits only, at least one. false for signs, spaces or trailing text
+    bool parseNumber(const char *text, size_t length, size_t &value)
+    {
+        if (length == 0)
+            return false;
+
+        value = 0;
+        for (size_t i = 0; i < length; i++)
+        {
+            if (text[i] < '0' || text[i] > '9')
+                return false;
+            value = value * 10 + (text[i] - '0');
+        }
+        return true;
+    }
+
+    // parse a single range (RFC 7233): "bytes=start-end", "bytes=start-" or the suffix
+    // "bytes=-length" (the last length bytes). Returns false for malformed specs, multiple
+    // ranges and ranges that are not satisfiable, e.g. any range of an empty file
+    bool parseRange(const String &header, size_t size, size_t &start, size_t &end)
+    {
+        if (!header.startsWith("bytes=") || size == 0)
+            return false;
+
+        const char *spec = header.c_str() + 6;
+        const char *dash = strchr(spec, '-');
+        if (dash == nullptr)
+            return false;
+
+        size_t first_len = dash - spec;
+        size_t last_len = strlen(dash + 1);
+
+        if (first_len == 0)
+        {
+            size_t suffix;
+            if (!parseNumber(dash + 1, last_len, suffix) || suffix == 0)
+                return false;
+            start = suffix < size ? size - suffix : 0;
+            end = size - 1;
+            return true;
+        }
+
+        if (!parseNumber(spec, first_len, start))
+            return false;
+        end = size - 1;
+        if (last_len)
+        {
+            size_t last;
+            if (!parseNumber(dash + 1, last_len, last) || last < start)
+                return false;
+            end = last < end ? last : end;
+        }
+        return start < size;
+    }
+
+    void sendRaw(AsyncWebServerRequest *request, std::shared_ptr<DownloadState> state, const String &name)
+    {
+        size_t size = state->file.size();
+        size_t start = 0;
+        size_t end = size ? size - 1 : 0;
+        bool partial = false;
+
+        if (request->hasHeader("Range"))
+        {
+            if (!parseRange(request->header("Range"), size, start, end))
+            {
+                AsyncWebServerResponse *response = request->beginResponse(416);
+                response->addHeader("Content-Range", "bytes */" + String(size));
+                request->send(response);
+                return;
+            }
+            partial = true;
+        }
+
+        state->file.seek(start);
+        size_t length = size ? end - start + 1 : 0;
+
+        AsyncWebServerResponse *response = request->beginResponse("application/octet-stream", length, [state, start, length](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+                                                                  {
+            if (index >= length)
+                return 0;
+            if (state->file.position() != start + index)
+                state->file.seek(start + index);
+
+            size_t len = min(min(maxLen, (size_t)DOWNLOAD_MAX_CHUNK), length - index);
+            len = state->file.read(buffer, len);
+            state->bytes += len;
+            return len; });
+
+        response->addHeader("Accept-Ranges", "bytes");
+        response->addHeader("Content-Disposition", "attachment; filename=\"" + name + "\"");
+        if (partial)
+        {
+            response->setCode(206);
+            response->addHeader("Content-Range", "bytes " + String(start) + "-" + String(end) + "/" + String(size));
+        }
+        request->send(response);
+    }
+
+    void sendCsv(AsyncWebServerRequest *request, std::shared_ptr<DownloadState> state, const String &name)
+    {
+        CaptureHeader header;
+        if (state->file.read((uint8_t *)&header, sizeof(header)) != sizeof(header) || header.magic != CAPTURE_MAGIC)
+        {
+            request->send(422, "text/plain", "not a capture file");
+            return;
+        }
+
+        PipelineParams params;
+        params.sensor_scale_factor = header.sensor_scale_factor;
+        params.sensor_zero_balance_raw = header.sensor_zero_balance_raw;
+        if (request->hasParam("rate_window"))
+            params.derived.rate_window = request->getParam("rate_window")->value().toInt();
+        state->pipeline.configure(params);
+        state->derived = request->hasParam("derived") && request->getParam("derived")->value().toInt() != 0;
+
+        // resume at sample index
+        size_t first = request->hasParam("start") ? request->getParam("start")->value().toInt() : 0;
+        size_t skip = 0;
+        state->encoding = captureEncoding(header);
+        if (state->encoding == CAPTURE_ENCODING_RAW)
+            state->file.seek(header.header_size + first * sizeof(CaptureSample));
+        else
+        {
+            // skip whole blocks by their headers, then the samples before first in the block
+            state->block.reset(new uint8_t[CODEC_MAX_BLOCK_SIZE(CAPTURE_BLOCK_SAMPLES)]);
+            size_t position = header.header_size;
+            CodecBlockHeader block;
+            while (state->file.seek(position) && state->file.read((uint8_t *)&block, sizeof(block)) == sizeof(block) &&
+                   SampleCodec::headerValid(block) && block.first_index + block.sample_count <= first)
+                position += sizeof(block) + block.payload_size;
+            state->file.seek(position);
+            if (first > block.first_index)
+                skip = first - block.first_index;
+        }
+
+        if (first == 0)
+            state->line_len = snprintf(state->line, sizeof(state->line), state->derived ? "timestamp_us,raw,%s,rate,impulse\n" : "timestamp_us,raw,%s\n", header.displayunit);
+
+        AsyncWebServerResponse *response = request->beginChunkedResponse("text/csv", [state, skip](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t
+                                                                         {
+            size_t len = 0;
+            maxLen = min(maxLen, (size_t)DOWNLOAD_MAX_CHUNK);
+
+            while (len < maxLen)
+            {
+                // flush pending line
+                if (state->line_pos < state->line_len)
+                {
+                    size_t copy = min(maxLen - len, state->line_len - state->line_pos);
+                    memcpy(buffer + len, state->line + state->line_pos, copy);
+                    len += copy;
+                    state->line_pos += copy;
+                    continue;
+                }
+
+                // next sample, refill from file in small blocks or one encoded block
+                if (state->samples_pos >= state->samples_count)
+                {
+                    if (state->encoding == CAPTURE_ENCODING_RAW)
+                        state->samples_count = state->file.read((uint8_t *)state->samples, DOWNLOAD_CSV_READ_SAMPLES * sizeof(CaptureSample)) / sizeof(CaptureSample);
+                    else
+                    {
+                        File &file = state->file;
+                        auto read = [&file](uint8_t *buffer, size_t length)
+                        { return file.read(buffer, length); };
+                        state->samples_count = SampleCodec::readBlock(read, state->block.get(), CODEC_MAX_BLOCK_SIZE(CAPTURE_BLOCK_SAMPLES), state->samples, CAPTURE_BLOCK_SAMPLES);
+                    }
+                    state->samples_pos = skip;
+                    skip = 0;
+                    if (state->samples_pos >= state->samples_count)
+                        break;
+                }
+
+                const CaptureSample &sample = state->samples[state->samples_pos++];
+                if (state->derived)
+                {
+                    // full pipeline for the timestamps, same derived values as in the acquisition
+                    state->pipeline.process(sample.raw, sample.timestamp_us);
+                    const DerivedChannels &derived = state->pipeline.getDerived();
+                    state->line_len = snprintf(state->line, sizeof(state->line), "%u,%d,%.6g,%.6g,%.6g\n", sample.timestamp_us, sample.raw, state->pipeline.getConverted(), derived.getRate(), derived.getImpulse());
+                }
+                else
+                    state->line_len = snprintf(state->line, sizeof(state->line), "%u,%d,%.6g\n", sample.timestamp_us, sample.raw, state->pipeline.convert(sample.raw));
+                state->line_pos = 0;
+            }
+
+            state->bytes += len;
+            return len; });
+
+        String csvName = name.substring(0, name.lastIndexOf('.')) + ".csv";
+        response->addHeader("Content-Disposition", "attachment; filename=\"" + csvName + "\"");
+        request->send(response);
+    }
+
+    void handleDownload(AsyncWebServerRequest *request)
+    {
+        if (!request->hasParam("file"))
+        {
+            request->send(400, "text/plain", "parameter file missing");
+            return;
+        }
+
+        String name = request->getParam("file")->value();
+        if (!validFilename(name))
+        {
+            request->send(400, "text/plain", "invalid file name");
+            return;
+        }
+
+        File file = FFat.open(String(CAPTURE_DIR) + name, FILE_READ);
+        if (!file || file.isDirectory())
+        {
+            request->send(404, "text/plain", "Not found");
+            return;
+        }
+
+        std::shared_ptr<DownloadState> state = std::make_shared<DownloadState>();
+        state->file = file;
+        stats.downloads++;
+        stats.active++;
+
+        if (request->hasParam("format") && request->getParam("format")->value() == "csv")
+            sendCsv(request, state, name);
+        else
+            sendRaw(request, state, name);
+    }
+}
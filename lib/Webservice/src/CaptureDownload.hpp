@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <FFat.h>
+#include <CaptureFormat.hpp>
+
+#define DOWNLOAD_MAX_CHUNK 2048 // limit time spent per AsyncTCP callback
+#define DOWNLOAD_CSV_READ_SAMPLES 32
+#define LIST_READ_RECORDS 8
+
+struct DownloadStats
+{
+    uint32_t downloads = 0;
+    uint32_t active = 0;
+    uint32_t bytes_total = 0;
+    float last_kbytes_per_sec = 0;
+};
+
+/// Streams capture files from FFat. Files are read chunk by chunk in the response filler,
+/// so neither the whole file nor the converted csv is ever held in RAM.
+///
+/// GET /api/captures                              list closed captures from the catalogue index, see CaptureCatalog
+///                 [?sensor=S][&min_samples=N]      substring of sensor name or serial, minimum samples
+///                 [&min_peak=X][&max_peak=X]       range of the maximum in displayunit
+///                 [&from=I][&to=I]                 range of the file index
+///                 [&offset=N][&limit=N]            page of the matching records, "matched" counts all
+/// GET /api/captures/download?file=cap_00001.sgc  file as stored, supports Range: bytes=start-[end]
+///                                                 (header encoding, see CaptureFormat)
+///                          &format=csv[&start=N] decoded and converted to csv on the fly, resume at sample N
+///                          &derived=1[&rate_window=N] adds rate and impulse columns, both start
+///                                                 over at the resume sample
+namespace CaptureDownload
+{
+    void handleList(AsyncWebServerRequest *request);
+    void handleDownload(AsyncWebServerRequest *request);
+
+    DownloadStats getStats();
+}
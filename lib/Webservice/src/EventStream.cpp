@@ -0,0 +1,194 @@
+#include <EventStream.hpp>
+
+#define EVENTSTREAM_RETRY_MS 1000
+
+namespace EventStream
+{
+    class SseTransport : public FanoutTransport
+    {
+    public:
+        virtual bool canSend(void *client, size_t len) override
+        {
+            AsyncClient *c = (AsyncClient *)client;
+            return c->connected() && c->canSend() && c->space() >= len;
+        }
+        virtual bool send(void *client, const char *buffer, size_t len) override
+        {
+            return ((AsyncClient *)client)->write(buffer, len) == len;
+        }
+        virtual void delivered(void *client, const FanoutEvent &event) override
+        {
+            g_Trace.record(TRACE_SSE, event.source_us);
+        }
+    };
+
+    SseTransport transport;
+    EventFanout fanout(transport);
+    SemaphoreHandle_t mutex = NULL;
+
+    void initialize()
+    {
+        mutex = xSemaphoreCreateMutex();
+
+        // known channels, unknown ones are registered on first publish
+        fanout.registerChannel("ping", true);
+        fanout.registerChannel("reading", true);
+        fanout.registerChannel("force", true);
+        fanout.registerChannel("battery", true);
+        fanout.registerChannel("message", false);
+        fanout.registerChannel(SAMPLEBLOCK_CHANNEL, false);
+    }
+
+    void publish(const char *channel, const char *data, uint32_t source_us)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+
+        int8_t index = fanout.findChannel(channel);
+        if (index < 0)
+            index = fanout.registerChannel(channel, true);
+        if (index >= 0)
+        {
+            fanout.publish(index, data, millis(), source_us);
+            fanout.service(millis());
+        }
+
+        xSemaphoreGive(mutex);
+    }
+
+    bool hasSubscribers(const char *channel)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        int8_t index = fanout.findChannel(channel);
+        bool subscribed = index >= 0 && fanout.hasSubscribers(index);
+        xSemaphoreGive(mutex);
+
+        return subscribed;
+    }
+
+    FanoutMetrics getMetrics()
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        FanoutMetrics metrics = fanout.getMetrics();
+        xSemaphoreGive(mutex);
+
+        return metrics;
+    }
+
+    void onConnect(AsyncWebServerRequest *request)
+    {
+        AsyncClient *client = request->client();
+
+        uint32_t lastId = 0;
+        if (request->hasHeader("Last-Event-ID"))
+            lastId = atoi(request->header("Last-Event-ID").c_str());
+        else if (request->hasParam("lastId"))
+            lastId = atoi(request->getParam("lastId")->value().c_str());
+
+        uint32_t interval = 0;
+        if (request->hasParam("interval"))
+            interval = atoi(request->getParam("interval")->value().c_str());
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+
+        // the sample blocks only by name, a page subscribing to everything would not keep up
+        uint32_t mask = request->hasParam("fields") ? fanout.channelMask(request->getParam("fields")->value().c_str())
+                                                    : FANOUT_ALL_CHANNELS & ~(1UL << fanout.findChannel(SAMPLEBLOCK_CHANNEL));
+        bool added = fanout.addClient(client, lastId, mask, interval);
+
+        xSemaphoreGive(mutex);
+
+        client->setRxTimeout(0);
+        client->onError(NULL, NULL);
+        client->onData(NULL, NULL);
+        client->onAck([](void *r, AsyncClient *c, size_t len, uint32_t time)
+                      {
+            xSemaphoreTake(mutex, portMAX_DELAY);
+            fanout.service(c, millis());
+            xSemaphoreGive(mutex); },
+                      NULL);
+        client->onPoll([](void *r, AsyncClient *c)
+                       {
+            xSemaphoreTake(mutex, portMAX_DELAY);
+            fanout.service(c, millis());
+            xSemaphoreGive(mutex); },
+                       NULL);
+        client->onTimeout([](void *r, AsyncClient *c, uint32_t time)
+                          { c->close(true); },
+                          NULL);
+        client->onDisconnect([](void *r, AsyncClient *c)
+                             {
+            xSemaphoreTake(mutex, portMAX_DELAY);
+            fanout.removeClient(c);
+            xSemaphoreGive(mutex);
+            delete c; },
+                             NULL);
+
+        if (!added)
+        {
+            log_w("event stream: too many clients, rejected");
+            client->close(true);
+            return;
+        }
+
+        if (lastId)
+            log_i("Client reconnected! Last message ID that it got is: %u", lastId);
+
+        String greeting = "retry: " + String(EVENTSTREAM_RETRY_MS) + "\ndata: init event session\n\n";
+        client->write(greeting.c_str(), greeting.length());
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        fanout.service(client, millis());
+        xSemaphoreGive(mutex);
+    }
+
+    class EventStreamResponse : public AsyncWebServerResponse
+    {
+    public:
+        EventStreamResponse()
+        {
+            _code = 200;
+            _contentType = "text/event-stream";
+            _sendContentLength = false;
+            addHeader("Cache-Control", "no-cache");
+            addHeader("Connection", "keep-alive");
+        }
+
+        void _respond(AsyncWebServerRequest *request)
+        {
+            String out = _assembleHead(request->version());
+            request->client()->write(out.c_str(), _headLength);
+            _state = RESPONSE_WAIT_ACK;
+        }
+
+        size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time)
+        {
+            if (len)
+            {
+                // take over the connection, request (and this response) are deleted afterwards
+                onConnect(request);
+                delete request;
+            }
+            return 0;
+        }
+
+        bool _sourceValid() const { return true; }
+    };
+}
+
+EventStreamHandler::EventStreamHandler(const char *url) : _url(url)
+{
+}
+
+bool EventStreamHandler::canHandle(AsyncWebServerRequest *request)
+{
+    if (request->method() != HTTP_GET || request->url() != _url)
+        return false;
+
+    request->addInterestingHeader("Last-Event-ID");
+    return true;
+}
+
+void EventStreamHandler::handleRequest(AsyncWebServerRequest *request)
+{
+    request->send(new EventStream::EventStreamResponse());
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <AsyncTCP.h>
+#include <EventFanout.hpp>
+#include <SampleBlock.hpp>
+#include <Trace.hpp>
+
+/// Server sent events with per client queues on top of EventFanout.
+/// Each client takes over its AsyncClient (like AsyncEventSource does) and is serviced
+/// on ack/poll, so one slow client only fills its own queue.
+///
+/// subscription by query parameters: /events?fields=force,battery&interval=500
+/// the "samples" channel (SampleEvents) is sent only if named in fields
+/// reconnect replay by Last-Event-ID header (sent by the browser automatically) or ?lastId=
+class EventStreamHandler : public AsyncWebHandler
+{
+private:
+    String _url;
+
+public:
+    EventStreamHandler(const char *url);
+
+    virtual bool canHandle(AsyncWebServerRequest *request) override final;
+    virtual void handleRequest(AsyncWebServerRequest *request) override final;
+};
+
+namespace EventStream
+{
+    void initialize();
+
+    // thread safe, may be called from any task. source_us: data ready timestamp of the
+    // sample the value is derived from, for latency tracing
+    void publish(const char *channel, const char *data, uint32_t source_us = 0);
+    // a client takes the channel
+    bool hasSubscribers(const char *channel);
+    FanoutMetrics getMetrics();
+}
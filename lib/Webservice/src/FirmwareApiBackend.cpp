@@ -0,0 +1,186 @@
+#include <FirmwareApiBackend.hpp>
+
+#include <ArduinoJson.h>
+#include <JsonPool.hpp>
+#include <DataEvent.hpp>
+#include <System.hpp>   // -->g_System
+#include <Loadcell.hpp> // -->g_Loadcell
+#include <History.hpp>  // -->g_History
+#include <Trace.hpp>    // -->g_Trace
+#include <Mqtt.hpp>     // -->g_Mqtt
+#include <Alarm.hpp>    // -->g_Alarm
+#include <Spectrum.hpp> // -->g_Spectrum
+#include <Storage.hpp>  // -->g_Storage
+
+using namespace esp32m;
+
+// Print on top of an ApiSink, for the modules that print their json themselves
+class SinkPrint : public Print
+{
+private:
+    ApiSink &_sink;
+
+public:
+    SinkPrint(ApiSink &sink) : _sink(sink) {}
+    size_t write(uint8_t c) override { return _sink.write((const char *)&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override { return _sink.write((const char *)buffer, size); }
+};
+
+static void publish(const char *name)
+{
+    // send event to inform other modules to action
+    Event ev(name);
+    EventManager::instance().publish(ev);
+}
+
+static void publish(const char *name, const String &data)
+{
+    DataEvent ev(name, data);
+    EventManager::instance().publish(ev);
+}
+
+// in Task_Storage, the web server does not wait for the file reads behind a flash write
+static void loadConfiguration(void *context)
+{
+    g_System.cbLoadConfiguration();
+    g_Loadcell.cbLoadConfiguration();
+    g_Mqtt.cbLoadConfiguration();
+    g_Alarm.cbLoadConfiguration();
+}
+
+bool FirmwareApiBackend::command(ApiCommand command, const char *arg)
+{
+    switch (command)
+    {
+    case API_CMD_RESTART:
+        ESP.restart();
+        return true;
+    case API_CMD_TARE:
+        publish("Loadcell/tare");
+        return true;
+    case API_CMD_LOAD_CONFIG:
+        return g_Storage.defer(loadConfiguration);
+    case API_CMD_SAVE_CONFIG:
+        g_System.cbSaveConfiguration();
+        g_Loadcell.cbSaveConfiguration();
+        g_Mqtt.cbSaveConfiguration();
+        g_Alarm.cbSaveConfiguration();
+        return true;
+    case API_CMD_CAPTURE_START:
+        publish("Capture/start");
+        return true;
+    case API_CMD_CAPTURE_STOP:
+        publish("Capture/stop");
+        return true;
+    case API_CMD_CAPTURE_CATALOG:
+        publish("Capture/rebuildCatalog");
+        return true;
+    case API_CMD_ALARM_ACK:
+        publish("Alarm/acknowledge");
+        return true;
+    case API_CMD_RESET_STATS:
+        publish("Loadcell/resetstats");
+        return true;
+    case API_CMD_TEMP_LEARN:
+        publish("Loadcell/tempLearn", arg);
+        return true;
+    case API_CMD_TRACE:
+        g_Trace.setEnabled(strcmp(arg, "1") == 0);
+        return true;
+    case API_CMD_CALIBRATE:
+        publish("Loadcell/calibrateToKnownValue", arg);
+        return true;
+    default:
+        return false;
+    }
+}
+
+void FirmwareApiBackend::writeConfig(ApiSink &out)
+{
+    PooledJsonDocument response_json(6144);
+    PooledJsonDocument system = PooledJsonDocument(1024);
+    PooledJsonDocument sensor = PooledJsonDocument(1024);
+    PooledJsonDocument adc = PooledJsonDocument(1024);
+    PooledJsonDocument mqtt = PooledJsonDocument(1024);
+    PooledJsonDocument alarm = PooledJsonDocument(MAX_DOCUMENT_SIZE);
+
+    g_System.system_config.toDoc(system);
+    g_Loadcell.sensor_config.toDoc(sensor);
+    g_Loadcell.adc_config.toDoc(adc);
+    g_Mqtt.mqtt_config.toDoc(mqtt);
+    g_Alarm.alarm_config.toDoc(alarm);
+
+    // https://arduino.stackexchange.com/a/94216
+    response_json[F("system")] = system;
+    response_json[F("sensor")] = sensor;
+    response_json[F("adc")] = adc;
+    response_json[F("mqtt")] = mqtt;
+    response_json[F("alarm")] = alarm;
+
+    SinkPrint print(out);
+    serializeJson(response_json, print);
+}
+
+bool FirmwareApiBackend::applyConfig(const char *json, size_t length)
+{
+    PooledJsonDocument doc(JSON_POOL_LARGE_SIZE);
+    DeserializationError error = deserializeJson(doc, json, length);
+    if (error)
+    {
+        log_e("config from web: %s", error.c_str());
+        return false;
+    }
+
+    g_System.system_config.fromWeb(doc["system"]);
+    // only what differs is reapplied, e.g. a new displayunit keeps the adc running
+    g_Loadcell.configFromWeb(doc["sensor"], doc["adc"]);
+    g_Mqtt.mqtt_config.fromWeb(doc["mqtt"]);
+    g_Mqtt.postConfigChange();
+    g_Alarm.configFromWeb(doc["alarm"]);
+    return true;
+}
+
+PipelineStats FirmwareApiBackend::getStats()
+{
+    return g_Loadcell.getStats();
+}
+
+PipelineParams FirmwareApiBackend::getPipelineParams()
+{
+    return g_Loadcell.getPipelineParams();
+}
+
+void FirmwareApiBackend::writeHistory(ApiSink &out, uint32_t from_ms, uint32_t to_ms, size_t points)
+{
+    SinkPrint print(out);
+    g_History.printJson(print, from_ms, to_ms, points);
+}
+
+bool FirmwareApiBackend::getHistoryRange(uint32_t &oldest_ms, uint32_t &newest_ms)
+{
+    return g_History.getRange(oldest_ms, newest_ms);
+}
+
+void FirmwareApiBackend::writeSpectrum(ApiSink &out, size_t bins)
+{
+    SinkPrint print(out);
+    g_Spectrum.printJson(print, bins);
+}
+
+SpectrumStatus FirmwareApiBackend::getSpectrumStatus()
+{
+    return g_Spectrum.getStatus();
+}
+
+bool FirmwareApiBackend::configureSpectrum(bool enable, uint16_t points, uint16_t averages, bool sse)
+{
+    log_i("webserver spectrum triggered");
+    g_Spectrum.cmdConfigure(enable, points, averages, sse);
+    return true;
+}
+
+bool FirmwareApiBackend::benchmarkSpectrum()
+{
+    g_Spectrum.cmdBenchmark();
+    return true;
+}
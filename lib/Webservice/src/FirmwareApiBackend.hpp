@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ApiBackend.hpp>
+
+/// ApiBackend of the box: commands become events for the owning tasks as before, config
+/// documents and readings come from the modules.
+class FirmwareApiBackend : public ApiBackend
+{
+public:
+    bool command(ApiCommand command, const char *arg) override;
+
+    void writeConfig(ApiSink &out) override;
+    bool applyConfig(const char *json, size_t length) override;
+
+    PipelineStats getStats() override;
+    PipelineParams getPipelineParams() override;
+
+    void writeHistory(ApiSink &out, uint32_t from_ms, uint32_t to_ms, size_t points) override;
+    bool getHistoryRange(uint32_t &oldest_ms, uint32_t &newest_ms) override;
+
+    bool hasSpectrum() override { return true; }
+    void writeSpectrum(ApiSink &out, size_t bins) override;
+    SpectrumStatus getSpectrumStatus() override;
+    bool configureSpectrum(bool enable, uint16_t points, uint16_t averages, bool sse) override;
+    bool benchmarkSpectrum() override;
+};
@@ -0,0 +1,155 @@
+#include <WebApiHandler.hpp>
+
+// request body collected by handleBody, owned by the request (_tempObject is freed with it)
+struct WebApiBody
+{
+    size_t length;
+    char data[1];
+};
+
+static ApiMethod toApiMethod(WebRequestMethodComposite method)
+{
+    switch (method)
+    {
+    case HTTP_GET:
+        return API_GET;
+    case HTTP_POST:
+        return API_POST;
+    case HTTP_PUT:
+        return API_PUT;
+    case HTTP_PATCH:
+        return API_PATCH;
+    case HTTP_DELETE:
+        return API_DELETE;
+    default:
+        return API_NONE;
+    }
+}
+
+class AsyncApiRequest : public ApiRequest
+{
+private:
+    AsyncWebServerRequest *_request;
+
+public:
+    AsyncApiRequest(AsyncWebServerRequest *request) : _request(request) {}
+
+    ApiMethod method() const override { return toApiMethod(_request->method()); }
+    const char *path() const override { return _request->url().c_str(); }
+
+    const char *param(const char *name, bool post) const override
+    {
+        AsyncWebParameter *param = _request->getParam(name, post);
+        return param ? param->value().c_str() : nullptr;
+    }
+
+    const char *header(const char *name) const override
+    {
+        AsyncWebHeader *header = _request->getHeader(name);
+        return header ? header->value().c_str() : nullptr;
+    }
+
+    const char *body() const override
+    {
+        WebApiBody *body = (WebApiBody *)_request->_tempObject;
+        return body ? body->data : "";
+    }
+
+    size_t bodyLength() const override
+    {
+        WebApiBody *body = (WebApiBody *)_request->_tempObject;
+        return body ? body->length : 0;
+    }
+};
+
+class PrintSink : public ApiSink
+{
+private:
+    Print *_print = nullptr;
+
+public:
+    void setPrint(Print *print) { _print = print; }
+    size_t write(const char *data, size_t length) override { return _print->write((const uint8_t *)data, length); }
+};
+
+class AsyncApiResponse : public ApiResponse
+{
+private:
+    AsyncWebServerRequest *_request;
+    AsyncResponseStream *_stream = nullptr;
+    PrintSink _sink;
+
+protected:
+    void doSend(int status, const char *type, const char *body, size_t length) override
+    {
+        // copied, the body may live on the handler stack
+        AsyncResponseStream *response = _request->beginResponseStream(type);
+        response->setCode(status);
+        response->write((const uint8_t *)body, length);
+        _request->send(response);
+    }
+
+    ApiSink &doBeginStream(int status, const char *type) override
+    {
+        _stream = _request->beginResponseStream(type);
+        _stream->setCode(status);
+        _sink.setPrint(_stream);
+        return _sink;
+    }
+
+    void doFinish() override
+    {
+        _request->send(_stream);
+    }
+
+public:
+    AsyncApiResponse(AsyncWebServerRequest *request) : _request(request) {}
+};
+
+WebApiHandler::WebApiHandler(ApiRouter &router) : _router(router)
+{
+}
+
+bool WebApiHandler::canHandle(AsyncWebServerRequest *request)
+{
+    if (!_router.find(toApiMethod(request->method()), request->url().c_str()))
+        return false;
+
+    request->addInterestingHeader("content-type");
+    return true;
+}
+
+void WebApiHandler::handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    if (total > WEBAPI_MAX_BODY)
+        return;
+
+    if (index == 0 && request->_tempObject == NULL)
+    {
+        WebApiBody *body = (WebApiBody *)malloc(sizeof(WebApiBody) + total);
+        if (body == NULL)
+            return;
+        body->length = total;
+        body->data[total] = 0;
+        request->_tempObject = body;
+    }
+
+    WebApiBody *body = (WebApiBody *)request->_tempObject;
+    if (body && index + len <= body->length)
+        memcpy(body->data + index, data, len);
+}
+
+void WebApiHandler::handleRequest(AsyncWebServerRequest *request)
+{
+    if (request->contentLength() > WEBAPI_MAX_BODY)
+    {
+        request->send(413, "text/plain", "request too large");
+        return;
+    }
+
+    log_d("webapi %s", request->url().c_str());
+
+    AsyncApiRequest apiRequest(request);
+    AsyncApiResponse apiResponse(request);
+    _router.dispatch(apiRequest, apiResponse);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <ApiRouter.hpp>
+
+#define WEBAPI_MAX_BODY 8192 // config documents, larger bodies are rejected with 413
+
+/// Runs the portable api handlers (ApiRouter, ApiHandlers) on AsyncWebServer. Requests for
+/// routes in the table are taken here, everything else falls through to the other handlers.
+/// Bodies of POST, PUT and PATCH are collected in the request before dispatch.
+class WebApiHandler : public AsyncWebHandler
+{
+private:
+    ApiRouter &_router;
+
+public:
+    WebApiHandler(ApiRouter &router);
+
+    virtual bool canHandle(AsyncWebServerRequest *request) override final;
+    virtual void handleRequest(AsyncWebServerRequest *request) override final;
+    virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override final;
+    virtual bool isRequestHandlerTrivial() override final { return false; }
+};
@@ -0,0 +1,148 @@
+#include <WebappHandler.hpp>
+
+WebappHandler::WebappHandler(const char *uri, FS &fs, const char *path, const char *defaultFile)
+    : _fs(fs), _uri(uri), _path(path), _defaultFile(defaultFile)
+{
+}
+
+bool WebappHandler::isHashedAsset(const String &path)
+{
+    // quasar build output: <name>.<8 hex digits>.<ext>
+    int extension = path.lastIndexOf('.');
+    int hash = path.lastIndexOf('.', extension - 1);
+    if (hash < 0 || extension - hash - 1 != 8)
+        return false;
+
+    for (int i = hash + 1; i < extension; i++)
+    {
+        if (!isxdigit(path.charAt(i)))
+            return false;
+    }
+    return true;
+}
+
+// stored: path of the opened file, <path>.gz for the compressed variant
+String WebappHandler::etag(const String &stored, File &file)
+{
+    // hashed assets are identified by name
+    String name = stored.endsWith(".gz") ? stored.substring(0, stored.length() - 3) : stored;
+    if (isHashedAsset(name))
+        return "\"" + stored.substring(stored.lastIndexOf('/') + 1) + "\"";
+
+    if (!_etagsLoaded)
+    {
+        _etagsLoaded = true;
+        File list = _fs.open(_path + WEBAPP_ETAG_FILE, "r");
+        if (list && !list.isDirectory())
+            _etags = "\n" + list.readString();
+        list.close();
+    }
+
+    String key = "\n" + stored.substring(_path.length()) + " ";
+    int start = _etags.indexOf(key);
+    if (start >= 0)
+    {
+        start += key.length();
+        int end = _etags.indexOf('\n', start);
+        String hash = _etags.substring(start, end < 0 ? _etags.length() : end);
+        hash.trim();
+        return "\"" + hash + "\"";
+    }
+
+    return "\"" + String(file.size()) + "-" + String((uint32_t)file.getLastWrite()) + "\"";
+}
+
+bool WebappHandler::canHandle(AsyncWebServerRequest *request)
+{
+    if (request->method() != HTTP_GET)
+        return false;
+    if (!request->url().startsWith(_uri))
+        return false;
+
+    String path = _path + request->url().substring(_uri.length());
+    if (path.endsWith("/"))
+        path += _defaultFile;
+
+    // prefer pre-compressed variant, the response adds Content-Encoding: gzip for *.gz files
+    request->_tempFile = _fs.open(path + ".gz", "r");
+    if (!request->_tempFile || request->_tempFile.isDirectory())
+        request->_tempFile = _fs.open(path, "r");
+    if (!request->_tempFile || request->_tempFile.isDirectory())
+    {
+        request->_tempFile.close();
+        return false;
+    }
+
+    // keep requested (uncompressed) path for content type detection in handleRequest
+    request->_tempObject = strdup(path.c_str());
+    request->addInterestingHeader("If-None-Match");
+    request->addInterestingHeader("Accept-Encoding");
+
+    return true;
+}
+
+void WebappHandler::handleRequest(AsyncWebServerRequest *request)
+{
+    uint32_t start_us = micros();
+
+    String path = String((char *)request->_tempObject);
+    bool hashed = isHashedAsset(path);
+    bool gzip = String(request->_tempFile.name()).endsWith(".gz");
+
+    // headers are known only now, canHandle runs before they are parsed
+    bool acceptGzip = request->hasHeader("Accept-Encoding") && request->header("Accept-Encoding").indexOf("gzip") >= 0;
+    if (gzip && !acceptGzip)
+    {
+        request->_tempFile.close();
+        request->_tempFile = _fs.open(path, "r");
+        gzip = false;
+    }
+
+    const char *cacheControl = hashed ? WEBAPP_CACHE_CONTROL_IMMUTABLE : WEBAPP_CACHE_CONTROL_REVALIDATE;
+
+    _stats.requests++;
+
+    if (!request->_tempFile || request->_tempFile.isDirectory())
+    {
+        request->_tempFile.close();
+        request->send(406, "text/plain", "gzip encoding required");
+
+        _stats.not_acceptable++;
+    }
+    else
+    {
+        size_t size = request->_tempFile.size();
+        String tag = etag(gzip ? path + ".gz" : path, request->_tempFile);
+        AsyncWebServerResponse *response;
+        bool notModified = request->hasHeader("If-None-Match") && request->header("If-None-Match").indexOf(tag) >= 0;
+        if (notModified)
+        {
+            request->_tempFile.close();
+            response = request->beginResponse(304);
+        }
+        else
+        {
+            response = request->beginResponse(request->_tempFile, path);
+        }
+        response->addHeader("Cache-Control", cacheControl);
+        response->addHeader("ETag", tag);
+        response->addHeader("Vary", "Accept-Encoding");
+        request->send(response);
+
+        if (notModified)
+        {
+            _stats.not_modified++;
+        }
+        else
+        {
+            _stats.bytes_sent += size;
+            if (gzip)
+                _stats.gzip_responses++;
+        }
+    }
+
+    uint32_t elapsed_us = micros() - start_us;
+    _stats.handler_time_us_total += elapsed_us;
+    if (elapsed_us > _stats.handler_time_us_max)
+        _stats.handler_time_us_max = elapsed_us;
+}
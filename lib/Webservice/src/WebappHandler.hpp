@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <FS.h>
+
+#define WEBAPP_CACHE_CONTROL_IMMUTABLE "public, max-age=31536000, immutable"
+#define WEBAPP_CACHE_CONTROL_REVALIDATE "no-cache"
+#define WEBAPP_ETAG_FILE "etags.txt" // content hashes, written by scripts/prepare_data.py
+
+struct WebappStats
+{
+    uint32_t requests = 0;
+    uint32_t not_modified = 0;
+    uint32_t gzip_responses = 0;
+    uint32_t not_acceptable = 0; // gzip only file, client does not accept gzip
+    uint32_t bytes_sent = 0;
+    uint32_t handler_time_us_total = 0;
+    uint32_t handler_time_us_max = 0;
+};
+
+/// Serves the web ui from the filesystem, preferring the pre-compressed <file>.gz variants
+/// created by scripts/prepare_data.py if the client accepts gzip. A file stored only as .gz
+/// is answered with 406 otherwise.
+/// Assets with content hash in their name (vendor.13411031.js) are sent as immutable,
+/// everything else (index.html, icons) is revalidated by ETag and answered with 304 if unchanged.
+/// Their ETag is the content hash from WEBAPP_ETAG_FILE, size and modification time if the
+/// file is not listed (data uploaded without the script).
+class WebappHandler : public AsyncWebHandler
+{
+private:
+    FS &_fs;
+    String _uri;
+    String _path;
+    String _defaultFile;
+
+    WebappStats _stats;
+
+    String _etags; // WEBAPP_ETAG_FILE: "\n<stored path> <hash>" per file
+    bool _etagsLoaded = false;
+
+    static bool isHashedAsset(const String &path);
+    String etag(const String &stored, File &file);
+
+public:
+    WebappHandler(const char *uri, FS &fs, const char *path, const char *defaultFile);
+
+    virtual bool canHandle(AsyncWebServerRequest *request) override final;
+    virtual void handleRequest(AsyncWebServerRequest *request) override final;
+    virtual bool isRequestHandlerTrivial() override final { return true; }
+
+    const WebappStats &getStats() const { return _stats; }
+};
@@ -1,22 +1,30 @@
 #include <Webservice.hpp>
 
-#include <System.hpp>    // -->g_System
 #include <Fuelgauge.hpp> // -->g_Fuelgauge
 #include <Loadcell.hpp>  // -->g_Loadcell
+#include <Trace.hpp>     // -->g_Trace
+#include <Mqtt.hpp>      // -->g_Mqtt
+#include <Alarm.hpp>     // -->g_Alarm
+#include <MemoryPlan.hpp> // -->g_MemoryPlan
+#include <Capture.hpp>    // -->g_Capture
+#include <Storage.hpp>    // -->g_Storage
 
 using namespace esp32m;
 
 namespace Webservice
 {
     AsyncWebServer server(80);
-    AsyncEventSource events("/events");
+    EventStreamHandler events("/events");
+    WebappHandler webapp("/", FFat, "/q/", "index.html");
+    FirmwareApiBackend api_backend;
+    ApiRouter api_router;
+    WebApiHandler api(api_router);
 
     void route_webapp_init()
     {
 
-        // attach filesystem root at URL /fs
-        server.serveStatic("/", FFat, "/q/")
-            .setDefaultFile("index.html");
+        // attach filesystem root at URL /fs, gzip + cache headers
+        server.addHandler(&webapp);
     }
 
     void route_status_init()
@@ -26,7 +34,7 @@ namespace Webservice
         server.on("/status/wifi-info", HTTP_GET, [](AsyncWebServerRequest *request)
                   {
             AsyncResponseStream *response = request->beginResponseStream("application/json");
-            DynamicJsonDocument json(1024);
+            PooledJsonDocument json(1024);
             json["wifi_status"] = WiFi.status();
             json["wifi_sta_ssid"] = WiFi.SSID();
             json["wifi_ip"] = WiFi.localIP().toString();
@@ -39,161 +47,290 @@ namespace Webservice
             .setCacheControl("no-store")
             .setDefaultFile("index.html");
 
-        // gather information about connection status
-        server.on("/status/filesystem", HTTP_GET, [](AsyncWebServerRequest *request)
-                  { return false; }); // TODO: maybe add or not...
-    }
-
-    bool cb_api_cmd_save_configuration()
-    {
-        // send event to inform other modules to action
-
-        g_System.cbSaveConfiguration();
-        g_Loadcell.cbSaveConfiguration();
-
-        return true;
-    }
-
-    bool cb_api_cmd_load_configuration()
-    {
-        // send event to inform other modules to action
-        g_System.cbLoadConfiguration();
-        g_Loadcell.cbLoadConfiguration();
-
-        return true;
-    }
-
-    bool cb_api_cmd_tare()
-    {
-        // send event to inform other modules to action
-        Event ev("Loadcell/tare");
-        EventManager::instance().publish(ev);
-
-        return true;
-    }
-
-    bool cb_api_cmd_calibrateknownreference(String knownreference_value)
-    {
-        // send event to inform other modules to action
-        DataEvent ev("Loadcell/calibrateToKnownValue", knownreference_value);
-        EventManager::instance().publish(ev);
-
-        return true;
-    }
-
-    // simple commands
-    void route_api_cmd_init()
-    {
-
-        server.on("/api/cmd/restart", HTTP_GET, [](AsyncWebServerRequest *request)
+        // statistics of the webapp static file handler
+        server.on("/status/webapp", HTTP_GET, [](AsyncWebServerRequest *request)
                   {
-                      log_i("webserver api/cmd/restart triggered");
-                      request->send(200, "text/plain", "OK");
-
-                      ESP.restart(); });
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            const WebappStats &stats = webapp.getStats();
+            PooledJsonDocument json(512);
+            json["requests"] = stats.requests;
+            json["not_modified"] = stats.not_modified;
+            json["gzip_responses"] = stats.gzip_responses;
+            json["not_acceptable"] = stats.not_acceptable;
+            json["bytes_sent"] = stats.bytes_sent;
+            json["handler_time_us_total"] = stats.handler_time_us_total;
+            json["handler_time_us_max"] = stats.handler_time_us_max;
+            serializeJson(json, *response);
+            request->send(response); });
 
-        // Send a HTTP_GET request to <IP>/post with a form field message set to <message>
-        server.on("/api/cmd/tare", HTTP_GET, [](AsyncWebServerRequest *request)
+        // event stream clients and fan-out statistics
+        server.on("/status/events", HTTP_GET, [](AsyncWebServerRequest *request)
                   {
-                    log_i("webserver tare triggered");
-
-                    if (cb_api_cmd_tare())
-                        request->send(200, "text/plain", "OK");
-
-                    request->send(400, "text/plain", "request error"); });
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            FanoutMetrics metrics = EventStream::getMetrics();
+            PooledJsonDocument json(512);
+            json["clients"] = metrics.clients;
+            json["published"] = metrics.published;
+            json["delivered"] = metrics.delivered;
+            json["dropped"] = metrics.dropped;
+            json["coalesced"] = metrics.coalesced;
+            json["replayed"] = metrics.replayed;
+            serializeJson(json, *response);
+            request->send(response); });
 
-        // Send a HTTP_GET request to <IP>/post with a form field message set to <message>
-        server.on("/api/cmd/loadconfiguration", HTTP_GET, [](AsyncWebServerRequest *request)
+        // capture download throughput and acquisition timing, to judge the impact of downloads on sampling
+        server.on("/status/capture", HTTP_GET, [](AsyncWebServerRequest *request)
                   {
-                    log_i("webserver loadconfiguration triggered");
-
-                    if (cb_api_cmd_load_configuration())
-                        request->send(200, "text/plain", "OK");
-
-                    request->send(400, "text/plain", "request error"); });
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            DownloadStats downloads = CaptureDownload::getStats();
+            PipelineStats loadcell = g_Loadcell.getStats();
+            PooledJsonDocument json(512);
+            json["downloads"] = downloads.downloads;
+            json["downloads_active"] = downloads.active;
+            json["download_bytes_total"] = downloads.bytes_total;
+            json["download_last_kbytes_per_sec"] = downloads.last_kbytes_per_sec;
+            json["catalog_records"] = g_Capture.getCatalogRecords();
+            json["catalog_rebuild_ms"] = g_Capture.getCatalogRebuildMs();
+            json["capture_samples"] = g_Capture.getSampleCount();
+            json["capture_data_bytes"] = g_Capture.getDataBytes();
+            json["capture_write_errors"] = g_Capture.getWriteErrors();
+            json["sample_count"] = loadcell.count;
+            json["sample_interval_us_min"] = loadcell.interval_us_min;
+            json["sample_interval_us_max"] = loadcell.interval_us_max;
+            json["sample_interval_us_mean"] = loadcell.interval_us_mean;
+            serializeJson(json, *response);
+            request->send(response); });
 
-        // Send a HTTP_GET request to <IP>/post with a form field message set to <message>
-        server.on("/api/cmd/saveconfiguration", HTTP_GET, [](AsyncWebServerRequest *request)
+        // write-behind queue of FFat: depth, coalescing and write latency
+        server.on("/status/storage", HTTP_GET, [](AsyncWebServerRequest *request)
                   {
-                    log_i("webserver saveconfiguration triggered");
-
-                    if (cb_api_cmd_save_configuration())
-                        request->send(200, "text/plain", "OK");
-
-                    request->send(400, "text/plain", "request error"); });
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            StorageStats storage = g_Storage.getStats();
+            PooledJsonDocument json(1024);
+            json["depth"] = storage.queue.depth;
+            json["depth_peak"] = storage.queue.depth_peak;
+            json["slots"] = STORAGE_QUEUE_SLOTS;
+            json["submitted"] = storage.queue.submitted;
+            json["coalesced"] = storage.queue.coalesced;
+            json["rejected"] = storage.queue.rejected;
+            json["completed"] = storage.queue.completed;
+            json["failed"] = storage.queue.failed;
+            json["write_us_last"] = storage.queue.write_us_last;
+            json["write_us_max"] = storage.queue.write_us_max;
+            json["write_us_mean"] = storage.queue.completed ? (uint32_t)(storage.queue.write_us_total / storage.queue.completed) : 0;
+            json["latency_us_last"] = storage.queue.latency_us_last;
+            json["latency_us_max"] = storage.queue.latency_us_max;
+            json["sector_size"] = STORAGE_SECTOR_SIZE;
+            json["sector_writes"] = storage.writer.sector_writes;
+            json["tail_writes"] = storage.writer.tail_writes;
+            json["file_writes"] = storage.writer.file_writes;
+            json["patch_writes"] = storage.writer.patch_writes;
+            json["bytes_written"] = storage.writer.bytes_written;
+            json["errors"] = storage.writer.errors;
+            serializeJson(json, *response);
+            request->send(response); });
 
-        // Send a POST request to <IP>/post with a form field message set to <message>
-        server.on("/api/cmd/calibrateknownreference", HTTP_POST, [](AsyncWebServerRequest *request)
+        // alarm outputs and conversion to GPIO latency
+        server.on("/status/alarm", HTTP_GET, [](AsyncWebServerRequest *request)
                   {
-                    log_i("webserver calibrateknownreference triggered");
-
-                    //validation
-                    if (!request->hasParam("knownValue", true))
-                        request->send(400, "text/plain", "parameter knownValue missing");
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            AlarmStatus alarm = g_Alarm.getStatus();
+            PooledJsonDocument json(512);
+            json["outputs"] = alarm.outputs;
+            json["active_rules"] = alarm.active_rules;
+            json["edges"] = alarm.edges;
+            json["edge_latency_us_last"] = alarm.edge_latency_us_last;
+            json["edge_latency_us_max"] = alarm.edge_latency_us_max;
+            json["eval_latency_us_max"] = alarm.eval_latency_us_max;
+            json["eval_latency_us_mean"] = alarm.eval_latency_us_mean;
+            json["eval_samples"] = alarm.eval_samples;
+            json["deadline_misses"] = alarm.deadline_misses;
+            json["sample_period_us"] = 1000000.0f / g_Loadcell.getSampleRate();
+            serializeJson(json, *response);
+            request->send(response); });
 
-                    //get request information for callback
-                    String knownValue = request->getParam("knownValue", true)->value();
+        // sensor temperature, compensation and coefficient learning
+        server.on("/status/temperature", HTTP_GET, [](AsyncWebServerRequest *request)
+                  {
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            TemperatureStatus temperature = g_Loadcell.getTemperatureStatus();
+            PipelineParams params = g_Loadcell.getPipelineParams();
+            PooledJsonDocument json(512);
+            json["temperature"] = temperature.temperature;
+            json["temp_reference"] = params.temp_reference;
+            json["compensating"] = temperature.compensating;
+            json["conversions"] = temperature.conversions;
+            json["held_samples"] = temperature.held_samples;
+            json["load_sample_ratio"] = temperature.load_sample_ratio;
+            json["learning"] = temperature.learning;
+            json["learn_load"] = temperature.learn_load;
+            json["learn_points"] = temperature.learn_points;
+            json["learn_temp_span"] = temperature.learn_temp_span;
+            serializeJson(json, *response);
+            request->send(response); });
 
+        // mains hum filter: notch frequencies for the measured sample rate and the attenuation
+        // at the mains harmonics, from the same fixed point coefficients as the acquisition
+        server.on("/status/filter", HTTP_GET, [](AsyncWebServerRequest *request)
+                  {
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            PipelineParams params = g_Loadcell.getPipelineParams();
+            HumFilter hum;
+            hum.design(params.hum, g_Loadcell.getTelemetry().hum_sample_rate);
+            PooledJsonDocument json(1024);
+            json["mode"] = params.hum.mode;
+            json["mains_hz"] = params.hum.mains_hz;
+            json["q"] = params.hum.q;
+            json["sample_rate_nominal"] = params.sample_rate;
+            json["sample_rate_design"] = hum.getSampleRate();
+            JsonArray notches = json.createNestedArray("notch_hz");
+            for (uint8_t i = 0; i < hum.getStageCount(); i++)
+                notches.add(hum.getStage(i).frequency);
+            JsonArray attenuation = json.createNestedArray("harmonic_attenuation_db");
+            for (uint8_t k = 1; hum.isActive() && k <= params.hum.harmonics; k++)
+                attenuation.add(-20.0 * log10(hum.response(k * params.hum.mains_hz) + 1e-9));
+            serializeJson(json, *response);
+            request->send(response); });
 
-                    if (cb_api_cmd_calibrateknownreference(knownValue))
-                        request->send(200, "text/plain", "OK");
+        // derived channels of the latest sample and the peak rate since the last resetstats
+        server.on("/status/derived", HTTP_GET, [](AsyncWebServerRequest *request)
+                  {
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            LoadcellTelemetry reading = g_Loadcell.getTelemetry();
+            uint8_t window = g_Loadcell.getPipelineParams().derived.rate_window;
+            PooledJsonDocument json(512);
+            json["rate"] = reading.rate;
+            json["impulse"] = reading.impulse;
+            json["work"] = reading.work;
+            json["rate_min"] = reading.stats.rate_min;
+            json["rate_max"] = reading.stats.rate_max;
+            json["rate_window"] = window;
+            json["rate_delay_us"] = (window - 1) / 2.0f * reading.stats.interval_us_mean;
+            json["display_channel"] = g_Loadcell.sensor_config.display_channel;
+            json["stream_channel"] = g_Loadcell.sensor_config.stream_channel;
+            serializeJson(json, *response);
+            request->send(response); });
 
-                    request->send(400, "text/plain", "request error"); });
-    }
+        // acquisition gap per kind of config change
+        server.on("/status/config", HTTP_GET, [](AsyncWebServerRequest *request)
+                  {
+            static const char *kinds[CONFIG_APPLY_KINDS] = {"presentation", "scale", "adc"};
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            ConfigApplyStatus apply = g_Loadcell.getConfigApplyStatus();
+            PooledJsonDocument json(512);
+            json["sample_period_us"] = apply.sample_period_us;
+            for (uint8_t i = 0; i < CONFIG_APPLY_KINDS; i++)
+            {
+                JsonObject kind = json.createNestedObject(kinds[i]);
+                kind["count"] = apply.count[i];
+                kind["apply_us_last"] = apply.apply_us_last[i];
+                kind["gap_us_last"] = apply.gap_us_last[i];
+                kind["gap_us_max"] = apply.gap_us_max[i];
+            }
+            serializeJson(json, *response);
+            request->send(response); });
 
-    // api/config update requests
-    void route_api_config_init()
-    {
-        // GET config
-        server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request)
+        // memory budget: task stacks, static buffers, json pool, heap growth and allocation guard
+        server.on("/status/memory", HTTP_GET, [](AsyncWebServerRequest *request)
                   {
-            log_i("webserver /api/config triggered");
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            g_MemoryPlan.printJson(*response);
+            request->send(response); });
 
+        // mqtt publisher: connection, offline spool, throughput and heap
+        server.on("/status/mqtt", HTTP_GET, [](AsyncWebServerRequest *request)
+                  {
             AsyncResponseStream *response = request->beginResponseStream("application/json");
+            MqttStatus mqtt = g_Mqtt.getStatus();
+            PooledJsonDocument json(1024);
+            json["enabled"] = mqtt.enabled;
+            json["connected"] = mqtt.connected;
+            json["inflight"] = mqtt.inflight;
+            json["spooled"] = mqtt.spooled;
+            json["spool_dropped"] = mqtt.spool_dropped;
+            json["overruns"] = mqtt.overruns;
+            json["spool_failures"] = mqtt.publisher.spool_failures;
+            json["messages_per_sec"] = mqtt.publisher.messages_per_sec;
+            json["records_per_sec"] = mqtt.publisher.records_per_sec;
+            json["bytes_per_sec"] = mqtt.publisher.bytes_per_sec;
+            json["connects"] = mqtt.session.connects;
+            json["connect_failures"] = mqtt.session.connect_failures;
+            json["disconnects"] = mqtt.session.disconnects;
+            json["published"] = mqtt.session.published;
+            json["acked"] = mqtt.session.acked;
+            json["retransmits"] = mqtt.session.retransmits;
+            json["bytes_sent"] = mqtt.session.bytes_sent;
+            json["ack_latency_ms_max"] = mqtt.session.ack_latency_ms_max;
+            json["module_bytes"] = sizeof(MqttClass) + MQTT_SAMPLE_BUFFER_SIZE;
+            json["free_heap"] = ESP.getFreeHeap();
+            json["min_free_heap"] = ESP.getMinFreeHeap();
+            serializeJson(json, *response);
+            request->send(response); });
 
-            DynamicJsonDocument response_json(3072);
-            DynamicJsonDocument system = DynamicJsonDocument(1024);
-            DynamicJsonDocument sensor = DynamicJsonDocument(1024);
-            DynamicJsonDocument adc = DynamicJsonDocument(1024);
+        // sample-to-output latency per trace point, enable with /api/cmd/trace?enable=1
+        server.on("/status/latency", HTTP_GET, [](AsyncWebServerRequest *request)
+                  {
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            PipelineStats loadcell = g_Loadcell.getStats();
+            PooledJsonDocument json(4096);
+            json["enabled"] = g_Trace.isEnabled();
+            // moving average delays the filtered value by (n-1)/2 samples on top of the measured latency
+            json["filter_group_delay_us"] = (g_Loadcell.getPipelineParams().filter_size - 1) / 2.0f * loadcell.interval_us_mean;
+            for (uint8_t i = 0; i < TRACE_POINT_COUNT; i++)
+            {
+                LatencyHistogram histogram = g_Trace.getHistogram((TracePoint)i);
+                JsonObject point = json.createNestedObject(TraceClass::getPointName(i));
+                point["count"] = histogram.count;
+                point["min_us"] = histogram.min_us;
+                point["max_us"] = histogram.max_us;
+                point["mean_us"] = histogram.count ? (uint32_t)(histogram.sum_us / histogram.count) : 0;
+                point["p50_us"] = histogram.percentile(0.50f);
+                point["p90_us"] = histogram.percentile(0.90f);
+                point["p99_us"] = histogram.percentile(0.99f);
+                JsonArray buckets = point.createNestedArray("log2_buckets_us");
+                for (uint8_t b = 0; b < TRACE_HISTOGRAM_BUCKETS; b++)
+                    buckets.add(histogram.buckets[b]);
+            }
+            serializeJson(json, *response);
+            request->send(response); });
 
-            g_System.system_config.toDoc(system);
-            g_Loadcell.sensor_config.toDoc(sensor);
-            g_Loadcell.adc_config.toDoc(adc);
+        // raw trace records, open in ui.perfetto.dev or chrome://tracing
+        server.on("/status/trace", HTTP_GET, [](AsyncWebServerRequest *request)
+                  {
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            response->addHeader("Content-Disposition", "attachment; filename=\"trace.json\"");
+            g_Trace.printChromeTrace(*response);
+            request->send(response); });
 
-            // https://arduino.stackexchange.com/a/94216
-            response_json[F("system")] = system;
-            response_json[F("sensor")] = sensor;
-            response_json[F("adc")] = adc;
+        // gather information about connection status
+        server.on("/status/filesystem", HTTP_GET, [](AsyncWebServerRequest *request)
+                  { return false; }); // TODO: maybe add or not...
+    }
 
-            serializeJson(response_json, *response);
+    // captured datasets
+    void route_api_captures_init()
+    {
+        server.on("/api/captures/download", HTTP_GET, CaptureDownload::handleDownload);
+        server.on("/api/captures", HTTP_GET, CaptureDownload::handleList);
+    }
 
-            request->send(response); });
+    // commands, config, history and spectrum: portable handlers, see ApiHandlers
+    void route_api_init()
+    {
+        api_router.begin(api_backend, []() -> uint32_t
+                         { return micros(); });
+        if (!ApiHandlers::registerRoutes(api_router))
+            log_e("api route table full");
 
-        // POST/PUT/PATCH config
-        AsyncCallbackJsonWebHandler *handlerCfg = new AsyncCallbackJsonWebHandler("/api/config", [](AsyncWebServerRequest *request, JsonVariant json)
-                                                                                  {
-                                                                                    
-                                                                                    g_System.system_config.fromWeb(json["system"]);
-                                                                                    g_Loadcell.sensor_config.fromWeb(json["sensor"]);
-                                                                                    g_Loadcell.adc_config.fromWeb(json["adc"]);
-                                                                                    g_Loadcell.postConfigChange();
-
-                                                                                    String response = "{\"status\":\"OK\"}";
-                                                                                    request -> send(200, "application/json", response); });
-        server.addHandler(handlerCfg);
+        server.addHandler(&api);
     }
 
     void route_sse_init()
     {
         // SSE ......
 
-        events.onConnect([](AsyncEventSourceClient *client)
-                         {
-            if(client->lastId()){
-                log_i("Client reconnected! Last message ID that it got is: %u\n", client->lastId());
-            }
-            
-            client->send("init event session",NULL, millis(), 1000); });
+        // per client queues, see EventStream
+        EventStream::initialize();
 
         server.addHandler(&events);
     }
@@ -222,9 +359,10 @@ namespace Webservice
     {
         route_status_init();
 
-        route_api_cmd_init();
+        route_api_init();
+
+        route_api_captures_init();
 
-        route_api_config_init();
 
         route_sse_init();
 
@@ -244,6 +382,11 @@ namespace Webservice
                 log_d("%s",((DataEvent *)ev)->data().c_str());
 
                 invokeSendEvent("message", ((DataEvent *)ev)->data());
+            }
+            else if (ev->is("Webservice/sendSpectrum"))
+            {
+                // peaks only, the full spectrum is too large for an event: /api/spectrum
+                invokeSendEvent("spectrum", ((DataEvent *)ev)->data());
         } });
     }
 
@@ -256,8 +399,8 @@ namespace Webservice
         server.begin();
     }
 
-    void invokeSendEvent(String event, String value)
+    void invokeSendEvent(String event, String value, uint32_t source_us)
     {
-        events.send(value.c_str(), event.c_str(), millis());
+        EventStream::publish(event.c_str(), value.c_str(), source_us);
     }
 }
@@ -9,6 +9,12 @@
 #include <DataEvent.hpp>
 #include <WiFi.h>
 #include <AsyncTCP.h>
+#include <WebappHandler.hpp>
+#include <EventStream.hpp>
+#include <CaptureDownload.hpp>
+#include <WebApiHandler.hpp>
+#include <FirmwareApiBackend.hpp>
+#include <ApiHandlers.hpp>
 
 /// The display module to control the attached LEDs
 ///
@@ -18,6 +24,6 @@ namespace Webservice
     /// Initialize the webserver
     void initialize();
 
-    void invokeSendEvent(String event, String value);
+    void invokeSendEvent(String event, String value, uint32_t source_us = 0);
 
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+# PlatformIO post-script: static memory budget of the firmware image.
+#
+# After linking, sums the RAM sections of firmware.elf (internal DRAM, IRAM, PSRAM) and lists
+# the largest statically allocated symbols: task stacks, stream buffers, json pool, ...
+# Complements the run-time report at /status/memory, which adds heap and stack high water marks.
+# Fails the build if internal DRAM use exceeds DRAM_BUDGET (override with MEMORY_DRAM_BUDGET).
+
+import os
+import subprocess
+
+Import("env")
+
+DRAM_BUDGET = int(os.environ.get("MEMORY_DRAM_BUDGET", 160 * 1024))
+TOP_SYMBOLS = 20
+
+# section name prefixes per memory region
+REGIONS = {
+    "dram": (".dram0.data", ".dram0.bss", ".noinit"),
+    "iram": (".iram0.text", ".iram0.vectors", ".iram0.data", ".iram0.bss"),
+    "psram": (".ext_ram.bss", ".ext_ram_noinit"),
+}
+
+
+def tool(name):
+    # xtensa-esp32s3-elf-gcc -> xtensa-esp32s3-elf-<name>
+    cc = env.subst("$CC")
+    return cc[: cc.rfind("-") + 1] + name
+
+
+def section_sizes(elf):
+    out = subprocess.run([tool("size"), "-A", elf], capture_output=True, text=True, check=True).stdout
+    sizes = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".") and parts[1].isdigit():
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def largest_symbols(elf):
+    out = subprocess.run([tool("nm"), "-S", "-C", "--size-sort", "-r", elf], capture_output=True, text=True, check=True).stdout
+    symbols = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        # address size type name, b/B: bss, d/D: data
+        if len(parts) == 4 and parts[2] in "bBdD":
+            symbols.append((int(parts[1], 16), parts[3]))
+    return symbols[:TOP_SYMBOLS]
+
+
+def report(source, target, env):
+    elf = str(source[0])
+    sizes = section_sizes(elf)
+
+    print("memory budget (static):")
+    totals = {}
+    for region, prefixes in REGIONS.items():
+        totals[region] = sum(size for name, size in sizes.items() if name.startswith(prefixes))
+        print("  %-6s %8d bytes" % (region, totals[region]))
+
+    print("  largest static symbols:")
+    for size, name in largest_symbols(elf):
+        print("    %8d  %s" % (size, name))
+
+    if totals["dram"] > DRAM_BUDGET:
+        print("internal DRAM %d bytes exceeds the budget of %d bytes" % (totals["dram"], DRAM_BUDGET))
+        env.Exit(1)
+    print("  dram budget: %d of %d bytes (%.0f%%)" % (totals["dram"], DRAM_BUDGET, 100.0 * totals["dram"] / DRAM_BUDGET))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)
@@ -0,0 +1,83 @@
+# PlatformIO pre-script: stage the filesystem image contents.
+#
+# Copies data/ to .pio/data/ and stores the files of the web ui (data/q/) as
+# gzip-only variant <file>.gz if that saves space (fonts and images are kept as is).
+# Webservice serves these with Content-Encoding: gzip.
+# Writes q/etags.txt to the staged dir with a content hash per stored file of the web ui whose name has
+# no hash (index.html, icons), WebappHandler sends it as ETag. A rebuilt file of the same
+# size gets a new ETag.
+# The staged dir is used as data dir for buildfs/uploadfs, data/ stays untouched.
+
+import gzip
+import hashlib
+import os
+import re
+import shutil
+
+Import("env")
+
+WEBAPP_DIR = "q"
+MIN_GZIP_SAVING = 0.1
+ETAG_FILE = "etags.txt"  # WEBAPP_ETAG_FILE
+HASHED_ASSET = re.compile(r"\.[0-9a-fA-F]{8}\.[^.]+$")  # WebappHandler::isHashedAsset
+
+project_data_dir = env.subst("$PROJECT_DATA_DIR")
+staged_data_dir = os.path.join(env.subst("$PROJECT_DIR"), ".pio", "data")
+
+
+def stage_data():
+    if os.path.isdir(staged_data_dir):
+        shutil.rmtree(staged_data_dir)
+
+    bytes_plain = 0
+    bytes_gzip = 0
+    etags = []
+
+    def add_etag(rel_root, stored_name, content):
+        # per stored file, the gzip and the plain variant are different representations
+        if HASHED_ASSET.search(stored_name[:-3] if stored_name.endswith(".gz") else stored_name):
+            return
+        rel_webapp = os.path.relpath(os.path.join(rel_root, stored_name), WEBAPP_DIR).replace(os.sep, "/")
+        etags.append("%s %s" % (rel_webapp, hashlib.sha1(content).hexdigest()[:16]))
+
+    for root, _, files in os.walk(project_data_dir):
+        rel_root = os.path.relpath(root, project_data_dir)
+        is_webapp = rel_root == WEBAPP_DIR or rel_root.startswith(WEBAPP_DIR + os.sep)
+        os.makedirs(os.path.join(staged_data_dir, rel_root), exist_ok=True)
+
+        for name in files:
+            src = os.path.join(root, name)
+
+            if not is_webapp or name.endswith(".gz"):
+                shutil.copy2(src, os.path.join(staged_data_dir, rel_root, name))
+                if is_webapp:
+                    with open(src, "rb") as f_in:
+                        add_etag(rel_root, name, f_in.read())
+                continue
+
+            with open(src, "rb") as f_in:
+                content = f_in.read()
+            # mtime=0 keeps the output reproducible
+            compressed = gzip.compress(content, compresslevel=9, mtime=0)
+
+            bytes_plain += len(content)
+            if len(compressed) < len(content) * (1 - MIN_GZIP_SAVING):
+                with open(os.path.join(staged_data_dir, rel_root, name + ".gz"), "wb") as f_out:
+                    f_out.write(compressed)
+                add_etag(rel_root, name + ".gz", compressed)
+                bytes_gzip += len(compressed)
+            else:
+                shutil.copy2(src, os.path.join(staged_data_dir, rel_root, name))
+                add_etag(rel_root, name, content)
+                bytes_gzip += len(content)
+
+    if os.path.isdir(os.path.join(staged_data_dir, WEBAPP_DIR)):
+        with open(os.path.join(staged_data_dir, WEBAPP_DIR, ETAG_FILE), "w", newline="\n") as f_out:
+            f_out.write("".join(line + "\n" for line in sorted(etags)))
+
+    print("webapp staged: %d bytes -> %d bytes (%.1f%%)" % (bytes_plain, bytes_gzip, 100.0 * bytes_gzip / max(bytes_plain, 1)))
+
+
+if any(target in COMMAND_LINE_TARGETS for target in ("buildfs", "uploadfs", "uploadfsota")):
+    stage_data()
+    env.Replace(PROJECT_DATA_DIR=staged_data_dir)
@@ -34,6 +34,14 @@
 #include "System.hpp"    // --> g_System
 #include "Fuelgauge.hpp" // --> g_Fuelgauge
 #include "Loadcell.hpp"  // --> g_Loadcell
+#include "Capture.hpp"   // --> g_Capture
+#include "Storage.hpp"   // --> g_Storage
+#include "Spectrum.hpp"  // --> g_Spectrum
+#include "SerialStream.hpp" // --> g_SerialStream
+#include "Mqtt.hpp"      // --> g_Mqtt
+#include "SampleEvents.hpp" // --> g_SampleEvents
+#include "Alarm.hpp"     // --> g_Alarm
+#include "MemoryPlan.hpp" // --> g_MemoryPlan
 #include "Webservice.hpp"
 #include "Display.hpp"
 
@@ -53,7 +61,32 @@ using namespace esp32m;
 
 /////////////////////////////////////////////////////////////////
 
-void pressed(Button2 &btn)
+// Tasks run on static stacks (depth in bytes on ESP-IDF), registered with the memory plan.
+// Size = peak use + 1 kB margin, rounded up to 512 bytes. The peaks noted at START_TASK are
+// estimated from the deepest call path (frames, stack buffers, newlib printf for log_x with
+// floats about 1.1 kB, FFat through VFS/FatFs/wear levelling about 1.5 kB, an SSE send
+// through the fan-out and AsyncTCP about 1.2 kB); replace them with stack - stack_free_min
+// from /status/memory after a soak run on the board. critical: heap use after boot is
+// counted by the allocation guard.
+// START_TASK_PINNED: other core than ARDUINO_RUNNING_CORE for work that must not compete with acquisition.
+#define START_TASK_PINNED(function, stack_bytes, priority, critical, core)                                   \
+  {                                                                                                          \
+    static StackType_t function##_stack[stack_bytes];                                                        \
+    static StaticTask_t function##_tcb;                                                                      \
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(function, #function, stack_bytes, NULL, priority,     \
+                                                        function##_stack, &function##_tcb, core);            \
+    g_MemoryPlan.registerTask(handle, #function, stack_bytes, critical);                                     \
+  }
+#if CONFIG_FREERTOS_UNICORE
+#define OTHER_CORE ARDUINO_RUNNING_CORE // ESP32-S2
+#else
+#define OTHER_CORE (1 - ARDUINO_RUNNING_CORE)
+#endif
+#define START_TASK(function, stack_bytes, priority, critical) \
+  START_TASK_PINNED(function, stack_bytes, priority, critical, ARDUINO_RUNNING_CORE)
+
+// short press: tare
+void clicked(Button2 &btn)
 {
   log_i("tare button pressed");
 
@@ -62,6 +95,14 @@ void pressed(Button2 &btn)
   EventManager::instance().publish(ev);
 }
 
+// long or double press: next display page
+void pageChange(Button2 &btn)
+{
+  log_i("display page button pressed");
+
+  Display::next_page();
+}
+
 void Task_Display(void *pvParameters)
 {
   (void)pvParameters;
@@ -70,7 +111,7 @@ void Task_Display(void *pvParameters)
   {
     Display::update_loop();
 
-    vTaskDelay(250 / portTICK_PERIOD_MS);
+    vTaskDelay(DISPLAY_UPDATE_MS / portTICK_PERIOD_MS);
   }
 }
 
@@ -84,7 +125,107 @@ void Task_Loadcell(void *pvParameters)
   {
     g_Loadcell.update_loop();
 
-    vTaskDelay(1);
+    // next conversion or one tick, data ready interrupt capable backends wake per sample
+    g_Loadcell.waitReady();
+  }
+}
+
+void Task_Capture(void *pvParameters)
+{
+  (void)pvParameters;
+
+  g_Capture.initialize();
+
+  while (1) // A Task shall never return or exit.
+  {
+    g_Capture.update_loop();
+
+    vTaskDelay(20 / portTICK_PERIOD_MS);
+  }
+}
+
+void Task_Storage(void *pvParameters)
+{
+  (void)pvParameters;
+
+  // initialized in setup, config loading reads through the queue
+  while (1) // A Task shall never return or exit.
+  {
+    g_Storage.update_loop();
+
+    // next request or the flush period of a staged tail
+    g_Storage.waitWork();
+  }
+}
+
+void Task_Spectrum(void *pvParameters)
+{
+  (void)pvParameters;
+
+  g_Spectrum.initialize();
+
+  while (1) // A Task shall never return or exit.
+  {
+    g_Spectrum.update_loop();
+
+    vTaskDelay(20 / portTICK_PERIOD_MS);
+  }
+}
+
+void Task_SerialStream(void *pvParameters)
+{
+  (void)pvParameters;
+
+  g_SerialStream.initialize();
+
+  while (1) // A Task shall never return or exit.
+  {
+    g_SerialStream.update_loop();
+
+    vTaskDelay(20 / portTICK_PERIOD_MS);
+  }
+}
+
+void Task_Mqtt(void *pvParameters)
+{
+  (void)pvParameters;
+
+  g_Mqtt.initialize();
+
+  while (1) // A Task shall never return or exit.
+  {
+    g_Mqtt.update_loop();
+
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+  }
+}
+
+void Task_SampleEvents(void *pvParameters)
+{
+  (void)pvParameters;
+
+  g_SampleEvents.initialize();
+
+  while (1) // A Task shall never return or exit.
+  {
+    g_SampleEvents.update_loop();
+
+    vTaskDelay(20 / portTICK_PERIOD_MS);
+  }
+}
+
+void Task_Alarm(void *pvParameters)
+{
+  (void)pvParameters;
+
+  // initialized by g_Loadcell, this task only publishes what acquisition queued: the alarm
+  // events and the tare, calibration and temperature learning messages
+  while (1) // A Task shall never return or exit.
+  {
+    g_Alarm.update_loop();
+    g_Loadcell.publishMessages();
+
+    vTaskDelay(50 / portTICK_PERIOD_MS);
   }
 }
 
@@ -107,7 +248,9 @@ void Task_Buttons(void *pvParameters)
   (void)pvParameters;
 
   button.begin(BUTTON_PIN);
-  button.setPressedHandler(pressed);
+  button.setClickHandler(clicked);
+  button.setLongClickHandler(pageChange);
+  button.setDoubleClickHandler(pageChange);
 
   while (1) // A Task shall never return or exit.
   {
@@ -122,21 +265,34 @@ void Task_RegularInfoOut(void *pvParameters)
 
   while (1) // A Task shall never return or exit.
   {
+    g_MemoryPlan.update_loop();
+    // STA connect or fallback to AP
+    g_System.update_loop();
+
     // events + data
+    // one snapshot each, all values below belong to the same sample
+    LoadcellTelemetry reading = g_Loadcell.getTelemetry();
+    FuelgaugeStatus battery = g_Fuelgauge.getStatus();
+
     Webservice::invokeSendEvent("ping", String(millis()));
-    Webservice::invokeSendEvent("reading", String(g_Loadcell.getReadingRaw()));
-    Webservice::invokeSendEvent("force", String(g_Loadcell.getReadingDisplayunitFiltered(), 0));
-    Webservice::invokeSendEvent("battery", String(g_Fuelgauge.getBatteryPercent(), 1));
-
-    // send debug information
-    Serial.println();
-    Serial.print(g_Loadcell.getReadingRaw());
-    Serial.print("\t");
-    Serial.print(g_Loadcell.getReadingDisplayunitFiltered(), 4);
-    Serial.print("\t");
-    Serial.print(g_Fuelgauge.getBatteryPercent(), 1);
-    Serial.print("\t");
-    Serial.print(g_Fuelgauge.getChargeRate(), 1);
+    Webservice::invokeSendEvent("reading", String(reading.raw));
+    Webservice::invokeSendEvent("force", String(reading.filtered, 0), reading.micros);
+    Webservice::invokeSendEvent("battery", String(battery.percent, 1));
+    // <rate>,<impulse>,<work>
+    Webservice::invokeSendEvent("derived", String(reading.rate, 3) + "," + String(reading.impulse, 4) + "," + String(reading.work, 4), reading.micros);
+
+    // send debug information, only if the serial link is not used for binary streaming
+    if (!g_SerialStream.isActive())
+    {
+      Serial.println();
+      Serial.print(reading.raw);
+      Serial.print("\t");
+      Serial.print(reading.filtered, 4);
+      Serial.print("\t");
+      Serial.print(battery.percent, 1);
+      Serial.print("\t");
+      Serial.print(battery.charge_rate, 1);
+    }
 
     vTaskDelay(500 / portTICK_PERIOD_MS);
   }
@@ -153,19 +309,29 @@ void setup()
   Display::initialize();
   Display::status_message("display initialized");
 
+  // queue for all writes to FFat, before the first config is loaded
+  g_Storage.initialize();
+
   // onetime load system config on start, also setup filesystem+wifi
   g_System.initialize();
 
   // later init phase
-  xTaskCreatePinnedToCore(Task_Buttons, "Task_Buttons", 4096, NULL, 2, NULL, ARDUINO_RUNNING_CORE);
-  xTaskCreatePinnedToCore(Task_Loadcell, "Task_Loadcell", 4096, NULL, 3, NULL, ARDUINO_RUNNING_CORE);
-  xTaskCreatePinnedToCore(Task_Fuelgauge, "Task_Fuelgauge", 4096, NULL, 3, NULL, ARDUINO_RUNNING_CORE);
+  START_TASK_PINNED(Task_Storage, 3584, 1, false, OTHER_CORE); // peak ~2.3 kB, fopen/fwrite/fsync on FFat. flash writes away from acquisition
+  START_TASK(Task_Buttons, 3072, 2, false);                    // peak ~1.7 kB, click handler log and the tare event chain
+  START_TASK(Task_Loadcell, 4096, 3, true);                    // peak ~2.6 kB, config load at init, I2C reads, no events
+  START_TASK(Task_Capture, 4096, 1, false);                    // peak ~2.6 kB, catalog rebuild reads files with a 512 byte buffer
+  START_TASK_PINNED(Task_Spectrum, 3072, 1, false, OTHER_CORE); // peak ~1.9 kB, peak formatting and the sse event. fft away from acquisition
+  START_TASK(Task_SerialStream, 3072, 2, false);               // peak ~1.8 kB, sample frame buffers (0.75 kB) and USB CDC write
+  START_TASK(Task_Alarm, 3072, 2, false);                      // peak ~1.9 kB, alarm and loadcell messages through the sse fan-out
+  START_TASK(Task_Mqtt, 4096, 1, false);                       // peak ~3.0 kB, WiFiClient connect with DNS, 0.5 kB sample batch
+  START_TASK(Task_Fuelgauge, 2560, 3, false);                  // peak ~1.5 kB, gauge reads over I2C, no events
   Webservice::initialize();
 
   Display::status_message("Ready.");
 
-  xTaskCreatePinnedToCore(Task_Display, "Task_Display", 4096, NULL, 2, NULL, ARDUINO_RUNNING_CORE);
-  xTaskCreatePinnedToCore(Task_RegularInfoOut, "Task_RegularInfoOut", 4096, NULL, 3, NULL, ARDUINO_RUNNING_CORE);
+  START_TASK(Task_Display, 3072, 2, false);         // peak ~2.0 kB, page text with floats, U8g2 transfer
+  START_TASK(Task_SampleEvents, 3072, 2, false);    // peak ~1.8 kB, 384 byte receive buffer, float formatting, sse send
+  START_TASK(Task_RegularInfoOut, 3072, 3, false); // peak ~2.0 kB, five sse events, Serial.print of floats, wifi state
 }
 
 void loop()
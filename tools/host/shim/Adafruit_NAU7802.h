@@ -0,0 +1,38 @@
+#pragma once
+
+// Host stand-in for the register enums of the Adafruit NAU7802 library that Nau7802Config
+// stores, same values as the library.
+
+typedef enum _ldovoltages
+{
+    NAU7802_4V5,
+    NAU7802_4V2,
+    NAU7802_3V9,
+    NAU7802_3V6,
+    NAU7802_3V3,
+    NAU7802_3V0,
+    NAU7802_2V7,
+    NAU7802_2V4,
+    NAU7802_EXTERNAL,
+} NAU7802_LDOVoltage;
+
+typedef enum _gains
+{
+    NAU7802_GAIN_1,
+    NAU7802_GAIN_2,
+    NAU7802_GAIN_4,
+    NAU7802_GAIN_8,
+    NAU7802_GAIN_16,
+    NAU7802_GAIN_32,
+    NAU7802_GAIN_64,
+    NAU7802_GAIN_128,
+} NAU7802_Gain;
+
+typedef enum _sample_rates
+{
+    NAU7802_RATE_10SPS = 0,
+    NAU7802_RATE_20SPS = 1,
+    NAU7802_RATE_40SPS = 2,
+    NAU7802_RATE_80SPS = 3,
+    NAU7802_RATE_320SPS = 7,
+} NAU7802_SampleRate;
@@ -0,0 +1,232 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core that the config structs (ConfigStructs),
+// DataEvent and the JSON pool use: String, Stream, the log_x macros and the critical section
+// macros. Only for host tools that link those libraries, see the soak env in platformio.ini.
+// millis() and micros() are defined by the tool, on its own clock.
+//
+// String keeps its text in a std::string: like on the box, texts longer than the inline
+// buffer allocate, which the soak counts.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <utility>
+
+uint32_t millis();
+uint32_t micros();
+
+// errors and warnings go to stderr, the rest is dropped
+#define log_e(format, ...) fprintf(stderr, "[E] " format "\n", ##__VA_ARGS__)
+#define log_w(format, ...) fprintf(stderr, "[W] " format "\n", ##__VA_ARGS__)
+#define log_i(format, ...) ((void)0)
+#define log_d(format, ...) ((void)0)
+#define log_v(format, ...) ((void)0)
+
+#define F(text) (text)
+
+// single threaded on the host
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+#if defined(__GLIBC__) && (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t length = strlen(src);
+    if (size)
+    {
+        size_t copy = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, copy);
+        dst[copy] = 0;
+    }
+    return length;
+}
+#endif
+
+class String
+{
+private:
+    std::string _text;
+
+    static std::string number(long value)
+    {
+        char text[24];
+        snprintf(text, sizeof(text), "%ld", value);
+        return text;
+    }
+
+    static std::string number(unsigned long value)
+    {
+        char text[24];
+        snprintf(text, sizeof(text), "%lu", value);
+        return text;
+    }
+
+    static std::string number(double value, unsigned int digits)
+    {
+        char text[48];
+        snprintf(text, sizeof(text), "%.*f", (int)digits, value);
+        return text;
+    }
+
+public:
+    String() {}
+    String(const char *text) : _text(text ? text : "") {}
+    String(const String &other) = default;
+    String(String &&other) = default;
+    explicit String(char c) : _text(1, c) {}
+    explicit String(int value) : _text(number((long)value)) {}
+    explicit String(unsigned int value) : _text(number((unsigned long)value)) {}
+    explicit String(long value) : _text(number(value)) {}
+    explicit String(unsigned long value) : _text(number(value)) {}
+    explicit String(float value, unsigned int digits = 2) : _text(number(value, digits)) {}
+    explicit String(double value, unsigned int digits = 2) : _text(number(value, digits)) {}
+
+    String &operator=(const String &other) = default;
+    String &operator=(String &&other) = default;
+    // ArduinoJson resets a String it writes to with a null pointer
+    String &operator=(const char *text)
+    {
+        _text.assign(text ? text : "");
+        return *this;
+    }
+
+    const char *c_str() const { return _text.c_str(); }
+    unsigned int length() const { return _text.length(); }
+    bool isEmpty() const { return _text.empty(); }
+    bool reserve(unsigned int size)
+    {
+        _text.reserve(size);
+        return true;
+    }
+    char operator[](unsigned int index) const { return index < _text.length() ? _text[index] : 0; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    bool concat(const char *text)
+    {
+        if (text)
+            _text.append(text);
+        return true;
+    }
+    bool concat(const String &other) { return concat(other.c_str()); }
+    bool concat(char c)
+    {
+        _text.push_back(c);
+        return true;
+    }
+    String &operator+=(const char *text)
+    {
+        concat(text);
+        return *this;
+    }
+    String &operator+=(const String &other)
+    {
+        concat(other);
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        concat(c);
+        return *this;
+    }
+
+    bool operator==(const String &other) const { return _text == other._text; }
+    bool operator==(const char *text) const { return _text == (text ? text : ""); }
+    bool operator!=(const String &other) const { return !(*this == other); }
+    bool operator!=(const char *text) const { return !(*this == text); }
+    bool operator<(const String &other) const { return _text < other._text; }
+
+    bool startsWith(const String &prefix) const { return _text.compare(0, prefix.length(), prefix._text) == 0; }
+    bool endsWith(const String &suffix) const
+    {
+        return suffix.length() <= length() && _text.compare(length() - suffix.length(), suffix.length(), suffix._text) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const
+    {
+        size_t found = _text.find(c, from);
+        return found == std::string::npos ? -1 : (int)found;
+    }
+    int indexOf(const String &text, unsigned int from = 0) const
+    {
+        size_t found = _text.find(text._text, from);
+        return found == std::string::npos ? -1 : (int)found;
+    }
+    int lastIndexOf(char c) const
+    {
+        size_t found = _text.rfind(c);
+        return found == std::string::npos ? -1 : (int)found;
+    }
+
+    String substring(unsigned int from) const { return from < length() ? String(_text.substr(from).c_str()) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (from > to)
+            std::swap(from, to);
+        return from < length() ? String(_text.substr(from, to - from).c_str()) : String();
+    }
+
+    long toInt() const { return strtol(c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(c_str(), nullptr); }
+    double toDouble() const { return strtod(c_str(), nullptr); }
+};
+
+// result type of the + operators, ArduinoJson adapts it like String
+class StringSumHelper : public String
+{
+public:
+    StringSumHelper(const String &text) : String(text) {}
+    StringSumHelper(const char *text) : String(text) {}
+};
+
+inline StringSumHelper operator+(const String &left, const String &right)
+{
+    StringSumHelper sum(left);
+    sum.concat(right);
+    return sum;
+}
+
+inline StringSumHelper operator+(const String &left, const char *right)
+{
+    StringSumHelper sum(left);
+    sum.concat(right);
+    return sum;
+}
+
+inline StringSumHelper operator+(const char *left, const String &right)
+{
+    StringSumHelper sum(left);
+    sum.concat(right);
+    return sum;
+}
+
+inline StringSumHelper operator+(const String &left, char right)
+{
+    StringSumHelper sum(left);
+    sum.concat(right);
+    return sum;
+}
+
+// byte source for deserializeJson(doc, file)
+class Stream
+{
+public:
+    virtual ~Stream() {}
+    virtual int available() = 0;
+    // next byte, -1 at the end
+    virtual int read() = 0;
+
+    size_t readBytes(char *buffer, size_t length)
+    {
+        size_t count = 0;
+        int c;
+        while (count < length && (c = read()) >= 0)
+            buffer[count++] = (char)c;
+        return count;
+    }
+};
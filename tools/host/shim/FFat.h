@@ -0,0 +1,60 @@
+#pragma once
+
+// Host stand-in for FFat: files in memory, read by BaseConfig::loadConfiguration and written
+// by the Storage.hpp stand-in in place of the FAT on flash.
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+
+#define FILE_READ "r"
+
+class File : public Stream
+{
+private:
+    std::string _content;
+    size_t _position = 0;
+    bool _open = false;
+
+public:
+    File() {}
+    File(const std::string &content) : _content(content), _open(true) {}
+
+    explicit operator bool() const { return _open; }
+    size_t size() const { return _content.size(); }
+
+    int available() override { return _open ? _content.size() - _position : 0; }
+    int read() override { return available() ? (uint8_t)_content[_position++] : -1; }
+
+    void close()
+    {
+        _open = false;
+        _content.clear();
+        _position = 0;
+    }
+};
+
+class FFatFS
+{
+private:
+    std::map<std::string, std::string> _files;
+
+public:
+    bool exists(const String &path) const { return _files.count(path.c_str()) != 0; }
+
+    // read only, the box writes through g_Storage
+    File open(const String &path, const char *mode = FILE_READ) const
+    {
+        auto file = _files.find(path.c_str());
+        return file == _files.end() ? File() : File(file->second);
+    }
+
+    bool remove(const String &path) { return _files.erase(path.c_str()) != 0; }
+
+    // for the Storage.hpp stand-in
+    void write(const char *path, const uint8_t *data, size_t length) { _files[path].assign((const char *)data, length); }
+    size_t fileCount() const { return _files.size(); }
+};
+
+inline FFatFS FFat;
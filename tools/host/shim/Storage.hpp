@@ -0,0 +1,112 @@
+#pragma once
+
+// Host stand-in for lib/Storage: the same request interface on the real StorageQueue,
+// without the lock and the task. The tool calls update_loop in place of Task_Storage, it
+// writes the replaced files into the FFat stand-in and runs the deferred work. Appends and
+// patches are not supported and complete as failed.
+
+#include <Arduino.h>
+#include <FFat.h>
+#include <StorageQueue.hpp>
+
+#define STORAGE_DEFERRED 4
+
+typedef void (*StorageWork)(void *context);
+
+struct StorageStats
+{
+    StorageQueueStats queue;
+};
+
+class StorageClass
+{
+private:
+    StorageQueue _queue;
+
+    struct Deferred
+    {
+        StorageWork work;
+        void *context;
+    };
+    Deferred _deferred[STORAGE_DEFERRED];
+    uint8_t _deferredCount = 0;
+
+public:
+    void initialize() {}
+
+    // writes the queued requests
+    void update_loop()
+    {
+        StorageJob job;
+        while (_queue.next(job))
+        {
+            uint32_t start = micros();
+            bool ok = job.mode == STORAGE_REPLACE;
+            if (ok)
+                FFat.write(job.path, job.data, job.length);
+
+            StorageResult result;
+            StorageCallback callback;
+            void *context;
+            _queue.complete(job, ok, micros() - start, micros(), result, callback, context);
+            if (callback)
+                callback(result, context);
+        }
+
+        for (uint8_t i = 0; i < _deferredCount; i++)
+            _deferred[i].work(_deferred[i].context);
+        _deferredCount = 0;
+    }
+
+    bool defer(StorageWork work, void *context = nullptr)
+    {
+        for (uint8_t i = 0; i < _deferredCount; i++)
+            if (_deferred[i].work == work && _deferred[i].context == context)
+                return true;
+        if (_deferredCount == STORAGE_DEFERRED)
+            return false;
+        _deferred[_deferredCount++] = {work, context};
+        return true;
+    }
+
+    bool submit(const char *path, StorageMode mode, const uint8_t *data, size_t length, uint32_t offset = 0,
+                StorageCallback callback = nullptr, void *context = nullptr, uint32_t wait_ms = 0)
+    {
+        return _queue.submit(path, mode, data, length, micros(), offset, callback, context);
+    }
+
+    template <typename Fill>
+    bool replace(const char *path, Fill fill, StorageCallback callback = nullptr, void *context = nullptr)
+    {
+        size_t capacity;
+        uint8_t *buffer = _queue.begin(path, STORAGE_REPLACE, 0, capacity, micros());
+        size_t length = buffer ? fill(buffer, capacity) : 0;
+        if (length > 0)
+            _queue.commit(length, 0, callback, context);
+        else if (buffer)
+            _queue.abort();
+        return length > 0;
+    }
+
+    template <typename Read>
+    bool readLatest(const char *path, Read read)
+    {
+        const uint8_t *data;
+        size_t length;
+        bool found = _queue.latest(path, data, length);
+        if (found)
+            read(data, length);
+        return found;
+    }
+
+    bool idle() const { return _queue.idle(); }
+
+    StorageStats getStats()
+    {
+        StorageStats stats;
+        stats.queue = _queue.getStats();
+        return stats;
+    }
+};
+
+inline StorageClass g_Storage;
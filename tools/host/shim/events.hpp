@@ -0,0 +1,57 @@
+#pragma once
+
+// Host stand-in for the esp32m events library: events are delivered synchronously to all
+// subscribers, in the task of the publisher, like on the box. Pattern matching of is() as
+// used by the firmware: '*' matches any part of the type, e.g. "*/saveconfiguration".
+
+#include <functional>
+#include <vector>
+
+namespace esp32m
+{
+    class Event
+    {
+    private:
+        const char *_type;
+
+        static bool matches(const char *pattern, const char *type)
+        {
+            if (*pattern == 0)
+                return *type == 0;
+            if (*pattern == '*')
+                return matches(pattern + 1, type) || (*type && matches(pattern, type + 1));
+            return *pattern == *type && matches(pattern + 1, type + 1);
+        }
+
+    public:
+        Event(const char *type) : _type(type) {}
+        virtual ~Event() {}
+
+        const char *type() const { return _type; }
+        bool is(const char *pattern) const { return matches(pattern, _type); }
+    };
+
+    typedef std::function<void(Event *)> EventHandler;
+
+    class EventManager
+    {
+    private:
+        std::vector<EventHandler> _handlers;
+
+    public:
+        static EventManager &instance()
+        {
+            static EventManager manager;
+            return manager;
+        }
+
+        // at startup, the handlers are kept for the run
+        void subscribe(EventHandler handler) { _handlers.push_back(handler); }
+
+        void publish(Event &event)
+        {
+            for (EventHandler &handler : _handlers)
+                handler(&event);
+        }
+    };
+}
@@ -0,0 +1,165 @@
+/*
+  ADC backend simulation
+
+  Runs the acquisition loop against AdcMock (the ADC backend interface of the firmware,
+  simulated) through LoadcellPipeline. The loop is a template over the backend like
+  LoadcellClass, so any host capable backend can be dropped in. Checks the converted value
+  against the expected force for a known bridge signal and reports rate and overruns.
+
+    adcsim                          simulated clock, 2000 SPS, 10 s, exit code 1 on mismatch
+    adcsim -r 2000 -w 400 -d 5      600 us per sample: more work than the sample period
+    adcsim -t -r 2000 -w 100        real time with sleeping waitReady
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <AdcMock.hpp>
+#include <LoadcellPipeline.hpp>
+
+struct AcquireResult
+{
+    uint32_t samples = 0;
+    uint32_t overruns = 0;
+    double seconds = 0;
+    double mean = 0; // converted value over the second half of the run
+};
+
+static uint64_t sim_clock_us = 0;
+
+static uint64_t sim_clock()
+{
+    return sim_clock_us;
+}
+
+static uint64_t monotonic_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void busy_wait_us(uint32_t us)
+{
+    uint64_t end = monotonic_us() + us;
+    while (monotonic_us() < end)
+        ;
+}
+
+// same sequence as LoadcellClass::update_loop and Task_Loadcell
+template <typename Adc>
+static AcquireResult acquire(Adc &adc, LoadcellPipeline &pipeline, double seconds, uint32_t work_us, bool realtime)
+{
+    AcquireResult result;
+    uint64_t start = realtime ? monotonic_us() : sim_clock_us;
+    uint64_t duration = (uint64_t)(seconds * 1e6);
+    uint64_t half = start + duration / 2;
+    uint32_t mean_count = 0;
+
+    while (true)
+    {
+        uint64_t now = realtime ? monotonic_us() : sim_clock_us;
+        if (now - start >= duration)
+            break;
+
+        if (adc.available())
+        {
+            int32_t raw = adc.read();
+            pipeline.process(raw, (uint32_t)now, adc.readFailed());
+            result.samples++;
+
+            if (now >= half)
+            {
+                mean_count++;
+                result.mean += (pipeline.getConverted() - result.mean) / mean_count;
+            }
+
+            // consumers of the sample: history, alarm, streaming
+            if (realtime)
+                busy_wait_us(work_us);
+            else
+                sim_clock_us += work_us;
+        }
+
+        if (realtime)
+            adc.waitReady(1);
+        else
+            sim_clock_us += 100; // polling granularity of the simulated task
+    }
+
+    result.seconds = ((realtime ? monotonic_us() : sim_clock_us) - start) / 1e6;
+    result.overruns = adc.getOverruns();
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    AdcMockConfig config;
+    config.signal_mv_per_v = 1.0;
+    config.noise_counts = 200;
+    float sensitivity = 2.0; // mV/V at full range
+    float fullrange = 1000.0;
+    double seconds = 10;
+    uint32_t work_us = 50;
+    bool realtime = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:g:s:n:d:w:th")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            config.samplerate = atof(optarg);
+            break;
+        case 'g':
+            config.gain = atoi(optarg);
+            break;
+        case 's':
+            config.signal_mv_per_v = atof(optarg);
+            break;
+        case 'n':
+            config.noise_counts = atof(optarg);
+            break;
+        case 'd':
+            seconds = atof(optarg);
+            break;
+        case 'w':
+            work_us = atoi(optarg);
+            break;
+        case 't':
+            realtime = true;
+            break;
+        default:
+            fprintf(stderr, "usage: adcsim [-r SPS] [-g gain log2] [-s signal mV/V] [-n noise counts] [-d seconds] [-w work us per sample] [-t real time]\n");
+            return 2;
+        }
+    }
+
+    AdcMock adc;
+    if (!realtime)
+        adc.setClock(sim_clock);
+    adc.begin();
+    adc.configure(config);
+
+    PipelineParams params;
+    params.sensor_scale_factor = PipelineParams::calcScaleFactor(AdcMock::FULL_SCALE_COUNTS, config.gain, sensitivity, config.cali_gain_factor, fullrange);
+    params.sensor_zero_balance_raw = 0;
+    LoadcellPipeline pipeline;
+    pipeline.configure(params);
+
+    AcquireResult result = acquire(adc, pipeline, seconds, work_us, realtime);
+
+    float expected = config.signal_mv_per_v / sensitivity * fullrange;
+    float tolerance = fullrange * 1e-4f + 4.0f * config.noise_counts / params.sensor_scale_factor;
+    bool ok = fabs(result.mean - expected) <= tolerance;
+
+    printf("backend %s, %s clock, %.0f SPS configured\n", AdcMock::NAME, realtime ? "real time" : "simulated", adc.getSampleRate());
+    printf("samples %u in %.2f s: %.1f SPS, overruns %u (%.2f%%)\n", result.samples, result.seconds, result.samples / result.seconds,
+           result.overruns, 100.0 * result.overruns / (result.samples + result.overruns));
+    printf("converted mean %.4f, expected %.4f +- %.4f: %s\n", result.mean, expected, tolerance, ok ? "ok" : "MISMATCH");
+
+    return ok ? 0 : 1;
+}
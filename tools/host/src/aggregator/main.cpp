@@ -0,0 +1,515 @@
+/*
+  Multi-box aggregator
+
+  Discovers strain gauge boxes by mDNS (_sgbox._tcp.local) or takes host[:port] arguments,
+  subscribes to the "samples" event stream of all boxes at the same time (every sample with
+  its acquisition timestamp, see SampleBlock.hpp) and merges them into one stream aligned
+  by timestamp.
+
+  Box timestamps are micros() of each box, unwrapped to 64 bit. The boxes have no common
+  clock, the offset to host time is estimated per box from the blocks themselves: every
+  block arrives at least the transport latency after its last sample, so
+    offset = min(receive time - timestamp of the last sample)
+  over a sliding window (-w, default 10 s) is the box clock at the lowest latency seen. The
+  window lets the offset follow the crystal drift of the box (up to ~50 ppm) and
+  reconnects. The alignment error between two boxes is the difference of their lowest
+  latencies (same network: well below a millisecond on a quiet WLAN, it grows with load)
+  plus the drift within the window, 0.5 ms at 50 ppm and 10 s. The drift itself is
+  reported at the end from the offset change.
+
+  Output is one csv line per interval:
+    host_time_ms,<box1>,<box2>,...
+  with the value of each box linearly interpolated between its two samples around that
+  time, empty if there are none or samples between them were lost.
+
+  Test without hardware against simulated boxes on loopback, see simbox.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SampleBlock.hpp>
+
+#define MDNS_ADDRESS "224.0.0.251"
+#define MDNS_PORT 5353
+#define MDNS_SERVICE_NAME "_sgbox._tcp.local"
+#define BOX_HISTORY 8192 // samples, 25 s at 320 SPS
+
+struct Sample
+{
+    uint32_t index;
+    int64_t box_us; // unwrapped
+    float value;
+};
+
+struct Latency
+{
+    int64_t received_us;
+    int64_t latency_us; // receive time - box time of the last sample of a block
+};
+
+struct Box
+{
+    std::string host;
+    uint16_t port = 80;
+    std::string name;
+
+    std::mutex mutex;
+    std::deque<Sample> samples;
+    std::deque<Latency> latencies; // increasing latency, front is the window minimum
+    int64_t offset_us = 0;         // host time - box time
+    bool synced = false;
+    bool connected = false;
+    uint32_t received = 0;
+    uint32_t lost = 0;
+
+    // drift from the offset change since the first full window
+    int64_t connected_us = 0;
+    int64_t reference_us = 0;
+    int64_t reference_offset_us = 0;
+};
+
+static std::atomic<bool> running(true);
+static int64_t window_us = 10000000;
+
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t now_ms()
+{
+    return now_us() / 1000;
+}
+
+// ---- mDNS discovery ----
+
+static size_t encode_name(const char *name, uint8_t *out)
+{
+    size_t pos = 0;
+    while (*name)
+    {
+        size_t len = strcspn(name, ".");
+        out[pos++] = (uint8_t)len;
+        memcpy(out + pos, name, len);
+        pos += len;
+        name += len;
+        if (*name == '.')
+            name++;
+    }
+    out[pos++] = 0;
+    return pos;
+}
+
+// skip a (possibly compressed) name, returns new offset or 0 on error
+static size_t skip_name(const uint8_t *packet, size_t size, size_t pos)
+{
+    while (pos < size)
+    {
+        uint8_t len = packet[pos];
+        if (len == 0)
+            return pos + 1;
+        if ((len & 0xC0) == 0xC0)
+            return pos + 2;
+        pos += len + 1;
+    }
+    return 0;
+}
+
+static uint16_t read16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static void discover(std::vector<Box *> &boxes, int seconds)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return;
+    }
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    bind(sock, (sockaddr *)&local, sizeof(local));
+
+    // query: one PTR question for the service
+    uint8_t query[512] = {0};
+    size_t len = 12;
+    query[5] = 1; // qdcount
+    len += encode_name(MDNS_SERVICE_NAME, query + len);
+    query[len++] = 0;
+    query[len++] = 12; // PTR
+    query[len++] = 0;
+    query[len++] = 1; // IN
+
+    sockaddr_in mdns = {};
+    mdns.sin_family = AF_INET;
+    mdns.sin_port = htons(MDNS_PORT);
+    inet_pton(AF_INET, MDNS_ADDRESS, &mdns.sin_addr);
+    sendto(sock, query, len, 0, (sockaddr *)&mdns, sizeof(mdns));
+
+    int64_t end = now_ms() + seconds * 1000;
+    while (now_ms() < end)
+    {
+        pollfd pfd = {sock, POLLIN, 0};
+        if (poll(&pfd, 1, (int)(end - now_ms())) <= 0)
+            break;
+
+        uint8_t packet[1500];
+        sockaddr_in from = {};
+        socklen_t from_len = sizeof(from);
+        ssize_t size = recvfrom(sock, packet, sizeof(packet), 0, (sockaddr *)&from, &from_len);
+        if (size < 12 || !(packet[2] & 0x80))
+            continue; // not a response
+
+        // walk all records, take the port of the first SRV record. address is the sender
+        uint16_t questions = read16(packet + 4);
+        uint16_t records = read16(packet + 6) + read16(packet + 8) + read16(packet + 10);
+        size_t pos = 12;
+        for (uint16_t i = 0; i < questions && pos; i++)
+            pos = skip_name(packet, size, pos) + 4;
+
+        uint16_t port = 0;
+        for (uint16_t i = 0; i < records && pos && pos + 10 <= (size_t)size; i++)
+        {
+            pos = skip_name(packet, size, pos);
+            if (!pos || pos + 10 > (size_t)size)
+                break;
+            uint16_t type = read16(packet + pos);
+            uint16_t rdlength = read16(packet + pos + 8);
+            pos += 10;
+            if (type == 33 && rdlength >= 6 && port == 0) // SRV
+                port = read16(packet + pos + 4);
+            pos += rdlength;
+        }
+        if (port == 0)
+            continue;
+
+        char address[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &from.sin_addr, address, sizeof(address));
+
+        bool known = false;
+        for (Box *box : boxes)
+            known |= (box->host == address && box->port == port);
+        if (known)
+            continue;
+
+        Box *box = new Box();
+        box->host = address;
+        box->port = port;
+        box->name = std::string(address) + ":" + std::to_string(port);
+        boxes.push_back(box);
+        fprintf(stderr, "discovered box %s\n", box->name.c_str());
+    }
+
+    close(sock);
+}
+
+// ---- event stream client ----
+
+static int connect_box(const Box &box)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result;
+    if (getaddrinfo(box.host.c_str(), std::to_string(box.port).c_str(), &hints, &result) != 0)
+        return -1;
+
+    int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (sock >= 0 && connect(sock, result->ai_addr, result->ai_addrlen) != 0)
+    {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(result);
+    return sock;
+}
+
+// a new connection starts a new timeline, the box may have rebooted meanwhile
+static void reset_box(Box &box)
+{
+    std::lock_guard<std::mutex> lock(box.mutex);
+    box.samples.clear();
+    box.latencies.clear();
+    box.synced = false;
+    box.connected_us = now_us();
+    box.reference_us = 0;
+}
+
+static void handle_event(Box &box, const std::string &event, const std::string &data)
+{
+    if (event != SAMPLEBLOCK_CHANNEL)
+        return;
+
+    int64_t received_us = now_us();
+    SampleBlock block;
+    if (!SampleBlock::parse(data.c_str(), block))
+        return;
+
+    std::lock_guard<std::mutex> lock(box.mutex);
+    for (uint16_t i = 0; i < block.count; i++)
+    {
+        uint32_t index = block.index + i;
+        uint32_t timestamp = block.timestamp(i);
+        int64_t box_us = timestamp;
+        if (!box.samples.empty())
+        {
+            const Sample &last = box.samples.back();
+            if (index - last.index - 1 > UINT32_MAX / 2)
+                continue; // replayed after a reconnect, already known
+            box.lost += index - last.index - 1;
+            box_us = last.box_us + (int32_t)(timestamp - (uint32_t)last.box_us); // micros() wraps
+        }
+        box.samples.push_back({index, box_us, block.values[i]});
+        box.received++;
+    }
+    while (box.samples.size() > BOX_HISTORY)
+        box.samples.pop_front();
+
+    // sliding window minimum of the latency
+    Latency latency = {received_us, received_us - box.samples.back().box_us};
+    while (!box.latencies.empty() && box.latencies.back().latency_us >= latency.latency_us)
+        box.latencies.pop_back();
+    box.latencies.push_back(latency);
+    while (box.latencies.front().received_us < received_us - window_us)
+        box.latencies.pop_front();
+
+    box.offset_us = box.latencies.front().latency_us;
+    box.synced = true;
+    if (box.reference_us == 0 && received_us - box.connected_us >= window_us)
+    {
+        box.reference_us = received_us;
+        box.reference_offset_us = box.offset_us;
+    }
+}
+
+static void box_thread(Box *box)
+{
+    while (running)
+    {
+        int sock = connect_box(*box);
+        if (sock < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+
+        reset_box(*box);
+        std::string request = "GET /events?fields=" SAMPLEBLOCK_CHANNEL " HTTP/1.1\r\nHost: " + box->host + "\r\nAccept: text/event-stream\r\n\r\n";
+        send(sock, request.data(), request.size(), 0);
+        box->connected = true;
+
+        std::string buffer, line, event, data;
+        bool header_done = false;
+        char chunk[1024];
+
+        while (running)
+        {
+            pollfd pfd = {sock, POLLIN, 0};
+            if (poll(&pfd, 1, 200) == 0)
+                continue;
+
+            ssize_t len = recv(sock, chunk, sizeof(chunk), 0);
+            if (len <= 0)
+                break;
+            buffer.append(chunk, len);
+
+            size_t eol;
+            while ((eol = buffer.find('\n')) != std::string::npos)
+            {
+                line = buffer.substr(0, eol);
+                buffer.erase(0, eol + 1);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+
+                if (!header_done)
+                {
+                    header_done = line.empty();
+                    continue;
+                }
+
+                if (line.empty())
+                {
+                    handle_event(*box, event, data);
+                    event.clear();
+                    data.clear();
+                }
+                else if (line.compare(0, 7, "event: ") == 0)
+                    event = line.substr(7);
+                else if (line.compare(0, 6, "data: ") == 0)
+                    data = line.substr(6);
+            }
+        }
+
+        box->connected = false;
+        close(sock);
+    }
+}
+
+// ---- merge ----
+
+// linear between the samples around host time t_us, false if there are none or not consecutive
+static bool value_at(Box &box, int64_t t_us, float &value)
+{
+    std::lock_guard<std::mutex> lock(box.mutex);
+    if (!box.synced)
+        return false;
+
+    int64_t box_us = t_us - box.offset_us;
+    auto after = std::lower_bound(box.samples.begin(), box.samples.end(), box_us,
+                                  [](const Sample &sample, int64_t t)
+                                  { return sample.box_us < t; });
+    if (after == box.samples.end() || after == box.samples.begin())
+        return false;
+    auto before = after - 1;
+    if (after->index != before->index + 1)
+        return false;
+
+    float fraction = (float)(box_us - before->box_us) / (after->box_us - before->box_us);
+    value = before->value + fraction * (after->value - before->value);
+    return true;
+}
+
+// box clock rate against the host clock, 0 until a window after the first one
+static double drift_ppm(Box &box, int64_t t_us)
+{
+    std::lock_guard<std::mutex> lock(box.mutex);
+    if (box.reference_us == 0 || t_us - box.reference_us < window_us)
+        return 0;
+    return -1e6 * (box.offset_us - box.reference_offset_us) / (t_us - box.reference_us);
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: aggregator [options] [host[:port]...]\n"
+            "  -d SEC   mDNS discovery time, 0 disables (default: 3, disabled if hosts are given)\n"
+            "  -i MS    output interval (default: 100)\n"
+            "  -l MS    output delay to wait for late blocks (default: 500)\n"
+            "  -n N     stop after N output lines (default: run forever)\n"
+            "  -w SEC   clock offset window (default: 10)\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int discovery = -1;
+    int interval = 100;
+    int delay = 500;
+    long lines = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:i:l:n:w:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            discovery = atoi(optarg);
+            break;
+        case 'i':
+            interval = atoi(optarg);
+            break;
+        case 'l':
+            delay = atoi(optarg);
+            break;
+        case 'n':
+            lines = atol(optarg);
+            break;
+        case 'w':
+            window_us = atof(optarg) * 1e6;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (interval < 1 || delay < 0 || window_us < 1000000)
+        usage();
+
+    std::vector<Box *> boxes;
+    for (int i = optind; i < argc; i++)
+    {
+        Box *box = new Box();
+        std::string arg = argv[i];
+        size_t colon = arg.find(':');
+        box->host = arg.substr(0, colon);
+        if (colon != std::string::npos)
+            box->port = atoi(arg.c_str() + colon + 1);
+        box->name = arg;
+        boxes.push_back(box);
+    }
+
+    if (discovery < 0)
+        discovery = boxes.empty() ? 3 : 0;
+    if (discovery > 0)
+        discover(boxes, discovery);
+
+    if (boxes.empty())
+    {
+        fprintf(stderr, "no boxes found\n");
+        return 1;
+    }
+
+    std::vector<std::thread> threads;
+    for (Box *box : boxes)
+        threads.emplace_back(box_thread, box);
+
+    printf("time_ms");
+    for (Box *box : boxes)
+        printf(",%s", box->name.c_str());
+    printf("\n");
+
+    int64_t next = now_ms() + interval;
+    for (long n = 0; lines < 0 || n < lines; n++)
+    {
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::milliseconds(next)));
+
+        int64_t t = next - delay;
+        printf("%lld", (long long)t);
+        for (Box *box : boxes)
+        {
+            float value;
+            if (value_at(*box, t * 1000, value))
+                printf(",%.6g", value);
+            else
+                printf(",");
+        }
+        printf("\n");
+        fflush(stdout);
+
+        next += interval;
+    }
+
+    running = false;
+    for (std::thread &thread : threads)
+        thread.join();
+
+    int64_t end_us = now_us();
+    for (Box *box : boxes)
+    {
+        fprintf(stderr, "%s: %u samples, %u lost, offset %.3f ms, drift %+.1f ppm\n", box->name.c_str(), box->received, box->lost,
+                box->offset_us / 1000.0, drift_ppm(*box, end_us));
+        delete box;
+    }
+
+    return 0;
+}
@@ -0,0 +1,356 @@
+/*
+  Alarm engine verification
+
+  Checks the compiled rule table of AlarmEngine:
+    - above and below rules set at the level and clear only beyond the hysteresis band
+    - confirm_samples: the rule fires on the n-th consecutive sample beyond level, a sample
+      back inside restarts the count
+    - latch: stays active inside the band until acknowledged, fires again after the
+      acknowledge if still beyond level, acknowledge leaves non latching rules alone
+    - NAN (read error) is skipped, rule states and pending confirmations stay
+    - rules on one output are or-ed, disabled rules and invalid outputs are dropped, changed
+      rules are reported by configured index
+    - random rule tables and inputs against a plain per rule reference
+  Reports the cost per sample with ALARM_MAX_RULES rules.
+
+    alarm            all checks, exit code 1 on failure
+    alarm -s 7       seed of the random tables
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <AlarmEngine.hpp>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double value, double expected)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s: %g, expected %g\n", what, value, expected);
+    }
+}
+
+class Noise
+{
+private:
+    uint32_t _state;
+
+public:
+    Noise(uint32_t seed) : _state(seed ? seed : 1) {}
+
+    uint32_t next()
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+
+    // uniform in [low, high)
+    float uniform(float low, float high) { return low + (high - low) * (next() >> 8) / 16777216.0f; }
+};
+
+static AlarmRuleParams rule(AlarmMode mode, float level, float hysteresis, uint8_t output = 0, bool latch = false, uint8_t confirm = 1)
+{
+    AlarmRuleParams params;
+    params.enabled = true;
+    params.mode = mode;
+    params.level = level;
+    params.hysteresis = hysteresis;
+    params.output = output;
+    params.latch = latch;
+    params.confirm_samples = confirm;
+    return params;
+}
+
+// feeds the values, compares the output mask after each with the expected one ('0'/'1' per
+// sample for output 0)
+static void sequence(AlarmEngine &engine, const float *values, const char *expected, const char *what)
+{
+    for (int i = 0; expected[i]; i++)
+    {
+        uint8_t outputs = engine.process(values[i]);
+        check((outputs & 1) == (expected[i] == '1'), what, i, expected[i] - '0');
+    }
+}
+
+static void verifyHysteresis()
+{
+    AlarmEngine engine;
+
+    AlarmRuleParams above = rule(ALARM_ABOVE, 10, 2);
+    engine.compile(&above, 1);
+    const float up[] = {9.9f, 10, 9, 8.5f, 8, 7.99f, 9.99f, 10.5f, 11};
+    sequence(engine, up, "011110011", "above with hysteresis");
+
+    AlarmRuleParams below = rule(ALARM_BELOW, -5, 1);
+    engine.compile(&below, 1);
+    const float down[] = {-4.9f, -5, -4.5f, -4, -3.99f, -5.1f};
+    sequence(engine, down, "011101", "below with hysteresis");
+
+    // a negative hysteresis is taken as its magnitude, zero clears right below level
+    AlarmRuleParams negative = rule(ALARM_ABOVE, 10, -2);
+    engine.compile(&negative, 1);
+    const float band[] = {10, 8.5f, 7.9f};
+    sequence(engine, band, "110", "negative hysteresis");
+
+    AlarmRuleParams zero = rule(ALARM_ABOVE, 10, 0);
+    engine.compile(&zero, 1);
+    const float edge[] = {10, 10, 9.999f, 10};
+    sequence(engine, edge, "1101", "zero hysteresis");
+    printf("hysteresis: above, below, negative and zero band\n");
+}
+
+static void verifyConfirm()
+{
+    AlarmEngine engine;
+    AlarmRuleParams params = rule(ALARM_ABOVE, 10, 1, 0, false, 3);
+    engine.compile(&params, 1);
+
+    // two beyond, one back inside restarts the count, then three in a row
+    const float values[] = {11, 11, 9, 11, 11, 11, 11, 8.9f, 11, 11, 11};
+    sequence(engine, values, "00000110001", "confirm_samples 3");
+
+    // 0 is taken as 1
+    params.confirm_samples = 0;
+    engine.compile(&params, 1);
+    const float once[] = {11};
+    sequence(engine, once, "1", "confirm_samples 0");
+    printf("confirm: run of 3, restarted by a sample inside\n");
+}
+
+static void verifyLatch()
+{
+    AlarmEngine engine;
+    AlarmRuleParams params[2] = {rule(ALARM_ABOVE, 10, 1, 0, true, 2), rule(ALARM_BELOW, 0, 1, 1)};
+    engine.compile(params, 2);
+
+    const float values[] = {11, 11, 5, 5};
+    sequence(engine, values, "0111", "latched");
+
+    // the non latching rule on output 1 is not acknowledged
+    engine.process(-1);
+    engine.acknowledge();
+    check(engine.getOutputs() == 2, "outputs after acknowledge", engine.getOutputs(), 2);
+    check(engine.takeChangedRules() == 3, "changed rules around acknowledge", 0, 3);
+
+    // still beyond level after the acknowledge: fires again after confirm_samples
+    engine.process(11);
+    check(!(engine.getOutputs() & 1), "first sample after acknowledge", engine.getOutputs() & 1, 0);
+    engine.process(11);
+    check(engine.getOutputs() & 1, "second sample after acknowledge", engine.getOutputs() & 1, 1);
+    engine.acknowledge();
+    engine.process(5);
+    check(!(engine.getOutputs() & 1), "acknowledged inside the band", engine.getOutputs() & 1, 0);
+    printf("latch: held until acknowledged, fires again beyond level\n");
+}
+
+static void verifyNan()
+{
+    AlarmEngine engine;
+    AlarmRuleParams params = rule(ALARM_ABOVE, 10, 1, 0, false, 3);
+    engine.compile(&params, 1);
+
+    // a read error neither counts nor restarts the confirmation
+    const float values[] = {11, NAN, 11, NAN, NAN, 11, NAN, 5, NAN, 11};
+    sequence(engine, values, "0000011000", "NAN skipped");
+    check(engine.takeChangedRules() == 1, "changed rules with NAN", 0, 1);
+    printf("NAN: skipped, pending confirmation and state kept\n");
+}
+
+static void verifyTable()
+{
+    AlarmEngine engine;
+    AlarmRuleParams params[5] = {rule(ALARM_ABOVE, 10, 0, 2), rule(ALARM_ABOVE, 20, 0, 2), rule(ALARM_BELOW, 0, 0, 3),
+                                 rule(ALARM_ABOVE, 5, 0, ALARM_MAX_OUTPUTS), rule(ALARM_ABOVE, 1, 0, 0)};
+    params[4].enabled = false;
+    engine.compile(params, 5);
+
+    engine.process(15);
+    check(engine.getOutputs() == 4, "outputs at 15", engine.getOutputs(), 4);
+    check(engine.getActiveRules() == 1, "rules at 15", engine.getActiveRules(), 1);
+    engine.process(25);
+    check(engine.getOutputs() == 4 && engine.getActiveRules() == 3, "two rules on one output", engine.getActiveRules(), 3);
+    engine.process(-1);
+    check(engine.getOutputs() == 8 && engine.getActiveRules() == 4, "rule 2 by configured index", engine.getActiveRules(), 4);
+    check(engine.takeChangedRules() == 7, "changed rules", 0, 7);
+    check(engine.takeChangedRules() == 0, "changed rules taken", 0, 0);
+    printf("table: or-ed outputs, dropped rules, configured indexes\n");
+}
+
+// the rules as documented in AlarmRuleParams, without the compiled table
+class Reference
+{
+private:
+    AlarmRuleParams _params[ALARM_MAX_RULES];
+    bool _active[ALARM_MAX_RULES] = {};
+    int _pending[ALARM_MAX_RULES] = {};
+    uint8_t _count = 0;
+
+public:
+    void compile(const AlarmRuleParams *params, uint8_t count)
+    {
+        _count = count;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            _params[i] = params[i];
+            _active[i] = false;
+            _pending[i] = 0;
+        }
+    }
+
+    uint8_t process(float value)
+    {
+        uint8_t outputs = 0;
+        for (uint8_t i = 0; i < _count; i++)
+        {
+            const AlarmRuleParams &p = _params[i];
+            if (!p.enabled || p.output >= ALARM_MAX_OUTPUTS)
+                continue;
+            if (!isnan(value))
+            {
+                float h = fabsf(p.hysteresis);
+                bool beyond = p.mode == ALARM_ABOVE ? value >= p.level : value <= p.level;
+                bool inside = p.mode == ALARM_ABOVE ? value < p.level - h : value > p.level + h;
+                if (!_active[i])
+                {
+                    _pending[i] = beyond ? _pending[i] + 1 : 0;
+                    if (_pending[i] >= (p.confirm_samples ? p.confirm_samples : 1))
+                    {
+                        _active[i] = true;
+                        _pending[i] = 0;
+                    }
+                }
+                else if (!p.latch && inside)
+                {
+                    _active[i] = false;
+                }
+            }
+            if (_active[i])
+                outputs |= 1 << p.output;
+        }
+        return outputs;
+    }
+
+    void acknowledge()
+    {
+        for (uint8_t i = 0; i < _count; i++)
+        {
+            if (_params[i].latch)
+                _active[i] = false;
+        }
+    }
+};
+
+static void verifyRandom(Noise &rng)
+{
+    uint32_t samples = 0, mismatches = 0, transitions = 0;
+
+    for (int table = 0; table < 2000; table++)
+    {
+        AlarmRuleParams params[ALARM_MAX_RULES];
+        uint8_t count = 1 + rng.next() % ALARM_MAX_RULES;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            params[i] = rule(rng.next() % 2 ? ALARM_BELOW : ALARM_ABOVE, rng.uniform(-10, 10), rng.uniform(-2, 4),
+                             rng.next() % (ALARM_MAX_OUTPUTS + 1), rng.next() % 3 == 0, rng.next() % 5);
+            params[i].enabled = rng.next() % 8 != 0;
+        }
+
+        AlarmEngine engine;
+        Reference reference;
+        engine.compile(params, count);
+        reference.compile(params, count);
+
+        uint8_t last = 0;
+        float value = 0;
+        for (int n = 0; n < 500; n++)
+        {
+            // a random walk across the levels with read errors, samples exactly on a level
+            // and acknowledges in between
+            uint32_t r = rng.next() % 100;
+            if (r < 3)
+            {
+                engine.acknowledge();
+                reference.acknowledge();
+            }
+            value += rng.uniform(-1.5f, 1.5f);
+            value = value > 15 ? 15 : value < -15 ? -15 : value;
+            float input = r < 6 ? NAN : r < 9 ? params[r % count].level : value;
+
+            uint8_t expected = reference.process(input);
+            uint8_t outputs = engine.process(input);
+            mismatches += outputs != expected || engine.getOutputs() != expected;
+            transitions += outputs != last;
+            last = outputs;
+            samples++;
+        }
+    }
+
+    printf("random: %u samples of 2000 tables, %u output transitions, %u mismatches\n", samples, transitions, mismatches);
+    check(mismatches == 0, "random tables against reference", mismatches, 0);
+    check(transitions > samples / 50, "random transitions", transitions, samples / 50);
+}
+
+static void benchmark(Noise &rng)
+{
+    AlarmRuleParams params[ALARM_MAX_RULES];
+    for (uint8_t i = 0; i < ALARM_MAX_RULES; i++)
+        params[i] = rule(i % 2 ? ALARM_BELOW : ALARM_ABOVE, i % 2 ? -8.0f + i : 8.0f - i, 0.5f, i % ALARM_MAX_OUTPUTS, i == 0, 1 + i % 3);
+    AlarmEngine engine;
+    engine.compile(params, ALARM_MAX_RULES);
+
+    // precomputed input, the loop measures the engine only. Swings across all levels
+    float values[4096];
+    for (float &value : values)
+        value = rng.uniform(-10, 10);
+
+    const uint32_t samples = 20000000;
+    volatile uint8_t sink = 0;
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t n = 0; n < samples; n++)
+        sink = engine.process(values[n % 4096]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    (void)sink;
+
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / samples;
+    printf("cost: %.1f ns per sample with %d rules (host)\n", ns, ALARM_MAX_RULES);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: alarm [-s seed]\n");
+            return 2;
+        }
+    }
+
+    Noise rng(seed);
+    verifyHysteresis();
+    verifyConfirm();
+    verifyLatch();
+    verifyNan();
+    verifyTable();
+    verifyRandom(rng);
+    benchmark(rng);
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
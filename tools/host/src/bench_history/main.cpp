@@ -0,0 +1,261 @@
+/*
+  History store benchmark
+
+  Feeds the HistoryStore with a synthetic load signal at a given sample rate and measures
+  insert cost per sample and query cost for random zoom windows. Checks the queries first:
+    - the whole session (the open ends of /api/history) on the finest level that fits,
+      with every complete entry of it
+    - from only, to beyond the newest entry, random windows: the points cover the range,
+      at most the requested number, and the next finer level would need more
+    - the same session with timestamps across the millis() wrap gives the same results
+
+    bench_history [-r rate SPS] [-s simulated seconds] [-c capacity] [-l levels] [-b base samples] [-p points]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <HistoryStore.hpp>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double value, double expected)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s: %g, expected %g\n", what, value, expected);
+    }
+}
+
+static double elapsed_s(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct QueryResult
+{
+    int8_t level = -1;
+    size_t count = 0;
+    int64_t first = 0; // offsets from the oldest entry, wrap safe
+    int64_t last = 0;
+};
+
+static QueryResult runQuery(const HistoryStore &store, uint32_t from_ms, uint32_t to_ms, size_t points)
+{
+    uint32_t oldest, newest;
+    store.getRange(oldest, newest);
+    QueryResult result;
+    result.level = store.query(from_ms, to_ms, points, [&](const HistoryEntry &entry)
+                               {
+                                   int64_t t = (uint32_t)(entry.t_ms - oldest);
+                                   if (result.count++ == 0)
+                                       result.first = t;
+                                   result.last = t; });
+    return result;
+}
+
+// points of a query cover [from, to] clipped to the stored range, the next finer level would
+// need more points or does not reach back to from
+static QueryResult verifyQuery(const HistoryStore &store, uint32_t from_ms, uint32_t to_ms, size_t points, double entry_ms, const char *what)
+{
+    uint32_t oldest, newest;
+    store.getRange(oldest, newest);
+    int64_t span = (uint32_t)(newest - oldest);
+    int64_t from = std::min<int64_t>((uint32_t)(from_ms - oldest), span);
+    int64_t to = std::min<int64_t>((uint32_t)(to_ms - oldest), span);
+
+    QueryResult result = runQuery(store, from_ms, to_ms, points);
+    double duration = entry_ms * (1 << result.level);
+    bool ok = result.level >= 0 && result.count > 0 && result.count <= points;
+    // the last complete entry of a level ends up to one entry before the newest sample
+    ok = ok && result.first <= from && result.last + 2 * duration > to;
+
+    if (ok && result.level > 0)
+    {
+        int64_t finer_oldest = 0;
+        store.visitLevel(result.level - 1, oldest, newest, 1, false, [&](const HistoryEntry &entry)
+                         { finer_oldest = (uint32_t)(entry.t_ms - oldest); });
+        size_t finer = store.visitLevel(result.level - 1, from_ms, to_ms, SIZE_MAX, true, [](const HistoryEntry &) {});
+        ok = finer > points || finer_oldest > from;
+    }
+    if (!ok)
+    {
+        printf("  %s: from %lld to %lld of %lld: level %d, %zu of %zu points %lld..%lld\n", what, (long long)from, (long long)to, (long long)span,
+               result.level, result.count, points, (long long)result.first, (long long)result.last);
+        check(false, what, result.level, -1);
+    }
+    return result;
+}
+
+static void fill(HistoryStore &store, const std::vector<float> &values, int rate, uint32_t start_ms)
+{
+    store.clear();
+    for (size_t i = 0; i < values.size(); i++)
+        store.add(start_ms + (uint32_t)(i * 1000ULL / rate), values[i]);
+}
+
+static void verify(HistoryStore &store, HistoryStore &wrapped, const std::vector<float> &values, int rate, int levels, int base, size_t points)
+{
+    double entry_ms = base * 1000.0 / rate;
+    const uint32_t wrap_start = UINT32_MAX - 1800000; // wraps after 30 min
+    fill(store, values, rate, 0);
+    fill(wrapped, values, rate, wrap_start);
+
+    // whole session: the finest level with all its complete entries within points
+    int expected_level = levels - 1;
+    for (int l = levels - 1; l >= 0 && values.size() / ((size_t)base << l) <= points; l--)
+        expected_level = l;
+    size_t expected_count = values.size() / ((size_t)base << expected_level);
+
+    uint32_t oldest, newest;
+    store.getRange(oldest, newest);
+    QueryResult all = verifyQuery(store, oldest, newest, points, entry_ms, "whole session");
+    printf("whole session: level %d, %zu points, %.1f..%.1f s\n", all.level, all.count, all.first / 1000.0, (all.last + entry_ms * (1 << all.level)) / 1000.0);
+    check(all.level == expected_level, "whole session level", all.level, expected_level);
+    check(all.count == expected_count, "whole session points", all.count, expected_count);
+
+    verifyQuery(store, newest / 2, newest, points, entry_ms, "from only");
+    verifyQuery(store, oldest, newest + 600000, points, entry_ms, "to beyond the newest");
+    QueryResult empty = runQuery(store, newest, oldest + 1, points);
+    check(empty.level < 0 && empty.count == 0, "inverted range", empty.count, 0);
+
+    // across the wrap: same levels, points and offsets
+    uint32_t w_oldest, w_newest;
+    wrapped.getRange(w_oldest, w_newest);
+    check(w_newest < w_oldest && (uint32_t)(w_newest - w_oldest) == newest - oldest, "span across the wrap", (uint32_t)(w_newest - w_oldest), newest - oldest);
+    QueryResult w_all = verifyQuery(wrapped, w_oldest, w_newest, points, entry_ms, "whole session across the wrap");
+    check(w_all.level == all.level && w_all.count == all.count, "whole session across the wrap", w_all.count, all.count);
+
+    std::mt19937 random(2);
+    std::uniform_int_distribution<uint32_t> position(oldest, newest);
+    std::uniform_int_distribution<size_t> point_count(1, points);
+    int mismatches = 0;
+    for (int q = 0; q < 2000; q++)
+    {
+        uint32_t a = position(random), b = position(random);
+        uint32_t from = std::min(a, b), to = std::max(a, b);
+        size_t n = q % 2 ? points : point_count(random);
+        // fewer points than the coarsest level needs: the checks assume the level fits
+        if (store.visitLevel(levels - 1, from, to, SIZE_MAX, true, [](const HistoryEntry &) {}) > n)
+            continue;
+        QueryResult plain = verifyQuery(store, from, to, n, entry_ms, "random window");
+        QueryResult wrap = verifyQuery(wrapped, wrap_start + from, wrap_start + to, n, entry_ms, "random window across the wrap");
+        mismatches += plain.level != wrap.level || plain.count != wrap.count || plain.first != wrap.first || plain.last != wrap.last;
+    }
+    check(mismatches == 0, "random windows across the wrap differ", mismatches, 0);
+}
+
+int main(int argc, char **argv)
+{
+    int rate = 320;
+    int seconds = 3600;
+    size_t capacity = 4096;
+    int levels = 12;
+    int base = 8;
+    size_t points = 500;
+    int queries = 10000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:s:c:l:b:p:q:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 's':
+            seconds = atoi(optarg);
+            break;
+        case 'c':
+            capacity = atoi(optarg);
+            break;
+        case 'l':
+            levels = atoi(optarg);
+            break;
+        case 'b':
+            base = atoi(optarg);
+            break;
+        case 'p':
+            points = atoi(optarg);
+            break;
+        case 'q':
+            queries = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: bench_history [-r rate] [-s seconds] [-c capacity] [-l levels] [-b base samples] [-p points] [-q queries]\n");
+            return 2;
+        }
+    }
+
+    size_t memory_size = HistoryStore::requiredMemory(capacity, levels);
+    std::vector<HistoryEntry> memory(memory_size / sizeof(HistoryEntry));
+    HistoryStore store;
+    if (!store.begin(memory.data(), capacity, levels, base))
+    {
+        fprintf(stderr, "invalid store configuration\n");
+        return 1;
+    }
+
+    HistoryStore wrapped;
+    std::vector<HistoryEntry> wrapped_memory(memory_size / sizeof(HistoryEntry));
+    wrapped.begin(wrapped_memory.data(), capacity, levels, base);
+
+    // synthetic load: slow ramps, vibration and noise
+    size_t samples = (size_t)rate * seconds;
+    std::vector<float> values(samples);
+    std::mt19937 random(1);
+    std::normal_distribution<float> noise(0, 0.5);
+    for (size_t i = 0; i < samples; i++)
+    {
+        double t = (double)i / rate;
+        values[i] = 100 * sin(t / 60) + 5 * sin(2 * M_PI * 12 * t) + noise(random);
+    }
+
+    verify(store, wrapped, values, rate, levels, base, points);
+    store.clear();
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < samples; i++)
+        store.add((uint32_t)(i * 1000ULL / rate), values[i]);
+    double insert_s = elapsed_s(start);
+
+    uint32_t oldest, newest;
+    store.getRange(oldest, newest);
+
+    std::uniform_int_distribution<uint32_t> position(oldest, newest);
+    size_t visited = 0;
+    int level_histogram[HISTORY_MAX_LEVELS] = {0};
+
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++)
+    {
+        uint32_t a = position(random);
+        uint32_t b = position(random);
+        int8_t level = store.query(a < b ? a : b, a < b ? b : a, points, [&](const HistoryEntry &entry)
+                                   { visited++; });
+        if (level >= 0)
+            level_histogram[level]++;
+    }
+    double query_s = elapsed_s(start);
+
+    printf("store: %zu levels x %zu entries, %zu bytes, base %d samples, span %.1f s\n",
+           (size_t)levels, capacity, memory_size, base, (newest - oldest) / 1000.0);
+    printf("insert: %zu samples in %.3f s, %.1f ns/sample, %.0f samples/s\n",
+           samples, insert_s, insert_s * 1e9 / samples, samples / insert_s);
+    printf("query: %d queries (max %zu points) in %.3f s, %.2f us/query, %.1f points/query\n",
+           queries, points, query_s, query_s * 1e6 / queries, (double)visited / queries);
+    printf("levels used:");
+    for (int i = 0; i < levels; i++)
+        printf(" %d", level_histogram[i]);
+    printf("\n");
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
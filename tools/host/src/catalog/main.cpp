@@ -0,0 +1,394 @@
+/*
+  Capture catalogue benchmark
+
+  Writes a directory of synthetic capture files with their catalogue index the way
+  CaptureClass does, then compares the cost of listing the sessions:
+    - directory walk with a stat per file, the listing without the index
+    - directory walk reading every capture header, a listing with metadata without the index
+    - rebuild of the index, reads every sample
+    - listing and filtering from the index, as GET /api/captures
+  Checks that the index matches the files and that filtered listings match a scan.
+  Host filesystem with a warm cache, FFat on the device pays far more per file opened.
+
+    catalog [-n captures] [-s samples per capture] [-d dir, kept] [-q queries]
+*/
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <CaptureCatalog.hpp>
+
+static double elapsed_s(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s\n", what);
+    }
+}
+
+static const char *sensors[] = {"K-1000", "K-2000", "S-beam 50", "Pancake 5k"};
+
+// one capture with a ramp to a random peak, every 7th capture was not closed
+static void writeCapture(const std::string &dir, uint32_t file_index, uint32_t samples, std::mt19937 &random, FILE *index)
+{
+    CaptureHeader header;
+    header.start_millis = file_index * 60000;
+    header.sample_rate = 320;
+    header.sensor_scale_factor = 2000.0f;
+    header.sensor_zero_balance_raw = 1000;
+    snprintf(header.sensor_name, sizeof(header.sensor_name), "%s", sensors[file_index % 4]);
+    snprintf(header.sensor_serial, sizeof(header.sensor_serial), "SN%05u", file_index % 10);
+    snprintf(header.displayunit, sizeof(header.displayunit), "N");
+
+    std::uniform_real_distribution<float> peak_dist(10, 1000);
+    float peak = peak_dist(random);
+    std::vector<CaptureSample> data(samples);
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        float value = peak * sinf((float)M_PI * i / samples);
+        data[i].timestamp_us = 4000000000u + i * 3125; // wraps during the capture
+        data[i].raw = (int32_t)lroundf(value * header.sensor_scale_factor) + header.sensor_zero_balance_raw;
+    }
+    bool closed = file_index % 7 != 0;
+    if (closed)
+        header.sample_count = samples;
+
+    char name[32];
+    catalogFilename(name, sizeof(name), file_index);
+    FILE *file = fopen((dir + "/" + name).c_str(), "wb");
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(data.data(), sizeof(CaptureSample), samples, file);
+    long size = ftell(file);
+    fclose(file);
+
+    // as CaptureClass on close, a capture that was not closed has no record until a rebuild
+    if (closed)
+    {
+        CatalogSummary summary;
+        summary.add(data.data(), samples);
+        CatalogRecord record;
+        summary.fill(record, header, file_index, size);
+        fwrite(&record, sizeof(record), 1, index);
+    }
+}
+
+static void openIndex(FILE *index)
+{
+    CatalogHeader header;
+    header.record_size = sizeof(CatalogRecord);
+    fwrite(&header, sizeof(header), 1, index);
+}
+
+static bool captureIndex(const char *name, uint32_t &file_index)
+{
+    unsigned int index;
+    if (sscanf(name, "cap_%u", &index) != 1)
+        return false;
+    file_index = index;
+    return true;
+}
+
+// listing without the index: names and sizes
+static size_t walkStat(const std::string &dir)
+{
+    size_t bytes = 0;
+    DIR *d = opendir(dir.c_str());
+    while (dirent *entry = readdir(d))
+    {
+        uint32_t file_index;
+        struct stat st;
+        if (captureIndex(entry->d_name, file_index) && stat((dir + "/" + entry->d_name).c_str(), &st) == 0)
+            bytes += st.st_size;
+    }
+    closedir(d);
+    return bytes;
+}
+
+// listing with metadata without the index: every capture header
+static size_t walkHeaders(const std::string &dir)
+{
+    size_t found = 0;
+    DIR *d = opendir(dir.c_str());
+    while (dirent *entry = readdir(d))
+    {
+        uint32_t file_index;
+        if (!captureIndex(entry->d_name, file_index))
+            continue;
+        FILE *file = fopen((dir + "/" + entry->d_name).c_str(), "rb");
+        CaptureHeader header;
+        if (file && fread(&header, sizeof(header), 1, file) == 1 && header.magic == CAPTURE_MAGIC)
+            found++;
+        if (file)
+            fclose(file);
+    }
+    closedir(d);
+    return found;
+}
+
+// as CaptureClass::rebuildCatalog
+static size_t rebuild(const std::string &dir)
+{
+    FILE *index = fopen((dir + "/index.tmp").c_str(), "wb");
+    openIndex(index);
+    size_t records = 0;
+    CaptureSample samples[64];
+
+    DIR *d = opendir(dir.c_str());
+    while (dirent *entry = readdir(d))
+    {
+        uint32_t file_index;
+        if (!captureIndex(entry->d_name, file_index))
+            continue;
+        FILE *file = fopen((dir + "/" + entry->d_name).c_str(), "rb");
+        CaptureHeader header;
+        if (file && fread(&header, sizeof(header), 1, file) == 1 && header.magic == CAPTURE_MAGIC)
+        {
+            CatalogSummary summary;
+            fseek(file, header.header_size, SEEK_SET);
+            size_t received;
+            while ((received = fread(samples, sizeof(CaptureSample), 64, file)) > 0)
+                summary.add(samples, received);
+            CatalogRecord record;
+            summary.fill(record, header, file_index, ftell(file));
+            fwrite(&record, sizeof(record), 1, index);
+            records++;
+        }
+        if (file)
+            fclose(file);
+    }
+    closedir(d);
+    fclose(index);
+    rename((dir + "/index.tmp").c_str(), (dir + "/" + (CATALOG_FILE + strlen(CAPTURE_DIR))).c_str());
+    return records;
+}
+
+static std::vector<CatalogRecord> readIndex(const std::string &dir)
+{
+    std::vector<CatalogRecord> records;
+    FILE *index = fopen((dir + "/" + (CATALOG_FILE + strlen(CAPTURE_DIR))).c_str(), "rb");
+    CatalogHeader header;
+    if (!index || fread(&header, sizeof(header), 1, index) != 1 || !catalogHeaderValid(header))
+    {
+        if (index)
+            fclose(index);
+        return records;
+    }
+    CatalogRecord record;
+    while (fread(&record, sizeof(record), 1, index) == 1)
+        records.push_back(record);
+    fclose(index);
+    return records;
+}
+
+// as GET /api/captures: read the index in blocks of 8 records, filter and format json
+static size_t listIndex(const std::string &dir, const CatalogFilter &filter, std::string &json, size_t &matched)
+{
+    json = "{\"captures\":[";
+    matched = 0;
+    FILE *index = fopen((dir + "/" + (CATALOG_FILE + strlen(CAPTURE_DIR))).c_str(), "rb");
+    CatalogHeader header;
+    if (fread(&header, sizeof(header), 1, index) != 1 || !catalogHeaderValid(header))
+    {
+        fclose(index);
+        return 0;
+    }
+    CatalogRecord records[8];
+    size_t count;
+    char line[384], name[24];
+    while ((count = fread(records, sizeof(CatalogRecord), 8, index)) > 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const CatalogRecord &record = records[i];
+            if (!filter.matches(record))
+                continue;
+            catalogFilename(name, sizeof(name), record.file_index);
+            snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"size\":%u,\"samples\":%u,\"min\":%.6g,\"max\":%.6g,\"sensor\":\"%s\"}",
+                     matched ? "," : "", name, record.file_size, record.sample_count, record.min, record.max, record.sensor_name);
+            json += line;
+            matched++;
+        }
+    }
+    fclose(index);
+    json += "]}";
+    return json.size();
+}
+
+static void verify(const std::string &dir, uint32_t captures, uint32_t samples, int queries)
+{
+    std::vector<CatalogRecord> records = readIndex(dir);
+    check(records.size() == captures, "one record per capture after the rebuild");
+
+    uint32_t recovered = 0;
+    for (const CatalogRecord &record : records)
+    {
+        if (record.flags & CATALOG_RECOVERED)
+            recovered++;
+        check(record.sample_count == samples, "sample count");
+        check(record.duration_ms == (uint32_t)((samples - 1) * 3125ull / 1000), "duration across the micros() wrap");
+        check(record.min > -0.01f && record.min < 0.01f, "minimum of the ramp");
+        check(record.max >= 10 && record.max <= 1000, "peak of the ramp");
+        check(strcmp(record.sensor_name, sensors[record.file_index % 4]) == 0, "sensor name");
+        check(record.data_offset == sizeof(CaptureHeader), "data offset");
+        check(record.file_size == sizeof(CaptureHeader) + samples * sizeof(CaptureSample), "file size");
+    }
+    printf("index: %zu records, %u recovered from captures not closed\n", records.size(), recovered);
+    check(recovered == (captures + 6) / 7, "captures not closed are recovered");
+
+    // filtered listings against a plain scan of the records
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> peak(0, 1100);
+    for (int q = 0; q < queries; q++)
+    {
+        CatalogFilter filter;
+        filter.min_peak = peak(random);
+        filter.max_peak = filter.min_peak + 300;
+        filter.sensor = q % 2 ? sensors[q % 4] : "SN0000";
+        filter.from_index = q;
+
+        size_t expected = 0;
+        for (const CatalogRecord &record : records)
+            if (record.file_index >= filter.from_index && record.max >= filter.min_peak && record.max <= filter.max_peak &&
+                (strstr(record.sensor_name, filter.sensor) || strstr(record.sensor_serial, filter.sensor)))
+                expected++;
+
+        std::string json;
+        size_t matched;
+        listIndex(dir, filter, json, matched);
+        if (matched != expected)
+        {
+            printf("  query %d: %zu matched, %zu expected\n", q, matched, expected);
+            check(false, "filtered listing");
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t captures = 1000;
+    uint32_t samples = 2000;
+    int queries = 100;
+    std::string dir;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:d:q:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            captures = atoi(optarg);
+            break;
+        case 's':
+            samples = atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        case 'q':
+            queries = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: catalog [-n captures] [-s samples per capture] [-d dir, kept] [-q queries]\n");
+            return 2;
+        }
+    }
+
+    bool keep = !dir.empty();
+    if (!keep)
+    {
+        char tmpl[] = "/tmp/catalogXXXXXX";
+        if (!mkdtemp(tmpl))
+        {
+            perror("mkdtemp");
+            return 1;
+        }
+        dir = tmpl;
+    }
+    else
+        mkdir(dir.c_str(), 0755);
+
+    std::mt19937 random(1);
+    FILE *index = fopen((dir + "/" + (CATALOG_FILE + strlen(CAPTURE_DIR))).c_str(), "wb");
+    if (!index)
+    {
+        perror(dir.c_str());
+        return 1;
+    }
+    openIndex(index);
+    for (uint32_t i = 0; i < captures; i++)
+        writeCapture(dir, i, samples, random, index);
+    fclose(index);
+    printf("%u captures of %u samples in %s\n", captures, samples, dir.c_str());
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = walkStat(dir);
+    double stat_s = elapsed_s(start);
+
+    start = std::chrono::steady_clock::now();
+    size_t headers = walkHeaders(dir);
+    double headers_s = elapsed_s(start);
+
+    start = std::chrono::steady_clock::now();
+    size_t appended = readIndex(dir).size();
+    size_t records = rebuild(dir);
+    double rebuild_s = elapsed_s(start);
+    printf("records before the rebuild: %zu, captures not closed have none\n", appended);
+
+    CatalogFilter all;
+    std::string json;
+    size_t matched = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++)
+        listIndex(dir, all, json, matched);
+    double list_s = elapsed_s(start) / queries;
+
+    CatalogFilter filter;
+    filter.min_peak = 500;
+    filter.sensor = "K-";
+    size_t filtered = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++)
+        listIndex(dir, filter, json, filtered);
+    double filter_s = elapsed_s(start) / queries;
+
+    printf("walk + stat:         %8.3f ms  (%zu bytes of captures, names and sizes only)\n", stat_s * 1e3, bytes);
+    printf("walk + headers:      %8.3f ms  (%zu headers)\n", headers_s * 1e3, headers);
+    printf("rebuild:             %8.3f ms  (%zu records, every sample read)\n", rebuild_s * 1e3, records);
+    printf("index, all:          %8.3f ms  (%zu records, %zu bytes json)\n", list_s * 1e3, matched, json.size());
+    printf("index, filtered:     %8.3f ms  (%zu records, peak >= 500, sensor K-)\n", filter_s * 1e3, filtered);
+    printf("per record %.2f us from the index, %.2f us per header from the files\n", list_s * 1e6 / captures, headers_s * 1e6 / captures);
+
+    check(headers == captures && records == captures, "capture files found");
+    verify(dir, captures, samples, queries);
+
+    if (!keep)
+    {
+        DIR *d = opendir(dir.c_str());
+        while (dirent *entry = readdir(d))
+            if (entry->d_name[0] != '.')
+                unlink((dir + "/" + entry->d_name).c_str());
+        closedir(d);
+        rmdir(dir.c_str());
+    }
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
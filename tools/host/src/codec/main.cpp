@@ -0,0 +1,354 @@
+/*
+  Sample codec benchmark
+
+  Compresses synthetic load profiles and recorded captures with SampleCodec in blocks, checks
+  that every block decodes to the exact input and reports per profile and prediction order:
+  bytes per sample, ratio to the raw capture layout (8 bytes) and to plain serial frames
+  (7 bytes), encode and decode speed in MB/s of raw samples and ns per sample. Serial frame
+  mode packs blocks into SP_MAX_PAYLOAD like SerialStream does.
+
+    codec                          synthetic profiles, exit code 1 on a round trip error
+    codec -b 256 cap_00001.sgc     block size, recorded captures (raw or encoded) in addition
+    codec -w DIR                   also write each synthetic profile as raw and encoded capture
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <CaptureFormat.hpp>
+#include <SampleCodec.hpp>
+#include <SerialProtocol.hpp>
+
+#define SPAN_COUNTS 2000000            // full range of the simulated sensor
+#define SERIAL_PENDING_SAMPLES 128 // SERIALSTREAM_PACKED_SAMPLES
+
+static int failures = 0;
+
+class Noise
+{
+private:
+    uint32_t _state = 1;
+
+public:
+    float next(float amplitude)
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return ((float)_state / 4294967296.0f * 2.0f - 1.0f) * amplitude;
+    }
+};
+
+struct Profile
+{
+    std::string name;
+    float sample_rate = 0;
+    bool recorded = false;
+    std::vector<CaptureSample> samples;
+};
+
+// timestamps at the sample period with interrupt jitter, raw from the signal function
+template <typename Signal>
+static Profile synthesize(const char *name, float rate, float seconds, float jitter_us, Signal signal)
+{
+    Profile profile;
+    profile.name = name;
+    profile.sample_rate = rate;
+    Noise rng;
+    size_t count = (size_t)(rate * seconds);
+    profile.samples.resize(count);
+    double period_us = 1e6 / rate;
+    for (size_t n = 0; n < count; n++)
+    {
+        profile.samples[n].timestamp_us = (uint32_t)(4000000000.0 + n * period_us + rng.next(jitter_us)); // wraps
+        profile.samples[n].raw = signal(n, n / (double)rate);
+    }
+    return profile;
+}
+
+static std::vector<Profile> syntheticProfiles()
+{
+    std::vector<Profile> profiles;
+    Noise noise;
+
+    profiles.push_back(synthesize("idle 320 SPS", 320, 60, 20, [&](size_t, double)
+                                  { return (int32_t)lround(150000 + noise.next(40)); }));
+    profiles.push_back(synthesize("idle 2000 SPS", 2000, 20, 5, [&](size_t, double)
+                                  { return (int32_t)lround(150000 + noise.next(15)); }));
+    profiles.push_back(synthesize("hx711 80 SPS noisy", 80, 300, 200, [&](size_t, double)
+                                  { return (int32_t)lround(150000 + noise.next(2000)); }));
+    profiles.push_back(synthesize("slow pull 320 SPS", 320, 60, 20, [&](size_t, double t)
+                                  { return (int32_t)lround(0.4 * SPAN_COUNTS * (1 - cos(2 * M_PI * t / 60)) + noise.next(40)); }));
+    profiles.push_back(synthesize("vibration 2000 SPS", 2000, 20, 5, [&](size_t, double t)
+                                  { return (int32_t)lround(300000 + 0.2 * SPAN_COUNTS * sin(2 * M_PI * 2 * t) + 0.02 * SPAN_COUNTS * sin(2 * M_PI * 80 * t) + noise.next(40)); }));
+    profiles.push_back(synthesize("drop tests 320 SPS", 320, 60, 20, [&](size_t n, double t)
+                                  {
+        // load steps every 5 s with a decaying ring
+        double since = fmod(t, 5.0);
+        double level = (n / 1600) % 2 ? 0.6 * SPAN_COUNTS : 0.05 * SPAN_COUNTS;
+        return (int32_t)lround(level + 0.1 * SPAN_COUNTS * exp(-since * 8) * sin(2 * M_PI * 12 * since) + noise.next(40)); }));
+    profiles.push_back(synthesize("spikes 320 SPS", 320, 60, 20, [&](size_t n, double)
+                                  { return (int32_t)lround(150000 + noise.next(40) + (n % 97 == 0 ? 0.8 * SPAN_COUNTS : 0)); }));
+    return profiles;
+}
+
+// raw or encoded capture file
+static bool loadCapture(const char *path, Profile &profile)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    CaptureHeader header;
+    if (fread(&header, 1, sizeof(header), file) < offsetof(CaptureHeader, encoding) || header.magic != CAPTURE_MAGIC)
+    {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        fclose(file);
+        return false;
+    }
+    fseek(file, header.header_size, SEEK_SET);
+
+    const char *slash = strrchr(path, '/');
+    profile.name = slash ? slash + 1 : path;
+    profile.recorded = true;
+    profile.sample_rate = header.sample_rate;
+    if (captureEncoding(header) == CAPTURE_ENCODING_RAW)
+    {
+        CaptureSample sample;
+        while (fread(&sample, sizeof(sample), 1, file) == 1)
+            profile.samples.push_back(sample);
+    }
+    else
+    {
+        std::vector<uint8_t> buffer(CODEC_MAX_BLOCK_SIZE(CODEC_MAX_BLOCK_SAMPLES));
+        std::vector<CaptureSample> block(CODEC_MAX_BLOCK_SAMPLES);
+        auto read = [file](uint8_t *data, size_t length)
+        { return fread(data, 1, length, file); };
+        size_t count;
+        while ((count = SampleCodec::readBlock(read, buffer.data(), buffer.size(), block.data(), block.size())) > 0)
+            profile.samples.insert(profile.samples.end(), block.begin(), block.begin() + count);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool writeCapture(const std::string &path, const Profile &profile, uint8_t encoding, size_t block_samples)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        perror(path.c_str());
+        return false;
+    }
+
+    CaptureHeader header;
+    header.sample_rate = profile.sample_rate;
+    header.sample_count = profile.samples.size();
+    header.sensor_scale_factor = SPAN_COUNTS / 1000.0f;
+    strncpy(header.sensor_name, "codec", sizeof(header.sensor_name) - 1);
+    strncpy(header.displayunit, "N", sizeof(header.displayunit) - 1);
+    header.encoding = encoding;
+    fwrite(&header, sizeof(header), 1, file);
+
+    if (encoding == CAPTURE_ENCODING_RAW)
+        fwrite(profile.samples.data(), sizeof(CaptureSample), profile.samples.size(), file);
+    else
+    {
+        std::vector<uint8_t> out(CODEC_MAX_BLOCK_SIZE(block_samples));
+        for (size_t pos = 0; pos < profile.samples.size();)
+        {
+            CodecResult result = SampleCodec::encodeBlock(&profile.samples[pos], std::min(block_samples, profile.samples.size() - pos), pos, out.data(), out.size());
+            fwrite(out.data(), 1, result.bytes, file);
+            pos += result.samples;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+struct Result
+{
+    size_t bytes = 0;
+    size_t blocks = 0;
+    double encode_s = 0;
+    double decode_s = 0;
+    size_t errors = 0;
+};
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// block_budget: output bytes per block, SP_MAX_PAYLOAD for serial frames, 0 for the worst case
+static Result run(const Profile &profile, size_t block_samples, size_t block_budget, CodecOrder order)
+{
+    Result result;
+    const std::vector<CaptureSample> &samples = profile.samples;
+    size_t out_size = block_budget ? block_budget : CODEC_MAX_BLOCK_SIZE(block_samples);
+    std::vector<uint8_t> stream(samples.size() * CODEC_MAX_SAMPLE_BYTES + (samples.size() + 1) * sizeof(CodecBlockHeader));
+    std::vector<size_t> offsets;
+
+    // repeat for at least 0.2 s, single blocks are far below the clock resolution
+    int repeats = 0;
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        size_t written = 0;
+        offsets.clear();
+        for (size_t pos = 0; pos < samples.size();)
+        {
+            size_t count = std::min(block_samples, samples.size() - pos);
+            CodecResult block = SampleCodec::encodeBlock(&samples[pos], count, pos, stream.data() + written, out_size, order);
+            offsets.push_back(written);
+            written += block.bytes;
+            pos += block.samples;
+        }
+        result.bytes = written;
+        repeats++;
+    } while (seconds(start) < 0.2);
+    result.encode_s = seconds(start) / repeats;
+    result.blocks = offsets.size();
+    offsets.push_back(result.bytes);
+
+    std::vector<CaptureSample> decoded(CODEC_MAX_BLOCK_SAMPLES);
+    repeats = 0;
+    start = std::chrono::steady_clock::now();
+    do
+    {
+        for (size_t b = 0; b + 1 < offsets.size(); b++)
+            SampleCodec::decodeBlock(stream.data() + offsets[b], offsets[b + 1] - offsets[b], decoded.data(), decoded.size());
+        repeats++;
+    } while (seconds(start) < 0.2);
+    result.decode_s = seconds(start) / repeats;
+
+    // round trip, outside of the timing
+    size_t pos = 0;
+    for (size_t b = 0; b + 1 < offsets.size(); b++)
+    {
+        const CodecBlockHeader *header = (const CodecBlockHeader *)(stream.data() + offsets[b]);
+        size_t count = SampleCodec::decodeBlock(stream.data() + offsets[b], offsets[b + 1] - offsets[b], decoded.data(), decoded.size());
+        if (count == 0 || header->first_index != pos || (block_budget && offsets[b + 1] - offsets[b] > block_budget))
+        {
+            result.errors++;
+            break;
+        }
+        for (size_t i = 0; i < count; i++)
+            if (decoded[i].timestamp_us != samples[pos + i].timestamp_us || decoded[i].raw != samples[pos + i].raw)
+                result.errors++;
+        pos += count;
+    }
+    if (pos != samples.size())
+        result.errors++;
+    return result;
+}
+
+static void report(const Profile &profile, const char *mode, const Result &result)
+{
+    size_t count = profile.samples.size();
+    double raw_mb = count * sizeof(CaptureSample) / 1e6;
+    double bytes_per_sample = (double)result.bytes / count;
+    printf("%-20s %-7s %8zu %8.2f %7.2f %7.2f %9.0f %9.0f %8.1f %8.1f%s\n", profile.name.c_str(), mode, count, bytes_per_sample,
+           sizeof(CaptureSample) / bytes_per_sample, SP_SAMPLE_SIZE / bytes_per_sample, raw_mb / result.encode_s, raw_mb / result.decode_s,
+           result.encode_s * 1e9 / count, result.decode_s * 1e9 / count, result.errors ? "  ROUND TRIP ERROR" : "");
+    if (result.errors)
+        failures++;
+}
+
+// corrupted and truncated blocks are rejected, not decoded to wrong samples
+static void verifyDamage(const Profile &profile)
+{
+    size_t count = std::min((size_t)128, profile.samples.size());
+    std::vector<uint8_t> block(CODEC_MAX_BLOCK_SIZE(count));
+    std::vector<CaptureSample> decoded(count);
+    CodecResult result = SampleCodec::encodeBlock(profile.samples.data(), count, 0, block.data(), block.size());
+
+    uint32_t accepted = 0;
+    for (size_t byte = sizeof(CodecBlockHeader); byte < result.bytes; byte++)
+    {
+        block[byte] ^= 0x10;
+        if (SampleCodec::decodeBlock(block.data(), result.bytes, decoded.data(), count))
+            accepted++;
+        block[byte] ^= 0x10;
+    }
+    uint32_t truncated = SampleCodec::decodeBlock(block.data(), result.bytes - 1, decoded.data(), count);
+    printf("damage: %u of %zu single bit errors in the payload accepted, truncated block %s\n", accepted, result.bytes - sizeof(CodecBlockHeader),
+           truncated ? "accepted" : "rejected");
+    if (accepted || truncated)
+        failures++;
+}
+
+int main(int argc, char **argv)
+{
+    size_t block_samples = 128;
+    const char *write_dir = nullptr;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:w:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            block_samples = atoi(optarg);
+            break;
+        case 'w':
+            write_dir = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: codec [-b block samples] [-w dir] [capture.sgc...]\n");
+            return 2;
+        }
+    }
+    if (block_samples < 1 || block_samples > CODEC_MAX_BLOCK_SAMPLES)
+    {
+        fprintf(stderr, "block samples 1..%u\n", CODEC_MAX_BLOCK_SAMPLES);
+        return 2;
+    }
+
+    std::vector<Profile> profiles = syntheticProfiles();
+    for (int i = optind; i < argc; i++)
+    {
+        Profile profile;
+        if (!loadCapture(argv[i], profile))
+            return 1;
+        profiles.push_back(profile);
+    }
+
+    printf("blocks of %zu samples, serial: blocks in %u byte frames\n", block_samples, SP_MAX_PAYLOAD);
+    printf("%-20s %-7s %8s %8s %7s %7s %9s %9s %8s %8s\n", "profile", "mode", "samples", "B/sample", "vs raw", "vs 7B",
+           "enc MB/s", "dec MB/s", "enc ns", "dec ns");
+    for (const Profile &profile : profiles)
+    {
+        if (profile.samples.empty())
+            continue;
+        report(profile, "auto", run(profile, block_samples, 0, CODEC_ORDER_AUTO));
+        report(profile, "order 1", run(profile, block_samples, 0, CODEC_ORDER_1));
+        report(profile, "order 2", run(profile, block_samples, 0, CODEC_ORDER_2));
+        report(profile, "serial", run(profile, SERIAL_PENDING_SAMPLES, SP_MAX_PAYLOAD, CODEC_ORDER_AUTO));
+
+        if (write_dir && !profile.recorded)
+        {
+            std::string name = profile.name;
+            for (char &c : name)
+                if (c == ' ')
+                    c = '_';
+            writeCapture(std::string(write_dir) + "/" + name + "_raw.sgc", profile, CAPTURE_ENCODING_RAW, block_samples);
+            writeCapture(std::string(write_dir) + "/" + name + ".sgc", profile, CAPTURE_ENCODING_DELTA_RICE, block_samples);
+        }
+    }
+
+    verifyDamage(profiles[0]);
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/*
+  Derived channels verification
+
+  Feeds analytic load curves with real (jittered, gapped, wrapping) timestamps through
+  DerivedChannels and LoadcellPipeline and compares rate, impulse and work with the
+  analytic derivative and integrals:
+    - rate of a parabola is exact at the window center, sine within the smoothing error
+    - impulse of offset + sine, work of a linear spring (exact for trapezoids)
+    - micros() wrap-around and tare reset of the integrals
+    - peak rate in the pipeline statistics
+  Reports the cost per sample for the largest window.
+
+    derived                 all checks, exit code 1 on failure
+    derived -w 15 -r 320    slope window and sample rate for the sine checks
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <DerivedChannels.hpp>
+#include <LoadcellPipeline.hpp>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double value, double expected)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s: %g, expected %g\n", what, value, expected);
+    }
+}
+
+// sample timestamps: nominal period with jitter, optional gap and start offset
+class Clock
+{
+private:
+    uint32_t _noise = 1;
+
+public:
+    uint32_t start_us = 0;
+    float period_us = 1000;
+    float jitter_us = 0;
+    uint32_t gap_at = 0; // sample index after which one sample is missing, 0: none
+
+    uint32_t timestamp(uint32_t n)
+    {
+        _noise ^= _noise << 13;
+        _noise ^= _noise >> 17;
+        _noise ^= _noise << 5;
+        float jitter = ((float)_noise / 4294967296.0f - 0.5f) * 2 * jitter_us;
+        if (gap_at > 0 && n > gap_at)
+            n++;
+        // one period margin, jitter must not move the first sample before start_us
+        return start_us + (uint32_t)lround((n + 1) * period_us + jitter);
+    }
+};
+
+// seconds since the first sample, unwrapped
+static double seconds(uint32_t timestamp_us, uint32_t start_us)
+{
+    return (uint32_t)(timestamp_us - start_us) * 1e-6;
+}
+
+// slope window center in seconds, the time the rate estimate belongs to
+static double windowCenter(const uint32_t *history, uint32_t n, uint8_t window, uint32_t start_us)
+{
+    uint8_t count = n + 1 < window ? n + 1 : window;
+    double sum = 0;
+    for (uint8_t i = 0; i < count; i++)
+        sum += seconds(history[(n - i) % DERIVED_RATE_WINDOW_MAX], start_us);
+    return sum / count;
+}
+
+static void verifyParabola(uint8_t window)
+{
+    // F = a t^2 + b t + c, uniform sampling: the slope is exact at the window center
+    const double a = 3.0, b = -2.0, c = 100.0;
+    DerivedParams params;
+    params.rate_window = window;
+    DerivedChannels derived;
+    derived.configure(params);
+
+    Clock clock;
+    clock.period_us = 1000;
+    uint32_t history[DERIVED_RATE_WINDOW_MAX];
+    double worst = 0;
+    for (uint32_t n = 0; n < 2000; n++)
+    {
+        uint32_t ts = clock.timestamp(n);
+        history[n % DERIVED_RATE_WINDOW_MAX] = ts;
+        double t = seconds(ts, 0);
+        derived.process(a * t * t + b * t + c, ts);
+        if (n + 1 >= window)
+        {
+            double expected = 2 * a * windowCenter(history, n, window, 0) + b;
+            worst = fmax(worst, fabs(derived.getRate() - expected));
+        }
+    }
+    printf("parabola, window %2u: max rate error %.2e /s\n", window, worst);
+    check(worst < 1e-3 * 2 * a * 2.0, "parabola rate error", worst, 0);
+}
+
+static void verifySine(uint8_t window, float rate, float jitter_us, uint32_t start_us)
+{
+    // F = C + A sin(wt), rate at the window center, smoothing error ~ (window*w/rate)^2 / 6
+    const double A = 50.0, C = 200.0, f = 2.0, w = 2 * M_PI * f;
+    DerivedParams params;
+    params.rate_window = window;
+    DerivedChannels derived;
+    derived.configure(params);
+
+    Clock clock;
+    clock.start_us = start_us;
+    clock.period_us = 1e6f / rate;
+    clock.jitter_us = jitter_us;
+    clock.gap_at = (uint32_t)(rate * 3.3f);
+    Clock replay = clock; // same jitter sequence for the first timestamp
+
+    uint32_t history[DERIVED_RATE_WINDOW_MAX];
+    uint32_t samples = (uint32_t)(rate * 10);
+    uint32_t first = replay.timestamp(0), last = 0;
+    double worst = 0;
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        uint32_t ts = clock.timestamp(n);
+        history[n % DERIVED_RATE_WINDOW_MAX] = ts;
+        double t = seconds(ts, start_us);
+        derived.process(C + A * sin(w * t), ts);
+        if (n + 1 >= window)
+        {
+            double center = windowCenter(history, n, window, start_us);
+            worst = fmax(worst, fabs(derived.getRate() - A * w * cos(w * center)));
+        }
+        last = ts;
+    }
+
+    // from the first sample on: G(t) = C t - A cos(wt) / w
+    double t0 = seconds(first, start_us), T = seconds(last, start_us);
+    double impulse = C * (T - t0) - A * (cos(w * T) - cos(w * t0)) / w;
+    double impulse_error = fabs(derived.getImpulse() - impulse) / impulse;
+
+    double smoothing = pow(window * w / rate, 2) / 6.0 + 0.01;
+    printf("sine %.0f SPS, window %2u, jitter %3.0f us, start %10u: rate error %.3f%% of peak, impulse error %.1e\n",
+           rate, window, jitter_us, start_us, worst / (A * w) * 100, impulse_error);
+    check(worst < smoothing * A * w, "sine rate error", worst, 0);
+    check(impulse_error < 1e-5, "sine impulse relative error", impulse_error, 0);
+    check(isnan(derived.getWork()), "work without displacement", derived.getWork(), NAN);
+}
+
+static void verifyWork()
+{
+    // linear spring F = k x, x = v t: trapezoids are exact, W = k x^2 / 2
+    const double k = 20.0, v = 0.005;
+    DerivedChannels derived;
+    derived.configure(DerivedParams());
+    derived.setDisplacement(0);
+    derived.resetIntegrals();
+
+    Clock clock;
+    clock.period_us = 1e6f / 320;
+    clock.jitter_us = 100;
+    double x = 0;
+    for (uint32_t n = 0; n < 3200; n++)
+    {
+        uint32_t ts = clock.timestamp(n);
+        x = v * seconds(ts, 0);
+        derived.setDisplacement(x);
+        derived.process(k * x, ts);
+    }
+    double expected = k * x * x / 2;
+    double error = fabs(derived.getWork() - expected) / expected;
+    printf("work of a spring: %.6f, expected %.6f, error %.1e\n", derived.getWork(), expected, error);
+    check(error < 1e-4, "work relative error", error, 0);
+
+    derived.resetIntegrals();
+    check(derived.getImpulse() == 0 && derived.getWork() == 0, "integrals after tare", derived.getImpulse(), 0);
+    derived.setDisplacement(x + 0.01);
+    derived.process(k * (x + 0.01), clock.timestamp(3200));
+    expected = k * (x + 0.005) * 0.01;
+    check(fabs(derived.getWork() - expected) < 1e-6, "work after tare", derived.getWork(), expected);
+}
+
+static void verifyPipeline()
+{
+    // raw counts -> displayunit, peak rate in the statistics
+    PipelineParams params;
+    params.sensor_scale_factor = 1000.0;
+    params.sensor_zero_balance_raw = 5000;
+    params.derived.rate_window = 9;
+    LoadcellPipeline pipeline;
+    pipeline.configure(params);
+
+    const double A = 10.0, f = 1.0, w = 2 * M_PI * f, rate = 2000;
+    for (uint32_t n = 0; n < rate * 5; n++)
+    {
+        uint32_t ts = (uint32_t)(n * 1e6 / rate);
+        double force = A * sin(w * n / rate);
+        pipeline.process(5000 + (int32_t)lround(force * 1000.0), ts);
+    }
+
+    const PipelineStats &stats = pipeline.getStats();
+    double peak = A * w;
+    printf("pipeline: rate_min %.3f rate_max %.3f, analytic +-%.3f, impulse %.2e\n", stats.rate_min, stats.rate_max, peak, pipeline.getDerived().getImpulse());
+    check(fabs(stats.rate_max - peak) < 0.01 * peak, "peak rate", stats.rate_max, peak);
+    check(fabs(stats.rate_min + peak) < 0.01 * peak, "negative peak rate", stats.rate_min, -peak);
+    // whole periods: impulse of the sine is zero, up to the quantization of the raw counts
+    check(fabs(pipeline.getDerived().getImpulse()) < 1e-3, "impulse over whole periods", pipeline.getDerived().getImpulse(), 0);
+
+    pipeline.resetIntegrals();
+    check(pipeline.getDerived().getImpulse() == 0, "impulse after tare", pipeline.getDerived().getImpulse(), 0);
+}
+
+static void benchmark()
+{
+    DerivedParams params;
+    params.rate_window = DERIVED_RATE_WINDOW_MAX;
+    DerivedChannels derived;
+    derived.configure(params);
+    derived.setDisplacement(0);
+
+    const uint32_t samples = 5000000;
+    volatile float sink = 0;
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        derived.setDisplacement(n * 1e-6f);
+        derived.process((float)(n % 1000), n * 500);
+        sink = derived.getRate();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    (void)sink;
+
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / samples;
+    printf("cost: %.1f ns per sample with window %u (host)\n", ns, DERIVED_RATE_WINDOW_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t window = 0;
+    float rate = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:r:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'w':
+            window = atoi(optarg);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: derived [-w window] [-r SPS]\n");
+            return 2;
+        }
+    }
+
+    if (window > 0 || rate > 0)
+    {
+        verifySine(window ? window : DerivedParams().rate_window, rate ? rate : 320, 50, 0);
+    }
+    else
+    {
+        const uint8_t windows[] = {DERIVED_RATE_WINDOW_MIN, 9, 16, DERIVED_RATE_WINDOW_MAX};
+        for (uint8_t w : windows)
+            verifyParabola(w);
+
+        // NAU7802, ADS1220 rates, jitter of the data ready handling, micros() wrap after 4 s
+        const float rates[] = {80, 320, 2000};
+        for (float r : rates)
+        {
+            verifySine(9, r, 0, 0);
+            verifySine(9, r, 0.05f * 1e6f / r, 0);
+            verifySine(9, r, 0.05f * 1e6f / r, UINT32_MAX - 4000000);
+        }
+
+        verifyWork();
+        verifyPipeline();
+        benchmark();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
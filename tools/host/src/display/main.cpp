@@ -0,0 +1,382 @@
+/*
+  Display pages on the host
+
+  Renders the display pages (DisplayPages, DisplayLayout, TrendPlot) into an in-memory
+  128x64 buffer in the U8g2 layout of the SH1106, with a model of the controller RAM that
+  is updated by the transfers. Text is drawn as character cells of the font size, enough
+  to check placement and changes, not the glyphs.
+
+  Checks:
+  - the trend plot drawn by shifting is the same as a full redraw, pixel for pixel
+  - the header of the trend page stays out of the plot region
+  - after every frame the controller shows the buffer, with only the changed tiles sent
+  - page switching wraps, status messages force a full frame
+  - autoscale: few full redraws on load cycles and steps, none on a steady signal
+
+  Reports bytes sent and time per frame, incremental against full redraws.
+
+    display [-n frames] [-v]   -v prints the screens
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include <DisplayPages.hpp>
+
+static int failures = 0;
+
+#define WIDTH 128
+#define HEIGHT 64
+#define BUFFER_SIZE (WIDTH * HEIGHT / 8)
+
+// cell of a character: width, rows above and below the baseline
+struct FontCell
+{
+    uint8_t width;
+    uint8_t ascent;
+    uint8_t descent;
+};
+
+static const FontCell font_cells[] = {
+    {5, 7, 1},  // DISPLAY_FONT_SMALL, spleen 5x8
+    {16, 26, 0}, // DISPLAY_FONT_VALUE, spleen 16x32 digits
+    {6, 8, 2},  // DISPLAY_FONT_ICONS, siji 6x10
+    {8, 13, 3}, // DISPLAY_FONT_MEDIUM, spleen 8x16
+};
+
+class MemoryCanvas : public DisplayCanvas
+{
+private:
+    DisplayFont _font = DISPLAY_FONT_SMALL;
+
+    void pixel(int16_t x, int16_t y)
+    {
+        if (x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT)
+            buffer[(y >> 3) * WIDTH + x] |= 1 << (y & 7);
+    }
+
+    // pattern per character and column, different text gives different pixels
+    void cell(int16_t x, int16_t y, uint32_t code)
+    {
+        const FontCell &font = font_cells[_font];
+        if (x < 0 || x + font.width > WIDTH)
+            outside++;
+        text_top = y - font.ascent < text_top ? y - font.ascent : text_top;
+        text_bottom = y + font.descent - 1 > text_bottom ? y + font.descent - 1 : text_bottom;
+        for (uint8_t column = 0; column + 1 < font.width; column++)
+        {
+            uint32_t bits = (code * 2654435761u) >> column;
+            for (int16_t row = y - font.ascent; row < y + font.descent; row++)
+                if ((bits >> ((row - y) & 15)) & 1)
+                    pixel(x + column, row);
+        }
+    }
+
+public:
+    uint8_t buffer[BUFFER_SIZE];
+    uint8_t controller[BUFFER_SIZE]; // what the display shows
+
+    uint64_t bytes_sent = 0;
+    uint32_t outside = 0;     // text cells beyond the left or right edge
+    int16_t text_top = 0;     // rows drawn by text since resetText()
+    int16_t text_bottom = 0;
+
+    MemoryCanvas()
+    {
+        memset(buffer, 0, sizeof(buffer));
+        memset(controller, 0, sizeof(controller));
+        resetText();
+    }
+
+    void resetText()
+    {
+        text_top = HEIGHT;
+        text_bottom = -1;
+    }
+
+    uint16_t width() const override { return WIDTH; }
+    uint16_t height() const override { return HEIGHT; }
+
+    void clear() override { memset(buffer, 0, sizeof(buffer)); }
+    void setFont(DisplayFont font) override { _font = font; }
+
+    void drawStr(int16_t x, int16_t y, const char *text) override
+    {
+        for (; *text; text++, x += font_cells[_font].width)
+            cell(x, y, (uint8_t)*text);
+    }
+
+    void drawGlyph(int16_t x, int16_t y, uint16_t glyph) override { cell(x, y, glyph); }
+    uint16_t getStrWidth(const char *text) override { return strlen(text) * font_cells[_font].width; }
+
+    uint8_t *getBuffer() override { return buffer; }
+
+    void send() override
+    {
+        memcpy(controller, buffer, sizeof(buffer));
+        bytes_sent += sizeof(buffer);
+    }
+
+    void sendArea(uint8_t tile_x, uint8_t tile_y, uint8_t tile_width, uint8_t tile_height) override
+    {
+        for (uint8_t row = tile_y; row < tile_y + tile_height; row++)
+        {
+            size_t offset = row * WIDTH + tile_x * DISPLAY_TILE;
+            memcpy(controller + offset, buffer + offset, tile_width * DISPLAY_TILE);
+            bytes_sent += tile_width * DISPLAY_TILE;
+        }
+    }
+
+    void print() const
+    {
+        for (int16_t y = 0; y < HEIGHT; y += 2)
+        {
+            for (int16_t x = 0; x < WIDTH; x++)
+            {
+                bool top = (buffer[(y >> 3) * WIDTH + x] >> (y & 7)) & 1;
+                bool bottom = (buffer[((y + 1) >> 3) * WIDTH + x] >> ((y + 1) & 7)) & 1;
+                fputs(top ? (bottom ? "\u2588" : "\u2580") : (bottom ? "\u2584" : " "), stdout);
+            }
+            putchar('\n');
+        }
+    }
+};
+
+class Noise
+{
+private:
+    uint32_t _state = 1;
+
+public:
+    float next(float amplitude)
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return ((float)_state / 4294967296.0f * 2.0f - 1.0f) * amplitude;
+    }
+};
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static DisplayState makeState(float value)
+{
+    DisplayState state;
+    state.unit = "kg";
+    state.value = value;
+    state.digits = 1;
+    state.fullrange = 500;
+    state.sensitivity = 2.0012;
+    state.zerobalance = -0.0134;
+    state.peak = 412.5;
+    state.valley = -3.2;
+    state.samples = 1234567;
+    state.battery_available = true;
+    state.battery_percent = 76;
+    state.battery_voltage = 3.98;
+    state.battery_charge_rate = -3.5;
+    state.wifi_connected = true;
+    state.wifi_rssi = -67;
+    state.ip[0] = 192;
+    state.ip[1] = 168;
+    state.ip[2] = 4;
+    state.ip[3] = 1;
+    state.uptime_s = 3 * 86400 + 4 * 3600 + 5 * 60 + 6;
+    return state;
+}
+
+// load cycles with noise, steps every 700 frames
+static float signal(uint32_t frame, Noise &noise)
+{
+    float value = 200 + 150 * sinf(frame * 0.02f) + noise.next(3);
+    if (frame / 700 % 2)
+        value += 400;
+    return value;
+}
+
+// trend page for n frames, plot region compared to a full redraw after every frame
+static void checkTrend(uint32_t frames, bool verbose)
+{
+    MemoryCanvas canvas;
+    DisplayPages pages;
+    pages.begin(canvas);
+    pages.setPage(DISPLAY_PAGE_TREND);
+
+    Noise noise;
+    uint8_t redrawn[BUFFER_SIZE];
+    uint32_t mismatches = 0;
+    uint32_t header_leaks = 0;
+    uint32_t stale = 0;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        canvas.resetText();
+        pages.update(canvas, makeState(signal(frame, noise)));
+
+        memcpy(redrawn, canvas.buffer, sizeof(redrawn));
+        pages.getTrend().redraw(redrawn, WIDTH);
+        if (memcmp(redrawn, canvas.buffer, sizeof(redrawn)) != 0)
+            mismatches++;
+        if (canvas.text_bottom >= DISPLAY_TREND_TILE_ROW * DISPLAY_TILE)
+            header_leaks++;
+        if (memcmp(canvas.controller, canvas.buffer, BUFFER_SIZE) != 0)
+            stale++;
+    }
+    if (verbose)
+        canvas.print();
+
+    const TrendStats &trend = pages.getTrend().getStats();
+    const DisplayPagesStats &stats = pages.getStats();
+    printf("trend: %u frames, %u columns shifted in, %u full redraws (%u rescales), %.0f bytes per frame\n", stats.frames, trend.columns,
+           trend.full_redraws, trend.rescales, (double)canvas.bytes_sent / frames);
+    printf("trend: %u frames differ from a full redraw, %u header leaks, %u frames not on the display\n", mismatches, header_leaks, stale);
+    check(mismatches == 0, "shifted plot equals full redraw");
+    check(header_leaks == 0, "trend header above the plot");
+    check(stale == 0, "display shows the buffer");
+    check(trend.columns > frames * 9 / 10, "plot scrolls by shifting");
+    // autoscale follows the load cycles, a few percent of the frames
+    check(trend.full_redraws < frames / 20, "full redraws");
+}
+
+// steady load with noise of a few display steps: no rescales after the first, traffic
+// against full frames
+static void checkTraffic(uint32_t frames)
+{
+    MemoryCanvas canvas;
+    DisplayPages pages;
+    pages.begin(canvas);
+    pages.setPage(DISPLAY_PAGE_TREND);
+
+    Noise noise;
+    for (uint32_t frame = 0; frame < frames; frame++)
+        pages.update(canvas, makeState(100 + noise.next(0.2f)));
+    double trend_bytes = (double)canvas.bytes_sent / frames;
+
+    MemoryCanvas measurement;
+    DisplayPages measurementPages;
+    measurementPages.begin(measurement);
+    for (uint32_t frame = 0; frame < frames; frame++)
+        measurementPages.update(measurement, makeState(100 + noise.next(0.2f)));
+    double measurement_bytes = (double)measurement.bytes_sent / frames;
+
+    printf("traffic, steady signal: trend %.0f, measurement %.0f bytes per frame, full frame %u\n", trend_bytes, measurement_bytes, BUFFER_SIZE);
+    check(pages.getTrend().getStats().rescales <= 2, "steady signal rescales");
+    check(trend_bytes < BUFFER_SIZE / 2, "trend sends changed tiles only");
+    check(measurement_bytes < BUFFER_SIZE / 2, "measurement sends changed tiles only");
+}
+
+// all pages, switching and status messages, the display always shows the buffer
+static void checkPages(bool verbose)
+{
+    MemoryCanvas canvas;
+    DisplayPages pages;
+    pages.begin(canvas);
+
+    uint8_t seen = 0;
+    uint32_t stale = 0;
+    Noise noise;
+    for (uint32_t frame = 0; frame < 400; frame++)
+    {
+        if (frame % 50 == 49)
+            pages.nextPage();
+        if (frame == 123)
+        {
+            DisplayLayout::drawStatusMessage(canvas, "WiFi setup...");
+            pages.invalidate();
+        }
+
+        canvas.resetText();
+        DisplayState state = makeState(signal(frame, noise));
+        state.wifi_connected = frame % 100 < 60;
+        pages.update(canvas, state);
+        seen |= 1 << pages.getPage();
+        if (memcmp(canvas.controller, canvas.buffer, BUFFER_SIZE) != 0)
+            stale++;
+        if (canvas.text_top < -1 || canvas.text_bottom > HEIGHT)
+            canvas.outside++;
+
+        if (verbose && frame % 50 == 48 && frame < 200)
+        {
+            printf("page %u:\n", pages.getPage());
+            canvas.print();
+        }
+    }
+    printf("pages: %u frames, %u full sends, %u areas, %u text cells off screen\n", pages.getStats().frames, pages.getStats().full_sends,
+           pages.getStats().areas_sent, canvas.outside);
+    check(seen == (1 << DISPLAY_PAGE_COUNT) - 1, "all pages shown");
+    check(pages.getPage() == (400 / 50) % DISPLAY_PAGE_COUNT, "page wraps");
+    check(stale == 0, "display shows the buffer after page switches");
+    check(pages.getStats().full_sends == 2, "full sends: first frame and after the status message");
+    check(canvas.outside == 0, "text on screen");
+}
+
+// cpu per frame, trend page incremental against a redraw every frame
+static void benchTrend(uint32_t frames)
+{
+    MemoryCanvas canvas;
+    DisplayPages pages;
+    pages.begin(canvas);
+    pages.setPage(DISPLAY_PAGE_TREND);
+    Noise noise;
+
+    double ns[2];
+    for (int full = 0; full < 2; full++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            if (full)
+                pages.invalidate();
+            pages.update(canvas, makeState(100 + 50 * sinf(frame * 0.05f) + noise.next(2)));
+        }
+        ns[full] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames;
+    }
+    printf("time per trend frame: %.0f ns shifting, %.0f ns full redraw and send\n", ns[0], ns[1]);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 5000;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: display [-n frames] [-v]\n");
+            return 2;
+        }
+    }
+    if (frames < 1000)
+    {
+        fprintf(stderr, "at least 1000 frames\n");
+        return 2;
+    }
+
+    checkTrend(frames, verbose);
+    checkTraffic(frames);
+    checkPages(verbose);
+    benchTrend(frames);
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,414 @@
+/*
+  Event fan-out verification
+
+  Checks EventFanout, the server sent events of /events, with simulated clients:
+    - a client that does not drain keeps the newest FANOUT_QUEUE_SIZE events, the older ones
+      are dropped and counted, in order
+    - state channels (readings) are coalesced to the latest value and rate limited per client,
+      messages are never coalesced or rate limited
+    - a reconnect with Last-Event-ID replays exactly the missed events, a new client gets the
+      latest state but no old messages
+    - a slow client does not delay a fast one, the fast one gets every event when it is published
+    - a send the transport rejects is counted as dropped, every queued event is accounted for
+  Reports the publish rate with FANOUT_MAX_CLIENTS clients.
+
+    fanout            all checks, exit code 1 on failure
+    fanout -s 7       seed of the slow client
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <EventFanout.hpp>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double value, double expected)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s: %g, expected %g\n", what, value, expected);
+    }
+}
+
+class Noise
+{
+private:
+    uint32_t _state;
+
+public:
+    Noise(uint32_t seed) : _state(seed ? seed : 1) {}
+
+    uint32_t next()
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+};
+
+#define MAX_RECEIVED 4096
+
+struct Sink
+{
+    bool open = true;     // canSend
+    bool failing = false; // send fails
+    uint32_t received = 0;
+    uint32_t ids[MAX_RECEIVED];
+    uint8_t channels[MAX_RECEIVED];
+    uint32_t timestamps[MAX_RECEIVED]; // publish time of the event
+    uint32_t last_id = 0;
+    uint32_t received_ms = 0; // time of the service call, set by the test
+    uint32_t latency_max_ms = 0;
+};
+
+class TestTransport : public FanoutTransport
+{
+public:
+    bool canSend(void *client, size_t len) override { return ((Sink *)client)->open; }
+
+    bool send(void *client, const char *buffer, size_t len) override
+    {
+        // the event id is the first line, "id: <n>"
+        return !((Sink *)client)->failing && strncmp(buffer, "id: ", 4) == 0 && buffer[len - 1] == '\n';
+    }
+
+    void delivered(void *client, const FanoutEvent &event) override
+    {
+        Sink &sink = *(Sink *)client;
+        if (sink.received < MAX_RECEIVED)
+        {
+            sink.ids[sink.received] = event.id;
+            sink.channels[sink.received] = event.channel;
+            sink.timestamps[sink.received] = event.timestamp_ms;
+        }
+        sink.received++;
+        sink.last_id = event.id;
+        uint32_t latency = sink.received_ms - event.timestamp_ms;
+        if (latency > sink.latency_max_ms)
+            sink.latency_max_ms = latency;
+    }
+};
+
+struct Setup
+{
+    TestTransport transport;
+    EventFanout fanout;
+    int8_t reading;
+    int8_t battery;
+    int8_t message;
+
+    Setup() : fanout(transport)
+    {
+        reading = fanout.registerChannel("reading", true);
+        battery = fanout.registerChannel("battery", true);
+        message = fanout.registerChannel("message", false);
+    }
+
+    uint32_t publish(int8_t channel, uint32_t now_ms)
+    {
+        char data[32];
+        snprintf(data, sizeof(data), "{\"t\":%u}", now_ms);
+        return fanout.publish(channel, data, now_ms);
+    }
+
+    void service(Sink &sink, uint32_t now_ms)
+    {
+        sink.received_ms = now_ms;
+        fanout.service(&sink, now_ms);
+    }
+};
+
+// ids of the sink are strictly increasing
+static bool ordered(const Sink &sink)
+{
+    for (uint32_t i = 1; i < sink.received && i < MAX_RECEIVED; i++)
+    {
+        if (sink.ids[i] <= sink.ids[i - 1])
+            return false;
+    }
+    return true;
+}
+
+static uint32_t countChannel(const Sink &sink, int8_t channel)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < sink.received && i < MAX_RECEIVED; i++)
+        count += sink.channels[i] == channel;
+    return count;
+}
+
+static void verifyDropOldest()
+{
+    Setup setup;
+    Sink blocked, other;
+    blocked.open = false;
+    setup.fanout.addClient(&blocked, 0, FANOUT_ALL_CHANNELS, 0);
+    setup.fanout.addClient(&other, 0, FANOUT_ALL_CHANNELS, 0);
+
+    // messages only, nothing is coalesced. Fewer than the history holds, none is overwritten
+    const uint32_t count = FANOUT_HISTORY_SIZE - 4;
+    uint32_t last = 0;
+    for (uint32_t n = 0; n < count; n++)
+    {
+        last = setup.publish(setup.message, n);
+        setup.service(blocked, n);
+    }
+
+    uint32_t dropped = count - FANOUT_QUEUE_SIZE;
+    check(setup.fanout.getQueued(&blocked) == FANOUT_QUEUE_SIZE, "queued while blocked", setup.fanout.getQueued(&blocked), FANOUT_QUEUE_SIZE);
+    check(setup.fanout.getDropped(&blocked) == dropped, "dropped while blocked", setup.fanout.getDropped(&blocked), dropped);
+    check(setup.fanout.getDropped(&other) == dropped, "dropped of the other client", setup.fanout.getDropped(&other), dropped);
+
+    blocked.open = true;
+    setup.service(blocked, count);
+    bool newest = blocked.received == FANOUT_QUEUE_SIZE && blocked.ids[0] == last - FANOUT_QUEUE_SIZE + 1 &&
+                  blocked.ids[FANOUT_QUEUE_SIZE - 1] == last;
+    printf("drop oldest: %u of %u messages queued, %u dropped, received %u..%u\n", blocked.received, count,
+           setup.fanout.getDropped(&blocked), blocked.received ? blocked.ids[0] : 0, blocked.last_id);
+    check(newest, "newest events kept", blocked.received ? blocked.ids[0] : 0, last - FANOUT_QUEUE_SIZE + 1);
+    check(ordered(blocked), "order after drops", 0, 1);
+    check(setup.fanout.getQueued(&blocked) == 0, "queue drained", setup.fanout.getQueued(&blocked), 0);
+
+    // a queue that waits longer than the history holds loses the overwritten events on send
+    Setup late;
+    Sink stalled;
+    stalled.open = false;
+    late.fanout.addClient(&stalled, 0, FANOUT_ALL_CHANNELS, 0);
+    for (uint32_t n = 0; n < FANOUT_HISTORY_SIZE + 8; n++)
+        last = late.publish(late.message, n);
+    stalled.open = true;
+    late.service(stalled, 0);
+    uint32_t total = FANOUT_HISTORY_SIZE + 8;
+    check(stalled.received + late.fanout.getDropped(&stalled) == total, "overwritten events accounted", stalled.received + late.fanout.getDropped(&stalled), total);
+    check(stalled.last_id == last && ordered(stalled), "newest event after overwrite", stalled.last_id, last);
+}
+
+static void verifyCoalescing()
+{
+    Setup setup;
+    Sink blocked, limited;
+    blocked.open = false;
+    setup.fanout.addClient(&blocked, 0, FANOUT_ALL_CHANNELS, 0);
+    setup.fanout.addClient(&limited, 0, FANOUT_ALL_CHANNELS, 500);
+
+    // readings at 10 Hz, battery at 1 Hz, a message every 500 ms, for 2 s. Fewer events than
+    // the history holds, the queued messages are not overwritten (see verifyDropOldest)
+    uint32_t last_reading = 0, messages = 0;
+    uint32_t readings = 0, batteries = 0;
+    for (uint32_t t = 0; t < 2000; t += 100)
+    {
+        last_reading = setup.publish(setup.reading, t);
+        readings++;
+        if (t % 1000 == 0)
+        {
+            setup.publish(setup.battery, t);
+            batteries++;
+        }
+        if (t % 500 == 0)
+        {
+            setup.publish(setup.message, t);
+            messages++;
+        }
+        setup.service(blocked, t);
+        setup.service(limited, t);
+    }
+
+    blocked.open = true;
+    setup.service(blocked, 2000);
+    uint32_t got_readings = countChannel(blocked, setup.reading);
+    uint32_t got_batteries = countChannel(blocked, setup.battery);
+    uint32_t got_messages = countChannel(blocked, setup.message);
+    printf("coalescing: blocked client got %u of %u readings, %u of %u battery, %u of %u messages\n",
+           got_readings, readings, got_batteries, batteries, got_messages, messages);
+    check(got_readings == 1 && got_batteries == 1, "state channels coalesced", got_readings + got_batteries, 2);
+    check(got_messages == messages, "messages not coalesced", got_messages, messages);
+    check(setup.fanout.getDropped(&blocked) == 0, "dropped with coalescing", setup.fanout.getDropped(&blocked), 0);
+    bool latest = false;
+    for (uint32_t i = 0; i < blocked.received; i++)
+        latest |= blocked.ids[i] == last_reading;
+    check(latest, "latest reading kept", 0, last_reading);
+    check(ordered(blocked), "order with coalescing", 0, 1);
+
+    // 500 ms per state channel: a reading every 5th publish, every message at once
+    uint32_t limited_readings = countChannel(limited, setup.reading);
+    uint32_t limited_messages = countChannel(limited, setup.message);
+    printf("rate limit 500 ms: %u of %u readings, %u of %u messages, latency max %u ms\n", limited_readings, readings,
+           limited_messages, messages, limited.latency_max_ms);
+    check(limited_readings == readings / 5, "rate limited readings", limited_readings, readings / 5);
+    check(limited_messages == messages, "messages not rate limited", limited_messages, messages);
+    check(setup.fanout.getDropped(&limited) == 0, "dropped with rate limit", setup.fanout.getDropped(&limited), 0);
+}
+
+static void verifyReplay()
+{
+    Setup setup;
+    Sink first, second, fresh;
+    setup.fanout.addClient(&first, 0, FANOUT_ALL_CHANNELS, 0);
+
+    uint32_t t = 0;
+    for (int n = 0; n < 6; n++, t += 100)
+    {
+        setup.publish(n % 2 ? setup.message : setup.reading, t);
+        setup.service(first, t);
+    }
+    uint32_t last_id = first.last_id;
+    setup.fanout.removeClient(&first);
+
+    // missed while disconnected: messages and readings
+    uint32_t missed_messages = 0, last_reading = 0, missed_first = 0;
+    for (int n = 0; n < 12; n++, t += 100)
+    {
+        uint32_t id = setup.publish(n % 3 ? setup.reading : setup.message, t);
+        missed_first = missed_first ? missed_first : id;
+        if (n % 3)
+            last_reading = id;
+        else
+            missed_messages++;
+    }
+
+    // the browser reconnects with Last-Event-ID, readings are coalesced to the latest on replay
+    setup.fanout.addClient(&second, last_id, FANOUT_ALL_CHANNELS, 0);
+    setup.service(second, t);
+    uint32_t replayed_messages = countChannel(second, setup.message);
+    uint32_t replayed_readings = countChannel(second, setup.reading);
+    bool after = second.received > 0 && second.ids[0] >= missed_first;
+    printf("replay: last id %u, %u of %u missed messages and %u reading (latest %u) replayed\n", last_id,
+           replayed_messages, missed_messages, replayed_readings, second.last_id);
+    check(after, "nothing up to Last-Event-ID replayed", second.received ? second.ids[0] : 0, missed_first);
+    check(replayed_messages == missed_messages, "missed messages replayed", replayed_messages, missed_messages);
+    check(replayed_readings == 1 && second.last_id == last_reading, "latest reading replayed", second.last_id, last_reading);
+    check(ordered(second), "replay order", 0, 1);
+
+    // a new client: the latest state of each channel, no history of messages
+    setup.publish(setup.battery, t);
+    setup.fanout.addClient(&fresh, 0, FANOUT_ALL_CHANNELS, 0);
+    setup.service(fresh, t);
+    check(countChannel(fresh, setup.message) == 0, "messages to a new client", countChannel(fresh, setup.message), 0);
+    check(countChannel(fresh, setup.reading) == 1 && countChannel(fresh, setup.battery) == 1, "state to a new client", fresh.received, 2);
+
+    // a subscription without readings replays none
+    Sink filtered;
+    setup.fanout.addClient(&filtered, last_id, setup.fanout.channelMask("message"), 0);
+    setup.service(filtered, t);
+    check(filtered.received == missed_messages && countChannel(filtered, setup.message) == missed_messages, "replay of a subscription", filtered.received, missed_messages);
+}
+
+static void verifySlowClient(Noise &rng)
+{
+    Setup setup;
+    Sink fast, slow;
+    setup.fanout.addClient(&slow, 0, FANOUT_ALL_CHANNELS, 0);
+    setup.fanout.addClient(&fast, 0, FANOUT_ALL_CHANNELS, 0);
+
+    // 10 s of readings at 20 Hz and a message per second, both clients serviced per publish.
+    // The slow one accepts a write in one of 10 attempts, like a tab in the background
+    uint32_t published = 0, slow_writes = 0;
+    for (uint32_t t = 0; t < 10000; t += 50)
+    {
+        setup.publish(setup.reading, t);
+        published++;
+        if (t % 1000 == 0)
+        {
+            setup.publish(setup.message, t);
+            published++;
+        }
+        slow.open = rng.next() % 10 == 0;
+        slow_writes += slow.open;
+        setup.service(slow, t);
+        setup.service(fast, t);
+    }
+
+    printf("slow client: fast got %u of %u events, latency max %u ms; slow got %u in %u writable rounds, %u dropped\n",
+           fast.received, published, fast.latency_max_ms, slow.received, slow_writes, setup.fanout.getDropped(&slow));
+    check(fast.received == published, "events to the fast client", fast.received, published);
+    check(fast.latency_max_ms == 0, "latency of the fast client", fast.latency_max_ms, 0);
+    check(setup.fanout.getDropped(&fast) == 0, "dropped of the fast client", setup.fanout.getDropped(&fast), 0);
+    check(ordered(fast) && ordered(slow), "order", 0, 1);
+    check(countChannel(slow, setup.message) + setup.fanout.getQueued(&slow) >= 1, "messages to the slow client", countChannel(slow, setup.message), 1);
+}
+
+static void verifySendFailure()
+{
+    Setup setup;
+    Sink good, broken;
+    broken.failing = true;
+    setup.fanout.addClient(&good, 0, FANOUT_ALL_CHANNELS, 0);
+    setup.fanout.addClient(&broken, 0, FANOUT_ALL_CHANNELS, 0);
+
+    const uint32_t count = 20;
+    for (uint32_t n = 0; n < count; n++)
+    {
+        setup.publish(n % 2 ? setup.message : setup.reading, n);
+        setup.fanout.service(n);
+    }
+
+    // every queued event is delivered, dropped, coalesced or still queued
+    const FanoutMetrics &metrics = setup.fanout.getMetrics();
+    uint32_t queued = setup.fanout.getQueued(&good) + setup.fanout.getQueued(&broken);
+    uint32_t accounted = metrics.delivered + metrics.dropped + metrics.coalesced + queued;
+    printf("send failure: %u rejected sends counted as dropped, %u delivered to the other client\n",
+           setup.fanout.getDropped(&broken), good.received);
+    check(broken.received == 0, "events delivered by a failing send", broken.received, 0);
+    check(setup.fanout.getDropped(&broken) == count, "failed sends dropped", setup.fanout.getDropped(&broken), count);
+    check(good.received == count, "events to the other client", good.received, count);
+    check(accounted == 2 * count, "events accounted", accounted, 2 * count);
+}
+
+static void benchmark()
+{
+    Setup setup;
+    Sink sinks[FANOUT_MAX_CLIENTS];
+    for (Sink &sink : sinks)
+        setup.fanout.addClient(&sink, 0, FANOUT_ALL_CHANNELS, 0);
+
+    const uint32_t events = 200000;
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t n = 0; n < events; n++)
+    {
+        setup.fanout.publish(n % 8 ? setup.reading : setup.message, "{\"v\":12.345,\"t\":123456}", n);
+        setup.fanout.service(n);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double s = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    uint32_t delivered = setup.fanout.getMetrics().delivered;
+    printf("publish: %.2f us per event to %d clients (host)\n", s * 1e6 / events, FANOUT_MAX_CLIENTS);
+    check(delivered == events * FANOUT_MAX_CLIENTS, "benchmark delivered", delivered, events * FANOUT_MAX_CLIENTS);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: fanout [-s seed]\n");
+            return 2;
+        }
+    }
+
+    Noise rng(seed);
+    verifyDropOldest();
+    verifyCoalescing();
+    verifyReplay();
+    verifySlowClient(rng);
+    verifySendFailure();
+    benchmark();
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
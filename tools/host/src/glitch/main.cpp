@@ -0,0 +1,360 @@
+/*
+  Glitch rejection verification
+
+  Injects faults into clean load signals and checks GlitchFilter and the pipeline:
+    - clean noise, sines and steps: no false rejections, steps pass after max_consecutive
+    - spikes, rail codes and read errors: every one flagged, counted and substituted,
+      the output stays within the noise of the clean signal
+    - sustained overload: only the first rail code is substituted and counted, the rest and
+      the sample leaving the overload pass unchanged
+    - AdcMock with injected faults through LoadcellPipeline: peak hold and mean unaffected
+    - the alarm input of the pipeline follows an overload and a step in the same sample
+  Reports the cost per sample.
+
+    glitch                 all checks, exit code 1 on failure
+    glitch -k 6 -n 300     Hampel threshold and noise counts for the fault checks
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <AdcMock.hpp>
+#include <GlitchFilter.hpp>
+#include <LoadcellPipeline.hpp>
+
+#define SPAN_COUNTS 2000000 // full range of the simulated sensor
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double value, double expected)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s: %g, expected %g\n", what, value, expected);
+    }
+}
+
+// settings as LoadcellClass derives them from sensor.json defaults
+static GlitchParams defaultParams(float k)
+{
+    GlitchParams params;
+    params.enabled = true;
+    params.k = k;
+    params.min_deviation = (int32_t)(0.01f * SPAN_COUNTS);
+    params.max_step = (int32_t)(0.5f * SPAN_COUNTS);
+    return params;
+}
+
+class Noise
+{
+private:
+    uint32_t _state = 1;
+
+public:
+    float next(float amplitude)
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return ((float)_state / 4294967296.0f * 2.0f - 1.0f) * amplitude;
+    }
+};
+
+static int32_t cleanSignal(uint32_t n, float rate, float noise, Noise &rng)
+{
+    // vibration at 25 Hz or a tenth of the sample rate, within the bandwidth of the adc filter
+    double t = n / (double)rate;
+    double vibration = fmin(25.0, rate / 10);
+    return (int32_t)lround(300000 + 0.2 * SPAN_COUNTS * sin(2 * M_PI * 2.0 * t) + 0.02 * SPAN_COUNTS * sin(2 * M_PI * vibration * t) + rng.next(noise));
+}
+
+static void verifyClean(float k, float noise)
+{
+    const float rates[] = {80, 320, 2000};
+    for (float rate : rates)
+    {
+        GlitchFilter filter;
+        filter.configure(defaultParams(k));
+        Noise rng;
+        uint32_t rejected = 0;
+        for (uint32_t n = 0; n < rate * 20; n++)
+        {
+            filter.process(cleanSignal(n, rate, noise, rng), false);
+            rejected += filter.getSubstituted();
+        }
+        printf("clean %4.0f SPS, noise %4.0f: %u substituted\n", rate, noise, rejected);
+        check(rejected == 0, "false rejections on a clean signal", rejected, 0);
+    }
+
+    // real steps, e.g. a load dropped on the sensor: delayed by max_consecutive samples at most
+    GlitchFilter filter;
+    GlitchParams params = defaultParams(k);
+    filter.configure(params);
+    Noise rng;
+    uint32_t delay = 0;
+    int32_t level = 0;
+    for (uint32_t n = 0; n < 2000; n++)
+    {
+        if (n % 500 == 0)
+            level = (n / 500) % 2 ? 0.8 * SPAN_COUNTS : 0.1 * SPAN_COUNTS;
+        int32_t raw = level + (int32_t)rng.next(noise);
+        int32_t out = filter.process(raw, false);
+        if (out != raw)
+            delay++;
+    }
+    printf("steps: %u samples delayed for 3 steps, limit %u each\n", delay, params.max_consecutive);
+    check(delay <= 3u * params.max_consecutive, "step delay", delay, 3 * params.max_consecutive);
+}
+
+static void verifyFaults(float k, float noise)
+{
+    const float rate = 320;
+    GlitchFilter filter;
+    filter.configure(defaultParams(k));
+    Noise rng, rng_fault;
+
+    uint32_t injected[4] = {}, detected[4] = {};
+    const char *names[4] = {"read error", "saturation", "step", "outlier"};
+    int32_t last_clean = 0;
+    double worst = 0;
+
+    for (uint32_t n = 0; n < rate * 60; n++)
+    {
+        int32_t clean = cleanSignal(n, rate, noise, rng);
+        int32_t raw = clean;
+        bool read_error = false;
+        int fault = -1;
+
+        // single sample faults at irregular distances, never two in a row
+        if (n > 20 && n % 37 == 0)
+        {
+            fault = (n / 37) % 4;
+            switch (fault)
+            {
+            case 0: // corrupted transfer
+                read_error = true;
+                raw = 0;
+                break;
+            case 1: // ESD at the rails
+                raw = (n / 37) % 8 < 4 ? GLITCH_RAIL_HIGH : GLITCH_RAIL_LOW;
+                break;
+            case 2: // bit error in the high byte
+                raw = clean ^ 0x400000;
+                break;
+            case 3: // spike within the step limit
+                raw = clean + (int32_t)((rng_fault.next(1.0f) > 0 ? 1 : -1) * 0.1f * SPAN_COUNTS);
+                break;
+            }
+            injected[fault]++;
+        }
+
+        int32_t out = filter.process(raw, read_error);
+        uint8_t reason = filter.getReason();
+        if (fault >= 0)
+        {
+            if (filter.getSubstituted() && reason != GLITCH_NONE)
+                detected[fault]++;
+            check(out == last_clean, "substitute is the last good sample", out, last_clean);
+        }
+        else
+        {
+            check(reason == GLITCH_NONE, "clean sample flagged", reason, 0);
+            last_clean = out;
+        }
+        worst = fmax(worst, fabs((double)out - clean));
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        printf("%-10s: %3u injected, %3u substituted\n", names[i], injected[i], detected[i]);
+        check(detected[i] == injected[i], "fault detection", detected[i], injected[i]);
+    }
+    // substitute lags the signal by one sample at most
+    double slope = 2 * M_PI * (0.2 * 2.0 + 0.02 * fmin(25.0, rate / 10)) * SPAN_COUNTS / rate;
+    printf("max deviation from the clean signal: %.0f counts, one sample of slope %.0f\n", worst, slope + 2 * noise);
+    check(worst <= slope + 2 * noise, "deviation from clean signal", worst, slope + 2 * noise);
+}
+
+static void verifyOverload(float k, float noise)
+{
+    const int32_t rails[2] = {GLITCH_RAIL_HIGH, GLITCH_RAIL_LOW};
+    for (int32_t rail : rails)
+    {
+        GlitchFilter filter;
+        filter.configure(defaultParams(k));
+        Noise rng;
+        uint32_t substituted = 0, flagged = 0, passed = 0;
+        for (uint32_t n = 0; n < 300; n++)
+        {
+            int32_t raw = n >= 100 && n < 200 ? rail : cleanSignal(n, 320, noise, rng);
+            int32_t out = filter.process(raw, false);
+            substituted += filter.getSubstituted();
+            flagged += filter.getReason() != GLITCH_NONE;
+            if (n >= 101 && n < 201)
+                passed += out == raw;
+        }
+        printf("overload at %d: %u substituted, %u flagged, %u of 100 passed unchanged\n", rail, substituted, flagged, passed);
+        check(substituted == 1 && flagged == 1, "single substitution per overload", substituted, 1);
+        check(passed == 100, "overload and the sample after it pass", passed, 100);
+    }
+}
+
+static void verifyAlarmInput()
+{
+    PipelineParams params;
+    params.glitch = defaultParams(5);
+    LoadcellPipeline pipeline;
+    pipeline.configure(params);
+
+    // level, overload, step beyond max_step and back
+    const int32_t levels[] = {100000, GLITCH_RAIL_HIGH, 100000, 100000 + (int32_t)(0.8f * SPAN_COUNTS), 100000};
+    uint32_t n = 0, late = 0;
+    for (int32_t level : levels)
+    {
+        for (int i = 0; i < 50; i++, n++)
+        {
+            pipeline.process(level, n * 3125);
+            late += pipeline.getAlarmInput() != (float)level;
+        }
+    }
+    pipeline.process(0, n * 3125, true);
+    printf("alarm input: %u of %u samples differ from the input, %.0f on a read error\n", late, n, pipeline.getAlarmInput());
+    check(late == 0, "alarm input follows without delay", late, 0);
+    check(isnan(pipeline.getAlarmInput()), "alarm input on a read error", pipeline.getAlarmInput(), NAN);
+}
+
+static uint64_t sim_clock_us = 0;
+
+static uint64_t sim_clock()
+{
+    return sim_clock_us;
+}
+
+struct RunResult
+{
+    PipelineStats stats;
+    double mean = 0;
+};
+
+static RunResult runPipeline(const AdcMockConfig &config, bool glitch, double seconds)
+{
+    AdcMock adc;
+    adc.setClock(sim_clock);
+    sim_clock_us = 0;
+    adc.begin();
+    adc.configure(config);
+
+    const float sensitivity = 2.0, fullrange = 1000.0;
+    PipelineParams params;
+    params.sensor_scale_factor = PipelineParams::calcScaleFactor(AdcMock::FULL_SCALE_COUNTS, config.gain, sensitivity, config.cali_gain_factor, fullrange);
+    float span_counts = fullrange * params.sensor_scale_factor;
+    params.glitch.enabled = glitch;
+    params.glitch.min_deviation = (int32_t)(0.01f * span_counts);
+    params.glitch.max_step = (int32_t)(0.5f * span_counts);
+    LoadcellPipeline pipeline;
+    pipeline.configure(params);
+
+    RunResult result;
+    uint32_t count = 0;
+    while (sim_clock_us < seconds * 1e6)
+    {
+        if (adc.available())
+        {
+            int32_t raw = adc.read();
+            pipeline.process(raw, (uint32_t)sim_clock_us, adc.readFailed());
+            count++;
+            result.mean += (pipeline.getConverted() - result.mean) / count;
+        }
+        sim_clock_us += 100;
+    }
+    result.stats = pipeline.getStats();
+    return result;
+}
+
+static void verifyPipeline(float noise)
+{
+    AdcMockConfig config;
+    config.samplerate = 2000;
+    config.signal_mv_per_v = 1.0;
+    config.sine_mv_per_v = 0.2;
+    config.sine_hz = 3.0;
+    config.noise_counts = noise;
+
+    RunResult clean = runPipeline(config, true, 10);
+
+    config.fault_spike_every = 101;
+    config.fault_spike_counts = 3e6;
+    config.fault_saturate_every = 997;
+    config.fault_read_error_every = 503;
+    RunResult faulty = runPipeline(config, true, 10);
+    RunResult unfiltered = runPipeline(config, false, 10);
+
+    const PipelineStats &s = faulty.stats;
+    uint32_t injected = s.count / 101 + s.count / 997 + s.count / 503;
+    printf("pipeline: max clean %.2f, with faults %.2f, unfiltered %.2f; mean %.3f / %.3f\n",
+           clean.stats.max, s.max, unfiltered.stats.max, clean.mean, faulty.mean);
+    printf("          read errors %u, saturations %u, steps %u, outliers %u, substituted %u of about %u\n",
+           s.glitch_read_errors, s.glitch_saturations, s.glitch_steps, s.glitch_outliers, s.glitch_substituted, injected);
+    check(fabs(s.max - clean.stats.max) < 0.5, "peak hold with faults", s.max, clean.stats.max);
+    check(fabs(faulty.mean - clean.mean) < 0.05, "mean with faults", faulty.mean, clean.mean);
+    check(s.glitch_substituted + 3 >= injected && s.glitch_substituted <= injected + 3, "substituted count", s.glitch_substituted, injected);
+    check(clean.stats.glitch_substituted == 0, "substitutions without faults", clean.stats.glitch_substituted, 0);
+}
+
+static void benchmark()
+{
+    GlitchFilter filter;
+    GlitchParams params = defaultParams(5);
+    params.window = GLITCH_WINDOW_MAX;
+    filter.configure(params);
+    Noise rng;
+
+    const uint32_t samples = 10000000;
+    volatile int32_t sink = 0;
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t n = 0; n < samples; n++)
+        sink = filter.process(100000 + (int32_t)rng.next(1000), false);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    (void)sink;
+
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / samples;
+    printf("cost: %.1f ns per sample with window %u (host)\n", ns, GLITCH_WINDOW_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    float k = 5;
+    float noise = 200;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'k':
+            k = atof(optarg);
+            break;
+        case 'n':
+            noise = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: glitch [-k Hampel threshold] [-n noise counts]\n");
+            return 2;
+        }
+    }
+
+    verifyClean(k, noise);
+    verifyFaults(k, noise);
+    verifyOverload(k, noise);
+    verifyPipeline(noise);
+    verifyAlarmInput();
+    benchmark();
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
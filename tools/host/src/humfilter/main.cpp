@@ -0,0 +1,278 @@
+/*
+  Hum filter verification
+
+  Designs the notch/comb filters of the acquisition pipeline for the sample rates of the adc
+  backends and checks the fixed point coefficients and the simulated response:
+    - exact unity DC gain, a static load passes bit exact after settling
+    - attenuation at every notch frequency (analytic and by simulating a sine)
+    - passband gain at low frequencies compared between analytic response and simulation
+  Reports the attenuation for a drifting mains frequency and the cost per sample.
+  Measures the step delay of the hum filter in LoadcellPipeline and checks that the alarm
+  input, taken ahead of the filter, follows a step in the same sample.
+
+    humfilter                       all checks, exit code 1 on failure
+    humfilter -r 320 -m 50 -c -v    one design: 320 SPS, 50 Hz comb, print coefficients
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <HumFilter.hpp>
+#include <LoadcellPipeline.hpp>
+
+#define NOTCH_MIN_ATTENUATION_DB 40.0
+#define PASSBAND_TOLERANCE 0.01
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, float rate, float mains, int mode, double value)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s: %.1f SPS, %.0f Hz, mode %d: %g\n", what, rate, mains, mode, value);
+    }
+}
+
+static double db(double gain)
+{
+    return 20.0 * log10(gain + 1e-12);
+}
+
+// rms of the output for a sine input, after the filter settled
+static double simulateSine(const HumFilterParams &params, float rate, float frequency, double amplitude, int32_t offset)
+{
+    HumFilter filter;
+    filter.design(params, rate);
+
+    uint32_t settle = (uint32_t)(rate * 10); // 10 s
+    uint32_t measure = (uint32_t)(rate * 20);
+    double sum = 0, sum2 = 0;
+    for (uint32_t n = 0; n < settle + measure; n++)
+    {
+        int32_t x = offset + (int32_t)lround(amplitude * sin(2.0 * M_PI * frequency * n / rate));
+        int32_t y = filter.process(x);
+        if (n >= settle)
+        {
+            sum += y - offset;
+            sum2 += (double)(y - offset) * (y - offset);
+        }
+    }
+    double mean = sum / measure;
+    return sqrt(sum2 / measure - mean * mean);
+}
+
+static void printDesign(const HumFilter &filter)
+{
+    printf("  %.2f SPS, %u stages\n", filter.getSampleRate(), filter.getStageCount());
+    for (uint8_t i = 0; i < filter.getStageCount(); i++)
+    {
+        const HumFilterStage &s = filter.getStage(i);
+        printf("    %7.2f Hz  b0 %11d b1 %11d b2 %11d a1 %11d a2 %11d  (Q%d)\n", s.frequency, s.b0, s.b1, s.b2, s.a1, s.a2, HUM_FILTER_COEFF_BITS);
+    }
+}
+
+static void verify(float rate, float mains, HumFilterMode mode, bool verbose)
+{
+    HumFilterParams params;
+    params.mode = mode;
+    params.mains_hz = mains;
+    HumFilter filter;
+    filter.design(params, rate);
+    if (verbose)
+        printDesign(filter);
+    if (!filter.isActive())
+    {
+        printf("%7.1f SPS %2.0f Hz %-5s: no notch below Nyquist\n", rate, mains, mode == HUM_FILTER_COMB ? "comb" : "notch");
+        return;
+    }
+
+    // coefficients: numerator sums to the denominator, DC gain exactly 1
+    for (uint8_t i = 0; i < filter.getStageCount(); i++)
+    {
+        const HumFilterStage &s = filter.getStage(i);
+        int64_t num = (int64_t)s.b0 + s.b1 + s.b2;
+        int64_t den = ((int64_t)1 << HUM_FILTER_COEFF_BITS) + s.a1 + s.a2;
+        check(num == den, "dc gain of coefficients", rate, mains, mode, (double)(num - den));
+    }
+
+    // static load passes bit exact, also after a step
+    HumFilter dc;
+    dc.design(params, rate);
+    int32_t y = 0;
+    for (int i = 0; i < 100; i++)
+        y = dc.process(1234567);
+    check(y == 1234567, "static input", rate, mains, mode, y);
+    for (uint32_t i = 0; i < rate * 20; i++)
+        y = dc.process(-2345678);
+    check(y == -2345678, "static input after step", rate, mains, mode, y);
+
+    // notch frequencies, analytic and simulated with a large sine on a large offset
+    double worst = 1e9;
+    for (uint8_t i = 0; i < filter.getStageCount(); i++)
+    {
+        float f = filter.getStage(i).frequency;
+        double analytic = -db(filter.response(f));
+        check(analytic >= NOTCH_MIN_ATTENUATION_DB, "analytic notch attenuation dB", rate, mains, mode, analytic);
+        double amplitude = 200000;
+        double simulated = -db(simulateSine(params, rate, f, amplitude, 3000000) / (amplitude / sqrt(2.0)));
+        check(simulated >= NOTCH_MIN_ATTENUATION_DB, "simulated notch attenuation dB", rate, mains, mode, simulated);
+        if (simulated < worst)
+            worst = simulated;
+    }
+
+    // the harmonics themselves, folded or not
+    double harmonics_worst = 1e9;
+    uint8_t harmonics = mode == HUM_FILTER_COMB ? params.harmonics : 1;
+    for (uint8_t k = 1; k <= harmonics; k++)
+    {
+        float f = fmodf(k * mains, rate);
+        if (f > rate / 2)
+            f = rate - f;
+        if (f < HUM_FILTER_MIN_HZ || f > 0.49f * rate)
+            continue;
+        double attenuation = -db(filter.response(k * mains));
+        if (attenuation < harmonics_worst)
+            harmonics_worst = attenuation;
+    }
+
+    // passband: analytic response of the quantized coefficients against simulation
+    float passband = mains / 10;
+    double expected = filter.response(passband);
+    double simulated = simulateSine(params, rate, passband, 100000, 0) / (100000 / sqrt(2.0));
+    check(fabs(simulated - expected) <= PASSBAND_TOLERANCE * expected, "passband simulated vs analytic", rate, mains, mode, simulated - expected);
+
+    // mains frequency off by 0.5%, the filter is designed for the nominal one
+    double drift = -db(filter.response(mains * 1.005f));
+
+    printf("%7.1f SPS %2.0f Hz %-5s: %u notches, notch >= %5.1f dB simulated, harmonics >= %5.1f dB, +0.5%% mains %5.1f dB, gain at %4.1f Hz %.4f\n",
+           rate, mains, mode == HUM_FILTER_COMB ? "comb" : "notch", filter.getStageCount(), worst, harmonics_worst, drift, passband, expected);
+}
+
+// samples from a step of the input until the output reaches fraction of it
+static int stepDelay(const float *output, int count, float step, float fraction)
+{
+    for (int n = 0; n < count; n++)
+        if (output[n] >= fraction * step)
+            return n;
+    return count;
+}
+
+static void verifyAlarmDelay(float rate, float mains, HumFilterMode mode)
+{
+    PipelineParams params;
+    params.hum.mode = mode;
+    params.hum.mains_hz = mains;
+    params.sample_rate = rate;
+    params.filter_size = 1;
+    params.glitch.enabled = false;
+    LoadcellPipeline pipeline;
+    pipeline.configure(params);
+
+    const int settle = (int)rate * 2, after = 64;
+    const float step = 100000;
+    float converted[after], alarm[after];
+    uint32_t period_us = (uint32_t)lroundf(1e6f / rate);
+    for (int n = 0; n < settle + after; n++)
+    {
+        pipeline.process(n < settle ? 0 : (int32_t)step, n * period_us);
+        if (n >= settle)
+        {
+            converted[n - settle] = pipeline.getConverted();
+            alarm[n - settle] = pipeline.getAlarmInput();
+        }
+    }
+
+    // a threshold close to the new level is where the delay and the ringing of the cascade count
+    int half = stepDelay(converted, after, step, 0.5f);
+    int ninety = stepDelay(converted, after, step, 0.9f);
+    float overshoot = 0;
+    for (int n = 0; n < after; n++)
+        overshoot = fmaxf(overshoot, (converted[n] - step) / step);
+    int alarm_delay = stepDelay(alarm, after, step, 1.0f);
+    printf("%7.1f SPS %2.0f Hz %-5s: hum filter step 50%% after %d, 90%% after %d samples (%.1f ms), overshoot %.0f%%; alarm input after %d\n",
+           rate, mains, mode == HUM_FILTER_COMB ? "comb" : "notch", half, ninety, ninety * 1000 / rate, overshoot * 100, alarm_delay);
+    check(alarm_delay == 0, "alarm input step delay", rate, mains, mode, alarm_delay);
+}
+
+static void benchmark()
+{
+    HumFilterParams params;
+    params.mode = HUM_FILTER_COMB;
+    params.harmonics = HUM_FILTER_MAX_STAGES;
+    HumFilter filter;
+    filter.design(params, 2000);
+
+    const uint32_t samples = 10000000;
+    volatile int32_t sink = 0;
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t n = 0; n < samples; n++)
+        sink = filter.process((int32_t)(n * 2654435761u) >> 8);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    (void)sink;
+
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / samples;
+    printf("cost: %.1f ns per sample with %u stages (host)\n", ns, filter.getStageCount());
+}
+
+int main(int argc, char **argv)
+{
+    float rate = 0;
+    float mains = 50;
+    HumFilterMode mode = HUM_FILTER_NOTCH;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:m:cvh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'm':
+            mains = atof(optarg);
+            break;
+        case 'c':
+            mode = HUM_FILTER_COMB;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: humfilter [-r SPS [-m mains Hz] [-c comb] [-v coefficients]]\n");
+            return 2;
+        }
+    }
+
+    if (rate > 0)
+    {
+        verify(rate, mains, mode, verbose);
+    }
+    else
+    {
+        // NAU7802, HX711 and ADS1220 (turbo) rates, plus off-nominal adc clocks
+        const float rates[] = {80, 320, 322.4f, 90, 180, 350, 660, 1200, 2000, 1987.5f};
+        const float mains_list[] = {50, 60};
+        for (float r : rates)
+            for (float m : mains_list)
+            {
+                verify(r, m, HUM_FILTER_NOTCH, verbose);
+                verify(r, m, HUM_FILTER_COMB, verbose);
+            }
+        const float delay_rates[] = {80, 320, 2000};
+        for (float r : delay_rates)
+        {
+            verifyAlarmDelay(r, 50, HUM_FILTER_NOTCH);
+            verifyAlarmDelay(r, 50, HUM_FILTER_COMB);
+        }
+        benchmark();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,241 @@
+/*
+  MQTT publisher host harness
+
+  Runs the firmware's MqttPublisher (batching, QoS 1 window, offline spool) against a broker
+  on the host, fed with a synthetic load signal. Reports publish throughput, acks, spool
+  level and memory. Stop and restart the broker while it runs to exercise store-and-forward.
+
+    mosquitto -p 1883 &
+    mqttpub -h 127.0.0.1 -p 1883 -r 320 -d 60
+    mqttpub -r 0 -d 10 -b 80 -i 8                as fast as possible, max batch
+    mosquitto_sub -t 'sgbox/#' -v                 watch (payload is binary, see MqttBatch)
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <MqttPublisher.hpp>
+
+static volatile bool running = true;
+
+static void on_signal(int)
+{
+    running = false;
+}
+
+static uint32_t now_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+class PosixTransport : public MqttTransport
+{
+private:
+    int _fd = -1;
+
+public:
+    virtual bool connect(const char *host, uint16_t port) override
+    {
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *result;
+        char service[8];
+        snprintf(service, sizeof(service), "%u", port);
+        if (getaddrinfo(host, service, &hints, &result) != 0)
+            return false;
+
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        bool ok = _fd >= 0 && ::connect(_fd, result->ai_addr, result->ai_addrlen) == 0;
+        freeaddrinfo(result);
+        if (!ok)
+        {
+            close();
+            return false;
+        }
+
+        int one = 1;
+        setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+    virtual bool connected() override
+    {
+        return _fd >= 0;
+    }
+    virtual bool write(const uint8_t *data, size_t len) override
+    {
+        while (len > 0)
+        {
+            ssize_t n = send(_fd, data, len, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+    virtual int read(uint8_t *data, size_t len) override
+    {
+        ssize_t n = recv(_fd, data, len, MSG_DONTWAIT);
+        if (n > 0)
+            return n;
+        if (n == 0)
+            return -1; // closed by peer
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    virtual void close() override
+    {
+        if (_fd >= 0)
+            ::close(_fd);
+        _fd = -1;
+    }
+};
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    int port = 1883;
+    int rate = 320;
+    int duration = 30;
+    int batch = 64;
+    int inflight = 4;
+    int drain = 10;
+    bool stats = false;
+    const char *spool_path = "mqttpub_spool.bin";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "h:p:r:d:b:i:D:s:S")) != -1)
+    {
+        switch (opt)
+        {
+        case 'h':
+            host = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'b':
+            batch = atoi(optarg);
+            break;
+        case 'i':
+            inflight = atoi(optarg);
+            break;
+        case 'D':
+            drain = atoi(optarg);
+            break;
+        case 's':
+            spool_path = optarg;
+            break;
+        case 'S':
+            stats = true;
+            break;
+        default:
+            fprintf(stderr, "usage: mqttpub [-h host] [-p port] [-r SPS, 0 = max] [-d seconds] [-b batch records] [-i inflight] [-D drain rate] [-s spool file] [-S stats mode]\n");
+            return 2;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    PosixTransport transport;
+    MqttSession session(transport);
+    SpoolStdioFile spoolFile;
+    SpoolRing spool(spoolFile);
+    MqttPublisher publisher(session, spool);
+
+    if (!spool.open(spool_path, MQTT_SPOOL_SLOT_SIZE, 256))
+        fprintf(stderr, "[mqttpub] spool %s not available\n", spool_path);
+    else if (spool.getCount())
+        fprintf(stderr, "[mqttpub] %u messages left in spool from the last run\n", spool.getCount());
+
+    MqttPublisherConfig config;
+    config.host = host;
+    config.port = port;
+    config.connect.client_id = "mqttpub";
+    config.topic_prefix = "sgbox/mqttpub";
+    config.stats_mode = stats;
+    config.batch_records = batch;
+    config.max_inflight = inflight;
+    config.drain_rate = drain;
+
+    uint32_t start = now_ms();
+    publisher.configure(config, start);
+
+    uint64_t samples = 0;
+    uint32_t report = start;
+    bool was_connected = false;
+
+    while (running && now_ms() - start < (uint32_t)duration * 1000)
+    {
+        uint32_t now = now_ms();
+
+        // synthetic load: 1 Hz sine, rate samples/s with timestamps on the sample grid.
+        // max rate: one batch whenever the inflight window has room, timestamps 1 ms apart
+        uint64_t due;
+        if (rate)
+            due = (uint64_t)(now - start) * rate / 1000;
+        else
+            due = session.canPublish() && spool.getCount() == 0 ? samples + batch : samples;
+        for (; samples < due; samples++)
+        {
+            uint32_t t = rate ? start + samples * 1000 / rate : start + samples;
+            publisher.addSample(t, 100.0f * sinf(2 * M_PI * (t - start) / 1000.0f), now);
+        }
+
+        publisher.loop(now, true);
+
+        if (session.isConnected() != was_connected)
+        {
+            was_connected = session.isConnected();
+            fprintf(stderr, "[mqttpub] %s, %u messages spooled\n", was_connected ? "connected" : "disconnected", spool.getCount());
+        }
+
+        if (now - report >= MQTT_THROUGHPUT_WINDOW_MS)
+        {
+            const MqttPublisherStats &stats = publisher.getStats();
+            const MqttMetrics &metrics = session.getMetrics();
+            fprintf(stderr, "[mqttpub] %.1f msg/s, %.0f records/s, %.0f B/s, published %u, acked %u, retransmits %u, inflight %u, spooled %u, spool dropped %u\n",
+                    stats.messages_per_sec, stats.records_per_sec, stats.bytes_per_sec, metrics.published, metrics.acked,
+                    metrics.retransmits, session.getInflight(), spool.getCount(), spool.getDropped());
+            report = now;
+        }
+
+        if (rate)
+            usleep(5000);
+    }
+
+    session.disconnect(now_ms());
+
+    const MqttMetrics &metrics = session.getMetrics();
+    double elapsed = (now_ms() - start) / 1000.0;
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(stderr, "[mqttpub] %llu samples in %.1f s, %u records published, %u messages published, %u acked, %.1f msg/s, %u bytes sent, max ack latency %u ms\n",
+            (unsigned long long)samples, elapsed, publisher.getStats().records_published, metrics.published, metrics.acked,
+            metrics.acked / elapsed, metrics.bytes_sent, metrics.ack_latency_ms_max);
+    fprintf(stderr, "[mqttpub] memory: session %zu B, publisher %zu B, max rss %ld kB\n", sizeof(MqttSession), sizeof(MqttPublisher), usage.ru_maxrss);
+    return 0;
+}
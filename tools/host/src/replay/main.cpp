@@ -0,0 +1,415 @@
+/*
+  Capture replay
+
+  Runs the firmware sample pipeline (LoadcellPipeline) over recorded raw capture files
+  on the host, as fast as possible. Jobs are the cross product of input files and
+  parameter sweep values and are distributed over worker threads. Input is read through mmap,
+  encoded captures are decoded into memory once before the jobs start. Scale, zero and sample
+  rate come from the capture header, glitch rejection and hum filter are not recorded there
+  and are set on the command line.
+
+  Reports samples/sec per job and in total, so it doubles as benchmark for the DSP path.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <LoadcellPipeline.hpp>
+#include <CaptureFormat.hpp>
+#include <SampleCodec.hpp>
+
+// glitch rejection defaults of SensorConfig (ConfigStructs.hpp), shares of the fullrange
+#define GLITCH_K 5.0f
+#define GLITCH_FLOOR 0.01f
+#define GLITCH_MAX_STEP 0.5f
+
+struct MappedCapture
+{
+    std::string path;
+    const uint8_t *base = nullptr;
+    size_t size = 0;
+    const CaptureHeader *header = nullptr;
+    const CaptureSample *samples = nullptr;
+    size_t sample_count = 0;
+    std::vector<CaptureSample> decoded; // encoded captures
+};
+
+struct Job
+{
+    const MappedCapture *capture;
+    PipelineParams params;
+};
+
+struct JobResult
+{
+    PipelineStats stats;
+    double seconds = 0;
+};
+
+struct Options
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    std::vector<int> filter_sizes = {8};
+    TriggerMode trigger_mode = TRIGGER_OFF;
+    float trigger_level = 0;
+    float trigger_hysteresis = 0;
+    bool override_scale = false;
+    float scale_factor = 1.0;
+    bool override_zero = false;
+    int32_t zero_balance_raw = 0;
+    float sample_rate = 0; // 0: from the capture header
+    float glitch_fullrange = 0; // displayunit, 0: glitch rejection off
+    HumFilterParams hum;
+    const char *output_dir = nullptr;
+    std::vector<const char *> files;
+};
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: replay [options] capture.sgc...\n"
+            "  -j N        worker threads (default: number of cores)\n"
+            "  -f 4,8,16   filter sizes to sweep (default: 8)\n"
+            "  -t LEVEL    trigger level in displayunit, enables trigger\n"
+            "  -y HYST     trigger hysteresis (default: 0)\n"
+            "  -m MODE     trigger mode rising|falling|both (default: rising)\n"
+            "  -s SCALE    override sensor scale factor from capture header\n"
+            "  -z ZERO     override sensor zero balance raw from capture header\n"
+            "  -r RATE     override sample rate in SPS from capture header\n"
+            "  -g RANGE    glitch rejection with the firmware defaults for a sensor fullrange in displayunit\n"
+            "  -n MODE     hum filter notch|comb, optionally with the mains frequency: comb,60 (default: off)\n"
+            "  -o DIR      write processed samples as csv to DIR (default: no output, benchmark only)\n");
+    exit(2);
+}
+
+static bool map_capture(const char *path, MappedCapture &capture)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CaptureHeader))
+    {
+        fprintf(stderr, "%s: too small for a capture file\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        perror(path);
+        return false;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    capture.path = path;
+    capture.base = (const uint8_t *)base;
+    capture.size = st.st_size;
+    capture.header = (const CaptureHeader *)base;
+
+    if (capture.header->magic != CAPTURE_MAGIC || capture.header->version > CAPTURE_VERSION)
+    {
+        fprintf(stderr, "%s: not a capture file or unsupported version\n", path);
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    if (captureEncoding(*capture.header) == CAPTURE_ENCODING_DELTA_RICE)
+    {
+        // blocks up to the first damaged or truncated one, e.g. the end of a capture not closed
+        size_t offset = capture.header->header_size;
+        CodecBlockHeader block;
+        while (offset + sizeof(block) <= capture.size)
+        {
+            memcpy(&block, capture.base + offset, sizeof(block));
+            size_t size = sizeof(block) + block.payload_size;
+            if (!SampleCodec::headerValid(block) || offset + size > capture.size)
+                break;
+            size_t first = capture.decoded.size();
+            capture.decoded.resize(first + block.sample_count);
+            if (SampleCodec::decodeBlock(capture.base + offset, size, capture.decoded.data() + first, block.sample_count) == 0)
+            {
+                capture.decoded.resize(first);
+                fprintf(stderr, "%s: damaged block at sample %zu\n", path, first);
+                break;
+            }
+            offset += size;
+        }
+        capture.samples = capture.decoded.data();
+        capture.sample_count = capture.decoded.size();
+        return true;
+    }
+
+    capture.samples = (const CaptureSample *)(capture.base + capture.header->header_size);
+
+    // captures that were not closed properly have no sample count, derive it from file size
+    size_t available = (capture.size - capture.header->header_size) / sizeof(CaptureSample);
+    capture.sample_count = capture.header->sample_count;
+    if (capture.sample_count == 0 || capture.sample_count > available)
+        capture.sample_count = available;
+
+    return true;
+}
+
+static std::string output_path(const Options &options, const Job &job)
+{
+    std::string name = job.capture->path;
+    size_t slash = name.find_last_of('/');
+    if (slash != std::string::npos)
+        name = name.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos)
+        name = name.substr(0, dot);
+
+    return std::string(options.output_dir) + "/" + name + "_f" + std::to_string(job.params.filter_size) + ".csv";
+}
+
+static JobResult run_job(const Options &options, const Job &job)
+{
+    JobResult result;
+    LoadcellPipeline pipeline;
+    pipeline.configure(job.params);
+
+    FILE *out = nullptr;
+    static const size_t out_buffer_size = 1 << 16;
+    char out_buffer[out_buffer_size];
+    size_t out_fill = 0;
+
+    if (options.output_dir)
+    {
+        std::string path = output_path(options, job);
+        out = fopen(path.c_str(), "w");
+        if (!out)
+            perror(path.c_str());
+        else
+            fputs("timestamp_us,raw,converted,filtered,trigger\n", out);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    const CaptureSample *samples = job.capture->samples;
+    for (size_t i = 0; i < job.capture->sample_count; i++)
+    {
+        CaptureSample sample;
+        memcpy(&sample, &samples[i], sizeof(sample)); // header is packed, samples may be unaligned
+
+        bool triggered = pipeline.process(sample.raw, sample.timestamp_us);
+
+        if (out)
+        {
+            if (out_buffer_size - out_fill < 128)
+            {
+                fwrite(out_buffer, 1, out_fill, out);
+                out_fill = 0;
+            }
+            out_fill += snprintf(out_buffer + out_fill, out_buffer_size - out_fill, "%u,%d,%.6g,%.6g,%d\n",
+                                 sample.timestamp_us, sample.raw, pipeline.getConverted(), pipeline.getFiltered(), triggered ? 1 : 0);
+        }
+    }
+
+    if (out)
+    {
+        fwrite(out_buffer, 1, out_fill, out);
+        fclose(out);
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.stats = pipeline.getStats();
+    return result;
+}
+
+static std::vector<int> parse_list(const char *arg)
+{
+    std::vector<int> values;
+    char *end;
+    while (*arg)
+    {
+        values.push_back((int)strtol(arg, &end, 10));
+        if (end == arg)
+            usage();
+        arg = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    bool trigger = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:f:t:y:m:s:z:r:g:n:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            options.threads = atoi(optarg);
+            break;
+        case 'f':
+            // PipelineParams::filter_size is a uint8_t
+            options.filter_sizes = parse_list(optarg);
+            for (int filter_size : options.filter_sizes)
+            {
+                if (filter_size < 1 || filter_size > 255)
+                {
+                    fprintf(stderr, "filter size %d outside 1..255\n", filter_size);
+                    usage();
+                }
+            }
+            break;
+        case 't':
+            trigger = true;
+            options.trigger_level = atof(optarg);
+            break;
+        case 'y':
+            options.trigger_hysteresis = atof(optarg);
+            break;
+        case 'm':
+            if (!strcmp(optarg, "rising"))
+                options.trigger_mode = TRIGGER_RISING;
+            else if (!strcmp(optarg, "falling"))
+                options.trigger_mode = TRIGGER_FALLING;
+            else if (!strcmp(optarg, "both"))
+                options.trigger_mode = TRIGGER_BOTH;
+            else
+                usage();
+            break;
+        case 's':
+            options.override_scale = true;
+            options.scale_factor = atof(optarg);
+            break;
+        case 'z':
+            options.override_zero = true;
+            options.zero_balance_raw = atoi(optarg);
+            break;
+        case 'r':
+            options.sample_rate = atof(optarg);
+            break;
+        case 'g':
+            options.glitch_fullrange = atof(optarg);
+            if (options.glitch_fullrange <= 0)
+                usage();
+            break;
+        case 'n':
+        {
+            char *hz = strchr(optarg, ',');
+            if (hz)
+            {
+                *hz++ = 0;
+                options.hum.mains_hz = atof(hz);
+            }
+            if (!strcmp(optarg, "notch"))
+                options.hum.mode = HUM_FILTER_NOTCH;
+            else if (!strcmp(optarg, "comb"))
+                options.hum.mode = HUM_FILTER_COMB;
+            else
+                usage();
+            break;
+        }
+        case 'o':
+            options.output_dir = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    for (int i = optind; i < argc; i++)
+        options.files.push_back(argv[i]);
+
+    if (options.files.empty())
+        usage();
+    if (options.threads < 1)
+        options.threads = 1;
+    if (trigger && options.trigger_mode == TRIGGER_OFF)
+        options.trigger_mode = TRIGGER_RISING;
+
+    std::vector<MappedCapture> captures(options.files.size());
+    for (size_t i = 0; i < options.files.size(); i++)
+        if (!map_capture(options.files[i], captures[i]))
+            return 1;
+
+    // cross product of files and sweep values
+    std::vector<Job> jobs;
+    for (const MappedCapture &capture : captures)
+    {
+        for (int filter_size : options.filter_sizes)
+        {
+            Job job;
+            job.capture = &capture;
+            job.params.sensor_scale_factor = options.override_scale ? options.scale_factor : capture.header->sensor_scale_factor;
+            job.params.sensor_zero_balance_raw = options.override_zero ? options.zero_balance_raw : capture.header->sensor_zero_balance_raw;
+            job.params.filter_size = filter_size;
+            job.params.sample_rate = options.sample_rate > 0 ? options.sample_rate : capture.header->sample_rate;
+            job.params.hum = options.hum;
+            if (options.glitch_fullrange > 0)
+            {
+                // thresholds relative to the span in counts, as LoadcellClass::applyPipelineConfig
+                float span_counts = fabsf(options.glitch_fullrange * job.params.sensor_scale_factor);
+                job.params.glitch.enabled = true;
+                job.params.glitch.k = GLITCH_K;
+                job.params.glitch.min_deviation = (int32_t)(GLITCH_FLOOR * span_counts);
+                job.params.glitch.max_step = (int32_t)(GLITCH_MAX_STEP * span_counts);
+            }
+            job.params.trigger_mode = trigger ? options.trigger_mode : TRIGGER_OFF;
+            job.params.trigger_level = options.trigger_level;
+            job.params.trigger_hysteresis = options.trigger_hysteresis;
+            jobs.push_back(job);
+        }
+    }
+
+    std::vector<JobResult> results(jobs.size());
+    std::atomic<size_t> next_job(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < options.threads && t < jobs.size(); t++)
+    {
+        workers.emplace_back([&]()
+                             {
+            size_t i;
+            while ((i = next_job.fetch_add(1)) < jobs.size())
+                results[i] = run_job(options, jobs[i]); });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+
+    double total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t total_samples = 0;
+    printf("file\tfilter\tsamples\tmin\tmax\tmean\ttriggers\tseconds\tsamples/s\n");
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const PipelineStats &stats = results[i].stats;
+        printf("%s\t%u\t%u\t%.6g\t%.6g\t%.6g\t%u\t%.4f\t%.0f\n",
+               jobs[i].capture->path.c_str(), jobs[i].params.filter_size, stats.count,
+               stats.min, stats.max, stats.mean, stats.triggers,
+               results[i].seconds, results[i].seconds > 0 ? stats.count / results[i].seconds : 0.0);
+        total_samples += stats.count;
+    }
+    printf("total: %llu samples in %.4f s, %.0f samples/s on %zu threads\n",
+           (unsigned long long)total_samples, total_seconds,
+           total_seconds > 0 ? total_samples / total_seconds : 0.0, workers.size());
+
+    for (const MappedCapture &capture : captures)
+        munmap((void *)capture.base, capture.size);
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+  Seqlock stress test
+
+  One writer thread publishes a telemetry struct as fast as it can (or at a fixed rate),
+  reader threads copy it concurrently and check that every copy belongs to a single
+  publish: all fields are derived from the same counter. Reports torn reads (must be 0),
+  reader retries and the writer publish time, which must not depend on the readers.
+
+    seqlock_stress                    4 readers, 10 s, writer unthrottled
+    seqlock_stress -r 8 -d 30 -p 500  8 readers, 30 s, one publish per 500 us like 2000 SPS
+
+  Exit code 1 on a torn or out of order read.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <Seqlock.hpp>
+#include <LoadcellPipeline.hpp>
+
+// same shape as LoadcellTelemetry of the firmware
+struct Telemetry
+{
+    uint32_t sequence;
+    int32_t raw;
+    uint32_t millis;
+    uint32_t micros;
+    float converted;
+    float filtered;
+    PipelineStats stats;
+    float temperature;
+    uint32_t check; // copy of sequence, written last
+};
+
+struct ReaderResult
+{
+    uint64_t reads = 0;
+    uint64_t retries = 0;
+    uint64_t torn = 0;
+    uint64_t backwards = 0;
+};
+
+static uint64_t monotonic_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static Telemetry make(uint32_t n)
+{
+    Telemetry t;
+    t.sequence = n;
+    t.raw = (int32_t)(n * 7);
+    t.millis = n / 2;
+    t.micros = n * 500;
+    t.converted = (float)(n % 100000);
+    t.filtered = t.converted + 0.5f;
+    t.stats.count = n;
+    t.stats.min = -(float)(n % 1000);
+    t.stats.max = (float)(n % 1000);
+    t.stats.mean = t.converted;
+    t.stats.triggers = n / 3;
+    t.stats.last_trigger_timestamp_us = n * 3;
+    t.stats.interval_us_min = n;
+    t.stats.interval_us_max = n + 1;
+    t.stats.interval_us_mean = (float)(n % 777);
+    t.temperature = (float)(n % 50);
+    t.check = n;
+    return t;
+}
+
+static bool consistent(const Telemetry &t)
+{
+    Telemetry expected = make(t.sequence);
+    return t.raw == expected.raw && t.millis == expected.millis && t.micros == expected.micros &&
+           t.converted == expected.converted && t.filtered == expected.filtered &&
+           t.stats.count == expected.stats.count && t.stats.min == expected.stats.min &&
+           t.stats.max == expected.stats.max && t.stats.mean == expected.stats.mean &&
+           t.stats.triggers == expected.stats.triggers &&
+           t.stats.last_trigger_timestamp_us == expected.stats.last_trigger_timestamp_us &&
+           t.stats.interval_us_min == expected.stats.interval_us_min &&
+           t.stats.interval_us_max == expected.stats.interval_us_max &&
+           t.stats.interval_us_mean == expected.stats.interval_us_mean &&
+           t.temperature == expected.temperature && t.check == t.sequence;
+}
+
+int main(int argc, char **argv)
+{
+    int readers = 4;
+    double seconds = 10;
+    uint32_t period_us = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:d:p:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            readers = atoi(optarg);
+            break;
+        case 'd':
+            seconds = atof(optarg);
+            break;
+        case 'p':
+            period_us = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: seqlock_stress [-r readers] [-d seconds] [-p writer period us, 0: unthrottled]\n");
+            return 2;
+        }
+    }
+
+    Seqlock<Telemetry> snapshot;
+    snapshot.write(make(0));
+    std::atomic<bool> running{true};
+
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; i++)
+    {
+        threads.emplace_back([&, i]()
+                             {
+            ReaderResult &result = results[i];
+            uint32_t last = 0;
+            while (running.load(std::memory_order_relaxed))
+            {
+                Telemetry t;
+                if (!snapshot.tryRead(t))
+                {
+                    result.retries++;
+                    continue;
+                }
+                result.reads++;
+                if (!consistent(t))
+                    result.torn++;
+                if (t.sequence < last)
+                    result.backwards++;
+                last = t.sequence;
+            } });
+    }
+
+    uint64_t publishes = 0;
+    uint64_t write_ns_max = 0;
+    uint64_t write_ns_sum = 0;
+    uint64_t start = monotonic_ns();
+    uint64_t end = start + (uint64_t)(seconds * 1e9);
+    uint64_t next = start;
+
+    for (uint64_t now = start; now < end; now = monotonic_ns())
+    {
+        if (period_us)
+        {
+            if (now < next)
+                continue;
+            next += period_us * 1000ull;
+        }
+
+        Telemetry t = make((uint32_t)++publishes);
+        uint64_t before = monotonic_ns();
+        snapshot.write(t);
+        uint64_t took = monotonic_ns() - before;
+        write_ns_sum += took;
+        if (took > write_ns_max)
+            write_ns_max = took;
+    }
+
+    running = false;
+    for (std::thread &thread : threads)
+        thread.join();
+
+    ReaderResult total;
+    for (const ReaderResult &result : results)
+    {
+        total.reads += result.reads;
+        total.retries += result.retries;
+        total.torn += result.torn;
+        total.backwards += result.backwards;
+    }
+
+    double elapsed = (monotonic_ns() - start) / 1e9;
+    printf("%d readers, %.1f s, struct %zu bytes\n", readers, elapsed, sizeof(Telemetry));
+    printf("writer: %llu publishes (%.0f/s), write mean %.0f ns, max %llu ns\n", (unsigned long long)publishes, publishes / elapsed,
+           publishes ? (double)write_ns_sum / publishes : 0.0, (unsigned long long)write_ns_max);
+    printf("readers: %llu reads (%.0f/s), retries %llu (%.2f%%), torn %llu, out of order %llu: %s\n",
+           (unsigned long long)total.reads, total.reads / elapsed, (unsigned long long)total.retries,
+           100.0 * total.retries / (total.reads + total.retries), (unsigned long long)total.torn,
+           (unsigned long long)total.backwards, total.torn || total.backwards ? "FAIL" : "ok");
+
+    return total.torn || total.backwards ? 1 : 0;
+}
@@ -0,0 +1,300 @@
+/*
+  Serial protocol verification
+
+  Checks the framing of the USB serial link (SerialProtocol) as SerialStream sends it and
+  sgstream decodes it:
+    - round trip of every payload length 0..SP_MAX_PAYLOAD, random content with zeros and
+      long runs without zeros (COBS block boundaries), wire length within SP_MAX_ENCODED
+    - every single bit error of a frame is rejected, none decodes to a frame
+    - a frame cut at every length is rejected and the following frame decodes
+    - garbage, plain text and overlong input between frames: every frame is recovered,
+      nothing else decodes
+    - samples: 24 bit raw values including the rails, timestamps across the wrap
+  Reports the decode rate.
+
+    serialproto            all checks, exit code 1 on failure
+    serialproto -s 7       seed of the random content
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <SerialProtocol.hpp>
+
+using namespace SerialProtocol;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double value, double expected)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s: %g, expected %g\n", what, value, expected);
+    }
+}
+
+class Noise
+{
+private:
+    uint32_t _state;
+
+public:
+    Noise(uint32_t seed) : _state(seed ? seed : 1) {}
+
+    uint32_t next()
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+};
+
+// payload of len bytes, pattern 0: random with zeros, 1: no zeros, 2: all zeros
+static void fillPayload(uint8_t *payload, size_t len, int pattern, Noise &rng)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t byte = rng.next();
+        if (pattern == 1 && byte == 0)
+            byte = 0xFF;
+        if (pattern == 2)
+            byte = 0;
+        payload[i] = byte;
+    }
+}
+
+struct Feed
+{
+    uint32_t frames = 0;
+    uint32_t matching = 0; // frames equal to the expected one
+};
+
+// feeds bytes, counts the decoded frames and those equal to type, seq, payload
+static Feed feed(FrameDecoder &decoder, const uint8_t *wire, size_t length, uint8_t type, uint16_t seq, const uint8_t *payload, size_t len)
+{
+    Feed result;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (!decoder.feed(wire[i]))
+            continue;
+        result.frames++;
+        if (decoder.type() == type && decoder.seq() == seq && decoder.payloadLength() == len &&
+            memcmp(decoder.payload(), payload, len) == 0)
+            result.matching++;
+    }
+    return result;
+}
+
+static void verifyRoundTrip(Noise &rng)
+{
+    uint8_t payload[SP_MAX_PAYLOAD];
+    uint8_t wire[SP_MAX_ENCODED];
+    FrameDecoder decoder;
+    uint32_t frames = 0, matching = 0;
+    size_t longest = 0;
+
+    for (int pattern = 0; pattern < 3; pattern++)
+    {
+        for (size_t len = 0; len <= SP_MAX_PAYLOAD; len++)
+        {
+            fillPayload(payload, len, pattern, rng);
+            uint16_t seq = rng.next();
+            size_t length = encodeFrame(FRAME_LOG + len % 3, seq, payload, len, wire);
+            if (length > longest)
+                longest = length;
+
+            // the only zeros are the delimiters
+            bool delimited = length >= 2 && wire[0] == 0 && wire[length - 1] == 0 && memchr(wire + 1, 0, length - 2) == nullptr;
+            check(delimited, "zeros only as delimiters", len, pattern);
+
+            Feed result = feed(decoder, wire, length, FRAME_LOG + len % 3, seq, payload, len);
+            frames += result.frames;
+            matching += result.matching;
+        }
+    }
+
+    uint32_t expected = 3 * (SP_MAX_PAYLOAD + 1);
+    printf("round trip: %u of %u frames, longest %zu bytes on the wire, limit %d\n", matching, expected, longest, SP_MAX_ENCODED);
+    check(frames == expected && matching == expected, "round trip", matching, expected);
+    check(longest <= SP_MAX_ENCODED, "wire length", longest, SP_MAX_ENCODED);
+    check(decoder.crc_errors == 0 && decoder.framing_errors == 0, "errors on clean input", decoder.crc_errors + decoder.framing_errors, 0);
+    check(encodeFrame(FRAME_LOG, 0, payload, SP_MAX_PAYLOAD + 1, wire) == 0, "payload too large", 1, 0);
+}
+
+static void verifyCorruption(Noise &rng)
+{
+    uint8_t payload[SP_MAX_PAYLOAD];
+    uint8_t wire[SP_MAX_ENCODED];
+    uint8_t next[SP_MAX_ENCODED];
+    const size_t lengths[] = {0, 1, 7, 63, 200, SP_MAX_PAYLOAD};
+    uint32_t flips = 0, accepted = 0, cuts = 0, resynced = 0, resync_expected = 0;
+
+    for (size_t len : lengths)
+    {
+        fillPayload(payload, len, 0, rng);
+        size_t length = encodeFrame(FRAME_SAMPLES, 1234, payload, len, wire);
+        uint8_t next_payload[3] = {1, 2, 3};
+        size_t next_length = encodeFrame(FRAME_ACK, 1235, next_payload, sizeof(next_payload), next);
+
+        // every bit between the delimiters, a flip to 0x00 splits the frame
+        for (size_t i = 1; i + 1 < length; i++)
+        {
+            for (int bit = 0; bit < 8; bit++)
+            {
+                FrameDecoder decoder;
+                wire[i] ^= 1 << bit;
+                Feed result = feed(decoder, wire, length, FRAME_SAMPLES, 1234, payload, len);
+                wire[i] ^= 1 << bit;
+                flips++;
+                accepted += result.frames;
+            }
+        }
+
+        // cut after every byte, the leading delimiter of the next frame ends the fragment. A cut
+        // right before the trailing delimiter leaves the frame complete
+        for (size_t cut = 1; cut + 1 < length; cut++)
+        {
+            FrameDecoder decoder;
+            Feed partial = feed(decoder, wire, cut, FRAME_SAMPLES, 1234, payload, len);
+            Feed following = feed(decoder, next, next_length, FRAME_ACK, 1235, next_payload, sizeof(next_payload));
+            cuts++;
+            accepted += partial.frames + following.frames - following.matching;
+            resynced += following.matching;
+            resync_expected++;
+        }
+    }
+
+    printf("corruption: %u bit flips and %u truncations, %u corrupt frames accepted, %u of %u following frames decoded\n",
+           flips, cuts, accepted, resynced, resync_expected);
+    check(accepted == 0, "corrupt frames accepted", accepted, 0);
+    check(resynced == resync_expected, "frame after a truncated one", resynced, resync_expected);
+}
+
+static void verifyResync(Noise &rng)
+{
+    uint8_t payload[SP_MAX_PAYLOAD];
+    uint8_t wire[SP_MAX_ENCODED];
+    FrameDecoder decoder;
+    uint32_t sent = 0, matching = 0, frames = 0;
+    const char *text = "[  1234][I][Loadcell.cpp:42] initialize(): Loadcell init\r\n";
+
+    for (int n = 0; n < 2000; n++)
+    {
+        // between frames: random bytes with zeros, log text as before streaming started, or
+        // more than a frame buffer without a delimiter
+        uint8_t garbage[2 * SP_MAX_ENCODED];
+        size_t garbage_length = 0;
+        switch (n % 4)
+        {
+        case 0:
+            garbage_length = rng.next() % 64;
+            fillPayload(garbage, garbage_length, 0, rng);
+            break;
+        case 1:
+            garbage_length = strlen(text);
+            memcpy(garbage, text, garbage_length);
+            break;
+        case 2:
+            garbage_length = sizeof(garbage);
+            fillPayload(garbage, garbage_length, 1, rng);
+            break;
+        }
+        for (size_t i = 0; i < garbage_length; i++)
+            frames += decoder.feed(garbage[i]);
+
+        size_t len = rng.next() % (SP_MAX_PAYLOAD + 1);
+        fillPayload(payload, len, 0, rng);
+        size_t length = encodeFrame(FRAME_SAMPLES, n, payload, len, wire);
+        Feed result = feed(decoder, wire, length, FRAME_SAMPLES, n, payload, len);
+        sent++;
+        frames += result.frames;
+        matching += result.matching;
+    }
+
+    printf("resync: %u of %u frames after garbage, %u decoded in total, %u crc and %u framing errors\n",
+           matching, sent, frames, decoder.crc_errors, decoder.framing_errors);
+    check(matching == sent, "frames after garbage", matching, sent);
+    check(frames == sent, "frames decoded from garbage", frames, sent);
+}
+
+static void verifySamples(Noise &rng)
+{
+    Sample samples[SP_MAX_SAMPLES_PER_FRAME];
+    Sample decoded[SP_MAX_SAMPLES_PER_FRAME];
+    uint8_t payload[SP_MAX_PAYLOAD];
+    const int32_t fixed[] = {0, 1, -1, 0x7FFFFF, -0x800000, 0x123456, -0x123456};
+    uint32_t mismatches = 0;
+
+    for (int n = 0; n < 1000; n++)
+    {
+        size_t count = n % (SP_MAX_SAMPLES_PER_FRAME + 1);
+        for (size_t i = 0; i < count; i++)
+        {
+            samples[i].timestamp_us = UINT32_MAX - 1000 + (n * SP_MAX_SAMPLES_PER_FRAME + i) * 3125;
+            samples[i].raw = i < 7 ? fixed[i] : (int32_t)(rng.next() << 8) >> 8;
+        }
+        size_t len = encodeSamples(samples, count, payload);
+        size_t got = decodeSamples(payload, len, decoded);
+        mismatches += got != count || len != count * SP_SAMPLE_SIZE;
+        for (size_t i = 0; i < got && i < count; i++)
+            mismatches += decoded[i].timestamp_us != samples[i].timestamp_us || decoded[i].raw != samples[i].raw;
+    }
+
+    printf("samples: %u mismatches\n", mismatches);
+    check(mismatches == 0, "sample round trip", mismatches, 0);
+}
+
+static void benchmark(Noise &rng)
+{
+    uint8_t payload[SP_MAX_PAYLOAD];
+    uint8_t wire[SP_MAX_ENCODED];
+    fillPayload(payload, sizeof(payload), 0, rng);
+    size_t length = encodeFrame(FRAME_SAMPLES, 0, payload, sizeof(payload), wire);
+
+    const uint32_t frames = 200000;
+    FrameDecoder decoder;
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t n = 0; n < frames; n++)
+        for (size_t i = 0; i < length; i++)
+            decoder.feed(wire[i]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double s = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("decode: %.1f MB/s, %.2f us per frame of %zu bytes (host)\n", frames * length / s / 1e6, s * 1e6 / frames, length);
+    check(decoder.frames == frames, "benchmark frames", decoder.frames, frames);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: serialproto [-s seed]\n");
+            return 2;
+        }
+    }
+
+    Noise rng(seed);
+    verifyRoundTrip(rng);
+    verifyCorruption(rng);
+    verifyResync(rng);
+    verifySamples(rng);
+    benchmark(rng);
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/*
+  Serial stream decoder
+
+  Talks SerialProtocol to the box over USB serial: starts streaming, decodes sample frames
+  to csv on stdout (timestamp_us,raw) and prints the multiplexed log output on stderr.
+  Lost frames are detected by sequence number gaps, corrupted ones by CRC.
+
+    sgstream -d /dev/ttyACM0 > samples.csv
+    sgstream -d /dev/ttyACM0 -r 7 -t        set 320 SPS (NAU7802), tare, then stream
+    sgstream -d /dev/ttyACM0 -z             compressed sample frames (SampleCodec)
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <SerialProtocol.hpp>
+#include <SampleCodec.hpp>
+
+using namespace SerialProtocol;
+
+static volatile bool running = true;
+
+static void on_signal(int)
+{
+    running = false;
+}
+
+static int open_serial(const char *device)
+{
+    int fd = open(device, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(device);
+        return -1;
+    }
+
+    termios tty;
+    if (tcgetattr(fd, &tty) == 0)
+    {
+        cfmakeraw(&tty);
+        cfsetspeed(&tty, B115200);
+        tty.c_cc[VMIN] = 0;
+        tty.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tty);
+    }
+    return fd;
+}
+
+static void send_command(int fd, uint8_t command, int arg = -1)
+{
+    static uint16_t seq = 0;
+    uint8_t payload[2] = {command, (uint8_t)arg};
+    uint8_t wire[SP_MAX_ENCODED];
+    size_t len = encodeFrame(FRAME_COMMAND, seq++, payload, arg < 0 ? 1 : 2, wire);
+    if (write(fd, wire, len) != (ssize_t)len)
+        perror("write");
+}
+
+static double now_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const char *device = "/dev/ttyACM0";
+    int rate = -1;
+    bool tare = false;
+    bool start = true;
+    bool packed = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:r:tnzh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            device = optarg;
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 't':
+            tare = true;
+            break;
+        case 'n':
+            start = false;
+            break;
+        case 'z':
+            packed = true;
+            break;
+        default:
+            fprintf(stderr, "usage: sgstream [-d device] [-r adc rate enum] [-t tare] [-n do not send start] [-z compressed]\n");
+            return 2;
+        }
+    }
+
+    int fd = open_serial(device);
+    if (fd < 0)
+        return 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    if (rate >= 0)
+        send_command(fd, CMD_SET_RATE, rate);
+    if (tare)
+        send_command(fd, CMD_TARE);
+    if (start)
+        send_command(fd, CMD_START, packed ? 1 : -1);
+
+    FrameDecoder decoder;
+    Sample samples[SP_MAX_SAMPLES_PER_FRAME];
+    CaptureSample block[CODEC_MAX_BLOCK_SAMPLES];
+    uint32_t next_index = 0;
+    uint64_t lost_samples = 0;
+    uint64_t sample_bytes = 0;
+    bool have_seq = false;
+    uint16_t expected_seq = 0;
+    uint32_t lost_frames = 0;
+    uint64_t sample_count = 0;
+    uint64_t sample_count_last = 0;
+    double report_time = now_s();
+
+    printf("timestamp_us,raw\n");
+
+    while (running)
+    {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) < 0 && errno != EINTR)
+            break;
+
+        uint8_t buffer[4096];
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        for (ssize_t i = 0; i < len; i++)
+        {
+            if (!decoder.feed(buffer[i]))
+                continue;
+
+            if (have_seq && decoder.seq() != expected_seq)
+                lost_frames += (uint16_t)(decoder.seq() - expected_seq);
+            expected_seq = decoder.seq() + 1;
+            have_seq = true;
+
+            switch (decoder.type())
+            {
+            case FRAME_SAMPLES:
+            {
+                size_t count = decodeSamples(decoder.payload(), decoder.payloadLength(), samples);
+                for (size_t s = 0; s < count; s++)
+                    printf("%u,%d\n", samples[s].timestamp_us, samples[s].raw);
+                sample_count += count;
+                sample_bytes += decoder.payloadLength();
+                break;
+            }
+            case FRAME_SAMPLES_PACKED:
+            {
+                const CodecBlockHeader *header = (const CodecBlockHeader *)decoder.payload();
+                size_t count = SampleCodec::decodeBlock(decoder.payload(), decoder.payloadLength(), block, CODEC_MAX_BLOCK_SAMPLES);
+                if (count == 0)
+                {
+                    fprintf(stderr, "[sgstream] damaged sample block\n");
+                    break;
+                }
+                // block positions count from the start command, gaps are lost frames
+                if (header->first_index > next_index)
+                    lost_samples += header->first_index - next_index;
+                next_index = header->first_index + count;
+
+                for (size_t s = 0; s < count; s++)
+                    printf("%u,%d\n", block[s].timestamp_us, block[s].raw);
+                sample_count += count;
+                sample_bytes += decoder.payloadLength();
+                break;
+            }
+            case FRAME_LOG:
+                fwrite(decoder.payload(), 1, decoder.payloadLength(), stderr);
+                break;
+            case FRAME_ACK:
+                if (decoder.payloadLength() >= 2)
+                    fprintf(stderr, "[sgstream] ack command 0x%02x: %s\n", decoder.payload()[0], decoder.payload()[1] ? "error" : "ok");
+                break;
+            }
+        }
+
+        double now = now_s();
+        if (now - report_time >= 5.0)
+        {
+            fprintf(stderr, "[sgstream] %.1f samples/s, %llu samples, %.2f payload bytes/sample, %u frames lost, %u crc errors, %u framing errors\n",
+                    (sample_count - sample_count_last) / (now - report_time), (unsigned long long)sample_count,
+                    sample_count ? (double)sample_bytes / sample_count : 0.0, lost_frames, decoder.crc_errors, decoder.framing_errors);
+            fflush(stdout);
+            sample_count_last = sample_count;
+            report_time = now;
+        }
+    }
+
+    if (start)
+        send_command(fd, CMD_STOP);
+    close(fd);
+
+    fprintf(stderr, "[sgstream] %llu samples, %u frames lost, %llu samples lost in packed frames, %u crc errors\n",
+            (unsigned long long)sample_count, lost_frames, (unsigned long long)lost_samples, decoder.crc_errors);
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+  Simulated strain gauge boxes
+
+  Serves N fake boxes on loopback, each with its own /events stream of "samples" events
+  like the firmware sends them (SampleBlock: <index>,<first_us>,<span_us>,<value>,...).
+  Every box has a random boot time, a clock drift of up to -d ppm, transport jitter and
+  optionally lost samples. All boxes see the same sine load at the same host time, so the
+  aggregator alignment can be checked by comparing the columns:
+
+    simbox -n 4 -p 8080 &
+    aggregator 127.0.0.1:8080 127.0.0.1:8081 127.0.0.1:8082 127.0.0.1:8083
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SampleBlock.hpp>
+
+#define SIM_BLOCK_AGE_US 100000 // like SAMPLEEVENTS_MAX_AGE_MS
+
+struct SimOptions
+{
+    int boxes = 4;
+    int port = 8080;
+    float rate = 320;
+    int jitter_ms = 20;
+    float drift_ppm = 50;
+    float loss = 0;
+    float frequency = 0.2;
+};
+
+struct SimBox
+{
+    int number;
+    int64_t boot_us;
+    double drift_ppm;
+};
+
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// micros() of the box at host time t_us
+static uint32_t box_micros(const SimBox &box, int64_t t_us)
+{
+    return (uint32_t)(int64_t)((t_us - box.boot_us) * (1 + box.drift_ppm * 1e-6));
+}
+
+static void serve_client(int sock, SimBox box, SimOptions options)
+{
+    // consume request header, any path is answered with the event stream
+    char request[1024];
+    if (recv(sock, request, sizeof(request), 0) <= 0)
+    {
+        close(sock);
+        return;
+    }
+
+    std::string header = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n\r\n";
+    send(sock, header.data(), header.size(), MSG_NOSIGNAL);
+
+    std::mt19937 random(box.number);
+    std::uniform_int_distribution<int> jitter(0, options.jitter_ms * 1000);
+    std::uniform_real_distribution<float> lost(0, 1);
+    SampleBlockWriter block;
+    int64_t start_us = now_us();
+    int64_t block_us = start_us;
+    uint32_t id = 1;
+    bool connected = true;
+
+    for (uint32_t index = 0; connected; index++)
+    {
+        // adc clocked by the box, i.e. the sample period drifts with the box clock
+        int64_t sample_us = start_us + (int64_t)(index * 1e6 / options.rate / (1 + box.drift_ppm * 1e-6));
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::microseconds(sample_us)));
+        float value = sinf(2 * M_PI * options.frequency * (sample_us / 1e6)) * 100.0;
+
+        if (lost(random) < options.loss)
+            continue;
+
+        if (block.isEmpty())
+            block_us = sample_us;
+        bool added = block.add(index, box_micros(box, sample_us), value);
+        if (added && sample_us - block_us < SIM_BLOCK_AGE_US)
+            continue;
+
+        // transport latency between reading and sending
+        std::this_thread::sleep_for(std::chrono::microseconds(jitter(random)));
+
+        char event[SAMPLEBLOCK_SIZE + 64];
+        int len = snprintf(event, sizeof(event), "id: %u\nevent: %s\ndata: %s\n\n", id++, SAMPLEBLOCK_CHANNEL, block.text());
+        connected = send(sock, event, len, MSG_NOSIGNAL) == len;
+
+        // a sample that did not fit (full, or after a lost one) starts the next block
+        block.clear();
+        block_us = sample_us;
+        if (!added)
+            block.add(index, box_micros(box, sample_us), value);
+    }
+
+    close(sock);
+}
+
+static void serve_box(SimBox box, SimOptions options)
+{
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(options.port + box.number);
+    if (bind(server, (sockaddr *)&address, sizeof(address)) != 0 || listen(server, 4) != 0)
+    {
+        perror("bind");
+        return;
+    }
+
+    fprintf(stderr, "box %d on 127.0.0.1:%d, micros %u, drift %+.1f ppm\n", box.number, options.port + box.number,
+            (unsigned)box_micros(box, now_us()), box.drift_ppm);
+
+    while (true)
+    {
+        int client = accept(server, nullptr, nullptr);
+        if (client >= 0)
+            std::thread(serve_client, client, box, options).detach();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    SimOptions options;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:r:j:d:l:f:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            options.boxes = atoi(optarg);
+            break;
+        case 'p':
+            options.port = atoi(optarg);
+            break;
+        case 'r':
+            options.rate = atof(optarg);
+            break;
+        case 'j':
+            options.jitter_ms = atoi(optarg);
+            break;
+        case 'd':
+            options.drift_ppm = atof(optarg);
+            break;
+        case 'l':
+            options.loss = atof(optarg);
+            break;
+        case 'f':
+            options.frequency = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: simbox [-n boxes] [-p first port] [-r samples/s] [-j max jitter ms] [-d max drift ppm]\n"
+                            "              [-l lost sample fraction] [-f sine Hz]\n");
+            return 2;
+        }
+    }
+    if (options.rate <= 0)
+        options.rate = 320;
+
+    srand(time(nullptr));
+
+    std::vector<std::thread> threads;
+    for (int number = 0; number < options.boxes; number++)
+    {
+        // each box booted at a different time, up to the micros() wrap, and has its own crystal
+        SimBox box;
+        box.number = number;
+        box.boot_us = now_us() - 1000000LL * (1 + rand() % 4200);
+        box.drift_ppm = options.drift_ppm * (2.0 * rand() / RAND_MAX - 1);
+        threads.emplace_back(serve_box, box, options);
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    return 0;
+}
@@ -0,0 +1,1263 @@
+/*
+  Soak test on the host
+
+  Simulated multi-day operation in accelerated time. The portable cores of the firmware run
+  on the schedule of the firmware tasks (src/main.cpp): AdcMock through LoadcellPipeline into
+  the HistoryStore and the AlarmEngine, captures through SampleCodec, the server sent events
+  through EventFanout with clients that come and go, the web api config and command routes
+  (ApiRouter, ApiHandlers), the display pages on a null canvas and a simulated fuel gauge.
+  Time is simulated, a day at 320 SPS takes about 15 s.
+
+  The config is the firmware's: the ConfigStructs of system, sensor, adc, mqtt and alarm are
+  written and applied through PooledJsonDocument like FirmwareApiBackend, saved through the
+  storage queue and loaded in the storage task (Storage.hpp and FFat.h stand-ins in
+  tools/host/shim). Commands
+  and messages go through the events: tare, alarm acknowledge, and the alarm messages as
+  DataEvent with String payloads like Task_Alarm, into the "message" channel. One client
+  subscribes the "samples" blocks like the aggregator, produced only while it is connected
+  as by Task_SampleEvents.
+
+  Tracked per simulated hour: heap allocations and live bytes (operator new), malloc arena
+  and free chunks (glibc), events published, delivered and dropped, connected clients and
+  the wall time per simulated second. After the first hour (boot and warm up) the run fails
+  if the acquisition, display, info or event paths allocate, the heap or the arena grows,
+  clients or queued events leak, a loaded config differs from the saved one, a JSON document
+  misses the pool, the iterations get slower, or the sample clock drifts against the
+  simulated time, including across the 32 bit micros() wrap every 71.6 minutes. The web
+  requests, the storage task and the messages allocate briefly, as on the box (String, JSON
+  parse), and are counted apart.
+
+    soak [-d days] [-r samplerate] [-s seed] [-v]
+*/
+
+#include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <vector>
+
+#include <AdcMock.hpp>
+#include <AlarmEngine.hpp>
+#include <ApiHandlers.hpp>
+#include <CaptureFormat.hpp>
+#include <ConfigStructs.hpp>
+#include <DataEvent.hpp>
+#include <DisplayPages.hpp>
+#include <EventFanout.hpp>
+#include <HistoryStore.hpp>
+#include <JsonPool.hpp>
+#include <LoadcellPipeline.hpp>
+#include <SampleBlock.hpp>
+#include <SampleCodec.hpp>
+#include <Seqlock.hpp>
+#include <Storage.hpp>
+
+static int failures = 0;
+
+// ---- heap tracking -------------------------------------------------------------------------
+
+static uint64_t alloc_count = 0;
+static uint64_t transient_count = 0; // see TransientAllocations
+static uint64_t alloc_bytes = 0;
+static int64_t live_bytes = 0;
+static int transient_depth = 0;
+
+// Scope of the work that allocates briefly on the box too: web requests (String, JSON parse),
+// the storage task and the String messages. Counted apart, the memory has to come back
+struct TransientAllocations
+{
+    TransientAllocations() { transient_depth++; }
+    ~TransientAllocations() { transient_depth--; }
+};
+
+void *operator new(size_t size)
+{
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    if (transient_depth)
+        transient_count++;
+    else
+        alloc_count++;
+    alloc_bytes += size;
+    live_bytes += malloc_usable_size(ptr);
+    return ptr;
+}
+
+// not inlined, gcc would see free() on a pointer from operator new
+__attribute__((noinline)) void operator delete(void *ptr) noexcept
+{
+    if (ptr)
+        live_bytes -= malloc_usable_size(ptr);
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+struct HeapSnapshot
+{
+    uint64_t allocs = 0;
+    uint64_t transient = 0;
+    int64_t live = 0;
+    size_t arena = 0;       // bytes the allocator got from the system
+    size_t in_use = 0;      // bytes in allocated chunks, operator new and malloc
+    size_t free_chunks = 0; // fragments, grows if allocations of varying life time interleave
+};
+
+static HeapSnapshot heapSnapshot()
+{
+    HeapSnapshot snapshot;
+    snapshot.allocs = alloc_count;
+    snapshot.transient = transient_count;
+    snapshot.live = live_bytes;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    snapshot.arena = info.arena + info.hblkhd;
+    snapshot.in_use = info.uordblks + info.hblkhd;
+    snapshot.free_chunks = info.ordblks + info.smblks;
+#endif
+    return snapshot;
+}
+
+// ---- simulated time ------------------------------------------------------------------------
+
+static uint64_t sim_us = 0;
+
+static uint64_t sim_clock() { return sim_us; }
+static uint32_t sim_micros() { return (uint32_t)sim_us; } // wraps like micros()
+static uint32_t sim_millis() { return (uint32_t)(sim_us / 1000); }
+
+// the clock of the Arduino.h stand-in, for g_Storage and the config structs
+uint32_t micros() { return sim_micros(); }
+uint32_t millis() { return sim_millis(); }
+
+class Noise
+{
+private:
+    uint32_t _state = 1;
+
+public:
+    void seed(uint32_t seed) { _state = seed ? seed : 1; }
+
+    float next(float amplitude)
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return ((float)_state / 4294967296.0f * 2.0f - 1.0f) * amplitude;
+    }
+
+    // 0..1
+    float uniform() { return next(0.5f) + 0.5f; }
+};
+
+static Noise noise;
+
+// ---- fuel gauge ----------------------------------------------------------------------------
+
+// as FuelgaugeStatus
+struct BatteryStatus
+{
+    bool available = true;
+    float percent = 100;
+    float voltage = 4.2;
+    float charge_rate = 0; // %/h
+};
+
+// discharges, recharges for a few hours every simulated day
+class SimFuelgauge
+{
+private:
+    float _percent = 100;
+    Seqlock<BatteryStatus> _status;
+
+public:
+    void update_loop()
+    {
+        uint32_t hour_of_day = (uint32_t)(sim_us / 3600000000ull) % 24;
+        float rate = hour_of_day < 4 ? 20.0f : -3.5f;
+        _percent += rate * 2.0f / 3600.0f; // every 2 s
+
+        BatteryStatus status;
+        status.percent = _percent < 0 ? 0 : (_percent > 100 ? 100 : _percent);
+        status.voltage = 3.3f + 0.9f * status.percent / 100.0f;
+        status.charge_rate = rate;
+        _status.write(status);
+    }
+
+    BatteryStatus getStatus() const { return _status.read(); }
+};
+
+// ---- event stream clients ------------------------------------------------------------------
+
+// clients that drain slowly at times, like a browser tab in the background
+class SimTransport : public FanoutTransport
+{
+public:
+    struct Client
+    {
+        bool connected = false;
+        bool slow = false;
+        uint32_t last_id = 0;
+        uint64_t bytes = 0;
+        uint32_t events = 0;
+    };
+
+    Client clients[FANOUT_MAX_CLIENTS];
+
+    bool canSend(void *handle, size_t len) override
+    {
+        Client &client = *(Client *)handle;
+        return !client.slow || noise.uniform() < 0.2f;
+    }
+
+    bool send(void *handle, const char *buffer, size_t len) override
+    {
+        ((Client *)handle)->bytes += len;
+        return true;
+    }
+
+    void delivered(void *handle, const FanoutEvent &event) override
+    {
+        Client &client = *(Client *)handle;
+        client.last_id = event.id;
+        client.events++;
+    }
+
+    uint32_t connected() const
+    {
+        uint32_t count = 0;
+        for (const Client &client : clients)
+            count += client.connected;
+        return count;
+    }
+};
+
+// ---- web api -------------------------------------------------------------------------------
+
+#define SOAK_BODY_SIZE 256
+#define SOAK_RESPONSE_SIZE 1024
+
+class SoakRequest : public ApiRequest
+{
+public:
+    ApiMethod _method = API_GET;
+    const char *_path = "";
+    const char *_body = "";
+    size_t _bodyLength = 0;
+
+    ApiMethod method() const override { return _method; }
+    const char *path() const override { return _path; }
+    const char *param(const char *name, bool post) const override { return nullptr; }
+    const char *header(const char *name) const override { return nullptr; }
+    const char *body() const override { return _body; }
+    size_t bodyLength() const override { return _bodyLength; }
+};
+
+// counts the body, keeps the start of it
+class SoakResponse : public ApiResponse
+{
+private:
+    class CountingSink : public ApiSink
+    {
+    public:
+        size_t bytes = 0;
+        size_t write(const char *data, size_t length) override
+        {
+            bytes += length;
+            return length;
+        }
+    };
+
+    CountingSink _sink;
+
+protected:
+    void doSend(int status, const char *type, const char *body, size_t length) override
+    {
+        bytes = length;
+        size_t n = std::min(length, sizeof(text) - 1);
+        memcpy(text, body, n);
+        text[n] = 0;
+    }
+
+    ApiSink &doBeginStream(int status, const char *type) override { return _sink; }
+    void doFinish() override { bytes = _sink.bytes; }
+
+public:
+    size_t bytes = 0;
+    char text[SOAK_RESPONSE_SIZE] = {0};
+};
+
+// the firmware modules' config structs, requests and commands as FirmwareApiBackend
+class SoakBackend : public ApiBackend
+{
+private:
+    LoadcellPipeline &_pipeline;
+    HistoryStore &_history;
+    AlarmEngine &_alarm;
+    char _json[JSON_POOL_LARGE_SIZE];
+    char _saved[JSON_POOL_LARGE_SIZE]; // config at the last save
+    size_t _savedLength = 0;
+
+    static void publish(const char *name)
+    {
+        Event ev(name);
+        EventManager::instance().publish(ev);
+    }
+
+    // in the storage task, as the load command of FirmwareApiBackend
+    static void loadConfiguration(void *context)
+    {
+        SoakBackend *backend = (SoakBackend *)context;
+        backend->system_config.loadConfiguration();
+        backend->sensor_config.loadConfiguration();
+        backend->adc_config.loadConfiguration();
+        backend->mqtt_config.loadConfiguration();
+        backend->alarm_config.loadConfiguration();
+        backend->applyAlarmConfig();
+        if (backend->serializeConfig(backend->_json, sizeof(backend->_json)) != backend->_savedLength ||
+            memcmp(backend->_json, backend->_saved, backend->_savedLength) != 0)
+            backend->mismatches++;
+        backend->loads++;
+    }
+
+    // as FirmwareApiBackend::writeConfig, into a buffer instead of a Print
+    size_t serializeConfig(char *buffer, size_t size)
+    {
+        PooledJsonDocument response_json(JSON_POOL_LARGE_SIZE);
+        PooledJsonDocument system = PooledJsonDocument(1024);
+        PooledJsonDocument sensor = PooledJsonDocument(1024);
+        PooledJsonDocument adc = PooledJsonDocument(1024);
+        PooledJsonDocument mqtt = PooledJsonDocument(1024);
+        PooledJsonDocument alarm = PooledJsonDocument(MAX_DOCUMENT_SIZE);
+
+        system_config.toDoc(system);
+        sensor_config.toDoc(sensor);
+        adc_config.toDoc(adc);
+        mqtt_config.toDoc(mqtt);
+        alarm_config.toDoc(alarm);
+
+        response_json["system"] = system;
+        response_json["sensor"] = sensor;
+        response_json["adc"] = adc;
+        response_json["mqtt"] = mqtt;
+        response_json["alarm"] = alarm;
+        return serializeJson(response_json, buffer, size);
+    }
+
+public:
+    SystemConfig system_config = SystemConfig("system.json");
+    SensorConfig sensor_config = SensorConfig("sensor.json");
+    Nau7802Config adc_config = Nau7802Config("adc.json");
+    MqttConfig mqtt_config = MqttConfig("mqtt.json");
+    AlarmConfig alarm_config = AlarmConfig("alarm.json");
+
+    uint32_t commands[API_CMD_COUNT] = {0};
+    uint32_t saves = 0;
+    uint32_t loads = 0;
+    uint32_t mismatches = 0; // loaded config differs from the saved one
+
+    SoakBackend(LoadcellPipeline &pipeline, HistoryStore &history, AlarmEngine &alarm) : _pipeline(pipeline), _history(history), _alarm(alarm) {}
+
+    // as Task_Alarm after a config change
+    void applyAlarmConfig() { _alarm.compile(alarm_config.rules, ALARM_MAX_RULES); }
+
+    bool command(ApiCommand command, const char *arg) override
+    {
+        if (command >= API_CMD_COUNT)
+            return false;
+        commands[command]++;
+        switch (command)
+        {
+        case API_CMD_SAVE_CONFIG:
+            system_config.saveConfiguration();
+            sensor_config.saveConfiguration();
+            adc_config.saveConfiguration();
+            mqtt_config.saveConfiguration();
+            alarm_config.saveConfiguration();
+            _savedLength = serializeConfig(_saved, sizeof(_saved));
+            saves++;
+            return true;
+        case API_CMD_LOAD_CONFIG:
+            return g_Storage.defer(loadConfiguration, this);
+        case API_CMD_TARE:
+            publish("Loadcell/tare");
+            return true;
+        case API_CMD_ALARM_ACK:
+            publish("Alarm/acknowledge");
+            return true;
+        default:
+            return true;
+        }
+    }
+
+    void writeConfig(ApiSink &out) override { out.write(_json, serializeConfig(_json, sizeof(_json))); }
+
+    bool applyConfig(const char *json, size_t length) override
+    {
+        PooledJsonDocument doc(JSON_POOL_LARGE_SIZE);
+        DeserializationError error = deserializeJson(doc, json, length);
+        if (error)
+        {
+            log_e("config from web: %s", error.c_str());
+            return false;
+        }
+
+        system_config.fromWeb(doc["system"]);
+        sensor_config.fromWeb(doc["sensor"]);
+        adc_config.fromWeb(doc["adc"]);
+        mqtt_config.fromWeb(doc["mqtt"]);
+        alarm_config.fromWeb(doc["alarm"]);
+        applyAlarmConfig();
+        return true;
+    }
+
+    PipelineStats getStats() override { return _pipeline.getStats(); }
+    PipelineParams getPipelineParams() override { return _pipeline.getParams(); }
+
+    void writeHistory(ApiSink &out, uint32_t from_ms, uint32_t to_ms, size_t points) override
+    {
+        char line[80];
+        bool first = true;
+        out.print("{\"points\":[");
+        int8_t level = _history.query(from_ms, to_ms, points, [&](const HistoryEntry &entry)
+                                      {
+                                          out.write(line, snprintf(line, sizeof(line), "%s[%u,%g,%g,%g]", first ? "" : ",", entry.t_ms, entry.min, entry.max, entry.mean));
+                                          first = false; });
+        out.write(line, snprintf(line, sizeof(line), "],\"level\":%d}", level));
+    }
+    bool getHistoryRange(uint32_t &oldest_ms, uint32_t &newest_ms) override { return _history.getRange(oldest_ms, newest_ms); }
+};
+
+// ---- display -------------------------------------------------------------------------------
+
+// draws no text, the trend plot goes into the buffer. Counts text off screen and transfers
+class NullCanvas : public DisplayCanvas
+{
+private:
+    DisplayFont _font = DISPLAY_FONT_SMALL;
+    uint8_t _buffer[128 * 64 / 8] = {0};
+
+public:
+    uint32_t strings = 0;
+    uint32_t glyphs = 0;
+    uint32_t errors = 0; // text off screen, unknown glyphs
+    uint64_t bytes_sent = 0;
+
+    uint16_t width() const override { return 128; }
+    uint16_t height() const override { return 64; }
+
+    void clear() override { memset(_buffer, 0, sizeof(_buffer)); }
+    void setFont(DisplayFont font) override { _font = font; }
+
+    void drawStr(int16_t x, int16_t y, const char *text) override
+    {
+        strings++;
+        if (x < 0 || x + getStrWidth(text) > width() || y > height())
+            errors++;
+    }
+
+    void drawGlyph(int16_t x, int16_t y, uint16_t glyph) override
+    {
+        glyphs++;
+        if (x < 0 || x > width() || glyph < DISPLAY_BATTERY_GLYPH || glyph > DISPLAY_BATTERY_GLYPH + 9)
+            errors++;
+    }
+
+    uint16_t getStrWidth(const char *text) override
+    {
+        static const uint8_t widths[] = {5, 16, 6, 8}; // DisplayFont
+        return strlen(text) * widths[_font];
+    }
+
+    uint8_t *getBuffer() override { return _buffer; }
+    void send() override { bytes_sent += sizeof(_buffer); }
+    void sendArea(uint8_t tile_x, uint8_t tile_y, uint8_t tile_width, uint8_t tile_height) override
+    {
+        bytes_sent += tile_width * tile_height * DISPLAY_TILE;
+    }
+};
+
+// ---- the box -------------------------------------------------------------------------------
+
+#define SOAK_HISTORY_CAPACITY 4096 // as lib/History
+#define SOAK_HISTORY_LEVELS 12
+#define SOAK_HISTORY_BASE 8
+#define SOAK_CAPTURE_BLOCK 128 // as CAPTURE_BLOCK_SAMPLES
+#define SOAK_CAPTURE_EVERY_H 6
+#define SOAK_CAPTURE_MINUTES 10
+#define SOAK_SAMPLES_QUEUE 64        // samples between two runs of the samples task
+#define SOAK_SAMPLES_MAX_AGE_US 100000 // as SAMPLEEVENTS_MAX_AGE_MS
+#define SOAK_SAMPLES_CLIENT 1        // subscribes the "samples" channel only, the aggregator
+
+enum SoakChannel : uint8_t
+{
+    CH_PING = 0,
+    CH_READING,
+    CH_FORCE,
+    CH_BATTERY,
+    CH_DERIVED,
+    CH_SAMPLES,
+    CH_MESSAGE,
+};
+
+struct HourStats
+{
+    HeapSnapshot heap;
+    FanoutMetrics fanout;
+    uint32_t clients = 0;
+    uint32_t samples = 0;
+    uint32_t frames = 0;
+    uint32_t requests = 0;
+    uint32_t messages = 0;
+    uint32_t sample_blocks = 0;
+    uint64_t capture_bytes = 0;
+    uint32_t p50_us = 0;
+    uint32_t p99_us = 0;
+    uint32_t max_us = 0;
+};
+
+class SoakBox
+{
+private:
+    AdcMock _adc;
+    AdcMockConfig _adcConfig;
+    LoadcellPipeline _pipeline;
+    std::vector<HistoryEntry> _historyMemory;
+    HistoryStore _history;
+    AlarmEngine _alarm;
+    SimFuelgauge _fuelgauge;
+    SimTransport _transport;
+    EventFanout _fanout;
+    ApiRouter _router;
+    SoakBackend _backend;
+    NullCanvas _canvas;
+    DisplayPages _pages;
+
+    // capture, encoded blocks are decoded again and compared
+    CaptureSample _block[SOAK_CAPTURE_BLOCK];
+    CaptureSample _decoded[SOAK_CAPTURE_BLOCK];
+    uint8_t _encoded[CODEC_MAX_BLOCK_SIZE(SOAK_CAPTURE_BLOCK)];
+    size_t _blockCount = 0;
+    uint32_t _captureIndex = 0;
+    bool _capturing = false;
+
+    uint64_t _nextSample_us = 0;
+    uint64_t _period_us = 0;
+    bool _tareRequest = false;
+
+    // "samples" event stream, as SampleEventsClass
+    struct QueuedSample
+    {
+        uint32_t index;
+        uint32_t timestamp_us;
+        float value;
+    };
+    QueuedSample _samplesQueue[SOAK_SAMPLES_QUEUE];
+    size_t _samplesQueued = 0;
+    uint32_t _samplesIndex = 0;
+    bool _samplesActive = false;
+    SampleBlockWriter _sampleBlock;
+    uint32_t _sampleBlockSince_us = 0;
+
+    void publish(uint8_t channel, const char *data, uint32_t source_us = 0)
+    {
+        _fanout.publish(channel, data, sim_millis(), source_us);
+    }
+
+    void request(ApiMethod method, const char *path, const char *body = "")
+    {
+        SoakRequest request;
+        request._method = method;
+        request._path = path;
+        request._body = body;
+        request._bodyLength = strlen(body);
+        SoakResponse response;
+        _router.dispatch(request, response);
+        if (response.status() != 200)
+        {
+            fprintf(stderr, "%s: status %d %s\n", path, response.status(), response.text);
+            stats.request_errors++;
+        }
+        stats.requests++;
+    }
+
+    void sendSampleBlock()
+    {
+        // what the aggregator parses
+        SampleBlock parsed;
+        if (!SampleBlock::parse(_sampleBlock.text(), parsed) || parsed.count != _sampleBlock.getCount() ||
+            parsed.timestamp(parsed.count - 1) != _sampleBlock.getLastUs())
+            stats.sample_block_errors++;
+        else if (_samplesIndex - parsed.index < parsed.count)
+            stats.sample_block_errors++; // index not counted
+        stats.block_samples += parsed.count;
+
+        publish(CH_SAMPLES, _sampleBlock.text(), _sampleBlock.getLastUs());
+        stats.sample_blocks++;
+        _sampleBlock.clear();
+    }
+
+    // FANOUT_ALL_CHANNELS without "samples", as EventStream subscribes without fields
+    uint32_t subscription(uint8_t client, bool all)
+    {
+        if (client == SOAK_SAMPLES_CLIENT)
+            return 1UL << CH_SAMPLES;
+        return all ? FANOUT_ALL_CHANNELS & ~(1UL << CH_SAMPLES) : _fanout.channelMask("force,battery,message");
+    }
+
+    void writeCaptureBlock()
+    {
+        size_t done = 0;
+        while (done < _blockCount)
+        {
+            CodecResult result = SampleCodec::encodeBlock(_block + done, _blockCount - done, _captureIndex, _encoded, sizeof(_encoded));
+            size_t n = SampleCodec::decodeBlock(_encoded, result.bytes, _decoded, SOAK_CAPTURE_BLOCK);
+            if (n != result.samples || memcmp(_decoded, _block + done, n * sizeof(CaptureSample)) != 0)
+                stats.capture_errors++;
+            stats.capture_bytes += result.bytes;
+            _captureIndex += result.samples;
+            done += result.samples;
+        }
+        _blockCount = 0;
+    }
+
+public:
+    struct
+    {
+        uint32_t samples = 0;
+        uint32_t alarms = 0;   // rule changes
+        uint32_t messages = 0; // "message" events: alarms and tare
+        uint32_t requests = 0;
+        uint32_t request_errors = 0;
+        uint32_t capture_errors = 0;
+        uint64_t capture_bytes = 0;
+        uint32_t captures = 0;
+        uint32_t reconnects = 0;
+        uint32_t history_lag_ms_max = 0;
+        uint32_t sample_blocks = 0;
+        uint32_t block_samples = 0;
+        uint32_t sample_block_errors = 0;
+        uint32_t samples_overruns = 0;
+    } stats;
+
+    SoakBox() : _fanout(_transport), _backend(_pipeline, _history, _alarm) {}
+
+    void begin(float samplerate)
+    {
+        _adc.setClock(sim_clock);
+        _adc.begin();
+        _adcConfig.samplerate = samplerate;
+        _adcConfig.signal_mv_per_v = 0.5;
+        _adcConfig.sine_mv_per_v = 0.05;
+        _adcConfig.sine_hz = 0.7;
+        _adcConfig.noise_counts = 400;
+        _adcConfig.fault_spike_every = 9973;
+        _adcConfig.fault_spike_counts = 2e6;
+        _adcConfig.fault_read_error_every = 50021;
+        _adc.configure(_adcConfig);
+        _period_us = (uint64_t)(1000000.0 / samplerate);
+        _nextSample_us = sim_us + _period_us;
+
+        PipelineParams params;
+        params.sensor_scale_factor = PipelineParams::calcScaleFactor(AdcMock::FULL_SCALE_COUNTS, _adcConfig.gain, 2.0, 1.0, 1000.0);
+        params.glitch.enabled = true;
+        params.glitch.min_deviation = (int32_t)(0.01f * 1000.0f * params.sensor_scale_factor);
+        params.glitch.max_step = (int32_t)(0.5f * 1000.0f * params.sensor_scale_factor);
+        params.hum.mode = HUM_FILTER_NOTCH;
+        params.sample_rate = samplerate;
+        _pipeline.configure(params);
+
+        _historyMemory.resize(HistoryStore::requiredMemory(SOAK_HISTORY_CAPACITY, SOAK_HISTORY_LEVELS) / sizeof(HistoryEntry) + 1);
+        _history.begin(_historyMemory.data(), SOAK_HISTORY_CAPACITY, SOAK_HISTORY_LEVELS, SOAK_HISTORY_BASE);
+
+        SensorConfig &sensor = _backend.sensor_config;
+        sensor.name = "soak";
+        sensor.fullrange = 1000;
+        sensor.sensitivity = 2;
+        sensor.displayunit = "kg";
+        sensor.digits = 1;
+
+        AlarmRuleParams *rules = _backend.alarm_config.rules;
+        rules[0].enabled = true;
+        rules[0].level = 300;
+        rules[0].hysteresis = 10;
+        rules[0].confirm_samples = 3;
+        rules[1].enabled = true;
+        rules[1].mode = ALARM_BELOW;
+        rules[1].level = 100;
+        rules[1].hysteresis = 10;
+        rules[1].latch = true;
+        rules[1].output = 1;
+        _backend.applyAlarmConfig();
+
+        const char *channels[] = {"ping", "reading", "force", "battery", "derived", SAMPLEBLOCK_CHANNEL, "message"};
+        for (uint8_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++)
+            _fanout.registerChannel(channels[i], i != CH_MESSAGE && i != CH_SAMPLES);
+
+        // the subscribers of Loadcell, Alarm and Webservice
+        EventManager::instance().subscribe([this](Event *ev)
+                                           {
+            if (ev->is("Loadcell/tare"))
+                _tareRequest = true;
+            else if (ev->is("Alarm/acknowledge"))
+                _alarm.acknowledge();
+            else if (ev->is("Webservice/sendMessage"))
+            {
+                publish(CH_MESSAGE, ((DataEvent *)ev)->data().c_str());
+                stats.messages++;
+            } });
+
+        _router.begin(_backend, sim_micros);
+        ApiHandlers::registerRoutes(_router);
+
+        _pages.begin(_canvas);
+        DisplayLayout::drawStatusMessage(_canvas, "Ready.");
+        _pages.invalidate();
+    }
+
+    uint64_t nextSample() const { return _nextSample_us; }
+
+    // Task_Loadcell: one conversion
+    void acquire()
+    {
+        if (_tareRequest)
+        {
+            // as LoadcellClass::applyRequests, the message String allocates in the acquisition
+            // task on the box too, once per tare
+            TransientAllocations transient;
+            _tareRequest = false;
+            _pipeline.setZeroBalanceRaw(_pipeline.getRaw());
+            _pipeline.resetIntegrals();
+            DataEvent ev("Webservice/sendMessage", "new zero offset: " + String((long)_pipeline.getRaw()));
+            EventManager::instance().publish(ev);
+        }
+
+        while (_adc.available())
+        {
+            int32_t raw = _adc.read();
+            uint32_t timestamp_us = sim_micros();
+            _pipeline.process(raw, timestamp_us, _adc.readFailed());
+            _history.add(sim_millis(), _pipeline.getConverted());
+            _alarm.process(_pipeline.getAlarmInput());
+            stats.samples++;
+
+            if (_samplesActive)
+            {
+                QueuedSample sample = {_samplesIndex++, timestamp_us, _pipeline.getConverted()};
+                if (_samplesQueued < SOAK_SAMPLES_QUEUE)
+                    _samplesQueue[_samplesQueued++] = sample;
+                else
+                    stats.samples_overruns++;
+            }
+
+            if (_capturing && _blockCount < SOAK_CAPTURE_BLOCK)
+            {
+                _block[_blockCount].timestamp_us = timestamp_us;
+                _block[_blockCount].raw = _pipeline.getRaw();
+                _blockCount++;
+            }
+        }
+        _nextSample_us += _period_us;
+    }
+
+    // load profile over the day: idle, a few load cycles per hour crossing the alarm levels
+    void updateSignal()
+    {
+        double t_h = sim_us / 3600e6;
+        double load = 0.4 + 0.35 * sin(2 * M_PI * t_h * 3) + 0.05 * sin(2 * M_PI * t_h / 24);
+        _adc.setSignal((float)load);
+    }
+
+    // Task_Capture, every 20 ms
+    void captureTask()
+    {
+        bool active = (sim_us / 60000000ull) % (SOAK_CAPTURE_EVERY_H * 60) < SOAK_CAPTURE_MINUTES;
+        if (active && !_capturing)
+        {
+            _capturing = true;
+            _captureIndex = 0;
+            _blockCount = 0;
+            stats.captures++;
+        }
+        if (_capturing && (_blockCount == SOAK_CAPTURE_BLOCK || (!active && _blockCount)))
+            writeCaptureBlock();
+        if (!active)
+            _capturing = false;
+    }
+
+    // Task_Alarm, every 50 ms: the events of AlarmClass::update_loop
+    void alarmTask()
+    {
+        uint32_t changed_rules = _alarm.takeChangedRules();
+        if (!changed_rules)
+            return;
+
+        TransientAllocations transient;
+        uint32_t active_rules = _alarm.getActiveRules();
+        float value = _pipeline.getAlarmInput();
+        for (uint8_t i = 0; i < ALARM_MAX_RULES; i++)
+        {
+            if (!(changed_rules & (1UL << i)))
+                continue;
+
+            bool active = active_rules & (1UL << i);
+            String message = "alarm " + String(i) + (active ? " set" : " cleared") + " at " + String(value);
+
+            DataEvent changed("Alarm/changed", String(i) + "," + String(active ? 1 : 0) + "," + String(sim_millis()) + "," + String(value));
+            EventManager::instance().publish(changed);
+
+            DataEvent ev("Webservice/sendMessage", message);
+            EventManager::instance().publish(ev);
+            stats.alarms++;
+        }
+    }
+
+    // Task_Display, every DISPLAY_UPDATE_MS. The page changes every simulated 10 minutes
+    void displayTask()
+    {
+        if (sim_us % 600000000ull == 0)
+            _pages.nextPage();
+
+        const PipelineStats &pipeline = _pipeline.getStats();
+        BatteryStatus battery = _fuelgauge.getStatus();
+        const SensorConfig &sensor = _backend.sensor_config;
+        DisplayState state;
+        state.unit = sensor.displayunit.c_str();
+        state.channel = CHANNEL_FORCE;
+        state.value = _pipeline.getFiltered();
+        state.digits = sensor.digits;
+        state.fullrange = sensor.fullrange;
+        state.sensitivity = sensor.sensitivity;
+        state.zerobalance = 0.0123;
+        state.peak = pipeline.max;
+        state.valley = pipeline.min;
+        state.samples = pipeline.count;
+        state.battery_available = battery.available;
+        state.battery_percent = battery.percent;
+        state.battery_voltage = battery.voltage;
+        state.battery_charge_rate = battery.charge_rate;
+        state.wifi_connected = true;
+        state.wifi_rssi = -60;
+        state.uptime_s = sim_millis() / 1000;
+        _pages.update(_canvas, state);
+    }
+
+    // Task_RegularInfoOut, every 500 ms
+    void infoTask()
+    {
+        char text[FANOUT_DATA_SIZE];
+        BatteryStatus battery = _fuelgauge.getStatus();
+        const DerivedChannels &derived = _pipeline.getDerived();
+        uint32_t source_us = sim_micros();
+
+        snprintf(text, sizeof(text), "%u", sim_millis());
+        publish(CH_PING, text);
+        snprintf(text, sizeof(text), "%d", (int)_pipeline.getRaw());
+        publish(CH_READING, text);
+        snprintf(text, sizeof(text), "%.0f", _pipeline.getFiltered());
+        publish(CH_FORCE, text, source_us);
+        snprintf(text, sizeof(text), "%.1f", battery.percent);
+        publish(CH_BATTERY, text);
+        snprintf(text, sizeof(text), "%.3f,%.4f,%.4f", derived.getRate(), derived.getImpulse(), derived.getWork());
+        publish(CH_DERIVED, text, source_us);
+
+        uint32_t oldest, newest;
+        if (_history.getRange(oldest, newest))
+            stats.history_lag_ms_max = std::max(stats.history_lag_ms_max, sim_millis() - newest);
+    }
+
+    // Task_SampleEvents, every 20 ms
+    void samplesTask()
+    {
+        bool active = _fanout.hasSubscribers(CH_SAMPLES);
+        if (active && !_samplesActive)
+        {
+            _samplesQueued = 0;
+            _sampleBlock.clear();
+        }
+        _samplesActive = active;
+        if (!active)
+            return;
+
+        _sampleBlock.setDigits(_backend.sensor_config.digits);
+        for (size_t i = 0; i < _samplesQueued; i++)
+        {
+            const QueuedSample &sample = _samplesQueue[i];
+            if (_sampleBlock.isEmpty())
+                _sampleBlockSince_us = sim_micros();
+            if (_sampleBlock.add(sample.index, sample.timestamp_us, sample.value))
+                continue;
+            sendSampleBlock();
+            _sampleBlockSince_us = sim_micros();
+            _sampleBlock.add(sample.index, sample.timestamp_us, sample.value);
+        }
+        _samplesQueued = 0;
+
+        if (!_sampleBlock.isEmpty() && sim_micros() - _sampleBlockSince_us >= SOAK_SAMPLES_MAX_AGE_US)
+            sendSampleBlock();
+    }
+
+    // Task_Fuelgauge, every 2 s
+    void fuelgaugeTask() { _fuelgauge.update_loop(); }
+
+    // Task_Storage: writes the saved configs
+    void storageTask()
+    {
+        TransientAllocations transient;
+        g_Storage.update_loop();
+    }
+
+    // AsyncTCP: clients drain their queues
+    void serviceEvents() { _fanout.service(sim_millis()); }
+
+    // browsers and scripts: connect, reconnect with the last event id, change subscriptions
+    void clientsTask()
+    {
+        for (uint8_t i = 0; i < FANOUT_MAX_CLIENTS - 1; i++)
+        {
+            SimTransport::Client &client = _transport.clients[i];
+            float dice = noise.uniform();
+            if (!client.connected && dice < 0.3f)
+            {
+                client.connected = _fanout.addClient(&client, client.last_id, subscription(i, i % 2), i % 3 ? 0 : 1000);
+                client.slow = i == 3;
+                stats.reconnects += client.last_id != 0;
+            }
+            else if (client.connected && dice < 0.05f)
+            {
+                _fanout.removeClient(&client);
+                client.connected = false;
+            }
+            else if (client.connected && dice < 0.08f)
+                _fanout.setSubscription(&client, subscription(i, true), (uint32_t)(noise.uniform() * 2000));
+        }
+    }
+
+    // web page and scripts: config round trips, status, history. Loads run in the storage
+    // task after the queued saves, right after a save or two minutes later
+    void webTask(uint32_t minute)
+    {
+        TransientAllocations transient;
+        char body[SOAK_BODY_SIZE];
+        snprintf(body, sizeof(body), "{\"sensor\":{\"digits\":%u},\"mqtt\":{\"topic_prefix\":\"soak/line-%u\"},\"alarm\":{\"rules\":[{\"level\":%u}]}}",
+                 minute % 4, minute, 300 + minute % 2 * 10);
+
+        request(API_GET, "/api/config");
+        request(API_GET, "/status/glitch");
+        if (minute % 10 == 0)
+            request(API_GET, "/api/cmd/alarmack");
+        if (minute % 5 == 0)
+        {
+            request(API_POST, "/api/config", body);
+            request(API_GET, "/api/cmd/saveconfiguration");
+        }
+        if (minute % 30 == 0 || minute % 30 == 2)
+            request(API_GET, "/api/cmd/loadconfiguration");
+        if (minute % 30 == 0)
+        {
+            request(API_GET, "/api/history");
+            request(API_GET, "/status/api");
+        }
+        if (minute % 180 == 0)
+            request(API_GET, "/api/cmd/tare");
+    }
+
+    const AdcMock &getAdc() const { return _adc; }
+    const LoadcellPipeline &getPipeline() const { return _pipeline; }
+    const EventFanout &getFanout() const { return _fanout; }
+    const ApiRouter &getRouter() const { return _router; }
+    const SoakBackend &getBackend() const { return _backend; }
+    const NullCanvas &getCanvas() const { return _canvas; }
+    const DisplayPages &getPages() const { return _pages; }
+    const SimTransport &getTransport() const { return _transport; }
+    uint64_t getPeriod() const { return _period_us; }
+
+    // events queued for connected clients, bounded by the queue size
+    uint32_t queued()
+    {
+        uint32_t count = 0;
+        for (SimTransport::Client &client : _transport.clients)
+            if (client.connected)
+                count += _fanout.getQueued(&client);
+        return count;
+    }
+};
+
+// ---- scheduler -----------------------------------------------------------------------------
+
+struct Task
+{
+    const char *name;
+    uint32_t period_ms;
+    uint64_t due_us;
+    uint64_t runs;
+};
+
+static uint32_t percentile(std::vector<uint32_t> &values, float fraction)
+{
+    if (values.empty())
+        return 0;
+    size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    float days = 2;
+    float samplerate = 320;
+    uint32_t seed = 1;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:r:s:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            days = atof(optarg);
+            break;
+        case 'r':
+            samplerate = atof(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: soak [-d days] [-r samplerate] [-s seed] [-v]\n");
+            return 2;
+        }
+    }
+    if (days < 2.0f / 24 || samplerate < 1 || samplerate > 10000)
+    {
+        fprintf(stderr, "at least 2 hours, samplerate 1..10000\n");
+        return 2;
+    }
+    noise.seed(seed);
+
+    const uint32_t hours = (uint32_t)(days * 24);
+    std::vector<HourStats> hourly;
+    hourly.reserve(hours + 1);
+    std::vector<uint32_t> seconds;
+    seconds.reserve(3600);
+
+    static SoakBox box;
+    box.begin(samplerate);
+
+    // periods of the firmware tasks
+    Task tasks[] = {
+        {"capture", 20, 0, 0},
+        {"alarm", 50, 0, 0},
+        {"display", 100, 0, 0},
+        {"info", 500, 0, 0},
+        {"fuelgauge", 2000, 0, 0},
+        {"events", 10, 0, 0},
+        {"signal", 1000, 0, 0},
+        {"clients", 60000, 0, 0},
+        {"web", 60000, 0, 0},
+        {"storage", 10, 0, 0},
+        {"samples", 20, 0, 0},
+    };
+    const size_t task_count = sizeof(tasks) / sizeof(tasks[0]);
+
+    printf("soak: %u h simulated, %.0f SPS, seed %u\n", hours, samplerate, seed);
+    printf("%5s %8s %9s %9s %7s %9s %9s %7s %7s %8s %8s %8s\n", "hour", "allocs", "live kB", "arena kB", "chunks", "published",
+           "delivered", "dropped", "clients", "p50 us", "p99 us", "max us");
+
+    auto wall_start = std::chrono::steady_clock::now();
+    uint64_t end_us = (uint64_t)hours * 3600000000ull;
+    uint64_t second_us = 1000000;
+    auto second_start = std::chrono::steady_clock::now();
+    uint32_t micros_wraps = 0;
+
+    while (sim_us < end_us)
+    {
+        // next event: a conversion or a task
+        uint64_t next = box.nextSample();
+        for (size_t i = 0; i < task_count; i++)
+            next = std::min(next, tasks[i].due_us);
+        if ((uint32_t)next < (uint32_t)sim_us)
+            micros_wraps++;
+        sim_us = next;
+
+        if (sim_us >= box.nextSample())
+            box.acquire();
+
+        for (size_t i = 0; i < task_count; i++)
+        {
+            Task &task = tasks[i];
+            if (sim_us < task.due_us)
+                continue;
+            switch (i)
+            {
+            case 0: box.captureTask(); break;
+            case 1: box.alarmTask(); break;
+            case 2: box.displayTask(); break;
+            case 3: box.infoTask(); break;
+            case 4: box.fuelgaugeTask(); break;
+            case 5: box.serviceEvents(); break;
+            case 6: box.updateSignal(); break;
+            case 7: box.clientsTask(); break;
+            case 8: box.webTask((uint32_t)(task.runs % 1440)); break;
+            case 9: box.storageTask(); break;
+            case 10: box.samplesTask(); break;
+            }
+            task.runs++;
+            task.due_us += (uint64_t)task.period_ms * 1000;
+        }
+
+        // one iteration: a simulated second
+        if (sim_us >= second_us)
+        {
+            auto now = std::chrono::steady_clock::now();
+            seconds.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - second_start).count() / 1000);
+            second_start = now;
+            second_us += 1000000;
+        }
+
+        if (sim_us >= (uint64_t)(hourly.size() + 1) * 3600000000ull)
+        {
+            HourStats hour;
+            hour.heap = heapSnapshot();
+            hour.fanout = box.getFanout().getMetrics();
+            hour.clients = box.getTransport().connected();
+            hour.samples = box.stats.samples;
+            hour.frames = box.getPages().getStats().frames;
+            hour.requests = box.stats.requests;
+            hour.messages = box.stats.messages;
+            hour.sample_blocks = box.stats.sample_blocks;
+            hour.capture_bytes = box.stats.capture_bytes;
+            hour.p50_us = percentile(seconds, 0.5f);
+            hour.p99_us = percentile(seconds, 0.99f);
+            hour.max_us = seconds.empty() ? 0 : *std::max_element(seconds.begin(), seconds.end());
+            seconds.clear();
+            hourly.push_back(hour);
+
+            const HourStats *previous = hourly.size() > 1 ? &hourly[hourly.size() - 2] : nullptr;
+            if (verbose || hourly.size() <= 2 || hourly.size() % 6 == 0 || hourly.size() == hours)
+                printf("%5zu %8llu %9.1f %9.1f %7zu %9u %9u %7u %7u %8u %8u %8u\n", hourly.size(),
+                       (unsigned long long)(hour.heap.allocs - (previous ? previous->heap.allocs : 0)), hour.heap.live / 1024.0,
+                       hour.heap.arena / 1024.0, hour.heap.free_chunks, hour.fanout.published - (previous ? previous->fanout.published : 0),
+                       hour.fanout.delivered - (previous ? previous->fanout.delivered : 0), hour.fanout.dropped - (previous ? previous->fanout.dropped : 0),
+                       hour.clients, hour.p50_us, hour.p99_us, hour.max_us);
+        }
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    // ---- checks, against the state after the first hour ----
+    const HourStats &warm = hourly[0];
+    const HourStats &last = hourly.back();
+    const PipelineStats &pipeline = box.getPipeline().getStats();
+    const FanoutMetrics &fanout = box.getFanout().getMetrics();
+    const ApiRouterStats &router = box.getRouter().getStats();
+    const NullCanvas &canvas = box.getCanvas();
+    const DisplayPagesStats &display = box.getPages().getStats();
+    const TrendStats &trend = box.getPages().getTrend().getStats();
+    const SoakBackend &backend = box.getBackend();
+    StorageStats storage = g_Storage.getStats();
+    JsonPoolStats json_pool = JsonPool::getStats();
+
+    printf("\n%.1f s wall for %u h, %.0fx real time\n", wall_s, hours, hours * 3600.0 / wall_s);
+    printf("samples %u, conversions %u, overruns %u, micros() wraps %u, interval %u..%u us (period %llu)\n", box.stats.samples,
+           box.getAdc().getConversions(), box.getAdc().getOverruns(), micros_wraps, pipeline.interval_us_min, pipeline.interval_us_max,
+           (unsigned long long)box.getPeriod());
+    printf("glitches: %u spikes, %u read errors; alarms %u; history lag max %u ms\n", pipeline.glitch_outliers + pipeline.glitch_steps,
+           pipeline.glitch_read_errors, box.stats.alarms, box.stats.history_lag_ms_max);
+    printf("events: %u published, %u delivered, %u dropped, %u coalesced, %u replayed, %u reconnects, %u queued\n", fanout.published,
+           fanout.delivered, fanout.dropped, fanout.coalesced, fanout.replayed, box.stats.reconnects, box.queued());
+    printf("web: %u requests, %u errors, %u rejected sends, %u missing responses\n", router.requests, box.stats.request_errors,
+           router.rejected_sends, router.missing_responses);
+    printf("config: %u saves, %u loads, %u mismatches; storage %u written, %u failed, %u coalesced; json pool peak %u small, %u large, %u fallbacks\n",
+           backend.saves, backend.loads, backend.mismatches, storage.queue.completed, storage.queue.failed, storage.queue.coalesced,
+           json_pool.small_peak, json_pool.large_peak, json_pool.fallbacks);
+    printf("display: %u frames, %u strings, %u glyphs, %u errors, %.0f bytes per frame, trend %u columns, %u full redraws\n", display.frames,
+           canvas.strings, canvas.glyphs, canvas.errors, (double)canvas.bytes_sent / display.frames, trend.columns, trend.full_redraws);
+    printf("samples events: %u blocks, %u samples, %u errors, %u overruns\n", box.stats.sample_blocks, box.stats.block_samples,
+           box.stats.sample_block_errors, box.stats.samples_overruns);
+    printf("captures: %u, %.1f MB encoded, %u block errors\n", box.stats.captures, box.stats.capture_bytes / 1e6, box.stats.capture_errors);
+    printf("heap after warm up: %llu allocations (%llu transient), live %lld -> %lld bytes, arena %zu -> %zu bytes, free chunks %zu -> %zu\n",
+           (unsigned long long)(last.heap.allocs - warm.heap.allocs), (unsigned long long)(last.heap.transient - warm.heap.transient),
+           (long long)warm.heap.live, (long long)last.heap.live, warm.heap.arena, last.heap.arena, warm.heap.free_chunks, last.heap.free_chunks);
+
+    // the steady state must not touch the heap: on the box that is fragmentation over weeks.
+    // The transient allocations have to be freed again
+    check(last.heap.allocs == warm.heap.allocs, "allocations after warm up");
+    check(last.heap.live <= warm.heap.live, "live heap grows");
+    check(last.heap.arena <= warm.heap.arena, "malloc arena grows");
+    check(last.heap.free_chunks <= warm.heap.free_chunks + 2, "heap fragments");
+
+    // sample clock: every conversion read once, intervals stay the period across micros() wraps
+    uint64_t expected_samples = end_us / box.getPeriod();
+    check(box.getAdc().getOverruns() == 0, "adc overruns");
+    check(box.stats.samples + 1 >= expected_samples && box.stats.samples <= expected_samples + 1, "samples against simulated time");
+    check(pipeline.count == box.stats.samples, "pipeline sample count");
+    check(micros_wraps >= hours * 60 / 72, "micros() wraps");
+    check(pipeline.interval_us_min + 1 >= box.getPeriod() && pipeline.interval_us_max <= box.getPeriod() + 1, "sample interval across wraps");
+    check(box.stats.history_lag_ms_max <= 2 * SOAK_HISTORY_BASE * 1000 / samplerate + 1, "history lags the clock");
+
+    // periodic work keeps its rate
+    for (size_t i = 0; i < task_count; i++)
+    {
+        uint64_t expected = end_us / ((uint64_t)tasks[i].period_ms * 1000);
+        if (tasks[i].runs < expected || tasks[i].runs > expected + 1)
+        {
+            printf("task %s: %llu runs, expected %llu\n", tasks[i].name, (unsigned long long)tasks[i].runs, (unsigned long long)expected);
+            failures++;
+        }
+    }
+    // info events without the messages, which follow the load and the commands, and the sample
+    // blocks, which follow the samples client
+    auto info = [](const HourStats &hour)
+    { return hour.fanout.published - hour.messages - hour.sample_blocks; };
+    uint32_t info_warm = info(hourly[1]) - info(warm);
+    uint32_t info_last = info(last) - info(hourly[hourly.size() - 2]);
+    check(info_last == info_warm, "info event rate changes");
+
+    // event stream: bounded queues, clients accounted for
+    check(box.queued() <= box.getTransport().connected() * FANOUT_QUEUE_SIZE, "queued events");
+    check(fanout.clients == box.getTransport().connected(), "connected clients");
+    check(fanout.delivered > 0 && fanout.replayed > 0, "events delivered and replayed");
+
+    check(router.missing_responses == 0 && router.rejected_sends == 0 && box.stats.request_errors == 0, "web api responses");
+    check(backend.saves > 0 && backend.loads > 0 && backend.mismatches == 0, "config saved and loaded");
+    check(storage.queue.failed == 0 && storage.queue.rejected == 0 && g_Storage.idle() && FFat.fileCount() == 5, "config files written");
+    check(json_pool.fallbacks == 0 && json_pool.small_used == 0 && json_pool.large_used == 0, "json documents from the pool");
+    check(canvas.errors == 0 && display.frames == tasks[2].runs, "display frames");
+    check(box.stats.capture_errors == 0 && box.stats.captures > 0, "capture blocks");
+    check(box.stats.alarms > 0 && box.stats.messages >= box.stats.alarms, "alarms");
+    check(box.stats.sample_blocks > 0 && box.stats.sample_block_errors == 0 && box.stats.samples_overruns == 0, "sample blocks");
+
+    // iterations do not get slower, e.g. from growing tables or scans
+    uint32_t early = hourly.size() > 2 ? hourly[1].p99_us : warm.p99_us;
+    uint32_t late = 0;
+    for (size_t i = hourly.size() * 3 / 4; i < hourly.size(); i++)
+        late = std::max(late, hourly[i].p50_us);
+    uint32_t early_p50 = hourly.size() > 2 ? hourly[1].p50_us : warm.p50_us;
+    printf("wall time per simulated second: p50 %u us early, %u us late (max of p50), p99 %u us early\n", early_p50, late, early);
+    check(late <= 2 * early_p50 + 20, "iterations get slower");
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
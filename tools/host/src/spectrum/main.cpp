@@ -0,0 +1,191 @@
+/*
+  Spectrum verification and benchmark
+
+  Feeds synthetic load signals (static offset, two sines, noise) through SpectrumAnalyzer
+  and checks the FFT against a direct DFT, the detected peak frequencies and amplitudes.
+  Then measures the compute time per frame for 256 to 4096 points.
+
+    spectrum                  checks and benchmark, exit code 1 on failure
+    spectrum -r 2000 -n 4096  sample rate and points for the peak check
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include <SpectrumAnalyzer.hpp>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double value, double expected)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("  FAIL %s: %g, expected %g\n", what, value, expected);
+    }
+}
+
+static double monotonic_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static float signal(uint32_t n, float rate)
+{
+    double t = n / (double)rate;
+    return 1234.5 + 3.0 * sin(2 * M_PI * 50.0 * t) + 0.5 * sin(2 * M_PI * 137.3 * t + 1.0);
+}
+
+// windowed single sided amplitude by direct DFT of the latest frame, reference for the FFT
+static void referenceDft(const std::vector<float> &x, std::vector<double> &amplitude)
+{
+    size_t n = x.size();
+    double mean = 0, gain = 0;
+    for (float v : x)
+        mean += v;
+    mean /= n;
+
+    std::vector<double> w(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        w[i] = 0.5 - 0.5 * cos(2 * M_PI * i / n);
+        gain += w[i];
+    }
+
+    amplitude.assign(n / 2 + 1, 0);
+    for (size_t k = 0; k <= n / 2; k++)
+    {
+        double re = 0, im = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            double v = (x[i] - mean) * w[i];
+            re += v * cos(2 * M_PI * k * i / n);
+            im -= v * sin(2 * M_PI * k * i / n);
+        }
+        double a = sqrt(re * re + im * im) / gain;
+        amplitude[k] = (k == 0 || k == n / 2) ? a : 2 * a;
+    }
+}
+
+static void verifyDft(size_t points, float rate)
+{
+    std::vector<uint8_t> memory(SpectrumAnalyzer::requiredMemory(points));
+    SpectrumAnalyzer analyzer;
+    analyzer.begin(memory.data(), points, 1);
+
+    std::vector<float> frame;
+    uint32_t n = 0;
+    while (!analyzer.add(signal(n, rate)))
+        n++;
+    for (uint32_t i = n + 1 - points; i <= n; i++)
+        frame.push_back(signal(i, rate));
+    check(analyzer.compute(), "frame completes an average of 1", 0, 1);
+
+    std::vector<double> reference;
+    referenceDft(frame, reference);
+    double worst = 0;
+    for (size_t k = 0; k < analyzer.getBins(); k++)
+        worst = fmax(worst, fabs(analyzer.getResult()[k] - reference[k]));
+    printf("%4zu points: max deviation from direct DFT %.2e\n", points, worst);
+    check(worst < 1e-3, "deviation from direct DFT", worst, 0);
+}
+
+static void verifyPeaks(size_t points, float rate, uint16_t averages)
+{
+    std::vector<uint8_t> memory(SpectrumAnalyzer::requiredMemory(points));
+    SpectrumAnalyzer analyzer;
+    analyzer.begin(memory.data(), points, averages);
+
+    uint32_t noise = 1;
+    uint32_t n = 0;
+    while (analyzer.getResults() == 0)
+    {
+        noise ^= noise << 13;
+        noise ^= noise >> 17;
+        noise ^= noise << 5;
+        float value = signal(n++, rate) + ((float)noise / 4294967296.0f - 0.5f) * 0.2f;
+        if (analyzer.add(value))
+            analyzer.compute();
+    }
+
+    SpectrumPeak peaks[3];
+    size_t count = analyzer.findPeaks(rate, peaks, 3);
+    float resolution = rate / points;
+    printf("%4zu points, %.0f SPS, %u averages, %u samples: ", points, rate, averages, n);
+    for (size_t i = 0; i < count; i++)
+        printf("%.2f Hz %.3f  ", peaks[i].frequency, peaks[i].amplitude);
+    printf("\n");
+
+    check(count >= 2, "peaks found", count, 2);
+    if (count >= 2)
+    {
+        check(fabs(peaks[0].frequency - 50.0) < resolution / 2, "peak 1 frequency", peaks[0].frequency, 50.0);
+        check(fabs(peaks[1].frequency - 137.3) < resolution / 2, "peak 2 frequency", peaks[1].frequency, 137.3);
+        // Hann scalloping loss is at most 1.42 dB between bins
+        check(peaks[0].amplitude > 3.0 * 0.84 && peaks[0].amplitude < 3.0 * 1.01, "peak 1 amplitude", peaks[0].amplitude, 3.0);
+        check(peaks[1].amplitude > 0.5 * 0.84 && peaks[1].amplitude < 0.5 * 1.01, "peak 2 amplitude", peaks[1].amplitude, 0.5);
+    }
+}
+
+static void benchmark()
+{
+    for (size_t points = SPECTRUM_MIN_POINTS; points <= SPECTRUM_MAX_POINTS; points *= 2)
+    {
+        std::vector<uint8_t> memory(SpectrumAnalyzer::requiredMemory(points));
+        SpectrumAnalyzer analyzer;
+        analyzer.begin(memory.data(), points, 1);
+        for (uint32_t n = 0; n < points; n++)
+            analyzer.add(signal(n, 2000));
+
+        int runs = 200;
+        double start = monotonic_us();
+        for (int i = 0; i < runs; i++)
+            analyzer.compute();
+        double us = (monotonic_us() - start) / runs;
+        printf("compute %4zu points: %8.1f us per frame, %6zu bytes (host)\n", points, us, SpectrumAnalyzer::requiredMemory(points));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    float rate = 2000;
+    size_t points = 2048;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'n':
+            points = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: spectrum [-r SPS] [-n points]\n");
+            return 2;
+        }
+    }
+
+    if (!SpectrumAnalyzer::validPoints(points))
+    {
+        fprintf(stderr, "points must be a power of two between %d and %d\n", SPECTRUM_MIN_POINTS, SPECTRUM_MAX_POINTS);
+        return 2;
+    }
+
+    verifyDft(256, rate);
+    verifyDft(1024, rate);
+    verifyPeaks(points, rate, 1);
+    verifyPeaks(points, rate, 8);
+    benchmark();
+
+    printf("%s\n", failures ? "FAILED" : "all checks ok");
+    return failures ? 1 : 0;
+}
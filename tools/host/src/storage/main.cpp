@@ -0,0 +1,522 @@
+/*
+  Storage write-behind check
+
+  Runs StorageQueue and StorageWriter like the firmware storage task does, on files in a
+  temporary directory: coalescing of repeated config saves and of capture appends, order per
+  path, byte exact capture files with header patch (also reopened with a partial sector),
+  sector aligned writes, atomic replace into a directory that does not exist yet and patches
+  that are in the file when they complete (read back by the MQTT spool). Then a producer
+  thread queues config saves and capture blocks while a storage thread writes them with a
+  simulated flash stall per request, the time a producer spends in a submit must stay far
+  below the stall.
+
+    storage                     checks, exit code 1 on a failure
+    storage -l 30 -n 2000000    flash stall per request in ms, capture bytes of the threaded run
+    storage -d DIR              directory for the files, kept afterwards
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <StorageQueue.hpp>
+#include <StorageWriter.hpp>
+
+#define CONFIG_FILES 5
+#define SUBMIT_BUDGET_US 2000 // longest submit of a producer that must not block
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+class Noise
+{
+private:
+    uint32_t _state = 1;
+
+public:
+    uint32_t next()
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+};
+
+static uint32_t nowUs()
+{
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string dir;
+
+static std::vector<uint8_t> readFile(const char *path)
+{
+    std::vector<uint8_t> content;
+    FILE *file = fopen((dir + path).c_str(), "rb");
+    if (!file)
+        return content;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        content.insert(content.end(), buffer, buffer + n);
+    fclose(file);
+    return content;
+}
+
+static bool exists(const char *path)
+{
+    struct stat st;
+    return stat((dir + path).c_str(), &st) == 0;
+}
+
+// all pending requests, in the order the storage task takes them
+static bool drain(StorageQueue &queue, StorageWriter &writer, std::vector<StorageJob> *jobs = nullptr)
+{
+    bool ok = true;
+    StorageJob job;
+    while (queue.next(job))
+    {
+        if (jobs)
+            jobs->push_back(job);
+        bool written = writer.execute(job);
+        ok &= written;
+        StorageResult result;
+        StorageCallback callback;
+        void *context;
+        queue.complete(job, written, 0, nowUs(), result, callback, context);
+        if (callback)
+            callback(result, context);
+    }
+    return ok;
+}
+
+// like Task_Capture: a rejected request waits until the storage task made room
+static bool put(StorageQueue &queue, StorageWriter &writer, std::vector<StorageJob> *jobs, const char *path, StorageMode mode,
+                const uint8_t *data, size_t length, uint32_t offset = 0)
+{
+    if (queue.submit(path, mode, data, length, nowUs(), offset))
+        return true;
+    drain(queue, writer, jobs);
+    return queue.submit(path, mode, data, length, nowUs(), offset);
+}
+
+static void configText(char *text, size_t size, int file, int round)
+{
+    snprintf(text, size, "{\"file\":%d,\"round\":%d,\"pad\":\"%0*d\"}", file, round, 100 + file * 50, 0);
+}
+
+static void checkCoalescing(StorageQueue &queue, StorageWriter &writer)
+{
+    char path[STORAGE_PATH_SIZE];
+    char text[512];
+
+    // three saves of all config files in a row: one write per file, the last content
+    for (int round = 0; round < 3; round++)
+        for (int file = 0; file < CONFIG_FILES; file++)
+        {
+            snprintf(path, sizeof(path), "/config/c%d.json", file);
+            configText(text, sizeof(text), file, round);
+            queue.submit(path, STORAGE_REPLACE, (const uint8_t *)text, strlen(text), nowUs());
+        }
+    check(queue.getStats().depth == CONFIG_FILES, "repeated saves wait as one request per file");
+    check(queue.getStats().coalesced == 2 * CONFIG_FILES, "repeated saves coalesced");
+
+    const uint8_t *data;
+    size_t length;
+    configText(text, sizeof(text), 2, 2);
+    check(queue.latest("/config/c2.json", data, length) && length == strlen(text) && memcmp(data, text, length) == 0,
+          "read through the queue sees the latest save");
+
+    std::vector<StorageJob> saves;
+    bool ok = drain(queue, writer, &saves);
+    bool content = saves.size() == CONFIG_FILES;
+    for (int file = 0; file < CONFIG_FILES; file++)
+    {
+        snprintf(path, sizeof(path), "/config/c%d.json", file);
+        configText(text, sizeof(text), file, 2);
+        std::vector<uint8_t> written = readFile(path);
+        content &= written.size() == strlen(text) && memcmp(written.data(), text, written.size()) == 0;
+        content &= !exists((std::string(path) + ".tmp").c_str());
+    }
+    check(ok && content, "config files hold the last save, no .tmp left, directory created");
+    check(!queue.latest("/config/c2.json", data, length), "written saves leave the queue");
+
+    // small appends merge while they wait, a patch in between keeps the order
+    uint8_t block[300];
+    for (size_t i = 0; i < sizeof(block); i++)
+        block[i] = i;
+    std::vector<StorageJob> jobs;
+    for (int i = 0; i < 4; i++)
+        put(queue, writer, &jobs, "/order.bin", STORAGE_APPEND, block, sizeof(block));
+    uint32_t marker = 0xA5A5A5A5;
+    put(queue, writer, &jobs, "/order.bin", STORAGE_PATCH, (const uint8_t *)&marker, sizeof(marker), 0);
+    put(queue, writer, &jobs, "/order.bin", STORAGE_APPEND, block, sizeof(block));
+    put(queue, writer, &jobs, "/order.bin", STORAGE_CLOSE, nullptr, 0);
+    ok = drain(queue, writer, &jobs);
+
+    bool order = jobs.size() == 4 && jobs[0].mode == STORAGE_APPEND && jobs[1].mode == STORAGE_PATCH &&
+                 jobs[2].mode == STORAGE_APPEND && jobs[3].mode == STORAGE_CLOSE;
+    check(order, "appends merge up to a patch, not across it");
+    std::vector<uint8_t> written = readFile("/order.bin");
+    std::vector<uint8_t> expected;
+    for (int i = 0; i < 5; i++)
+        expected.insert(expected.end(), block, block + sizeof(block));
+    memcpy(expected.data(), &marker, sizeof(marker));
+    check(ok && written == expected, "order per path kept, patch applied");
+
+    // stream requests take at most STORAGE_STREAM_SLOTS, saves still find a slot
+    StorageQueue streams;
+    int accepted = 0;
+    for (int i = 0; i < STORAGE_QUEUE_SLOTS; i++)
+    {
+        snprintf(path, sizeof(path), "/s%d", i);
+        accepted += streams.submit(path, STORAGE_APPEND, block, 10, nowUs());
+    }
+    check(accepted == STORAGE_STREAM_SLOTS && streams.submit("/config/x.json", STORAGE_REPLACE, block, 10, nowUs()),
+          "streams limited to their slots, saves still queued");
+
+    // full queue: a replace of a pending path still coalesces, a new path is rejected
+    StorageQueue full;
+    for (int i = 0; i < STORAGE_QUEUE_SLOTS; i++)
+    {
+        snprintf(path, sizeof(path), "/f%d", i);
+        full.submit(path, STORAGE_REPLACE, block, 10, nowUs());
+    }
+    bool merged = full.submit("/f0", STORAGE_REPLACE, block, 20, nowUs());
+    bool rejected = !full.submit("/new", STORAGE_REPLACE, block, 10, nowUs());
+    check(merged && rejected && full.getStats().rejected == 1, "full queue: saves coalesce, new paths rejected");
+}
+
+// capture like Task_Capture writes it: header, blocks of varying size, sample count patch, close
+static void checkCapture(StorageQueue &queue, StorageWriter &writer, size_t bytes)
+{
+    const StorageWriterStats before = writer.getStats();
+    std::vector<uint8_t> expected(64, 0);
+    for (size_t i = 0; i < expected.size(); i++)
+        expected[i] = 0xC0 + i % 16;
+    put(queue, writer, nullptr, "/cap.sgc", STORAGE_APPEND, expected.data(), expected.size());
+
+    Noise rng;
+    uint8_t block[1100];
+    bool ok = true;
+    while (expected.size() < bytes)
+    {
+        size_t length = 200 + rng.next() % 900; // encoded blocks
+        for (size_t i = 0; i < length; i++)
+            block[i] = rng.next();
+        ok &= put(queue, writer, nullptr, "/cap.sgc", STORAGE_APPEND, block, length);
+        expected.insert(expected.end(), block, block + length);
+    }
+    uint32_t count = 123456;
+    ok &= put(queue, writer, nullptr, "/cap.sgc", STORAGE_PATCH, (const uint8_t *)&count, sizeof(count), 8);
+    ok &= put(queue, writer, nullptr, "/cap.sgc", STORAGE_CLOSE, nullptr, 0);
+    ok &= drain(queue, writer);
+    memcpy(expected.data() + 8, &count, sizeof(count));
+
+    const StorageWriterStats &after = writer.getStats();
+    uint32_t sectors = after.sector_writes - before.sector_writes;
+    check(ok && readFile("/cap.sgc") == expected, "capture file byte exact with header patch");
+    check(sectors == expected.size() / STORAGE_SECTOR_SIZE && after.tail_writes - before.tail_writes == 1,
+          "capture written in whole aligned sectors and one tail");
+    printf("  %zu bytes: %u sector writes, %u tail, %u patch, %u queue requests\n", expected.size(), sectors,
+           after.tail_writes - before.tail_writes, after.patch_writes - before.patch_writes, queue.getStats().completed);
+
+    // reopened with a partial last sector: staged again, appended data lands after it
+    for (size_t i = 0; i < 5000; i++)
+        block[i % sizeof(block)] = rng.next();
+    std::vector<uint8_t> more(block, block + 1000);
+    put(queue, writer, nullptr, "/cap.sgc", STORAGE_APPEND, more.data(), more.size());
+    put(queue, writer, nullptr, "/cap.sgc", STORAGE_CLOSE, nullptr, 0);
+    ok = drain(queue, writer);
+    expected.insert(expected.end(), more.begin(), more.end());
+    check(ok && readFile("/cap.sgc") == expected, "append to an existing file with a partial sector");
+
+    // flush writes the tail early and it is written again once the sector is complete
+    put(queue, writer, nullptr, "/flush.bin", STORAGE_APPEND, block, 100);
+    drain(queue, writer);
+    bool flushed = writer.hasUnflushed() && writer.flush() && readFile("/flush.bin").size() == 100 && !writer.hasUnflushed();
+    std::vector<uint8_t> tail(block, block + 100);
+    for (int i = 0; i < 5; i++)
+    {
+        put(queue, writer, nullptr, "/flush.bin", STORAGE_APPEND, block, 1000);
+        tail.insert(tail.end(), block, block + 1000);
+    }
+    put(queue, writer, nullptr, "/flush.bin", STORAGE_CLOSE, nullptr, 0);
+    drain(queue, writer);
+    check(flushed && readFile("/flush.bin") == tail, "flush of a staged tail, sector rewritten when complete");
+
+    check(!queue.submit("/flush.bin", STORAGE_PATCH, block, 10, nowUs(), 5100) || !drain(queue, writer),
+          "patch beyond the end of the file fails");
+
+    // the spool reads a slot back with its own handle as soon as the patch completed
+    uint32_t marker = 0x5A5A5A5A;
+    put(queue, writer, nullptr, "/spool.bin", STORAGE_APPEND, block, 1000);
+    put(queue, writer, nullptr, "/spool.bin", STORAGE_PATCH, (const uint8_t *)&marker, sizeof(marker), 900);
+    ok = drain(queue, writer);
+    std::vector<uint8_t> spool = readFile("/spool.bin");
+    check(ok && spool.size() == 1000 && memcmp(spool.data() + 900, &marker, sizeof(marker)) == 0,
+          "patch in the file when it completes, stream still open");
+    put(queue, writer, nullptr, "/spool.bin", STORAGE_CLOSE, nullptr, 0);
+    drain(queue, writer);
+}
+
+// the storage task and its lock, like StorageClass on FreeRTOS
+class HostStorage
+{
+private:
+    StorageQueue _queue;
+    StorageWriter _writer;
+    std::mutex _lock;
+    std::condition_variable _work;
+    bool _stop = false;
+    uint32_t _stallMs;
+    std::thread _thread;
+
+    void run()
+    {
+        StorageJob job;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_lock);
+                _work.wait(lock, [&]
+                           { return _stop || _queue.next(job); });
+                if (_stop && job.path == nullptr)
+                    return;
+            }
+            uint32_t start = nowUs();
+            bool ok = _writer.execute(job);
+            std::this_thread::sleep_for(std::chrono::milliseconds(_stallMs)); // sector write and erase
+            uint32_t write_us = nowUs() - start;
+
+            StorageResult result;
+            StorageCallback callback;
+            void *context;
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _queue.complete(job, ok, write_us, nowUs(), result, callback, context);
+            }
+            if (callback)
+                callback(result, context);
+            job.path = nullptr;
+        }
+    }
+
+public:
+    HostStorage(const char *root, uint32_t stall_ms) : _stallMs(stall_ms)
+    {
+        _writer.begin(root);
+        _thread = std::thread(&HostStorage::run, this);
+    }
+
+    ~HostStorage()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _stop = true;
+        }
+        _work.notify_one();
+        _thread.join();
+    }
+
+    bool submit(const char *path, StorageMode mode, const uint8_t *data, size_t length, uint32_t offset = 0,
+                StorageCallback callback = nullptr, void *context = nullptr)
+    {
+        bool queued;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            queued = _queue.submit(path, mode, data, length, nowUs(), offset, callback, context);
+        }
+        if (queued)
+            _work.notify_one();
+        return queued;
+    }
+
+    bool idle()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _queue.idle();
+    }
+
+    StorageQueueStats getStats()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _queue.getStats();
+    }
+};
+
+struct Completions
+{
+    uint32_t ok = 0;
+    uint32_t failed = 0;
+};
+
+static void onWritten(const StorageResult &result, void *context)
+{
+    Completions *completions = (Completions *)context;
+    (result.ok ? completions->ok : completions->failed)++;
+}
+
+static void checkThreaded(uint32_t stall_ms, size_t bytes)
+{
+    Completions completions;
+    std::vector<uint8_t> expected;
+    uint32_t config_submit_max = 0;
+    uint32_t config_rejected = 0;
+    uint32_t capture_waits = 0;
+    int rounds = 0;
+    StorageQueueStats stats;
+    {
+        HostStorage storage(dir.c_str(), stall_ms);
+        Noise rng;
+        uint8_t block[1100];
+        char path[STORAGE_PATH_SIZE];
+        char text[512];
+
+        // capture blocks at a steady rate, a save of all config files now and then
+        uint32_t next_save = 0;
+        while (expected.size() < bytes)
+        {
+            size_t length = 200 + rng.next() % 900;
+            for (size_t i = 0; i < length; i++)
+                block[i] = rng.next();
+            // Task_Capture waits for a slot, the stream buffer holds the samples meanwhile
+            while (!storage.submit("/thread.sgc", STORAGE_APPEND, block, length, 0, onWritten, &completions))
+            {
+                capture_waits++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            expected.insert(expected.end(), block, block + length);
+
+            if (expected.size() >= next_save)
+            {
+                // the web handler: must return at once
+                for (int file = 0; file < CONFIG_FILES; file++)
+                {
+                    snprintf(path, sizeof(path), "/config/t%d.json", file);
+                    configText(text, sizeof(text), file, rounds);
+                    uint32_t start = nowUs();
+                    if (!storage.submit(path, STORAGE_REPLACE, (const uint8_t *)text, strlen(text), 0, onWritten, &completions))
+                        config_rejected++;
+                    uint32_t took = nowUs() - start;
+                    config_submit_max = took > config_submit_max ? took : config_submit_max;
+                }
+                rounds++;
+                next_save += bytes / 8;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        storage.submit("/thread.sgc", STORAGE_CLOSE, nullptr, 0, 0, onWritten, &completions);
+        while (!storage.idle())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stats = storage.getStats();
+    }
+
+    bool configs = true;
+    char path[STORAGE_PATH_SIZE];
+    char text[512];
+    for (int file = 0; file < CONFIG_FILES; file++)
+    {
+        snprintf(path, sizeof(path), "/config/t%d.json", file);
+        configText(text, sizeof(text), file, rounds - 1);
+        std::vector<uint8_t> written = readFile(path);
+        configs &= written.size() == strlen(text) && memcmp(written.data(), text, written.size()) == 0;
+    }
+
+    printf("  %d save rounds, %zu capture bytes, flash stall %u ms per request\n", rounds, expected.size(), stall_ms);
+    printf("  submitted %u, coalesced %u, written %u, depth peak %u of %u, capture slot waits %u\n", stats.submitted, stats.coalesced,
+           stats.completed, stats.depth_peak, STORAGE_QUEUE_SLOTS, capture_waits);
+    printf("  write %.1f ms mean, %.1f ms max, latency %.1f ms max, config submit %u us max\n",
+           stats.completed ? stats.write_us_total / 1000.0 / stats.completed : 0.0, stats.write_us_max / 1000.0,
+           stats.latency_us_max / 1000.0, config_submit_max);
+
+    check(readFile("/thread.sgc") == expected, "threaded: capture file byte exact");
+    check(configs, "threaded: config files hold the last save");
+    check(completions.failed == 0 && stats.failed == 0, "threaded: no failed writes");
+    check(config_rejected == 0, "threaded: no config save rejected");
+    check(config_submit_max < SUBMIT_BUDGET_US && config_submit_max < stall_ms * 1000 / 4, "threaded: saves do not wait for the flash");
+    check(stats.coalesced > 0 && stats.completed < stats.submitted, "threaded: requests coalesced under load");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t stall_ms = 20;
+    size_t bytes = 400000;
+    const char *keep = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:n:d:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            stall_ms = atoi(optarg);
+            break;
+        case 'n':
+            bytes = atol(optarg);
+            break;
+        case 'd':
+            keep = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-l stall_ms] [-n capture_bytes] [-d dir]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (keep)
+        dir = keep;
+    else
+    {
+        char temp[] = "/tmp/storageXXXXXX";
+        if (!mkdtemp(temp))
+        {
+            perror("mkdtemp");
+            return 2;
+        }
+        dir = temp;
+    }
+
+    StorageQueue *queue = new StorageQueue();
+    StorageWriter *writer = new StorageWriter();
+    writer->begin(dir.c_str());
+
+    checkCoalescing(*queue, *writer);
+    checkCapture(*queue, *writer, bytes / 2);
+    delete queue;
+    delete writer;
+
+    checkThreaded(stall_ms, bytes);
+
+    if (!keep)
+    {
+        std::string command = "rm -rf " + dir;
+        if (system(command.c_str()) != 0)
+            fprintf(stderr, "could not remove %s\n", dir.c_str());
+    }
+
+    if (failures)
+    {
+        printf("%d checks FAILED\n", failures);
+        return 1;
+    }
+    printf("all checks ok\n");
+    return 0;
+}
@@ -0,0 +1,1015 @@
+/*
+  Web api on the host
+
+  Runs the firmware api handlers (ApiRouter, ApiHandlers) behind a small POSIX http server,
+  on a simulated acquisition: AdcMock through LoadcellPipeline into a HistoryStore and a
+  SpectrumAnalyzer, commands are counted, config documents are checked and stored but not
+  interpreted.
+
+  Load test (default): concurrent keep-alive clients send a mix of config, command,
+  history, spectrum and status requests. Reports latency per route, handler time, heap allocations
+  per request and checks that every request got exactly one well formed response, and
+  that HEAD and OPTIONS requests (CORS preflight) are not found and run no command.
+
+    webapi [-c clients] [-d seconds]       load test on a loopback port
+    webapi -s [-p port]                    serve only, e.g. for curl or wrk
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <AdcMock.hpp>
+#include <ApiHandlers.hpp>
+#include <HistoryStore.hpp>
+#include <JsonWriter.hpp>
+#include <LoadcellPipeline.hpp>
+#include <SpectrumAnalyzer.hpp>
+
+// heap allocations of the calling thread, read around dispatch
+static thread_local uint64_t alloc_count = 0;
+static thread_local uint64_t alloc_bytes = 0;
+
+void *operator new(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+// not inlined, gcc would see free() on a pointer from operator new
+__attribute__((noinline)) void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static uint32_t clock_us()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t clock_us64()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ---- simulated box -------------------------------------------------------------------------
+
+#define SIM_HISTORY_CAPACITY 4096
+#define SIM_HISTORY_LEVELS 12
+#define SIM_HISTORY_BASE 8
+#define SIM_SPECTRUM_CHUNK 64
+
+class SimBackend : public ApiBackend
+{
+private:
+    std::mutex _mutex;
+    AdcMock _adc;
+    LoadcellPipeline _pipeline;
+    PipelineParams _params;
+    std::vector<HistoryEntry> _historyMemory;
+    HistoryStore _history;
+    std::string _config;
+    std::string _saved;
+    std::atomic<uint32_t> _commands[API_CMD_COUNT];
+    bool _capturing = false;
+    uint32_t _captured = 0;
+
+    // spectrum of the converted values, computed in the acquisition thread
+    std::vector<float> _spectrumMemory;
+    SpectrumAnalyzer _analyzer;
+    SpectrumStatus _spectrum;
+    std::atomic<uint32_t> _spectrumConfigs{0};
+
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+
+    void acquire()
+    {
+        uint64_t start_us = clock_us64();
+        while (_running)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                while (_adc.available())
+                {
+                    int32_t raw = _adc.read();
+                    uint64_t now_us = clock_us64();
+                    _pipeline.process(raw, (uint32_t)now_us, _adc.readFailed());
+                    _history.add((uint32_t)((now_us - start_us) / 1000), _pipeline.getConverted());
+                    if (_capturing)
+                        _captured++;
+                    if (_spectrum.enabled && _analyzer.add(_pipeline.getConverted()))
+                        computeSpectrum();
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // with _mutex held, as SpectrumClass::update_loop
+    void computeSpectrum()
+    {
+        uint32_t start = clock_us();
+        bool completed = _analyzer.compute();
+        uint32_t compute_us = clock_us() - start;
+
+        _spectrum.frames++;
+        _spectrum.compute_us_last = compute_us;
+        _spectrum.compute_us_max = std::max(_spectrum.compute_us_max, compute_us);
+        _spectrum.compute_us_mean += ((float)compute_us - _spectrum.compute_us_mean) / _spectrum.frames;
+        if (completed)
+            _spectrum.results = _analyzer.getResults();
+    }
+
+public:
+    SimBackend()
+    {
+        for (auto &count : _commands)
+            count = 0;
+
+        AdcMockConfig config;
+        config.samplerate = 320;
+        config.signal_mv_per_v = 1.0;
+        config.sine_mv_per_v = 0.2;
+        config.sine_hz = 2.0;
+        config.noise_counts = 200;
+        _adc.begin();
+        _adc.configure(config);
+
+        _params.sensor_scale_factor = PipelineParams::calcScaleFactor(AdcMock::FULL_SCALE_COUNTS, config.gain, 2.0, 1.0, 1000.0);
+        _params.glitch.enabled = true;
+        _params.glitch.min_deviation = (int32_t)(0.01f * 1000.0f * _params.sensor_scale_factor);
+        _params.glitch.max_step = (int32_t)(0.5f * 1000.0f * _params.sensor_scale_factor);
+        _pipeline.configure(_params);
+
+        _historyMemory.resize(HistoryStore::requiredMemory(SIM_HISTORY_CAPACITY, SIM_HISTORY_LEVELS) / sizeof(HistoryEntry) + 1);
+        _history.begin(_historyMemory.data(), SIM_HISTORY_CAPACITY, SIM_HISTORY_LEVELS, SIM_HISTORY_BASE);
+
+        _spectrumMemory.resize(SpectrumAnalyzer::requiredMemory(SPECTRUM_MAX_POINTS) / sizeof(float) + 1);
+        _spectrum.max_points = SPECTRUM_MAX_POINTS;
+        _spectrum.sample_rate = config.samplerate;
+
+        _config = "{\"system\":{\"hostname\":\"sg-box-sim\"},\"sensor\":{\"name\":\"sim\",\"fullrange\":1000,\"sensitivity\":2},"
+                  "\"adc\":{\"samplerate\":320},\"mqtt\":{},\"alarm\":{}}";
+        _saved = _config;
+    }
+
+    void start()
+    {
+        _running = true;
+        _thread = std::thread(&SimBackend::acquire, this);
+    }
+
+    void stop()
+    {
+        _running = false;
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    uint32_t getCommandCount(ApiCommand command) const { return _commands[command]; }
+    uint32_t getSpectrumConfigs() const { return _spectrumConfigs; }
+
+    bool command(ApiCommand command, const char *arg) override
+    {
+        if (command >= API_CMD_COUNT)
+            return false;
+        _commands[command]++;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        switch (command)
+        {
+        case API_CMD_TARE:
+            _params.sensor_zero_balance_raw = _pipeline.getRaw();
+            _pipeline.setZeroBalanceRaw(_params.sensor_zero_balance_raw);
+            _pipeline.resetIntegrals();
+            return true;
+        case API_CMD_RESET_STATS:
+            _pipeline.resetStats();
+            return true;
+        case API_CMD_CAPTURE_START:
+            _capturing = true;
+            return true;
+        case API_CMD_CAPTURE_STOP:
+            _capturing = false;
+            return true;
+        case API_CMD_LOAD_CONFIG:
+            _config = _saved;
+            return true;
+        case API_CMD_SAVE_CONFIG:
+            _saved = _config;
+            return true;
+        case API_CMD_CALIBRATE:
+            return isfinite(atof(arg));
+        default:
+            return true;
+        }
+    }
+
+    void writeConfig(ApiSink &out) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        out.write(_config.data(), _config.size());
+    }
+
+    // structure only: an object, balanced brackets outside of strings
+    bool applyConfig(const char *json, size_t length) override
+    {
+        size_t start = 0;
+        while (start < length && isspace((unsigned char)json[start]))
+            start++;
+        if (start == length || json[start] != '{')
+            return false;
+
+        int depth = 0;
+        bool string = false;
+        for (size_t i = start; i < length; i++)
+        {
+            char c = json[i];
+            if (string)
+            {
+                if (c == '\\')
+                    i++;
+                else if (c == '"')
+                    string = false;
+            }
+            else if (c == '"')
+                string = true;
+            else if (c == '{' || c == '[')
+                depth++;
+            else if ((c == '}' || c == ']') && --depth < 0)
+                return false;
+        }
+        if (depth != 0 || string)
+            return false;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _config.assign(json + start, length - start);
+        return true;
+    }
+
+    PipelineStats getStats() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _pipeline.getStats();
+    }
+
+    PipelineParams getPipelineParams() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _pipeline.getParams();
+    }
+
+    bool getHistoryRange(uint32_t &oldest_ms, uint32_t &newest_ms) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _history.getRange(oldest_ms, newest_ms);
+    }
+
+    // as HistoryClass::printJson, copies in chunks so acquisition never waits for the formatting
+    void writeHistory(ApiSink &out, uint32_t from_ms, uint32_t to_ms, size_t points) override
+    {
+        if (points > 2000)
+            points = 2000;
+
+        out.print("{\"points\":[");
+        int8_t level;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            level = _history.selectLevel(from_ms, to_ms, points);
+        }
+
+        HistoryEntry chunk[64];
+        size_t count = 0;
+        bool first = true;
+        char line[80];
+        while (level >= 0 && count < points)
+        {
+            size_t n = 0;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _history.visitLevel(level, from_ms, to_ms, std::min(points - count, (size_t)64), first, [&](const HistoryEntry &entry)
+                                    { chunk[n++] = entry; });
+            }
+            if (n == 0)
+                break;
+
+            for (size_t i = 0; i < n; i++)
+            {
+                out.write(line, snprintf(line, sizeof(line), "%s[%u,%g,%g,%g]", first ? "" : ",", chunk[i].t_ms, chunk[i].min, chunk[i].max, chunk[i].mean));
+                first = false;
+            }
+            count += n;
+            from_ms = chunk[n - 1].t_ms + 1;
+        }
+        out.write(line, snprintf(line, sizeof(line), "],\"level\":%d,\"samples_per_point\":%u}", level, level < 0 ? 0 : SIM_HISTORY_BASE << level));
+    }
+
+    bool hasSpectrum() override { return true; }
+
+    SpectrumStatus getSpectrumStatus() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _spectrum;
+    }
+
+    bool configureSpectrum(bool enable, uint16_t points, uint16_t averages, bool sse) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_analyzer.begin(_spectrumMemory.data(), points, averages))
+            return false;
+        _spectrum.enabled = enable;
+        _spectrum.sse = sse;
+        _spectrum.points = _analyzer.getPoints();
+        _spectrum.averages = _analyzer.getAverages();
+        _spectrum.frames = 0;
+        _spectrum.results = 0;
+        _spectrum.compute_us_last = 0;
+        _spectrum.compute_us_max = 0;
+        _spectrum.compute_us_mean = 0;
+        _spectrumConfigs++;
+        return true;
+    }
+
+    // in the analyzer memory like SpectrumClass::runBenchmark, the running analysis starts over
+    bool benchmarkSpectrum() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (uint8_t i = 0; i < SPECTRUM_SIZES; i++)
+        {
+            size_t points = SPECTRUM_MIN_POINTS << i;
+            SpectrumAnalyzer bench;
+            bench.begin(_spectrumMemory.data(), points, 1);
+            for (size_t n = 0; n < points; n++)
+                bench.add(sinf(2.0f * (float)M_PI * 50.0f * n / 1000.0f));
+            uint32_t start = clock_us();
+            bench.compute();
+            _spectrum.bench_us[i] = std::max(clock_us() - start, 1u);
+        }
+        if (_spectrum.points)
+            _analyzer.begin(_spectrumMemory.data(), _spectrum.points, _spectrum.averages);
+        return true;
+    }
+
+    // as SpectrumClass::printJson, max of neighbouring bins, copied in chunks
+    void writeSpectrum(ApiSink &out, size_t bins) override
+    {
+        SpectrumStatus status = getSpectrumStatus();
+        size_t count = status.points / 2 + 1;
+        size_t group = bins > 0 && count > bins ? (count + bins - 1) / bins : 1;
+        float resolution = status.points ? status.sample_rate / status.points : 0;
+
+        char line[256];
+        out.write(line, snprintf(line, sizeof(line), "{\"enabled\":%s,\"points\":%u,\"averages\":%u,\"sample_rate\":%g,\"results\":%u,\"compute_us_last\":%u,\"bin_hz\":%g,\"amplitude\":[",
+                                 status.enabled ? "true" : "false", status.points, status.averages, status.sample_rate, status.results, status.compute_us_last, resolution * group));
+
+        float chunk[SIM_SPECTRUM_CHUNK];
+        bool first = true;
+        for (size_t k = 0; status.results > 0 && k < count;)
+        {
+            size_t n = 0;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_analyzer.getPoints() != status.points)
+                    break;
+                const float *result = _analyzer.getResult();
+                for (; n < SIM_SPECTRUM_CHUNK && k < count; n++)
+                {
+                    float value = 0;
+                    for (size_t end = std::min(k + group, count); k < end; k++)
+                        value = std::max(value, result[k]);
+                    chunk[n] = value;
+                }
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                out.write(line, snprintf(line, sizeof(line), "%s%g", first ? "" : ",", chunk[i]));
+                first = false;
+            }
+        }
+        out.print("]}");
+    }
+};
+
+// ---- http adapter --------------------------------------------------------------------------
+
+static std::string urlDecode(const std::string &text)
+{
+    std::string out;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] == '+')
+            out += ' ';
+        else if (text[i] == '%' && i + 2 < text.size())
+        {
+            out += (char)strtol(text.substr(i + 1, 2).c_str(), NULL, 16);
+            i += 2;
+        }
+        else
+            out += text[i];
+    }
+    return out;
+}
+
+static void parseParams(const std::string &text, std::vector<std::pair<std::string, std::string>> &params)
+{
+    size_t start = 0;
+    while (start < text.size())
+    {
+        size_t end = text.find('&', start);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string pair = text.substr(start, end - start);
+        size_t equal = pair.find('=');
+        if (!pair.empty())
+            params.push_back({urlDecode(pair.substr(0, equal)), equal == std::string::npos ? "" : urlDecode(pair.substr(equal + 1))});
+        start = end + 1;
+    }
+}
+
+class HostRequest : public ApiRequest
+{
+public:
+    ApiMethod _method = API_GET;
+    std::string _path;
+    std::vector<std::pair<std::string, std::string>> _query, _form, _headers;
+    std::string _body;
+
+    ApiMethod method() const override { return _method; }
+    const char *path() const override { return _path.c_str(); }
+
+    const char *param(const char *name, bool post) const override
+    {
+        for (const auto &param : post ? _form : _query)
+            if (param.first == name)
+                return param.second.c_str();
+        return nullptr;
+    }
+
+    const char *header(const char *name) const override
+    {
+        for (const auto &header : _headers)
+            if (strcasecmp(header.first.c_str(), name) == 0)
+                return header.second.c_str();
+        return nullptr;
+    }
+
+    const char *body() const override { return _body.c_str(); }
+    size_t bodyLength() const override { return _body.size(); }
+};
+
+class StringSink : public ApiSink
+{
+public:
+    std::string *text = nullptr;
+    size_t write(const char *data, size_t length) override
+    {
+        text->append(data, length);
+        return length;
+    }
+};
+
+// the whole response is built before it is written, like AsyncResponseStream. The buffers
+// belong to the connection and keep their capacity, so they do not show up as allocations
+class HostResponse : public ApiResponse
+{
+private:
+    std::string &_out;
+    std::string &_body;
+    StringSink _sink;
+    int _streamStatus = 0;
+    const char *_streamType = nullptr;
+
+    void header(int status, const char *type, size_t length)
+    {
+        char text[160];
+        _out.append(text, snprintf(text, sizeof(text), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: keep-alive\r\n\r\n",
+                                   status, status < 300 ? "OK" : (status == 404 ? "Not Found" : "Error"), type, length));
+    }
+
+protected:
+    void doSend(int status, const char *type, const char *body, size_t length) override
+    {
+        header(status, type, length);
+        _out.append(body, length);
+    }
+
+    ApiSink &doBeginStream(int status, const char *type) override
+    {
+        _streamStatus = status;
+        _streamType = type;
+        _body.clear();
+        _sink.text = &_body;
+        return _sink;
+    }
+
+    void doFinish() override
+    {
+        header(_streamStatus, _streamType, _body.size());
+        _out += _body;
+    }
+
+public:
+    HostResponse(std::string &out, std::string &body) : _out(out), _body(body) {}
+};
+
+struct RouteLoad
+{
+    uint32_t requests = 0;
+    uint64_t allocs = 0;
+    uint64_t alloc_bytes = 0;
+};
+
+class HostServer
+{
+private:
+    ApiRouter &_router;
+    std::mutex _dispatch; // the firmware dispatches from one AsyncTCP task only
+    std::map<std::string, RouteLoad> _load;
+    int _listen = -1;
+    std::thread _accept;
+    std::vector<std::thread> _connections;
+    std::atomic<bool> _running{false};
+
+    // false on a malformed request or a closed connection
+    bool readRequest(int sock, std::string &buffer, HostRequest &request, bool &keepAlive)
+    {
+        size_t end;
+        while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+        {
+            char chunk[4096];
+            ssize_t n = recv(sock, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return false;
+            buffer.append(chunk, n);
+        }
+
+        std::string head = buffer.substr(0, end);
+        buffer.erase(0, end + 4);
+
+        char method[16], target[1024];
+        if (sscanf(head.c_str(), "%15s %1023s", method, target) != 2)
+            return false;
+        request = HostRequest();
+        request._method = strcmp(method, "POST") == 0 ? API_POST : strcmp(method, "PUT") == 0 ? API_PUT
+                                                               : strcmp(method, "PATCH") == 0  ? API_PATCH
+                                                               : strcmp(method, "DELETE") == 0 ? API_DELETE
+                                                               : strcmp(method, "GET") == 0    ? API_GET
+                                                                                               : API_NONE;
+        std::string path = target;
+        size_t question = path.find('?');
+        if (question != std::string::npos)
+        {
+            parseParams(path.substr(question + 1), request._query);
+            path.erase(question);
+        }
+        request._path = path;
+
+        size_t line = head.find("\r\n");
+        size_t length = 0;
+        keepAlive = true;
+        while (line != std::string::npos)
+        {
+            size_t next = head.find("\r\n", line + 2);
+            std::string header = head.substr(line + 2, next == std::string::npos ? std::string::npos : next - line - 2);
+            size_t colon = header.find(':');
+            if (colon != std::string::npos)
+            {
+                std::string name = header.substr(0, colon);
+                std::string value = header.substr(header.find_first_not_of(' ', colon + 1));
+                if (strcasecmp(name.c_str(), "content-length") == 0)
+                    length = atol(value.c_str());
+                if (strcasecmp(name.c_str(), "connection") == 0 && strcasecmp(value.c_str(), "close") == 0)
+                    keepAlive = false;
+                request._headers.push_back({name, value});
+            }
+            line = next;
+        }
+
+        while (buffer.size() < length)
+        {
+            char chunk[4096];
+            ssize_t n = recv(sock, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return false;
+            buffer.append(chunk, n);
+        }
+        std::string body = buffer.substr(0, length);
+        buffer.erase(0, length);
+
+        // forms become post parameters like in AsyncWebServer, other bodies stay raw
+        const char *type = request.header("content-type");
+        if (type && strncasecmp(type, "application/x-www-form-urlencoded", 33) == 0)
+            parseParams(body, request._form);
+        else
+            request._body = body;
+        return true;
+    }
+
+    void serve(int sock)
+    {
+        std::string buffer, out, body;
+        out.reserve(1 << 16);
+        body.reserve(1 << 16);
+        HostRequest request;
+        bool keepAlive = true;
+
+        while (_running && keepAlive && readRequest(sock, buffer, request, keepAlive))
+        {
+            out.clear();
+            {
+                std::lock_guard<std::mutex> lock(_dispatch);
+                HostResponse response(out, body);
+                uint64_t count = alloc_count, bytes = alloc_bytes;
+                _router.dispatch(request, response);
+                count = alloc_count - count;
+                bytes = alloc_bytes - bytes;
+
+                RouteLoad &load = _load[request._path];
+                load.requests++;
+                load.allocs += count;
+                load.alloc_bytes += bytes;
+            }
+
+            size_t sent = 0;
+            while (sent < out.size())
+            {
+                ssize_t n = send(sock, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0)
+                    break;
+                sent += n;
+            }
+        }
+        close(sock);
+    }
+
+public:
+    HostServer(ApiRouter &router) : _router(router) {}
+
+    // port 0: any free port, returns the port or -1
+    int start(int port)
+    {
+        _listen = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (bind(_listen, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(_listen, 64) < 0)
+        {
+            perror("listen");
+            return -1;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(_listen, (sockaddr *)&addr, &len);
+
+        _running = true;
+        _accept = std::thread([this]()
+                              {
+            while (_running)
+            {
+                int sock = accept(_listen, NULL, NULL);
+                if (sock < 0)
+                    break;
+                int one = 1;
+                setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                _connections.emplace_back(&HostServer::serve, this, sock);
+            } });
+        return ntohs(addr.sin_port);
+    }
+
+    void stop()
+    {
+        _running = false;
+        shutdown(_listen, SHUT_RDWR);
+        close(_listen);
+        if (_accept.joinable())
+            _accept.join();
+        for (auto &connection : _connections)
+            connection.join();
+    }
+
+    std::map<std::string, RouteLoad> getLoad()
+    {
+        std::lock_guard<std::mutex> lock(_dispatch);
+        return _load;
+    }
+};
+
+// ---- load test -----------------------------------------------------------------------------
+
+struct MixEntry
+{
+    const char *name;
+    const char *method;
+    const char *target;
+    const char *type; // body content type
+    const char *body;
+    int expected; // status
+    int weight;
+};
+
+static const MixEntry mix[] = {
+    {"GET config", "GET", "/api/config", nullptr, nullptr, 200, 10},
+    {"POST config", "POST", "/api/config", "application/json", "{\"sensor\":{\"name\":\"sim \\\"a\\\"\",\"filter_size\":8},\"adc\":{\"samplerate\":320}}", 200, 4},
+    {"POST config bad", "POST", "/api/config", "application/json", "{\"sensor\":{", 400, 1},
+    {"tare", "GET", "/api/cmd/tare", nullptr, nullptr, 200, 4},
+    {"resetstats", "GET", "/api/cmd/resetstats", nullptr, nullptr, 200, 2},
+    {"capturestart", "GET", "/api/cmd/capturestart", nullptr, nullptr, 200, 1},
+    {"capturestop", "GET", "/api/cmd/capturestop", nullptr, nullptr, 200, 1},
+    {"calibrate", "POST", "/api/cmd/calibrateknownreference", "application/x-www-form-urlencoded", "knownValue=100.5", 200, 2},
+    {"calibrate missing", "POST", "/api/cmd/calibrateknownreference", "application/x-www-form-urlencoded", "other=1", 400, 1},
+    {"templearn bad", "GET", "/api/cmd/templearn?action=pause", nullptr, nullptr, 400, 1},
+    {"history 500", "GET", "/api/history?points=500", nullptr, nullptr, 200, 8},
+    {"history range", "GET", "/api/history?from=1000&to=3000&points=100", nullptr, nullptr, 200, 4},
+    {"spectrum", "GET", "/api/spectrum?bins=64", nullptr, nullptr, 200, 2},
+    {"spectrum on", "GET", "/api/cmd/spectrum?enable=1&points=512&averages=2", nullptr, nullptr, 200, 1},
+    {"spectrum bad", "GET", "/api/cmd/spectrum?enable=1&points=66048", nullptr, nullptr, 400, 1},
+    {"spectrum no enable", "GET", "/api/cmd/spectrum?points=512", nullptr, nullptr, 400, 1},
+    {"spectrum bench", "GET", "/api/cmd/spectrum?bench=1", nullptr, nullptr, 200, 1},
+    {"status spectrum", "GET", "/status/spectrum", nullptr, nullptr, 200, 2},
+    {"status glitch", "GET", "/status/glitch", nullptr, nullptr, 200, 8},
+    {"status api", "GET", "/status/api", nullptr, nullptr, 200, 2},
+    {"not found", "GET", "/api/none", nullptr, nullptr, 404, 1},
+    {"HEAD tare", "HEAD", "/api/cmd/tare", nullptr, nullptr, 404, 1},
+    {"OPTIONS tare", "OPTIONS", "/api/cmd/tare", nullptr, nullptr, 404, 1},
+};
+static const size_t MIX_SIZE = sizeof(mix) / sizeof(mix[0]);
+
+struct ClientResult
+{
+    std::vector<std::vector<uint32_t>> latency_us = std::vector<std::vector<uint32_t>>(MIX_SIZE);
+    uint32_t wrong_status = 0;
+    uint32_t malformed = 0;
+    uint32_t extra_bytes = 0;
+};
+
+// reads one response, false if it is not well formed. Content-Length framing only
+static bool readResponse(int sock, std::string &buffer, int &status, std::string &body)
+{
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+    {
+        char chunk[8192];
+        ssize_t n = recv(sock, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, n);
+    }
+    if (sscanf(buffer.c_str(), "HTTP/1.1 %d", &status) != 1)
+        return false;
+    const char *length = strcasestr(buffer.c_str(), "content-length:");
+    if (!length || length > buffer.c_str() + end)
+        return false;
+    size_t size = atol(length + 15);
+
+    while (buffer.size() < end + 4 + size)
+    {
+        char chunk[8192];
+        ssize_t n = recv(sock, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, n);
+    }
+    body = buffer.substr(end + 4, size);
+    buffer.erase(0, end + 4 + size);
+    return true;
+}
+
+static void client(int port, double seconds, int seed, ClientResult &result)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(sock, (sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        result.malformed++;
+        return;
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    int total_weight = 0;
+    for (const MixEntry &entry : mix)
+        total_weight += entry.weight;
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> pick(0, total_weight - 1);
+
+    std::string buffer, body, request;
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < end)
+    {
+        int w = pick(random);
+        size_t i = 0;
+        while (w >= mix[i].weight)
+            w -= mix[i++].weight;
+        const MixEntry &entry = mix[i];
+
+        char head[512];
+        size_t length = entry.body ? strlen(entry.body) : 0;
+        int n = snprintf(head, sizeof(head), "%s %s HTTP/1.1\r\nHost: box\r\n", entry.method, entry.target);
+        if (entry.type)
+            n += snprintf(head + n, sizeof(head) - n, "Content-Type: %s\r\nContent-Length: %zu\r\n", entry.type, length);
+        n += snprintf(head + n, sizeof(head) - n, "\r\n");
+        request.assign(head, n);
+        if (entry.body)
+            request += entry.body;
+
+        uint32_t start = clock_us();
+        send(sock, request.data(), request.size(), MSG_NOSIGNAL);
+        int status = 0;
+        if (!readResponse(sock, buffer, status, body))
+        {
+            result.malformed++;
+            break;
+        }
+        result.latency_us[i].push_back(clock_us() - start);
+        if (status != entry.expected)
+            result.wrong_status++;
+        // a second response to the same request would be left in the buffer
+        if (!buffer.empty())
+            result.extra_bytes += buffer.size();
+        if (status == 200 && strcmp(entry.type ? entry.type : "", "") == 0 && body.empty())
+            result.malformed++;
+    }
+    close(sock);
+}
+
+static uint32_t percentile(std::vector<uint32_t> &values, double p)
+{
+    if (values.empty())
+        return 0;
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int main(int argc, char **argv)
+{
+    int clients = 8;
+    double seconds = 5;
+    int port = 0;
+    bool serveOnly = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:d:p:sh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            clients = atoi(optarg);
+            break;
+        case 'd':
+            seconds = atof(optarg);
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 's':
+            serveOnly = true;
+            break;
+        default:
+            fprintf(stderr, "usage: webapi [-c clients] [-d seconds] | webapi -s [-p port]\n");
+            return 2;
+        }
+    }
+
+    SimBackend backend;
+    backend.start();
+    ApiRouter router;
+    router.begin(backend, clock_us);
+    if (!ApiHandlers::registerRoutes(router))
+    {
+        fprintf(stderr, "route table full\n");
+        return 1;
+    }
+
+    HostServer server(router);
+    if (serveOnly)
+    {
+        port = server.start(port ? port : 8080);
+        if (port < 0)
+            return 1;
+        printf("serving the api on http://127.0.0.1:%d, e.g. curl http://127.0.0.1:%d/status/api\n", port, port);
+        while (true)
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    port = server.start(port);
+    if (port < 0)
+        return 1;
+    // history needs a few seconds of samples for more than one level
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    std::vector<ClientResult> results(clients);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < clients; c++)
+        threads.emplace_back(client, port, seconds, c + 1, std::ref(results[c]));
+    for (auto &thread : threads)
+        thread.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // the load test reconfigures the spectrum all the time, one result of the quiet signal
+    uint32_t spectrum_configs = backend.getSpectrumConfigs();
+    backend.configureSpectrum(true, SPECTRUM_MIN_POINTS, 1, false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(SPECTRUM_MIN_POINTS * 1000 / 320 + 300));
+
+    server.stop();
+    backend.stop();
+
+    ClientResult total;
+    for (ClientResult &result : results)
+    {
+        for (size_t i = 0; i < MIX_SIZE; i++)
+            total.latency_us[i].insert(total.latency_us[i].end(), result.latency_us[i].begin(), result.latency_us[i].end());
+        total.wrong_status += result.wrong_status;
+        total.malformed += result.malformed;
+        total.extra_bytes += result.extra_bytes;
+    }
+
+    std::map<std::string, RouteLoad> load = server.getLoad();
+    size_t requests = 0;
+    printf("%d clients, %.1f s\n", clients, elapsed);
+    printf("%-18s %8s %8s %8s %8s %8s %10s %10s %10s\n", "route", "requests", "req/s", "p50 us", "p99 us", "max us", "handler us", "allocs/req", "bytes/req");
+    for (size_t i = 0; i < MIX_SIZE; i++)
+    {
+        std::vector<uint32_t> &latency = total.latency_us[i];
+        size_t count = latency.size();
+        requests += count;
+
+        std::string path = mix[i].target;
+        path = path.substr(0, path.find('?'));
+        const ApiRoute *route = router.find(strcmp(mix[i].method, "POST") == 0 ? API_POST : API_GET, path.c_str());
+        double handler = route && route->stats.requests ? (double)route->stats.time_us_total / route->stats.requests : 0;
+        const RouteLoad &server_load = load[path];
+        double allocs = server_load.requests ? (double)server_load.allocs / server_load.requests : 0;
+        double bytes = server_load.requests ? (double)server_load.alloc_bytes / server_load.requests : 0;
+
+        printf("%-18s %8zu %8.0f %8u %8u %8u %10.1f %10.2f %10.0f\n", mix[i].name, count, count / elapsed,
+               percentile(latency, 0.5), percentile(latency, 0.99), percentile(latency, 1.0), handler, allocs, bytes);
+    }
+    printf("total %zu requests, %.0f req/s; handler time and allocations per path, shared by routes on one path\n", requests, requests / elapsed);
+
+    const ApiRouterStats &stats = router.getStats();
+    printf("router: %u requests, %u not found, %u rejected sends, %u missing responses\n",
+           stats.requests, stats.not_found, stats.rejected_sends, stats.missing_responses);
+    printf("backend: %u tare, %u calibrate, %u capture start\n",
+           backend.getCommandCount(API_CMD_TARE), backend.getCommandCount(API_CMD_CALIBRATE), backend.getCommandCount(API_CMD_CAPTURE_START));
+    printf("clients: %u wrong status, %u malformed, %u bytes after a response\n", total.wrong_status, total.malformed, total.extra_bytes);
+
+    // HEAD and OPTIONS (a CORS preflight) must not run the command
+    size_t tare_sent = 0;
+    for (size_t i = 0; i < MIX_SIZE; i++)
+        if (strcmp(mix[i].name, "tare") == 0)
+            tare_sent = total.latency_us[i].size();
+    printf("commands: %zu tare sent with GET, %u run\n", tare_sent, backend.getCommandCount(API_CMD_TARE));
+
+    // only valid spectrum settings reach the analysis, 66048 points would wrap to 512 in a uint16_t
+    size_t spectrum_sent = 0;
+    for (size_t i = 0; i < MIX_SIZE; i++)
+        if (strcmp(mix[i].name, "spectrum on") == 0)
+            spectrum_sent = total.latency_us[i].size();
+    SpectrumStatus spectrum = backend.getSpectrumStatus();
+    printf("spectrum: %zu valid settings sent, %u applied; afterwards %u frames, %u results\n", spectrum_sent, spectrum_configs, spectrum.frames, spectrum.results);
+
+    bool ok = total.wrong_status == 0 && total.malformed == 0 && total.extra_bytes == 0 &&
+              stats.rejected_sends == 0 && stats.missing_responses == 0 && stats.requests == requests &&
+              backend.getCommandCount(API_CMD_TARE) == tare_sent && spectrum_configs == spectrum_sent && spectrum.results > 0;
+    printf("%s\n", ok ? "all checks ok" : "FAILED");
+    return ok ? 0 : 1;
+}